@@ -16,6 +16,53 @@
 
 #include "sockops.h"
 
+// Batching of the redirected messages, set by Felix from the
+// SidecarAccelerationApplyBytes and SidecarAccelerationCorkBytes config.
+//
+// - apply_bytes: once a message has been redirected, the kernel applies the
+//   same verdict to the next apply_bytes bytes that the socket sends without
+//   running this program again.
+// - cork_bytes: the kernel holds back the messages of a redirected socket
+//   until cork_bytes bytes have accumulated and then redirects them in one go.
+//   A message that is shorter than that waits for the next one, so this only
+//   suits streaming workloads.
+//
+// Zero disables either of them.
+//
+// WARNING: the value size must be kept in sync with NewSockmapMsgConfigMap()
+// in bpf/bpf.go.
+struct sk_msg_cfg {
+	__u32 apply_bytes;
+	__u32 cork_bytes;
+};
+
+struct bpf_map_def __attribute__((section("maps"))) calico_sk_msg_cfg = {
+	.type           = BPF_MAP_TYPE_ARRAY,
+	.key_size       = sizeof(__u32),
+	.value_size     = sizeof(struct sk_msg_cfg),
+	.max_entries    = 1,
+};
+
+// batch_redirects makes the verdict of a message that has just been redirected
+// stick for the messages that follow it, see struct sk_msg_cfg.  It is only
+// called for redirected messages so that the traffic that goes through the
+// rest of the stack is never held back.
+static CALI_BPF_INLINE void batch_redirects(struct sk_msg_md *msg)
+{
+	__u32 zero = 0;
+	struct sk_msg_cfg *cfg = bpf_map_lookup_elem(&calico_sk_msg_cfg, &zero);
+
+	if (!cfg) {
+		return;
+	}
+	if (cfg->apply_bytes) {
+		bpf_msg_apply_bytes(msg, cfg->apply_bytes);
+	}
+	if (cfg->cork_bytes) {
+		bpf_msg_cork_bytes(msg, cfg->cork_bytes);
+	}
+}
+
 __attribute__((section("calico_sk_msg_func")))
 enum sk_action calico_sk_msg(struct sk_msg_md *msg)
 {
@@ -29,6 +76,20 @@ enum sk_action calico_sk_msg(struct sk_msg_md *msg)
 	sport = port_to_host(msg->local_port);
 	dport = safe_extract_port(msg->remote_port);
 
+	// If this is a connection between two local endpoints, the socket at the
+	// other end is stored with the ends swapped.  It is only there if both ends
+	// established the connection, see sockops.c.
+	struct sock_key peer_key = {
+		.ip4 = dip,
+		.port = dport,
+		.peer_ip4 = sip,
+		.peer_port = sport,
+	};
+	if (bpf_msg_redirect_hash(msg, &calico_sock_map, &peer_key, BPF_REDIR_INGRESS) == SK_PASS) {
+		batch_redirects(msg);
+		return SK_PASS;
+	}
+
 	if (sip == ENVOY_IP && sport == ENVOY_PORT) {
 	// If the source is envoy, we need to redirect to the socket to the
 	// other end. That is, not on the envoy side and with an IP/port
@@ -53,6 +114,9 @@ enum sk_action calico_sk_msg(struct sk_msg_md *msg)
 	}
 
 	err = bpf_msg_redirect_hash(msg, &calico_sock_map, &key, BPF_REDIR_INGRESS);
+	if (err == SK_PASS) {
+		batch_redirects(msg);
+	}
 
 	// If the packet couldn't be redirected, pass it to the rest of the
 	// stack.
@@ -57,6 +57,24 @@ enum bpf_ret_code calico_sockops(struct bpf_sock_ops *skops)
 	sport = port_to_host(skops->local_port);
 	dport = safe_extract_port(skops->remote_port);
 
+	// If both ends are local endpoints, the sk_msg program can hand messages
+	// straight to the socket at the other end.  We only get here once the TCP
+	// handshake has completed, i.e. once the SYN and SYN-ACK got through the
+	// policy of both endpoints.  The bypass only takes effect once the other
+	// end has established too, so only flows that policy allowed in both
+	// directions get it.  Like conntrack, it then lasts for the lifetime of
+	// the connection.
+	if (    NULL != bpf_map_lookup_elem(&calico_sk_endpoints, &dip)
+		&&  NULL != bpf_map_lookup_elem(&calico_sk_endpoints, &sip) ) {
+		struct sock_key flow_key = {
+			.ip4 = sip.ip.addr,
+			.port = sport,
+			.peer_ip4 = dip.ip.addr,
+			.peer_port = dport,
+		};
+		err = bpf_sock_hash_update(skops, &calico_sock_map, &flow_key, BPF_ANY);
+	}
+
 	// We use the app's port and ip address as key. The socket attached
 	// to our in-kernel context will be stored as the value automatically.
 	if (sip.ip.addr == ENVOY_IP && sport == ENVOY_PORT) {
@@ -17,10 +17,23 @@
 #define ENVOY_IP 0x100007f
 #define ENVOY_PORT 0x993a
 
+// Sockets are stored under two kinds of key:
+//
+// - For the Envoy sidecar case, the IP and port of the app with envoy_side
+//   telling whether the socket is the app's or Envoy's end.  peer_ip4 and
+//   peer_port are zero.
+// - For connections between two local Calico endpoints, the local IP and port
+//   of the socket in ip4/port and the remote IP and port in peer_ip4/peer_port.
+//   The sk_msg program redirects messages straight to the socket at the other
+//   end of the connection, which has the same key with the two ends swapped.
+//
+// WARNING: the key size must be kept in sync with NewSockmap() in bpf/bpf.go.
 struct sock_key {
 	__u32 ip4;
 	__u32 port;
 	__u32 envoy_side;
+	__u32 peer_ip4;
+	__u32 peer_port;
 };
 
 struct bpf_map_def __attribute__((section("maps"))) calico_sock_map = {
@@ -70,6 +70,15 @@ struct bpf_map_def_extended {
 #define CALI_TC_WIREGUARD	(1<<5)
 // CALI_XDP_PROG is set for programs attached to the XDP hook
 #define CALI_XDP_PROG 	(1<<6)
+// CALI_TC_NO_NAT is set when compiling the variant of the endpoint programs for nodes that have
+// no services; it compiles out the NAT frontend lookup and everything that depends on it.
+#define CALI_TC_NO_NAT		(1<<7)
+// CALI_TC_NO_NP_TUNNEL is set when compiling the variant that neither forwards node port traffic
+// to other nodes over the VXLAN tunnel nor decaps it.
+#define CALI_TC_NO_NP_TUNNEL	(1<<8)
+// CALI_TC_NO_CTLB_REV is set when compiling the variant for nodes without the connect-time load
+// balancer, which skips the lookup of the pre-DNAT destination of host sockets.
+#define CALI_TC_NO_CTLB_REV	(1<<9)
 
 #ifndef CALI_DROP_WORKLOAD_TO_HOST
 #define CALI_DROP_WORKLOAD_TO_HOST false
@@ -104,6 +113,12 @@ struct bpf_map_def_extended {
 #define CALI_F_CGROUP	(((CALI_COMPILE_FLAGS) & CALI_CGROUP) != 0)
 #define CALI_F_DSR	(CALI_COMPILE_FLAGS & CALI_TC_DSR)
 
+/* The stages that the specialised program variants compile out; the NAT frontend lookup is what
+ * the node port tunnel and the CTLB reverse lookup are for, so they go with it. */
+#define CALI_F_NAT		(!((CALI_COMPILE_FLAGS) & CALI_TC_NO_NAT))
+#define CALI_F_NP_TUNNEL	(CALI_F_NAT && !((CALI_COMPILE_FLAGS) & CALI_TC_NO_NP_TUNNEL))
+#define CALI_F_CTLB_REV		(CALI_F_NAT && !((CALI_COMPILE_FLAGS) & CALI_TC_NO_CTLB_REV))
+
 #define CALI_RES_REDIR_BACK	108 /* packet should be sent back the same iface */
 #define CALI_RES_REDIR_IFINDEX	109 /* packet should be sent straight to
 				     * state->ct_result->ifindex_fwd
@@ -129,6 +144,8 @@ static CALI_BPF_INLINE void __compile_asserts(void) {
 		!!(CALI_COMPILE_FLAGS & (CALI_TC_HOST_EP | CALI_TC_INGRESS | CALI_TC_TUNNEL | CALI_TC_DSR | CALI_XDP_PROG))
 	);
 	COMPILE_TIME_ASSERT(!CALI_F_DSR || (CALI_F_DSR && CALI_F_FROM_WEP) || (CALI_F_DSR && CALI_F_HEP));
+	/* DSR only changes how the node port tunnel is used. */
+	COMPILE_TIME_ASSERT(!CALI_F_DSR || CALI_F_NP_TUNNEL);
 	COMPILE_TIME_ASSERT(CALI_F_TO_HOST || CALI_F_FROM_HOST);
 #pragma clang diagnostic pop
 }
@@ -197,6 +214,8 @@ static CALI_BPF_INLINE _Noreturn void bpf_exit(int rc) {
 
 #define ip_is_dnf(ip) ((ip)->frag_off & bpf_htons(0x4000))
 #define ip_frag_no(ip) ((ip)->frag_off & bpf_htons(0x1fff))
+/* The first fragment of a datagram: more fragments follow and the offset is zero. */
+#define ip_is_first_frag(ip) (((ip)->frag_off & bpf_htons(0x3fff)) == bpf_htons(0x2000))
 
 static CALI_BPF_INLINE void ip_dec_ttl(struct iphdr *ip)
 {
@@ -209,6 +228,22 @@ static CALI_BPF_INLINE void ip_dec_ttl(struct iphdr *ip)
 	ip->check = (__be16) (sum + (sum >> 16));
 }
 
+/* ip_csum_replace4 updates the IP header checksum for a change of a 32-bit field, e.g. an address,
+ * from "from" to "to" (RFC 1624).  The IP header is always in the linear area so, like
+ * ip_dec_ttl(), we write the checksum directly instead of calling bpf_l3_csum_replace(), which
+ * saves a helper call on every NATted packet.  It must be used before any helper call that
+ * invalidates the packet pointers.
+ */
+static CALI_BPF_INLINE void ip_csum_replace4(struct iphdr *ip, __be32 from, __be32 to)
+{
+	__u32 sum = (__u16)~ip->check;
+	sum += (__u16)~from + (__u16)~(from >> 16);
+	sum += (__u16)to + (__u16)(to >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	ip->check = (__sum16)~sum;
+}
+
 #define ip_ttl_exceeded(ip) (CALI_F_TO_HOST && !CALI_F_TUNNEL && (ip)->ttl <= 1)
 
 #define CALI_CONFIGURABLE_DEFINE(name, pattern)							\
@@ -226,12 +261,106 @@ CALI_CONFIGURABLE_DEFINE(tunnel_mtu, 0x55544d54) /* be 0x55544d54 = ASCII(TMTU)
 CALI_CONFIGURABLE_DEFINE(vxlan_port, 0x52505856) /* be 0x52505856 = ASCII(VXPR) */
 CALI_CONFIGURABLE_DEFINE(intf_ip, 0x46544e49) /*be 0x46544e49 = ASCII(INTF) */
 CALI_CONFIGURABLE_DEFINE(ext_to_svc_mark, 0x4b52414d) /*be 0x4b52414d = ASCII(MARK) */
+CALI_CONFIGURABLE_DEFINE(ct_lru, 0x524c5443) /*be 0x524c5443 = ASCII(CTLR) */
+CALI_CONFIGURABLE_DEFINE(pol_cache, 0x45435650) /*be 0x45435650 = ASCII(PVCE) */
+CALI_CONFIGURABLE_DEFINE(redir_neigh, 0x4749454e) /*be 0x4749454e = ASCII(NEIG) */
+CALI_CONFIGURABLE_DEFINE(wep_inline, 0x4c4e4957) /*be 0x4c4e4957 = ASCII(WINL) */
+CALI_CONFIGURABLE_DEFINE(shared_progs, 0x44524853) /*be 0x44524853 = ASCII(SHRD) */
+CALI_CONFIGURABLE_DEFINE(iface_cfg, 0x47434649) /*be 0x47434649 = ASCII(IFCG) */
+CALI_CONFIGURABLE_DEFINE(gso_size, 0x534f5347) /*be 0x534f5347 = ASCII(GSOS) */
+CALI_CONFIGURABLE_DEFINE(prog_lat, 0x4854414c) /*be 0x4854414c = ASCII(LATH) */
+CALI_CONFIGURABLE_DEFINE(lean_tunnel, 0x4e41454c) /*be 0x4e41454c = ASCII(LEAN) */
+CALI_CONFIGURABLE_DEFINE(syncookie, 0x434e5953) /*be 0x434e5953 = ASCII(SYNC) */
+CALI_CONFIGURABLE_DEFINE(cpu_steering, 0x4d555043) /*be 0x4d555043 = ASCII(CPUM) */
+CALI_CONFIGURABLE_DEFINE(ct_acct, 0x54434341) /*be 0x54434341 = ASCII(ACCT) */
+CALI_CONFIGURABLE_DEFINE(snat_ip, 0x50494e53) /*be 0x50494e53 = ASCII(SNIP) */
+CALI_CONFIGURABLE_DEFINE(snat_ports, 0x52504e53) /*be 0x52504e53 = ASCII(SNPR) */
+CALI_CONFIGURABLE_DEFINE(snat_ifindex, 0x46494e53) /*be 0x46494e53 = ASCII(SNIF) */
+CALI_CONFIGURABLE_DEFINE(edt, 0x53544445) /*be 0x53544445 = ASCII(EDTS) */
+CALI_CONFIGURABLE_DEFINE(svc_ctrs, 0x43435653) /*be 0x43435653 = ASCII(SVCC) */
+CALI_CONFIGURABLE_DEFINE(numa_replicas, 0x414d554e) /*be 0x414d554e = ASCII(NUMA) */
+CALI_CONFIGURABLE_DEFINE(ktime_coarse, 0x4f43544b) /*be 0x4f43544b = ASCII(KTCO) */
 
 #define HOST_IP		CALI_CONFIGURABLE(host_ip)
 #define TUNNEL_MTU 	CALI_CONFIGURABLE(tunnel_mtu)
 #define VXLAN_PORT 	CALI_CONFIGURABLE(vxlan_port)
 #define INTF_IP		CALI_CONFIGURABLE(intf_ip)
 #define EXT_TO_SVC_MARK	CALI_CONFIGURABLE(ext_to_svc_mark)
+/* CT_MAP_LRU is non-zero if the conntrack map has been loaded as an LRU hash map. */
+#define CT_MAP_LRU	CALI_CONFIGURABLE(ct_lru)
+/* POL_CACHE_ENABLED is non-zero if the policy verdict cache is in use, see policy_cache.h. */
+#define POL_CACHE_ENABLED	CALI_CONFIGURABLE(pol_cache)
+/* REDIRECT_NEIGH is non-zero if the kernel supports bpf_redirect_neigh() and bpf_redirect_peer(),
+ * see fib.h. */
+#define REDIRECT_NEIGH		CALI_CONFIGURABLE(redir_neigh)
+/* WEP_INLINE is non-zero if packets from host endpoints to local workloads are delivered inline,
+ * see wep_inline.h. */
+#define WEP_INLINE		CALI_CONFIGURABLE(wep_inline)
+/* SHARED_PROGS is non-zero if the program is shared between interfaces and hence finds the policy
+ * of the interface in cali_pol_progs rather than in its own jump map, see jump.h. */
+#define SHARED_PROGS		CALI_CONFIGURABLE(shared_progs)
+/* IFACE_CFG_ENABLED is non-zero if the per-interface values, such as HOST_IP, come from the
+ * cali_v4_ifcfg map rather than from the patched constants, see ifcfg.h. */
+#define IFACE_CFG_ENABLED	CALI_CONFIGURABLE(iface_cfg)
+/* GSO_SIZE_OK is non-zero if the kernel exposes __sk_buff.gso_size, see skb_gso_seg_len(). */
+#define GSO_SIZE_OK		CALI_CONFIGURABLE(gso_size)
+/* PROG_LAT_ENABLED is non-zero if the programs record their per-packet latency, see prog_lat.h. */
+#define PROG_LAT_ENABLED	CALI_CONFIGURABLE(prog_lat)
+/* LEAN_TUNNEL is non-zero if the tunnel and wireguard programs leave conntrack and NAT to the
+ * endpoint programs that the packets go through next, see calico_tc(). */
+#define LEAN_TUNNEL		((CALI_F_TUNNEL || CALI_F_WIREGUARD) && CALI_CONFIGURABLE(lean_tunnel))
+/* SYNCOOKIES_ENABLED is non-zero if the XDP program answers the SYNs to the ports in
+ * cali_syncookie with SYN cookies, see syncookie.h. */
+#define SYNCOOKIES_ENABLED	(CALI_F_XDP && CALI_CONFIGURABLE(syncookie))
+/* XDP_CPU_STEERING is the number of CPUs that the XDP program spreads Calico VXLAN packets over,
+ * or zero if it leaves them on the CPU that received them, see xdp_cpu_steer(). */
+#define XDP_CPU_STEERING	(CALI_F_XDP ? CALI_CONFIGURABLE(cpu_steering) : 0)
+/* CT_ACCT_ENABLED is non-zero if the programs count the packets and bytes of each flow in
+ * cali_v4_ct_acct, see ct_acct_update(). */
+#define CT_ACCT_ENABLED		CALI_CONFIGURABLE(ct_acct)
+/* SNAT_IP is the address that the programs SNAT the NAT-outgoing flows of workloads to.  SNAT_PORTS
+ * holds the first source port that they allocate in its upper 16 bits and the number of ports in
+ * its lower 16 bits; it is zero if iptables does the SNAT, see snat.h.  SNAT_IFINDEX is the
+ * interface that owns SNAT_IP, the programs only SNAT the flows that leave through it; zero skips
+ * the check. */
+#define SNAT_IP			CALI_CONFIGURABLE(snat_ip)
+#define SNAT_PORTS		CALI_CONFIGURABLE(snat_ports)
+#define SNAT_IFINDEX		CALI_CONFIGURABLE(snat_ifindex)
+/* EDT_ENABLED is non-zero if the host endpoint program shapes the egress bandwidth of the workloads
+ * in cali_v4_edt, see edt.h.  The tunnel programs leave it to the host endpoint that the
+ * encapped packets leave through. */
+#define EDT_ENABLED		(CALI_F_TO_HEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD && CALI_CONFIGURABLE(edt))
+/* XDP_EDT_ENABLED is non-zero if the workload XDP program must leave the packets of shaped
+ * workloads to TC, redirecting them would skip the host endpoint program that shapes them. */
+#define XDP_EDT_ENABLED		(CALI_F_XDP && CALI_F_WEP && CALI_CONFIGURABLE(edt))
+/* SVC_CTRS_ENABLED is non-zero if the TC programs count the NAT lookups of new flows per service in
+ * cali_v4_svc_ctrs, see svc_ctrs.h.  The connect-time load balancer is not patched and does not
+ * count them. */
+#define SVC_CTRS_ENABLED	(!CALI_F_CGROUP && CALI_CONFIGURABLE(svc_ctrs))
+/* NUMA_REPLICAS_ENABLED is non-zero if Felix keeps a replica of the read-mostly maps on the second
+ * NUMA node, see CALI_MAP_NUMA.  The connect-time load balancer is not patched and always looks up
+ * the primary maps. */
+#define NUMA_REPLICAS_ENABLED	(!CALI_F_CGROUP && CALI_CONFIGURABLE(numa_replicas))
+/* KTIME_COARSE is non-zero if the kernel supports bpf_ktime_get_coarse_ns(), see cali_now().  The
+ * connect-time load balancer is not patched and always reads the fine clock. */
+#define KTIME_COARSE		(!CALI_F_CGROUP && CALI_CONFIGURABLE(ktime_coarse))
+
+/* The vendored libbpf predates bpf_ktime_get_coarse_ns(), kernel 5.11. */
+static __u64 (*bpf_ktime_get_coarse_ns)(void) = (void *) 160;
+
+/* cali_now returns the timestamp for the conntrack and NAT affinity bookkeeping.  Their timeouts are
+ * seconds or more so, where the kernel supports it, it reads the cheaper jiffy-precision clock.  Both
+ * clocks are CLOCK_MONOTONIC so the entries stay comparable with the ones that the fine clock
+ * stamps and with Felix's view of the time; the coarse clock may lag the fine one by a jiffy.  The
+ * programs read it once per packet into cali_tc_state.now.
+ */
+static CALI_BPF_INLINE __u64 cali_now(void)
+{
+	if (KTIME_COARSE) {
+		return bpf_ktime_get_coarse_ns();
+	}
+	return bpf_ktime_get_ns();
+}
 
 #define MAP_PIN_GLOBAL	2
 
@@ -278,5 +407,36 @@ struct bpf_map_def_extended __attribute__((section("maps"))) map_symbol(name, ve
 #define CALI_MAP_V1(name, map_type, key_type, val_type, size, flags, pin) 	\
 		CALI_MAP(name,, map_type, key_type, val_type, size, flags, pin)
 
+/* CALI_MAP_NUMA defines a read-mostly map and its replica, which Felix writes in lockstep and
+ * places on the second NUMA node if NUMA_REPLICAS_ENABLED, see bpf.NUMAReplicatedMap.  The programs
+ * that run on that node look up the replica.  Only Felix writes to such maps so there are no update
+ * or delete functions.  The replica's name must fit in BPF_OBJ_NAME_LEN.
+ */
+#define CALI_MAP_NUMA(name, ver, replica, map_type, key_type, val_type, size, flags, pin)	\
+struct bpf_map_def_extended __attribute__((section("maps"))) map_symbol(name, ver) = {	\
+	.type = map_type,								\
+	.key_size = sizeof(key_type),							\
+	.value_size = sizeof(val_type),							\
+	.map_flags = flags,								\
+	.max_entries = size,								\
+	CALI_MAP_TC_EXT_PIN(pin)							\
+};											\
+struct bpf_map_def_extended __attribute__((section("maps"))) replica = {		\
+	.type = map_type,								\
+	.key_size = sizeof(key_type),							\
+	.value_size = sizeof(val_type),							\
+	.map_flags = flags,								\
+	.max_entries = size,								\
+	CALI_MAP_TC_EXT_PIN(pin)							\
+};											\
+											\
+static CALI_BPF_INLINE void * name##_lookup_elem(const void* key)			\
+{											\
+	if (NUMA_REPLICAS_ENABLED && bpf_get_numa_node_id() == 1) {			\
+		return bpf_map_lookup_elem(&replica, key);				\
+	}										\
+	return bpf_map_lookup_elem(&map_symbol(name, ver), key);			\
+}
+
 
 #endif /* __CALI_BPF_H__ */
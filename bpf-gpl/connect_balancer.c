@@ -30,6 +30,7 @@
 #include "nat.h"
 
 #include "sendrecv.h"
+#include "ctlb_cache.h"
 
 __attribute__((section("calico_connect_v4_noop")))
 int cali_noop_v4(struct bpf_sock_addr *ctx)
@@ -38,37 +39,22 @@ int cali_noop_v4(struct bpf_sock_addr *ctx)
 	return 1;
 }
 
-static CALI_BPF_INLINE void do_nat_common(struct bpf_sock_addr *ctx, __u8 proto)
+/* record_nat records the reverse mappings of a NAT from the destination of the socket to the
+ * backend.  It returns non-zero if the socket should not be NATted as the recvmsg program could not
+ * reverse it.
+ */
+static CALI_BPF_INLINE int record_nat(struct bpf_sock_addr *ctx, __u8 proto,
+				      __be32 be_ip, __u32 be_port, __u64 cookie)
 {
-	/* We do not know what the source address is yet, we only know that it
-	 * is the localhost, so we might just use 0.0.0.0. That would not
-	 * conflict with traffic from elsewhere.
-	 *
-	 * XXX it means that all workloads that use the cgroup hook have the
-	 * XXX same affinity, which (a) is sub-optimal and (b) leaks info between
-	 * XXX workloads.
-	 */
-	nat_lookup_result res = NAT_LOOKUP_ALLOW;
-	__u16 dport_he = (__u16)(bpf_ntohl(ctx->user_port)>>16);
-	struct calico_nat_dest *nat_dest;
-	nat_dest = calico_v4_nat_lookup(0, ctx->user_ip4, proto, dport_he, &res);
-	if (!nat_dest) {
-		CALI_INFO("NAT miss.\n");
-		goto out;
-	}
-
-	__u32 dport_be = host_to_ctx_port(nat_dest->port);
-
-	__u64 cookie = bpf_get_socket_cookie(ctx);
 	CALI_DEBUG("Store: ip=%x port=%d cookie=%x\n",
-			bpf_ntohl(nat_dest->addr), bpf_ntohs((__u16)dport_be), cookie);
+			bpf_ntohl(be_ip), bpf_ntohs((__u16)be_port), cookie);
 
 	/* For all protocols, record recent NAT operations in an LRU map; other BPF programs use this
 	 * cache to reverse our DNAT so they can do pre-DNAT policy. */
 	struct ct_nats_key natk = {
 		.cookie = cookie,
-		.ip = nat_dest->addr,
-		.port = dport_be,
+		.ip = be_ip,
+		.port = be_port,
 		.proto = proto,
 	};
 	struct sendrecv4_val val = {
@@ -76,6 +62,7 @@ static CALI_BPF_INLINE void do_nat_common(struct bpf_sock_addr *ctx, __u8 proto)
 		.port	= ctx->user_port,
 	};
 	int rc = cali_v4_ct_nats_update_elem(&natk, &val, 0);
+	map_stats_update_result(CALI_MAP_STATS_CT_NATS, rc);
 	if (rc) {
 		/* if this happens things are really bad! report */
 		CALI_INFO("Failed to update ct_nats map rc=%d\n", rc);
@@ -84,29 +71,104 @@ static CALI_BPF_INLINE void do_nat_common(struct bpf_sock_addr *ctx, __u8 proto)
 	if (proto != IPPROTO_TCP) {
 		/* For UDP, store a long-lived reverse mapping, which we use to reverse the DNAT for programs that
 		 * check the source on the return packets. */
-		__u64 cookie = bpf_get_socket_cookie(ctx);
-		CALI_DEBUG("Store: ip=%x port=%d cookie=%x\n",
-				bpf_ntohl(nat_dest->addr), bpf_ntohs((__u16)dport_be), cookie);
 		struct sendrecv4_key key = {
-			.ip	= nat_dest->addr,
-			.port	= dport_be,
+			.ip	= be_ip,
+			.port	= be_port,
 			.cookie	= cookie,
 		};
 
-		if (cali_v4_srmsg_update_elem(&key, &val, 0)) {
+		rc = cali_v4_srmsg_update_elem(&key, &val, 0);
+		map_stats_update_result(CALI_MAP_STATS_SRMSG, rc);
+		if (rc) {
 			/* if this happens things are really bad! report */
 			CALI_INFO("Failed to update map\n");
-			goto out;
+			return -1;
 		}
 	}
 
+	return 0;
+}
+
+/* do_nat_common NATs the destination of the socket if it is a service.  If cache is set, it also
+ * caches the outcome for the socket, see ctlb_cache.h.  src is the source address of the socket,
+ * which clients with session affinity are keyed on.
+ */
+static CALI_BPF_INLINE void do_nat_common(struct bpf_sock_addr *ctx, __u8 proto, __be32 src, bool cache)
+{
+	nat_lookup_result res = NAT_LOOKUP_ALLOW;
+	__u64 cookie = bpf_get_socket_cookie(ctx);
+
+	/* Read the generation before the NAT maps so that a concurrent update by Felix can at worst
+	 * invalidate an entry that is up to date. */
+	struct ctlb_cache4_val cached = {
+		.gen = cache ? ctlb_gen() : 0,
+		.ip = ctx->user_ip4,
+		.port = ctx->user_port,
+	};
+
+	__u16 dport_he = (__u16)(bpf_ntohl(ctx->user_port)>>16);
+	struct calico_nat_dest *nat_dest;
+	nat_dest = calico_v4_nat_lookup(src, ctx->user_ip4, proto, dport_he, &res);
+	if (!nat_dest) {
+		CALI_INFO("NAT miss.\n");
+		goto out;
+	}
+
+	__u32 dport_be = host_to_ctx_port(nat_dest->port);
+
+	if (record_nat(ctx, proto, nat_dest->addr, dport_be, cookie)) {
+		return;
+	}
+
+	cached.be_ip = nat_dest->addr;
+	cached.be_port = dport_be;
+
 	ctx->user_ip4 = nat_dest->addr;
 	ctx->user_port = dport_be;
 
 out:
+	if (cache) {
+		cached.refresh_ns = bpf_ktime_get_ns() + CTLB_CACHE_REFRESH_NS;
+		if (cali_v4_ctlb_cache_update_elem(&cookie, &cached, 0)) {
+			CALI_DEBUG("Failed to cache the backend\n");
+		}
+	}
 	return;
 }
 
+/* do_nat_cached NATs the destination of the socket like do_nat_common but it uses the backend that
+ * the socket cached if it is still valid.
+ */
+static CALI_BPF_INLINE void do_nat_cached(struct bpf_sock_addr *ctx, __u8 proto, __be32 src)
+{
+	__u64 cookie = bpf_get_socket_cookie(ctx);
+	struct ctlb_cache4_val *cached = cali_v4_ctlb_cache_lookup_elem(&cookie);
+
+	if (!cached || cached->ip != ctx->user_ip4 || cached->port != ctx->user_port ||
+			cached->gen != ctlb_gen()) {
+		do_nat_common(ctx, proto, src, true);
+		return;
+	}
+
+	if (!cached->be_port) {
+		CALI_DEBUG("Cached: not a service\n");
+		return;
+	}
+
+	__u64 now = bpf_ktime_get_ns();
+	if (now > cached->refresh_ns) {
+		if (record_nat(ctx, proto, cached->be_ip, cached->be_port, cookie)) {
+			return;
+		}
+		cached->refresh_ns = now + CTLB_CACHE_REFRESH_NS;
+	}
+
+	CALI_DEBUG("Cached: ip=%x port=%d\n",
+			bpf_ntohl(cached->be_ip), ctx_port_to_host(cached->be_port));
+	ctx->user_ip4 = cached->be_ip;
+	ctx->user_port = cached->be_port;
+}
+
 __attribute__((section("calico_connect_v4")))
 int cali_ctlb_v4(struct bpf_sock_addr *ctx)
 {
@@ -135,7 +197,11 @@ int cali_ctlb_v4(struct bpf_sock_addr *ctx)
 		goto out;
 	}
 
-	do_nat_common(ctx, ip_proto);
+	/* The socket only has a source address if it is bound.  Otherwise, it gets one as it
+	 * connects and we only know that it is this host, so we use 0.0.0.0, which does not
+	 * conflict with traffic from elsewhere.
+	 */
+	do_nat_common(ctx, ip_proto, ctx->sk->src_ip4, false);
 
 out:
 	return 1;
@@ -152,7 +218,9 @@ int cali_ctlb_sendmsg_v4(struct bpf_sock_addr *ctx)
 		goto out;
 	}
 
-	do_nat_common(ctx, IPPROTO_UDP);
+	/* msg_src_ip4 is the source that the message asks for, if any, see do_nat_common. */
+	__be32 src = ctx->msg_src_ip4 ? : ctx->sk->src_ip4;
+	do_nat_cached(ctx, IPPROTO_UDP, src);
 
 out:
 	return 1;
@@ -1,5 +1,5 @@
 // Project Calico BPF dataplane programs.
-// Copyright (c) 2020 Tigera, Inc. All rights reserved.
+// Copyright (c) 2020-2021 Tigera, Inc. All rights reserved.
 //
 // This program is free software; you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -16,6 +16,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <linux/bpf.h>
+#include <linux/in.h>
 
 // socket_type.h contains the definition of SOCK_XXX constants that we need
 // but it's supposed to be imported via socket.h, which we can't import due
@@ -27,14 +28,186 @@
 
 #include "bpf.h"
 #include "log.h"
+#include "nat6.h"
 
 #include "sendrecv.h"
+#include "ctlb_cache.h"
+
+static CALI_BPF_INLINE bool ctx_ip6_is_v4_mapped(struct bpf_sock_addr *ctx)
+{
+	return ctx->user_ip6[0] == 0 && ctx->user_ip6[1] == 0 &&
+		ctx->user_ip6[2] == bpf_htonl(0x0000ffff);
+}
+
+/* record_nat6 stores the reverse mapping of a UDP NAT, which recvmsg uses to reverse the DNAT for
+ * the return packets.  It returns non-zero if the socket should not be NATted as the reverse
+ * mapping could not be stored.
+ */
+static CALI_BPF_INLINE int record_nat6(struct bpf_sock_addr *ctx, __be32 *be_ip, __u32 be_port,
+				       __u64 cookie)
+{
+	struct sendrecv6_key key = {
+		.ip	= {be_ip[0], be_ip[1], be_ip[2], be_ip[3]},
+		.port	= be_port,
+		.cookie	= cookie,
+	};
+	struct sendrecv6_val val = {
+		.ip	= {ctx->user_ip6[0], ctx->user_ip6[1], ctx->user_ip6[2], ctx->user_ip6[3]},
+		.port	= ctx->user_port,
+	};
+
+	if (cali_v6_srmsg_update_elem(&key, &val, 0)) {
+		/* if this happens things are really bad! report */
+		CALI_INFO("Failed to update map\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static CALI_BPF_INLINE void ctx_set_ip6(struct bpf_sock_addr *ctx, __be32 *ip)
+{
+	ctx->user_ip6[0] = ip[0];
+	ctx->user_ip6[1] = ip[1];
+	ctx->user_ip6[2] = ip[2];
+	ctx->user_ip6[3] = ip[3];
+}
+
+/* do_nat6_common NATs the destination of the socket if it is a service.  If cache is set, it also
+ * caches the outcome for the socket, see ctlb_cache.h.
+ */
+static CALI_BPF_INLINE void do_nat6_common(struct bpf_sock_addr *ctx, __u8 proto, bool cache)
+{
+	nat_lookup_result res = NAT_LOOKUP_ALLOW;
+	__u64 cookie = bpf_get_socket_cookie(ctx);
+	struct calico_nat_v6_key nat_key = {
+		.addr = {ctx->user_ip6[0], ctx->user_ip6[1], ctx->user_ip6[2], ctx->user_ip6[3]},
+		.port = ctx_port_to_host(ctx->user_port),
+		.protocol = proto,
+	};
+
+	/* Read the generation before the NAT maps, like do_nat_common. */
+	struct ctlb_cache6_val cached = {
+		.gen = cache ? ctlb_gen() : 0,
+		.ip = {nat_key.addr[0], nat_key.addr[1], nat_key.addr[2], nat_key.addr[3]},
+		.port = ctx->user_port,
+	};
+
+	struct calico_nat_v6_dest *nat_dest = calico_v6_nat_lookup(&nat_key, &res);
+	if (!nat_dest) {
+		CALI_INFO("NAT6 miss.\n");
+		goto out;
+	}
+
+	__u32 dport_be = host_to_ctx_port(nat_dest->port);
+
+	if (proto != IPPROTO_TCP && record_nat6(ctx, nat_dest->addr, dport_be, cookie)) {
+		return;
+	}
+
+	cached.be_ip[0] = nat_dest->addr[0];
+	cached.be_ip[1] = nat_dest->addr[1];
+	cached.be_ip[2] = nat_dest->addr[2];
+	cached.be_ip[3] = nat_dest->addr[3];
+	cached.be_port = dport_be;
+
+	ctx_set_ip6(ctx, nat_dest->addr);
+	ctx->user_port = dport_be;
+
+out:
+	if (cache) {
+		cached.refresh_ns = bpf_ktime_get_ns() + CTLB_CACHE_REFRESH_NS;
+		if (cali_v6_ctlb_cache_update_elem(&cookie, &cached, 0)) {
+			CALI_DEBUG("Failed to cache the backend\n");
+		}
+	}
+	return;
+}
+
+/* do_nat6_cached is the v6 twin of do_nat_cached, it is only used for UDP. */
+static CALI_BPF_INLINE void do_nat6_cached(struct bpf_sock_addr *ctx)
+{
+	__u64 cookie = bpf_get_socket_cookie(ctx);
+	struct ctlb_cache6_val *cached = cali_v6_ctlb_cache_lookup_elem(&cookie);
+
+	if (!cached || cached->ip[0] != ctx->user_ip6[0] || cached->ip[1] != ctx->user_ip6[1] ||
+			cached->ip[2] != ctx->user_ip6[2] || cached->ip[3] != ctx->user_ip6[3] ||
+			cached->port != ctx->user_port || cached->gen != ctlb_gen()) {
+		do_nat6_common(ctx, IPPROTO_UDP, true);
+		return;
+	}
+
+	if (!cached->be_port) {
+		CALI_DEBUG("Cached: not a service\n");
+		return;
+	}
+
+	__u64 now = bpf_ktime_get_ns();
+	if (now > cached->refresh_ns) {
+		if (record_nat6(ctx, cached->be_ip, cached->be_port, cookie)) {
+			return;
+		}
+		cached->refresh_ns = now + CTLB_CACHE_REFRESH_NS;
+	}
+
+	CALI_DEBUG("Cached: port=%d\n", ctx_port_to_host(cached->be_port));
+	ctx_set_ip6(ctx, cached->be_ip);
+	ctx->user_port = cached->be_port;
+}
+
+__attribute__((section("calico_connect_v6")))
+int cali_ctlb_v6(struct bpf_sock_addr *ctx)
+{
+	CALI_DEBUG("calico_connect_v6\n");
+
+	__u8 ip_proto;
+	switch (ctx->type) {
+	case SOCK_STREAM:
+		CALI_DEBUG("SOCK_STREAM -> assuming TCP\n");
+		ip_proto = IPPROTO_TCP;
+		break;
+	case SOCK_DGRAM:
+		CALI_DEBUG("SOCK_DGRAM -> assuming UDP\n");
+		ip_proto = IPPROTO_UDP;
+		break;
+	default:
+		/* do not process anything non-TCP or non-UDP, but do not block it, will be
+		 * dealt with somewhere else.
+		 */
+		CALI_INFO("unexpected sock type %d\n", ctx->type);
+		goto out;
+	}
+
+	/* v4 services on a dual-stack socket are not balanced at connect time, the TC
+	 * programs deal with them.
+	 */
+	if (ctx_ip6_is_v4_mapped(ctx)) {
+		goto out;
+	}
+
+	do_nat6_common(ctx, ip_proto, false);
+
+out:
+	return 1;
+}
 
 __attribute__((section("calico_sendmsg_v6")))
 int cali_ctlb_sendmsg_v6(struct bpf_sock_addr *ctx)
 {
 	CALI_DEBUG("sendmsg_v6\n");
 
+	if (ctx->type != SOCK_DGRAM) {
+		CALI_INFO("unexpected sock type %d\n", ctx->type);
+		goto out;
+	}
+
+	if (ctx_ip6_is_v4_mapped(ctx)) {
+		goto out;
+	}
+
+	do_nat6_cached(ctx);
+
+out:
 	return 1;
 }
 
@@ -51,12 +224,35 @@ int cali_ctlb_recvmsg_v6(struct bpf_sock_addr *ctx)
 			ctx->user_ip6[3]);
 
 	/* check if it is a IPv4 mapped as IPv6 and if so, use the v4 table */
-	if (ctx->user_ip6[0] == 0 && ctx->user_ip6[1] == 0 &&
-			ctx->user_ip6[2] == bpf_htonl(0x0000ffff)) {
+	if (ctx_ip6_is_v4_mapped(ctx)) {
 		goto v4;
 	}
 
-	CALI_DEBUG("recvmsg_v6: not implemented for v6 yet\n");
+	if (ctx->type != SOCK_DGRAM) {
+		CALI_INFO("unexpected sock type %d\n", ctx->type);
+		goto out;
+	}
+
+	struct sendrecv6_key key6 = {
+		.ip	= {ctx->user_ip6[0], ctx->user_ip6[1], ctx->user_ip6[2], ctx->user_ip6[3]},
+		.port	= ctx->user_port,
+		.cookie	= bpf_get_socket_cookie(ctx),
+	};
+
+	struct sendrecv6_val *revnat6 = cali_v6_srmsg_lookup_elem(&key6);
+
+	if (revnat6 == NULL) {
+		CALI_DEBUG("revnat6 miss for port %d\n", ctx_port_to_host(ctx->user_port));
+		/* same as for v4 below, no mapping is not an error */
+		goto out;
+	}
+
+	ctx->user_ip6[0] = revnat6->ip[0];
+	ctx->user_ip6[1] = revnat6->ip[1];
+	ctx->user_ip6[2] = revnat6->ip[2];
+	ctx->user_ip6[3] = revnat6->ip[3];
+	ctx->user_port = revnat6->port;
+	CALI_DEBUG("recvmsg_v6 rev nat to port %d\n", ctx_port_to_host(ctx->user_port));
 	goto out;
 
 
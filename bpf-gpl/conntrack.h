@@ -23,6 +23,7 @@
 #include "bpf.h"
 #include "icmp.h"
 #include "types.h"
+#include "map_stats.h"
 
 // Connection tracking.
 
@@ -45,6 +46,87 @@
 
 #define ct_result_np_node(res)		((res).flags & CALI_CT_FLAG_NP_FWD)
 
+/* CALI_CT_LAST_SEEN_GRANULARITY is the minimum time between updates of a conntrack entry's last_seen
+ * timestamp.  Writing the timestamp on every packet dirties the entry's cache line for every packet of
+ * an established flow, which then bounces between the CPUs that handle the two directions of the flow.
+ * The conntrack cleanup timeouts are all several seconds or more so a coarse timestamp is enough.
+ */
+#ifndef CALI_CT_LAST_SEEN_GRANULARITY
+#define CALI_CT_LAST_SEEN_GRANULARITY	1000000000ull /* 1s */
+#endif
+
+static CALI_BPF_INLINE void ct_touch(struct calico_ct_value *v, __u64 now)
+{
+	/* Signed, in case last_seen came from the other clock, see cali_now(). */
+	if ((__s64)(now - v->last_seen) >= (__s64)CALI_CT_LAST_SEEN_GRANULARITY) {
+		v->last_seen = now;
+	}
+}
+
+struct calico_ct_acct_leg {
+	__u64 packets;
+	__u64 bytes;
+};
+
+/* struct calico_ct_acct holds the packet and byte counts of a flow, per leg, see ct_acct_update().
+ * WARNING: must be kept in sync with Usage in bpf/conntrack/accounting.go.
+ */
+struct calico_ct_acct {
+	struct calico_ct_acct_leg a_to_b;
+	struct calico_ct_acct_leg b_to_a;
+};
+
+/* cali_v4_ct_acct is keyed on the key of the conntrack entry that holds the legs of the flow: its
+ * NORMAL or its NAT_REV entry.  It is an LRU map, sized like the conntrack map, so the counts of
+ * the flows that are gone age out on their own.
+ * WARNING: must be kept in sync with AcctMapParams in bpf/conntrack/accounting.go.
+ */
+CALI_MAP_V1(cali_v4_ct_acct,
+		BPF_MAP_TYPE_LRU_HASH,
+		struct calico_ct_key, struct calico_ct_acct,
+		512000, 0, MAP_PIN_GLOBAL)
+
+/* ct_acct_update counts a packet of len bytes in the a_to_b or b_to_a leg of the flow with the
+ * tracking key k.  The entries are shared between the CPUs, like the conntrack entries, but each
+ * leg of a flow is mostly handled by one CPU so the adds rarely contend.
+ */
+static CALI_BPF_INLINE void ct_acct_update(struct calico_ct_key *k, bool a_to_b, __u64 len)
+{
+	struct calico_ct_acct *acct = cali_v4_ct_acct_lookup_elem(k);
+
+	if (!acct) {
+		struct calico_ct_acct init = {};
+		struct calico_ct_acct_leg *leg = a_to_b ? &init.a_to_b : &init.b_to_a;
+
+		leg->packets = 1;
+		leg->bytes = len;
+		if (!cali_v4_ct_acct_update_elem(k, &init, BPF_NOEXIST)) {
+			return;
+		}
+		/* Lost the race with another CPU. */
+		acct = cali_v4_ct_acct_lookup_elem(k);
+		if (!acct) {
+			return;
+		}
+	}
+
+	struct calico_ct_acct_leg *leg = a_to_b ? &acct->a_to_b : &acct->b_to_a;
+	__sync_fetch_and_add(&leg->packets, 1);
+	__sync_fetch_and_add(&leg->bytes, len);
+}
+
+/* ct_acct_should_count returns true if this program is the first one to see the packet, which then
+ * counts it, so that each packet is counted once.  The XDP program only counts the packets that it
+ * forwards itself; it passes the rest to the TC program.
+ */
+static CALI_BPF_INLINE bool ct_acct_should_count(struct cali_tc_ctx *ctx)
+{
+	if (!CT_ACCT_ENABLED || CALI_F_XDP) {
+		return false;
+	}
+	return CALI_F_TO_HOST || !skb_seen(ctx->skb);
+}
+
 static CALI_BPF_INLINE void dump_ct_key(struct calico_ct_key *k)
 {
 	CALI_VERB("CT-ALL   key A=%x:%d proto=%d\n", bpf_ntohl(k->addr_a), k->port_a, (int)k->protocol);
@@ -52,7 +134,8 @@ static CALI_BPF_INLINE void dump_ct_key(struct calico_ct_key *k)
 }
 
 static CALI_BPF_INLINE int calico_ct_v4_create_tracking(struct ct_create_ctx *ct_ctx,
-							struct calico_ct_key *k)
+							struct calico_ct_key *k,
+							__u64 now)
 {
 	__be32 ip_src = ct_ctx->src;
 	__be32 ip_dst = ct_ctx->dst;
@@ -65,7 +148,6 @@ static CALI_BPF_INLINE int calico_ct_v4_create_tracking(struct ct_create_ctx *ct
 
 	__be32 seq = 0;
 	bool syn = false;
-	__u64 now;
 
 	if (ct_ctx->tcp) {
 		seq = ct_ctx->tcp->seq;
@@ -112,7 +194,6 @@ static CALI_BPF_INLINE int calico_ct_v4_create_tracking(struct ct_create_ctx *ct
 	}
 
 create:
-	now = bpf_ktime_get_ns();
 	CALI_DEBUG("CT-ALL Creating tracking entry type %d at %llu.\n", ct_ctx->type, now);
 
 	struct calico_ct_value ct_value = {
@@ -137,6 +218,8 @@ create:
 				goto out;
 			}
 			CALI_DEBUG("CT-ALL nat tunneled from %x\n", bpf_ntohl(ct_ctx->tun_ip));
+			/* The return packets go back through the tunnel to the same next hop. */
+			ct_value.tun_nh = ct_ctx->tun_nh;
 		}
 		ct_value.tun_ip = ct_ctx->tun_ip;
 	}
@@ -169,6 +252,15 @@ create:
 	src_to_dst->seqno = seq;
 	src_to_dst->syn_seen = syn;
 	src_to_dst->opener = 1;
+	if (ct_ctx->tcp && ct_ctx->tcp->ack && !syn) {
+		/* Only an ACK that carries a valid SYN cookie opens a flow, see syncookie.h.  The
+		 * handshake is complete; the cookie was the listener's initial sequence number. */
+		src_to_dst->syn_seen = 1;
+		src_to_dst->ack_seen = 1;
+		dst_to_src->syn_seen = 1;
+		dst_to_src->ack_seen = 1;
+		dst_to_src->seqno = bpf_htonl(bpf_ntohl(ct_ctx->tcp->ack_seq) - 1);
+	}
 	if (CALI_F_TO_HOST) {
 		src_to_dst->ifindex = skb_ingress_ifindex(ct_ctx->skb);
 	} else {
@@ -200,7 +292,29 @@ create:
 		CALI_DEBUG("CT-ALL Whitelisted dest side - to EP\n");
 	}
 
-	err = cali_v4_ct_update_elem(k, &ct_value, 0);
+	__u64 update_flags = 0;
+	if (ct_ctx->flags & CALI_CT_FLAG_SNAT) {
+		/* The host endpoint programs only see the flow with the host's address, like with
+		 * iptables MASQUERADE, the workload's policy approves both directions.
+		 */
+		dst_to_src->whitelisted = 1;
+		/* The entry holds the allocated port, don't take it from another flow, see snat.h. */
+		update_flags = BPF_NOEXIST;
+	}
+
+	err = cali_v4_ct_update_elem(k, &ct_value, update_flags);
+	map_stats_update_result(CALI_MAP_STATS_CT, err);
+	if (!err && CT_ACCT_ENABLED && !CALI_F_XDP) {
+		/* Start from zero, rather than from the counts of a previous flow with the same
+		 * tuple, and count the packet that opened the flow.
+		 */
+		struct calico_ct_acct acct = {};
+		struct calico_ct_acct_leg *leg = srcLTDest ? &acct.a_to_b : &acct.b_to_a;
+
+		leg->packets = 1;
+		leg->bytes = ct_ctx->skb->len;
+		cali_v4_ct_acct_update_elem(k, &acct, 0);
+	}
 
 out:
 	CALI_VERB("CT-ALL Create result: %d.\n", err);
@@ -208,7 +322,8 @@ out:
 }
 
 static CALI_BPF_INLINE int calico_ct_v4_create_nat_fwd(struct ct_create_ctx *ct_ctx,
-						       struct calico_ct_key *rk)
+						       struct calico_ct_key *rk,
+						       __u64 now)
 {
 	__u8 ip_proto = ct_ctx->proto;
 	__be32 ip_src = ct_ctx->src;
@@ -216,8 +331,6 @@ static CALI_BPF_INLINE int calico_ct_v4_create_nat_fwd(struct ct_create_ctx *ct_
 	__u16 sport = ct_ctx->sport;
 	__u16 dport = ct_ctx->orig_dport;
 
-	__u64 now = bpf_ktime_get_ns();
-
 	CALI_DEBUG("CT-%d Creating FWD entry at %llu.\n", ip_proto, now);
 	struct calico_ct_value ct_value = {
 		.type = CALI_CT_TYPE_NAT_FWD,
@@ -225,6 +338,17 @@ static CALI_BPF_INLINE int calico_ct_v4_create_nat_fwd(struct ct_create_ctx *ct_
 		.created = now,
 	};
 
+	if (ct_ctx->flags & CALI_CT_FLAG_SNAT) {
+		/* The source is translated rather than the destination, the entry is keyed on the
+		 * workload, which is in orig_dst, and the remote side, see snat.h.
+		 */
+		ip_src = ct_ctx->orig_dst;
+		sport = ct_ctx->orig_dport;
+		ip_dst = ct_ctx->dst;
+		dport = ct_ctx->dport;
+		ct_value.flags = CALI_CT_FLAG_SNAT;
+	}
+
 	struct calico_ct_key k;
 
 	if ((ip_src < ip_dst) || ((ip_src == ip_dst) && sport < dport)) {
@@ -244,10 +368,39 @@ static CALI_BPF_INLINE int calico_ct_v4_create_nat_fwd(struct ct_create_ctx *ct_
 	dump_ct_key(&k);
 	ct_value.nat_rev_key = *rk;
 	int err = cali_v4_ct_update_elem(&k, &ct_value, 0);
+	map_stats_update_result(CALI_MAP_STATS_CT, err);
 	CALI_VERB("CT-%d Create result: %d.\n", ip_proto, err);
 	return err;
 }
 
+/* ct_lru_touch_nat_fwd looks up the NAT_FWD entry that belongs to the NAT_REV entry v, stored
+ * under key k.  In an LRU map, only the entries that are looked up count as recently used and reply
+ * packets only hit the NAT_REV entry.  Without this, the NAT_FWD entry of a flow that only has
+ * traffic in the reply direction could be evicted while its NAT_REV entry is still in use.
+ */
+static CALI_BPF_INLINE void ct_lru_touch_nat_fwd(struct calico_ct_key *k, struct calico_ct_value *v)
+{
+	__be32 client_ip;
+	__u16 client_port;
+	/* The NAT_FWD entry of an SNATed flow is keyed on the remote side rather than the opener. */
+	bool a = !(v->flags & CALI_CT_FLAG_SNAT);
+
+	if (v->a_to_b.opener) {
+		client_ip = a ? k->addr_a : k->addr_b;
+		client_port = a ? k->port_a : k->port_b;
+	} else if (v->b_to_a.opener) {
+		client_ip = a ? k->addr_b : k->addr_a;
+		client_port = a ? k->port_b : k->port_a;
+	} else {
+		return;
+	}
+
+	bool sltd = src_lt_dest(client_ip, v->orig_ip, client_port, v->orig_port);
+	struct calico_ct_key fwd_k = ct_make_key(sltd, k->protocol,
+			client_ip, v->orig_ip, client_port, v->orig_port);
+	cali_v4_ct_lookup_elem(&fwd_k);
+}
+
 /* skb_icmp_err_unpack tries to unpack the inner IP and TCP/UDP header from an ICMP error message.
  * It updates the ct_ctx with the protocol/src/dst/ports of the inner packet.  If the unpack fails
  * (due to packet too short, for example), it returns false and sets the RC in the cali_tc_ctx to
@@ -369,6 +522,63 @@ static CALI_BPF_INLINE void ct_tcp_entry_update(struct tcphdr *tcp_header,
 	}
 }
 
+/* calico_ct_v4_create_uplifted creates a tracking entry for a mid-flow TCP connection that Linux
+ * conntrack has accepted but that we have no record of, for example, because the connection
+ * predates the BPF programs.  Without it, every packet of such a connection that enters the host
+ * misses and falls through to iptables, for the whole lifetime of the connection.
+ *
+ * We didn't see the handshake, so we don't know which side opened the connection.  The host stack
+ * has accepted the flow in both directions, so both legs are whitelisted and marked as
+ * established.  Linux conntrack may hold NAT state for the flow (e.g. from kube-proxy before the
+ * switch to BPF mode), so the packets must keep going through the host IP stack rather than being
+ * forwarded by FIB.
+ */
+static CALI_BPF_INLINE void calico_ct_v4_create_uplifted(struct calico_ct_key *k, __u64 now)
+{
+	struct calico_ct_value ct_value = {
+		.created = now,
+		.last_seen = now,
+		.type = CALI_CT_TYPE_NORMAL,
+		.flags = CALI_CT_FLAG_SKIP_FIB,
+	};
+
+	ct_value.a_to_b.syn_seen = 1;
+	ct_value.a_to_b.ack_seen = 1;
+	ct_value.a_to_b.whitelisted = 1;
+	ct_value.b_to_a.syn_seen = 1;
+	ct_value.b_to_a.ack_seen = 1;
+	ct_value.b_to_a.whitelisted = 1;
+
+	/* Don't overwrite an entry that a packet in the other direction may have raced to create. */
+	int err = cali_v4_ct_update_elem(k, &ct_value, BPF_NOEXIST);
+	CALI_DEBUG("CT-ALL Created tracking entry for uplifted flow: %d\n", err);
+}
+
+/* ct_tun_nh_refresh records the MACs of the tunnel next hop in the NAT_REV entry of a flow that
+ * arrives through the VXLAN tunnel from another node, so that its return packets can be sent
+ * straight back through the tunnel, see forward_or_drop().  The entry is only written when the
+ * MACs change, so the tunnelled packets don't write to a map for every packet.
+ */
+static CALI_BPF_INLINE void ct_tun_nh_refresh(struct cali_tc_ctx *tc_ctx, struct calico_ct_value *v)
+{
+	struct calico_ct_tun_nh nh;
+
+	if (!CALI_F_FROM_HEP || !tc_ctx->state->tun_ip || tc_ctx->state->tun_ip != v->tun_ip ||
+			(v->flags & CALI_CT_FLAG_NP_FWD)) {
+		return;
+	}
+	if (tc_ctx->data_start + sizeof(struct ethhdr) > tc_ctx->data_end) {
+		return;
+	}
+
+	/* The eth header is dst:src, which are the src:dst of the return packets. */
+	__builtin_memcpy(&nh, tc_ctx->eth, sizeof(nh));
+	if (!ct_tun_nh_equal(&nh, &v->tun_nh)) {
+		CALI_CT_DEBUG("Updating tunnel next hop MACs\n");
+		v->tun_nh = nh;
+	}
+}
+
 static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_tc_ctx *tc_ctx)
 {
 	// TODO: refactor the conntrack code to simply use the tc_ctx instead of its own.  This
@@ -432,10 +642,14 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 			CALI_DEBUG("BPF CT Miss for mid-flow TCP\n");
 			if ((tc_ctx->skb->mark & CALI_SKB_MARK_CT_ESTABLISHED_MASK) == CALI_SKB_MARK_CT_ESTABLISHED) {
 				// Linux Conntrack has marked the packet as part of an established flow.
-				// TODO-HEP Create a tracking entry for uplifted flow so that we handle the reverse traffic more efficiently.
-				 CALI_DEBUG("BPF CT Miss but have Linux CT entry: established\n");
-				 result.rc = CALI_CT_ESTABLISHED;
-				 return result;
+				CALI_DEBUG("BPF CT Miss but have Linux CT entry: established\n");
+				if (CALI_F_HEP && tcp_header && !tcp_header->fin && !tcp_header->rst) {
+					// Uplift the flow so that we handle the reverse traffic more efficiently.
+					// There is no point for a connection that is closing.
+					calico_ct_v4_create_uplifted(&k, tc_ctx->state->now);
+				}
+				result.rc = CALI_CT_ESTABLISHED;
+				return result;
 			}
 			CALI_DEBUG("BPF CT Miss but Linux CT entry not signalled\n");
 			result.rc = CALI_CT_MID_FLOW_MISS;
@@ -481,8 +695,11 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 				ct_ctx->proto == IPPROTO_TCP &&
 				(tc_ctx->skb->mark & CALI_SKB_MARK_CT_ESTABLISHED_MASK) == CALI_SKB_MARK_CT_ESTABLISHED) {
 				// Linux Conntrack has marked the packet as part of a known flow.
-				// TODO-HEP Create a tracking entry for uplifted flow so that we handle the reverse traffic more efficiently.
 				CALI_DEBUG("BPF CT related miss but have Linux CT entry: established\n");
+				if (CALI_F_HEP) {
+					// Uplift the flow so that we handle the reverse traffic more efficiently.
+					calico_ct_v4_create_uplifted(&k, tc_ctx->state->now);
+				}
 				result.rc = CALI_CT_ESTABLISHED;
 				return result;
 			}
@@ -513,8 +730,8 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 		// updated to describe the inner packet.
 	}
 
-	__u64 now = bpf_ktime_get_ns();
-	v->last_seen = now;
+	__u64 now = tc_ctx->state->now;
+	ct_touch(v, now);
 
 	result.flags = v->flags;
 
@@ -526,8 +743,12 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 	}
 
 	struct calico_ct_leg *src_to_dst, *dst_to_src;
+	/* The key of the entry with the legs, and the leg of the packet, for ct_acct_update(). */
+	struct calico_ct_key *acct_key = &k;
+	bool acct_a_to_b = srcLTDest;
 
 	struct calico_ct_value *tracking_v;
+	bool bypass_dnat = false;
 	switch (v->type) {
 	case CALI_CT_TYPE_NAT_FWD:
 		// This is a forward NAT entry; since we do the bookkeeping on the
@@ -539,9 +760,21 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 			goto out_lookup_fail;
 		}
 		// Record timestamp.
-		tracking_v->last_seen = now;
+		ct_touch(tracking_v, now);
+
+		acct_key = &v->nat_rev_key;
+		acct_a_to_b = ip_src == v->nat_rev_key.addr_a && sport == v->nat_rev_key.port_a;
+
+		/* The packets that leave the workload of an SNATed flow come from neither side of the
+		 * NAT_REV key, they are from the SNAT side, the one that isn't their destination.
+		 */
+		bool snat_from_wep = (tracking_v->flags & CALI_CT_FLAG_SNAT) && !acct_a_to_b &&
+			!(ip_src == v->nat_rev_key.addr_b && sport == v->nat_rev_key.port_b);
+		if (snat_from_wep) {
+			acct_a_to_b = ip_dst == v->nat_rev_key.addr_b && dport == v->nat_rev_key.port_b;
+		}
 
-		if (ip_src == v->nat_rev_key.addr_a && sport == v->nat_rev_key.port_a) {
+		if (acct_a_to_b) {
 			CALI_VERB("CT-ALL FWD-REV src_to_dst A->B\n");
 			src_to_dst = &tracking_v->a_to_b;
 			dst_to_src = &tracking_v->b_to_a;
@@ -556,16 +789,29 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 		}
 		result.tun_ip = tracking_v->tun_ip;
 		CALI_CT_DEBUG("fwd tun_ip:%x\n", bpf_ntohl(tracking_v->tun_ip));
+		ct_tun_nh_refresh(tc_ctx, tracking_v);
 		// flags are in the tracking entry
 		result.flags = tracking_v->flags;
 
-		if (ct_ctx->proto == IPPROTO_ICMP) {
+		if (tracking_v->flags & CALI_CT_FLAG_SNAT) {
+			if (CALI_F_TO_HOST && snat_from_wep) {
+				/* Leaving the workload, translate the source to the SNAT side. */
+				result.rc =	CALI_CT_ESTABLISHED_SNAT;
+				result.nat_ip = acct_a_to_b ? v->nat_rev_key.addr_a : v->nat_rev_key.addr_b;
+				result.nat_port = acct_a_to_b ? v->nat_rev_key.port_a : v->nat_rev_key.port_b;
+			} else {
+				result.rc =	CALI_CT_ESTABLISHED;
+			}
+		} else if (ct_ctx->proto == IPPROTO_ICMP) {
 			result.rc =	CALI_CT_ESTABLISHED_DNAT;
 			result.nat_ip = tracking_v->orig_ip;
 		} else if (CALI_F_TO_HOST) {
 			// Since we found a forward NAT entry, we know that it's the destination
 			// that needs to be NATted.
 			result.rc =	CALI_CT_ESTABLISHED_DNAT;
+			// The program of the workload behind the NAT would look up the tracking
+			// entry once more only to find it approved; see CALI_CT_BYPASS_DNAT.
+			bypass_dnat = CALI_F_FROM_WEP && src_to_dst->whitelisted && dst_to_src->whitelisted;
 		} else {
 			result.rc =	CALI_CT_ESTABLISHED;
 		}
@@ -593,9 +839,35 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 
 		result.tun_ip = v->tun_ip;
 		CALI_CT_DEBUG("tun_ip:%x\n", bpf_ntohl(v->tun_ip));
+		/* The MACs are only valid on the device that the tunnel packets arrive through,
+		 * which is where a workload's return packets are redirected to. */
+		if (v->tun_ip && (CALI_F_TO_HOST ||
+				(CALI_F_TO_HEP && dst_to_src->ifindex == tc_ctx->skb->ifindex))) {
+			tc_ctx->tun_nh = v->tun_nh;
+		}
 
 		result.flags = v->flags;
 
+		if (CT_MAP_LRU) {
+			ct_lru_touch_nat_fwd(&k, v);
+		}
+
+		if (v->flags & CALI_CT_FLAG_SNAT) {
+			/* A flow that we SNATed on its way out of a workload.  Its replies, and the ICMP
+			 * errors about it, arrive at the host addressed to the SNAT side, which opened
+			 * the flow; translate their destination back to the workload as they enter.
+			 */
+			if (CALI_F_TO_HOST && (related ? src_to_dst->opener : dst_to_src->opener)) {
+				CALI_CT_DEBUG("Hit! NAT REV entry of SNATed flow towards opener: DNAT.\n");
+				result.rc =	CALI_CT_ESTABLISHED_DNAT;
+				result.nat_ip = v->orig_ip;
+				result.nat_port = v->orig_port;
+			} else {
+				result.rc =	CALI_CT_ESTABLISHED;
+			}
+			break;
+		}
+
 		if (ct_ctx->proto == IPPROTO_ICMP || (related && proto_orig == IPPROTO_ICMP)) {
 			result.rc =	CALI_CT_ESTABLISHED_SNAT;
 			result.nat_ip = v->orig_ip;
@@ -737,7 +1009,7 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 		ct_tcp_entry_update(tcp_header, src_to_dst, dst_to_src);
 	}
 
-	__u32 ifindex = skb_ingress_ifindex(tc_ctx->skb);
+	__u32 ifindex = ctx_ingress_ifindex(tc_ctx);
 
 	if (src_to_dst->ifindex != ifindex) {
 		// Conntrack entry records a different ingress interface than the one the
@@ -772,6 +1044,10 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 		}
 	}
 
+	if (bypass_dnat && !related && !ct_result_rpf_failed(result.rc)) {
+		ct_result_set_flag(result.rc, CALI_CT_BYPASS_DNAT);
+	}
+
 	if (CALI_F_TO_HOST) {
 		/* Fill in the ifindex we recorded in the opposite direction. The caller
 		 * may use it directly forward the packet to the same interface where
@@ -782,6 +1058,10 @@ static CALI_BPF_INLINE struct calico_ct_result calico_ct_v4_lookup(struct cali_t
 
 	CALI_CT_DEBUG("result: %d\n", result.rc);
 
+	if (!related && ct_acct_should_count(tc_ctx)) {
+		ct_acct_update(acct_key, acct_a_to_b, tc_ctx->skb->len);
+	}
+
 	if (related) {
 		ct_result_set_flag(result.rc, CALI_CT_RELATED);
 		CALI_CT_DEBUG("result: related\n");
@@ -808,15 +1088,18 @@ static CALI_BPF_INLINE int conntrack_create(struct cali_tc_ctx *ctx, struct ct_c
 	// Workaround for verifier; make sure verifier sees the skb on all code paths.
 	ct_ctx->skb = ctx->skb;
 
-	err = calico_ct_v4_create_tracking(ct_ctx, &k);
+	err = calico_ct_v4_create_tracking(ct_ctx, &k, ctx->state->now);
 	if (err) {
 		return err;
 	}
 
 	if (ct_ctx->type == CALI_CT_TYPE_NAT_REV) {
-		err = calico_ct_v4_create_nat_fwd(ct_ctx, &k);
+		err = calico_ct_v4_create_nat_fwd(ct_ctx, &k, ctx->state->now);
 		if (err) {
-			/* XXX we should clean up the tracking entry */
+			/* Don't leave a NAT_REV entry without its NAT_FWD entry behind; the
+			 * flow's next packet will try to create both again.
+			 */
+			cali_v4_ct_delete_elem(&k);
 		}
 	}
 
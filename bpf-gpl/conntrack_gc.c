@@ -0,0 +1,197 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <linux/bpf.h>
+#include <linux/in.h>
+
+#include <stdbool.h>
+
+#include "bpf.h"
+#include "log.h"
+#include "conntrack_types.h"
+
+/* In-kernel conntrack cleanup.  This is a map element iterator over the conntrack map that
+ * deletes the expired entries in place, so that Felix does not have to copy the whole table to
+ * userspace to find them.  It must be kept in sync with Timeouts.EntryExpired and
+ * LivenessScanner in bpf/conntrack/cleanup.go, which remain the fallback on kernels that cannot
+ * load it.
+ */
+
+/* The timeouts, in seconds, patched in by conntrack.PatchGCBinary. */
+CALI_CONFIGURABLE_DEFINE(ct_grace, 0x50475443) /* be 0x50475443 = ASCII(CTGP) */
+CALI_CONFIGURABLE_DEFINE(ct_tcp_pre_est, 0x45505443) /* be 0x45505443 = ASCII(CTPE) */
+CALI_CONFIGURABLE_DEFINE(ct_tcp_est, 0x53455443) /* be 0x53455443 = ASCII(CTES) */
+CALI_CONFIGURABLE_DEFINE(ct_tcp_fins, 0x4e465443) /* be 0x4e465443 = ASCII(CTFN) */
+CALI_CONFIGURABLE_DEFINE(ct_tcp_rst, 0x53525443) /* be 0x53525443 = ASCII(CTRS) */
+CALI_CONFIGURABLE_DEFINE(ct_udp, 0x44555443) /* be 0x44555443 = ASCII(CTUD) */
+CALI_CONFIGURABLE_DEFINE(ct_generic, 0x4e475443) /* be 0x4e475443 = ASCII(CTGN) */
+CALI_CONFIGURABLE_DEFINE(ct_icmp, 0x43495443) /* be 0x43495443 = ASCII(CTIC) */
+
+#define CT_TIMEOUT(name)	((__u64)CALI_CONFIGURABLE(name) * 1000000000ull)
+
+/* The context of the bpf_map_elem iterator, it is only defined in the kernel's internal
+ * headers.  Each field is a pointer padded out to 64 bits like __bpf_md_ptr().
+ */
+#define __cali_md_ptr(type, name)	\
+union {					\
+	type name;			\
+	__u64 :64;			\
+} __attribute__((aligned(8)))
+
+struct bpf_iter__bpf_map_elem {
+	__cali_md_ptr(void *, meta);
+	__cali_md_ptr(void *, map);
+	__cali_md_ptr(void *, key);
+	__cali_md_ptr(void *, value);
+};
+
+static CALI_BPF_INLINE bool ct_gc_tcp_established(struct calico_ct_value *v)
+{
+	return v->a_to_b.syn_seen && v->a_to_b.ack_seen && v->b_to_a.syn_seen && v->b_to_a.ack_seen;
+}
+
+/* ct_gc_expired mirrors Timeouts.EntryExpired. */
+static CALI_BPF_INLINE bool ct_gc_expired(__u64 now, __u32 proto, struct calico_ct_value *v)
+{
+	if (now - v->created < CT_TIMEOUT(ct_grace)) {
+		return false;
+	}
+
+	__u64 age = now - v->last_seen;
+
+	switch (proto) {
+	case IPPROTO_TCP:
+	{
+		bool dsr = v->flags & CALI_CT_FLAG_DSR_FWD;
+
+		if ((v->a_to_b.rst_seen || v->b_to_a.rst_seen) && age > CT_TIMEOUT(ct_tcp_rst)) {
+			return true;
+		}
+		bool fins_seen = (v->a_to_b.fin_seen && v->b_to_a.fin_seen) ||
+			(dsr && (v->a_to_b.fin_seen || v->b_to_a.fin_seen));
+		if (fins_seen && age > CT_TIMEOUT(ct_tcp_fins)) {
+			return true;
+		}
+		if (ct_gc_tcp_established(v) || dsr) {
+			return age > CT_TIMEOUT(ct_tcp_est);
+		}
+		return age > CT_TIMEOUT(ct_tcp_pre_est);
+	}
+	case IPPROTO_ICMP:
+		return age > CT_TIMEOUT(ct_icmp);
+	case IPPROTO_UDP:
+		return age > CT_TIMEOUT(ct_udp);
+	default:
+		return age > CT_TIMEOUT(ct_generic);
+	}
+}
+
+/* ct_gc_delete_nat_fwd deletes the NAT_FWD entry that belongs to the NAT_REV entry v, stored
+ * under key k.  The key is derived the same way as in ct_lru_touch_nat_fwd().
+ */
+static CALI_BPF_INLINE void ct_gc_delete_nat_fwd(struct calico_ct_key *k, struct calico_ct_value *v)
+{
+	struct calico_ct_key fwd_k = { .protocol = k->protocol };
+	__be32 client_ip;
+	__u16 client_port;
+
+	if (v->a_to_b.opener) {
+		client_ip = k->addr_a;
+		client_port = k->port_a;
+	} else if (v->b_to_a.opener) {
+		client_ip = k->addr_b;
+		client_port = k->port_b;
+	} else {
+		return;
+	}
+
+	if (client_ip < v->orig_ip || (client_ip == v->orig_ip && client_port < v->orig_port)) {
+		fwd_k.addr_a = client_ip;
+		fwd_k.port_a = client_port;
+		fwd_k.addr_b = v->orig_ip;
+		fwd_k.port_b = v->orig_port;
+	} else {
+		fwd_k.addr_a = v->orig_ip;
+		fwd_k.port_a = v->orig_port;
+		fwd_k.addr_b = client_ip;
+		fwd_k.port_b = client_port;
+	}
+
+	cali_v4_ct_delete_elem(&fwd_k);
+}
+
+/* Unlike the userspace scanner, which may only delete the entry that it is visiting, the iterator
+ * walks the hash buckets under RCU and so it can delete both halves of a NAT pair as soon as it
+ * finds either of them expired.
+ */
+__attribute__((section("iter/bpf_map_elem")))
+int calico_conntrack_gc(struct bpf_iter__bpf_map_elem *ctx)
+{
+	struct calico_ct_value *v = ctx->value;
+	struct calico_ct_key rev_k;
+	struct calico_ct_value *rev_v;
+	__u64 now;
+
+	if (!ctx->key || !v) {
+		/* End of iteration. */
+		return 0;
+	}
+
+	/* The map helpers only take keys on the stack, not the iterator's read-only buffer. */
+	struct calico_ct_key key = *(struct calico_ct_key *)ctx->key;
+	struct calico_ct_key *k = &key;
+
+	now = bpf_ktime_get_ns();
+
+	switch (v->type) {
+	case CALI_CT_TYPE_NAT_FWD:
+		/* The book-keeping is in the reverse entry. */
+		rev_k = v->nat_rev_key;
+		rev_v = cali_v4_ct_lookup_elem(&rev_k);
+		if (!rev_v) {
+			/* The BPF programs always create the NAT_REV entry before the NAT_FWD entry
+			 * so this one is orphaned and useless on its own.
+			 */
+			CALI_DEBUG("CT GC: NAT_FWD without NAT_REV, deleting\n");
+			cali_v4_ct_delete_elem(k);
+			break;
+		}
+		if (ct_gc_expired(now, k->protocol, rev_v)) {
+			CALI_DEBUG("CT GC: expired NAT pair (fwd), deleting\n");
+			cali_v4_ct_delete_elem(&rev_k);
+			cali_v4_ct_delete_elem(k);
+		}
+		break;
+	case CALI_CT_TYPE_NAT_REV:
+		if (ct_gc_expired(now, k->protocol, v)) {
+			CALI_DEBUG("CT GC: expired NAT pair (rev), deleting\n");
+			ct_gc_delete_nat_fwd(k, v);
+			cali_v4_ct_delete_elem(k);
+		}
+		break;
+	case CALI_CT_TYPE_NORMAL:
+		if (ct_gc_expired(now, k->protocol, v)) {
+			CALI_DEBUG("CT GC: expired entry, deleting\n");
+			cali_v4_ct_delete_elem(k);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+char ____license[] __attribute__((section("license"), used)) = "GPL";
@@ -40,7 +40,7 @@ enum cali_ct_type {
 #define CALI_CT_FLAG_DSR_FWD	0x02 /* marks entry into the tunnel on the fwd node when dsr */
 #define CALI_CT_FLAG_NP_FWD	0x04 /* marks entry into the tunnel on the fwd node */
 #define CALI_CT_FLAG_SKIP_FIB	0x08 /* marks traffic that should pass through host IP stack */
-#define CALI_CT_FLAG_RES_0x10	0x10 /* reserved */
+#define CALI_CT_FLAG_SNAT	0x10 /* marks a NAT-outgoing flow that the programs SNAT themselves, see snat.h */
 #define CALI_CT_FLAG_RES_0x20	0x20 /* reserved */
 #define CALI_CT_FLAG_EXT_LOCAL	0x40 /* marks traffic from external client to a local serice */
 
@@ -64,6 +64,25 @@ struct calico_ct_leg {
 };
 
 #define CT_INVALID_IFINDEX	0
+
+/* The MAC addresses to send a packet back through the VXLAN tunnel that a flow arrived through, in
+ * the same order as the ethernet header of the packets that arrive, destination first, so they
+ * are the source and destination MACs for the return packets, see ct_tun_nh_refresh(). */
+struct calico_ct_tun_nh {
+	union {
+		struct {
+			__u8 mac_src[6];
+			__u8 mac_dst[6];
+		};
+		__u32 words[3];
+	};
+};
+
+#define ct_tun_nh_valid(nh)	((nh)->words[0] | (nh)->words[1] | (nh)->words[2])
+#define ct_tun_nh_equal(a, b)	((a)->words[0] == (b)->words[0] && \
+				 (a)->words[1] == (b)->words[1] && \
+				 (a)->words[2] == (b)->words[2])
+
 struct calico_ct_value {
 	__u64 created;
 	__u64 last_seen; // 8
@@ -87,6 +106,10 @@ struct calico_ct_value {
 			__u8 pad1[2];                      // 50
 			__u32 tun_ip;                      // 52
 			__u32 pad3;                        // 56
+			/* For a flow that arrived through the VXLAN tunnel from another node,
+			 * the MACs of the tunnel's next hop, zero if unknown. */
+			struct calico_ct_tun_nh tun_nh;    // 64
+			__u32 pad4;                        // 76
 		};
 
 		// CALI_CT_TYPE_NAT_FWD; key for the CALI_CT_TYPE_NAT_REV entry.
@@ -119,12 +142,14 @@ struct ct_create_ctx {
 	__be32 tun_ip; /* is set when the packet arrive through the NP tunnel.
 			* It is also set on the first node when we create the
 			* initial CT entry for the tunneled traffic. */
+	struct calico_ct_tun_nh tun_nh; /* MACs of the tunnel next hop when the packet
+					 * arrived through the NP tunnel. */
 	__u8 flags;
 	enum cali_ct_type type;
 	bool allow_return;
 };
 
-CALI_MAP(cali_v4_ct, 2,
+CALI_MAP(cali_v4_ct, 3,
 		BPF_MAP_TYPE_HASH,
 		struct calico_ct_key, struct calico_ct_value,
 		512000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
@@ -167,6 +192,10 @@ enum calico_ct_result_type {
 #define CALI_CT_RELATED         0x100
 #define CALI_CT_RPF_FAILED      0x200
 #define CALI_CT_TUN_SRC_CHANGED 0x400
+/* CALI_CT_BYPASS_DNAT is set on a CALI_CT_ESTABLISHED_DNAT result when both legs of the tracking
+ * entry have been approved, so the DNATed packet can carry the bypass mark like a packet of an
+ * ESTABLISHED_BYPASS flow. */
+#define CALI_CT_BYPASS_DNAT     0x800
 
 #define ct_result_rc(rc)		((rc) & 0xff)
 #define ct_result_flags(rc)		((rc) & ~0xff)
@@ -176,6 +205,7 @@ enum calico_ct_result_type {
 #define ct_result_is_related(rc)	((rc) & CALI_CT_RELATED)
 #define ct_result_rpf_failed(rc)	((rc) & CALI_CT_RPF_FAILED)
 #define ct_result_tun_src_changed(rc)	((rc) & CALI_CT_TUN_SRC_CHANGED)
+#define ct_result_bypass_dnat(rc)	((rc) & CALI_CT_BYPASS_DNAT)
 
 struct calico_ct_result {
 	__s16 rc;
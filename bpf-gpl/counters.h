@@ -0,0 +1,200 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_COUNTERS_H__
+#define __CALI_COUNTERS_H__
+
+#include "bpf.h"
+#include "reasons.h"
+
+// Hot-path counters.  Unlike logging, these are compiled into all programs, including the no_log
+// ones; the cost is one per-CPU array lookup per program invocation plus a non-atomic increment
+// per counter.
+//
+// WARNING: must be kept in sync with the definitions in bpf/counters/counters.go.
+enum cali_counter {
+	/* Number of packets seen by the main program. */
+	CALI_COUNTER_TOTAL_PACKETS = 0,
+	/* Final verdicts, counted by whichever program in the chain made the decision.  Packets
+	 * dropped by the policy program are not counted here; they show up as the difference
+	 * between the total and the sum of these. */
+	CALI_COUNTER_ACCEPTED,
+	CALI_COUNTER_DROPPED,
+
+	/* Per-reason counters, incremented with the final verdict; one per enum calico_reason. */
+	CALI_COUNTER_REASON_UNKNOWN,
+	CALI_COUNTER_REASON_SHORT,
+	CALI_COUNTER_REASON_NOT_IP,
+	CALI_COUNTER_REASON_V6_WORKLOAD,
+	CALI_COUNTER_REASON_FAILSAFE,
+	CALI_COUNTER_REASON_DNT,
+	CALI_COUNTER_REASON_PREDNAT,
+	CALI_COUNTER_REASON_POL,
+	CALI_COUNTER_REASON_CT,
+	CALI_COUNTER_REASON_BYPASS,
+	CALI_COUNTER_REASON_CT_NAT,
+	CALI_COUNTER_REASON_CSUM_FAIL,
+	CALI_COUNTER_REASON_ENCAP_FAIL,
+	CALI_COUNTER_REASON_DECAP_FAIL,
+	CALI_COUNTER_REASON_ICMP_DF,
+	CALI_COUNTER_REASON_IP_OPTIONS,
+	CALI_COUNTER_REASON_IP_MALFORMED,
+	CALI_COUNTER_REASON_UNAUTH_SOURCE,
+	CALI_COUNTER_REASON_RT_UNKNOWN,
+
+	/* Conntrack lookup results. */
+	CALI_COUNTER_CT_HIT,
+	CALI_COUNTER_CT_MISS,
+	CALI_COUNTER_CT_NEW,
+
+	/* NAT frontend lookups (only done for packets that miss in conntrack). */
+	CALI_COUNTER_NAT_FE_HIT,
+	CALI_COUNTER_NAT_FE_MISS,
+
+	/* FIB lookups and redirects. */
+	CALI_COUNTER_FIB_SUCCESS,
+	CALI_COUNTER_FIB_FALLBACK,
+	CALI_COUNTER_REDIR_SUCCESS,
+	CALI_COUNTER_REDIR_FAILED,
+
+	/* Why FIB lookups failed, one per BPF_FIB_LKUP_RET_* code, see counter_for_fib_ret(). */
+	CALI_COUNTER_FIB_BLACKHOLE,
+	CALI_COUNTER_FIB_UNREACHABLE,
+	CALI_COUNTER_FIB_PROHIBIT,
+	CALI_COUNTER_FIB_NOT_FWDED,
+	CALI_COUNTER_FIB_FWD_DISABLED,
+	CALI_COUNTER_FIB_UNSUPP_LWT,
+	CALI_COUNTER_FIB_NO_NEIGH,
+	CALI_COUNTER_FIB_FRAG_NEEDED,
+	/* The lookup itself failed. */
+	CALI_COUNTER_FIB_BAD_INPUT,
+	/* The lookup succeeded but the TTL would expire, so the IP stack has to handle the packet. */
+	CALI_COUNTER_FIB_TTL_EXCEEDED,
+	/* Packets that the lookup found no neighbour for and that we redirected to the next hop with
+	 * bpf_redirect_neigh() rather than handing them to the IP stack. */
+	CALI_COUNTER_REDIR_NEIGH,
+
+	/* ICMP errors that we did not generate because of the rate limit. */
+	CALI_COUNTER_ICMP_RATE_LIMITED,
+
+	/* SYN cookies, see syncookie.h: SYN-ACKs sent by XDP and the ACKs whose cookie was valid or
+	 * not. */
+	CALI_COUNTER_SYNCOOKIE_SENT,
+	CALI_COUNTER_SYNCOOKIE_VALID,
+	CALI_COUNTER_SYNCOOKIE_INVALID,
+
+	/* VXLAN packets that XDP redirected to another CPU, see xdp_cpu_steer(). */
+	CALI_COUNTER_CPU_STEERED,
+
+	/* Packets from rate-limited workloads that we gave a later departure time or dropped because
+	 * it was beyond the horizon, see edt.h. */
+	CALI_COUNTER_EDT_DELAYED,
+	CALI_COUNTER_EDT_DROPPED,
+
+	CALI_COUNTER_MAX,
+};
+
+struct cali_counters {
+	__u64 c[CALI_COUNTER_MAX];
+};
+
+/* Index into the counters map; the programs at each hook keep their own set. */
+enum cali_counters_hook {
+	CALI_COUNTERS_HOOK_TO_HOST = 0,
+	CALI_COUNTERS_HOOK_FROM_HOST,
+	CALI_COUNTERS_HOOK_XDP,
+
+	CALI_COUNTERS_HOOK_MAX,
+};
+
+CALI_MAP_V1(cali_counters,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, struct cali_counters,
+		CALI_COUNTERS_HOOK_MAX, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE struct cali_counters *counters_get(void)
+{
+	__u32 key;
+
+	if (CALI_F_XDP) {
+		key = CALI_COUNTERS_HOOK_XDP;
+	} else if (CALI_F_TO_HOST) {
+		key = CALI_COUNTERS_HOOK_TO_HOST;
+	} else {
+		key = CALI_COUNTERS_HOOK_FROM_HOST;
+	}
+
+	return cali_counters_lookup_elem(&key);
+}
+
+static CALI_BPF_INLINE enum cali_counter counter_for_reason(enum calico_reason reason)
+{
+	switch (reason) {
+	case CALI_REASON_SHORT:		return CALI_COUNTER_REASON_SHORT;
+	case CALI_REASON_NOT_IP:	return CALI_COUNTER_REASON_NOT_IP;
+	case CALI_REASON_V6_WORKLOAD:	return CALI_COUNTER_REASON_V6_WORKLOAD;
+	case CALI_REASON_FAILSAFE:	return CALI_COUNTER_REASON_FAILSAFE;
+	case CALI_REASON_DNT:		return CALI_COUNTER_REASON_DNT;
+	case CALI_REASON_PREDNAT:	return CALI_COUNTER_REASON_PREDNAT;
+	case CALI_REASON_POL:		return CALI_COUNTER_REASON_POL;
+	case CALI_REASON_CT:		return CALI_COUNTER_REASON_CT;
+	case CALI_REASON_BYPASS:	return CALI_COUNTER_REASON_BYPASS;
+	case CALI_REASON_CT_NAT:	return CALI_COUNTER_REASON_CT_NAT;
+	case CALI_REASON_CSUM_FAIL:	return CALI_COUNTER_REASON_CSUM_FAIL;
+	case CALI_REASON_ENCAP_FAIL:	return CALI_COUNTER_REASON_ENCAP_FAIL;
+	case CALI_REASON_DECAP_FAIL:	return CALI_COUNTER_REASON_DECAP_FAIL;
+	case CALI_REASON_ICMP_DF:	return CALI_COUNTER_REASON_ICMP_DF;
+	case CALI_REASON_IP_OPTIONS:	return CALI_COUNTER_REASON_IP_OPTIONS;
+	case CALI_REASON_IP_MALFORMED:	return CALI_COUNTER_REASON_IP_MALFORMED;
+	case CALI_REASON_UNAUTH_SOURCE:	return CALI_COUNTER_REASON_UNAUTH_SOURCE;
+	case CALI_REASON_RT_UNKNOWN:	return CALI_COUNTER_REASON_RT_UNKNOWN;
+	default:			return CALI_COUNTER_REASON_UNKNOWN;
+	}
+}
+
+static CALI_BPF_INLINE enum cali_counter counter_for_fib_ret(int rc)
+{
+	switch (rc) {
+	case BPF_FIB_LKUP_RET_BLACKHOLE:	return CALI_COUNTER_FIB_BLACKHOLE;
+	case BPF_FIB_LKUP_RET_UNREACHABLE:	return CALI_COUNTER_FIB_UNREACHABLE;
+	case BPF_FIB_LKUP_RET_PROHIBIT:		return CALI_COUNTER_FIB_PROHIBIT;
+	case BPF_FIB_LKUP_RET_NOT_FWDED:	return CALI_COUNTER_FIB_NOT_FWDED;
+	case BPF_FIB_LKUP_RET_FWD_DISABLED:	return CALI_COUNTER_FIB_FWD_DISABLED;
+	case BPF_FIB_LKUP_RET_UNSUPP_LWT:	return CALI_COUNTER_FIB_UNSUPP_LWT;
+	case BPF_FIB_LKUP_RET_NO_NEIGH:		return CALI_COUNTER_FIB_NO_NEIGH;
+	case BPF_FIB_LKUP_RET_FRAG_NEEDED:	return CALI_COUNTER_FIB_FRAG_NEEDED;
+	default:				return CALI_COUNTER_FIB_BAD_INPUT;
+	}
+}
+
+static CALI_BPF_INLINE void counter_inc(struct cali_counters *counters, enum cali_counter idx)
+{
+	if (!counters) {
+		return;
+	}
+	/* Per-CPU map so no need for an atomic add. */
+	counters->c[idx]++;
+}
+
+static CALI_BPF_INLINE void counters_record_verdict(struct cali_counters *counters,
+						    bool dropped, enum calico_reason reason)
+{
+	counter_inc(counters, dropped ? CALI_COUNTER_DROPPED : CALI_COUNTER_ACCEPTED);
+	counter_inc(counters, counter_for_reason(reason));
+}
+
+#endif /* __CALI_COUNTERS_H__ */
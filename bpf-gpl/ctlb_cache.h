@@ -0,0 +1,64 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_CTLB_CACHE_H__
+#define __CALI_CTLB_CACHE_H__
+
+/* The sendmsg programs cache, per socket, the backend that they picked for the last destination
+ * that the socket sent to.  An unconnected UDP socket, like that of a DNS resolver, then skips
+ * the NAT lookup and the updates of the reverse mappings for the datagrams that follow.
+ *
+ * Felix moves cali_ctlb_gen on whenever it changes the NAT maps, which invalidates all the cached
+ * backends.  The programs re-record the reverse mappings of a cached backend every
+ * CTLB_CACHE_REFRESH_NS so that the LRU maps do not evict them while the socket uses them.
+ */
+#define CTLB_CACHE_REFRESH_NS 1000000000ull
+
+/* Map: the generation of the NAT maps, a single entry.
+ * WARNING: must be kept in sync with CTLBGenMapParameters in bpf/nat/maps.go.
+ */
+CALI_MAP_V1(cali_ctlb_gen,
+		BPF_MAP_TYPE_ARRAY,
+		__u32, __u64,
+		1, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE __u64 ctlb_gen(void)
+{
+	__u32 key = 0;
+	__u64 *gen = cali_ctlb_gen_lookup_elem(&key);
+
+	return gen ? *gen : 0;
+}
+
+/* Map: the backend that sendmsg last picked for each socket, keyed by the socket cookie.
+ * WARNING: must be kept in sync with CTLBCacheMapParameters in bpf/nat/maps.go.
+ */
+struct ctlb_cache4_val {
+	__u64 gen;
+	__u64 refresh_ns;
+	__be32 ip;	/* The destination as the socket sees it. */
+	__u32 port;
+	__be32 be_ip;
+	__u32 be_port;	/* Zero if the destination is not a service. */
+};
+
+CALI_MAP_V1(cali_v4_ctlb_cache,
+		BPF_MAP_TYPE_LRU_HASH,
+		__u64, struct ctlb_cache4_val,
+		65536, 0, MAP_PIN_GLOBAL)
+
+#endif /* __CALI_CTLB_CACHE_H__ */
@@ -0,0 +1,112 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef __CALI_EDT_H__
+#define __CALI_EDT_H__
+
+#include "bpf.h"
+#include "counters.h"
+
+/* Earliest Departure Time shaping of the egress bandwidth of workloads.  Rather than queueing the
+ * packets of a workload behind a token bucket qdisc, the program of the host endpoint stamps each
+ * packet with the time at which it may leave, spacing the packets of the workload out at its
+ * rate, and the fq qdisc of the host endpoint holds them until then.  There is no lock and no
+ * qdisc per workload, the only shared state is the departure time of the workload's last packet.
+ *
+ * The kernel clears skb->tstamp when it forwards a packet, so the stamp can't be set by the
+ * from-workload program; the program of the host endpoint finds the workload from the ingress
+ * interface of the packet, which is the workload's veth for everything that the workload sends
+ * through the host, encapped or not.
+ *
+ * Packets that would have to wait longer than EDT_HORIZON_NS are dropped, which is what makes
+ * TCP back off; fq would drop them anyway.
+ */
+
+/* cali_v4_edt holds the egress rates of the workloads, keyed on the ifindex of their veths.
+ * WARNING: must be kept in sync with bpf/edt/map.go.
+ */
+struct cali_edt_val {
+	/* Bytes per second; zero means no limit. */
+	__u64 rate;
+	/* Departure time of the last packet, in bpf_ktime_get_ns() time. */
+	__u64 t_last;
+};
+
+CALI_MAP_V1(cali_v4_edt,
+		BPF_MAP_TYPE_HASH,
+		__u32, struct cali_edt_val,
+		16 * 1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+#ifndef EDT_HORIZON_NS
+#define EDT_HORIZON_NS	(2000ULL * 1000 * 1000)
+#endif
+
+/* edt_sched_departure sets the departure time of a packet from a rate-limited workload.  It
+ * returns non-zero if the packet must be dropped because it would leave beyond the horizon.
+ */
+static CALI_BPF_INLINE int edt_sched_departure(struct __sk_buff *skb, struct cali_counters *counters)
+{
+	__u32 ifindex = skb->ingress_ifindex;
+
+	if (!ifindex) {
+		/* From the host itself. */
+		return 0;
+	}
+
+	struct cali_edt_val *val = cali_v4_edt_lookup_elem(&ifindex);
+	if (!val || !val->rate) {
+		return 0;
+	}
+
+	__u64 now = bpf_ktime_get_ns();
+	__u64 delay = (__u64)skb->len * 1000000000ULL / val->rate;
+	__u64 t = skb->tstamp;
+	if (t < now) {
+		t = now;
+	}
+
+	/* CPUs sending for the same workload race on t_last; losing an update only lets a packet
+	 * through a little early, which is not worth an atomic for.
+	 */
+	__u64 t_next = val->t_last + delay;
+	if (t_next <= t) {
+		val->t_last = t;
+		return 0;
+	}
+	if (t_next - now >= EDT_HORIZON_NS) {
+		counter_inc(counters, CALI_COUNTER_EDT_DROPPED);
+		return -1;
+	}
+
+	val->t_last = t_next;
+	skb->tstamp = t_next;
+	counter_inc(counters, CALI_COUNTER_EDT_DELAYED);
+	return 0;
+}
+
+/* edt_iface_shaped returns true if the egress bandwidth of the workload behind the interface is
+ * limited.
+ */
+static CALI_BPF_INLINE bool edt_iface_shaped(__u32 ifindex)
+{
+	struct cali_edt_val *val = cali_v4_edt_lookup_elem(&ifindex);
+
+	return val && val->rate;
+}
+
+#endif /* __CALI_EDT_H__ */
@@ -0,0 +1,231 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_EVENTS_H__
+#define __CALI_EVENTS_H__
+
+#include "bpf.h"
+#include "types.h"
+#include "counters.h"
+
+// Structured, sampled packet events.  Only compiled in to the "ev" variants of the programs
+// since BPF_MAP_TYPE_RINGBUF requires a 5.8+ kernel and we can't reference the map from
+// programs that must load on older kernels.
+
+enum cali_event_type {
+	CALI_EVENT_FLOW = 1,
+	CALI_EVENT_PACKET = 2,
+};
+
+// WARNING: must be kept in sync with the definitions in bpf/events/events.go.
+struct cali_event_flow {
+	__u32 type;
+	__u32 ifindex;
+	__be32 ip_src;
+	__be32 ip_dst;
+	__u16 sport; // HBO
+	__u16 dport; // HBO
+	__u8 ip_proto;
+	__u8 dropped;
+	__u16 reason;
+	__s16 ct_rc;
+	__u16 nat_port; // HBO
+	__be32 nat_addr;
+};
+
+/* The number of bytes of each packet that event_capture() records. */
+#define CALI_CAPTURE_SNAPLEN 128
+
+// WARNING: must be kept in sync with the definitions in bpf/events/events.go.
+struct cali_event_packet {
+	__u32 type;
+	__u32 ifindex;
+	__u32 len; /* Of the whole packet. */
+	__u16 cap_len;
+	__u8 dropped;
+	__u8 hook; /* enum cali_counters_hook */
+	__u16 reason;
+	__s16 ct_rc;
+	__u32 _pad;
+	__u8 data[CALI_CAPTURE_SNAPLEN];
+};
+
+/* The packets that event_capture() records; all non-zero fields must match.
+ * WARNING: must be kept in sync with the definitions in bpf/events/events.go.
+ */
+enum cali_capture_verdict {
+	CALI_CAPTURE_ANY = 0,
+	CALI_CAPTURE_DROPPED,
+	CALI_CAPTURE_ALLOWED,
+};
+
+#define CALI_CAPTURE_FLAG_ENABLED 1
+
+struct cali_capture_filter {
+	__u32 flags;
+	__u32 ifindex;
+	__be32 ip_src;
+	__be32 ip_dst;
+	__u16 sport; // HBO
+	__u16 dport; // HBO
+	__u8 ip_proto;
+	__u8 verdict; /* enum cali_capture_verdict */
+	__u16 reason;
+};
+
+CALI_CONFIGURABLE_DEFINE(events_sample_rate, 0x4d415345) /* be 0x4d415345 = ASCII(ESAM) */
+
+#define EVENTS_SAMPLE_RATE CALI_CONFIGURABLE(events_sample_rate)
+
+#ifdef CALI_EVENTS_ENABLED
+
+struct bpf_map_def_extended __attribute__((section("maps"))) cali_events = {
+	.type           = BPF_MAP_TYPE_RINGBUF,
+	.max_entries    = 256 * 1024, /* Bytes; must be a power-of-2 multiple of the page size. */
+#ifndef __BPFTOOL_LOADER__
+	.pinning_strategy        = MAP_PIN_GLOBAL,
+#endif
+};
+
+/* Per-CPU count of packets since the last sampled event. */
+CALI_MAP_V1(cali_ev_sample,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, __u32,
+		1, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE bool event_should_sample(void)
+{
+	__u32 rate = EVENTS_SAMPLE_RATE;
+	__u32 key = 0;
+	__u32 *count;
+
+	if (rate == 0) {
+		return false;
+	}
+
+	count = cali_ev_sample_lookup_elem(&key);
+	if (!count) {
+		return false;
+	}
+	/* Per-CPU map so no need for an atomic update. */
+	if (++(*count) < rate) {
+		return false;
+	}
+	*count = 0;
+	return true;
+}
+
+static CALI_BPF_INLINE void event_flow(struct cali_tc_ctx *ctx, bool dropped)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	if (!event_should_sample()) {
+		return;
+	}
+
+	struct cali_event_flow ev = {
+		.type = CALI_EVENT_FLOW,
+		.ifindex = ctx->skb->ifindex,
+		.ip_src = state->ip_src,
+		.ip_dst = state->ip_dst,
+		.sport = state->sport,
+		.dport = state->dport,
+		.ip_proto = state->ip_proto,
+		.dropped = dropped,
+		.reason = ctx->fwd.reason,
+		.ct_rc = state->ct_result.rc,
+		.nat_port = state->nat_dest.port,
+		.nat_addr = state->nat_dest.addr,
+	};
+
+	bpf_ringbuf_output(&cali_events, &ev, sizeof(ev), 0);
+}
+
+/* Map: the capture filter, a single entry that calico-bpf sets while it captures.
+ * WARNING: must be kept in sync with CaptureFilterMapParams in bpf/events/events.go.
+ */
+CALI_MAP_V1(cali_capture,
+		BPF_MAP_TYPE_ARRAY,
+		__u32, struct cali_capture_filter,
+		1, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE bool capture_matches(struct cali_tc_ctx *ctx, bool dropped)
+{
+	struct cali_tc_state *state = ctx->state;
+	__u32 key = 0;
+	struct cali_capture_filter *f = cali_capture_lookup_elem(&key);
+
+	if (!f || !(f->flags & CALI_CAPTURE_FLAG_ENABLED)) {
+		return false;
+	}
+	if ((f->verdict == CALI_CAPTURE_DROPPED && !dropped) ||
+			(f->verdict == CALI_CAPTURE_ALLOWED && dropped)) {
+		return false;
+	}
+	return (!f->reason || f->reason == ctx->fwd.reason) &&
+		(!f->ifindex || f->ifindex == ctx->skb->ifindex) &&
+		(!f->ip_proto || f->ip_proto == state->ip_proto) &&
+		(!f->ip_src || f->ip_src == state->ip_src) &&
+		(!f->ip_dst || f->ip_dst == state->ip_dst) &&
+		(!f->sport || f->sport == state->sport) &&
+		(!f->dport || f->dport == state->dport);
+}
+
+/* event_capture records the start of the packet, with its verdict, if it matches the capture
+ * filter.  It copies the packet into the ring buffer rather than cloning it, so capturing costs
+ * the packet nothing but the copy, whatever the verdict. */
+static CALI_BPF_INLINE void event_capture(struct cali_tc_ctx *ctx, bool dropped)
+{
+	if (!capture_matches(ctx, dropped)) {
+		return;
+	}
+
+	struct cali_event_packet *ev = bpf_ringbuf_reserve(&cali_events, sizeof(*ev), 0);
+	if (!ev) {
+		return;
+	}
+
+	__u32 cap_len = ctx->skb->len;
+	if (cap_len > CALI_CAPTURE_SNAPLEN) {
+		cap_len = CALI_CAPTURE_SNAPLEN;
+	}
+	if (cap_len == 0 || bpf_skb_load_bytes(ctx->skb, 0, ev->data, cap_len)) {
+		bpf_ringbuf_discard(ev, 0);
+		return;
+	}
+
+	ev->type = CALI_EVENT_PACKET;
+	ev->ifindex = ctx->skb->ifindex;
+	ev->len = ctx->skb->len;
+	ev->cap_len = cap_len;
+	ev->dropped = dropped;
+	ev->hook = CALI_F_TO_HOST ? CALI_COUNTERS_HOOK_TO_HOST : CALI_COUNTERS_HOOK_FROM_HOST;
+	ev->reason = ctx->fwd.reason;
+	ev->ct_rc = ctx->state->ct_result.rc;
+	ev->_pad = 0;
+
+	bpf_ringbuf_submit(ev, 0);
+}
+
+#else /* CALI_EVENTS_ENABLED */
+
+#define event_flow(ctx, dropped)
+#define event_capture(ctx, dropped)
+
+#endif /* CALI_EVENTS_ENABLED */
+
+#endif /* __CALI_EVENTS_H__ */
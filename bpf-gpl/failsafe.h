@@ -42,6 +42,30 @@ CALI_MAP(cali_v4_fsafes, 2,
 
 #define CALI_FSAFE_OUT 1
 
+/* Map: the failsafe ports, indexed by port; most failsafe rules are for any address so the
+ * programs can usually tell from this map alone, and they only consult the cali_v4_fsafes LPM map
+ * for the ports that have rules for specific addresses.
+ * WARNING: must be kept in sync with PortsMapParams in bpf/failsafes/failsafes_map.go.
+ */
+struct failsafe_port_key {
+	__u16 port;
+	__u8 ip_proto;
+	__u8 flags;
+};
+
+struct failsafe_port_val {
+	__u32 flags;
+};
+
+#define CALI_FSAFE_PORT_ANY_ADDR	1
+#define CALI_FSAFE_PORT_ADDR_SCOPED	2
+
+CALI_MAP_V1(cali_v4_fsafe_ports,
+		BPF_MAP_TYPE_HASH,
+		struct failsafe_port_key, struct failsafe_port_val,
+		65536,
+		BPF_F_NO_PREALLOC,
+		MAP_PIN_GLOBAL)
 
 /* Prefix len = (port + protocol + addr) in bits. */
 #define FSAFE_PREFIX_LEN  (sizeof(struct failsafe_key) - \
@@ -49,26 +73,29 @@ CALI_MAP(cali_v4_fsafes, 2,
 
 #define FSAFE_PREFIX_LEN_IN_BITS (FSAFE_PREFIX_LEN * 8)
 
-static CALI_BPF_INLINE bool is_failsafe_in(__u8 ip_proto, __u16 dport, __be32 ip) {
-	struct failsafe_key key = {
-		.prefixlen = FSAFE_PREFIX_LEN_IN_BITS,
-		.ip_proto = ip_proto,
+static CALI_BPF_INLINE bool is_failsafe(__u8 ip_proto, __u16 dport, __be32 ip, __u8 flags) {
+	struct failsafe_port_key port_key = {
 		.port = dport,
-		.flags = 0,
-		.addr = ip,
+		.ip_proto = ip_proto,
+		.flags = flags,
 	};
-	if (cali_v4_fsafes_lookup_elem(&key)) {
+	struct failsafe_port_val *port_val = cali_v4_fsafe_ports_lookup_elem(&port_key);
+
+	if (!port_val) {
+		return false;
+	}
+	if (port_val->flags & CALI_FSAFE_PORT_ANY_ADDR) {
 		return true;
 	}
-	return false;
-}
+	if (!(port_val->flags & CALI_FSAFE_PORT_ADDR_SCOPED)) {
+		return false;
+	}
 
-static CALI_BPF_INLINE bool is_failsafe_out(__u8 ip_proto, __u16 dport, __be32 ip) {
 	struct failsafe_key key = {
 		.prefixlen = FSAFE_PREFIX_LEN_IN_BITS,
 		.ip_proto = ip_proto,
 		.port = dport,
-		.flags = CALI_FSAFE_OUT,
+		.flags = flags,
 		.addr = ip,
 	};
 	if (cali_v4_fsafes_lookup_elem(&key)) {
@@ -77,4 +104,12 @@ static CALI_BPF_INLINE bool is_failsafe_out(__u8 ip_proto, __u16 dport, __be32 i
 	return false;
 }
 
+static CALI_BPF_INLINE bool is_failsafe_in(__u8 ip_proto, __u16 dport, __be32 ip) {
+	return is_failsafe(ip_proto, dport, ip, 0);
+}
+
+static CALI_BPF_INLINE bool is_failsafe_out(__u8 ip_proto, __u16 dport, __be32 ip) {
+	return is_failsafe(ip_proto, dport, ip, CALI_FSAFE_OUT);
+}
+
 #endif /* __CALI_BPF_FAILSAFE_H__ */
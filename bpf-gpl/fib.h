@@ -20,6 +20,10 @@
 
 #include "types.h"
 #include "skb.h"
+#include "events.h"
+#include "routes.h"
+#include "wep_inline.h"
+#include "prog_lat.h"
 
 #if CALI_FIB_ENABLED
 #define fwd_fib(fwd)			((fwd)->fib)
@@ -31,11 +35,49 @@
 #define fwd_fib_set_flags(fwd, flags)
 #endif
 
+/* fwd_dst_is_local_wep returns true if dst is a local workload behind the given interface. */
+static CALI_BPF_INLINE bool fwd_dst_is_local_wep(struct cali_tc_state *state, __be32 dst, __u32 ifindex)
+{
+	struct cali_rt *r = cali_rt_lookup_dst(state, dst);
+	return r && cali_rt_flags_local_workload(r->flags) && r->if_index == ifindex;
+}
+
+/* fwd_can_redirect_peer returns true if the packet, which the FIB lookup sends to ifindex, can skip
+ * the host side of the workload's veth and be delivered straight into the workload's namespace with
+ * bpf_redirect_peer().  That is only the case if the packet is to a local workload and it carries
+ * the bypass mark, i.e. the program on the veth would let it through untouched. */
+static CALI_BPF_INLINE bool fwd_can_redirect_peer(struct cali_tc_ctx *ctx, __u32 ifindex)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	if (!REDIRECT_NEIGH || !CALI_F_TO_HOST || ctx->fwd.mark != CALI_SKB_MARK_BYPASS) {
+		return false;
+	}
+	if (state->tun_ip != 0 || (state->ct_result.flags & CALI_CT_FLAG_EXT_LOCAL)) {
+		/* We'd need to set a different mark. */
+		return false;
+	}
+
+	return fwd_dst_is_local_wep(state, state->ip_dst, ifindex);
+}
+
+/* fwd_can_inline_wep returns true if the packet, which the FIB lookup sends to ifindex, should be
+ * handed to the to-workload program of the veth inline, see wep_inline.h. */
+static CALI_BPF_INLINE bool fwd_can_inline_wep(struct cali_tc_ctx *ctx, __u32 ifindex)
+{
+	if (!WEP_INLINE || !CALI_F_FROM_HEP) {
+		return false;
+	}
+
+	return fwd_dst_is_local_wep(ctx->state, ctx->state->ip_dst, ifindex);
+}
+
 static CALI_BPF_INLINE int forward_or_drop(struct cali_tc_ctx *ctx)
 {
 	int rc = ctx->fwd.res;
 	enum calico_reason reason = ctx->fwd.reason;
 	struct cali_tc_state *state = ctx->state;
+	__u32 inline_ifindex = 0;
 
 	if (rc == TC_ACT_SHOT) {
 		goto deny;
@@ -64,23 +106,32 @@ static CALI_BPF_INLINE int forward_or_drop(struct cali_tc_ctx *ctx)
 		rc = bpf_redirect(ctx->skb->ifindex, redir_flags);
 		if (rc == TC_ACT_REDIRECT) {
 			CALI_DEBUG("Redirect to the same interface (%d) succeeded.\n", ctx->skb->ifindex);
+			counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
 			goto skip_fib;
 		}
 
 		CALI_DEBUG("Redirect to the same interface (%d) failed.\n", ctx->skb->ifindex);
+		counter_inc(ctx->counters, CALI_COUNTER_REDIR_FAILED);
 		goto deny;
 	} else if (rc == CALI_RES_REDIR_IFINDEX) {
-		struct arp_value *arpv;
 		__u32 iface = state->ct_result.ifindex_fwd;
 
-		struct arp_key arpk = {
-			.ip = state->ip_dst,
-			.ifindex = iface,
-		};
+		if (REDIRECT_NEIGH) {
+			/* Let the kernel fill in the MACs from the neighbour table, resolving the
+			 * next hop if needed. */
+			rc = bpf_redirect_neigh(iface, NULL, 0, 0);
+			if (rc == TC_ACT_REDIRECT) {
+				CALI_DEBUG("Redirect to neighbour on interface (%d) succeeded.\n", iface);
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
+				goto skip_fib;
+			}
+			goto skip_redir_ifindex;
+		}
 
-		arpv = cali_v4_arp_lookup_elem(&arpk);
-		if (!arpv) {
-			CALI_DEBUG("ARP lookup failed for %x dev %d\n",
+		/* The conntrack entry recorded the MACs of the tunnel next hop on the
+		 * device that the flow arrived through. */
+		if (!ct_tun_nh_valid(&ctx->tun_nh)) {
+			CALI_DEBUG("No tunnel next hop for %x dev %d\n",
 					bpf_ntohl(state->ip_dst), iface);
 			goto skip_redir_ifindex;
 		}
@@ -94,17 +145,19 @@ static CALI_BPF_INLINE int forward_or_drop(struct cali_tc_ctx *ctx)
 
 		/* Patch in the MAC addresses that should be set on the next hop. */
 		struct ethhdr *eth_hdr = ctx->data_start;
-		__builtin_memcpy(&eth_hdr->h_dest, arpv->mac_dst, ETH_ALEN);
-		__builtin_memcpy(&eth_hdr->h_source, arpv->mac_src, ETH_ALEN);
+		__builtin_memcpy(&eth_hdr->h_dest, ctx->tun_nh.mac_dst, ETH_ALEN);
+		__builtin_memcpy(&eth_hdr->h_source, ctx->tun_nh.mac_src, ETH_ALEN);
 
 		rc = bpf_redirect(iface, 0);
 		if (rc == TC_ACT_REDIRECT) {
 			CALI_DEBUG("Redirect directly to interface (%d) succeeded.\n", iface);
+			counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
 			goto skip_fib;
 		}
 
 skip_redir_ifindex:
 		CALI_DEBUG("Redirect directly to interface (%d) failed.\n", iface);
+		counter_inc(ctx->counters, CALI_COUNTER_REDIR_FAILED);
 		/* fall through to FIB if enabled or the IP stack, don't give up yet. */
 		rc = TC_ACT_UNSPEC;
 	}
@@ -160,6 +213,8 @@ skip_redir_ifindex:
 			 * is safe.
 			 */
 			if ip_ttl_exceeded(ctx->ip_header) {
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_TTL_EXCEEDED);
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
 				rc = TC_ACT_UNSPEC;
 				goto cancel_fib;
 			}
@@ -170,17 +225,65 @@ skip_redir_ifindex:
 			__builtin_memcpy(&eth_hdr->h_dest, fib_params.dmac, sizeof(eth_hdr->h_dest));
 
 			// Redirect the packet.
-			CALI_DEBUG("Got Linux FIB hit, redirecting to iface %d.\n", fib_params.ifindex);
-			rc = bpf_redirect(fib_params.ifindex, 0);
+			if (fwd_can_redirect_peer(ctx, fib_params.ifindex)) {
+				CALI_DEBUG("Got Linux FIB hit, redirecting to peer of iface %d.\n", fib_params.ifindex);
+				rc = bpf_redirect_peer(fib_params.ifindex, 0);
+			} else if (fwd_can_inline_wep(ctx, fib_params.ifindex)) {
+				/* The tail call happens once we are done with the packet below. */
+				CALI_DEBUG("Got Linux FIB hit, delivering inline to workload iface %d.\n",
+						fib_params.ifindex);
+				inline_ifindex = fib_params.ifindex;
+				rc = TC_ACT_REDIRECT;
+			} else {
+				CALI_DEBUG("Got Linux FIB hit, redirecting to iface %d.\n", fib_params.ifindex);
+				rc = bpf_redirect(fib_params.ifindex, 0);
+			}
 			/* now we know we will bypass IP stack and ip->ttl > 1, decrement it! */
 			if (rc == TC_ACT_REDIRECT) {
 				ip_dec_ttl(ctx->ip_header);
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_SUCCESS);
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
+			} else {
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_FAILED);
+			}
+		} else if (REDIRECT_NEIGH && rc == BPF_FIB_LKUP_RET_NO_NEIGH) {
+			/* The route is fine, only the neighbour isn't resolved yet.  Rather than
+			 * bouncing the packet to the IP stack, let the kernel resolve it.  The lookup
+			 * has left the next hop in ipv4_dst, pass it on so that the kernel doesn't
+			 * have to look up the route again. */
+			counter_inc(ctx->counters, CALI_COUNTER_FIB_NO_NEIGH);
+			if ip_ttl_exceeded(ctx->ip_header) {
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_TTL_EXCEEDED);
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
+				rc = TC_ACT_UNSPEC;
+				goto cancel_fib;
+			}
+
+			struct bpf_redir_neigh nh = {
+				.nh_family = 2, /* AF_INET */
+				.ipv4_nh = fib_params.ipv4_dst,
+			};
+
+			CALI_DEBUG("FIB lookup found no neighbour, redirecting to next hop %x on iface %d.\n",
+					bpf_ntohl(nh.ipv4_nh), fib_params.ifindex);
+			rc = bpf_redirect_neigh(fib_params.ifindex, &nh, sizeof(nh), 0);
+			if (rc == TC_ACT_REDIRECT) {
+				ip_dec_ttl(ctx->ip_header);
+				counter_inc(ctx->counters, CALI_COUNTER_FIB_SUCCESS);
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_NEIGH);
+			} else {
+				counter_inc(ctx->counters, CALI_COUNTER_REDIR_FAILED);
 			}
 		} else if (rc < 0) {
 			CALI_DEBUG("FIB lookup failed (bad input): %d.\n", rc);
+			counter_inc(ctx->counters, CALI_COUNTER_FIB_BAD_INPUT);
+			counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
 			rc = TC_ACT_UNSPEC;
 		} else {
 			CALI_DEBUG("FIB lookup failed (FIB problem): %d.\n", rc);
+			counter_inc(ctx->counters, counter_for_fib_ret(rc));
+			counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
 			rc = TC_ACT_UNSPEC;
 		}
 	}
@@ -207,7 +310,7 @@ skip_fib:
 		ctx->fwd.mark |=  CALI_SKB_MARK_SEEN;
 		if (ctx->state->ct_result.flags & CALI_CT_FLAG_EXT_LOCAL) {
 			CALI_DEBUG("To host marked with FLAG_EXT_LOCAL\n");
-			ctx->fwd.mark |= EXT_TO_SVC_MARK;
+			ctx->fwd.mark |= CTX_EXT_TO_SVC_MARK(ctx);
 		}
 		CALI_DEBUG("Traffic is towards host namespace, marking with %x.\n", ctx->fwd.mark);
 		/* FIXME: this ignores the mask that we should be using.
@@ -224,9 +327,38 @@ skip_fib:
 				reason, prog_end_time-state->prog_start_time);
 	}
 
+	if (CALI_F_TO_WEP && rc == TC_ACT_UNSPEC && skb_wep_inline_ifindex(ctx->skb)) {
+		/* We're running inline from a HEP program (see wep_inline.h) so there's no veth to
+		 * let the packet through; deliver it into the workload's namespace ourselves.  If the
+		 * packet isn't for the workload any more, e.g. it became an ICMP error, leave it to
+		 * the IP stack. */
+		__u32 iface = skb_wep_inline_ifindex(ctx->skb);
+		if (!skb_refresh_validate_ptrs(ctx, UDP_SIZE) &&
+				fwd_dst_is_local_wep(state, ctx->ip_header->daddr, iface)) {
+			CALI_DEBUG("Inline, redirecting to peer of iface %d.\n", iface);
+			rc = bpf_redirect_peer(iface, 0);
+		}
+	}
+
+	counters_record_verdict(ctx->counters, false, reason);
+	event_flow(ctx, false);
+	event_capture(ctx, false);
+	prog_lat_record(state);
+
+	if (inline_ifindex) {
+		wep_inline_tail_call(ctx->skb, inline_ifindex);
+		/* No program for the veth (yet), fall back to the veth. */
+		CALI_DEBUG("No inline program for iface %d, redirecting.\n", inline_ifindex);
+		rc = bpf_redirect(inline_ifindex, 0);
+	}
+
 	return rc;
 
 deny:
+	counters_record_verdict(ctx->counters, true, ctx->fwd.reason);
+	event_flow(ctx, true);
+	event_capture(ctx, true);
+	prog_lat_record(state);
 	if (CALI_LOG_LEVEL >= CALI_LOG_LEVEL_INFO) {
 		__u64 prog_end_time = bpf_ktime_get_ns();
 		CALI_INFO("Final result=DENY (%x). Program execution time: %lluns\n",
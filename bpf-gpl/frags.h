@@ -0,0 +1,94 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_FRAGS_H__
+#define __CALI_FRAGS_H__
+
+#include "bpf.h"
+#include "map_stats.h"
+
+/* Only the first fragment of a fragmented datagram carries its L4 header, the trailing fragments
+ * have no ports to look conntrack up with.  When a program sees the first fragment of a UDP
+ * datagram, it records the ports in cali_v4_frags under the datagram's addresses and IP ID.  The
+ * trailing fragments that the program sees next pick the ports up so they hit the conntrack entry
+ * of the flow and share its verdict and NAT, without the host having to reassemble the datagram.
+ * Only UDP is tracked: TCP segments are sized to fit the path so they are seldom fragmented, and
+ * conntrack reads the flags of a TCP packet, which its trailing fragments don't carry.
+ */
+
+struct frags_key {
+	__be32 saddr;
+	__be32 daddr;
+	__be16 id;
+	__u8 proto;
+	__u8 pad;
+};
+
+struct frags_value {
+	__u16 sport;
+	__u16 dport;
+};
+
+/* The entries only need to live for as long as it takes for the fragments of a datagram to go
+ * through, the LRU recycles them.
+ * WARNING: must be kept in sync with FragsMapParams in bpf/conntrack/frags.go.
+ */
+CALI_MAP_V1(cali_v4_frags,
+		BPF_MAP_TYPE_LRU_HASH,
+		struct frags_key, struct frags_value,
+		10000, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE struct frags_key frags_key(struct iphdr *ip)
+{
+	struct frags_key k = {
+		.saddr = ip->saddr,
+		.daddr = ip->daddr,
+		.id = ip->id,
+		.proto = ip->protocol,
+	};
+	return k;
+}
+
+/* frags_record remembers the ports of the first fragment of a datagram. */
+static CALI_BPF_INLINE void frags_record(struct iphdr *ip, __u16 sport, __u16 dport)
+{
+	struct frags_key k = frags_key(ip);
+	struct frags_value v = {
+		.sport = sport,
+		.dport = dport,
+	};
+
+	map_stats_update_result(CALI_MAP_STATS_FRAGS, cali_v4_frags_update_elem(&k, &v, 0));
+}
+
+/* frags_lookup finds the ports of the datagram of a trailing fragment.  It returns false if the
+ * program hasn't seen the first fragment, for example because it arrived out of order.
+ */
+static CALI_BPF_INLINE bool frags_lookup(struct iphdr *ip, __u16 *sport, __u16 *dport)
+{
+	struct frags_key k = frags_key(ip);
+	struct frags_value *v = cali_v4_frags_lookup_elem(&k);
+
+	if (!v) {
+		return false;
+	}
+	*sport = v->sport;
+	*dport = v->dport;
+	return true;
+}
+
+#endif /* __CALI_FRAGS_H__ */
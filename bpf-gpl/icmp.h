@@ -23,9 +23,77 @@
 #include <linux/icmp.h>
 
 #include "bpf.h"
+#include "counters.h"
 #include "log.h"
 #include "skb.h"
 
+/* Rate limiting of the ICMP errors that we generate, like the kernel's icmp_ratelimit.  Without
+ * it, a client with a bad MTU or a scan of a service without backends makes us build one reply
+ * per offending packet.  There is a token bucket per destination prefix and per CPU, so the
+ * effective limit scales with the number of CPUs that the traffic is spread over, but the
+ * buckets do not need atomics or locks.
+ *
+ * WARNING: must be kept in sync with bpf/icmp/map.go.
+ */
+struct icmp_rl_value {
+	__u64 last_refill; /* ktime_ns up to which the tokens have been credited. */
+	__u32 tokens;
+	__u32 pad;
+};
+
+CALI_MAP_V1(cali_v4_icmp_rl,
+		BPF_MAP_TYPE_LRU_PERCPU_HASH,
+		__be32, struct icmp_rl_value,
+		16384, 0, MAP_PIN_GLOBAL)
+
+/* Replies to the same /24 share a bucket, like the kernel, we do not want a scan across a range
+ * of addresses to get around the limit. */
+#define ICMP_RL_PREFIX_MASK	bpf_htonl(0xffffff00)
+/* One reply every 10ms, with bursts of up to 50 replies. */
+#define ICMP_RL_INTERVAL_NS	(10ull * 1000 * 1000)
+#define ICMP_RL_BURST		50
+
+/* icmp_v4_reply_allowed takes a token from the bucket of the destination of the reply, it
+ * returns false and counts the reply as suppressed if there are none left. */
+static CALI_BPF_INLINE bool icmp_v4_reply_allowed(struct cali_tc_ctx *ctx, __be32 dst)
+{
+	__be32 prefix = dst & ICMP_RL_PREFIX_MASK;
+	__u64 now = bpf_ktime_get_ns();
+
+	struct icmp_rl_value *v = cali_v4_icmp_rl_lookup_elem(&prefix);
+	if (!v) {
+		struct icmp_rl_value new_v = {
+			.last_refill = now,
+			.tokens = ICMP_RL_BURST - 1,
+		};
+		/* If the update fails we still reply, we only lose the accounting of this one. */
+		cali_v4_icmp_rl_update_elem(&prefix, &new_v, 0);
+		return true;
+	}
+
+	if (now > v->last_refill) {
+		__u64 gained = (now - v->last_refill) / ICMP_RL_INTERVAL_NS;
+
+		if (gained >= ICMP_RL_BURST - v->tokens) {
+			/* Full bucket, do not bank the time for later. */
+			v->tokens = ICMP_RL_BURST;
+			v->last_refill = now;
+		} else if (gained) {
+			v->tokens += gained;
+			v->last_refill += gained * ICMP_RL_INTERVAL_NS;
+		}
+	}
+
+	if (!v->tokens) {
+		CALI_DEBUG("ICMP v4 reply: rate limited\n");
+		counter_inc(ctx->counters, CALI_COUNTER_ICMP_RATE_LIMITED);
+		return false;
+	}
+	v->tokens--;
+
+	return true;
+}
+
 static CALI_BPF_INLINE int icmp_v4_reply(struct cali_tc_ctx *ctx,
 					__u8 type, __u8 code, __be32 un)
 {
@@ -40,16 +108,17 @@ static CALI_BPF_INLINE int icmp_v4_reply(struct cali_tc_ctx *ctx,
 	}
 
 	struct iphdr ip_orig = *ctx->ip_header;
+	__u32 opts_len = ip_opts_len(ctx->ip_header);
 	CALI_DEBUG("ip->ihl: %d\n", ctx->ip_header->ihl);
-	if (ctx->ip_header->ihl > 5) {
-		CALI_DEBUG("ICMP v4 reply: IP options\n");
+	/* Before we spend any effort on resizing the packet. */
+	if (!icmp_v4_reply_allowed(ctx, ip_orig.saddr)) {
 		return -1;
 	}
 	/* Trim the packet to the desired length. ICMP requires min 8 bytes of
 	 * payload but the SKB implementation gets upset if we try to trim
 	 * part-way through the UDP/TCP header.
 	 */
-	__u32 len = skb_iphdr_offset(ctx->skb) + sizeof(struct iphdr) + 64;
+	__u32 len = skb_iphdr_offset(ctx->skb) + sizeof(struct iphdr) + opts_len + 64;
 	switch (ctx->ip_header->protocol) {
 	case IPPROTO_TCP:
 		len += sizeof(struct tcphdr);
@@ -82,7 +151,7 @@ static CALI_BPF_INLINE int icmp_v4_reply(struct cali_tc_ctx *ctx,
 	CALI_DEBUG("Len after insert %d\n", len);
 
 	/* ICMP reply carries the IP header + at least 8 bytes of data. */
-	if (skb_refresh_validate_ptrs(ctx, len - skb_iphdr_offset(ctx->skb) - IP_SIZE)) {
+	if (skb_refresh_validate_new_hdrs(ctx, len - skb_iphdr_offset(ctx->skb) - IP_SIZE)) {
 		ctx->fwd.reason = CALI_REASON_SHORT;
 		CALI_DEBUG("ICMP v4 reply: too short after making room\n");
 		return -1;
@@ -104,13 +173,13 @@ static CALI_BPF_INLINE int icmp_v4_reply(struct cali_tc_ctx *ctx,
 	 *
 	 * we only call this function because of NodePort encap
 	 */
-	if (ip_orig.daddr != HOST_IP) {
+	if (ip_orig.daddr != CTX_HOST_IP(ctx)) {
 		CALI_DEBUG("ICMP v4 reply: ip_orig.daddr != HOST_IP 0x%x\n", ip_orig.daddr);
 	}
 #endif
 
 	/* use the host IP of the program that handles the packet */
-	ctx->ip_header->saddr = INTF_IP;
+	ctx->ip_header->saddr = CTX_INTF_IP(ctx);
 	ctx->ip_header->daddr = ip_orig.saddr;
 
 	ctx->icmp_header->type = type;
@@ -146,7 +215,7 @@ static CALI_BPF_INLINE int icmp_v4_too_big(struct cali_tc_ctx *ctx)
 		__be16  unused;
 		__be16  mtu;
 	} frag = {
-		.mtu = bpf_htons(TUNNEL_MTU),
+		.mtu = bpf_htons(CTX_TUNNEL_MTU(ctx)),
 	};
 
 	CALI_DEBUG("Sending ICMP too big mtu=%d\n", bpf_ntohs(frag.mtu));
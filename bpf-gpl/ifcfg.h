@@ -0,0 +1,61 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_IFCFG_H__
+#define __CALI_IFCFG_H__
+
+#include "bpf.h"
+
+/* Per-interface configuration.  When IFACE_CFG_ENABLED is set, the programs read the values that
+ * are otherwise patched into the binary as CALI_CONFIGURABLE constants from this map, keyed on the
+ * ifindex of the interface.  The binary is then the same for all interfaces, so that it can be
+ * shared, and Felix can change the values in place, without reloading the programs.
+ *
+ * WARNING: must be kept in sync with bpf/ifcfg/map.go.
+ */
+struct cali_iface_cfg {
+	__be32 host_ip;
+	__be32 intf_ip;
+	__u32 ext_to_svc_mark;
+	__u16 tunnel_mtu;
+	__u16 vxlan_port;
+};
+
+CALI_MAP_V1(cali_v4_ifcfg,
+		BPF_MAP_TYPE_HASH,
+		__u32, struct cali_iface_cfg,
+		16 * 1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* iface_cfg_get returns the configuration of the interface, or NULL if the programs use the
+ * patched constants. */
+static CALI_BPF_INLINE struct cali_iface_cfg *iface_cfg_get(__u32 ifindex)
+{
+	if (!IFACE_CFG_ENABLED) {
+		return NULL;
+	}
+	return cali_v4_ifcfg_lookup_elem(&ifindex);
+}
+
+/* The values of the interface, ctx->iface_cfg falls back to the patched constants if it is NULL. */
+#define CTX_IFACE_CFG(ctx, field, dflt)	((ctx)->iface_cfg ? (ctx)->iface_cfg->field : (dflt))
+#define CTX_HOST_IP(ctx)		CTX_IFACE_CFG(ctx, host_ip, HOST_IP)
+#define CTX_INTF_IP(ctx)		CTX_IFACE_CFG(ctx, intf_ip, INTF_IP)
+#define CTX_TUNNEL_MTU(ctx)		CTX_IFACE_CFG(ctx, tunnel_mtu, TUNNEL_MTU)
+#define CTX_VXLAN_PORT(ctx)		CTX_IFACE_CFG(ctx, vxlan_port, VXLAN_PORT)
+#define CTX_EXT_TO_SVC_MARK(ctx)	CTX_IFACE_CFG(ctx, ext_to_svc_mark, EXT_TO_SVC_MARK)
+
+#endif /* __CALI_IFCFG_H__ */
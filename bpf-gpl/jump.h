@@ -21,7 +21,7 @@
 #include "conntrack.h"
 #include "policy.h"
 
-CALI_MAP(cali_v4_state, 3,
+CALI_MAP(cali_v4_state, 7,
 		BPF_MAP_TYPE_PERCPU_ARRAY,
 		__u32, struct cali_tc_state,
 		1, 0, MAP_PIN_GLOBAL)
@@ -32,11 +32,17 @@ static CALI_BPF_INLINE struct cali_tc_state *state_get(void)
 	return cali_v4_state_lookup_elem(&key);
 }
 
+/* Policies that are too big for one program are split into a chain of programs by Felix; the
+ * programs after the first live at these indices.
+ * WARNING: must be kept in sync with bpf/polprog/pol_prog_builder.go. */
+#define PROG_INDEX_POLICY_CONT	8
+#define PROG_POLICY_CONT_COUNT	8
+
 struct bpf_map_def_extended __attribute__((section("maps"))) cali_jump = {
 	.type = BPF_MAP_TYPE_PROG_ARRAY,
 	.key_size = 4,
 	.value_size = 4,
-	.max_entries = 8,
+	.max_entries = PROG_INDEX_POLICY_CONT + PROG_POLICY_CONT_COUNT,
 #ifndef __BPFTOOL_LOADER__
 	.map_id = 1,
 	.pinning_strategy = 1 /* object namespace */,
@@ -57,4 +63,29 @@ enum cali_jump_index {
 	PROG_INDEX_EPILOGUE,
 	PROG_INDEX_ICMP,
 };
+
+/* When the programs are shared between interfaces, the jump map belongs to the shared program
+ * and cannot hold the policy of any one interface.  Felix then installs a trampoline per
+ * interface and direction in this map, which jumps to the policy program in the jump map of the
+ * attach point.
+ * WARNING: must be kept in sync with bpf/tc/shared.go. */
+#define POL_PROGS_MAX_IFINDEX	(64 * 1024)
+
+struct bpf_map_def_extended __attribute__((section("maps"))) cali_pol_progs = {
+	.type = BPF_MAP_TYPE_PROG_ARRAY,
+	.key_size = 4,
+	.value_size = 4,
+	.max_entries = 2 * POL_PROGS_MAX_IFINDEX,
+	CALI_MAP_TC_EXT_PIN(MAP_PIN_GLOBAL)
+};
+
+static CALI_BPF_INLINE void policy_tail_call(struct __sk_buff *skb, __u32 ifindex)
+{
+	if (SHARED_PROGS) {
+		/* Ingress as defined by policy, like CALI_F_INGRESS. */
+		bpf_tail_call(skb, &cali_pol_progs, ifindex * 2 + (CALI_F_INGRESS ? 1 : 0));
+	} else {
+		bpf_tail_call(skb, &cali_jump, PROG_INDEX_POLICY);
+	}
+}
 #endif /* __CALI_BPF_JUMP_H__ */
@@ -0,0 +1,63 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_MAP_STATS_H__
+#define __CALI_MAP_STATS_H__
+
+#include "bpf.h"
+
+/* Failed updates of the maps that the programs write to.  A full hash map, or an LRU map whose
+ * free list is contended, fails the update, which usually degrades the traffic of the flow quietly
+ * (no conntrack entry, no affinity, no reverse NAT).  Felix exports these with the occupancy of
+ * the maps so that a map can be resized before it saturates.  Only the failure path touches the
+ * map so the cost on the hot path is nil.
+ *
+ * WARNING: must be kept in sync with the definitions in bpf/counters/counters.go.
+ */
+enum cali_map_stats_map {
+	CALI_MAP_STATS_CT = 0,
+	CALI_MAP_STATS_NAT_AFF,
+	CALI_MAP_STATS_ARP,
+	CALI_MAP_STATS_CT_NATS,
+	CALI_MAP_STATS_SRMSG,
+	CALI_MAP_STATS_FRAGS,
+
+	CALI_MAP_STATS_MAX,
+};
+
+CALI_MAP_V1(cali_map_errs,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, __u64,
+		CALI_MAP_STATS_MAX, 0, MAP_PIN_GLOBAL)
+
+/* map_stats_update_result counts a failed update of the given map; err is the result of the update. */
+static CALI_BPF_INLINE void map_stats_update_result(enum cali_map_stats_map map, int err)
+{
+	if (!err) {
+		return;
+	}
+
+	__u32 key = map;
+	__u64 *errs = cali_map_errs_lookup_elem(&key);
+
+	if (errs) {
+		/* Per-CPU map so no need for an atomic add. */
+		(*errs)++;
+	}
+}
+
+#endif /* __CALI_MAP_STATS_H__ */
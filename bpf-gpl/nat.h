@@ -27,14 +27,22 @@
 #include "skb.h"
 #include "routes.h"
 #include "nat_types.h"
+#include "tun_mtu.h"
+#include "map_stats.h"
+#include "svc_ctrs.h"
 
 #ifndef CALI_VXLAN_VNI
 #define CALI_VXLAN_VNI 0xca11c0
 #endif
 
-#define dnat_should_encap() (CALI_F_FROM_HEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD)
-#define dnat_return_should_encap() (CALI_F_FROM_WEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD)
+#define dnat_should_encap() (CALI_F_FROM_HEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD && CALI_F_NP_TUNNEL)
+#define dnat_return_should_encap() (CALI_F_FROM_WEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD && CALI_F_NP_TUNNEL)
+/* The programs without the node port tunnel still look at VXLAN packets to let the ones between
+ * Calico hosts through, see vxlan_attempt_decap(). */
 #define dnat_should_decap() (CALI_F_FROM_HEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD)
+/* dnat_host_return_should_encap is set if the host endpoint program sends the replies of host
+ * networked backends back through the tunnel. */
+#define dnat_host_return_should_encap() (CALI_F_TO_HEP && !CALI_F_DSR && CALI_F_NP_TUNNEL)
 
 /* Number of bytes we add to a packet when we do encap. */
 #define VXLAN_ENCAP_SIZE	(sizeof(struct ethhdr) + sizeof(struct iphdr) + \
@@ -64,11 +72,89 @@ static CALI_BPF_INLINE int skb_nat_l4_csum_ipv4(struct __sk_buff *skb, size_t of
 	return ret;
 }
 
+/* nat_maglev_hash hashes the 5-tuple of a flow to a slot of a Maglev table.  It must not depend on
+ * anything local to the node so that all nodes pick the same backend for the flow.
+ */
+static CALI_BPF_INLINE __u32 nat_maglev_mix(__u32 h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+static CALI_BPF_INLINE __u32 nat_flow_hash(__be32 ip_src, __be32 ip_dst,
+					   __u8 ip_proto, __u16 sport, __u16 dport)
+{
+	__u32 h = nat_maglev_mix(((__u32)sport << 16 | dport) ^ ip_proto);
+
+	h = nat_maglev_mix(h ^ ip_dst);
+	h = nat_maglev_mix(h ^ ip_src);
+
+	return h;
+}
+
+static CALI_BPF_INLINE __u32 nat_maglev_hash(__be32 ip_src, __be32 ip_dst,
+					     __u8 ip_proto, __u16 sport, __u16 dport)
+{
+	return nat_flow_hash(ip_src, ip_dst, ip_proto, sport, dport) % NAT_MAGLEV_TABLE_SIZE;
+}
+
+/* The outer source ports of our VXLAN packets are in the default ephemeral range of Linux. */
+#define VXLAN_SRC_PORT_MIN	32768
+#define VXLAN_SRC_PORT_MAX	61000 /* exclusive */
+
+/* vxlan_src_port picks the outer UDP source port of a tunnelled flow from the hash of its inner,
+ * post-DNAT, 5-tuple, the way udp_flow_src_port() does in the kernel, so that the receiver's RSS
+ * and the fabric's ECMP spread the flows.  The TC and the XDP programs must pick the same port.
+ * The decap accepts any source port.
+ */
+static CALI_BPF_INLINE __u16 vxlan_src_port(__be32 ip_src, __be32 ip_dst,
+					    __u8 ip_proto, __u16 sport, __u16 dport)
+{
+	if (ip_proto != IPPROTO_TCP && ip_proto != IPPROTO_UDP) {
+		sport = dport = 0;
+	}
+
+	__u64 h = nat_flow_hash(ip_src, ip_dst, ip_proto, sport, dport);
+
+	return VXLAN_SRC_PORT_MIN + (__u16)((h * (VXLAN_SRC_PORT_MAX - VXLAN_SRC_PORT_MIN)) >> 32);
+}
+
+/* nat_fe_lookup looks up the frontend in the exact-match tier and only walks the LPM trie for the
+ * services with source ranges.
+ */
+static CALI_BPF_INLINE struct calico_nat_v4_value *nat_fe_lookup(struct calico_nat_v4_key *nat_key)
+{
+	struct calico_nat_v4_exact_key exact_key = {
+		.addr = nat_key->addr,
+		.port = nat_key->port,
+		.protocol = nat_key->protocol,
+	};
+	struct calico_nat_v4_value *val, *src_val;
+
+	val = cali_v4_fex_lookup_elem(&exact_key);
+	if (val && val->count == NAT_FE_DROP_COUNT) {
+		CALI_DEBUG("NAT: frontend has source ranges\n");
+		src_val = cali_v4_nat_fe_lookup_elem(nat_key);
+		if (src_val) {
+			val = src_val;
+		}
+	}
+
+	return val;
+}
+
 static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_src,
 								     __be32 ip_dst,
 								     __u8 ip_proto,
+								     __u16 sport,
 								     __u16 dport,
 								     bool from_tun,
+								     struct cali_rt_cache_entry *rt_cache,
+								     __u64 now,
 								     nat_lookup_result *res)
 {
 	struct calico_nat_v4_key nat_key = {
@@ -82,59 +168,68 @@ static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_s
 	struct calico_nat_secondary_v4_key nat_lv2_key;
 	struct calico_nat_dest *nat_lv2_val;
 	struct calico_nat_v4_affinity_key affkey = {};
-	__u64 now = 0;
 
 	if (!CALI_F_TO_HOST) {
 		// Skip NAT lookup for traffic leaving the host namespace.
 		return NULL;
 	}
 
-	nat_lv1_val = cali_v4_nat_fe_lookup_elem(&nat_key);
+	nat_lv1_val = nat_fe_lookup(&nat_key);
 	CALI_DEBUG("NAT: 1st level lookup addr=%x port=%d protocol=%d.\n",
 		(int)bpf_ntohl(nat_key.addr), (int)dport,
 		(int)(nat_key.protocol));
 
 	if (!nat_lv1_val) {
 		struct cali_rt *rt;
+		struct calico_nat_np_key np_key = {
+			.port = dport,
+			.protocol = ip_proto,
+		};
 
 		CALI_DEBUG("NAT: Miss.\n");
-		/* If the traffic originates at the node (workload or host)
-		 * check whether the destination is a remote nodeport to do a
-		 * straight NAT and avoid a possible extra hop.
-		 */
-		if (!(CALI_F_FROM_WEP || CALI_F_TO_HEP || CALI_F_CGROUP ||
-					(CALI_F_FROM_HEP && from_tun)) || ip_dst == 0xffffffff) {
+		if (ip_dst == 0xffffffff) {
 			return NULL;
 		}
 
-		/* XXX replace the following with a nodeport cidrs lookup once
-		 * XXX we have it.
-		 */
-		rt = cali_rt_lookup(ip_dst);
-		if (!rt) {
-			CALI_DEBUG("NAT: route miss\n");
-			if (!from_tun) {
+		/* The NodePorts only apply to the addresses of the hosts. */
+		rt = rt_cache ? cali_rt_lookup_cached(rt_cache, ip_dst) : cali_rt_lookup(ip_dst);
+		if (rt && cali_rt_flags_local_host(rt->flags)) {
+			CALI_DEBUG("NAT: dest is a local host\n");
+		} else {
+			/* If the traffic originates at the node (workload or host)
+			 * check whether the destination is a remote nodeport to do a
+			 * straight NAT and avoid a possible extra hop.
+			 */
+			if (!(CALI_F_FROM_WEP || CALI_F_TO_HEP || CALI_F_CGROUP ||
+						(CALI_F_FROM_HEP && from_tun))) {
 				return NULL;
 			}
 
-			/* we got here because the original node that forwarded
-			 * it through the tunnel thought it is a nodeport, we can
-			 * use the wildcard nodeport entry.
-			 *
-			 * If the nodes have multiple IPs/NICs, RT entries would
-			 * not know the other IPs of other nodes.
-			 *
-			 * XXX we might wrongly consider another service IP that
-			 * XXX we do not know yet (anymore?) as a nodeport.
-			 */
-			CALI_DEBUG("NAT: ignore rt lookup miss from tunnel, assume nodeport\n");
-		} else if (!cali_rt_is_host(rt)) {
-			CALI_DEBUG("NAT: route dest not a host\n");
-			return NULL;
+			if (!rt) {
+				CALI_DEBUG("NAT: route miss\n");
+				if (!from_tun) {
+					return NULL;
+				}
+
+				/* we got here because the original node that forwarded
+				 * it through the tunnel thought it is a nodeport, we can
+				 * use the wildcard nodeport entry.
+				 *
+				 * If the nodes have multiple IPs/NICs, RT entries would
+				 * not know the other IPs of other nodes.
+				 *
+				 * XXX we might wrongly consider another service IP that
+				 * XXX we do not know yet (anymore?) as a nodeport.
+				 */
+				CALI_DEBUG("NAT: ignore rt lookup miss from tunnel, assume nodeport\n");
+			} else if (!cali_rt_is_host(rt)) {
+				CALI_DEBUG("NAT: route dest not a host\n");
+				return NULL;
+			}
+			np_key.remote = 1;
 		}
 
-		nat_key.addr = 0xffffffff;
-		nat_lv1_val = cali_v4_nat_fe_lookup_elem(&nat_key);
+		nat_lv1_val = cali_v4_nat_np_lookup_elem(&np_key);
 		if (!nat_lv1_val) {
 			CALI_DEBUG("NAT: nodeport miss\n");
 			return NULL;
@@ -145,7 +240,13 @@ static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_s
 	 * with count equal to 0xffffffff. If we hit this entry,
 	 * packet is dropped.
 	 */
+	/* The flows that come through the tunnel were counted by the node that forwarded them. */
+	bool count_svc = !from_tun;
+
 	if (nat_lv1_val->count == NAT_FE_DROP_COUNT) {
+		if (count_svc) {
+			svc_ctr_inc(nat_lv1_val->id, CALI_SVC_CTR_SRC_RANGE_DROPS);
+		}
 		*res = NAT_FE_LOOKUP_DROP;
 		return NULL;
 	}
@@ -153,13 +254,24 @@ static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_s
 
 	CALI_DEBUG("NAT: 1st level hit; id=%d\n", nat_lv1_val->id);
 
+	/* The local backends take the first ordinals.  Connecting a socket straight to one of them
+	 * keeps the connection on this host.
+	 */
+	if (CALI_F_CGROUP && nat_fe_prefer_local(nat_lv1_val) && nat_lv1_val->local) {
+		CALI_DEBUG("NAT: prefer the %d local backends\n", nat_lv1_val->local);
+		count = nat_lv1_val->local;
+	}
+
 	if (count == 0) {
 		CALI_DEBUG("NAT: no backend\n");
+		if (count_svc) {
+			svc_ctr_inc(nat_lv1_val->id, CALI_SVC_CTR_NO_BACKEND);
+		}
 		*res = NAT_NO_BACKEND;
 		return NULL;
 	}
 
-	if (nat_lv1_val->affinity_timeo == 0) {
+	if (nat_fe_affinity_timeo(nat_lv1_val) == 0) {
 		goto skip_affinity;
 	}
 
@@ -171,15 +283,20 @@ static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_s
 	affkey.nat_key = nat_data;
 	affkey.client_ip = ip_src;
 
-	CALI_DEBUG("NAT: backend affinity %d seconds\n", nat_lv1_val->affinity_timeo);
+	CALI_DEBUG("NAT: backend affinity %d seconds\n", nat_fe_affinity_timeo(nat_lv1_val));
 
 	struct calico_nat_v4_affinity_val *affval;
 
-	now = bpf_ktime_get_ns();
-	affval = cali_v4_nat_aff_lookup_elem(&affkey);
-	if (affval && now - affval->ts <= nat_lv1_val->affinity_timeo * 1000000000ULL) {
+	affval = cali_v4_aff_lookup_elem(&affkey);
+	/* The entry may have been stamped with the other clock, see cali_now(), so a slightly
+	 * negative age is a fresh entry. */
+	if (affval && affval->gen == nat_lv1_val->affinity_gen &&
+			(__s64)(now - affval->ts) <= (__s64)(nat_fe_affinity_timeo(nat_lv1_val) * 1000000000ULL)) {
 		CALI_DEBUG("NAT: using affinity backend %x:%d\n",
 				bpf_ntohl(affval->nat_dest.addr), affval->nat_dest.port);
+		if (count_svc) {
+			svc_ctr_inc(nat_lv1_val->id, CALI_SVC_CTR_NEW_FLOWS);
+		}
 
 		return &affval->nat_dest;
 	}
@@ -188,28 +305,56 @@ static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup2(__be32 ip_s
 
 skip_affinity:
 	nat_lv2_key.id = nat_lv1_val->id;
-	nat_lv2_key.ordinal = bpf_get_prandom_u32();
-	nat_lv2_key.ordinal %= count;
+
+	/* If the service has a Maglev table, pick the backend by the hash of the flow so that every
+	 * node picks the same one.  Connect-time load balancing does not know the source yet.  The
+	 * table covers all the backends, so if the frontend only uses the local ones and the slot
+	 * points to a remote one, fall back to a random local one.
+	 */
+	__u32 *mglv_ordinal = NULL;
+	if (!CALI_F_CGROUP) {
+		struct calico_nat_maglev_key mglv_key = {
+			.id = nat_lv1_val->id,
+			.slot = nat_maglev_hash(ip_src, ip_dst, ip_proto, sport, dport),
+		};
+		mglv_ordinal = cali_v4_maglev_lookup_elem(&mglv_key);
+	}
+	if (mglv_ordinal && *mglv_ordinal < count) {
+		nat_lv2_key.ordinal = *mglv_ordinal;
+		CALI_DEBUG("NAT: Maglev hit\n");
+	} else {
+		nat_lv2_key.ordinal = bpf_get_prandom_u32();
+		nat_lv2_key.ordinal %= count;
+	}
 
 	CALI_DEBUG("NAT: 1st level hit; id=%d ordinal=%d\n", nat_lv2_key.id, nat_lv2_key.ordinal);
 
 	if (!(nat_lv2_val = cali_v4_nat_be_lookup_elem(&nat_lv2_key))) {
 		CALI_DEBUG("NAT: backend miss\n");
+		if (count_svc) {
+			svc_ctr_inc(nat_lv1_val->id, CALI_SVC_CTR_NO_BACKEND);
+		}
 		*res = NAT_NO_BACKEND;
 		return NULL;
 	}
 
 	CALI_DEBUG("NAT: backend selected %x:%d\n", bpf_ntohl(nat_lv2_val->addr), nat_lv2_val->port);
+	if (count_svc) {
+		svc_ctr_inc(nat_lv1_val->id, CALI_SVC_CTR_NEW_FLOWS);
+	}
 
-	if (nat_lv1_val->affinity_timeo != 0) {
+	if (nat_fe_affinity_timeo(nat_lv1_val) != 0) {
 		int err;
 		struct calico_nat_v4_affinity_val val = {
 			.ts = now,
 			.nat_dest = *nat_lv2_val,
+			.gen = nat_lv1_val->affinity_gen,
 		};
 
 		CALI_DEBUG("NAT: updating affinity for client %x\n", bpf_ntohl(ip_src));
-		if ((err = cali_v4_nat_aff_update_elem(&affkey, &val, BPF_ANY))) {
+		err = cali_v4_aff_update_elem(&affkey, &val, BPF_ANY);
+		map_stats_update_result(CALI_MAP_STATS_NAT_AFF, err);
+		if (err) {
 			CALI_INFO("NAT: failed to update affinity table: %d\n", err);
 			/* we do carry on, we have a good nat_lv2_val */
 		}
@@ -221,10 +366,15 @@ skip_affinity:
 static CALI_BPF_INLINE struct calico_nat_dest* calico_v4_nat_lookup(__be32 ip_src, __be32 ip_dst,
 								    __u8 ip_proto, __u16 dport, nat_lookup_result *res)
 {
-	return calico_v4_nat_lookup2(ip_src, ip_dst, ip_proto, dport, false, res);
+	return calico_v4_nat_lookup2(ip_src, ip_dst, ip_proto, 0, dport, false, NULL,
+				     bpf_ktime_get_ns(), res);
 }
 
-static CALI_BPF_INLINE int vxlan_v4_encap(struct cali_tc_ctx *ctx,  __be32 ip_src, __be32 ip_dst)
+/* vxlan_v4_encap encaps the packet to ip_dst and returns the outer source port, in host byte order,
+ * in *vxlan_sport.
+ */
+static CALI_BPF_INLINE int vxlan_v4_encap(struct cali_tc_ctx *ctx,  __be32 ip_src, __be32 ip_dst,
+					  __u16 *vxlan_sport)
 {
 	int ret;
 	__wsum csum;
@@ -243,7 +393,7 @@ static CALI_BPF_INLINE int vxlan_v4_encap(struct cali_tc_ctx *ctx,  __be32 ip_sr
 
 	ret = -1;
 
-	if (skb_refresh_validate_ptrs(ctx, new_hdrsz)) {
+	if (skb_refresh_validate_new_hdrs(ctx, new_hdrsz)) {
 		ctx->fwd.reason = CALI_REASON_SHORT;
 		CALI_DEBUG("Too short VXLAN encap\n");
 		goto out;
@@ -253,6 +403,17 @@ static CALI_BPF_INLINE int vxlan_v4_encap(struct cali_tc_ctx *ctx,  __be32 ip_sr
 	struct vxlanhdr *vxlan = (void *)(ctx->udp_header +1);
 	struct ethhdr *eth_inner = (void *)(vxlan+1);
 	struct iphdr *ip_inner = (void*)(eth_inner+1);
+	/* TCP and UDP have the ports at the same place.  If the inner header has options, we
+	 * hash whatever is there, which is still the same for every packet of the flow.
+	 */
+	struct udphdr *l4_inner = (void*)(ip_inner+1);
+	__u16 sport = 0, dport = 0;
+
+	if ((void *)(l4_inner+1) <= ctx->data_end) {
+		sport = bpf_ntohs(l4_inner->source);
+		dport = bpf_ntohs(l4_inner->dest);
+	}
+	*vxlan_sport = vxlan_src_port(ip_inner->saddr, ip_inner->daddr, ip_inner->protocol, sport, dport);
 
 	/* Copy the original IP header. Since it is already DNATed, the dest IP is
 	 * already set. All we need to do is to change the source IP
@@ -269,7 +430,8 @@ static CALI_BPF_INLINE int vxlan_v4_encap(struct cali_tc_ctx *ctx,  __be32 ip_sr
 	ctx->ip_header->check = 0;
 	ctx->ip_header->protocol = IPPROTO_UDP;
 
-	ctx->udp_header->source = ctx->udp_header->dest = bpf_htons(VXLAN_PORT);
+	ctx->udp_header->source = bpf_htons(*vxlan_sport);
+	ctx->udp_header->dest = bpf_htons(CTX_VXLAN_PORT(ctx));
 	ctx->udp_header->len = bpf_htons(bpf_ntohs(ctx->ip_header->tot_len) - sizeof(struct iphdr));
 
 	*((__u8*)&vxlan->flags) = 1 << 3; /* set the I flag to make the VNI valid */
@@ -303,12 +465,14 @@ static CALI_BPF_INLINE int vxlan_v4_decap(struct __sk_buff *skb)
 	return ret;
 }
 
-static CALI_BPF_INLINE int is_vxlan_tunnel(struct iphdr *ip)
+static CALI_BPF_INLINE int is_vxlan_tunnel(struct cali_tc_ctx *ctx)
 {
+	struct iphdr *ip = ctx->ip_header;
 	struct udphdr *udp = (struct udphdr *)(ip +1);
 
-	return ip->protocol == IPPROTO_UDP &&
-		udp->dest == bpf_htons(VXLAN_PORT);
+	/* The decap assumes a 20-byte outer IP header.  A trailing fragment has no UDP header. */
+	return ip->ihl == 5 && ip->protocol == IPPROTO_UDP && !ip_frag_no(ip) &&
+		udp->dest == bpf_htons(CTX_VXLAN_PORT(ctx));
 }
 
 static CALI_BPF_INLINE bool vxlan_size_ok(struct cali_tc_ctx *ctx)
@@ -336,15 +500,47 @@ static CALI_BPF_INLINE bool vxlan_vni_is_valid(struct cali_tc_ctx *ctx)
 
 #define vxlan_udp_csum_ok(udp) ((udp)->check == 0)
 
-static CALI_BPF_INLINE bool vxlan_v4_encap_too_big(struct cali_tc_ctx *ctx)
+/* vxlan_v4_tun_mtu returns the MTU of the tunnel to the node. */
+static CALI_BPF_INLINE __u32 vxlan_v4_tun_mtu(struct cali_tc_ctx *ctx, __be32 node)
 {
-	__u32 mtu = TUNNEL_MTU;
+	__u32 mtu = tun_mtu(node, 0);
+
+	if (!mtu) {
+		return CTX_TUNNEL_MTU(ctx);
+	}
+	if (CALI_F_WEP) {
+		/* Same allowance for the kernel's MTU check as in the TunnelMTU that Felix
+		 * configures on the workload interfaces. */
+		mtu -= VXLAN_ENCAP_SIZE;
+	}
+	return mtu;
+}
 
+static CALI_BPF_INLINE bool vxlan_v4_encap_too_big(struct cali_tc_ctx *ctx, __u32 mtu)
+{
 	/* RFC-1191: MTU is the size in octets of the largest datagram that
 	 * could be forwarded, along the path of the original datagram, without
 	 * being fragmented at this router.  The size includes the IP header and
 	 * IP data, and does not include any lower-level headers.
+	 *
+	 * A GSO packet, such as a GRO super-packet, goes out as segments so it is the segments
+	 * that must fit.
 	 */
+	if (skb_is_gso(ctx->skb)) {
+		__u32 seg_len = skb_gso_seg_len(ctx);
+
+		if (seg_len) {
+			if (seg_len > mtu) {
+				CALI_DEBUG("GSO segment too long (len=%d) vs limit=%d\n", seg_len, mtu);
+				return true;
+			}
+			return false;
+		}
+		if (ctx->ip_header->protocol == IPPROTO_TCP) {
+			/* The segment size is unknown, trust TCP to have sized them to the path. */
+			return false;
+		}
+	}
 	if (ctx->skb->len > sizeof(struct ethhdr) + mtu) {
 		CALI_DEBUG("SKB too long (len=%d) vs limit=%d\n", ctx->skb->len, mtu);
 		return true;
@@ -363,7 +559,7 @@ static CALI_BPF_INLINE int vxlan_attempt_decap(struct cali_tc_ctx *ctx) {
 	/* decap on host ep only if directly for the node */
 	CALI_DEBUG("VXLAN tunnel packet to %x (host IP=%x)\n",
 		bpf_ntohl(ctx->ip_header->daddr),
-		bpf_ntohl(HOST_IP));
+		bpf_ntohl(CTX_HOST_IP(ctx)));
 
 	if (!rt_addr_is_local_host(ctx->ip_header->daddr)) {
 		goto fall_through;
@@ -383,6 +579,11 @@ static CALI_BPF_INLINE int vxlan_attempt_decap(struct cali_tc_ctx *ctx) {
 		/* Not our VNI, not from Calico host. Fall through to policy. */
 		goto fall_through;
 	}
+	if (!CALI_F_NP_TUNNEL) {
+		CALI_DEBUG("VXLAN with our VNI but node port tunnel compiled out.\n");
+		ctx->fwd.reason = CALI_REASON_UNAUTH_SOURCE;
+		goto deny;
+	}
 	if (!rt_addr_is_remote_host(ctx->ip_header->saddr)) {
 		CALI_DEBUG("VXLAN with our VNI from unexpected source.\n");
 		ctx->fwd.reason = CALI_REASON_UNAUTH_SOURCE;
@@ -395,16 +596,10 @@ static CALI_BPF_INLINE int vxlan_attempt_decap(struct cali_tc_ctx *ctx) {
 		goto deny;
 	}
 
-	ctx->arpk.ip = ctx->ip_header->saddr;
-	ctx->arpk.ifindex = ctx->skb->ifindex;
-
-	/* We update the map straight with the packet data, eth header is
-	 * dst:src but the value is src:dst so it flips it automatically
-	 * when we use it on xmit.
+	/* The MACs of the tunnel next hop stay in the eth header, which the decap keeps; the
+	 * conntrack entry of the flow records them for the return packets, see
+	 * ct_tun_nh_refresh().
 	 */
-	cali_v4_arp_update_elem(&ctx->arpk, ctx->eth, 0);
-	CALI_DEBUG("ARP update for ifindex %d ip %x\n", ctx->arpk.ifindex, bpf_ntohl(ctx->arpk.ip));
-
 	ctx->state->tun_ip = ctx->ip_header->saddr;
 	CALI_DEBUG("vxlan decap\n");
 	if (vxlan_v4_decap(ctx->skb)) {
@@ -0,0 +1,122 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_NAT6_H__
+#define __CALI_NAT6_H__
+
+#include "bpf.h"
+#include "nat_types.h"
+
+/* IPv6 NAT for the connect-time load balancer.  It is kept apart from nat_types.h so that the
+ * v4 programs do not carry the v6 maps and vice versa.  The v6 frontends are exact-match only;
+ * session affinity, Maglev and LoadBalancer source ranges are not supported yet.
+ */
+
+/* Map: NAT level one.  Dest IP, port and protocol -> ID and num backends. */
+struct calico_nat_v6_key {
+	__be32 addr[4]; // NBO
+	__u16 port; // HBO
+	__u8 protocol;
+	__u8 pad;
+};
+
+CALI_MAP(cali_v6_nat_fe, 2,
+		BPF_MAP_TYPE_HASH,
+		struct calico_nat_v6_key, struct calico_nat_v4_value,
+		511000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* Map: NAT level two.  ID and ordinal -> new dest and port. */
+struct calico_nat_v6_dest {
+	__be32 addr[4];
+	__u16 port;
+	__u8 pad[2];
+};
+
+CALI_MAP_V1(cali_v6_nat_be,
+		BPF_MAP_TYPE_HASH,
+		struct calico_nat_secondary_v4_key, struct calico_nat_v6_dest,
+		510000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* Map: reverse translations for UDP sendmsg/recvmsg, the v6 twin of cali_v4_srmsg. */
+struct sendrecv6_key {
+	__u64 cookie;
+	__be32 ip[4];
+	__u32 port; /* because bpf_sock_addr uses 32bit and we would need padding */
+	__u32 pad;
+};
+
+struct sendrecv6_val {
+	__be32 ip[4];
+	__u32 port; /* because bpf_sock_addr uses 32bit and we would need padding */
+};
+
+CALI_MAP_V1(cali_v6_srmsg,
+		BPF_MAP_TYPE_LRU_HASH,
+		struct sendrecv6_key, struct sendrecv6_val,
+		510000, 0, MAP_PIN_GLOBAL)
+
+/* Map: the backend that sendmsg last picked for each socket, the v6 twin of cali_v4_ctlb_cache. */
+struct ctlb_cache6_val {
+	__u64 gen;
+	__u64 refresh_ns;
+	__be32 ip[4];
+	__u32 port;
+	__be32 be_ip[4];
+	__u32 be_port;	/* Zero if the destination is not a service. */
+};
+
+CALI_MAP_V1(cali_v6_ctlb_cache,
+		BPF_MAP_TYPE_LRU_HASH,
+		__u64, struct ctlb_cache6_val,
+		65536, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE struct calico_nat_v6_dest* calico_v6_nat_lookup(struct calico_nat_v6_key *nat_key,
+									nat_lookup_result *res)
+{
+	struct calico_nat_secondary_v4_key nat_lv2_key;
+	struct calico_nat_v6_dest *nat_lv2_val;
+	struct calico_nat_v4_value *nat_lv1_val;
+
+	nat_lv1_val = cali_v6_nat_fe_lookup_elem(nat_key);
+	if (!nat_lv1_val) {
+		CALI_DEBUG("NAT6: 1st level miss\n");
+		return NULL;
+	}
+
+	__u32 count = nat_lv1_val->count;
+	if (count == 0) {
+		CALI_DEBUG("NAT6: no backend\n");
+		*res = NAT_NO_BACKEND;
+		return NULL;
+	}
+
+	nat_lv2_key.id = nat_lv1_val->id;
+	nat_lv2_key.ordinal = bpf_get_prandom_u32();
+	nat_lv2_key.ordinal %= count;
+
+	CALI_DEBUG("NAT6: 1st level hit; id=%d ordinal=%d\n", nat_lv2_key.id, nat_lv2_key.ordinal);
+
+	if (!(nat_lv2_val = cali_v6_nat_be_lookup_elem(&nat_lv2_key))) {
+		CALI_DEBUG("NAT6: backend miss\n");
+		*res = NAT_NO_BACKEND;
+		return NULL;
+	}
+
+	return nat_lv2_val;
+}
+
+#endif /* __CALI_NAT6_H__ */
@@ -65,14 +65,57 @@ struct calico_nat_v4_value {
 	__u32 id;
 	__u32 count;
 	__u32 local;
-	__u32 affinity_timeo;
+	__u32 affinity_timeo; /* seconds, the top byte holds the NAT_FE_FLG_* flags */
+	__u32 affinity_gen; /* the affinities of other generations have expired */
 };
 
-CALI_MAP(cali_v4_nat_fe, 2,
+#define NAT_FE_AFFINITY_TIMEO_MASK	0x00ffffff
+/* The connect-time load balancer only picks from the local backends, if there are any. */
+#define NAT_FE_FLG_PREFER_LOCAL		0x01000000
+
+#define nat_fe_affinity_timeo(v)	((v)->affinity_timeo & NAT_FE_AFFINITY_TIMEO_MASK)
+#define nat_fe_prefer_local(v)		((v)->affinity_timeo & NAT_FE_FLG_PREFER_LOCAL)
+
+/* Only the frontends with a source CIDR, i.e. of the services with LoadBalancer source
+ * ranges, live in the LPM trie.  The rest live in cali_v4_fex.
+ */
+CALI_MAP_NUMA(cali_v4_nat_fe, 3, cali_v4_fe3_n1,
 		BPF_MAP_TYPE_LPM_TRIE,
 		union calico_nat_v4_lpm_key, struct calico_nat_v4_value,
 		511000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
 
+/* Map: NAT level one, exact-match tier.  Dest IP, port and protocol -> ID and num backends.
+ * The services with source ranges have a NAT_FE_DROP_COUNT entry here, which means "look up
+ * cali_v4_nat_fe with the source and drop if that misses".
+ */
+struct calico_nat_v4_exact_key {
+	__u32 addr; // NBO
+	__u16 port; // HBO
+	__u8 protocol;
+	__u8 pad;
+};
+
+CALI_MAP_NUMA(cali_v4_fex, 2, cali_v4_fex2_n1,
+		BPF_MAP_TYPE_HASH,
+		struct calico_nat_v4_exact_key, struct calico_nat_v4_value,
+		511000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* Map: NodePorts.  Port and protocol -> ID and num backends of the NodePort.  It is only looked
+ * up when the destination is an address of a host, so it needs a single entry per NodePort
+ * rather than one per host IP.  The entries with remote set are for the addresses of the other
+ * hosts; the services that only use the local backends do not have them.
+ */
+struct calico_nat_np_key {
+	__u16 port; // HBO
+	__u8 protocol;
+	__u8 remote;
+};
+
+CALI_MAP_NUMA(cali_v4_nat_np, 2, cali_v4_np2_n1,
+		BPF_MAP_TYPE_HASH,
+		struct calico_nat_np_key, struct calico_nat_v4_value,
+		393216, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
 
 // Map: NAT level two.  ID and ordinal -> new dest and port.
 
@@ -87,24 +130,45 @@ struct calico_nat_dest {
 	__u8 pad[2];
 };
 
-CALI_MAP_V1(cali_v4_nat_be,
+CALI_MAP_NUMA(cali_v4_nat_be,, cali_v4_be_n1,
 		BPF_MAP_TYPE_HASH,
 		struct calico_nat_secondary_v4_key, struct calico_nat_dest,
 		510000, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
 
+/* Map: optional per-service Maglev lookup tables.  (ID, slot) -> ordinal of the backend in the
+ * cali_v4_nat_be map.  A service either has all NAT_MAGLEV_TABLE_SIZE slots or none.
+ */
+#define NAT_MAGLEV_TABLE_SIZE	1021 /* must be a prime */
+
+struct calico_nat_maglev_key {
+	__u32 id;
+	__u32 slot;
+};
+
+CALI_MAP_V1(cali_v4_maglev,
+		BPF_MAP_TYPE_HASH,
+		struct calico_nat_maglev_key, __u32,
+		NAT_MAGLEV_TABLE_SIZE * 500, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
 struct calico_nat_v4_affinity_key {
 	struct calico_nat_v4 nat_key;
 	__u32 client_ip;
 	__u32 padding;
 };
 
+/* The affinity is only valid while its generation matches the affinity_gen of the frontend.  Felix
+ * moves the generation of a service on when the service loses a backend, which expires all its
+ * affinities at once without having to find and delete them.
+ */
 struct calico_nat_v4_affinity_val {
 	struct calico_nat_dest nat_dest;
 	__u64 ts;
+	__u32 gen;
+	__u32 pad;
 };
 
 
-CALI_MAP_V1(cali_v4_nat_aff,
+CALI_MAP(cali_v4_aff, 2,
 		BPF_MAP_TYPE_LRU_HASH,
 		struct calico_nat_v4_affinity_key, struct calico_nat_v4_affinity_val,
 		510000, 0, MAP_PIN_GLOBAL)
@@ -82,16 +82,10 @@ static CALI_BPF_INLINE int parse_packet_ip(struct cali_tc_ctx *ctx) {
 		CALI_DEBUG("Drop malformed IP packets\n");
 		goto deny;
 	} else if (ctx->ip_header->ihl > 5) {
-		/* Drop packets with IP options from/to WEP.
-		 * Also drop packets with IP options if the dest IP is not host IP
+		/* The packet pointers already skip the options, the packet goes through conntrack,
+		 * NAT and the FIB like any other.
 		 */
-		if (CALI_F_WEP || (CALI_F_FROM_HEP && !rt_addr_is_local_host(ctx->ip_header->daddr))) {
-			ctx->fwd.reason = CALI_REASON_IP_OPTIONS;
-			CALI_DEBUG("Drop packets with IP options\n");
-			goto deny;
-		}
-		CALI_DEBUG("Allow packets with IP options and dst IP = hostIP\n");
-		goto allow_no_fib;
+		CALI_DEBUG("IP options, %d bytes\n", ip_opts_len(ctx->ip_header));
 	}
 
 	return 0;
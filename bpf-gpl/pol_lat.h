@@ -0,0 +1,96 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_POL_LAT_H__
+#define __CALI_POL_LAT_H__
+
+#include "bpf.h"
+#include "types.h"
+#include "counters.h"
+
+/* The TC program stamps the state with the time when it hands a new flow to the policy program
+ * and the epilogue records how long the policy took, so only allowed packets are counted; a
+ * packet that the policy drops never comes back.
+ */
+
+/* Map: log2 histogram of the time that the policy programs take to allow a packet, per hook.
+ * Bucket i counts the evaluations that took [2^i, 2^(i+1)) ns.
+ * WARNING: must be kept in sync with PolicyLatencyMapParams in bpf/counters/counters.go.
+ */
+#define CALI_POL_LAT_BUCKETS 32
+
+struct cali_pol_lat {
+	__u64 b[CALI_POL_LAT_BUCKETS];
+};
+
+CALI_MAP_V1(cali_pol_lat,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, struct cali_pol_lat,
+		CALI_COUNTERS_HOOK_MAX, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE __u32 pol_lat_bucket(__u64 ns)
+{
+	__u32 b = 0;
+
+	if (ns >> 16) {
+		ns >>= 16;
+		b += 16;
+	}
+	if (ns >> 8) {
+		ns >>= 8;
+		b += 8;
+	}
+	if (ns >> 4) {
+		ns >>= 4;
+		b += 4;
+	}
+	if (ns >> 2) {
+		ns >>= 2;
+		b += 2;
+	}
+	if (ns >> 1) {
+		b += 1;
+	}
+	return b;
+}
+
+/* pol_lat_record records the time since the packet was handed to the policy program. */
+static CALI_BPF_INLINE void pol_lat_record(struct cali_tc_state *state)
+{
+	__u64 start = state->pol_start_time;
+	__u32 key = CALI_F_TO_HOST ? CALI_COUNTERS_HOOK_TO_HOST : CALI_COUNTERS_HOOK_FROM_HOST;
+	struct cali_pol_lat *lat;
+	__u64 ns;
+
+	if (!start) {
+		return;
+	}
+	state->pol_start_time = 0;
+
+	lat = cali_pol_lat_lookup_elem(&key);
+	if (!lat) {
+		return;
+	}
+	ns = bpf_ktime_get_ns() - start;
+	if (ns >> CALI_POL_LAT_BUCKETS) {
+		ns = (1ull << CALI_POL_LAT_BUCKETS) - 1;
+	}
+	/* Per-CPU map so no need for an atomic add. */
+	lat->b[pol_lat_bucket(ns) & (CALI_POL_LAT_BUCKETS - 1)]++;
+}
+
+#endif /* __CALI_POL_LAT_H__ */
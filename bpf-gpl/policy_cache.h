@@ -0,0 +1,109 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_POLICY_CACHE_H__
+#define __CALI_POLICY_CACHE_H__
+
+#include "bpf.h"
+#include "types.h"
+
+// Policy verdict cache.  Remembers the allow verdicts of the policy program for new flows so that
+// further flows with the same key skip the policy program.  Only verdicts that the policy program
+// marked with CALI_ST_POL_CACHEABLE are cached; it does that only if the verdict depends on nothing
+// but the fields of the key.
+
+// WARNING: must be kept in sync with the definitions in bpf/polcache/map.go.
+struct cali_pol_cache_key {
+	__u32 ifindex;
+	__be32 addr_src;
+	__be32 addr_dst; /* Post-DNAT. */
+	__u16 dport; /* Post-DNAT port or ICMP type and code. */
+	__u8 proto;
+	__u8 flags; /* CALI_POL_CACHE_F_* */
+};
+
+#define CALI_POL_CACHE_F_TO_EP		0x01
+#define CALI_POL_CACHE_F_DEST_IS_HOST	0x02
+#define CALI_POL_CACHE_F_SRC_IS_HOST	0x04
+
+CALI_MAP_V1(cali_v4_pol_vc,
+		BPF_MAP_TYPE_LRU_HASH,
+		struct cali_pol_cache_key, __u32,
+		64*1024, 0, MAP_PIN_GLOBAL)
+
+/* The single entry of cali_v4_pol_gen is the policy generation, which Felix bumps whenever the
+ * verdict of a policy program may change.  Cache entries hold the generation that they were
+ * created in. */
+CALI_MAP_V1(cali_v4_pol_gen,
+		BPF_MAP_TYPE_ARRAY,
+		__u32, __u32,
+		1, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE __u32 pol_cache_generation(void)
+{
+	__u32 key = 0;
+	__u32 *gen = cali_v4_pol_gen_lookup_elem(&key);
+
+	return gen ? *gen : 0;
+}
+
+static CALI_BPF_INLINE void pol_cache_key_fill(struct cali_pol_cache_key *key,
+					       struct cali_tc_state *state, __u32 ifindex)
+{
+	key->ifindex = ifindex;
+	key->addr_src = state->ip_src;
+	key->addr_dst = state->post_nat_ip_dst;
+	/* The policy program matches the ICMP type and code in place of the dport. */
+	key->dport = state->ip_proto == IPPROTO_ICMP ? state->dport : state->post_nat_dport;
+	key->proto = state->ip_proto;
+	key->flags = 0;
+	if (CALI_F_TO_WEP || CALI_F_TO_HEP) {
+		key->flags |= CALI_POL_CACHE_F_TO_EP;
+	}
+	if (state->flags & CALI_ST_DEST_IS_HOST) {
+		key->flags |= CALI_POL_CACHE_F_DEST_IS_HOST;
+	}
+	if (state->flags & CALI_ST_SRC_IS_HOST) {
+		key->flags |= CALI_POL_CACHE_F_SRC_IS_HOST;
+	}
+}
+
+/* pol_cache_lookup returns true if the policy program allowed an earlier flow with the same key in
+ * the current generation.  It stashes the generation in the state so that pol_cache_update()
+ * tags a verdict with the generation of the policy that computed it, even if Felix bumps the
+ * generation while the policy program runs. */
+static CALI_BPF_INLINE bool pol_cache_lookup(struct cali_tc_state *state, __u32 ifindex)
+{
+	struct cali_pol_cache_key key;
+	pol_cache_key_fill(&key, state, ifindex);
+
+	state->pol_gen = pol_cache_generation();
+
+	__u32 *gen = cali_v4_pol_vc_lookup_elem(&key);
+	return gen && *gen == state->pol_gen;
+}
+
+static CALI_BPF_INLINE void pol_cache_update(struct cali_tc_state *state, __u32 ifindex)
+{
+	struct cali_pol_cache_key key;
+	pol_cache_key_fill(&key, state, ifindex);
+
+	__u32 gen = state->pol_gen;
+	cali_v4_pol_vc_update_elem(&key, &gen, BPF_ANY);
+}
+
+#endif /* __CALI_POLICY_CACHE_H__ */
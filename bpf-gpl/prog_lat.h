@@ -0,0 +1,113 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_PROG_LAT_H__
+#define __CALI_PROG_LAT_H__
+
+#include "bpf.h"
+#include "types.h"
+#include "pol_lat.h"
+
+/* If PROG_LAT_ENABLED, the TC programs record how long they took with each packet, from the
+ * entry of calico_tc() to the verdict in forward_or_drop(), whichever tail calls the packet went
+ * through.  The histograms use the buckets of the policy latency histograms, see pol_lat.h.
+ */
+
+/* The hook that the program is attached to, as far as the latency histograms are concerned.
+ * WARNING: must be kept in sync with ProgLatencyHook in bpf/counters/counters.go.
+ */
+enum cali_prog_lat_hook {
+	CALI_PROG_LAT_FROM_HEP,
+	CALI_PROG_LAT_TO_HEP,
+	CALI_PROG_LAT_FROM_WEP,
+	CALI_PROG_LAT_TO_WEP,
+	CALI_PROG_LAT_FROM_TUNNEL,
+	CALI_PROG_LAT_TO_TUNNEL,
+	CALI_PROG_LAT_FROM_WG,
+	CALI_PROG_LAT_TO_WG,
+
+	CALI_PROG_LAT_HOOK_MAX,
+};
+
+/* The path that the packet took through the program.
+ * WARNING: must be kept in sync with ProgLatencyPath in bpf/counters/counters.go.
+ */
+enum cali_prog_lat_path {
+	/* The packet belongs to a known flow that isn't NATted, or didn't need a conntrack lookup. */
+	CALI_PROG_LAT_FAST,
+	/* The packet started a flow, so it went through the NAT lookup and policy. */
+	CALI_PROG_LAT_NEW,
+	/* The packet belongs to a known NATted flow, or started a flow to a service. */
+	CALI_PROG_LAT_NAT,
+
+	CALI_PROG_LAT_PATH_MAX,
+};
+
+#define CALI_PROG_LAT_HOOK ( \
+	CALI_F_WIREGUARD ? (CALI_F_TO_HOST ? CALI_PROG_LAT_FROM_WG : CALI_PROG_LAT_TO_WG) : \
+	CALI_F_TUNNEL ? (CALI_F_TO_HOST ? CALI_PROG_LAT_FROM_TUNNEL : CALI_PROG_LAT_TO_TUNNEL) : \
+	CALI_F_FROM_HEP ? CALI_PROG_LAT_FROM_HEP : \
+	CALI_F_TO_HEP ? CALI_PROG_LAT_TO_HEP : \
+	CALI_F_FROM_WEP ? CALI_PROG_LAT_FROM_WEP : CALI_PROG_LAT_TO_WEP)
+
+/* Map: log2 histograms of the time that the TC programs take per packet, keyed by
+ * hook * CALI_PROG_LAT_PATH_MAX + path.
+ * WARNING: must be kept in sync with ProgLatencyMapParams in bpf/counters/counters.go.
+ */
+CALI_MAP_V1(cali_prog_lat,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, struct cali_pol_lat,
+		CALI_PROG_LAT_HOOK_MAX * CALI_PROG_LAT_PATH_MAX, 0, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE __u32 prog_lat_path(struct cali_tc_state *state)
+{
+	switch (ct_result_rc(state->ct_result.rc)) {
+	case CALI_CT_NEW:
+		return state->nat_dest.addr ? CALI_PROG_LAT_NAT : CALI_PROG_LAT_NEW;
+	case CALI_CT_ESTABLISHED_SNAT:
+	case CALI_CT_ESTABLISHED_DNAT:
+		return CALI_PROG_LAT_NAT;
+	default:
+		return CALI_PROG_LAT_FAST;
+	}
+}
+
+/* prog_lat_record records the time since calico_tc() started with the packet. */
+static CALI_BPF_INLINE void prog_lat_record(struct cali_tc_state *state)
+{
+	__u32 key;
+	struct cali_pol_lat *lat;
+	__u64 ns;
+
+	if (!PROG_LAT_ENABLED || !state->prog_start_time) {
+		return;
+	}
+
+	key = CALI_PROG_LAT_HOOK * CALI_PROG_LAT_PATH_MAX + prog_lat_path(state);
+	lat = cali_prog_lat_lookup_elem(&key);
+	if (!lat) {
+		return;
+	}
+	ns = bpf_ktime_get_ns() - state->prog_start_time;
+	if (ns >> CALI_POL_LAT_BUCKETS) {
+		ns = (1ull << CALI_POL_LAT_BUCKETS) - 1;
+	}
+	/* Per-CPU map so no need for an atomic add. */
+	lat->b[pol_lat_bucket(ns) & (CALI_POL_LAT_BUCKETS - 1)]++;
+}
+
+#endif /* __CALI_PROG_LAT_H__ */
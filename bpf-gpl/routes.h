@@ -41,6 +41,7 @@ enum cali_rt_flags {
 	CALI_RT_LOCAL       = 0x08,
 	CALI_RT_HOST        = 0x10,
 	CALI_RT_SAME_SUBNET = 0x20,
+	CALI_RT_NH_GROUP    = 0x40,
 };
 
 struct cali_rt {
@@ -50,22 +51,83 @@ struct cali_rt {
 		__u32 next_hop;
 		// Interface index for local workload routes.
 		__u32 if_index;
+		// Next-hop group of remote workload routes with CALI_RT_NH_GROUP.
+		__u32 nh_group;
 	};
 };
 
-CALI_MAP_V1(cali_v4_routes,
+CALI_MAP_NUMA(cali_v4_routes,, cali_v4_rt_n1,
 		BPF_MAP_TYPE_LPM_TRIE,
 		union cali_rt_lpm_key, struct cali_rt,
 		1024*1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
 
+/* Map: the /32 routes, a copy of the full-length entries of cali_v4_routes.  Most lookups are
+ * for workload and host addresses, which a hash lookup finds without walking the trie.
+ * WARNING: must be kept in sync with ExactMapParameters in bpf/routes/map.go.
+ */
+CALI_MAP_NUMA(cali_v4_rt32,, cali_v4_rt32_n1,
+		BPF_MAP_TYPE_HASH,
+		__be32, struct cali_rt,
+		256*1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
 static CALI_BPF_INLINE struct cali_rt *cali_rt_lookup(__be32 addr)
 {
+	struct cali_rt *rt = cali_v4_rt32_lookup_elem(&addr);
+	if (rt) {
+		return rt;
+	}
+
+	/* Not a /32 route, or Felix hasn't copied it yet; the trie has the answer either way. */
 	union cali_rt_lpm_key k;
 	k.key.prefixlen = 32;
 	k.key.addr = addr;
 	return cali_v4_routes_lookup_elem(&k);
 }
 
+/* Map: the next-hop groups.  A remote workload route that several nodes can reach, for instance an
+ * anycast address, refers to a group of their IPs instead of having a single next hop.
+ * WARNING: must be kept in sync with NextHopGroupMapParameters in bpf/routes/nh_group.go.
+ */
+#define CALI_RT_NH_GROUP_MAX 8
+
+struct cali_rt_nh_group {
+	__u32 count;
+	__be32 next_hops[CALI_RT_NH_GROUP_MAX];
+};
+
+CALI_MAP_V1(cali_v4_nh_grp,
+		BPF_MAP_TYPE_ARRAY,
+		__u32, struct cali_rt_nh_group,
+		16*1024, 0, MAP_PIN_GLOBAL)
+
+/* cali_rt_next_hop returns the next hop of a remote route.  For a next-hop group, the flow hash
+ * picks one of its next hops, so each flow sticks to one path.  It returns 0 if the group is
+ * empty.
+ */
+static CALI_BPF_INLINE __be32 cali_rt_next_hop(struct cali_rt *rt, __u32 hash)
+{
+	if (!(rt->flags & CALI_RT_NH_GROUP)) {
+		return rt->next_hop;
+	}
+
+	__u32 id = rt->nh_group;
+	struct cali_rt_nh_group *grp = cali_v4_nh_grp_lookup_elem(&id);
+	if (!grp) {
+		return 0;
+	}
+
+	__u32 count = grp->count;
+	if (count == 0 || count > CALI_RT_NH_GROUP_MAX) {
+		return 0;
+	}
+
+	__u32 idx = ((__u64)hash * count) >> 32;
+	if (idx >= CALI_RT_NH_GROUP_MAX) {
+		return 0;
+	}
+	return grp->next_hops[idx];
+}
+
 static CALI_BPF_INLINE enum cali_rt_flags cali_rt_lookup_flags(__be32 addr)
 {
 	struct cali_rt *rt = cali_rt_lookup(addr);
@@ -84,6 +146,70 @@ static CALI_BPF_INLINE enum cali_rt_flags cali_rt_lookup_flags(__be32 addr)
 #define cali_rt_flags_remote_workload(t) (!((t) & CALI_RT_LOCAL) && ((t) & CALI_RT_WORKLOAD))
 #define cali_rt_flags_remote_host(t) (((t) & (CALI_RT_LOCAL | CALI_RT_HOST)) == CALI_RT_HOST)
 
+/* struct cali_rt_cache memoises the route lookups of a packet, one address on each side of the
+ * flow, so that each address costs at most one trie walk.  It lives in the cali_tc_state so that it
+ * survives tail calls; tc_state_init() empties it for each packet.
+ */
+enum cali_rt_cache_state {
+	CALI_RT_CACHE_EMPTY = 0,
+	CALI_RT_CACHE_MISS,
+	CALI_RT_CACHE_HIT,
+};
+
+struct cali_rt_cache_entry {
+	__be32 addr;
+	__u32 state; /* enum cali_rt_cache_state */
+	struct cali_rt rt;
+};
+
+struct cali_rt_cache {
+	struct cali_rt_cache_entry src;
+	struct cali_rt_cache_entry dst;
+};
+
+static CALI_BPF_INLINE struct cali_rt *cali_rt_lookup_cached(struct cali_rt_cache_entry *e, __be32 addr)
+{
+	struct cali_rt *rt;
+
+	if (e->state != CALI_RT_CACHE_EMPTY && e->addr == addr) {
+		return e->state == CALI_RT_CACHE_HIT ? &e->rt : NULL;
+	}
+
+	rt = cali_rt_lookup(addr);
+	e->addr = addr;
+	if (rt) {
+		e->rt = *rt;
+		e->state = CALI_RT_CACHE_HIT;
+	} else {
+		e->state = CALI_RT_CACHE_MISS;
+	}
+
+	return rt;
+}
+
+static CALI_BPF_INLINE enum cali_rt_flags cali_rt_lookup_flags_cached(struct cali_rt_cache_entry *e,
+								      __be32 addr)
+{
+	struct cali_rt *rt = cali_rt_lookup_cached(e, addr);
+	if (!rt) {
+		return CALI_RT_UNKNOWN;
+	}
+	return rt->flags;
+}
+
+/* Lookups of the source or destination side of the packet whose state is st.  Any address may be
+ * looked up on either side, the side only picks the cache entry.
+ */
+#define cali_rt_lookup_src(st, addr)		cali_rt_lookup_cached(&(st)->rt_cache.src, (addr))
+#define cali_rt_lookup_dst(st, addr)		cali_rt_lookup_cached(&(st)->rt_cache.dst, (addr))
+#define cali_rt_lookup_flags_src(st, addr)	cali_rt_lookup_flags_cached(&(st)->rt_cache.src, (addr))
+#define cali_rt_lookup_flags_dst(st, addr)	cali_rt_lookup_flags_cached(&(st)->rt_cache.dst, (addr))
+
+#define rt_addr_is_local_host_src(st, addr)	cali_rt_flags_local_host(cali_rt_lookup_flags_src(st, addr))
+#define rt_addr_is_local_host_dst(st, addr)	cali_rt_flags_local_host(cali_rt_lookup_flags_dst(st, addr))
+#define rt_addr_is_remote_host_src(st, addr)	cali_rt_flags_remote_host(cali_rt_lookup_flags_src(st, addr))
+#define rt_addr_is_remote_host_dst(st, addr)	cali_rt_flags_remote_host(cali_rt_lookup_flags_dst(st, addr))
+
 static CALI_BPF_INLINE bool rt_addr_is_local_host(__be32 addr)
 {
 	return  cali_rt_flags_local_host(cali_rt_lookup_flags(addr));
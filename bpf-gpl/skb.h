@@ -94,16 +94,27 @@ static CALI_BPF_INLINE long skb_iphdr_offset(struct __sk_buff *skb)
 	}
 }
 
-/* skb_refresh_hdr_ptrs refreshes the ip_header/nh fields in the context.
+/* ip_opts_len returns the length of the options of the IP header; 0 for a malformed IHL, which
+ * the parsing drops.  The IHL is 4 bits so the result is at most 40.
  */
-static CALI_BPF_INLINE void skb_refresh_hdr_ptrs(struct cali_tc_ctx *ctx)
+static CALI_BPF_INLINE __u32 ip_opts_len(struct iphdr *ip)
+{
+	__u32 ihl = ip->ihl;
+
+	return ihl > 5 ? (ihl - 5) * 4 : 0;
+}
+
+/* skb_refresh_hdr_ptrs refreshes the ip_header/nh fields in the context.  nh skips opts_len
+ * bytes of IP options.
+ */
+static CALI_BPF_INLINE void skb_refresh_hdr_ptrs(struct cali_tc_ctx *ctx, __u32 opts_len)
 {
 	long offset = skb_iphdr_offset(ctx->skb);
 	struct iphdr *ip =  ctx->data_start + offset;
 	CALI_DEBUG("IP id=%d s=%x d=%x\n",
 			bpf_ntohs(ip->id), bpf_ntohl(ip->saddr), bpf_ntohl(ip->daddr));
 	ctx->ip_header = ip;
-	ctx->nh = (void*)(ctx->ip_header+1);
+	ctx->nh = (void*)(ctx->ip_header+1) + opts_len;
 }
 
 #define IPV4_UDP_SIZE		(sizeof(struct iphdr) + sizeof(struct udphdr))
@@ -115,17 +126,7 @@ static CALI_BPF_INLINE void skb_refresh_hdr_ptrs(struct cali_tc_ctx *ctx)
 #define TCP_SIZE (sizeof(struct tcphdr))
 #define ICMP_SIZE (sizeof(struct icmphdr))
 
-/* skb_refresh_validate_ptrs refreshes the packet pointers in the context and validates access
- * to the IP header + nh_len (next header length) bytes.  If the skb is non-linear; attempts to
- * pull in that many bytes if needed.  If the pull fails, the packet pointers can be left invalid.
- *
- * After a successful validation, returns 0 and the following pointers are valid:
- * - ctx->data_start/end
- * - ctx->eth (if this BPF program has access to the L2 header)
- * - ctx->ip_header
- * - ctx->nh/tcp_header/udp_header/icmp_header.
- */
-static CALI_BPF_INLINE int skb_refresh_validate_ptrs(struct cali_tc_ctx *ctx, long nh_len) {
+static CALI_BPF_INLINE int __skb_refresh_validate_ptrs(struct cali_tc_ctx *ctx, long nh_len, bool ip_opts) {
 	int min_size = skb_iphdr_offset(ctx->skb) + IP_SIZE;
 	skb_refresh_start_end(ctx);
 	if (ctx->data_start + (min_size + nh_len) > ctx->data_end) {
@@ -151,11 +152,64 @@ static CALI_BPF_INLINE int skb_refresh_validate_ptrs(struct cali_tc_ctx *ctx, lo
 			return -2;
 		}
 	}
+
+	__u32 opts_len = 0;
+	if (ip_opts) {
+		opts_len = ip_opts_len(ctx->data_start + skb_iphdr_offset(ctx->skb));
+	}
 	// Success, refresh the IP header and next header.
-	skb_refresh_hdr_ptrs(ctx);
+	skb_refresh_hdr_ptrs(ctx, opts_len);
+	if (!opts_len) {
+		return 0;
+	}
+
+	// The options push the next header further in; validate it where it really is.
+	if (ctx->nh + nh_len > ctx->data_end) {
+		if (CALI_F_XDP) {
+			CALI_DEBUG("Too short to have %d bytes of options and next header\n",
+							opts_len + nh_len);
+			return -2;
+		}
+		CALI_DEBUG("Pulling %d bytes with IP options.\n", min_size + opts_len + nh_len);
+		if (bpf_skb_pull_data(ctx->skb, min_size + opts_len + nh_len)) {
+			CALI_DEBUG("Pull failed (options)\n");
+			return -1;
+		}
+		skb_refresh_start_end(ctx);
+		if (ctx->data_start + min_size > ctx->data_end) {
+			return -2;
+		}
+		skb_refresh_hdr_ptrs(ctx, opts_len);
+		if (ctx->nh + nh_len > ctx->data_end) {
+			return -2;
+		}
+	}
 	return 0;
 }
 
+/* skb_refresh_validate_ptrs refreshes the packet pointers in the context and validates access
+ * to the IP header, its options and nh_len (next header length) bytes.  If the skb is
+ * non-linear; attempts to pull in that many bytes if needed.  If the pull fails, the packet
+ * pointers can be left invalid.
+ *
+ * After a successful validation, returns 0 and the following pointers are valid:
+ * - ctx->data_start/end
+ * - ctx->eth (if this BPF program has access to the L2 header)
+ * - ctx->ip_header
+ * - ctx->nh/tcp_header/udp_header/icmp_header, past the IP options.
+ */
+static CALI_BPF_INLINE int skb_refresh_validate_ptrs(struct cali_tc_ctx *ctx, long nh_len) {
+	return __skb_refresh_validate_ptrs(ctx, nh_len, true);
+}
+
+/* skb_refresh_validate_new_hdrs is skb_refresh_validate_ptrs for a program that has just made
+ * room for the IP header that it is about to write: it ignores whatever IHL the room holds, the
+ * next header follows a 20-byte IP header.
+ */
+static CALI_BPF_INLINE int skb_refresh_validate_new_hdrs(struct cali_tc_ctx *ctx, long nh_len) {
+	return __skb_refresh_validate_ptrs(ctx, nh_len, false);
+}
+
 #define skb_ptr_after(skb, ptr) ((void *)((ptr) + 1))
 #define skb_seen(skb) (((skb)->mark & CALI_SKB_MARK_SEEN_MASK) == CALI_SKB_MARK_SEEN)
 
@@ -174,6 +228,44 @@ static CALI_BPF_INLINE __u32 skb_ingress_ifindex(struct __sk_buff *skb)
 #endif
 }
 
+/* ctx_ingress_ifindex returns the ingress interface of the packet in the context; it works for
+ * both TC and XDP programs.
+ */
+static CALI_BPF_INLINE __u32 ctx_ingress_ifindex(struct cali_tc_ctx *ctx)
+{
+	if (CALI_F_XDP) {
+		return ctx->xdp->ingress_ifindex;
+	}
+	return skb_ingress_ifindex(ctx->skb);
+}
+
 #define skb_is_gso(skb) ((skb)->gso_segs > 1)
 
+/* skb_gso_seg_len returns the IP length of the segments that the kernel will cut a GSO packet
+ * into, or 0 if it cannot tell, either because the kernel does not expose the segment size or
+ * because the protocol is not one that we parse.  The L4 header must have been validated.
+ */
+static CALI_BPF_INLINE __u32 skb_gso_seg_len(struct cali_tc_ctx *ctx)
+{
+	__u32 len;
+
+	if (!GSO_SIZE_OK) {
+		return 0;
+	}
+
+	len = ctx->ip_header->ihl * 4;
+	switch (ctx->ip_header->protocol) {
+	case IPPROTO_TCP:
+		len += ctx->tcp_header->doff * 4;
+		break;
+	case IPPROTO_UDP:
+		len += sizeof(struct udphdr);
+		break;
+	default:
+		return 0;
+	}
+
+	return len + ctx->skb->gso_size;
+}
+
 #endif /* __SKB_H__ */
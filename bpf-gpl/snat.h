@@ -0,0 +1,250 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_SNAT_H__
+#define __CALI_SNAT_H__
+
+#include "bpf.h"
+#include "skb.h"
+#include "conntrack.h"
+
+/* NAT-outgoing in the BPF programs.  Without it, the program of a workload in a NAT-outgoing pool
+ * marks the flows that leave the cluster for iptables to MASQUERADE, which takes every packet of
+ * those flows through the host IP stack and Linux conntrack.  With SNAT_PORTS set, the program
+ * SNATs the TCP and UDP flows itself, to SNAT_IP and a source port of its choosing, and tracks them
+ * with a pair of conntrack entries like the ones of a DNATted flow:
+ *
+ * - the NAT_REV entry is keyed on SNAT_IP:port and the remote side, it holds the legs of the flow
+ *   and the workload's address and port in orig_ip/orig_port,
+ * - the NAT_FWD entry is keyed on the workload and the remote side and points to the NAT_REV entry.
+ *
+ * Both are flagged with CALI_CT_FLAG_SNAT.  The packets from the workload hit the NAT_FWD entry and
+ * get their source translated; the replies arrive at the host endpoint, addressed to the host, hit
+ * the NAT_REV entry and get their destination translated back to the workload.
+ *
+ * The conntrack map is the port allocator: a port is in use for as long as a NAT_REV entry holds it
+ * for a remote side, the same port can be in use for many remote sides at the same time.  The
+ * programs look for a free port starting from a per-CPU cursor and create the NAT_REV entry with
+ * BPF_NOEXIST so that two CPUs that pick the same port for the same remote side can't both win.
+ * Felix reserves SNAT_PORTS in ip_local_reserved_ports, or checks that they are outside
+ * ip_local_port_range, or the replies to the host's own connections and to the workloads' flows
+ * could be mixed up.
+ *
+ * If there is no free port among the few that a program tries, the flow is left to iptables as
+ * before, as are the flows that aren't TCP or UDP and the flows that leave the host through an
+ * interface other than the one that owns SNAT_IP, see snat_egress_ok().  SNAT_PORTS must not
+ * overlap the ports that iptables MASQUERADE uses either, Linux conntrack doesn't know about our
+ * entries; the config rejects a NATPortRange that overlaps them.
+ */
+
+#define SNAT_PORT_MIN	((__u16)(SNAT_PORTS >> 16))
+#define SNAT_PORT_COUNT	((__u16)SNAT_PORTS)
+
+/* SNAT_PORT_TRIES is the number of ports that a program tries for a new flow. */
+#ifndef SNAT_PORT_TRIES
+#define SNAT_PORT_TRIES	8
+#endif
+
+/* cali_v4_snat_port holds the port that each CPU tries next.
+ * WARNING: must be kept in sync with SNATPortMapParams in bpf/conntrack/snat.go.
+ */
+CALI_MAP_V1(cali_v4_snat_port,
+		BPF_MAP_TYPE_PERCPU_ARRAY,
+		__u32, __u32,
+		1, 0, MAP_PIN_GLOBAL)
+
+/* snat_egress_ok returns true if the flow leaves the host through SNAT_IFINDEX, the interface that
+ * owns SNAT_IP.  iptables MASQUERADE picks the address of the interface that the flow leaves
+ * through; the replies to a flow that we SNATed to SNAT_IP but that left through another
+ * interface may not find their way back, so we leave those flows to iptables.
+ */
+static CALI_BPF_INLINE bool snat_egress_ok(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	if (!SNAT_IFINDEX) {
+		return true;
+	}
+
+	struct bpf_fib_lookup fib_params = {
+		.family = 2, /* AF_INET */
+		.tot_len = bpf_ntohs(ctx->ip_header->tot_len),
+		.ifindex = ctx->skb->ingress_ifindex,
+		.l4_protocol = state->ip_proto,
+		.sport = bpf_htons(state->sport),
+		.dport = bpf_htons(state->post_nat_dport),
+	};
+
+	/* set the ipv4 here, otherwise the ipv4/6 unions do not get zeroed properly */
+	fib_params.ipv4_src = state->ip_src;
+	fib_params.ipv4_dst = state->post_nat_ip_dst;
+
+	/* Only the egress interface matters, the kernel sets it before it looks for the neighbour. */
+	int rc = bpf_fib_lookup(ctx->skb, &fib_params, sizeof(fib_params), 0);
+	if (rc != BPF_FIB_LKUP_RET_SUCCESS && rc != BPF_FIB_LKUP_RET_NO_NEIGH) {
+		CALI_DEBUG("SNAT: FIB lookup failed (%d), leaving it to iptables\n", rc);
+		return false;
+	}
+	if (fib_params.ifindex != SNAT_IFINDEX) {
+		CALI_DEBUG("SNAT: flow leaves through iface %d, leaving it to iptables\n",
+				fib_params.ifindex);
+		return false;
+	}
+	return true;
+}
+
+/* snat_possible returns true if the program can SNAT a new NAT-outgoing flow itself. */
+static CALI_BPF_INLINE bool snat_possible(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	if (!CALI_F_FROM_WEP || !SNAT_PORT_COUNT) {
+		return false;
+	}
+	if (state->flags & CALI_ST_FRAG_TAIL) {
+		return false;
+	}
+	if (state->ip_proto != IPPROTO_TCP && state->ip_proto != IPPROTO_UDP) {
+		return false;
+	}
+	return snat_egress_ok(ctx);
+}
+
+/* snat_alloc_port returns a source port for a new flow to the post-NAT destination of the packet
+ * that no flow from SNAT_IP to that destination uses, or 0 if it didn't find one.
+ */
+static CALI_BPF_INLINE __u16 snat_alloc_port(struct cali_tc_state *state)
+{
+	__u32 zero = 0;
+	__u32 *cursor = cali_v4_snat_port_lookup_elem(&zero);
+	__u16 port = 0;
+	int i;
+
+	if (!cursor) {
+		return 0;
+	}
+
+	__u32 next = *cursor;
+	if (!next) {
+		/* Start each CPU somewhere else in the range so that they don't all try the same
+		 * ports. */
+		next = bpf_get_prandom_u32();
+	}
+
+#pragma clang loop unroll(full)
+	for (i = 0; i < SNAT_PORT_TRIES; i++) {
+		__u16 candidate = SNAT_PORT_MIN + next % SNAT_PORT_COUNT;
+		bool sltd = src_lt_dest(SNAT_IP, state->post_nat_ip_dst, candidate, state->post_nat_dport);
+		struct calico_ct_key k = ct_make_key(sltd, state->ip_proto,
+				SNAT_IP, state->post_nat_ip_dst, candidate, state->post_nat_dport);
+
+		next++;
+		if (!cali_v4_ct_lookup_elem(&k)) {
+			port = candidate;
+			break;
+		}
+	}
+
+	*cursor = next;
+	return port;
+}
+
+/* snat_conntrack_create allocates a source port for a new NAT-outgoing flow and creates its
+ * NAT_REV and NAT_FWD entries.  ct_ctx describes the flow as it leaves the workload.  It returns
+ * the port, or 0 if the flow must be left to iptables, in which case ct_ctx is unchanged.
+ */
+static CALI_BPF_INLINE __u16 snat_conntrack_create(struct cali_tc_ctx *ctx, struct ct_create_ctx *ct_ctx)
+{
+	__u16 port = snat_alloc_port(ctx->state);
+
+	if (!port) {
+		CALI_DEBUG("SNAT: no free port to %x:%d\n",
+				bpf_ntohl(ct_ctx->dst), ct_ctx->dport);
+		return 0;
+	}
+
+	__u8 flags = ct_ctx->flags;
+
+	ct_ctx->orig_dst = ct_ctx->src;
+	ct_ctx->orig_dport = ct_ctx->sport;
+	ct_ctx->src = SNAT_IP;
+	ct_ctx->sport = port;
+	ct_ctx->type = CALI_CT_TYPE_NAT_REV;
+	ct_ctx->flags = (flags & ~CALI_CT_FLAG_NAT_OUT) | CALI_CT_FLAG_SNAT;
+
+	if (conntrack_create(ctx, ct_ctx)) {
+		CALI_DEBUG("SNAT: failed to create conntrack for port %d\n", port);
+		ct_ctx->src = ct_ctx->orig_dst;
+		ct_ctx->sport = ct_ctx->orig_dport;
+		ct_ctx->orig_dst = 0;
+		ct_ctx->orig_dport = 0;
+		ct_ctx->type = CALI_CT_TYPE_NORMAL;
+		ct_ctx->flags = flags;
+		return 0;
+	}
+
+	CALI_DEBUG("SNAT: allocated %x:%d\n", bpf_ntohl(SNAT_IP), port);
+	return port;
+}
+
+/* snat_icmp_related_reverse translates an ICMP error about a flow that we SNATed, which arrives at
+ * the host endpoint addressed to SNAT_IP, for the workload: the outer destination and the source of
+ * the embedded packet go back to the workload's address and port in the conntrack result.
+ * It returns non-zero if the packet must be dropped.
+ */
+static CALI_BPF_INLINE int snat_icmp_related_reverse(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+	__be32 nat_ip = state->ct_result.nat_ip;
+	__be16 nat_port = bpf_htons(state->ct_result.nat_port);
+
+	if (skb_refresh_validate_ptrs(ctx, ICMP_SIZE + sizeof(struct iphdr) + 8)) {
+		return -1;
+	}
+
+	struct iphdr *ip_inner = (struct iphdr *)(ctx->icmp_header + 1);
+	if (ip_inner->ihl != 5) {
+		return -1;
+	}
+
+	long icmp_csum_off = skb_l4hdr_offset(ctx->skb, ctx->ip_header->ihl * 4) +
+		offsetof(struct icmphdr, checksum);
+
+	ctx->ip_header->daddr = nat_ip;
+	ip_csum_replace4(ctx->ip_header, state->ip_dst, nat_ip);
+
+	/* In the ICMP checksum, the new checksum of the embedded IP header makes up for its new
+	 * source but not for the new port, which is at the start of both TCP and UDP headers.
+	 */
+	__be32 old_ip = ip_inner->saddr;
+	ip_inner->saddr = nat_ip;
+	ip_csum_replace4(ip_inner, old_ip, nat_ip);
+
+	__be16 *port = (__be16 *)(ip_inner + 1);
+	__be16 old_port = *port;
+	*port = nat_port;
+
+	state->ip_dst = nat_ip;
+
+	if (bpf_l4_csum_replace(ctx->skb, icmp_csum_off, old_port, nat_port, 2)) {
+		return -1;
+	}
+
+	return skb_refresh_validate_ptrs(ctx, ICMP_SIZE);
+}
+
+#endif /* __CALI_SNAT_H__ */
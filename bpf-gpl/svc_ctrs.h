@@ -0,0 +1,72 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_SVC_CTRS_H__
+#define __CALI_SVC_CTRS_H__
+
+#include "bpf.h"
+
+/* Per-service counters of the NAT lookups of new flows.  Felix exports them with the names of the
+ * services, which the proxy knows by the IDs of their frontends.  The IDs are not dense, a service
+ * gets a new one when most of its backends change, so the counters are in an LRU hash rather than
+ * an array and the counters of the IDs that are no longer in use age out.  Only the first packet
+ * of a flow does the lookup, the packets of known flows hit conntrack and skip it.
+ *
+ * WARNING: must be kept in sync with the definitions in bpf/nat/svc_counters.go.
+ */
+enum cali_svc_ctr {
+	/* Flows that got a backend. */
+	CALI_SVC_CTR_NEW_FLOWS = 0,
+	/* Flows that were refused because the service had no backend. */
+	CALI_SVC_CTR_NO_BACKEND,
+	/* Flows that were dropped because their source was not in the source ranges of the
+	 * load balancer. */
+	CALI_SVC_CTR_SRC_RANGE_DROPS,
+
+	CALI_SVC_CTR_MAX,
+};
+
+struct cali_svc_ctrs {
+	__u64 c[CALI_SVC_CTR_MAX];
+};
+
+CALI_MAP_V1(cali_v4_svc_ctrs,
+		BPF_MAP_TYPE_LRU_PERCPU_HASH,
+		__u32, struct cali_svc_ctrs,
+		16 * 1024, 0, MAP_PIN_GLOBAL)
+
+/* svc_ctr_inc counts a NAT lookup of the service with the given ID. */
+static CALI_BPF_INLINE void svc_ctr_inc(__u32 id, enum cali_svc_ctr idx)
+{
+	if (!SVC_CTRS_ENABLED) {
+		return;
+	}
+
+	struct cali_svc_ctrs *ctrs = cali_v4_svc_ctrs_lookup_elem(&id);
+	if (!ctrs) {
+		struct cali_svc_ctrs zero = {};
+		cali_v4_svc_ctrs_update_elem(&id, &zero, BPF_NOEXIST);
+		ctrs = cali_v4_svc_ctrs_lookup_elem(&id);
+		if (!ctrs) {
+			return;
+		}
+	}
+	/* Per-CPU map so no need for an atomic add. */
+	ctrs->c[idx]++;
+}
+
+#endif /* __CALI_SVC_CTRS_H__ */
@@ -0,0 +1,257 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_SYNCOOKIE_H__
+#define __CALI_SYNCOOKIE_H__
+
+/* With SYNCOOKIES_ENABLED, the XDP program answers the SYNs to the host's own listening sockets
+ * on the ports in cali_syncookie with a SYN cookie, without involving the TC programs.  Only the
+ * ACKs that carry a valid cookie reach TC, which then treats them as new flows: it runs policy
+ * and creates the conntrack entry as it would for the SYN.  A SYN flood from spoofed sources then
+ * costs neither conntrack entries nor policy evaluations.
+ *
+ * The XDP program tells TC that it validated the cookie through the packet's metadata.  The
+ * kernel only issues cookies for a listener if net.ipv4.tcp_syncookies is 2, which Felix sets
+ * when the feature is enabled; otherwise the SYNs go through the stack as usual.
+ */
+
+/* Map: the TCP ports of host services whose SYNs the XDP program answers.
+ * WARNING: must be kept in sync with SynCookiePortsMapParams in bpf/xdp/map.go.
+ */
+CALI_MAP_V1(cali_syncookie,
+		BPF_MAP_TYPE_HASH,
+		__u32, __u32,
+		256, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* CALI_XDP_META_SYNCOOKIE is the metadata of an ACK that carries a valid SYN cookie. */
+#define CALI_XDP_META_SYNCOOKIE 0xca11c00c
+
+/* The window of our SYN-ACK; without the timestamp option the cookie can't carry a window scale. */
+#define SYNCOOKIE_WINDOW 0xffff
+
+#if CALI_F_XDP
+
+/* syncookie_csum_fold folds the sum from bpf_csum_diff() into a checksum. */
+static CALI_BPF_INLINE __u16 syncookie_csum_fold(__s64 sum)
+{
+	__u32 s = (__u32)sum;
+
+	s = (s & 0xffff) + (s >> 16);
+	s = (s & 0xffff) + (s >> 16);
+	return (__u16)~s;
+}
+
+static CALI_BPF_INLINE bool syncookie_port(__u16 dport)
+{
+	__u32 key = dport;
+
+	return cali_syncookie_lookup_elem(&key) != NULL;
+}
+
+/* syncookie_listener returns the listening socket for the packet, or NULL if there is none or if
+ * the packet belongs to a connection that already has a socket.  The caller must release it.
+ */
+static CALI_BPF_INLINE struct bpf_sock *syncookie_listener(struct cali_tc_ctx *ctx)
+{
+	struct bpf_sock_tuple tuple = {
+		.ipv4 = {
+			.saddr = ctx->ip_header->saddr,
+			.daddr = ctx->ip_header->daddr,
+			.sport = ctx->tcp_header->source,
+			.dport = ctx->tcp_header->dest,
+		},
+	};
+	struct bpf_sock *sk = bpf_skc_lookup_tcp(ctx->xdp, &tuple, sizeof(tuple.ipv4),
+						 BPF_F_CURRENT_NETNS, 0);
+
+	if (!sk) {
+		return NULL;
+	}
+	if (sk->state != BPF_TCP_LISTEN) {
+		bpf_sk_release(sk);
+		return NULL;
+	}
+	return sk;
+}
+
+/* syncookie_reply turns the SYN into a SYN-ACK that carries the cookie and sends it back out
+ * of the interface.  The only option is the MSS, which the cookie encodes; the other options
+ * become NOPs so that the headers keep their size.
+ */
+static CALI_BPF_INLINE int syncookie_reply(struct cali_tc_ctx *ctx, __u32 th_len, __u32 cookie, __u16 mss)
+{
+	struct ethhdr *eth = ctx->eth;
+	struct iphdr *ip = ctx->ip_header;
+	struct tcphdr *tcp = ctx->tcp_header;
+	__u8 mac[ETH_ALEN];
+
+	__builtin_memcpy(mac, eth->h_source, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, eth->h_dest, ETH_ALEN);
+	__builtin_memcpy(eth->h_dest, mac, ETH_ALEN);
+
+	__be32 addr = ip->saddr;
+	ip->saddr = ip->daddr;
+	ip->daddr = addr;
+	ip->tos = 0;
+	ip->tot_len = bpf_htons(sizeof(struct iphdr) + th_len);
+	ip->id = 0;
+	ip->frag_off = bpf_htons(0x4000); /* DF */
+	ip->ttl = 64;
+	ip->check = 0;
+	ip->check = syncookie_csum_fold(bpf_csum_diff(0, 0, (void *)ip, sizeof(struct iphdr), 0));
+
+	__be16 port = tcp->source;
+	tcp->source = tcp->dest;
+	tcp->dest = port;
+	tcp->ack_seq = bpf_htonl(bpf_ntohl(tcp->seq) + 1);
+	tcp->seq = bpf_htonl(cookie);
+	tcp->res1 = 0;
+	tcp->fin = 0;
+	tcp->rst = 0;
+	tcp->psh = 0;
+	tcp->urg = 0;
+	tcp->ece = 0;
+	tcp->cwr = 0;
+	tcp->syn = 1;
+	tcp->ack = 1;
+	tcp->window = bpf_htons(SYNCOOKIE_WINDOW);
+	tcp->urg_ptr = 0;
+
+	__u8 *opts = (void *)(tcp + 1);
+	if (th_len > sizeof(struct tcphdr)) {
+		if ((void *)(opts + 4) > ctx->data_end) {
+			return XDP_DROP;
+		}
+		opts[0] = 2; /* TCPOPT_MSS */
+		opts[1] = 4;
+		opts[2] = mss >> 8;
+		opts[3] = mss & 0xff;
+
+		#pragma clang loop unroll(full)
+		for (int i = 1; i < 10; i++) {
+			__u32 *word = (__u32 *)opts + i;
+			if (sizeof(struct tcphdr) + i * 4 >= th_len || (void *)(word + 1) > ctx->data_end) {
+				break;
+			}
+			*word = 0x01010101; /* TCPOPT_NOP */
+		}
+	}
+
+	struct {
+		__u8 zero;
+		__u8 proto;
+		__be16 len;
+	} pseudo = {
+		.proto = IPPROTO_TCP,
+		.len = bpf_htons(th_len),
+	};
+	tcp->check = 0;
+	__s64 sum = bpf_csum_diff(0, 0, (void *)&ip->saddr, 2 * sizeof(__be32), 0);
+	sum = bpf_csum_diff(0, 0, (void *)&pseudo, sizeof(pseudo), sum);
+	sum = bpf_csum_diff(0, 0, (void *)tcp, th_len, sum);
+	tcp->check = syncookie_csum_fold(sum);
+
+	return XDP_TX;
+}
+
+/* xdp_syncookie handles the TCP packets to the ports in cali_syncookie.  It answers SYNs with a
+ * SYN cookie, passes ACKs that carry a valid cookie up to TC, flagged in the metadata, and drops
+ * the other ACKs to the listener.  It returns -1 for packets that it leaves to the rest of the
+ * program: those that belong to a connection that already has a socket, those that the
+ * kernel wouldn't issue a cookie for and those with IP options, as the SYN-ACK and the cookie
+ * helpers assume a 20-byte IP header.
+ */
+static CALI_BPF_INLINE int xdp_syncookie(struct cali_tc_ctx *ctx)
+{
+	struct tcphdr *tcp = ctx->tcp_header;
+	bool syn = tcp->syn && !tcp->ack;
+	bool ack = tcp->ack && !tcp->syn && !tcp->rst;
+
+	if (!syn && !ack) {
+		return -1;
+	}
+	if (ctx->ip_header->ihl != 5) {
+		CALI_DEBUG("XDP: SYN cookie candidate with IP options, to the stack.\n");
+		return -1;
+	}
+	if (!syncookie_port(ctx->state->dport)) {
+		return -1;
+	}
+
+	__u32 th_len = tcp->doff * 4;
+	if (th_len < sizeof(struct tcphdr) || (void *)tcp + th_len > ctx->data_end) {
+		return -1;
+	}
+
+	struct bpf_sock *sk = syncookie_listener(ctx);
+	if (!sk) {
+		return -1;
+	}
+
+	if (syn) {
+		__s64 rc = bpf_tcp_gen_syncookie(sk, ctx->ip_header, sizeof(struct iphdr), tcp, th_len);
+		bpf_sk_release(sk);
+		if (rc < 0) {
+			CALI_DEBUG("XDP: no SYN cookie (%d), SYN to the stack.\n", rc);
+			return -1;
+		}
+		counter_inc(ctx->counters, CALI_COUNTER_SYNCOOKIE_SENT);
+		CALI_DEBUG("XDP: SYN to port %d, replying with a SYN cookie.\n", ctx->state->dport);
+		return syncookie_reply(ctx, th_len, (__u32)rc, (__u16)(rc >> 32));
+	}
+
+	long rc = bpf_tcp_check_syncookie(sk, ctx->ip_header, sizeof(struct iphdr), tcp, th_len);
+	bpf_sk_release(sk);
+	if (rc) {
+		counter_inc(ctx->counters, CALI_COUNTER_SYNCOOKIE_INVALID);
+		CALI_DEBUG("XDP: ACK to listener on port %d without valid SYN cookie: DROP\n",
+				ctx->state->dport);
+		return XDP_DROP;
+	}
+	counter_inc(ctx->counters, CALI_COUNTER_SYNCOOKIE_VALID);
+
+	if (bpf_xdp_adjust_meta(ctx->xdp, -(int)sizeof(__u32))) {
+		CALI_DEBUG("XDP: no room for metadata, ACK to the stack unflagged.\n");
+		return XDP_PASS;
+	}
+	__u32 *meta = (void *)(long)ctx->xdp->data_meta;
+	if ((void *)(meta + 1) > (void *)(long)ctx->xdp->data) {
+		return XDP_PASS;
+	}
+	*meta = CALI_XDP_META_SYNCOOKIE;
+	CALI_DEBUG("XDP: ACK with valid SYN cookie: PASS\n");
+	return XDP_PASS;
+}
+
+#else /* !CALI_F_XDP */
+
+/* skb_syncookie_validated returns true if the XDP program validated the SYN cookie of the
+ * packet, see xdp_syncookie().
+ */
+static CALI_BPF_INLINE bool skb_syncookie_validated(struct __sk_buff *skb)
+{
+	__u32 *meta = (void *)(long)skb->data_meta;
+
+	if ((void *)(meta + 1) > (void *)(long)skb->data) {
+		return false;
+	}
+	return *meta == CALI_XDP_META_SYNCOOKIE;
+}
+
+#endif /* CALI_F_XDP */
+
+#endif /* __CALI_SYNCOOKIE_H__ */
@@ -48,6 +48,32 @@
 #include "policy_program.h"
 #include "parsing.h"
 #include "failsafe.h"
+#include "policy_cache.h"
+#include "pol_lat.h"
+#include "syncookie.h"
+#include "untracked.h"
+#include "edt.h"
+#include "frags.h"
+#include "snat.h"
+
+/* tc_state_init prepares the state for a new packet.  Rather than zeroing the whole state, it only
+ * zeroes the fields that the program may read before it writes them, which depends on the hook.
+ * The packet fields at the start of the state are read all over, the route cache must start
+ * empty and the policy program starts from the top.  The conntrack result and the NAT dest are
+ * written before the policy program and the epilogue read them; only the paths that exit early
+ * read them before that, on the hooks towards the host and when we emit flow events. */
+static CALI_BPF_INLINE void tc_state_init(struct cali_tc_state *state)
+{
+	__builtin_memset(state, 0, offsetof(struct cali_tc_state, ct_result));
+	if (CALI_F_TO_HOST || EVENTS_SAMPLE_RATE || PROG_LAT_ENABLED) {
+		__builtin_memset(&state->ct_result, 0, sizeof(state->ct_result));
+		__builtin_memset(&state->nat_dest, 0, sizeof(state->nat_dest));
+	}
+	state->rt_cache.src.state = CALI_RT_CACHE_EMPTY;
+	state->rt_cache.dst.state = CALI_RT_CACHE_EMPTY;
+	state->pol_resume = 0;
+	state->now = cali_now();
+}
 
 /* calico_tc is the main function used in all of the tc programs.  It is specialised
  * for particular hook at build time based on the CALI_F build flags.
@@ -62,10 +88,22 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 #endif
 	CALI_DEBUG("New packet at ifindex=%d; mark=%x\n", skb->ifindex, skb->mark);
 
+	struct cali_counters *counters = counters_get();
+	counter_inc(counters, CALI_COUNTER_TOTAL_PACKETS);
+
+	/* Bandwidth shaping applies to everything that leaves, including the packets that other
+	 * programs pre-approved, so it comes first. */
+	if (EDT_ENABLED && edt_sched_departure(skb, counters)) {
+		CALI_DEBUG("Packet beyond the bandwidth limit horizon: DROP\n");
+		counter_inc(counters, CALI_COUNTER_DROPPED);
+		return TC_ACT_SHOT;
+	}
+
 	/* Optimisation: if another BPF program has already pre-approved the packet,
 	 * skip all processing. */
 	if (!CALI_F_TO_HOST && skb->mark == CALI_SKB_MARK_BYPASS) {
 		CALI_INFO("Final result=ALLOW (%d). Bypass mark bit set.\n", CALI_REASON_BYPASS);
+		counters_record_verdict(counters, false, CALI_REASON_BYPASS);
 		return TC_ACT_UNSPEC;
 	}
 
@@ -78,14 +116,16 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 			.res = TC_ACT_UNSPEC,
 			.reason = CALI_REASON_UNKNOWN,
 		},
+		.counters = counters,
+		.iface_cfg = iface_cfg_get(skb_wep_ifindex(skb)),
 	};
 	if (!ctx.state) {
 		CALI_DEBUG("State map lookup failed: DROP\n");
 		return TC_ACT_SHOT;
 	}
-	__builtin_memset(ctx.state, 0, sizeof(*ctx.state));
+	tc_state_init(ctx.state);
 
-	if (CALI_LOG_LEVEL >= CALI_LOG_LEVEL_INFO) {
+	if (CALI_LOG_LEVEL >= CALI_LOG_LEVEL_INFO || PROG_LAT_ENABLED) {
 		ctx.state->prog_start_time = bpf_ktime_get_ns();
 	}
 
@@ -114,22 +154,17 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 			}
 
 			__be32 ip_src = ctx.ip_header->saddr;
-			if (ip_src == HOST_IP) {
+			__be32 host_ip = CTX_HOST_IP(&ctx);
+			if (ip_src == host_ip) {
 				CALI_DEBUG("src ip fixup not needed %x\n", bpf_ntohl(ip_src));
 				goto allow;
 			} else {
-				CALI_DEBUG("src ip fixup %x\n", bpf_ntohl(HOST_IP));
+				CALI_DEBUG("src ip fixup %x\n", bpf_ntohl(host_ip));
 			}
 
 			/* XXX do a proper CT lookup to find this */
-			ctx.ip_header->saddr = HOST_IP;
-			int l3_csum_off = skb_iphdr_offset(skb) + offsetof(struct iphdr, check);
-
-			int res = bpf_l3_csum_replace(skb, l3_csum_off, ip_src, HOST_IP, 4);
-			if (res) {
-				ctx.fwd.reason = CALI_REASON_CSUM_FAIL;
-				goto deny;
-			}
+			ctx.ip_header->saddr = host_ip;
+			ip_csum_replace4(ctx.ip_header, ip_src, host_ip);
 
 			goto allow;
 		}
@@ -153,7 +188,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 	/* Now we've got as far as the UDP header, check if this is one of our VXLAN packets, which we
 	 * use to forward traffic for node ports. */
 	if (dnat_should_decap() /* Compile time: is this a BPF program that should decap packets? */ &&
-			is_vxlan_tunnel(ctx.ip_header) /* Is this a VXLAN packet? */ ) {
+			is_vxlan_tunnel(&ctx) /* Is this a VXLAN packet? */ ) {
 		/* Decap it; vxlan_attempt_decap will revalidate the packet if needed. */
 		switch (vxlan_attempt_decap(&ctx)) {
 		case -1:
@@ -170,6 +205,22 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 	/* Copy fields that are needed by downstream programs from the packet to the state. */
 	tc_state_fill_from_iphdr(ctx.state, ctx.ip_header);
 
+	if (LEAN_TUNNEL) {
+		/* The tunnel and wireguard programs allow everything.  A decapsulated or decrypted
+		 * packet goes through the program of the endpoint that it is routed to and that
+		 * program tracks, and NATs, the connection so don't do it twice.  Packets towards
+		 * the host still get the SEEN mark from forward_or_drop(). */
+		if (ctx.state->ip_proto == 4) {
+			// IPIP should never be sent down the tunnel.
+			CALI_DEBUG("IPIP traffic to/from tunnel: drop\n");
+			ctx.fwd.reason = CALI_REASON_UNAUTH_SOURCE;
+			goto deny;
+		}
+		CALI_DEBUG("Lean tunnel program, allow without conntrack.\n");
+		fwd_fib_set(&ctx.fwd, false);
+		goto allow;
+	}
+
 	/* Parse out the source/dest ports (or type/code for ICMP). */
 	switch (ctx.state->ip_proto) {
 	case IPPROTO_TCP:
@@ -184,15 +235,28 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 		CALI_DEBUG("TCP; ports: s=%d d=%d\n", ctx.state->sport, ctx.state->dport);
 		break;
 	case IPPROTO_UDP:
+		if (ip_frag_no(ctx.ip_header)) {
+			/* A trailing fragment, it has no UDP header, see frags.h. */
+			ctx.state->flags |= CALI_ST_FRAG_TAIL;
+			if (!frags_lookup(ctx.ip_header, &ctx.state->sport, &ctx.state->dport)) {
+				CALI_DEBUG("UDP fragment of an unknown datagram\n");
+				ctx.state->sport = ctx.state->dport = 0;
+			}
+			CALI_DEBUG("UDP fragment; ports: s=%d d=%d\n", ctx.state->sport, ctx.state->dport);
+			break;
+		}
 		ctx.state->sport = bpf_ntohs(ctx.udp_header->source);
 		ctx.state->dport = bpf_ntohs(ctx.udp_header->dest);
 		CALI_DEBUG("UDP; ports: s=%d d=%d\n", ctx.state->sport, ctx.state->dport);
-		if (ctx.state->dport == VXLAN_PORT) {
+		if (ip_is_first_frag(ctx.ip_header)) {
+			frags_record(ctx.ip_header, ctx.state->sport, ctx.state->dport);
+		}
+		if (ctx.state->dport == CTX_VXLAN_PORT(&ctx)) {
 			/* CALI_F_FROM_HEP case is handled in vxlan_attempt_decap above since it already decoded
 			 * the header. */
 			if (CALI_F_TO_HEP) {
-				if (rt_addr_is_remote_host(ctx.state->ip_dst) &&
-						rt_addr_is_local_host(ctx.state->ip_src)) {
+				if (rt_addr_is_remote_host_dst(ctx.state, ctx.state->ip_dst) &&
+						rt_addr_is_local_host_src(ctx.state, ctx.state->ip_src)) {
 					CALI_DEBUG("VXLAN packet to known Calico host, allow.\n");
 					goto allow;
 				} else {
@@ -216,7 +280,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 			goto deny;
 		}
 		if (CALI_F_FROM_HEP) {
-			if (rt_addr_is_remote_host(ctx.state->ip_src)) {
+			if (rt_addr_is_remote_host_src(ctx.state, ctx.state->ip_src)) {
 				CALI_DEBUG("IPIP packet from known Calico host, allow.\n");
 				goto allow;
 			} else {
@@ -225,7 +289,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 				goto deny;
 			}
 		} else if (CALI_F_TO_HEP && !CALI_F_TUNNEL && !CALI_F_WIREGUARD) {
-			if (rt_addr_is_remote_host(ctx.state->ip_dst)) {
+			if (rt_addr_is_remote_host_dst(ctx.state, ctx.state->ip_dst)) {
 				CALI_DEBUG("IPIP packet to known Calico host, allow.\n");
 				goto allow;
 			} else {
@@ -245,10 +309,31 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 
 	ctx.state->pol_rc = CALI_POL_NO_MATCH;
 
+	/* The untracked policy of the host endpoint allowed the packet in the XDP program, it skips
+	 * conntrack and policy, see untracked.h.
+	 */
+	if (CALI_F_FROM_HEP && skb_untracked_accepted(ctx.skb)) {
+		CALI_DEBUG("Allowed by untracked policy in XDP.\n");
+		ctx.fwd.reason = CALI_REASON_DNT;
+		fwd_fib_set(&ctx.fwd, false);
+		goto allow;
+	}
+
 	/* Do conntrack lookup before anything else */
 	ctx.state->ct_result = calico_ct_v4_lookup(&ctx);
 	CALI_DEBUG("conntrack entry flags 0x%x\n", ctx.state->ct_result.flags);
 
+	switch (ct_result_rc(ctx.state->ct_result.rc)) {
+	case CALI_CT_NEW:
+		counter_inc(ctx.counters, CALI_COUNTER_CT_NEW);
+		break;
+	case CALI_CT_MID_FLOW_MISS:
+		counter_inc(ctx.counters, CALI_COUNTER_CT_MISS);
+		break;
+	default:
+		counter_inc(ctx.counters, CALI_COUNTER_CT_HIT);
+	}
+
 	/* Check if someone is trying to spoof a tunnel packet */
 	if (CALI_F_FROM_HEP && ct_result_tun_src_changed(ctx.state->ct_result.rc)) {
 		CALI_DEBUG("dropping tunnel pkt with changed source node\n");
@@ -266,6 +351,15 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 		fwd_fib_set(&ctx.fwd, false);
 	}
 
+	/* The XDP program answered the SYN of this connection with a SYN cookie and validated the
+	 * cookie in this ACK, so it is the first packet of the flow that we see.
+	 */
+	if (CALI_F_FROM_HEP && ct_result_rc(ctx.state->ct_result.rc) == CALI_CT_MID_FLOW_MISS &&
+			skb_syncookie_validated(ctx.skb)) {
+		CALI_DEBUG("CT mid-flow miss on ACK with valid SYN cookie, new flow.\n");
+		ctx.state->ct_result.rc = CALI_CT_NEW;
+	}
+
 	if (ct_result_rc(ctx.state->ct_result.rc) == CALI_CT_MID_FLOW_MISS) {
 		if (CALI_F_TO_HOST) {
 			/* Mid-flow miss: let iptables handle it in case it's an existing flow
@@ -309,9 +403,18 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 
 	/* No conntrack entry, check if we should do NAT */
 	nat_lookup_result nat_res = NAT_LOOKUP_ALLOW;
-	ctx.nat_dest = calico_v4_nat_lookup2(ctx.state->ip_src, ctx.state->ip_dst,
-					     ctx.state->ip_proto, ctx.state->dport,
-					     ctx.state->tun_ip != 0, &nat_res);
+	if (CALI_F_NAT) {
+		ctx.nat_dest = calico_v4_nat_lookup2(ctx.state->ip_src, ctx.state->ip_dst,
+						     ctx.state->ip_proto, ctx.state->sport, ctx.state->dport,
+						     ctx.state->tun_ip != 0, &ctx.state->rt_cache.dst,
+						     ctx.state->now, &nat_res);
+
+		if (ctx.nat_dest != NULL || nat_res == NAT_NO_BACKEND) {
+			counter_inc(ctx.counters, CALI_COUNTER_NAT_FE_HIT);
+		} else {
+			counter_inc(ctx.counters, CALI_COUNTER_NAT_FE_MISS);
+		}
+	}
 
 	if (nat_res == NAT_FE_LOOKUP_DROP) {
 		CALI_DEBUG("Packet is from an unauthorised source: DROP\n");
@@ -333,7 +436,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 	}
 
 	if (CALI_F_TO_WEP && !skb_seen(skb) &&
-			cali_rt_flags_local_host(cali_rt_lookup_flags(ctx.state->ip_src))) {
+			rt_addr_is_local_host_src(ctx.state, ctx.state->ip_src)) {
 		/* Host to workload traffic always allowed.  We discount traffic that was
 		 * seen by another program since it must have come in via another interface.
 		 */
@@ -346,7 +449,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 		/* Do RPF check since it's our responsibility to police that. */
 		CALI_DEBUG("Workload RPF check src=%x skb iface=%d.\n",
 				bpf_ntohl(ctx.state->ip_src), skb->ifindex);
-		struct cali_rt *r = cali_rt_lookup(ctx.state->ip_src);
+		struct cali_rt *r = cali_rt_lookup_src(ctx.state, ctx.state->ip_src);
 		if (!r) {
 			CALI_INFO("Workload RPF fail: missing route.\n");
 			goto deny;
@@ -363,7 +466,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 
 		// Check whether the workload needs outgoing NAT to this address.
 		if (r->flags & CALI_RT_NAT_OUT) {
-			if (!(cali_rt_lookup_flags(ctx.state->post_nat_ip_dst) & CALI_RT_IN_POOL)) {
+			if (!(cali_rt_lookup_flags_dst(ctx.state, ctx.state->post_nat_ip_dst) & CALI_RT_IN_POOL)) {
 				CALI_DEBUG("Source is in NAT-outgoing pool "
 					   "but dest is not, need to SNAT.\n");
 				ctx.state->flags |= CALI_ST_NAT_OUTGOING;
@@ -371,7 +474,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 		}
 		if (!(r->flags & CALI_RT_IN_POOL)) {
 			CALI_DEBUG("Source %x not in IP pool\n", bpf_ntohl(ctx.state->ip_src));
-			r = cali_rt_lookup(ctx.state->post_nat_ip_dst);
+			r = cali_rt_lookup_dst(ctx.state, ctx.state->post_nat_ip_dst);
 			if (!r || !(r->flags & (CALI_RT_WORKLOAD | CALI_RT_HOST))) {
 				CALI_DEBUG("Outside cluster dest %x\n", bpf_ntohl(ctx.state->post_nat_ip_dst));
 				ctx.state->flags |= CALI_ST_SKIP_FIB;
@@ -410,8 +513,8 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 	// For the case where the packet was sent from a socket on this host, get the
 	// sending socket's cookie, so we can reverse a DNAT that the CTLB may have done.
 	// This allows us to give the policy program the pre-DNAT destination as well as
-	// the post-DNAT destination in all cases.
-	__u64 cookie = bpf_get_socket_cookie(ctx.skb);
+	// the post-DNAT destination in all cases.  Without the CTLB, there is nothing to reverse.
+	__u64 cookie = CALI_F_CTLB_REV ? bpf_get_socket_cookie(ctx.skb) : 0;
 	if (cookie) {
 		CALI_DEBUG("Socket cookie: %x\n", cookie);
 		struct ct_nats_key ct_nkey = {
@@ -425,8 +528,25 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 			CALI_DEBUG("Got cali_v4_ct_nats entry; flow was NATted by CTLB.\n");
 			ctx.state->pre_nat_ip_dst = revnat->ip;
 			ctx.state->pre_nat_dport = ctx_port_to_host(revnat->port);
+			ctx.state->flags |= CALI_ST_CTLB_NAT;
 			goto skip_pre_dnat_default;
 		}
+		if (ctx.state->ip_proto == IPPROTO_UDP) {
+			/* The long-lived reverse mapping of sendmsg holds the same translation, it
+			 * covers the UDP flows whose cali_v4_ct_nats entry was evicted. */
+			struct sendrecv4_key sr_key = {
+				.cookie	= cookie,
+				.ip	= ctx.state->ip_dst,
+				.port	= host_to_ctx_port(ctx.state->dport),
+			};
+			revnat = cali_v4_srmsg_lookup_elem(&sr_key);
+			if (revnat) {
+				CALI_DEBUG("Got cali_v4_srmsg entry; flow was NATted by CTLB.\n");
+				ctx.state->pre_nat_ip_dst = revnat->ip;
+				ctx.state->pre_nat_dport = ctx_port_to_host(revnat->port);
+				goto skip_pre_dnat_default;
+			}
+		}
 	}
 	// If we didn't find a CTLB NAT entry then use the packet's own IP/port for the
 	// pre-DNAT values.
@@ -434,7 +554,7 @@ static CALI_BPF_INLINE int calico_tc(struct __sk_buff *skb)
 	ctx.state->pre_nat_dport = ctx.state->dport;
 
 skip_pre_dnat_default:
-	if (rt_addr_is_local_host(ctx.state->post_nat_ip_dst)) {
+	if (rt_addr_is_local_host_dst(ctx.state, ctx.state->post_nat_ip_dst)) {
 		CALI_DEBUG("Post-NAT dest IP is local host.\n");
 		if (CALI_F_FROM_HEP && is_failsafe_in(ctx.state->ip_proto, ctx.state->post_nat_dport, ctx.state->ip_src)) {
 			CALI_DEBUG("Inbound failsafe port: %d. Skip policy.\n", ctx.state->post_nat_dport);
@@ -443,7 +563,7 @@ skip_pre_dnat_default:
 		}
 		ctx.state->flags |= CALI_ST_DEST_IS_HOST;
 	}
-	if (rt_addr_is_local_host(ctx.state->ip_src)) {
+	if (rt_addr_is_local_host_src(ctx.state, ctx.state->ip_src)) {
 		CALI_DEBUG("Source IP is local host.\n");
 		if (CALI_F_TO_HEP && is_failsafe_out(ctx.state->ip_proto, ctx.state->post_nat_dport, ctx.state->post_nat_ip_dst)) {
 			CALI_DEBUG("Outbound failsafe port: %d. Skip policy.\n", ctx.state->post_nat_dport);
@@ -453,8 +573,16 @@ skip_pre_dnat_default:
 		ctx.state->flags |= CALI_ST_SRC_IS_HOST;
 	}
 
+	if (POL_CACHE_ENABLED && pol_cache_lookup(ctx.state, skb_wep_ifindex(skb))) {
+		CALI_DEBUG("Allowed by policy verdict cache. Skip policy.\n");
+		ctx.state->pol_rc = CALI_POL_ALLOW;
+		goto skip_policy;
+	}
+
 	CALI_DEBUG("About to jump to policy program.\n");
-	bpf_tail_call(skb, &cali_jump, PROG_INDEX_POLICY);
+	ctx.state->pol_start_time = bpf_ktime_get_ns();
+	policy_tail_call(skb, skb_wep_ifindex(skb));
+	ctx.state->pol_start_time = 0;
 	if (CALI_F_HEP) {
 		CALI_DEBUG("HEP with no policy, allow.\n");
 		ctx.state->pol_rc = CALI_POL_ALLOW;
@@ -502,12 +630,16 @@ int calico_tc_skb_accepted_entrypoint(struct __sk_buff *skb)
 			.res = TC_ACT_UNSPEC,
 			.reason = CALI_REASON_UNKNOWN,
 		},
+		.counters = counters_get(),
+		.iface_cfg = iface_cfg_get(skb_wep_ifindex(skb)),
 	};
 	if (!ctx.state) {
 		CALI_DEBUG("State map lookup failed: DROP\n");
 		return TC_ACT_SHOT;
 	}
 
+	pol_lat_record(ctx.state);
+
 	if (skb_refresh_validate_ptrs(&ctx, UDP_SIZE)) {
 		ctx.fwd.reason = CALI_REASON_SHORT;
 		CALI_DEBUG("Too short\n");
@@ -530,6 +662,25 @@ deny:
 	return TC_ACT_SHOT;
 }
 
+/* ct_nats_release removes the cali_v4_ct_nats entry of a flow that the connect-time load balancer
+ * NATted once its conntrack entry exists.  Only the first packets of the flow need the entry, freeing
+ * it early stops the busy sockets from evicting the entries of the connections that are yet to send
+ * their first packet.
+ */
+static CALI_BPF_INLINE void ct_nats_release(struct __sk_buff *skb, struct cali_tc_state *state)
+{
+	struct ct_nats_key ct_nkey = {
+		.cookie	= bpf_get_socket_cookie(skb),
+		.proto	= state->ip_proto,
+		.ip	= state->ip_dst,
+		.port	= host_to_ctx_port(state->dport),
+	};
+
+	if (cali_v4_ct_nats_delete_elem(&ct_nkey)) {
+		CALI_DEBUG("cali_v4_ct_nats entry already gone\n");
+	}
+}
+
 static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx,
 							 struct calico_nat_dest *nat_dest)
 {
@@ -544,7 +695,8 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 	int ct_rc = ct_result_rc(state->ct_result.rc);
 	bool ct_related = ct_result_is_related(state->ct_result.rc);
 	__u32 seen_mark;
-	size_t l4_csum_off = 0, l3_csum_off;
+	size_t l4_csum_off = 0;
+	__u32 encap_mtu = 0;
 
 	CALI_DEBUG("src=%x dst=%x\n", bpf_ntohl(state->ip_src), bpf_ntohl(state->ip_dst));
 	CALI_DEBUG("post_nat=%x:%d\n", bpf_ntohl(state->post_nat_ip_dst), state->post_nat_dport);
@@ -561,7 +713,11 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 		state->dport = 0;
 	}
 
-	if (CALI_F_FROM_WEP && (state->flags & CALI_ST_NAT_OUTGOING)) {
+	/* New NAT-outgoing flows are SNATed by us if we can, see snat.h. */
+	bool snat = CALI_F_FROM_WEP && (state->flags & CALI_ST_NAT_OUTGOING) &&
+		ct_rc == CALI_CT_NEW && !ct_related && !nat_dest && snat_possible(ctx);
+
+	if (CALI_F_FROM_WEP && (state->flags & CALI_ST_NAT_OUTGOING) && !snat) {
 		// We are going to SNAT this traffic, using iptables SNAT so set the mark
 		// to trigger that and leave the fib lookup disabled.
 		seen_mark = CALI_SKB_MARK_NAT_OUT;
@@ -594,7 +750,23 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 		}
 	}
 
-	l3_csum_off = skb_iphdr_offset(skb) +  offsetof(struct iphdr, check);
+	if (ct_related && (state->ct_result.flags & CALI_CT_FLAG_SNAT)) {
+		if (ct_rc == CALI_CT_ESTABLISHED_DNAT) {
+			if (snat_icmp_related_reverse(ctx)) {
+				CALI_DEBUG("Failed to reverse SNAT of ICMP related\n");
+				goto deny;
+			}
+			CALI_DEBUG("ICMP related: reversed SNAT to %x\n", bpf_ntohl(state->ip_dst));
+			goto allow;
+		}
+		if (CALI_F_FROM_WEP) {
+			/* An error that the workload sends about a flow that we SNATed would leave
+			 * with the workload's address, don't leak it.
+			 */
+			CALI_DEBUG("ICMP related to SNATed flow from workload: DROP\n");
+			goto deny;
+		}
+	}
 
 	if (ct_related) {
 		if (ctx->ip_header->protocol == IPPROTO_ICMP) {
@@ -608,18 +780,13 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			 * and either DSR from WEP or originated at host ... */
 			outer_ip_snat = outer_ip_snat &&
 				((dnat_return_should_encap() && !CALI_F_DSR) ||
-				 (CALI_F_TO_HEP &&
+				 (CALI_F_TO_HEP && CALI_F_NP_TUNNEL &&
 				  ((CALI_F_DSR && skb_seen(skb)) || !skb_seen(skb))));
 
 			/* ... then fix the outer header IP first */
 			if (outer_ip_snat) {
 				ctx->ip_header->saddr = state->ct_result.nat_ip;
-				int res = bpf_l3_csum_replace(skb, l3_csum_off,
-						state->ip_src, state->ct_result.nat_ip, 4);
-				if (res) {
-					reason = CALI_REASON_CSUM_FAIL;
-					goto deny;
-				}
+				ip_csum_replace4(ctx->ip_header, state->ip_src, state->ct_result.nat_ip);
 				CALI_DEBUG("ICMP related: outer IP SNAT to %x\n",
 						bpf_ntohl(state->ct_result.nat_ip));
 			}
@@ -634,7 +801,6 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			/* Skip past the ICMP header and check the inner IP header.
 			 * WARNING: this modifies the ip_header pointer in the main context; need to
 			 * be careful in later code to avoid overwriting that. */
-			l3_csum_off += sizeof(*ctx->ip_header) + sizeof(struct icmphdr);
 			ctx->ip_header = (struct iphdr *)(ctx->icmp_header + 1); /* skip to inner ip */
 			if (ctx->ip_header->ihl != 5) {
 				CALI_INFO("ICMP inner IP header has options; unsupported\n");
@@ -677,6 +843,8 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 
 	if (state->ip_proto == IPPROTO_ICMP && ct_related) {
 		/* do not fix up embedded L4 checksum for related ICMP */
+	} else if (state->flags & CALI_ST_FRAG_TAIL) {
+		/* The L4 header and its checksum are in the first fragment. */
 	} else {
 		switch (ctx->ip_header->protocol) {
 		case IPPROTO_TCP:
@@ -699,12 +867,14 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			goto deny;
 		case CALI_POL_ALLOW:
 			CALI_DEBUG("Allowed by policy: ACCEPT\n");
+			if (POL_CACHE_ENABLED && (state->flags & CALI_ST_POL_CACHEABLE)) {
+				pol_cache_update(state, skb_wep_ifindex(skb));
+			}
 		}
 
 		if (CALI_F_FROM_WEP &&
 				CALI_DROP_WORKLOAD_TO_HOST &&
-				cali_rt_flags_local_host(
-					cali_rt_lookup_flags(state->post_nat_ip_dst))) {
+				rt_addr_is_local_host_dst(state, state->post_nat_ip_dst)) {
 			CALI_DEBUG("Workload to host traffic blocked by "
 				   "DefaultEndpointToHostAction: DROP\n");
 			goto deny;
@@ -726,6 +896,17 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			ct_ctx_nat.flags |= CALI_CT_FLAG_SKIP_FIB;
 		}
 
+		if (CALI_F_FROM_HEP && CALI_F_NP_TUNNEL && state->tun_ip) {
+			/* The decap kept the eth header of the tunnel packet, the conntrack entry
+			 * records its MACs for the return packets. */
+			if (skb_refresh_validate_ptrs(ctx, UDP_SIZE)) {
+				reason = CALI_REASON_SHORT;
+				CALI_DEBUG("Too short\n");
+				goto deny;
+			}
+			__builtin_memcpy(&ct_ctx_nat.tun_nh, ctx->eth, sizeof(ct_ctx_nat.tun_nh));
+		}
+
 		if (state->ip_proto == IPPROTO_TCP) {
 			if (skb_refresh_validate_ptrs(ctx, TCP_SIZE)) {
 				CALI_DEBUG("Too short for TCP: DROP\n");
@@ -736,18 +917,38 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 
 		// If we get here, we've passed policy.
 
+		if (snat) {
+			__u16 snat_port = snat_conntrack_create(ctx, &ct_ctx_nat);
+
+			if (snat_port) {
+				if (state->flags & CALI_ST_CTLB_NAT) {
+					ct_nats_release(skb, state);
+				}
+				state->ct_result.nat_ip = SNAT_IP;
+				state->ct_result.nat_port = snat_port;
+				state->ct_result.flags |= CALI_CT_FLAG_SNAT;
+				goto snat_source;
+			}
+			/* Leave it to iptables, ct_ctx_nat is still flagged for it. */
+			seen_mark = CALI_SKB_MARK_NAT_OUT;
+			fib = false;
+		}
+
 		if (nat_dest == NULL) {
 			if (conntrack_create(ctx, &ct_ctx_nat)) {
 				CALI_DEBUG("Creating normal conntrack failed\n");
 
-				if ((CALI_F_FROM_HEP && rt_addr_is_local_host(ct_ctx_nat.dst)) ||
-						(CALI_F_TO_HEP && rt_addr_is_local_host(ct_ctx_nat.src))) {
+				if ((CALI_F_FROM_HEP && rt_addr_is_local_host_dst(state, ct_ctx_nat.dst)) ||
+						(CALI_F_TO_HEP && rt_addr_is_local_host_src(state, ct_ctx_nat.src))) {
 					CALI_DEBUG("Allowing local host traffic without CT\n");
 					goto allow;
 				}
 
 				goto deny;
 			}
+			if (state->flags & CALI_ST_CTLB_NAT) {
+				ct_nats_release(skb, state);
+			}
 			goto allow;
 		}
 
@@ -786,7 +987,7 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 				/* When we need to encap, we need to find out if the backend is
 				 * local or not. If local, we actually do not need the encap.
 				 */
-				rt = cali_rt_lookup(state->post_nat_ip_dst);
+				rt = cali_rt_lookup_dst(state, state->post_nat_ip_dst);
 				if (!rt) {
 					reason = CALI_REASON_RT_UNKNOWN;
 					goto deny;
@@ -803,9 +1004,18 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 						ct_ctx_nat.flags |= CALI_CT_FLAG_NP_FWD;
 					}
 
+					__be32 next_hop = cali_rt_next_hop(rt, nat_flow_hash(state->ip_src,
+								state->post_nat_ip_dst, state->ip_proto,
+								state->sport, state->post_nat_dport));
+					if (!next_hop) {
+						reason = CALI_REASON_RT_UNKNOWN;
+						goto deny;
+					}
+					CALI_DEBUG("next hop 0x%x\n", bpf_ntohl(next_hop));
+
 					ct_ctx_nat.allow_return = true;
-					ct_ctx_nat.tun_ip = rt->next_hop;
-					state->ip_dst = rt->next_hop;
+					ct_ctx_nat.tun_ip = next_hop;
+					state->ip_dst = next_hop;
 				} else if (cali_rt_is_workload(rt) && state->ip_dst != state->post_nat_ip_dst) {
 					/* Packet arrived from a HEP for a workload and we're
 					 * about to NAT it.  We can't rely on the kernel's RPF check
@@ -838,12 +1048,12 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			}
 		}
 		if (encap_needed) {
-			if (!(state->ip_proto == IPPROTO_TCP && skb_is_gso(skb)) &&
-					ip_is_dnf(ctx->ip_header) && vxlan_v4_encap_too_big(ctx)) {
+			encap_mtu = vxlan_v4_tun_mtu(ctx, state->ip_dst);
+			if (ip_is_dnf(ctx->ip_header) && vxlan_v4_encap_too_big(ctx, encap_mtu)) {
 				CALI_DEBUG("Request packet with DNF set is too big\n");
 				goto icmp_too_big;
 			}
-			state->ip_src = HOST_IP;
+			state->ip_src = CTX_HOST_IP(ctx);
 			seen_mark = CALI_SKB_MARK_SKIP_RPF;
 
 			/* We cannot enforce RPF check on encapped traffic, do FIB if you can */
@@ -853,8 +1063,9 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 		}
 
 		ctx->ip_header->daddr = state->post_nat_ip_dst;
+		ip_csum_replace4(ctx->ip_header, state->ip_dst, state->post_nat_ip_dst);
 
-		switch (ctx->ip_header->protocol) {
+		switch (state->flags & CALI_ST_FRAG_TAIL ? 0 : ctx->ip_header->protocol) {
 		case IPPROTO_TCP:
 			ctx->tcp_header->dest = bpf_htons(state->post_nat_dport);
 			break;
@@ -863,7 +1074,7 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			break;
 		}
 
-		CALI_VERB("L3 csum at %d L4 csum at %d\n", l3_csum_off, l4_csum_off);
+		CALI_VERB("L4 csum at %d\n", l4_csum_off);
 
 		if (l4_csum_off) {
 			res = skb_nat_l4_csum_ipv4(skb, l4_csum_off, state->ip_dst,
@@ -872,8 +1083,6 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 					ctx->ip_header->protocol == IPPROTO_UDP ? BPF_F_MARK_MANGLED_0 : 0);
 		}
 
-		res |= bpf_l3_csum_replace(skb, l3_csum_off, state->ip_dst, state->post_nat_ip_dst, 4);
-
 		if (res) {
 			reason = CALI_REASON_CSUM_FAIL;
 			goto deny;
@@ -894,7 +1103,7 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 				state->ip_dst = state->ct_result.tun_ip;
 				seen_mark = CALI_SKB_MARK_BYPASS_FWD_SRC_FIXUP;
 				goto nat_encap;
-			} else if (CALI_F_TO_HEP) {
+			} else if (dnat_host_return_should_encap()) {
 				/* Special case for ICMP error being returned by the host with the
 				 * backing workload into the tunnel back to the original host. It is
 				 * ICMP related and there is a return tunnel path. We need to change
@@ -905,21 +1114,37 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 				 * to reinject it to fix the routing?
 				 */
 				CALI_DEBUG("Returning related ICMP from host to tunnel\n");
-				state->ip_src = HOST_IP;
+				state->ip_src = CTX_HOST_IP(ctx);
 				state->ip_dst = state->ct_result.tun_ip;
 				goto nat_encap;
 			}
 		}
 
+		/* Both legs of the flow are approved and it stays on this host, let the program of the
+		 * workload skip its conntrack lookup.
+		 */
+		if (ct_rc == CALI_CT_ESTABLISHED_DNAT && ct_result_bypass_dnat(state->ct_result.rc) &&
+				seen_mark == CALI_SKB_MARK_SEEN &&
+				cali_rt_flags_local_workload(cali_rt_lookup_flags_dst(state, state->post_nat_ip_dst))) {
+			CALI_DEBUG("CT: DNAT to approved local workload, bypass\n");
+			seen_mark = CALI_SKB_MARK_BYPASS;
+		}
+
 		state->dport = state->post_nat_dport;
 		state->ip_dst = state->post_nat_ip_dst;
 
 		goto allow;
 
 	case CALI_CT_ESTABLISHED_SNAT:
+snat_source:
 		CALI_DEBUG("CT: SNAT from %x:%d\n",
 				bpf_ntohl(state->ct_result.nat_ip), state->ct_result.nat_port);
 
+		if (CALI_F_FROM_WEP && (state->ct_result.flags & CALI_CT_FLAG_SNAT)) {
+			/* The source is now the host, we did the workload's RPF check already. */
+			seen_mark = CALI_SKB_MARK_SKIP_RPF;
+		}
+
 		if (dnat_return_should_encap() && state->ct_result.tun_ip) {
 			if (CALI_F_DSR) {
 				/* SNAT will be done after routing, when leaving HEP */
@@ -927,8 +1152,8 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 				goto allow;
 			}
 
-			if (!(state->ip_proto == IPPROTO_TCP && skb_is_gso(skb)) &&
-					ip_is_dnf(ctx->ip_header) && vxlan_v4_encap_too_big(ctx)) {
+			encap_mtu = vxlan_v4_tun_mtu(ctx, state->ct_result.tun_ip);
+			if (ip_is_dnf(ctx->ip_header) && vxlan_v4_encap_too_big(ctx, encap_mtu)) {
 				CALI_DEBUG("Return ICMP mtu is too big\n");
 				goto icmp_too_big;
 			}
@@ -936,8 +1161,9 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 
 		// Actually do the NAT.
 		ctx->ip_header->saddr = state->ct_result.nat_ip;
+		ip_csum_replace4(ctx->ip_header, state->ip_src, state->ct_result.nat_ip);
 
-		switch (ctx->ip_header->protocol) {
+		switch (state->flags & CALI_ST_FRAG_TAIL ? 0 : ctx->ip_header->protocol) {
 		case IPPROTO_TCP:
 			ctx->tcp_header->source = bpf_htons(state->ct_result.nat_port);
 			break;
@@ -946,7 +1172,7 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 			break;
 		}
 
-		CALI_VERB("L3 csum at %d L4 csum at %d\n", l3_csum_off, l4_csum_off);
+		CALI_VERB("L4 csum at %d\n", l4_csum_off);
 
 		if (l4_csum_off) {
 			res = skb_nat_l4_csum_ipv4(skb, l4_csum_off, state->ip_src,
@@ -955,14 +1181,6 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 					ctx->ip_header->protocol == IPPROTO_UDP ? BPF_F_MARK_MANGLED_0 : 0);
 		}
 
-		CALI_VERB("L3 checksum update (csum is at %d) port from %x to %x\n",
-				l3_csum_off, state->ip_src, state->ct_result.nat_ip);
-
-		int csum_rc = bpf_l3_csum_replace(skb, l3_csum_off,
-						  state->ip_src, state->ct_result.nat_ip, 4);
-		CALI_VERB("bpf_l3_csum_replace(IP): %d\n", csum_rc);
-		res |= csum_rc;
-
 		if (res) {
 			reason = CALI_REASON_CSUM_FAIL;
 			goto deny;
@@ -974,7 +1192,7 @@ static CALI_BPF_INLINE struct fwd calico_tc_skb_accepted(struct cali_tc_ctx *ctx
 		 * already encaped traffic would not reach this point and would not be
 		 * able to match as SNAT.
 		 */
-		if ((dnat_return_should_encap() || (CALI_F_TO_HEP && !CALI_F_DSR)) &&
+		if ((dnat_return_should_encap() || dnat_host_return_should_encap()) &&
 									state->ct_result.tun_ip) {
 			state->ip_dst = state->ct_result.tun_ip;
 			seen_mark = CALI_SKB_MARK_BYPASS_FWD_SRC_FIXUP;
@@ -1028,7 +1246,7 @@ icmp_too_big:
 		__be16  unused;
 		__be16  mtu;
 	} frag = {
-		.mtu = bpf_htons(TUNNEL_MTU),
+		.mtu = bpf_htons(encap_mtu),
 	};
 	state->tun_ip = *(__be32 *)&frag;
 
@@ -1045,37 +1263,30 @@ nat_encap:
 	 * forwarded it. We need to fix it now.
 	 */
 	if (CALI_F_TO_HEP) {
-		struct arp_value *arpv;
-		struct arp_key arpk = {
-			.ip = state->ip_dst,
-			.ifindex = skb->ifindex,
-		};
-
-		arpv = cali_v4_arp_lookup_elem(&arpk);
-		if (!arpv) {
-			CALI_DEBUG("ARP lookup failed for %x dev %d at HEP\n",
-					bpf_ntohl(state->ip_dst), arpk.ifindex);
+		/* The conntrack entry recorded the MACs of the tunnel next hop if the flow
+		 * arrived through this device. */
+		if (!ct_tun_nh_valid(&ctx->tun_nh)) {
+			CALI_DEBUG("No tunnel next hop for %x dev %d at HEP\n",
+					bpf_ntohl(state->ip_dst), skb->ifindex);
 			/* Don't drop it yet, we might get lucky and the MAC is correct */
 		} else {
 			if (skb_refresh_validate_ptrs(ctx, 0)) {
 				reason = CALI_REASON_SHORT;
 				goto deny;
 			}
-			__builtin_memcpy(&ctx->eth->h_dest, arpv->mac_dst, ETH_ALEN);
-			if (state->ct_result.ifindex_fwd == skb->ifindex) {
-				/* No need to change src MAC, if we are at the right device */
-			} else {
-				/* FIXME we need to redirect to the right device */
-			}
+			/* No need to change src MAC, we are at the right device */
+			__builtin_memcpy(&ctx->eth->h_dest, ctx->tun_nh.mac_dst, ETH_ALEN);
 		}
 	}
 
-	if (vxlan_v4_encap(ctx, state->ip_src, state->ip_dst)) {
+	__u16 vxlan_sport;
+	if (vxlan_v4_encap(ctx, state->ip_src, state->ip_dst, &vxlan_sport)) {
 		reason = CALI_REASON_ENCAP_FAIL;
 		goto  deny;
 	}
 
-	state->sport = state->dport = VXLAN_PORT;
+	state->sport = vxlan_sport;
+	state->dport = CTX_VXLAN_PORT(ctx);
 	state->ip_proto = IPPROTO_UDP;
 
 	CALI_DEBUG("vxlan return %d ifindex_fwd %d\n",
@@ -1121,6 +1332,8 @@ int calico_tc_skb_send_icmp_replies(struct __sk_buff *skb)
 			.res = TC_ACT_UNSPEC,
 			.reason = CALI_REASON_UNKNOWN,
 		},
+		.counters = counters_get(),
+		.iface_cfg = iface_cfg_get(skb_wep_ifindex(skb)),
 	};
 	if (!ctx.state) {
 		CALI_DEBUG("State map lookup failed: DROP\n");
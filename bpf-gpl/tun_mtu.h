@@ -0,0 +1,43 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_TUN_MTU_H__
+#define __CALI_TUN_MTU_H__
+
+#include "bpf.h"
+
+/* Map: the MTU of the VXLAN tunnel to each remote node, keyed by the IP of the node, i.e. the
+ * next hop of the cali_v4_routes entries of its workloads.  Felix only adds the nodes that it
+ * can reach over a path with a larger MTU than the tunnel MTU of the interface, for instance
+ * the nodes on a jumbo-frame subnet; the NodePort encap to the other nodes uses the tunnel MTU
+ * of the interface.
+ * WARNING: must be kept in sync with TunMTUMapParameters in bpf/routes/tun_mtu.go.
+ */
+CALI_MAP_V1(cali_v4_tun_mtu,
+		BPF_MAP_TYPE_HASH,
+		__be32, __u32,
+		64*1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+/* tun_mtu returns the MTU of the tunnel to node, or dflt if the node has no entry. */
+static CALI_BPF_INLINE __u32 tun_mtu(__be32 node, __u32 dflt)
+{
+	__u32 *mtu = cali_v4_tun_mtu_lookup_elem(&node);
+
+	return mtu ? *mtu : dflt;
+}
+
+#endif /* __CALI_TUN_MTU_H__ */
@@ -27,12 +27,16 @@
 #include <linux/in.h>
 #include <linux/udp.h>
 #include "bpf.h"
+#include "routes.h"
 #include "arp.h"
 #include "conntrack_types.h"
 #include "nat_types.h"
 #include "reasons.h"
+#include "counters.h"
+#include "ifcfg.h"
 
-// struct cali_tc_state holds state that is passed between the BPF programs.
+// struct cali_tc_state holds state that is passed between the BPF programs.  It is not zeroed
+// for each packet, see tc_state_init() in tc.c for the fields that are.
 // WARNING: must be kept in sync with
 // - the definitions in bpf/polprog/pol_prog_builder.go.
 // - the Go version of the struct in bpf/state/map.go
@@ -86,6 +90,21 @@ struct cali_tc_state {
 	/* Result of the NAT calculation.  Zeroed if there is no DNAT. */
 	struct calico_nat_dest nat_dest;
 	__u64 prog_start_time;
+
+	/* Route lookups of this packet, see cali_rt_lookup_src/dst(). */
+	struct cali_rt_cache rt_cache;
+
+	/* Where a policy program that has been split into several programs resumes, set by the
+	 * previous program in the chain. */
+	__u32 pol_resume;
+	/* Policy generation read by pol_cache_lookup(), used to tag the verdict when it is cached. */
+	__u32 pol_gen;
+	/* When the packet was handed to the policy program, zero if it was not, see
+	 * pol_lat_record(). */
+	__u64 pol_start_time;
+	/* Timestamp for the conntrack and NAT bookkeeping of the packet, read once per packet with
+	 * cali_now() so that all the entries that the packet touches agree on it. */
+	__u64 now;
 };
 
 enum cali_state_flags {
@@ -101,6 +120,15 @@ enum cali_state_flags {
 	/* CALI_ST_SRC_IS_HOST is set if the packet is heading away from the host namespace and the source
 	 * belongs to the host. */
 	CALI_ST_SRC_IS_HOST	  = 0x08,
+	/* CALI_ST_POL_CACHEABLE is set by the policy program if its allow verdict may be stored in the
+	 * policy verdict cache. */
+	CALI_ST_POL_CACHEABLE	  = 0x10,
+	/* CALI_ST_CTLB_NAT is set if the connect-time load balancer NATted the flow and we found its
+	 * pre-DNAT destination in cali_v4_ct_nats. */
+	CALI_ST_CTLB_NAT	  = 0x20,
+	/* CALI_ST_FRAG_TAIL is set if the packet is a trailing fragment of a UDP datagram, its ports
+	 * come from the first fragment, see frags.h. */
+	CALI_ST_FRAG_TAIL	  = 0x40,
 };
 
 struct fwd {
@@ -135,8 +163,16 @@ struct cali_tc_ctx {
   };
 
   struct calico_nat_dest *nat_dest;
-  struct arp_key arpk;
+  /* The MACs to send the packet back through the VXLAN tunnel, copied from the conntrack entry of
+   * the flow by calico_ct_v4_lookup(), zero if unknown. */
+  struct calico_ct_tun_nh tun_nh;
   struct fwd fwd;
+
+  /* Per-CPU hot-path counters for this hook, may be NULL. */
+  struct cali_counters *counters;
+
+  /* Configuration of the interface, NULL if the program uses the patched constants. */
+  struct cali_iface_cfg *iface_cfg;
 };
 
 #endif /* __CALI_BPF_TYPES_H__ */
@@ -0,0 +1,70 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef __CALI_UNTRACKED_H__
+#define __CALI_UNTRACKED_H__
+
+/* Untracked (DoNotTrack) policy of host endpoints.  Felix installs the ingress untracked policy of
+ * a host endpoint in the jump map of its XDP program, which tail-calls it before the fast path.
+ * The packets that the policy denies are dropped before the kernel allocates an skb for them,
+ * which is what makes untracked policy useful against floods.  The packets that it allows are
+ * passed up, flagged in the packet's metadata, and TC lets them through without conntrack or
+ * policy, the way iptables' NOTRACK does.  The packets that no untracked policy matches carry
+ * on through the XDP fast path and TC as usual.
+ *
+ * If the XDP program has no room for the metadata, the allowed packet reaches TC unflagged and
+ * gets the normal treatment: conntrack and the ingress policy of the host endpoint.
+ */
+
+/* CALI_XDP_META_UNTRACKED is the metadata of a packet that untracked policy allowed. */
+#define CALI_XDP_META_UNTRACKED 0xca11d07c
+
+#if CALI_F_XDP
+
+/* xdp_untracked_accept flags the packet as allowed by untracked policy for TC. */
+static CALI_BPF_INLINE void xdp_untracked_accept(struct cali_tc_ctx *ctx)
+{
+	if (bpf_xdp_adjust_meta(ctx->xdp, -(int)sizeof(__u32))) {
+		CALI_DEBUG("XDP: no room for metadata, packet to the stack unflagged.\n");
+		return;
+	}
+	__u32 *meta = (void *)(long)ctx->xdp->data_meta;
+	if ((void *)(meta + 1) > (void *)(long)ctx->xdp->data) {
+		return;
+	}
+	*meta = CALI_XDP_META_UNTRACKED;
+}
+
+#else /* !CALI_F_XDP */
+
+/* skb_untracked_accepted returns true if untracked policy in the XDP program allowed the packet,
+ * see xdp_untracked_accept().
+ */
+static CALI_BPF_INLINE bool skb_untracked_accepted(struct __sk_buff *skb)
+{
+	__u32 *meta = (void *)(long)skb->data_meta;
+
+	if ((void *)(meta + 1) > (void *)(long)skb->data) {
+		return false;
+	}
+	return *meta == CALI_XDP_META_UNTRACKED;
+}
+
+#endif /* CALI_F_XDP */
+
+#endif /* __CALI_UNTRACKED_H__ */
@@ -28,5 +28,7 @@ static CALI_BPF_INLINE int calico_unittest_entry (struct __sk_buff *skb)
 			.reason = CALI_REASON_UNKNOWN,
 		},
 	};
-	return vxlan_v4_encap(&ctx, HOST_IP, 0x02020202);
+	__u16 sport;
+
+	return vxlan_v4_encap(&ctx, HOST_IP, 0x02020202, &sport);
 }
@@ -0,0 +1,78 @@
+// Project Calico BPF dataplane programs.
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef __CALI_WEP_INLINE_H__
+#define __CALI_WEP_INLINE_H__
+
+#include "bpf.h"
+
+// Inline delivery to local workloads.  Rather than redirecting a packet from a host endpoint to
+// the host side of a workload's veth, where the to-workload program runs once more, the HEP
+// program tail calls the to-workload program of the veth directly.  That program then runs its
+// policy as usual and delivers the packet straight into the workload's namespace with
+// bpf_redirect_peer(), so the packet never crosses the veth.
+//
+// Felix adds the to-workload programs to this map, keyed on the ifindex of the veth, see
+// bpf/tc/wep_progs.go.  A missing entry makes the HEP program fall back to a plain redirect.
+struct bpf_map_def_extended __attribute__((section("maps"))) cali_wep_progs = {
+	.type = BPF_MAP_TYPE_PROG_ARRAY,
+	.key_size = 4,
+	.value_size = 4,
+	.max_entries = 64 * 1024,
+	CALI_MAP_TC_EXT_PIN(MAP_PIN_GLOBAL)
+};
+
+/* The HEP program passes the ifindex of the veth to the to-workload program in skb->cb; the magic
+ * value tells the to-workload program that it is running inline. */
+#define CALI_WEP_INLINE_MAGIC	0x4c4e4c49 /* ASCII(ILNL) */
+#define CALI_WEP_INLINE_CB_MAGIC	0
+#define CALI_WEP_INLINE_CB_IFINDEX	1
+
+/* wep_inline_tail_call tail calls the to-workload program of the given veth.  It only returns if
+ * there is no program for the veth in the map. */
+static CALI_BPF_INLINE void wep_inline_tail_call(struct __sk_buff *skb, __u32 ifindex)
+{
+	skb->cb[CALI_WEP_INLINE_CB_MAGIC] = CALI_WEP_INLINE_MAGIC;
+	skb->cb[CALI_WEP_INLINE_CB_IFINDEX] = ifindex;
+	bpf_tail_call(skb, &cali_wep_progs, ifindex);
+	skb->cb[CALI_WEP_INLINE_CB_MAGIC] = 0;
+}
+
+/* skb_wep_inline_ifindex returns the ifindex of the veth if this to-workload program was tail
+ * called by a HEP program, or 0 if it is running on the veth as normal.  When inline, the program
+ * runs at the ingress hook of the HEP, so skb->ifindex is the HEP's ifindex. */
+static CALI_BPF_INLINE __u32 skb_wep_inline_ifindex(struct __sk_buff *skb)
+{
+	if (!CALI_F_TO_WEP || !WEP_INLINE) {
+		return 0;
+	}
+	if (skb->cb[CALI_WEP_INLINE_CB_MAGIC] != CALI_WEP_INLINE_MAGIC ||
+			skb->ifindex != skb->ingress_ifindex) {
+		return 0;
+	}
+	return skb->cb[CALI_WEP_INLINE_CB_IFINDEX];
+}
+
+/* skb_wep_ifindex returns the ifindex of the interface that the program is attached to, which
+ * differs from skb->ifindex when a to-workload program runs inline. */
+static CALI_BPF_INLINE __u32 skb_wep_ifindex(struct __sk_buff *skb)
+{
+	__u32 ifindex = skb_wep_inline_ifindex(skb);
+	return ifindex ? : skb->ifindex;
+}
+
+#endif /* __CALI_WEP_INLINE_H__ */
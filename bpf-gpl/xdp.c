@@ -16,7 +16,6 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 
-// NOTE: THIS FILE IS NOT YET IN ACTIVE USE.
 
 #include <linux/if_ether.h>
 #include <linux/ip.h>
@@ -40,36 +39,705 @@
 #include "parsing.h"
 #include "failsafe.h"
 #include "jump.h"
+#include "conntrack.h"
+#include "counters.h"
+#include "syncookie.h"
+#include "untracked.h"
+#include "edt.h"
 
+/* cali_xdp_tx holds the interfaces that the XDP fast path may redirect to.  XDP_REDIRECT
+ * only succeeds towards devices that can transmit XDP frames (for example, a veth whose peer
+ * has no XDP program silently drops them) so Felix only adds the host endpoints that it has
+ * attached this program to.  If the FIB points anywhere else, the packet takes the normal path.
+ */
+CALI_MAP_V1(cali_xdp_tx,
+		BPF_MAP_TYPE_DEVMAP_HASH,
+		__u32, __u32,
+		512, 0, MAP_PIN_GLOBAL)
+
+/* cali_cpumap holds the CPUs that the XDP program steers Calico VXLAN packets to, see
+ * xdp_cpu_steer().  The value is the size of each CPU's queue.  Felix sizes the map to the number
+ * of possible CPUs, which is all that the kernel allows; the default only has to be valid.
+ * WARNING: must be kept in sync with CPUMapParams in bpf/xdp/map.go.
+ */
+CALI_MAP_V1(cali_cpumap,
+		BPF_MAP_TYPE_CPUMAP,
+		__u32, __u32,
+		1, 0, MAP_PIN_GLOBAL)
+
+/* cali_v4_pfilter is the prefilter blocklist: traffic from any of its source CIDRs is dropped
+ * before any other processing, unless it is to a failsafe port.  The value counts the drops so
+ * that each blocked prefix reports its own hits.
+ */
+struct prefilter_key {
+	__u32 prefixlen;
+	__be32 addr;
+};
+
+struct prefilter_val {
+	__u64 packets;
+	__u64 bytes;
+};
+
+CALI_MAP_V1(cali_v4_pfilter,
+		BPF_MAP_TYPE_LPM_TRIE,
+		struct prefilter_key, struct prefilter_val,
+		1024*1024, BPF_F_NO_PREALLOC, MAP_PIN_GLOBAL)
+
+static CALI_BPF_INLINE bool prefilter_should_drop(struct cali_tc_ctx *ctx)
+{
+	struct prefilter_key key = {
+		.prefixlen = 32,
+		.addr = ctx->state->ip_src,
+	};
+	struct prefilter_val *val = cali_v4_pfilter_lookup_elem(&key);
+
+	if (!val) {
+		return false;
+	}
+
+	/* LPM values are shared between CPUs. */
+	__sync_fetch_and_add(&val->packets, 1);
+	__sync_fetch_and_add(&val->bytes, ctx->xdp->data_end - ctx->xdp->data);
+
+	return true;
+}
+
+/* xdp_fib_lookup does a kernel FIB lookup for the parameters that the caller filled in.  It
+ * returns 0 if the packet can be redirected to the resulting next hop from XDP.
+ */
+static CALI_BPF_INLINE int xdp_fib_lookup(struct cali_tc_ctx *ctx, struct bpf_fib_lookup *fib_params)
+{
+	int rc = bpf_fib_lookup(ctx->xdp, fib_params, sizeof(*fib_params), 0);
+	if (rc != 0) {
+		/* Includes packets to the host itself (BPF_FIB_LKUP_RET_NOT_FWDED), packets
+		 * bigger than the egress MTU and next hops without a neighbour entry; the
+		 * stack resolves those.
+		 */
+		CALI_DEBUG("XDP: FIB lookup failed: %d, pass to stack.\n", rc);
+		counter_inc(ctx->counters, counter_for_fib_ret(rc));
+		counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
+		return -1;
+	}
+
+	__u32 iface = fib_params->ifindex;
+	if (!cali_xdp_tx_lookup_elem(&iface)) {
+		CALI_DEBUG("XDP: iface %d does not accept XDP redirect, pass to stack.\n", iface);
+		counter_inc(ctx->counters, CALI_COUNTER_FIB_FALLBACK);
+		return -1;
+	}
+	counter_inc(ctx->counters, CALI_COUNTER_FIB_SUCCESS);
+
+	return 0;
+}
+
+/* xdp_redirect sends the packet to the next hop that xdp_fib_lookup() found.  The packet (or
+ * its outer header, if it has been encapped) must be at ctx->ip_header.
+ */
+static CALI_BPF_INLINE int xdp_redirect(struct cali_tc_ctx *ctx, struct bpf_fib_lookup *fib_params)
+{
+	// Update the MACs.
+	struct ethhdr *eth_hdr = ctx->data_start;
+	__builtin_memcpy(&eth_hdr->h_source, fib_params->smac, sizeof(eth_hdr->h_source));
+	__builtin_memcpy(&eth_hdr->h_dest, fib_params->dmac, sizeof(eth_hdr->h_dest));
+	ip_dec_ttl(ctx->ip_header);
+
+	CALI_DEBUG("XDP: FIB hit, redirecting to iface %d.\n", fib_params->ifindex);
+	int rc = bpf_redirect_map(&cali_xdp_tx, fib_params->ifindex, 0);
+	if (rc == XDP_REDIRECT) {
+		counter_inc(ctx->counters, CALI_COUNTER_REDIR_SUCCESS);
+	} else {
+		/* The packet has already been modified so it cannot be passed up. */
+		counter_inc(ctx->counters, CALI_COUNTER_REDIR_FAILED);
+	}
+
+	return rc;
+}
+
+/* xdp_fib_forward tries to forward the packet straight to its next hop using the kernel FIB.
+ * It returns XDP_REDIRECT on success; otherwise, XDP_PASS so that the packet is handled by
+ * the TC programs and the IP stack as usual.
+ */
+static CALI_BPF_INLINE int xdp_fib_forward(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	/* Let the IP stack generate the ICMP time exceeded. */
+	if (ip_ttl_exceeded(ctx->ip_header)) {
+		return XDP_PASS;
+	}
+
+	struct bpf_fib_lookup fib_params = {
+		.family = 2, /* AF_INET */
+		.tot_len = bpf_ntohs(ctx->ip_header->tot_len),
+		.ifindex = ctx->xdp->ingress_ifindex,
+		.l4_protocol = state->ip_proto,
+		.sport = bpf_htons(state->sport),
+		.dport = bpf_htons(state->dport),
+	};
+
+	/* set the ipv4 here, otherwise the ipv4/6 unions do not get
+	 * zeroed properly
+	 */
+	fib_params.ipv4_src = state->ip_src;
+	fib_params.ipv4_dst = state->ip_dst;
+
+	if (xdp_fib_lookup(ctx, &fib_params)) {
+		return XDP_PASS;
+	}
+
+	return xdp_redirect(ctx, &fib_params);
+}
+
+/* XDP has no equivalent of bpf_l3/l4_csum_replace() so we update the checksums ourselves,
+ * incrementally, as per RFC-1624.
+ */
+static CALI_BPF_INLINE __u16 xdp_csum_fold(__u32 sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (__u16)~sum;
+}
+
+static CALI_BPF_INLINE void xdp_csum_replace2(__u16 *sum, __u16 from, __u16 to)
+{
+	__u32 s = (__u16)~*sum;
+
+	s += (__u16)~from;
+	s += to;
+	*sum = xdp_csum_fold(s);
+}
+
+static CALI_BPF_INLINE void xdp_csum_replace4(__u16 *sum, __u32 from, __u32 to)
+{
+	xdp_csum_replace2(sum, from >> 16, to >> 16);
+	xdp_csum_replace2(sum, from & 0xffff, to & 0xffff);
+}
+
+/* xdp_dnat rewrites the destination of the packet to the NAT backend, fixing up the checksums. */
+static CALI_BPF_INLINE void xdp_dnat(struct cali_tc_ctx *ctx, __be32 ip_to, __be16 port_to)
+{
+	__be32 ip_from = ctx->ip_header->daddr;
+
+	switch (ctx->ip_header->protocol) {
+	case IPPROTO_TCP:
+		xdp_csum_replace4(&ctx->tcp_header->check, ip_from, ip_to);
+		xdp_csum_replace2(&ctx->tcp_header->check, ctx->tcp_header->dest, port_to);
+		ctx->tcp_header->dest = port_to;
+		break;
+	case IPPROTO_UDP:
+		/* Zero UDP checksum means there is no checksum. */
+		if (ctx->udp_header->check) {
+			xdp_csum_replace4(&ctx->udp_header->check, ip_from, ip_to);
+			xdp_csum_replace2(&ctx->udp_header->check, ctx->udp_header->dest, port_to);
+			if (!ctx->udp_header->check) {
+				ctx->udp_header->check = 0xffff;
+			}
+		}
+		ctx->udp_header->dest = port_to;
+		break;
+	}
+
+	xdp_csum_replace4(&ctx->ip_header->check, ip_from, ip_to);
+	ctx->ip_header->daddr = ip_to;
+}
+
+#define XDP_VXLAN_HDR_SIZE (sizeof(struct ethhdr) + sizeof(struct iphdr) + \
+		sizeof(struct udphdr) + sizeof(struct vxlanhdr))
+
+/* xdp_vxlan_encap is the XDP equivalent of vxlan_v4_encap().  It prepends the outer headers
+ * using the headroom of the frame; the original ethernet header becomes the inner one.  The
+ * caller picks the outer source port with vxlan_src_port() as it needs it for the FIB lookup.
+ */
+static CALI_BPF_INLINE int xdp_vxlan_encap(struct cali_tc_ctx *ctx,  __be32 ip_src, __be32 ip_dst,
+					   __u16 vxlan_sport)
+{
+	if (bpf_xdp_adjust_head(ctx->xdp, -(int)XDP_VXLAN_HDR_SIZE)) {
+		CALI_DEBUG("XDP: no headroom for VXLAN encap\n");
+		return -1;
+	}
+
+	if (skb_refresh_validate_new_hdrs(ctx, XDP_VXLAN_HDR_SIZE)) {
+		ctx->fwd.reason = CALI_REASON_SHORT;
+		CALI_DEBUG("Too short VXLAN encap\n");
+		return -1;
+	}
+
+	struct vxlanhdr *vxlan = (void *)(ctx->udp_header +1);
+	struct ethhdr *eth_inner = (void *)(vxlan+1);
+	struct iphdr *ip_inner = (void*)(eth_inner+1);
+
+	/* Copy the original IP header. Since it is already DNATed, the dest IP is
+	 * already set. All we need to do is to change the source IP
+	 */
+	*ctx->ip_header = *ip_inner;
+
+	/* decrement TTL for the inner IP header. TTL must be > 1 to get here */
+	ip_dec_ttl(ip_inner);
+
+	ctx->ip_header->saddr = ip_src;
+	ctx->ip_header->daddr = ip_dst;
+	ctx->ip_header->tot_len = bpf_htons(bpf_ntohs(ctx->ip_header->tot_len) + XDP_VXLAN_HDR_SIZE);
+	ctx->ip_header->ihl = 5; /* in case there were options in ip_inner */
+	ctx->ip_header->protocol = IPPROTO_UDP;
+	ctx->ip_header->check = 0;
+	ctx->ip_header->check = xdp_csum_fold(bpf_csum_diff(0, 0, (void *)ctx->ip_header,
+				sizeof(struct iphdr), 0));
+
+	ctx->udp_header->source = bpf_htons(vxlan_sport);
+	ctx->udp_header->dest = bpf_htons(VXLAN_PORT);
+	ctx->udp_header->len = bpf_htons(bpf_ntohs(ctx->ip_header->tot_len) - sizeof(struct iphdr));
+	ctx->udp_header->check = 0;
+
+	*((__u8*)&vxlan->flags) = 1 << 3; /* set the I flag to make the VNI valid */
+	vxlan->vni = bpf_htonl(CALI_VXLAN_VNI) >> 8; /* it is actually 24-bit, last 8 reserved */
+
+	/* The outer MACs are set from the FIB; keep eth_inner MACs zeroed, it is useless
+	 * after decap.
+	 */
+	ctx->eth->h_proto = eth_inner->h_proto;
+	__builtin_memset(eth_inner->h_dest, 0, ETH_ALEN);
+	__builtin_memset(eth_inner->h_source, 0, ETH_ALEN);
+
+	CALI_DEBUG("vxlan encap %x : %x\n", bpf_ntohl(ctx->ip_header->saddr), bpf_ntohl(ctx->ip_header->daddr));
+
+	return 0;
+}
+
+/* xdp_nodeport_forward handles request packets of established NodePort flows whose backend is
+ * on another node.  It does what calico_tc_skb_accepted() does for such packets: DNAT to the
+ * backend recorded in conntrack, VXLAN-encap to the backend's node and FIB-forward. Any packet
+ * that would need the slow path on the TC side (ICMP errors, MTU problems) is passed up before
+ * it is modified.
+ */
+static CALI_BPF_INLINE int xdp_nodeport_forward(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+	__be32 tun_ip = state->ct_result.tun_ip;
+
+	if (!tun_ip) {
+		return XDP_PASS;
+	}
+
+	/* Let the IP stack generate the ICMP time exceeded. */
+	if (ip_ttl_exceeded(ctx->ip_header)) {
+		return XDP_PASS;
+	}
+
+	/* Let TC send the ICMP too big or the stack fragment the encapped packet. */
+	__u16 tot_len = bpf_ntohs(ctx->ip_header->tot_len);
+	if (tot_len > tun_mtu(tun_ip, TUNNEL_MTU)) {
+		CALI_DEBUG("XDP: packet too big for the tunnel (len=%d): PASS\n", tot_len);
+		return XDP_PASS;
+	}
+
+	/* Same port as vxlan_v4_encap() picks from the inner header after the DNAT. */
+	__u16 vxlan_sport = vxlan_src_port(ctx->ip_header->saddr, state->ct_result.nat_ip,
+					   state->ip_proto, state->sport, state->ct_result.nat_port);
+
+	struct bpf_fib_lookup fib_params = {
+		.family = 2, /* AF_INET */
+		.tot_len = tot_len + XDP_VXLAN_HDR_SIZE,
+		.ifindex = ctx->xdp->ingress_ifindex,
+		.l4_protocol = IPPROTO_UDP,
+		.sport = bpf_htons(vxlan_sport),
+		.dport = bpf_htons(VXLAN_PORT),
+	};
+	fib_params.ipv4_src = HOST_IP;
+	fib_params.ipv4_dst = tun_ip;
+
+	if (xdp_fib_lookup(ctx, &fib_params)) {
+		return XDP_PASS;
+	}
+
+	CALI_DEBUG("XDP: DNAT to %x:%d\n", bpf_ntohl(state->ct_result.nat_ip), state->ct_result.nat_port);
+	xdp_dnat(ctx, state->ct_result.nat_ip, bpf_htons(state->ct_result.nat_port));
+
+	if (xdp_vxlan_encap(ctx, HOST_IP, tun_ip, vxlan_sport)) {
+		ctx->fwd.reason = CALI_REASON_ENCAP_FAIL;
+		return XDP_DROP;
+	}
+
+	return xdp_redirect(ctx, &fib_params);
+}
+
+/* xdp_ct_acct counts a packet that the fast path forwarded in the accounting of its flow; the TC
+ * programs count the packets that it passes up, see ct_acct_should_count().
+ */
+static CALI_BPF_INLINE void xdp_ct_acct(struct cali_tc_ctx *ctx, __u64 len)
+{
+	struct cali_tc_state *state = ctx->state;
+	__be32 ip_dst = state->ip_dst;
+	__u16 dport = state->dport;
+
+	if (ct_result_rc(state->ct_result.rc) == CALI_CT_ESTABLISHED_DNAT) {
+		/* The legs are in the NAT_REV entry, which is keyed on the backend. */
+		ip_dst = state->ct_result.nat_ip;
+		dport = state->ct_result.nat_port;
+	}
+
+	bool srcLTDest = src_lt_dest(state->ip_src, ip_dst, state->sport, dport);
+	struct calico_ct_key k = ct_make_key(srcLTDest, state->ip_proto,
+			state->ip_src, ip_dst, state->sport, dport);
+
+	ct_acct_update(&k, srcLTDest, len);
+}
+
+/* xdp_cpu_steer spreads the VXLAN packets that the BPF programs on other nodes send to NodePort
+ * backends on this one over XDP_CPU_STEERING CPUs.  All the flows from one node share the outer
+ * 5-tuple so RSS delivers them to the same CPU, which then does the decap, conntrack and delivery
+ * for all of them.  We pick the CPU from the hash of the inner 5-tuple instead and redirect the
+ * packet to that CPU's queue in cali_cpumap; the kernel builds the skb there and the TC programs
+ * run on that CPU.  All the packets of an inner flow go to the same CPU so they stay in order.
+ *
+ * Returns XDP_REDIRECT if it steered the packet and -1 if the packet stays on this CPU.
+ */
+static CALI_BPF_INLINE int xdp_cpu_steer(struct cali_tc_ctx *ctx)
+{
+	if (ctx->ip_header->ihl != 5 || ctx->udp_header->dest != bpf_htons(VXLAN_PORT)) {
+		return -1;
+	}
+
+	struct vxlanhdr *vxlan = (void *)(ctx->udp_header + 1);
+	struct ethhdr *eth_inner = (void *)(vxlan + 1);
+	struct iphdr *ip_inner = (void *)(eth_inner + 1);
+	/* TCP and UDP have the ports at the same place. */
+	__be16 *ports = (void *)(ip_inner + 1);
+
+	if ((void *)(ports + 2) > ctx->data_end) {
+		return -1;
+	}
+	if (!(*((__u8 *)&vxlan->flags) & (1 << 3)) ||
+			bpf_ntohl(vxlan->vni << 8) != CALI_VXLAN_VNI ||
+			eth_inner->h_proto != bpf_htons(ETH_P_IP)) {
+		return -1;
+	}
+
+	__u16 sport = 0, dport = 0;
+	/* Fragments, other than the first, have no ports; hash all of them without. */
+	if (ip_inner->ihl == 5 && !(ip_inner->frag_off & bpf_htons(0x3fff)) &&
+			(ip_inner->protocol == IPPROTO_TCP || ip_inner->protocol == IPPROTO_UDP)) {
+		sport = bpf_ntohs(ports[0]);
+		dport = bpf_ntohs(ports[1]);
+	}
+
+	__u64 h = nat_flow_hash(ip_inner->saddr, ip_inner->daddr, ip_inner->protocol, sport, dport);
+	__u32 cpu = (h * XDP_CPU_STEERING) >> 32;
+
+	if (cpu == bpf_get_smp_processor_id()) {
+		return -1;
+	}
+
+	CALI_DEBUG("XDP: VXLAN packet steered to CPU %d.\n", cpu);
+	/* If the CPU is not in the map, the packet goes through the stack on this CPU. */
+	int rc = bpf_redirect_map(&cali_cpumap, cpu, XDP_PASS);
+	if (rc == XDP_REDIRECT) {
+		counter_inc(ctx->counters, CALI_COUNTER_CPU_STEERED);
+	}
+	return rc == XDP_REDIRECT ? rc : -1;
+}
+
+/* xdp_pass records the verdict of a packet that the program doesn't drop and returns its action,
+ * which is XDP_PASS unless the packet was redirected.
+ */
+static CALI_BPF_INLINE int xdp_pass(struct cali_tc_ctx *ctx)
+{
+	if (CALI_LOG_LEVEL >= CALI_LOG_LEVEL_INFO) {
+		__u64 prog_end_time = bpf_ktime_get_ns();
+		CALI_INFO("Final result=ALLOW (%d). XDP action %d. Program execution time: %lluns\n",
+				ctx->fwd.reason, ctx->fwd.res, prog_end_time-ctx->state->prog_start_time);
+	}
+	counters_record_verdict(ctx->counters, false, ctx->fwd.reason);
+	return ctx->fwd.res;
+}
+
+/* xdp_fast_path forwards the packets of established flows straight to their next hop, see
+ * calico_xdp(), and passes everything else up.
+ */
+static CALI_BPF_INLINE int xdp_fast_path(struct cali_tc_ctx *ctx)
+{
+	if (CALI_F_HEP && XDP_CPU_STEERING && ctx->state->ip_proto == IPPROTO_UDP &&
+			xdp_cpu_steer(ctx) == XDP_REDIRECT) {
+		ctx->fwd.res = XDP_REDIRECT;
+		return xdp_pass(ctx);
+	}
+
+	if (CALI_F_HEP && SYNCOOKIES_ENABLED && ctx->state->ip_proto == IPPROTO_TCP) {
+		int rc = xdp_syncookie(ctx);
+		if (rc == XDP_TX || rc == XDP_DROP) {
+			counters_record_verdict(ctx->counters, rc == XDP_DROP,
+					rc == XDP_DROP ? CALI_REASON_UNAUTH_SOURCE : CALI_REASON_UNKNOWN);
+			return rc;
+		}
+		if (rc == XDP_PASS) {
+			return xdp_pass(ctx);
+		}
+	}
+
+	if (ctx->state->ip_proto != IPPROTO_TCP && ctx->state->ip_proto != IPPROTO_UDP) {
+		CALI_DEBUG("XDP: protocol %d not fast-pathed\n", ctx->state->ip_proto);
+		return xdp_pass(ctx);
+	}
+
+	/* The length before any encap, for the accounting. */
+	__u64 pkt_len = ctx->xdp->data_end - ctx->xdp->data;
+	ctx->state->ct_result = calico_ct_v4_lookup(ctx);
+
+	switch (ct_result_rc(ctx->state->ct_result.rc)) {
+	case CALI_CT_NEW:
+		counter_inc(ctx->counters, CALI_COUNTER_CT_NEW);
+		break;
+	case CALI_CT_MID_FLOW_MISS:
+		counter_inc(ctx->counters, CALI_COUNTER_CT_MISS);
+		break;
+	default:
+		counter_inc(ctx->counters, CALI_COUNTER_CT_HIT);
+	}
+
+	/* Compare the whole rc, not just ct_result_rc(), so that related packets and flows
+	 * that failed the RPF check or whose tunnel source changed take the slow path.
+	 */
+	switch (ctx->state->ct_result.rc) {
+	case CALI_CT_ESTABLISHED_BYPASS:
+		/* Flows that need NAT or special handling by the host stack take the slow path. */
+		if (ctx->state->ct_result.flags & (CALI_CT_FLAG_NAT_OUT | CALI_CT_FLAG_SKIP_FIB |
+					CALI_CT_FLAG_NP_FWD | CALI_CT_FLAG_DSR_FWD | CALI_CT_FLAG_EXT_LOCAL)) {
+			CALI_DEBUG("XDP: CT flags %x need the slow path: PASS\n", ctx->state->ct_result.flags);
+			return xdp_pass(ctx);
+		}
+		ctx->fwd.reason = CALI_REASON_BYPASS;
+		ctx->fwd.res = xdp_fib_forward(ctx);
+		break;
+	case CALI_CT_ESTABLISHED_DNAT:
+		/* Only NodePort flows forwarded to a backend on another node.  Local backends are
+		 * workloads, whose veths cannot take XDP redirects, so TC does the NAT for them,
+		 * and for the service flows that workloads start.
+		 */
+		if (CALI_F_WEP || !ct_result_np_node(ctx->state->ct_result)) {
+			CALI_DEBUG("XDP: DNAT to local backend: PASS\n");
+			return xdp_pass(ctx);
+		}
+		ctx->fwd.reason = CALI_REASON_CT_NAT;
+		ctx->fwd.res = xdp_nodeport_forward(ctx);
+		break;
+	default:
+		CALI_DEBUG("XDP: CT rc %x, not fast-pathed: PASS\n", ctx->state->ct_result.rc);
+		return xdp_pass(ctx);
+	}
+
+	if (ctx->fwd.res != XDP_REDIRECT && ctx->fwd.res != XDP_PASS) {
+		counters_record_verdict(ctx->counters, true, ctx->fwd.reason);
+		return ctx->fwd.res;
+	}
+	if (CT_ACCT_ENABLED && ctx->fwd.res == XDP_REDIRECT) {
+		xdp_ct_acct(ctx, pkt_len);
+	}
+
+	return xdp_pass(ctx);
+}
+
+/* xdp_untracked_policy runs the ingress untracked policy of the host endpoint, which Felix
+ * installs in the jump map, see untracked.h.  The policy program tail-calls
+ * calico_xdp_accepted_entrypoint() with the verdict.  If there is no untracked policy, the tail
+ * call fails and the packet carries on here.
+ */
+static CALI_BPF_INLINE void xdp_untracked_policy(struct cali_tc_ctx *ctx)
+{
+	struct cali_tc_state *state = ctx->state;
+
+	if (state->ip_proto == IPPROTO_ICMP) {
+		/* icmp_type and icmp_code share storage with the ports, which ICMP doesn't have. */
+		state->icmp_type = ctx->icmp_header->type;
+		state->icmp_code = ctx->icmp_header->code;
+	}
+	state->pre_nat_ip_dst = state->ip_dst;
+	state->post_nat_ip_dst = state->ip_dst;
+	state->pre_nat_dport = state->dport;
+	state->post_nat_dport = state->dport;
+	state->pol_rc = CALI_POL_NO_MATCH;
+
+	bpf_tail_call(ctx->xdp, &cali_jump, PROG_INDEX_POLICY);
+	CALI_DEBUG("XDP: no untracked policy.\n");
+}
+
+/* xdp_wep_rpf_ok does the same RPF check as the TC program of the workload: the source must be a
+ * local workload behind the interface that the packet came from.
+ */
+static CALI_BPF_INLINE bool xdp_wep_rpf_ok(struct cali_tc_ctx *ctx)
+{
+	struct cali_rt *r = cali_rt_lookup(ctx->state->ip_src);
+	if (!r) {
+		CALI_INFO("XDP: workload RPF fail: missing route.\n");
+		return false;
+	}
+	if (!cali_rt_flags_local_workload(r->flags)) {
+		CALI_INFO("XDP: workload RPF fail: not a local workload.\n");
+		return false;
+	}
+	if (r->if_index != ctx->xdp->ingress_ifindex) {
+		CALI_INFO("XDP: workload RPF fail iface (%d) != route iface (%d)\n",
+				ctx->xdp->ingress_ifindex, r->if_index);
+		return false;
+	}
+	return true;
+}
+
+/* calico_xdp is the fast path for host endpoint ingress.  It first drops traffic from the
+ * prefilter blocklist, except to failsafe ports, which share the TC programs' map, and runs the
+ * untracked policy of the host endpoint, see untracked.h.  Packets that belong to established flows,
+ * which both sides' policy has already approved and which need no NAT, are forwarded straight to
+ * the next hop before the kernel allocates an skb for them; so are the request packets of
+ * established NodePort flows with a remote backend, after DNAT and VXLAN encap.  With
+ * XDP_CPU_STEERING, Calico VXLAN packets are spread over the CPUs first.  New flows still
+ * go through TC, which runs policy and creates the conntrack entries that this program relies on.
+ * Everything else is passed up to the TC programs untouched; they redo the same conntrack lookup
+ * and remain the source of truth.
+ *
+ * The xdp_wep variant is attached to the host side of the workload veths, where it sees the
+ * packets that the workload sends.  It drops the packets that fail the workload's RPF check and
+ * forwards the established, approved flows that leave the host in the same way; flows to other
+ * workloads on the host, flows that need NAT and the packets of workloads whose egress is shaped
+ * go through TC.  There is no prefilter, failsafe or untracked policy on the workload side.
+ */
 SEC("prog")
-int calico_xdp(struct xdp_md *xdp_ctx) {
+int calico_xdp(struct xdp_md *xdp_ctx)
+{
+	struct cali_counters *counters = counters_get();
+	counter_inc(counters, CALI_COUNTER_TOTAL_PACKETS);
+
 	/* Initialise the context, which is stored on the stack, and the state, which
 	 * we use to pass data from one program to the next via tail calls. */
 	struct cali_tc_ctx ctx = {
 		.state = state_get(),
 		.xdp = xdp_ctx,
 		.fwd = {
-			.res = XDP_PASS, // TODO: Adjust based on the design
+			.res = XDP_PASS,
 			.reason = CALI_REASON_UNKNOWN,
 		},
+		.counters = counters,
 	};
 
 	if (!ctx.state) {
 		CALI_DEBUG("State map lookup failed: PASS\n");
-		return XDP_PASS; // TODO: Adjust base on the design
+		return XDP_PASS;
 	}
 	__builtin_memset(ctx.state, 0, sizeof(*ctx.state));
+	ctx.state->now = cali_now();
 
 	if (CALI_LOG_LEVEL >= CALI_LOG_LEVEL_INFO) {
 		ctx.state->prog_start_time = bpf_ktime_get_ns();
 	}
 
 	// Parse packets and drop malformed and unsupported ones
-	if (parse_packet_ip(&ctx) == -2) {
+	switch (parse_packet_ip(&ctx)) {
+	case -1:
+		/* IP packets with options are let through to the stack but the blocklist
+		 * still applies to them.
+		 */
+		if (CALI_F_HEP && ctx.eth->h_proto == bpf_htons(ETH_P_IP)) {
+			ctx.state->ip_src = ctx.ip_header->saddr;
+			if (prefilter_should_drop(&ctx)) {
+				goto prefilter_drop;
+			}
+		}
+		goto pass;
+	case -2:
+		counters_record_verdict(ctx.counters, true, ctx.fwd.reason);
 		return XDP_DROP;
 	}
 
-	return XDP_PASS;
+	tc_state_fill_from_iphdr(ctx.state, ctx.ip_header);
+
+	switch (ctx.state->ip_proto) {
+	case IPPROTO_TCP:
+		if (skb_refresh_validate_ptrs(&ctx, TCP_SIZE)) {
+			/* Leave it to the TC program to deal with. */
+			CALI_DEBUG("Too short for TCP: PASS\n");
+			goto pass;
+		}
+		ctx.state->sport = bpf_ntohs(ctx.tcp_header->source);
+		ctx.state->dport = bpf_ntohs(ctx.tcp_header->dest);
+		break;
+	case IPPROTO_UDP:
+		ctx.state->sport = bpf_ntohs(ctx.udp_header->source);
+		ctx.state->dport = bpf_ntohs(ctx.udp_header->dest);
+		break;
+	}
+
+	if (CALI_F_WEP) {
+		if (!xdp_wep_rpf_ok(&ctx)) {
+			counters_record_verdict(ctx.counters, true, CALI_REASON_UNAUTH_SOURCE);
+			return XDP_DROP;
+		}
+		if (XDP_EDT_ENABLED && edt_iface_shaped(ctx.xdp->ingress_ifindex)) {
+			CALI_DEBUG("XDP: workload egress is shaped: PASS\n");
+			goto pass;
+		}
+		return xdp_fast_path(&ctx);
+	}
+
+	if (is_failsafe_in(ctx.state->ip_proto, ctx.state->dport, ctx.state->ip_src)) {
+		CALI_DEBUG("XDP: inbound failsafe port: %d: PASS\n", ctx.state->dport);
+		ctx.fwd.reason = CALI_REASON_FAILSAFE;
+		goto pass;
+	}
+
+	if (prefilter_should_drop(&ctx)) {
+		goto prefilter_drop;
+	}
+
+	xdp_untracked_policy(&ctx);
+
+	return xdp_fast_path(&ctx);
+
+prefilter_drop:
+	CALI_DEBUG("XDP: source %x blocked by prefilter: DROP\n", bpf_ntohl(ctx.state->ip_src));
+	counters_record_verdict(ctx.counters, true, CALI_REASON_UNAUTH_SOURCE);
+	return XDP_DROP;
+
+pass:
+	return xdp_pass(&ctx);
+}
+
+/* calico_xdp_accepted_entrypoint is where the untracked policy program jumps to.  The packets that
+ * the policy allowed are passed up flagged for TC; the ones that it didn't match carry on through
+ * the fast path.  The policy program drops the denied ones itself.
+ */
+__attribute__((section("1/1")))
+int calico_xdp_accepted_entrypoint(struct xdp_md *xdp_ctx)
+{
+	CALI_DEBUG("Entering calico_xdp_accepted_entrypoint\n");
+	struct cali_tc_ctx ctx = {
+		.state = state_get(),
+		.xdp = xdp_ctx,
+		.fwd = {
+			.res = XDP_PASS,
+			.reason = CALI_REASON_UNKNOWN,
+		},
+		.counters = counters_get(),
+	};
+
+	if (!ctx.state) {
+		CALI_DEBUG("State map lookup failed: PASS\n");
+		return XDP_PASS;
+	}
+
+	/* The packet is unchanged since calico_xdp() parsed it but the verifier doesn't know. */
+	if (parse_packet_ip(&ctx)) {
+		return XDP_PASS;
+	}
+	if (ctx.state->ip_proto == IPPROTO_TCP && skb_refresh_validate_ptrs(&ctx, TCP_SIZE)) {
+		return XDP_PASS;
+	}
+
+	if (ctx.state->pol_rc == CALI_POL_ALLOW) {
+		CALI_DEBUG("XDP: allowed by untracked policy: PASS\n");
+		ctx.fwd.reason = CALI_REASON_DNT;
+		xdp_untracked_accept(&ctx);
+		return xdp_pass(&ctx);
+	}
+
+	return xdp_fast_path(&ctx);
 }
 
 char ____license[] __attribute__((section("license"), used)) = "GPL";
@@ -352,6 +352,10 @@ func (b *Block) AndImm64(dst Reg, imm int32) {
 	b.add(AndImm64, dst, 0, 0, imm)
 }
 
+func (b *Block) OrImm32(dst Reg, imm int32) {
+	b.add(OrImm32, dst, 0, 0, imm)
+}
+
 func (b *Block) ShiftRImm64(dst Reg, imm int32) {
 	b.add(ShiftRImm64, dst, 0, 0, imm)
 }
@@ -570,6 +574,26 @@ func (b *Block) TargetIsUsed(label string) bool {
 	return b.inUseJumpTargets.Contains(label)
 }
 
+// NumInsns returns the number of instructions in the block so far.
+func (b *Block) NumInsns() int {
+	return len(b.insns)
+}
+
+// UnresolvedLabels returns the labels that are jumped to but not yet defined, in the order that
+// they were first used.
+func (b *Block) UnresolvedLabels() []string {
+	var labels []string
+	seen := map[string]bool{}
+	for _, f := range b.fixUps {
+		if _, ok := b.labelToInsnIdx[f.label]; ok || seen[f.label] {
+			continue
+		}
+		seen[f.label] = true
+		labels = append(labels, f.label)
+	}
+	return labels
+}
+
 func (b *Block) Assemble() (Insns, error) {
 	for _, f := range b.fixUps {
 		labelIdx, ok := b.labelToInsnIdx[f.label]
@@ -19,13 +19,18 @@ package bpf
 import (
 	"bytes"
 	"crypto/rand"
+	"crypto/sha256"
+	"debug/elf"
 	"encoding/binary"
+	"encoding/hex"
 	"io/ioutil"
 	"net"
 	"os"
+	"time"
 
 	"github.com/pkg/errors"
 	"github.com/sirupsen/logrus"
+	"golang.org/x/sys/unix"
 )
 
 // Binary is an in memory representation of a BPF binary
@@ -77,6 +82,28 @@ func (b *Binary) WriteToFile(ofile string) error {
 	return nil
 }
 
+// MemFile writes the binary to a new memory-backed file, see memfd_create(2), so that loading it
+// doesn't have to go through the disk.  Like WriteToFile, it appends a UUID to the binary.  The
+// caller owns the returned file, which another process can open if it is passed the file.
+func (b *Binary) MemFile(name string) (*os.File, error) {
+	fd, err := unix.MemfdCreate(name, unix.MFD_CLOEXEC)
+	if err != nil {
+		return nil, errors.Wrap(err, "failed to create memfd")
+	}
+	f := os.NewFile(uintptr(fd), name)
+
+	uuid := make([]byte, 16)
+	_, err = rand.Read(uuid)
+	if err == nil {
+		_, err = f.Write(append(append([]byte(nil), b.raw...), uuid...))
+	}
+	if err != nil {
+		_ = f.Close()
+		return nil, err
+	}
+	return f, nil
+}
+
 // ReplaceAll replaces all non-overlapping instance of orig with replacements.
 func (b *Binary) ReplaceAll(orig, replacement []byte) {
 	b.raw = bytes.ReplaceAll(b.raw, orig, replacement)
@@ -139,6 +166,346 @@ func (b *Binary) PatchExtToServiceConnmark(mark uint32) {
 	b.patchU32Placeholder("MARK", uint32(mark))
 }
 
+// PatchEventsSampleRate replaces the ESAM placeholder with the 1-in-N event sampling rate.
+func (b *Binary) PatchEventsSampleRate(rate uint32) {
+	b.patchU32Placeholder("ESAM", rate)
+}
+
+// PatchConntrackLRU replaces the CTLR placeholder; it must be set if the conntrack map is an LRU map.
+func (b *Binary) PatchConntrackLRU(lru bool) {
+	var v uint32
+	if lru {
+		v = 1
+	}
+	b.patchU32Placeholder("CTLR", v)
+}
+
+// PatchPolicyCache replaces the PVCE placeholder, which enables the policy verdict cache.
+func (b *Binary) PatchPolicyCache(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("PVCE", v)
+}
+
+// PatchRedirectNeigh replaces the NEIG placeholder, which makes the program forward with
+// bpf_redirect_neigh() and bpf_redirect_peer().  It must only be set if SupportsRedirectNeigh().
+func (b *Binary) PatchRedirectNeigh(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("NEIG", v)
+}
+
+// PatchGSOSize replaces the GSOS placeholder, which makes the program check the segments of GSO
+// packets, rather than the whole packet, against the MTU.  It must only be set if SupportsGSOSize().
+func (b *Binary) PatchGSOSize(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("GSOS", v)
+}
+
+// PatchKtimeCoarse replaces the KTCO placeholder, which makes the programs stamp the conntrack
+// and NAT affinity entries with bpf_ktime_get_coarse_ns().  It must only be set if
+// SupportsKtimeCoarse().
+func (b *Binary) PatchKtimeCoarse(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("KTCO", v)
+}
+
+// PatchProgLatency replaces the LATH placeholder, which makes the TC programs record how long they
+// take with each packet, see counters.ProgLatencyMapParams.
+func (b *Binary) PatchProgLatency(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("LATH", v)
+}
+
+// PatchLeanTunnel replaces the LEAN placeholder, which makes the tunnel and wireguard programs
+// allow packets without conntrack or NAT, leaving those to the endpoint programs.
+func (b *Binary) PatchLeanTunnel(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("LEAN", v)
+}
+
+// PatchSynCookies replaces the SYNC placeholder, which makes the XDP program answer the SYNs to
+// the ports in the SYN cookie map with SYN cookies.
+func (b *Binary) PatchSynCookies(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("SYNC", v)
+}
+
+// PatchConntrackAccounting replaces the ACCT placeholder, which makes the programs count the packets
+// and bytes of each flow, see conntrack.AcctMapParams.
+func (b *Binary) PatchConntrackAccounting(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("ACCT", v)
+}
+
+// PatchNATOutgoing replaces the SNIP, SNIF and SNPR placeholders, the address and the range of
+// source ports to which the programs SNAT the NAT-outgoing flows of the workloads and the
+// interface that owns the address, the programs only SNAT the flows that leave through it; a zero
+// ifindex skips that check.  A nil ip or a zero maxPort leaves the SNAT to iptables.
+func (b *Binary) PatchNATOutgoing(ip net.IP, ifindex int, minPort, maxPort uint16) error {
+	if ip == nil || maxPort == 0 {
+		b.patchU32Placeholder("SNIP", 0)
+		b.patchU32Placeholder("SNIF", 0)
+		b.patchU32Placeholder("SNPR", 0)
+		return nil
+	}
+	ipv4 := ip.To4()
+	if ipv4 == nil {
+		return errors.Errorf("%s is not IPv4", ip)
+	}
+	if minPort > maxPort {
+		return errors.Errorf("invalid NAT-outgoing port range %d-%d", minPort, maxPort)
+	}
+	b.replaceAllLoadImm32([]byte("SNIP"), []byte(ipv4))
+	b.patchU32Placeholder("SNIF", uint32(ifindex))
+	// The count is one more than the difference and must fit in 16 bits.
+	count := uint32(maxPort) - uint32(minPort) + 1
+	if count > 0xffff {
+		count = 0xffff
+	}
+	b.patchU32Placeholder("SNPR", uint32(minPort)<<16|count)
+	return nil
+}
+
+// PatchEDT replaces the EDTS placeholder, which makes the host endpoint programs shape the egress
+// bandwidth of the workloads in the EDT map, see edt.MapParams.
+func (b *Binary) PatchEDT(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("EDTS", v)
+}
+
+// PatchServiceCounters replaces the SVCC placeholder, which makes the programs count the NAT
+// lookups of new flows per service, see nat.ServiceCountersMapParams.
+func (b *Binary) PatchServiceCounters(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("SVCC", v)
+}
+
+// PatchNUMAReplicas replaces the NUMA placeholder, which makes the programs that run on the second
+// NUMA node look up the replicas of the read-mostly maps, see NUMAReplicatedMap.
+func (b *Binary) PatchNUMAReplicas(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("NUMA", v)
+}
+
+// PatchCPUSteering replaces the CPUM placeholder, the number of CPUs that the XDP program spreads
+// Calico VXLAN packets over; zero leaves them on the CPU that received them.
+func (b *Binary) PatchCPUSteering(cpus uint32) {
+	b.patchU32Placeholder("CPUM", cpus)
+}
+
+// PatchWorkloadInline replaces the WINL placeholder, which makes the programs deliver packets from
+// host endpoints to local workloads inline, see tc.WEPProgsMapParams.  It must only be set if
+// SupportsRedirectNeigh().
+func (b *Binary) PatchWorkloadInline(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("WINL", v)
+}
+
+// PatchSharedProgs replaces the SHRD placeholder, which makes the program find the policy program of
+// the interface in the cali_pol_progs map so that the program can be shared between interfaces,
+// see tc.AttachPoint.AttachSharedProgram.
+func (b *Binary) PatchSharedProgs(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("SHRD", v)
+}
+
+// PatchIfaceConfig replaces the IFCG placeholder, which makes the program read its per-interface
+// values from the cali_v4_ifcfg map rather than from the patched constants, see ifcfg.MapParams.
+func (b *Binary) PatchIfaceConfig(enabled bool) {
+	var v uint32
+	if enabled {
+		v = 1
+	}
+	b.patchU32Placeholder("IFCG", v)
+}
+
+// PatchConntrackGCTimeout replaces one of the CT?? timeout placeholders of the in-kernel conntrack
+// cleanup program, bpf-gpl/conntrack_gc.c, with the timeout in whole seconds.
+func (b *Binary) PatchConntrackGCTimeout(placeholder string, timeout time.Duration) {
+	secs := uint32((timeout + time.Second - 1) / time.Second)
+	logrus.WithFields(logrus.Fields{"placeholder": placeholder, "seconds": secs}).Debug(
+		"Patching conntrack timeout")
+	b.patchU32Placeholder(placeholder, secs)
+}
+
+// Offsets of the fields of struct bpf_map_def_extended in bpf-gpl/bpf.h that we patch.
+const (
+	mapDefTypeOffset       = 0
+	mapDefMaxEntriesOffset = 12
+	mapDefFlagsOffset      = 16
+	mapDefPatchedSize      = 20
+	mapDefPinningOffset    = 24
+)
+
+// PatchMapParams rewrites the type, flags and max entries of the map's definition in the "maps"
+// section so that the loader creates, or accepts the already-pinned, map with those parameters.
+func (b *Binary) PatchMapParams(mp MapParameters) error {
+	mapType, ok := mapTypes[mp.Type]
+	if !ok {
+		return errors.Errorf("unknown map type %q", mp.Type)
+	}
+
+	return b.patchMapDef(mp.versionedName(), func(def []byte, order binary.ByteOrder) {
+		order.PutUint32(def[mapDefTypeOffset:], mapType)
+		order.PutUint32(def[mapDefMaxEntriesOffset:], uint32(mp.MaxEntries))
+		order.PutUint32(def[mapDefFlagsOffset:], uint32(mp.Flags))
+	})
+}
+
+// PatchMapSize rewrites the max entries of the definition of the map with the given versioned name.
+func (b *Binary) PatchMapSize(name string, maxEntries uint32) error {
+	return b.patchMapDef(name, func(def []byte, order binary.ByteOrder) {
+		order.PutUint32(def[mapDefMaxEntriesOffset:], maxEntries)
+	})
+}
+
+// PatchMapNUMANode sets BPF_F_NUMA_NODE in the flags of the definition of the map with the given
+// versioned name, to match the pinned map that Felix created on a NUMA node, see
+// MapContext.NUMANodes.  The loader refuses pinned maps whose flags differ from the definition.
+func (b *Binary) PatchMapNUMANode(name string) error {
+	return b.patchMapDef(name, func(def []byte, order binary.ByteOrder) {
+		flags := order.Uint32(def[mapDefFlagsOffset:])
+		order.PutUint32(def[mapDefFlagsOffset:], flags|unix.BPF_F_NUMA_NODE)
+	})
+}
+
+// patchMapDef calls patch with the definition of the named map in the "maps" section.  It does nothing
+// if the binary doesn't use the map.
+func (b *Binary) patchMapDef(name string, patch func(def []byte, order binary.ByteOrder)) error {
+	found := false
+	err := b.forEachMapDef(func(symName string, def []byte, order binary.ByteOrder) error {
+		if symName != name {
+			return nil
+		}
+		if len(def) < mapDefPatchedSize {
+			return errors.Errorf("definition of map %s is too short", name)
+		}
+		patch(def[:mapDefPatchedSize], order)
+		logrus.WithField("map", name).Debug("Patched map definition")
+		found = true
+		return nil
+	})
+	if err != nil {
+		return err
+	}
+
+	if !found {
+		// Not all programs use all the maps.
+		logrus.WithField("map", name).Debug("Map not defined in BPF binary, nothing to patch")
+	}
+	return nil
+}
+
+// forEachMapDef calls fn with the name and the definition, in place, of each map in the "maps" section.
+func (b *Binary) forEachMapDef(fn func(name string, def []byte, order binary.ByteOrder) error) error {
+	f, err := elf.NewFile(bytes.NewReader(b.raw))
+	if err != nil {
+		return errors.Errorf("failed to parse BPF binary: %s", err)
+	}
+	defer f.Close()
+
+	sec := f.Section("maps")
+	if sec == nil {
+		return errors.New("BPF binary has no maps section")
+	}
+	syms, err := f.Symbols()
+	if err != nil {
+		return errors.Errorf("failed to read BPF binary symbols: %s", err)
+	}
+
+	for _, sym := range syms {
+		if sym.Name == "" || int(sym.Section) >= len(f.Sections) || f.Sections[sym.Section] != sec {
+			continue
+		}
+		off := sec.Offset + sym.Value
+		if off+sym.Size > uint64(len(b.raw)) {
+			return errors.Errorf("definition of map %s is out of range", sym.Name)
+		}
+		err := fn(sym.Name, b.raw[off:off+sym.Size], f.ByteOrder)
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Pinning strategies of the maps, as understood by the iproute2 loader.
+const (
+	MapPinNone   = 0
+	MapPinObject = 1
+	MapPinGlobal = 2
+)
+
+// MapPinning returns the pinning strategy of each map of the binary that is loaded through iproute2,
+// indexed by the name of the map.
+func (b *Binary) MapPinning() (map[string]uint32, error) {
+	pinning := map[string]uint32{}
+	err := b.forEachMapDef(func(name string, def []byte, order binary.ByteOrder) error {
+		if len(def) >= mapDefPinningOffset+4 {
+			pinning[name] = order.Uint32(def[mapDefPinningOffset:])
+		} else {
+			pinning[name] = MapPinNone
+		}
+		return nil
+	})
+	return pinning, err
+}
+
+// StripIPRoute2MapDefs zeroes the fields of the map definitions that only the iproute2 loader
+// understands.  libbpf, and hence bpftool, refuses to load a binary with those fields set.
+func (b *Binary) StripIPRoute2MapDefs() error {
+	return b.forEachMapDef(func(name string, def []byte, order binary.ByteOrder) error {
+		for i := mapDefPatchedSize; i < len(def); i++ {
+			def[i] = 0
+		}
+		return nil
+	})
+}
+
+// Hash returns a hash of the contents of the binary, which identifies a patched binary.
+func (b *Binary) Hash() string {
+	sum := sha256.Sum256(b.raw)
+	return hex.EncodeToString(sum[:])
+}
+
 // patchU32Placeholder replaces a placeholder with the given value.
 func (b *Binary) patchU32Placeholder(from string, to uint32) {
 	toBytes := make([]byte, 4)
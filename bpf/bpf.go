@@ -72,10 +72,16 @@ const (
 	sockopsProgName            = "calico_sockops_" + sockopsProgVersion
 	skMsgProgVersion           = "v1"
 	skMsgProgName              = "calico_sk_msg_" + skMsgProgVersion
-	sockMapVersion             = "v1"
+	sockMapVersion             = "v2"
 	sockMapName                = "calico_sock_map_" + sockMapVersion
 	sockmapEndpointsMapVersion = "v1"
 	sockmapEndpointsMapName    = "calico_sk_endpoints_" + sockmapEndpointsMapVersion
+	sockmapMsgConfigMapVersion = "v1"
+	sockmapMsgConfigMapName    = "calico_sk_msg_cfg_" + sockmapMsgConfigMapVersion
+
+	// legacySockMapName is the map with the shorter keys used before endpoint-to-endpoint
+	// acceleration; it's only ever removed.
+	legacySockMapName = "calico_sock_map_v1"
 
 	defaultBPFfsPath = "/sys/fs/bpf"
 )
@@ -99,6 +105,11 @@ var (
 	// v5Dot3Dot0 is the first kernel version that has all the
 	// required features we use for BPF dataplane mode
 	v5Dot3Dot0 = versionparse.MustParseVersion("5.3.0")
+	// v5Dot7Dot0 is the first kernel version that exposes gso_size in __sk_buff
+	v5Dot7Dot0 = versionparse.MustParseVersion("5.7.0")
+	// v5Dot10Dot0 is the first kernel version that has the bpf_redirect_neigh() and
+	// bpf_redirect_peer() helpers
+	v5Dot10Dot0 = versionparse.MustParseVersion("5.10.0")
 )
 
 var distToVersionMap = map[string]*versionparse.Version{
@@ -363,6 +374,9 @@ type BPFDataplane interface {
 	LookupSockmapEndpointsMap(ip net.IP, mask int) (bool, error)
 	RemoveItemSockmapEndpointsMap(ip net.IP, mask int) error
 	RemoveSockmapEndpointsMap() error
+	NewSockmapMsgConfigMap() (string, error)
+	UpdateSockmapMsgConfig(applyBytes, corkBytes uint32) error
+	RemoveSockmapMsgConfigMap() error
 }
 
 func getCIDRMapName(ifName string, family IPFamily) string {
@@ -1728,6 +1742,8 @@ func clearSockmap(mapArgs []string) error {
 }
 
 func (b *BPFLib) RemoveSockmap(mode FindObjectMode) error {
+	_ = os.Remove(filepath.Join(b.sockmapDir, legacySockMapName))
+
 	mapPath := filepath.Join(b.sockmapDir, sockMapName)
 	defer os.Remove(mapPath)
 	if err := clearSockmap([]string{"pinned", mapPath}); err != nil {
@@ -1863,11 +1879,13 @@ func (b *BPFLib) RemoveSockops() error {
 
 func (b *BPFLib) getSkMsgArgs() ([]string, error) {
 	sockmapPath := filepath.Join(b.sockmapDir, sockMapName)
+	msgConfigPath := filepath.Join(b.sockmapDir, sockmapMsgConfigMapName)
 
 	// key: symbol of the map definition in the XDP program
 	// value: path where the map is pinned
 	maps := map[string]string{
-		"calico_sock_map": sockmapPath,
+		"calico_sock_map":   sockmapPath,
+		"calico_sk_msg_cfg": msgConfigPath,
 	}
 
 	var mapArgs []string
@@ -1978,7 +1996,8 @@ func (b *BPFLib) DetachFromCgroup(mode FindObjectMode) error {
 func (b *BPFLib) NewSockmap() (string, error) {
 	mapPath := filepath.Join(b.sockmapDir, sockMapName)
 
-	keySize := 12
+	// WARNING: must be kept in sync with struct sock_key in bpf-apache/sockops.h.
+	keySize := 20
 	valueSize := 4
 
 	return newMap(sockMapName,
@@ -2172,6 +2191,70 @@ func (b *BPFLib) RemoveSockmapEndpointsMap() error {
 	return os.Remove(mapPath)
 }
 
+func (b *BPFLib) NewSockmapMsgConfigMap() (string, error) {
+	mapPath := filepath.Join(b.sockmapDir, sockmapMsgConfigMapName)
+
+	// WARNING: must be kept in sync with struct sk_msg_cfg in bpf-apache/redir.c.
+	keySize := 4
+	valueSize := 8
+
+	return newMap(sockmapMsgConfigMapName,
+		mapPath,
+		"array",
+		1,
+		keySize,
+		valueSize,
+		0,
+	)
+}
+
+// UpdateSockmapMsgConfig sets the number of bytes that the sk_msg program applies a redirect
+// verdict to and the number of bytes that it corks a redirected socket for, see struct sk_msg_cfg
+// in bpf-apache/redir.c.
+func (b *BPFLib) UpdateSockmapMsgConfig(applyBytes, corkBytes uint32) error {
+	mapPath := filepath.Join(b.sockmapDir, sockmapMsgConfigMapName)
+
+	prog := "bpftool"
+	args := []string{
+		"map",
+		"update",
+		"pinned",
+		mapPath,
+		"key",
+		"hex",
+		"00", "00", "00", "00",
+		"value",
+		"hex"}
+	args = append(args, sockmapMsgConfigValueToHex(applyBytes, corkBytes)...)
+
+	printCommand(prog, args...)
+	output, err := exec.Command(prog, args...).CombinedOutput()
+	if err != nil {
+		return fmt.Errorf("failed to update map (%s): %s\n%s", sockmapMsgConfigMapName, err, output)
+	}
+
+	return nil
+}
+
+func sockmapMsgConfigValueToHex(applyBytes, corkBytes uint32) []string {
+	value := make([]byte, 8)
+	nativeEndian.PutUint32(value[:4], applyBytes)
+	nativeEndian.PutUint32(value[4:], corkBytes)
+
+	var ret []string
+	for _, b := range value {
+		ret = append(ret, fmt.Sprintf("%02x", b))
+	}
+
+	return ret
+}
+
+func (b *BPFLib) RemoveSockmapMsgConfigMap() error {
+	mapPath := filepath.Join(b.sockmapDir, sockmapMsgConfigMapName)
+
+	return os.Remove(mapPath)
+}
+
 func isAtLeastKernel(v *versionparse.Version) error {
 	versionReader, err := versionparse.GetKernelVersionReader()
 	if err != nil {
@@ -2203,6 +2286,32 @@ func SupportsSockmap() error {
 	return nil
 }
 
+// SupportsRedirectNeigh returns nil if the kernel has the bpf_redirect_neigh() and
+// bpf_redirect_peer() helpers.
+func SupportsRedirectNeigh() error {
+	if !SyscallSupport() {
+		return isAtLeastKernel(v5Dot10Dot0)
+	}
+	if f := DetectFeatures(); !f.RedirectNeigh || !f.RedirectPeer {
+		return errors.New("kernel lacks bpf_redirect_neigh() or bpf_redirect_peer()")
+	}
+	return nil
+}
+
+// SupportsGSOSize returns nil if the kernel lets TC programs read the GSO segment size of the skb.
+func SupportsGSOSize() error {
+	return isAtLeastKernel(v5Dot7Dot0)
+}
+
+// SupportsKtimeCoarse returns nil if programs can read the jiffy-precision clock with
+// bpf_ktime_get_coarse_ns().
+func SupportsKtimeCoarse() error {
+	if !DetectFeatures().KtimeCoarse {
+		return errors.New("kernel lacks bpf_ktime_get_coarse_ns()")
+	}
+	return nil
+}
+
 func GetMinKernelVersionForDistro(distName string) *versionparse.Version {
 	return distToVersionMap[distName]
 }
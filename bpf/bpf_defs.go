@@ -38,6 +38,30 @@ func (f ProgFD) Close() error {
 	return unix.Close(int(f))
 }
 
+// LinkFD is a BPF link, which keeps a program attached for as long as the link is open or pinned.
+type LinkFD uint32
+
+func (f LinkFD) Close() error {
+	log.WithField("fd", int(f)).Debug("Closing LinkFD")
+	return unix.Close(int(f))
+}
+
+// LinkAttachType is the attach type of a link to an interface, see CreateLink.
+type LinkAttachType uint32
+
+const (
+	LinkAttachTCXIngress LinkAttachType = 46
+	LinkAttachTCXEgress  LinkAttachType = 47
+)
+
+// LinkInfo is the subset of struct bpf_link_info that we use.  IfIndex is zero once the interface
+// of a link to an interface has gone; the link stays around, detached, until it is closed.
+type LinkInfo struct {
+	ID      int
+	ProgID  int
+	IfIndex int
+}
+
 func IsNotExists(err error) bool {
 	return err == unix.ENOENT
 }
@@ -49,9 +73,25 @@ type ProgResult struct {
 }
 
 type MapInfo struct {
-	Type      int
-	KeySize   int
-	ValueSize int
+	Type       int
+	KeySize    int
+	ValueSize  int
+	MaxEntries int
+	Flags      int
+}
+
+// ProgInfo is the subset of struct bpf_prog_info that we report.  Fields that the kernel doesn't
+// support are zero: VerifiedInsns needs 5.16 and the run statistics are only collected while
+// kernel.bpf_stats_enabled is set.
+type ProgInfo struct {
+	Type          int
+	ID            int
+	Name          string
+	XlatedLen     int
+	JitedLen      int
+	RunTime       time.Duration
+	RunCount      uint64
+	VerifiedInsns int
 }
 
 const ObjectDir = "/usr/lib/calico/bpf"
@@ -62,3 +102,6 @@ var ErrIterationFinished = errors.New("iteration finished")
 // ErrVisitedTooManyKeys is returned by the MapIterator's Next() method if it sees many more keys than there should
 // be in the map.
 var ErrVisitedTooManyKeys = errors.New("visited 10x the max size of the map keys")
+
+// ErrBatchNotSupported is returned by the batch map operations if the kernel or the map type doesn't support them.
+var ErrBatchNotSupported = errors.New("batch map operations not supported")
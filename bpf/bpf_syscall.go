@@ -15,10 +15,13 @@
 package bpf
 
 import (
+	"bytes"
+	"encoding/binary"
 	"reflect"
 	"runtime"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"syscall"
 	"time"
 	"unsafe"
@@ -68,11 +71,36 @@ func GetMapFDByID(mapID int) (MapFD, error) {
 	return MapFD(fd), nil
 }
 
+func GetProgFDByID(progID int) (ProgFD, error) {
+	log.Debugf("GetProgFDByID(%v)", progID)
+	bpfAttr := C.bpf_attr_alloc()
+	defer C.free(unsafe.Pointer(bpfAttr))
+
+	// prog_id shares its offset in the union with map_id.
+	C.bpf_attr_setup_obj_get_id(bpfAttr, C.uint(progID), 0)
+	fd, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_PROG_GET_FD_BY_ID, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
+	if errno != 0 {
+		return 0, errno
+	}
+
+	return ProgFD(fd), nil
+}
+
 const defaultLogSize = 1024 * 1024
 const maxLogSize = 128 * 1024 * 1024
 
 func LoadBPFProgramFromInsns(insns asm.Insns, license string) (fd ProgFD, err error) {
-	log.Debugf("LoadBPFProgramFromInsns(%v, %v)", insns, license)
+	return loadBPFProgramFromInsns(insns, license, unix.BPF_PROG_TYPE_SCHED_CLS)
+}
+
+// LoadXDPProgramFromInsns is like LoadBPFProgramFromInsns but for programs that run in XDP, such as
+// the policy programs of the XDP program, see polprog.Builder.EnableXDP.
+func LoadXDPProgramFromInsns(insns asm.Insns, license string) (fd ProgFD, err error) {
+	return loadBPFProgramFromInsns(insns, license, unix.BPF_PROG_TYPE_XDP)
+}
+
+func loadBPFProgramFromInsns(insns asm.Insns, license string, progType uint32) (fd ProgFD, err error) {
+	log.Debugf("LoadBPFProgramFromInsns(%v, %v, %v)", insns, license, progType)
 	increaseLockedMemoryQuota()
 
 	// Occasionally see retryable errors here, retry silently a few times before going into log-collection mode.
@@ -80,7 +108,7 @@ func LoadBPFProgramFromInsns(insns asm.Insns, license string) (fd ProgFD, err er
 	for retries := 10; retries > 0; retries-- {
 		// By default, try to load the program with logging disabled.  This has two advantages: better performance
 		// and the fact that the log cannot overflow.
-		fd, err = tryLoadBPFProgramFromInsns(insns, license, 0)
+		fd, err = tryLoadBPFProgramFromInsns(insns, license, progType, 0)
 		if err == nil {
 			log.WithField("fd", fd).Debug("Loaded program successfully")
 			return fd, nil
@@ -94,7 +122,7 @@ func LoadBPFProgramFromInsns(insns asm.Insns, license string) (fd ProgFD, err er
 	log.WithError(err).Warn("Failed to load BPF program; collecting diagnostics...")
 	var logSize uint = defaultLogSize
 	for {
-		fd, err2 := tryLoadBPFProgramFromInsns(insns, license, logSize)
+		fd, err2 := tryLoadBPFProgramFromInsns(insns, license, progType, logSize)
 		if err2 == nil {
 			// Unexpected but we'll take it.
 			log.Warn("Retry succeeded.")
@@ -113,8 +141,8 @@ func LoadBPFProgramFromInsns(insns asm.Insns, license string) (fd ProgFD, err er
 	}
 }
 
-func tryLoadBPFProgramFromInsns(insns asm.Insns, license string, logSize uint) (ProgFD, error) {
-	log.Debugf("tryLoadBPFProgramFromInsns(..., %v, %v)", license, logSize)
+func tryLoadBPFProgramFromInsns(insns asm.Insns, license string, progType uint32, logSize uint) (ProgFD, error) {
+	log.Debugf("tryLoadBPFProgramFromInsns(..., %v, %v, %v)", license, progType, logSize)
 	bpfAttr := C.bpf_attr_alloc()
 	defer C.free(unsafe.Pointer(bpfAttr))
 
@@ -131,7 +159,7 @@ func tryLoadBPFProgramFromInsns(insns asm.Insns, license string, logSize uint) (
 		defer C.free(logBuf)
 	}
 
-	C.bpf_attr_setup_load_prog(bpfAttr, unix.BPF_PROG_TYPE_SCHED_CLS, C.uint(len(insns)), cInsnBytes, cLicense, (C.uint)(logLevel), (C.uint)(logSize), logBuf)
+	C.bpf_attr_setup_load_prog(bpfAttr, C.uint(progType), C.uint(len(insns)), cInsnBytes, cLicense, (C.uint)(logLevel), (C.uint)(logSize), logBuf)
 	fd, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_PROG_LOAD, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
 
 	if errno != 0 && errno != unix.ENOSPC /* log buffer too small */ {
@@ -152,6 +180,54 @@ func tryLoadBPFProgramFromInsns(insns asm.Insns, license string, logSize uint) (
 	return ProgFD(fd), nil
 }
 
+// ProbeProgram loads the program, once and without logging verifier errors, to find out whether the
+// kernel supports it.  It returns the verifier log if the load fails.
+func ProbeProgram(insns asm.Insns) (string, error) {
+	increaseLockedMemoryQuota()
+
+	bpfAttr := C.bpf_attr_alloc()
+	defer C.free(unsafe.Pointer(bpfAttr))
+
+	cInsnBytes := C.CBytes(insns.AsBytes())
+	defer C.free(cInsnBytes)
+	cLicense := C.CString("GPL")
+	defer C.free(unsafe.Pointer(cLicense))
+	const logSize = 64 * 1024
+	logBuf := C.malloc(logSize)
+	defer C.free(logBuf)
+
+	C.bpf_attr_setup_load_prog(bpfAttr, unix.BPF_PROG_TYPE_SCHED_CLS, C.uint(len(insns)), cInsnBytes, cLicense, 1, logSize, logBuf)
+	fd, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_PROG_LOAD, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
+	if errno != 0 {
+		return strings.TrimSpace(C.GoString((*C.char)(logBuf))), errno
+	}
+	_ = unix.Close(int(fd))
+	return "", nil
+}
+
+// ProbeMapType creates, and closes, a map of the given type and parameters to find out whether the
+// kernel supports them.
+func ProbeMapType(mapType, keySize, valueSize, maxEntries, flags uint32) error {
+	increaseLockedMemoryQuota()
+
+	errno := C.bpf_probe_map_create(C.uint(mapType), C.uint(keySize), C.uint(valueSize), C.uint(maxEntries), C.uint(flags))
+	if errno != 0 {
+		return unix.Errno(errno)
+	}
+	return nil
+}
+
+// ProbeMapBatchOps returns nil if the kernel supports the BPF_MAP_*_BATCH commands on hash maps.
+func ProbeMapBatchOps() error {
+	increaseLockedMemoryQuota()
+
+	errno := unix.Errno(C.bpf_probe_map_batch())
+	if errno == 0 || errno == unix.ENOENT {
+		return nil
+	}
+	return errno
+}
+
 var memLockOnce sync.Once
 
 func increaseLockedMemoryQuota() {
@@ -213,6 +289,126 @@ func PinBPFProgram(fd ProgFD, filename string) error {
 	return nil
 }
 
+// CreateMap creates a map, on NUMA node numaNode if flags has BPF_F_NUMA_NODE, which bpftool can't
+// do.
+func CreateMap(mapType, keySize, valueSize, maxEntries, flags, numaNode uint32, name string) (MapFD, error) {
+	increaseLockedMemoryQuota()
+
+	bpfAttr := C.bpf_attr_alloc()
+	defer C.free(unsafe.Pointer(bpfAttr))
+
+	cName := C.CString(name)
+	defer C.free(unsafe.Pointer(cName))
+
+	C.bpf_attr_setup_map_create(bpfAttr, C.uint(mapType), C.uint(keySize), C.uint(valueSize), C.uint(maxEntries),
+		C.uint(flags), C.uint(numaNode), cName)
+	fd, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_MAP_CREATE, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
+	if errno != 0 {
+		return 0, errno
+	}
+	return MapFD(fd), nil
+}
+
+// PinMap pins the map at filename.
+func PinMap(fd MapFD, filename string) error {
+	return PinBPFProgram(ProgFD(fd), filename) // BPF_OBJ_PIN works for any object.
+}
+
+// GetProgFDByPin returns an fd of the program pinned at filename.
+func GetProgFDByPin(filename string) (ProgFD, error) {
+	fd, err := GetMapFDByPin(filename) // BPF_OBJ_GET works for any pinned object.
+	return ProgFD(fd), err
+}
+
+// CreateLink attaches the program to the interface through a new link.  The program stays
+// attached until the link is closed and unpinned.
+func CreateLink(progFD ProgFD, ifIndex int, attachType LinkAttachType) (LinkFD, error) {
+	rc := C.bpf_link_create(C.uint(progFD), C.uint(ifIndex), C.uint(attachType))
+	if rc < 0 {
+		return 0, unix.Errno(-rc)
+	}
+	return LinkFD(rc), nil
+}
+
+// UpdateLink atomically replaces the program of the link, packets see either the old or the new
+// program.
+func UpdateLink(linkFD LinkFD, progFD ProgFD) error {
+	rc := C.bpf_link_update(C.uint(linkFD), C.uint(progFD))
+	if rc < 0 {
+		return unix.Errno(-rc)
+	}
+	return nil
+}
+
+// PinLink pins the link at filename so that it outlives our fd.
+func PinLink(fd LinkFD, filename string) error {
+	return PinBPFProgram(ProgFD(fd), filename) // BPF_OBJ_PIN works for any object.
+}
+
+// GetLinkFDByPin returns an fd of the link pinned at filename.
+func GetLinkFDByPin(filename string) (LinkFD, error) {
+	fd, err := GetMapFDByPin(filename)
+	return LinkFD(fd), err
+}
+
+// Offsets of the fields of struct bpf_link_info that GetLinkInfo reads; the ifindex is that of
+// the tcx and XDP links.
+const (
+	linkInfoOffID      = 4
+	linkInfoOffProgID  = 8
+	linkInfoOffIfIndex = 16
+	linkInfoSize       = 64
+)
+
+// GetLinkInfo returns the information that the kernel has about a link to an interface.
+func GetLinkInfo(fd LinkFD) (*LinkInfo, error) {
+	bpfAttr := C.bpf_attr_alloc()
+	defer C.free(unsafe.Pointer(bpfAttr))
+	cInfo := C.calloc(1, linkInfoSize)
+	defer C.free(cInfo)
+
+	C.bpf_attr_setup_get_info(bpfAttr, C.uint(fd), linkInfoSize, cInfo)
+	_, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_OBJ_GET_INFO_BY_FD, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
+	if errno != 0 {
+		return nil, errno
+	}
+
+	info := C.GoBytes(cInfo, linkInfoSize)
+	return &LinkInfo{
+		ID:      int(binary.LittleEndian.Uint32(info[linkInfoOffID:])),
+		ProgID:  int(binary.LittleEndian.Uint32(info[linkInfoOffProgID:])),
+		IfIndex: int(binary.LittleEndian.Uint32(info[linkInfoOffIfIndex:])),
+	}, nil
+}
+
+// RunMapIterator runs the BPF_TRACE_ITER program progFD over all the elements of the map
+// mapFD.  The program is expected to do its work in place, any output that it writes is
+// discarded.
+func RunMapIterator(progFD ProgFD, mapFD MapFD) error {
+	rc := C.bpf_map_iter_create(C.uint(progFD), C.uint(mapFD))
+	if rc < 0 {
+		return unix.Errno(-rc)
+	}
+	iterFD := int(rc)
+	defer unix.Close(iterFD)
+
+	buf := make([]byte, 4096)
+	for {
+		n, err := unix.Read(iterFD, buf)
+		if err == unix.EINTR || err == unix.EAGAIN {
+			// EAGAIN means that the kernel stopped after a large number of elements to
+			// avoid hogging the CPU, the next read resumes where it left off.
+			continue
+		}
+		if err != nil {
+			return err
+		}
+		if n == 0 {
+			return nil
+		}
+	}
+}
+
 func UpdateMapEntry(mapFD MapFD, k, v []byte) error {
 	log.Debugf("UpdateMapEntry(%v, %v, %v)", mapFD, k, v)
 
@@ -258,6 +454,27 @@ func GetMapEntry(mapFD MapFD, k []byte, valueSize int) ([]byte, error) {
 	return val, nil
 }
 
+// GetMapEntryPerCPU looks up a key in a per-CPU map.  The kernel returns one value per possible CPU, each
+// padded to a multiple of 8 bytes.
+func GetMapEntryPerCPU(mapFD MapFD, k []byte, valueSize, numCPUs int) ([]byte, error) {
+	log.Debugf("GetMapEntryPerCPU(%v, %v, %v, %v)", mapFD, k, valueSize, numCPUs)
+
+	err := checkMapIfDebug(mapFD, len(k), valueSize)
+	if err != nil {
+		return nil, err
+	}
+
+	val := make([]byte, align64(valueSize)*numCPUs)
+
+	errno := C.bpf_map_call(unix.BPF_MAP_LOOKUP_ELEM, C.uint(mapFD),
+		unsafe.Pointer(&k[0]), unsafe.Pointer(&val[0]), 0)
+	if errno != 0 {
+		return nil, unix.Errno(errno)
+	}
+
+	return val, nil
+}
+
 func checkMapIfDebug(mapFD MapFD, keySize, valueSize int) error {
 	if log.GetLevel() >= log.DebugLevel {
 		mapInfo, err := GetMapInfo(mapFD)
@@ -289,9 +506,58 @@ func GetMapInfo(fd MapFD) (*MapInfo, error) {
 		return nil, errno
 	}
 	return &MapInfo{
-		Type:      int(bpfMapInfo._type),
-		KeySize:   int(bpfMapInfo.key_size),
-		ValueSize: int(bpfMapInfo.value_size),
+		Type:       int(bpfMapInfo._type),
+		KeySize:    int(bpfMapInfo.key_size),
+		ValueSize:  int(bpfMapInfo.value_size),
+		MaxEntries: int(bpfMapInfo.max_entries),
+		Flags:      int(bpfMapInfo.map_flags),
+	}, nil
+}
+
+// Offsets of the fields of struct bpf_prog_info that GetProgInfo reads.  The struct is decoded by
+// hand because the fields that we want are newer than the kernel headers that we build against.
+const (
+	progInfoOffType          = 0
+	progInfoOffID            = 4
+	progInfoOffJitedLen      = 16
+	progInfoOffXlatedLen     = 20
+	progInfoOffName          = 64
+	progInfoNameLen          = 16
+	progInfoOffRunTimeNs     = 192
+	progInfoOffRunCnt        = 200
+	progInfoOffVerifiedInsns = 216
+	progInfoSize             = 232
+)
+
+// GetProgInfo returns the information that the kernel has about a program, including its verifier
+// and runtime statistics.
+func GetProgInfo(fd ProgFD) (*ProgInfo, error) {
+	bpfAttr := C.bpf_attr_alloc()
+	defer C.free(unsafe.Pointer(bpfAttr))
+	// The kernel fills in the prefix that it knows about and requires the rest to be zero.
+	cInfo := C.calloc(1, progInfoSize)
+	defer C.free(cInfo)
+
+	C.bpf_attr_setup_get_info(bpfAttr, C.uint(fd), progInfoSize, cInfo)
+	_, _, errno := unix.Syscall(unix.SYS_BPF, unix.BPF_OBJ_GET_INFO_BY_FD, uintptr(unsafe.Pointer(bpfAttr)), C.sizeof_union_bpf_attr)
+	if errno != 0 {
+		return nil, errno
+	}
+
+	info := C.GoBytes(cInfo, progInfoSize)
+	name := info[progInfoOffName : progInfoOffName+progInfoNameLen]
+	if i := bytes.IndexByte(name, 0); i >= 0 {
+		name = name[:i]
+	}
+	return &ProgInfo{
+		Type:          int(binary.LittleEndian.Uint32(info[progInfoOffType:])),
+		ID:            int(binary.LittleEndian.Uint32(info[progInfoOffID:])),
+		Name:          string(name),
+		XlatedLen:     int(binary.LittleEndian.Uint32(info[progInfoOffXlatedLen:])),
+		JitedLen:      int(binary.LittleEndian.Uint32(info[progInfoOffJitedLen:])),
+		RunTime:       time.Duration(binary.LittleEndian.Uint64(info[progInfoOffRunTimeNs:])),
+		RunCount:      binary.LittleEndian.Uint64(info[progInfoOffRunCnt:]),
+		VerifiedInsns: int(binary.LittleEndian.Uint32(info[progInfoOffVerifiedInsns:])),
 	}, nil
 }
 
@@ -324,6 +590,49 @@ func DeleteMapEntryIfExists(mapFD MapFD, k []byte, valueSize int) error {
 // Batch size established by trial and error; 8-32 seemed to be the sweet spot for the conntrack map.
 const MapIteratorNumKeys = 16
 
+// MapIteratorBatchNumKeys is the number of entries that we ask the kernel for in one BPF_MAP_LOOKUP_BATCH
+// call.  It needs to be larger than the longest hash bucket chain (or the kernel returns ENOSPC) and large enough
+// to amortise the syscall but small enough that the C buffers stay modest for big values.
+const MapIteratorBatchNumKeys = 1024
+
+// MapDeleteBatchNumKeys is the number of keys that we queue up before issuing a BPF_MAP_DELETE_BATCH.
+const MapDeleteBatchNumKeys = 1024
+
+const (
+	batchOpsUnknown int32 = iota
+	batchOpsSupported
+	batchOpsUnsupported
+)
+
+// batchOpsState records whether the kernel supports the BPF_MAP_*_BATCH commands at all.  It is determined lazily
+// by the first batch operation that we attempt.
+var batchOpsState = batchOpsUnknown
+
+// MapBatchOpsSupported returns true unless a previous batch operation has shown that the kernel doesn't support the
+// BPF_MAP_*_BATCH commands.  Support is also map-type dependent so callers must still handle the fallback.
+func MapBatchOpsSupported() bool {
+	return atomic.LoadInt32(&batchOpsState) != batchOpsUnsupported
+}
+
+// noteMapBatchOpsUnsupported records that the feature probe found no batch support.
+func noteMapBatchOpsUnsupported() {
+	atomic.StoreInt32(&batchOpsState, batchOpsUnsupported)
+}
+
+// isBatchUnsupportedErr returns true if the errno returned by a batch command indicates that the kernel or the map
+// type doesn't support batch operations.  Pre-5.6 kernels reject the unknown command with EINVAL; newer kernels
+// return ENOTSUPP (the kernel-internal 524) for map types that don't implement the operation.
+func isBatchUnsupportedErr(errno unix.Errno) bool {
+	switch errno {
+	case unix.EINVAL:
+		atomic.CompareAndSwapInt32(&batchOpsState, batchOpsUnknown, batchOpsUnsupported)
+		return true
+	case unix.ENOTSUP, unix.Errno(524) /* ENOTSUPP */ :
+		return true
+	}
+	return false
+}
+
 // MapIterator handles one pass of iteration over the map.
 type MapIterator struct {
 	// Metadata about the map.
@@ -343,14 +652,26 @@ type MapIterator struct {
 	// bpf_map_load_multi.
 	keyBeforeNextBatch unsafe.Pointer
 
-	// keys points to a buffer containing up to MapIteratorNumKeys keys
+	// keys points to a buffer containing up to MapIteratorNumKeys keys (MapIteratorBatchNumKeys in batch mode).
 	keys unsafe.Pointer
-	// values points to a buffer containing up to MapIteratorNumKeys values
+	// values points to a buffer containing up to MapIteratorNumKeys values (MapIteratorBatchNumKeys in batch mode).
 	values unsafe.Pointer
 
+	// batchMode is true while we're using BPF_MAP_LOOKUP_BATCH.  We clear it and fall back to
+	// bpf_map_load_multi if the kernel rejects the first batch.
+	batchMode bool
+	// batchStarted is set once we've done our first BPF_MAP_LOOKUP_BATCH; after that we pass batchIn to the kernel.
+	batchStarted bool
+	// batchDone is set once the kernel has told us that the last batch reached the end of the map.
+	batchDone bool
+	// batchIn and batchOut hold the kernel's opaque batch position token.
+	batchIn, batchOut unsafe.Pointer
+
 	// valueStride is the step through the values buffer.  I.e. the size of the value rounded up for alignment.
+	// In batch mode, the kernel packs the values so the stride is the value size.
 	valueStride int
 	// keyStride is the step through the keys buffer.  I.e. the size of the key rounded up for alignment.
+	// In batch mode, the kernel packs the keys so the stride is the key size.
 	keyStride int
 	// numEntriesLoaded is the number of valid entries in the key and values buffers.
 	numEntriesLoaded int
@@ -359,14 +680,9 @@ type MapIterator struct {
 	// numEntriesVisited is incremented for each entry that we visit.  Used as a sanity check in case we go into an
 	// infinite loop.
 	numEntriesVisited int
-}
 
-// align64 rounds up the given size to the nearest 8-bytes.
-func align64(size int) int {
-	if size%8 == 0 {
-		return size
-	}
-	return size + (8 - (size % 8))
+	// packed is the buffer in which NextBatch packs the aligned entries of bpf_map_load_multi.
+	packed []byte
 }
 
 func NewMapIterator(mapFD MapFD, keySize, valueSize, maxEntries int) (*MapIterator, error) {
@@ -375,25 +691,29 @@ func NewMapIterator(mapFD MapFD, keySize, valueSize, maxEntries int) (*MapIterat
 		return nil, err
 	}
 
-	keyStride := align64(keySize)
-	valueStride := align64(valueSize)
-
-	keysBufSize := (C.size_t)(keyStride * MapIteratorNumKeys)
-	valueBufSize := (C.size_t)(valueStride * MapIteratorNumKeys)
-
 	m := &MapIterator{
-		mapFD:       mapFD,
-		maxEntries:  maxEntries,
-		keySize:     keySize,
-		valueSize:   valueSize,
-		keyStride:   keyStride,
-		valueStride: valueStride,
-		keys:        C.malloc(keysBufSize),
-		values:      C.malloc(valueBufSize),
+		mapFD:      mapFD,
+		maxEntries: maxEntries,
+		keySize:    keySize,
+		valueSize:  valueSize,
 	}
 
-	C.memset(m.keys, 0, (C.size_t)(keysBufSize))
-	C.memset(m.values, 0, (C.size_t)(valueBufSize))
+	if MapBatchOpsSupported() {
+		m.batchMode = true
+		m.keyStride = keySize
+		m.valueStride = valueSize
+		m.allocBuffers(MapIteratorBatchNumKeys)
+
+		// The batch token is a bucket index for hash maps and a key for other map types; size it for the
+		// larger of the two.
+		tokenSize := (C.size_t)(align64(keySize))
+		m.batchIn = C.malloc(tokenSize)
+		m.batchOut = C.malloc(tokenSize)
+		C.memset(m.batchIn, 0, tokenSize)
+		C.memset(m.batchOut, 0, tokenSize)
+	} else {
+		m.useLegacyMode()
+	}
 
 	// Make sure the C buffers are cleaned up.
 	runtime.SetFinalizer(m, func(m *MapIterator) {
@@ -406,6 +726,84 @@ func NewMapIterator(mapFD MapFD, keySize, valueSize, maxEntries int) (*MapIterat
 	return m, nil
 }
 
+func (m *MapIterator) allocBuffers(numKeys int) {
+	keysBufSize := (C.size_t)(m.keyStride * numKeys)
+	valueBufSize := (C.size_t)(m.valueStride * numKeys)
+
+	m.keys = C.malloc(keysBufSize)
+	m.values = C.malloc(valueBufSize)
+
+	C.memset(m.keys, 0, keysBufSize)
+	C.memset(m.values, 0, valueBufSize)
+}
+
+// useLegacyMode (re)configures the iterator to use bpf_map_load_multi, which does a BPF_MAP_GET_NEXT_KEY and a
+// BPF_MAP_LOOKUP_ELEM per entry.
+func (m *MapIterator) useLegacyMode() {
+	C.free(m.keys)
+	C.free(m.values)
+	C.free(m.batchIn)
+	C.free(m.batchOut)
+	m.batchIn = nil
+	m.batchOut = nil
+
+	m.batchMode = false
+	m.keyStride = align64(m.keySize)
+	m.valueStride = align64(m.valueSize)
+	m.allocBuffers(MapIteratorNumKeys)
+}
+
+// Batched returns true if the iterator is using BPF_MAP_LOOKUP_BATCH.  Only valid after the first call to Next().
+func (m *MapIterator) Batched() bool {
+	return m.batchMode
+}
+
+// loadBatch loads the next batch of KVs from the kernel using BPF_MAP_LOOKUP_BATCH.  Returns the number of entries
+// loaded.
+func (m *MapIterator) loadBatch() (int, error) {
+	if m.batchDone {
+		return 0, nil
+	}
+
+	var inBatch unsafe.Pointer
+	if m.batchStarted {
+		inBatch = m.batchIn
+	}
+	count := C.__u32(MapIteratorBatchNumKeys)
+	rc := C.bpf_map_batch_call(C.BPF_MAP_LOOKUP_BATCH, C.uint(m.mapFD), inBatch, m.batchOut, m.keys, m.values, &count, 0)
+	if rc == C.int(unix.ENOENT) {
+		// Reached the end of the map, but count may still be non-zero.
+		m.batchDone = true
+		rc = 0
+	}
+	if rc != 0 {
+		return 0, unix.Errno(rc)
+	}
+	atomic.CompareAndSwapInt32(&batchOpsState, batchOpsUnknown, batchOpsSupported)
+
+	m.batchStarted = true
+	m.batchIn, m.batchOut = m.batchOut, m.batchIn
+
+	return int(count), nil
+}
+
+// loadMulti loads the next batch of KVs from the kernel using bpf_map_load_multi.  Returns the number of entries
+// loaded.
+func (m *MapIterator) loadMulti() (int, error) {
+	rc := C.bpf_map_load_multi(C.uint(m.mapFD), m.keyBeforeNextBatch, MapIteratorNumKeys, C.int(m.keyStride), m.keys, C.int(m.valueStride), m.values)
+	if rc < 0 {
+		return 0, unix.Errno(-rc)
+	}
+	count := int(rc)
+	if count > 0 {
+		if m.keyBeforeNextBatch == nil {
+			m.keyBeforeNextBatch = C.malloc((C.size_t)(m.keySize))
+		}
+		C.memcpy(m.keyBeforeNextBatch, unsafe.Pointer(uintptr(m.keys)+uintptr(m.keyStride*(count-1))), (C.size_t)(m.keySize))
+	}
+	return count, nil
+}
+
 // Next gets the next key/value pair from the iteration.  The key and value []byte slices returned point to the
 // MapIterator's internal buffers (which are allocated on the C heap); they should not be retained or modified.
 // Returns ErrIterationFinished at the end of the iteration or ErrVisitedTooManyKeys if it visits considerably more
@@ -413,25 +811,10 @@ func NewMapIterator(mapFD MapFD, keySize, valueSize, maxEntries int) (*MapIterat
 func (m *MapIterator) Next() (k, v []byte, err error) {
 	if m.numEntriesLoaded == m.entryIdx {
 		// Need to load a new batch of KVs from the kernel.
-		var count C.int
-		rc := C.bpf_map_load_multi(C.uint(m.mapFD), m.keyBeforeNextBatch, MapIteratorNumKeys, C.int(m.keyStride), m.keys, C.int(m.valueStride), m.values)
-		if rc < 0 {
-			err = unix.Errno(-rc)
-			return
-		}
-		count = rc
-		if count == 0 {
-			// No error but no keys either.  We're done.
-			err = ErrIterationFinished
+		err = m.load()
+		if err != nil {
 			return
 		}
-
-		m.numEntriesLoaded = int(count)
-		m.entryIdx = 0
-		if m.keyBeforeNextBatch == nil {
-			m.keyBeforeNextBatch = C.malloc((C.size_t)(m.keySize))
-		}
-		C.memcpy(m.keyBeforeNextBatch, unsafe.Pointer(uintptr(m.keys)+uintptr(m.keyStride*(m.numEntriesLoaded-1))), (C.size_t)(m.keySize))
 	}
 
 	currentKeyPtr := unsafe.Pointer(uintptr(m.keys) + uintptr(m.keyStride*(m.entryIdx)))
@@ -452,6 +835,67 @@ func (m *MapIterator) Next() (k, v []byte, err error) {
 	return
 }
 
+// load loads the next batch of KVs from the kernel into the iterator's buffers.  Returns ErrIterationFinished if
+// there are no more.
+func (m *MapIterator) load() (err error) {
+	var count int
+	if m.batchMode {
+		count, err = m.loadBatch()
+		if errno, ok := err.(unix.Errno); ok && !m.batchStarted && isBatchUnsupportedErr(errno) {
+			log.WithError(err).Debug("Batch map lookup not supported, falling back to per-entry iteration.")
+			m.useLegacyMode()
+			count, err = m.loadMulti()
+		}
+	} else {
+		count, err = m.loadMulti()
+	}
+	if err != nil {
+		return
+	}
+	if count == 0 {
+		// No error but no keys either.  We're done.
+		return ErrIterationFinished
+	}
+
+	m.numEntriesLoaded = count
+	m.entryIdx = 0
+	return nil
+}
+
+// NextBatch gets the next batch of key/value pairs from the iteration, with the keys and the values packed
+// back-to-back at the key and value sizes, and the number of pairs.  It saves a call per entry when loading a
+// whole map.  The slices point to the MapIterator's internal buffers, or to a buffer that it reuses, and are only
+// valid until the next call; they should not be retained or modified.  It must not be mixed with Next.  Returns
+// ErrIterationFinished at the end of the iteration or ErrVisitedTooManyKeys, like Next.
+func (m *MapIterator) NextBatch() (keys, values []byte, n int, err error) {
+	err = m.load()
+	if err != nil {
+		return
+	}
+	n = m.numEntriesLoaded
+	m.entryIdx = n
+	m.numEntriesVisited += n
+	if m.numEntriesVisited > m.maxEntries*10 {
+		err = ErrVisitedTooManyKeys
+		return
+	}
+
+	keys = ptrToSlice(m.keys, m.keyStride*n)
+	values = ptrToSlice(m.values, m.valueStride*n)
+	if m.keyStride != m.keySize || m.valueStride != m.valueSize {
+		// bpf_map_load_multi aligns the entries, pack them.
+		m.packed = m.packed[:0]
+		for i := 0; i < n; i++ {
+			m.packed = append(m.packed, keys[i*m.keyStride:i*m.keyStride+m.keySize]...)
+		}
+		for i := 0; i < n; i++ {
+			m.packed = append(m.packed, values[i*m.valueStride:i*m.valueStride+m.valueSize]...)
+		}
+		keys, values = m.packed[:n*m.keySize], m.packed[n*m.keySize:]
+	}
+	return
+}
+
 func ptrToSlice(ptr unsafe.Pointer, size int) (b []byte) {
 	keySliceHdr := (*reflect.SliceHeader)(unsafe.Pointer(&b))
 	keySliceHdr.Data = uintptr(ptr)
@@ -467,9 +911,160 @@ func (m *MapIterator) Close() error {
 	m.keys = nil
 	C.free(m.values)
 	m.values = nil
+	C.free(m.batchIn)
+	m.batchIn = nil
+	C.free(m.batchOut)
+	m.batchOut = nil
 
 	// Don't need the finalizer any more.
 	runtime.SetFinalizer(m, nil)
 
 	return nil
 }
+
+// DeleteMapEntriesBatch deletes the given keys, which must be packed back-to-back at keySize, using
+// BPF_MAP_DELETE_BATCH.  Keys that no longer exist are skipped.  Falls back to one BPF_MAP_DELETE_ELEM per key if
+// the kernel or map type doesn't support batch operations.
+func DeleteMapEntriesBatch(mapFD MapFD, keys []byte, keySize int) error {
+	if len(keys) == 0 {
+		return nil
+	}
+	if len(keys)%keySize != 0 {
+		log.WithFields(log.Fields{"len": len(keys), "keySize": keySize}).Panic("Bug: keys buffer not a multiple of key size")
+	}
+
+	if MapBatchOpsSupported() {
+		cKeys := C.CBytes(keys)
+		defer C.free(cKeys)
+
+		remaining := len(keys) / keySize
+		offset := 0
+		for remaining > 0 {
+			count := C.__u32(remaining)
+			rc := C.bpf_map_batch_call(C.BPF_MAP_DELETE_BATCH, C.uint(mapFD), nil, nil,
+				unsafe.Pointer(uintptr(cKeys)+uintptr(offset*keySize)), nil, &count, 0)
+			offset += int(count)
+			remaining -= int(count)
+			if rc == 0 {
+				atomic.CompareAndSwapInt32(&batchOpsState, batchOpsUnknown, batchOpsSupported)
+				break
+			}
+			errno := unix.Errno(rc)
+			if errno == unix.ENOENT {
+				// The kernel stops at the first key that doesn't exist; skip it and carry on.
+				offset++
+				remaining--
+				continue
+			}
+			if offset == 0 && isBatchUnsupportedErr(errno) {
+				break
+			}
+			return errno
+		}
+		if remaining == 0 {
+			return nil
+		}
+		keys = keys[offset*keySize:]
+	}
+
+	var errno C.int
+	C.bpf_map_delete_multi(C.uint(mapFD), C.int(len(keys)/keySize), C.int(keySize), unsafe.Pointer(&keys[0]), &errno)
+	if errno != 0 {
+		return unix.Errno(errno)
+	}
+	return nil
+}
+
+// UpdateMapEntriesBatch sets the values of the given keys, which must be packed back-to-back at keySize and
+// valueSize, using BPF_MAP_UPDATE_BATCH.  Returns ErrBatchNotSupported, having updated nothing, if the kernel or
+// map type doesn't support batch operations; the caller should fall back to BPF_MAP_UPDATE_ELEM.
+func UpdateMapEntriesBatch(mapFD MapFD, keys, values []byte, keySize, valueSize int) error {
+	if len(keys) == 0 {
+		return nil
+	}
+	if len(keys)%keySize != 0 || len(values) != len(keys)/keySize*valueSize {
+		log.WithFields(log.Fields{
+			"keysLen":   len(keys),
+			"valuesLen": len(values),
+			"keySize":   keySize,
+			"valueSize": valueSize,
+		}).Panic("Bug: keys or values buffer doesn't match the key and value sizes")
+	}
+	if !MapBatchOpsSupported() {
+		return ErrBatchNotSupported
+	}
+
+	cKeys := C.CBytes(keys)
+	defer C.free(cKeys)
+	cValues := C.CBytes(values)
+	defer C.free(cValues)
+
+	count := C.__u32(len(keys) / keySize)
+	rc := C.bpf_map_batch_call(C.BPF_MAP_UPDATE_BATCH, C.uint(mapFD), nil, nil, cKeys, cValues, &count, 0)
+	if rc != 0 {
+		errno := unix.Errno(rc)
+		if count == 0 && isBatchUnsupportedErr(errno) {
+			return ErrBatchNotSupported
+		}
+		return errno
+	}
+	atomic.CompareAndSwapInt32(&batchOpsState, batchOpsUnknown, batchOpsSupported)
+	return nil
+}
+
+// UpdateMapEntries sets the values of the given keys, which must be packed back-to-back at keySize and valueSize.
+// It uses BPF_MAP_UPDATE_BATCH if possible and falls back to one BPF_MAP_UPDATE_ELEM per entry otherwise.  If it
+// fails, some of the entries may have been updated.
+func UpdateMapEntries(mapFD MapFD, keys, values []byte, keySize, valueSize int) error {
+	err := UpdateMapEntriesBatch(mapFD, keys, values, keySize, valueSize)
+	if err != ErrBatchNotSupported {
+		return err
+	}
+
+	var errno C.int
+	C.bpf_map_update_multi(C.uint(mapFD), C.int(len(keys)/keySize),
+		C.int(keySize), unsafe.Pointer(&keys[0]), C.int(valueSize), unsafe.Pointer(&values[0]), unix.BPF_ANY, &errno)
+	if errno != 0 {
+		return unix.Errno(errno)
+	}
+	return nil
+}
+
+// DrainMap deletes every entry from the map using BPF_MAP_LOOKUP_AND_DELETE_BATCH.  Returns the number of entries
+// deleted.  Returns ErrBatchNotSupported if the kernel or map type doesn't support the batch operation; the
+// caller should fall back to iterating the map.
+func DrainMap(mapFD MapFD, keySize, valueSize int) (int, error) {
+	keysBufSize := (C.size_t)(keySize * MapIteratorBatchNumKeys)
+	valueBufSize := (C.size_t)(valueSize * MapIteratorBatchNumKeys)
+	tokenSize := (C.size_t)(align64(keySize))
+
+	keys := C.malloc(keysBufSize)
+	defer C.free(keys)
+	values := C.malloc(valueBufSize)
+	defer C.free(values)
+	batchIn := C.malloc(tokenSize)
+	defer C.free(batchIn)
+	batchOut := C.malloc(tokenSize)
+	defer C.free(batchOut)
+
+	total := 0
+	var inBatch unsafe.Pointer
+	for {
+		count := C.__u32(MapIteratorBatchNumKeys)
+		rc := C.bpf_map_batch_call(C.BPF_MAP_LOOKUP_AND_DELETE_BATCH, C.uint(mapFD), inBatch, batchOut, keys, values, &count, 0)
+		total += int(count)
+		if rc == C.int(unix.ENOENT) {
+			return total, nil
+		}
+		if rc != 0 {
+			errno := unix.Errno(rc)
+			if total == 0 && isBatchUnsupportedErr(errno) {
+				return 0, ErrBatchNotSupported
+			}
+			return total, errno
+		}
+		atomic.CompareAndSwapInt32(&batchOpsState, batchOpsUnknown, batchOpsSupported)
+		batchIn, batchOut = batchOut, batchIn
+		inBatch = batchIn
+	}
+}
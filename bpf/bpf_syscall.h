@@ -109,6 +109,68 @@ void bpf_attr_setup_get_info(union bpf_attr *attr, __u32 map_fd,
    attr->info.info = (__u64)(unsigned long)info;
 }
 
+// bpf_attr_setup_map_create sets up the bpf_attr union for use with BPF_MAP_CREATE.  The kernel only
+// looks at numa_node if flags has BPF_F_NUMA_NODE.
+// A C function makes this easier because unions aren't easy to access from Go.
+void bpf_attr_setup_map_create(union bpf_attr *attr, __u32 map_type, __u32 key_size, __u32 value_size,
+                               __u32 max_entries, __u32 flags, __u32 numa_node, char *name) {
+   attr->map_type = map_type;
+   attr->key_size = key_size;
+   attr->value_size = value_size;
+   attr->max_entries = max_entries;
+   attr->map_flags = flags;
+   attr->numa_node = numa_node;
+   strncpy(attr->map_name, name, BPF_OBJ_NAME_LEN - 1);
+}
+
+// bpf_probe_map_create creates and closes a map with the given parameters, to find out whether the kernel
+// supports them.  Returns 0 or the errno.
+int bpf_probe_map_create(__u32 map_type, __u32 key_size, __u32 value_size, __u32 max_entries, __u32 flags) {
+   union bpf_attr attr = {};
+
+   attr.map_type = map_type;
+   attr.key_size = key_size;
+   attr.value_size = value_size;
+   attr.max_entries = max_entries;
+   attr.map_flags = flags;
+
+   int fd = syscall(SYS_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+   if (fd < 0) {
+     return errno;
+   }
+   close(fd);
+   return 0;
+}
+
+// bpf_probe_map_batch creates an empty hash map and looks up a batch in it, to find out whether the kernel
+// supports the BPF_MAP_*_BATCH commands.  Returns 0 or the errno; an empty map gives ENOENT if the commands
+// are supported.
+int bpf_probe_map_batch() {
+   union bpf_attr attr = {};
+   __u32 key, value, batch;
+   int rc;
+
+   attr.map_type = BPF_MAP_TYPE_HASH;
+   attr.key_size = sizeof(key);
+   attr.value_size = sizeof(value);
+   attr.max_entries = 1;
+
+   int fd = syscall(SYS_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+   if (fd < 0) {
+     return errno;
+   }
+
+   memset(&attr, 0, sizeof(attr));
+   attr.batch.map_fd = fd;
+   attr.batch.out_batch = (__u64)(unsigned long)&batch;
+   attr.batch.keys = (__u64)(unsigned long)&key;
+   attr.batch.values = (__u64)(unsigned long)&value;
+   attr.batch.count = 1;
+   rc = syscall(SYS_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr)) == 0 ? 0 : errno;
+   close(fd);
+   return rc;
+}
+
 __u32 bpf_attr_prog_run_retval(union bpf_attr *attr) {
    return attr->test.retval;
 }
@@ -177,3 +239,170 @@ int bpf_map_load_multi(__u32 map_fd,
    }
    return count;
 }
+
+// bpf_map_batch_call issues one of the BPF_MAP_*_BATCH commands.  On entry, *count is the number of
+// slots in the keys/values buffers; on return it is the number of entries that the kernel processed,
+// which may be non-zero even if an error (typically ENOENT at the end of the map) is returned.  Keys
+// and values are packed back-to-back at key_size/value_size as required by the kernel.
+int bpf_map_batch_call(int cmd, __u32 map_fd,
+                       void *in_batch, void *out_batch,
+                       void *keys, void *values,
+                       __u32 *count, __u64 flags) {
+   union bpf_attr attr = {};
+
+   attr.batch.map_fd = map_fd;
+   attr.batch.in_batch = (__u64)(unsigned long)in_batch;
+   attr.batch.out_batch = (__u64)(unsigned long)out_batch;
+   attr.batch.keys = (__u64)(unsigned long)keys;
+   attr.batch.values = (__u64)(unsigned long)values;
+   attr.batch.count = *count;
+   attr.batch.elem_flags = flags;
+
+   int rc = syscall(SYS_bpf, cmd, &attr, sizeof(attr));
+   *count = attr.batch.count;
+   return rc == 0 ? 0 : errno;
+}
+
+// bpf_map_update_multi sets count entries of the map, reading the keys and values at key_stride and
+// value_stride, with one BPF_MAP_UPDATE_ELEM each.  It is the fallback for BPF_MAP_UPDATE_BATCH, doing
+// the loop in C saves a cgo call and a copy of the key and value per entry.  Returns the number of
+// entries that it updated before the first failure and sets *err to its errno, or to 0 on success.
+int bpf_map_update_multi(__u32 map_fd,
+                         int count,
+                         int key_stride,
+                         void *keys,
+                         int value_stride,
+                         void *values,
+                         __u64 flags,
+                         int *err) {
+   union bpf_attr attr = {};
+   attr.map_fd = map_fd;
+   attr.flags = flags;
+   *err = 0;
+   for (int i = 0; i < count; i++) {
+     attr.key = (__u64)(unsigned long)keys;
+     attr.value = (__u64)(unsigned long)values;
+     if (syscall(SYS_bpf, BPF_MAP_UPDATE_ELEM, &attr, sizeof(attr)) != 0) {
+       *err = errno;
+       return i;
+     }
+     keys += key_stride;
+     values += value_stride;
+   }
+   return count;
+}
+
+// bpf_map_delete_multi is the equivalent of bpf_map_update_multi for BPF_MAP_DELETE_ELEM.  Keys
+// that don't exist are skipped.
+int bpf_map_delete_multi(__u32 map_fd,
+                         int count,
+                         int key_stride,
+                         void *keys,
+                         int *err) {
+   union bpf_attr attr = {};
+   attr.map_fd = map_fd;
+   *err = 0;
+   for (int i = 0; i < count; i++) {
+     attr.key = (__u64)(unsigned long)keys;
+     if (syscall(SYS_bpf, BPF_MAP_DELETE_ELEM, &attr, sizeof(attr)) != 0 && errno != ENOENT) {
+       *err = errno;
+       return i;
+     }
+     keys += key_stride;
+   }
+   return count;
+}
+
+// Commands and attach type of the BPF iterators (kernel 5.9+), spelled out because the build's
+// linux/bpf.h may predate them.
+#define CALI_BPF_LINK_CREATE  28
+#define CALI_BPF_ITER_CREATE  33
+#define CALI_BPF_TRACE_ITER   28
+
+// bpf_map_iter_create attaches the BPF_TRACE_ITER program prog_fd to the map map_fd and returns an
+// iterator fd; each read() of the fd runs the program over the map's elements.  It returns -errno on
+// failure.  The link_create attributes are laid out by hand for the same reason as above.
+int bpf_map_iter_create(__u32 prog_fd, __u32 map_fd) {
+   union bpf_attr attr = {};
+   __u32 iter_info[1] = { map_fd }; // union bpf_iter_link_info { struct { __u32 map_fd; } map; }
+   struct {
+      __u32 prog_fd;
+      __u32 target_fd;
+      __u32 attach_type;
+      __u32 flags;
+      __u64 iter_info;
+      __u32 iter_info_len;
+   } link_create = {
+      .prog_fd = prog_fd,
+      .attach_type = CALI_BPF_TRACE_ITER,
+      .iter_info = (__u64)(unsigned long)iter_info,
+      .iter_info_len = sizeof(iter_info),
+   };
+   memcpy(&attr, &link_create, sizeof(link_create));
+
+   int link_fd = syscall(SYS_bpf, CALI_BPF_LINK_CREATE, &attr, sizeof(attr));
+   if (link_fd < 0) {
+      return -errno;
+   }
+
+   memset(&attr, 0, sizeof(attr));
+   ((__u32 *)&attr)[0] = link_fd; // iter_create.link_fd
+   int iter_fd = syscall(SYS_bpf, CALI_BPF_ITER_CREATE, &attr, sizeof(attr));
+   int err = errno;
+   // The iterator holds its own reference to the link.
+   close(link_fd);
+   if (iter_fd < 0) {
+      return -err;
+   }
+   return iter_fd;
+}
+
+// Commands and attach types of the links that attach programs to interfaces, spelled out because
+// the build's linux/bpf.h may predate them.  tcx needs kernel 6.6+.
+#define CALI_BPF_LINK_UPDATE   29
+#define CALI_BPF_TCX_INGRESS   46
+#define CALI_BPF_TCX_EGRESS    47
+
+// bpf_link_create attaches the program prog_fd to the interface with the given ifindex and returns
+// a link fd.  It returns -errno on failure.
+int bpf_link_create(__u32 prog_fd, __u32 ifindex, __u32 attach_type) {
+   union bpf_attr attr = {};
+   struct {
+      __u32 prog_fd;
+      __u32 target_ifindex;
+      __u32 attach_type;
+      __u32 flags;
+   } link_create = {
+      .prog_fd = prog_fd,
+      .target_ifindex = ifindex,
+      .attach_type = attach_type,
+   };
+   memcpy(&attr, &link_create, sizeof(link_create));
+
+   int link_fd = syscall(SYS_bpf, CALI_BPF_LINK_CREATE, &attr, sizeof(attr));
+   if (link_fd < 0) {
+      return -errno;
+   }
+   return link_fd;
+}
+
+// bpf_link_update atomically replaces the program of the link link_fd with prog_fd.  It returns
+// -errno on failure.
+int bpf_link_update(__u32 link_fd, __u32 prog_fd) {
+   union bpf_attr attr = {};
+   struct {
+      __u32 link_fd;
+      __u32 new_prog_fd;
+      __u32 flags;
+      __u32 old_prog_fd;
+   } link_update = {
+      .link_fd = link_fd,
+      .new_prog_fd = prog_fd,
+   };
+   memcpy(&attr, &link_update, sizeof(link_update));
+
+   if (syscall(SYS_bpf, CALI_BPF_LINK_UPDATE, &attr, sizeof(attr)) < 0) {
+      return -errno;
+   }
+   return 0;
+}
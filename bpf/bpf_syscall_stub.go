@@ -21,6 +21,8 @@ import (
 )
 
 const MapIteratorNumKeys = 16
+const MapIteratorBatchNumKeys = 1024
+const MapDeleteBatchNumKeys = 1024
 
 func SyscallSupport() bool {
 	return false
@@ -34,10 +36,22 @@ func GetMapFDByID(mapID int) (MapFD, error) {
 	panic("BPF syscall stub")
 }
 
+func GetProgFDByID(progID int) (ProgFD, error) {
+	panic("BPF syscall stub")
+}
+
+func GetProgInfo(fd ProgFD) (*ProgInfo, error) {
+	panic("BPF syscall stub")
+}
+
 func LoadBPFProgramFromInsns(insns asm.Insns, license string) (ProgFD, error) {
 	panic("BPF syscall stub")
 }
 
+func LoadXDPProgramFromInsns(insns asm.Insns, license string) (ProgFD, error) {
+	panic("BPF syscall stub")
+}
+
 func RunBPFProgram(fd ProgFD, dataIn []byte, repeat int) (pr ProgResult, err error) {
 	panic("BPF syscall stub")
 }
@@ -46,6 +60,42 @@ func PinBPFProgram(fd ProgFD, filename string) error {
 	panic("BPF syscall stub")
 }
 
+func CreateMap(mapType, keySize, valueSize, maxEntries, flags, numaNode uint32, name string) (MapFD, error) {
+	panic("BPF syscall stub")
+}
+
+func PinMap(fd MapFD, filename string) error {
+	panic("BPF syscall stub")
+}
+
+func GetProgFDByPin(filename string) (ProgFD, error) {
+	panic("BPF syscall stub")
+}
+
+func RunMapIterator(progFD ProgFD, mapFD MapFD) error {
+	panic("BPF syscall stub")
+}
+
+func CreateLink(progFD ProgFD, ifIndex int, attachType LinkAttachType) (LinkFD, error) {
+	panic("BPF syscall stub")
+}
+
+func UpdateLink(linkFD LinkFD, progFD ProgFD) error {
+	panic("BPF syscall stub")
+}
+
+func PinLink(fd LinkFD, filename string) error {
+	panic("BPF syscall stub")
+}
+
+func GetLinkFDByPin(filename string) (LinkFD, error) {
+	panic("BPF syscall stub")
+}
+
+func GetLinkInfo(fd LinkFD) (*LinkInfo, error) {
+	panic("BPF syscall stub")
+}
+
 func UpdateMapEntry(mapFD MapFD, k, v []byte) error {
 	panic("BPF syscall stub")
 }
@@ -54,6 +104,10 @@ func GetMapEntry(mapFD MapFD, k []byte, valueSize int) ([]byte, error) {
 	panic("BPF syscall stub")
 }
 
+func GetMapEntryPerCPU(mapFD MapFD, k []byte, valueSize, numCPUs int) ([]byte, error) {
+	panic("BPF syscall stub")
+}
+
 func GetMapInfo(fd MapFD) (*MapInfo, error) {
 	panic("BPF syscall stub")
 }
@@ -66,6 +120,41 @@ func DeleteMapEntryIfExists(mapFD MapFD, k []byte, valueSize int) error {
 	panic("BPF syscall stub")
 }
 
+func ProbeProgram(insns asm.Insns) (string, error) {
+	panic("BPF syscall stub")
+}
+
+func ProbeMapType(mapType, keySize, valueSize, maxEntries, flags uint32) error {
+	panic("BPF syscall stub")
+}
+
+func ProbeMapBatchOps() error {
+	panic("BPF syscall stub")
+}
+
+func noteMapBatchOpsUnsupported() {
+}
+
+func MapBatchOpsSupported() bool {
+	return false
+}
+
+func DeleteMapEntriesBatch(mapFD MapFD, keys []byte, keySize int) error {
+	panic("BPF syscall stub")
+}
+
+func UpdateMapEntriesBatch(mapFD MapFD, keys, values []byte, keySize, valueSize int) error {
+	panic("BPF syscall stub")
+}
+
+func UpdateMapEntries(mapFD MapFD, keys, values []byte, keySize, valueSize int) error {
+	panic("BPF syscall stub")
+}
+
+func DrainMap(mapFD MapFD, keySize, valueSize int) (int, error) {
+	panic("BPF syscall stub")
+}
+
 func GetMapNextKey(mapFD MapFD, k []byte, keySize int) ([]byte, error) {
 	panic("BPF syscall stub")
 }
@@ -81,6 +170,14 @@ func (m *MapIterator) Next() (k, v []byte, err error) {
 	return
 }
 
+func (m *MapIterator) NextBatch() (keys, values []byte, n int, err error) {
+	return
+}
+
+func (m *MapIterator) Batched() bool {
+	return false
+}
+
 func (m *MapIterator) Close() error {
 	return nil
 }
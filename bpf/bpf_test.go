@@ -580,6 +580,40 @@ func TestCreateAndRemoveFailsafeMap(t *testing.T) {
 	}
 }
 
+func TestSockmapMsgConfigMap(t *testing.T) {
+	err := cleanup(bpfDP.GetBPFCalicoDir())
+	if err != nil {
+		t.Fatalf("cannot cleanup: %v", err)
+	}
+
+	t.Log("Creating, updating and removing the sk_msg config map should succeed")
+	_, err = bpfDP.NewSockmapMsgConfigMap()
+	if err != nil {
+		t.Fatalf("cannot create sk_msg config map: %v", err)
+	}
+	err = bpfDP.UpdateSockmapMsgConfig(65536, 4096)
+	if err != nil {
+		t.Fatalf("cannot update sk_msg config map: %v", err)
+	}
+	err = bpfDP.RemoveSockmapMsgConfigMap()
+	if err != nil {
+		t.Fatalf("cannot delete map: %v", err)
+	}
+	t.Log("Removing an already removed sk_msg config map should fail")
+	err = bpfDP.RemoveSockmapMsgConfigMap()
+	if err == nil {
+		t.Fatalf("map deletion should have failed: %v", err)
+	}
+}
+
+func TestSockmapMsgConfigValueToHex(t *testing.T) {
+	RegisterTestingT(t)
+
+	// Sockmap acceleration is only supported on little endian architectures.
+	Expect(sockmapMsgConfigValueToHex(0x10000, 0x1000)).To(Equal(
+		[]string{"00", "00", "01", "00", "00", "10", "00", "00"}))
+}
+
 func TestFailsafeMapContent(t *testing.T) {
 	_, err := bpfDP.NewFailsafeMap()
 	if err != nil {
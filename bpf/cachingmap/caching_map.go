@@ -31,6 +31,10 @@ import (
 // CachingMap will load a cache of the dataplane state on the first call to ApplyXXX, or the cache can be loaded
 // explicitly by calling LoadCacheFromDataplane().  This allows for client code to inspect the dataplane cache
 // with IterDataplaneCache and GetDataplaneCache.
+//
+// Both copies of the map are SlabMaps, which hold the entries in a few large pointer-free slices.  Rather
+// than queueing up the operations, the CachingMap records the keys that it may need to update or delete;
+// the Apply methods only look at those.
 type CachingMap struct {
 	// dataplaneMap is the backing map in the dataplane
 	dataplaneMap bpf.Map
@@ -39,34 +43,28 @@ type CachingMap struct {
 	// desiredStateOfDataplane stores the complete set of key/value pairs that we _want_ to
 	// be in the dataplane.  Calling ApplyAllChanges attempts to bring the dataplane into
 	// sync.
-	//
-	// For occupancy's sake we may want to drop this copy and instead maintain the invariant:
-	// desiredStateOfDataplane = cacheOfDataplane - pendingDeletions + pendingUpdates.
-	desiredStateOfDataplane *ByteArrayToByteArrayMap
-
-	cacheOfDataplane *ByteArrayToByteArrayMap
-	pendingUpdates   *ByteArrayToByteArrayMap
-	pendingDeletions *ByteArrayToByteArrayMap
+	desiredStateOfDataplane *SlabMap
+
+	cacheOfDataplane *SlabMap
+	// dirtyKeys holds the keys whose desired state may differ from the cache of the dataplane.
+	dirtyKeys *SlabMap
 }
 
 func New(mapParams bpf.MapParameters, dataplaneMap bpf.Map) *CachingMap {
 	cm := &CachingMap{
 		params:                  mapParams,
 		dataplaneMap:            dataplaneMap,
-		desiredStateOfDataplane: NewByteArrayToByteArrayMap(mapParams.KeySize, mapParams.ValueSize),
+		desiredStateOfDataplane: NewSlabMap(mapParams.KeySize, mapParams.ValueSize),
 	}
 	return cm
 }
 
 // LoadCacheFromDataplane loads the contents of the BPF map into the dataplane cache, allowing it to be queried with
-// GetDataplaneCache and IterDataplaneCache.
+// GetDataplaneCache and IterDataplaneCache.  It reads the map a batch at a time, see bpf.LoadBatches.
 func (c *CachingMap) LoadCacheFromDataplane() error {
 	logrus.WithField("name", c.params.Name).Debug("Loading cache of dataplane state.")
 	c.initCache()
-	err := c.dataplaneMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		c.cacheOfDataplane.Set(k, v)
-		return bpf.IterNone
-	})
+	err := bpf.LoadBatches(c.dataplaneMap, c.cacheOfDataplane.SetBatch)
 	if err != nil {
 		logrus.WithError(err).WithField("name", c.params.Name).Warn("Failed to load cache of BPF map")
 		c.clearCache()
@@ -79,54 +77,48 @@ func (c *CachingMap) LoadCacheFromDataplane() error {
 }
 
 func (c *CachingMap) initCache() {
-	c.cacheOfDataplane = NewByteArrayToByteArrayMap(c.params.KeySize, c.params.ValueSize)
-	c.pendingUpdates = NewByteArrayToByteArrayMap(c.params.KeySize, c.params.ValueSize)
-	c.pendingDeletions = NewByteArrayToByteArrayMap(c.params.KeySize, c.params.ValueSize)
+	c.cacheOfDataplane = NewSlabMap(c.params.KeySize, c.params.ValueSize)
+	c.dirtyKeys = NewSlabMap(c.params.KeySize, 0)
 }
 
 func (c *CachingMap) clearCache() {
 	logrus.WithField("name", c.params.Name).Debug("Clearing cache of BPF map")
 	c.cacheOfDataplane = nil
-	c.pendingDeletions = nil
-	c.pendingUpdates = nil
+	c.dirtyKeys = nil
 }
 
-// recalculatePendingOperations compares the dataplane cache against he desired state and adds entries to
-// pendingUpdates/pendingDeletions that would bring the dataplane into sync with the desired state.
+// recalculatePendingOperations compares the dataplane cache against he desired state and marks the keys that
+// differ as dirty.
 func (c *CachingMap) recalculatePendingOperations() {
 	debug := logrus.GetLevel() >= logrus.DebugLevel
 
-	// Look for any discrepancies and queue up updates.
+	// Look for any discrepancies.
 	c.desiredStateOfDataplane.Iter(func(k, desiredVal []byte) {
-		actualVal := c.cacheOfDataplane.Get(k)
+		actualVal := c.cacheOfDataplane.get(k)
 		if slicesEqual(actualVal, desiredVal) {
 			return
 		}
-		c.pendingUpdates.Set(k, desiredVal)
+		c.dirtyKeys.Set(k, nil)
 	})
 
-	// Scan for any dataplane keys that are not in the desired map at all and
-	// queue up deletions.
+	// Scan for any dataplane keys that are not in the desired map at all.
 	c.cacheOfDataplane.Iter(func(k, actualVal []byte) {
-		desiredVal := c.desiredStateOfDataplane.Get(k)
 		if debug {
 			logrus.WithFields(logrus.Fields{
 				"k":        k,
 				"v":        actualVal,
-				"expected": desiredVal,
+				"expected": c.desiredStateOfDataplane.get(k),
 			}).Debug("Checking cache against desired")
 		}
-		if desiredVal == nil {
-			c.pendingDeletions.Set(k, actualVal)
-			return
+		if !c.desiredStateOfDataplane.Contains(k) {
+			c.dirtyKeys.Set(k, nil)
 		}
 	})
 
 	logrus.WithFields(logrus.Fields{
-		"cached":         c.cacheOfDataplane.Len(),
-		"pendingDels":    c.pendingDeletions.Len(),
-		"pendingUpdates": c.pendingUpdates.Len(),
-		"name":           c.params.Name,
+		"cached": c.cacheOfDataplane.Len(),
+		"dirty":  c.dirtyKeys.Len(),
+		"name":   c.params.Name,
 	}).Info("Recalculated pending operations")
 }
 
@@ -141,17 +133,7 @@ func (c *CachingMap) SetDesired(k, v []byte) {
 		logrus.Debug("SetDesired: initial sync pending.")
 		return // Initial sync is pending, we're not tracking deltas yet.
 	}
-	c.pendingDeletions.Delete(k)
-
-	// Check if we think we need to update the dataplane as a result.
-	currentVal := c.cacheOfDataplane.Get(k)
-	if slicesEqual(currentVal, v) {
-		// Dataplane already agrees with the new value so clear any pending update.
-		logrus.Debug("SetDesired: Key in dataplane already, ignoring.")
-		c.pendingUpdates.Delete(k)
-		return
-	}
-	c.pendingUpdates.Set(k, v)
+	c.markDirty(k)
 }
 
 func slicesEqual(a, b []byte) bool {
@@ -177,17 +159,20 @@ func (c *CachingMap) DeleteDesired(k []byte) {
 		logrus.Debug("DeleteDesired: initial sync pending.")
 		return // Initial sync is pending, we're not tracking deltas yet.
 	}
-	c.pendingUpdates.Delete(k)
+	c.markDirty(k)
+}
 
-	// Check if we need to update the dataplane.
-	currentVal := c.cacheOfDataplane.Get(k)
-	if currentVal == nil {
-		// We don't think this value is in the dataplane so clear any pending delete.
-		logrus.Debug("DeleteDesired: Key not in dataplane, ignoring.")
-		c.pendingDeletions.Delete(k)
+// markDirty records that the key needs an update or a deletion, unless the dataplane already agrees with
+// the desired state.
+func (c *CachingMap) markDirty(k []byte) {
+	desiredVal := c.desiredStateOfDataplane.get(k)
+	currentVal := c.cacheOfDataplane.get(k)
+	if (desiredVal == nil) == (currentVal == nil) && slicesEqual(desiredVal, currentVal) {
+		logrus.Debug("Key in sync with dataplane already, ignoring.")
+		c.dirtyKeys.Delete(k)
 		return
 	}
-	c.pendingDeletions.Set(k, currentVal)
+	c.dirtyKeys.Set(k, nil)
 }
 
 // DeleteAllDesired deletes all entries from the in-memory desired state of the map.  It doesn't actually touch
@@ -211,6 +196,12 @@ func (c *CachingMap) GetDataplaneCache(k []byte) []byte {
 	return c.cacheOfDataplane.Get(k)
 }
 
+// PeekDataplaneCache is GetDataplaneCache without the copy: the value is only valid until the cache changes and it
+// must not be modified.
+func (c *CachingMap) PeekDataplaneCache(k []byte) []byte {
+	return c.cacheOfDataplane.get(k)
+}
+
 // ApplyAllChanges attempts to bring the dataplane map into sync with the desired state.
 func (c *CachingMap) ApplyAllChanges() error {
 	var errs ErrSlice
@@ -238,6 +229,31 @@ func (c *CachingMap) maybeLoadCache() error {
 	return nil
 }
 
+// pendingOperations returns the dirty keys that need an update, with their desired values, or, if deletions is
+// set, the dirty keys that need deleting.  It cleans up the dirty keys that are in sync after all.
+func (c *CachingMap) pendingOperations(deletions bool) (keys, values []byte) {
+	c.dirtyKeys.Iter(func(k, _ []byte) {
+		desiredVal := c.desiredStateOfDataplane.get(k)
+		currentVal := c.cacheOfDataplane.get(k)
+		switch {
+		case desiredVal == nil && currentVal == nil:
+			c.dirtyKeys.Delete(k)
+		case desiredVal == nil:
+			if deletions {
+				keys = append(keys, k...)
+			}
+		case currentVal != nil && slicesEqual(desiredVal, currentVal):
+			c.dirtyKeys.Delete(k)
+		default:
+			if !deletions {
+				keys = append(keys, k...)
+				values = append(values, desiredVal...)
+			}
+		}
+	})
+	return
+}
+
 // ApplyUpdatesOnly applies any pending adds/updates to the dataplane map.  It doesn't delete any keys that are no
 // longer wanted.
 func (c *CachingMap) ApplyUpdatesOnly() error {
@@ -246,17 +262,22 @@ func (c *CachingMap) ApplyUpdatesOnly() error {
 	if err != nil {
 		return err
 	}
+	keys, values := c.pendingOperations(false)
+	if len(keys) > c.params.KeySize && c.applyUpdatesBatch(keys, values) {
+		return nil
+	}
 	var errs ErrSlice
-	c.pendingUpdates.Iter(func(k, v []byte) {
+	for i, j := 0, 0; i < len(keys); i, j = i+c.params.KeySize, j+c.params.ValueSize {
+		k, v := keys[i:i+c.params.KeySize], values[j:j+c.params.ValueSize]
 		err := c.dataplaneMap.Update(k, v)
 		if err != nil {
 			logrus.WithError(err).Warn("Error while updating BPF map")
 			errs = append(errs, err)
 		} else {
-			c.pendingUpdates.Delete(k)
+			c.dirtyKeys.Delete(k)
 			c.cacheOfDataplane.Set(k, v)
 		}
-	})
+	}
 	if len(errs) > 0 {
 		return errs
 	}
@@ -271,23 +292,60 @@ func (c *CachingMap) ApplyDeletionsOnly() error {
 	if err != nil {
 		return err
 	}
+	keys, _ := c.pendingOperations(true)
+	if len(keys) > c.params.KeySize && c.applyDeletionsBatch(keys) {
+		return nil
+	}
 	var errs ErrSlice
-	c.pendingDeletions.Iter(func(k, v []byte) {
+	for i := 0; i < len(keys); i += c.params.KeySize {
+		k := keys[i : i+c.params.KeySize]
 		err := c.dataplaneMap.Delete(k)
 		if err != nil && !bpf.IsNotExists(err) {
 			logrus.WithError(err).Warn("Error while deleting from BPF map")
 			errs = append(errs, err)
 		} else {
-			c.pendingDeletions.Delete(k)
+			c.dirtyKeys.Delete(k)
 			c.cacheOfDataplane.Delete(k)
 		}
-	})
+	}
 	if len(errs) > 0 {
 		return errs
 	}
 	return nil
 }
 
+// applyUpdatesBatch tries to apply all the pending updates with a single batch operation, which saves a syscall
+// per entry when a large service changes.  It returns false, leaving the keys dirty, if the batch failed; the
+// caller then retries entry by entry to find out which ones failed.
+func (c *CachingMap) applyUpdatesBatch(keys, values []byte) bool {
+	err := bpf.UpdateBatch(c.dataplaneMap, keys, values, c.params.KeySize, c.params.ValueSize)
+	if err != nil {
+		logrus.WithError(err).WithField("name", c.params.Name).Debug(
+			"Batch update of BPF map failed, falling back to updating each entry.")
+		return false
+	}
+	for i, j := 0, 0; i < len(keys); i, j = i+c.params.KeySize, j+c.params.ValueSize {
+		c.dirtyKeys.Delete(keys[i : i+c.params.KeySize])
+		c.cacheOfDataplane.Set(keys[i:i+c.params.KeySize], values[j:j+c.params.ValueSize])
+	}
+	return true
+}
+
+// applyDeletionsBatch is the equivalent of applyUpdatesBatch for the pending deletions.
+func (c *CachingMap) applyDeletionsBatch(keys []byte) bool {
+	err := bpf.DeleteBatch(c.dataplaneMap, keys, c.params.KeySize)
+	if err != nil {
+		logrus.WithError(err).WithField("name", c.params.Name).Debug(
+			"Batch deletion from BPF map failed, falling back to deleting each entry.")
+		return false
+	}
+	for i := 0; i < len(keys); i += c.params.KeySize {
+		c.dirtyKeys.Delete(keys[i : i+c.params.KeySize])
+		c.cacheOfDataplane.Delete(keys[i : i+c.params.KeySize])
+	}
+	return true
+}
+
 type ErrSlice []error
 
 func (e ErrSlice) Error() string {
@@ -0,0 +1,260 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cachingmap
+
+import (
+	"log"
+)
+
+const (
+	// slabRows is the number of entries in each slab.  Growing by whole slabs, rather than by
+	// re-allocating one big slice, avoids copying the entries and needing twice the memory while
+	// we do.
+	slabRows = 4096
+
+	slotEmpty     = 0
+	slotTombstone = -1
+)
+
+// SlabMap is a compact map from fixed-size keys to fixed-size values, with the same API as
+// ByteArrayToByteArrayMap.  The entries are packed, key then value, into slabs of slabRows
+// entries and found through an open-addressing index of 32-bit row numbers.  None of them contain
+// pointers so the garbage collector doesn't have to scan them, and an entry costs its key and value
+// plus, at most, a couple of index slots.
+//
+// All operations panic if passed a slice of incorrect size.
+type SlabMap struct {
+	keySize   int
+	valueSize int
+	stride    int
+
+	slabs [][]byte
+	// used has a bit per row that is set if the row holds an entry.
+	used []uint64
+	// free holds the rows that were deleted, for reuse.
+	free []int32
+	rows int
+
+	// index holds, per slot, slotEmpty, slotTombstone or the row number plus one.  Its size is
+	// a power of two.
+	index      []int32
+	len        int
+	tombstones int
+}
+
+func NewSlabMap(keySize, valueSize int) *SlabMap {
+	return &SlabMap{
+		keySize:   keySize,
+		valueSize: valueSize,
+		stride:    keySize + valueSize,
+		index:     make([]int32, 16),
+	}
+}
+
+func (m *SlabMap) row(r int32) []byte {
+	off := int(r%slabRows) * m.stride
+	return m.slabs[r/slabRows][off : off+m.stride]
+}
+
+func hashKey(k []byte) uint64 {
+	// FNV-1a, followed by a final mix so that the low bits, which pick the slot, depend on all
+	// of the key.
+	h := uint64(14695981039346656037)
+	for _, b := range k {
+		h ^= uint64(b)
+		h *= 1099511628211
+	}
+	h ^= h >> 33
+	h *= 0xff51afd7ed558ccd
+	h ^= h >> 33
+	return h
+}
+
+// find returns the slot of the given key, or -1 if it is not in the map along with the slot
+// where it should be inserted.
+func (m *SlabMap) find(k []byte) (slot int, insertAt int) {
+	mask := len(m.index) - 1
+	insertAt = -1
+	for i := int(hashKey(k)) & mask; ; i = (i + 1) & mask {
+		switch s := m.index[i]; s {
+		case slotEmpty:
+			if insertAt < 0 {
+				insertAt = i
+			}
+			return -1, insertAt
+		case slotTombstone:
+			if insertAt < 0 {
+				insertAt = i
+			}
+		default:
+			if slicesEqual(m.row(s - 1)[:m.keySize], k) {
+				return i, i
+			}
+		}
+	}
+}
+
+// grow resizes the index, if needed, so that at most 3/4 of it is in use, dropping the tombstones.
+func (m *SlabMap) grow() {
+	m.growFor(1)
+}
+
+// growFor is grow for n more entries; growing once for a batch avoids rehashing the index
+// several times over while it fills up.
+func (m *SlabMap) growFor(n int) {
+	if (m.len+m.tombstones+n)*4 < len(m.index)*3 {
+		return
+	}
+	size := len(m.index)
+	for (m.len+n)*2 > size {
+		size *= 2
+	}
+	old := m.index
+	m.index = make([]int32, size)
+	m.tombstones = 0
+	mask := size - 1
+	for _, s := range old {
+		if s <= 0 {
+			continue
+		}
+		i := int(hashKey(m.row(s - 1)[:m.keySize])) & mask
+		for m.index[i] != slotEmpty {
+			i = (i + 1) & mask
+		}
+		m.index[i] = s
+	}
+}
+
+func (m *SlabMap) allocRow() int32 {
+	if n := len(m.free); n > 0 {
+		r := m.free[n-1]
+		m.free = m.free[:n-1]
+		return r
+	}
+	if m.rows%slabRows == 0 {
+		m.slabs = append(m.slabs, make([]byte, slabRows*m.stride))
+		m.used = append(m.used, make([]uint64, slabRows/64)...)
+	}
+	r := int32(m.rows)
+	m.rows++
+	return r
+}
+
+func (m *SlabMap) Set(k, v []byte) {
+	if len(k) != m.keySize {
+		log.Panic("SlabMap.Set() called with incorrect key length")
+	}
+	if len(v) != m.valueSize {
+		log.Panic("SlabMap.Set() called with incorrect value length")
+	}
+
+	if slot, _ := m.find(k); slot >= 0 {
+		copy(m.row(m.index[slot] - 1)[m.keySize:], v)
+		return
+	}
+
+	m.grow()
+	_, insertAt := m.find(k)
+	if m.index[insertAt] == slotTombstone {
+		m.tombstones--
+	}
+	r := m.allocRow()
+	row := m.row(r)
+	copy(row, k)
+	copy(row[m.keySize:], v)
+	m.used[r/64] |= 1 << uint(r%64)
+	m.index[insertAt] = r + 1
+	m.len++
+}
+
+// SetBatch sets the n keys, packed back-to-back, to the values, packed the same way.  It is
+// Set for each pair, with the index sized for the batch up front.
+func (m *SlabMap) SetBatch(keys, values []byte, n int) {
+	if len(keys) != n*m.keySize || len(values) != n*m.valueSize {
+		log.Panic("SlabMap.SetBatch() called with incorrect keys or values length")
+	}
+	m.growFor(n)
+	for i := 0; i < n; i++ {
+		m.Set(keys[i*m.keySize:(i+1)*m.keySize], values[i*m.valueSize:(i+1)*m.valueSize])
+	}
+}
+
+// Get returns a copy of the value of the given key, or nil if it is not in the map.
+func (m *SlabMap) Get(k []byte) []byte {
+	v := m.get(k)
+	if v == nil {
+		return nil
+	}
+	out := make([]byte, m.valueSize)
+	copy(out, v)
+	return out
+}
+
+// get returns the value of the given key in place; it is only valid until the map changes.
+func (m *SlabMap) get(k []byte) []byte {
+	if len(k) != m.keySize {
+		log.Panic("SlabMap.Get() called with incorrect key length")
+	}
+	slot, _ := m.find(k)
+	if slot < 0 {
+		return nil
+	}
+	return m.row(m.index[slot] - 1)[m.keySize:]
+}
+
+// Contains returns true if the given key is in the map.
+func (m *SlabMap) Contains(k []byte) bool {
+	if len(k) != m.keySize {
+		log.Panic("SlabMap.Contains() called with incorrect key length")
+	}
+	slot, _ := m.find(k)
+	return slot >= 0
+}
+
+func (m *SlabMap) Delete(k []byte) {
+	if len(k) != m.keySize {
+		log.Panic("SlabMap.Delete() called with incorrect key length")
+	}
+	slot, _ := m.find(k)
+	if slot < 0 {
+		return
+	}
+	r := m.index[slot] - 1
+	m.index[slot] = slotTombstone
+	m.tombstones++
+	m.used[r/64] &^= 1 << uint(r%64)
+	m.free = append(m.free, r)
+	m.len--
+}
+
+// Iter iterates over the map, passing each key/value to the given func as a slice.  For performance,
+// the slices are reused between iterations and should not be retained.  As with a normal map, it is
+// safe to delete from the map during iteration; entries added during iteration may or may not be
+// visited.
+func (m *SlabMap) Iter(f func(k, v []byte)) {
+	buf := make([]byte, m.stride)
+	k, v := buf[:m.keySize], buf[m.keySize:]
+	for r := 0; r < m.rows; r++ {
+		if m.used[r/64]&(1<<uint(r%64)) == 0 {
+			continue
+		}
+		copy(buf, m.row(int32(r)))
+		f(k, v)
+	}
+}
+
+func (m *SlabMap) Len() int {
+	return m.len
+}
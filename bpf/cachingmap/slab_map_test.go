@@ -0,0 +1,138 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cachingmap
+
+import (
+	"encoding/binary"
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestSlabMap(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := NewSlabMap(2, 4)
+
+	Expect(m.Get([]byte{1, 2})).To(BeNil(), "New map should not contain a value")
+	m.Set([]byte{1, 2}, []byte{1, 2, 3, 4})
+	Expect(m.Get([]byte{1, 2})).To(Equal([]byte{1, 2, 3, 4}), "Map should contain set value")
+	m.Set([]byte{1, 2}, []byte{1, 2, 3, 5})
+	Expect(m.Get([]byte{1, 2})).To(Equal([]byte{1, 2, 3, 5}), "Map should record updates")
+	m.Set([]byte{3, 4}, []byte{1, 2, 3, 6})
+	Expect(m.Get([]byte{3, 4})).To(Equal([]byte{1, 2, 3, 6}), "Map should record updates")
+	Expect(m.Len()).To(Equal(2))
+
+	seenValues := map[string][]byte{}
+	m.Iter(func(k, v []byte) {
+		Expect(k).To(HaveLen(2))
+		Expect(v).To(HaveLen(4))
+		vCopy := make([]byte, len(v))
+		copy(vCopy, v)
+		seenValues[string(k)] = vCopy
+	})
+	Expect(seenValues).To(Equal(map[string][]byte{
+		string([]byte{1, 2}): {1, 2, 3, 5},
+		string([]byte{3, 4}): {1, 2, 3, 6},
+	}))
+
+	m.Delete([]byte{1, 2})
+	Expect(m.Get([]byte{1, 2})).To(BeNil(), "Deletion should remove the value")
+	Expect(m.Contains([]byte{1, 2})).To(BeFalse())
+	Expect(m.Contains([]byte{3, 4})).To(BeTrue())
+	Expect(m.Len()).To(Equal(1))
+}
+
+// TestSlabMap_Grow verifies that the map stays consistent as it grows across several slabs and
+// the rows and index slots of deleted entries are reused.
+func TestSlabMap_Grow(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := NewSlabMap(4, 4)
+	key := func(i int) []byte {
+		k := make([]byte, 4)
+		binary.LittleEndian.PutUint32(k, uint32(i))
+		return k
+	}
+	value := func(i int) []byte {
+		return key(i * 7)
+	}
+
+	const n = 3*slabRows + 100
+	for i := 0; i < n; i++ {
+		m.Set(key(i), value(i))
+	}
+	Expect(m.Len()).To(Equal(n))
+	Expect(m.slabs).To(HaveLen(4))
+
+	// Delete the odd entries, which leaves tombstones all over the index.
+	for i := 1; i < n; i += 2 {
+		m.Delete(key(i))
+	}
+	Expect(m.Len()).To(Equal(n / 2))
+	for i := 0; i < n; i++ {
+		if i%2 == 0 {
+			Expect(m.Get(key(i))).To(Equal(value(i)))
+		} else {
+			Expect(m.Get(key(i))).To(BeNil())
+		}
+	}
+
+	// Adding the same number of new entries should reuse the freed rows.
+	for i := n; i < n+n/2; i++ {
+		m.Set(key(i), value(i))
+	}
+	Expect(m.slabs).To(HaveLen(4))
+	Expect(m.rows).To(Equal(n))
+
+	seen := 0
+	m.Iter(func(k, v []byte) {
+		i := int(binary.LittleEndian.Uint32(k))
+		Expect(i%2 == 0 || i >= n).To(BeTrue(), "Iter returned a deleted key")
+		Expect(v).To(Equal(value(i)))
+		seen++
+	})
+	Expect(seen).To(Equal(m.Len()))
+
+	// Deleting during iteration is allowed.
+	m.Iter(func(k, v []byte) {
+		m.Delete(k)
+	})
+	Expect(m.Len()).To(BeZero())
+	Expect(m.Get(key(0))).To(BeNil())
+}
+
+func TestSlabMapSetBatch(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := NewSlabMap(4, 2)
+	m.Set([]byte{0, 0, 0, 1}, []byte{9, 9})
+
+	const n = 5000
+	keys := make([]byte, 0, n*4)
+	values := make([]byte, 0, n*2)
+	for i := 0; i < n; i++ {
+		var k [4]byte
+		binary.BigEndian.PutUint32(k[:], uint32(i))
+		keys = append(keys, k[:]...)
+		values = append(values, k[2:]...)
+	}
+	m.SetBatch(keys, values, n)
+
+	Expect(m.Len()).To(Equal(n))
+	Expect(m.Get([]byte{0, 0, 0, 1})).To(Equal([]byte{0, 1}), "SetBatch should overwrite existing keys")
+	Expect(m.Get([]byte{0, 0, 0x13, 0x87})).To(Equal([]byte{0x13, 0x87}))
+	Expect(func() { m.SetBatch(keys[:4], values, 1) }).To(Panic())
+}
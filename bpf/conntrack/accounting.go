@@ -0,0 +1,218 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack
+
+import (
+	"container/heap"
+	"encoding/binary"
+	"fmt"
+	"strconv"
+	"sync"
+
+	"github.com/prometheus/client_golang/prometheus"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// UsageSize is the size of struct calico_ct_acct.
+const UsageSize = 32
+
+// AcctMapParams describes the map of the packet and byte counts of each flow.  It is keyed on the
+// key of the conntrack entry that holds the legs of the flow, the normal or the reverse NAT entry.
+// WARNING: must be kept in sync with cali_v4_ct_acct in bpf-gpl/conntrack.h.
+var AcctMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ct_acct",
+	Type:       "lru_hash",
+	KeySize:    KeySize,
+	ValueSize:  UsageSize,
+	MaxEntries: MaxEntries,
+	Name:       "cali_v4_ct_acct",
+}
+
+func AcctMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(AcctMapParams)
+}
+
+// Usage is the number of packets and bytes that went through each leg of a flow.
+// WARNING: must be kept in sync with struct calico_ct_acct in bpf-gpl/conntrack.h.
+type Usage struct {
+	PacketsAToB uint64
+	BytesAToB   uint64
+	PacketsBToA uint64
+	BytesBToA   uint64
+}
+
+func UsageFromBytes(b []byte) Usage {
+	return Usage{
+		PacketsAToB: binary.LittleEndian.Uint64(b[0:8]),
+		BytesAToB:   binary.LittleEndian.Uint64(b[8:16]),
+		PacketsBToA: binary.LittleEndian.Uint64(b[16:24]),
+		BytesBToA:   binary.LittleEndian.Uint64(b[24:32]),
+	}
+}
+
+func (u Usage) AsBytes() []byte {
+	b := make([]byte, UsageSize)
+	binary.LittleEndian.PutUint64(b[0:8], u.PacketsAToB)
+	binary.LittleEndian.PutUint64(b[8:16], u.BytesAToB)
+	binary.LittleEndian.PutUint64(b[16:24], u.PacketsBToA)
+	binary.LittleEndian.PutUint64(b[24:32], u.BytesBToA)
+	return b
+}
+
+// Bytes returns the number of bytes in both directions.
+func (u Usage) Bytes() uint64 {
+	return u.BytesAToB + u.BytesBToA
+}
+
+func (u Usage) String() string {
+	return fmt.Sprintf("A->B %d packets %d bytes, B->A %d packets %d bytes",
+		u.PacketsAToB, u.BytesAToB, u.PacketsBToA, u.BytesBToA)
+}
+
+var (
+	gaugeVecTopFlowBytes = prometheus.NewGaugeVec(prometheus.GaugeOpts{
+		Name: "felix_bpf_conntrack_top_flow_bytes",
+		Help: "Bytes that went through each leg of the flows that carried the most bytes, as of the last conntrack scan.",
+	}, []string{"proto", "addr_a", "port_a", "addr_b", "port_b", "leg"})
+	gaugeVecTopFlowPackets = prometheus.NewGaugeVec(prometheus.GaugeOpts{
+		Name: "felix_bpf_conntrack_top_flow_packets",
+		Help: "Packets that went through each leg of the flows that carried the most bytes, as of the last conntrack scan.",
+	}, []string{"proto", "addr_a", "port_a", "addr_b", "port_b", "leg"})
+)
+
+func init() {
+	prometheus.MustRegister(gaugeVecTopFlowBytes, gaugeVecTopFlowPackets)
+}
+
+// FlowUsage is the usage of the flow with the conntrack key Key.
+type FlowUsage struct {
+	Key   Key
+	Usage Usage
+}
+
+// flowUsageHeap is a min-heap of flows by bytes, so the smallest of the top flows is at the root.
+type flowUsageHeap []FlowUsage
+
+func (h flowUsageHeap) Len() int            { return len(h) }
+func (h flowUsageHeap) Less(i, j int) bool  { return h[i].Usage.Bytes() < h[j].Usage.Bytes() }
+func (h flowUsageHeap) Swap(i, j int)       { h[i], h[j] = h[j], h[i] }
+func (h *flowUsageHeap) Push(x interface{}) { *h = append(*h, x.(FlowUsage)) }
+func (h *flowUsageHeap) Pop() interface{} {
+	old := *h
+	f := old[len(old)-1]
+	*h = old[:len(old)-1]
+	return f
+}
+
+// AccountingScanner is an EntryScannerSynced that reads the usage of each flow that the conntrack
+// table tracks and, at the end of each scan, exports the topN flows by bytes as metrics.
+type AccountingScanner struct {
+	acctMap bpf.Map
+	topN    int
+	report  func([]FlowUsage)
+
+	lock sync.Mutex
+	top  flowUsageHeap
+}
+
+type AccountingScannerOpt func(s *AccountingScanner)
+
+// WithUsageReporter replaces the metrics with the function, which is given the top flows, largest
+// first, at the end of every scan.
+func WithUsageReporter(report func([]FlowUsage)) AccountingScannerOpt {
+	return func(s *AccountingScanner) {
+		s.report = report
+	}
+}
+
+func NewAccountingScanner(acctMap bpf.Map, topN int, opts ...AccountingScannerOpt) *AccountingScanner {
+	s := &AccountingScanner{
+		acctMap: acctMap,
+		topN:    topN,
+		report:  reportTopFlowMetrics,
+	}
+	for _, opt := range opts {
+		opt(s)
+	}
+	return s
+}
+
+// IterationStart satisfies EntryScannerSynced.
+func (s *AccountingScanner) IterationStart() {
+	s.lock.Lock()
+	s.top = s.top[:0]
+	s.lock.Unlock()
+}
+
+// Check satisfies EntryScanner; it records the usage of the flows whose legs the entry holds.
+func (s *AccountingScanner) Check(k Key, v Value, _ EntryGet) ScanVerdict {
+	if v.Type() == TypeNATForward || s.topN <= 0 {
+		return ScanVerdictOK
+	}
+	b, err := s.acctMap.Get(k.AsBytes())
+	if err != nil {
+		if !bpf.IsNotExists(err) {
+			log.WithError(err).WithField("key", k).Debug("Failed to look up conntrack usage.")
+		}
+		return ScanVerdictOK
+	}
+	f := FlowUsage{Key: k, Usage: UsageFromBytes(b)}
+
+	s.lock.Lock()
+	defer s.lock.Unlock()
+	if len(s.top) < s.topN {
+		heap.Push(&s.top, f)
+	} else if f.Usage.Bytes() > s.top[0].Usage.Bytes() {
+		s.top[0] = f
+		heap.Fix(&s.top, 0)
+	}
+	return ScanVerdictOK
+}
+
+// IterationEnd satisfies EntryScannerSynced; it reports the top flows.
+func (s *AccountingScanner) IterationEnd() {
+	s.lock.Lock()
+	top := make([]FlowUsage, len(s.top))
+	for i := len(top) - 1; i >= 0; i-- {
+		top[i] = heap.Pop(&s.top).(FlowUsage)
+	}
+	s.lock.Unlock()
+
+	s.report(top)
+}
+
+func reportTopFlowMetrics(top []FlowUsage) {
+	gaugeVecTopFlowBytes.Reset()
+	gaugeVecTopFlowPackets.Reset()
+	for _, f := range top {
+		aToB := topFlowLabels(f.Key, "a_to_b")
+		bToA := topFlowLabels(f.Key, "b_to_a")
+		gaugeVecTopFlowBytes.WithLabelValues(aToB...).Set(float64(f.Usage.BytesAToB))
+		gaugeVecTopFlowBytes.WithLabelValues(bToA...).Set(float64(f.Usage.BytesBToA))
+		gaugeVecTopFlowPackets.WithLabelValues(aToB...).Set(float64(f.Usage.PacketsAToB))
+		gaugeVecTopFlowPackets.WithLabelValues(bToA...).Set(float64(f.Usage.PacketsBToA))
+	}
+}
+
+func topFlowLabels(k Key, leg string) []string {
+	return []string{
+		strconv.Itoa(int(k.Proto())),
+		k.AddrA().String(), strconv.Itoa(int(k.PortA())),
+		k.AddrB().String(), strconv.Itoa(int(k.PortB())),
+		leg,
+	}
+}
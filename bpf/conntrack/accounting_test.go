@@ -0,0 +1,82 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack_test
+
+import (
+	"net"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+var _ = Describe("BPF Conntrack AccountingScanner", func() {
+	var (
+		ctMap, acctMap *mock.Map
+		reported       []conntrack.FlowUsage
+		scanner        *conntrack.Scanner
+	)
+
+	client := net.ParseIP("10.0.0.1")
+	server := net.ParseIP("10.65.0.2")
+	flowKey := func(port uint16) conntrack.Key {
+		return conntrack.NewKey(conntrack.ProtoUDP, client, port, server, 53)
+	}
+
+	BeforeEach(func() {
+		ctMap = mock.NewMockMap(conntrack.MapParams)
+		acctMap = mock.NewMockMap(conntrack.AcctMapParams)
+		reported = nil
+		scanner = conntrack.NewScanner(ctMap,
+			conntrack.NewAccountingScanner(acctMap, 2, conntrack.WithUsageReporter(func(top []conntrack.FlowUsage) {
+				reported = top
+			})))
+
+		for i, bytes := range []uint64{100, 5000, 300, 70} {
+			k := flowKey(uint16(1000 + i))
+			Expect(ctMap.Update(k.AsBytes(), udpJustCreated[:])).To(Succeed())
+			u := conntrack.Usage{PacketsAToB: 1, BytesAToB: bytes, PacketsBToA: 2, BytesBToA: bytes}
+			Expect(acctMap.Update(k.AsBytes(), u.AsBytes())).To(Succeed())
+		}
+		// A flow that hasn't been counted yet.
+		Expect(ctMap.Update(flowKey(2000).AsBytes(), udpJustCreated[:])).To(Succeed())
+	})
+
+	It("should report the top flows by bytes, largest first", func() {
+		scanner.Scan()
+		Expect(reported).To(Equal([]conntrack.FlowUsage{
+			{Key: flowKey(1001), Usage: conntrack.Usage{PacketsAToB: 1, BytesAToB: 5000, PacketsBToA: 2, BytesBToA: 5000}},
+			{Key: flowKey(1002), Usage: conntrack.Usage{PacketsAToB: 1, BytesAToB: 300, PacketsBToA: 2, BytesBToA: 300}},
+		}))
+	})
+
+	It("should only report the current usage", func() {
+		scanner.Scan()
+		Expect(ctMap.Delete(flowKey(1001).AsBytes())).To(Succeed())
+		scanner.Scan()
+		Expect(reported).To(HaveLen(2))
+		Expect(reported[0].Key).To(Equal(flowKey(1002)))
+		Expect(reported[1].Key).To(Equal(flowKey(1000)))
+	})
+
+	It("should round-trip a Usage through bytes", func() {
+		u := conntrack.Usage{PacketsAToB: 1, BytesAToB: 2, PacketsBToA: 3, BytesBToA: 4}
+		Expect(u.AsBytes()).To(HaveLen(conntrack.UsageSize))
+		Expect(conntrack.UsageFromBytes(u.AsBytes())).To(Equal(u))
+		Expect(u.Bytes()).To(Equal(uint64(6)))
+	})
+})
@@ -16,6 +16,7 @@ package conntrack
 
 import (
 	"net"
+	"sync"
 	"time"
 
 	log "github.com/sirupsen/logrus"
@@ -40,6 +41,11 @@ type Timeouts struct {
 	ICMPLastSeen time.Duration
 }
 
+// LastSeenGranularity is how often, at most, the BPF programs update the last seen timestamp of an
+// entry.  The age of an entry may be overestimated by up to this much.
+// WARNING: must be kept in sync with CALI_CT_LAST_SEEN_GRANULARITY in bpf-gpl/conntrack.h.
+const LastSeenGranularity = time.Second
+
 func DefaultTimeouts() Timeouts {
 	return Timeouts{
 		CreationGracePeriod: 10 * time.Second,
@@ -58,6 +64,8 @@ type LivenessScanner struct {
 	dsr      bool
 	time     timeshim.Interface
 
+	// kTimeLock protects the cached kernel time from concurrent calls to Check.
+	kTimeLock sync.Mutex
 	// goTimeOfLastKTimeLookup is the go timestamp of the last time we looked up the kernel time.
 	// We cache the kernel time because it's expensive to look up (vs looking up a go timestamp which uses vdso).
 	goTimeOfLastKTimeLookup time.Time
@@ -86,11 +94,13 @@ func WithTimeShim(shim timeshim.Interface) LivenessScannerOpt {
 }
 
 func (l *LivenessScanner) Check(ctKey Key, ctVal Value, get EntryGet) ScanVerdict {
+	l.kTimeLock.Lock()
 	if l.cachedKTime == 0 || l.time.Since(l.goTimeOfLastKTimeLookup) > time.Second {
 		l.cachedKTime = l.time.KTimeNanos()
 		l.goTimeOfLastKTimeLookup = l.time.Now()
 	}
 	now := l.cachedKTime
+	l.kTimeLock.Unlock()
 
 	debug := log.GetLevel() >= log.DebugLevel
 
@@ -215,6 +225,12 @@ func NewStaleNATScanner(frontendHasBackend NATChecker) *StaleNATScanner {
 func (sns *StaleNATScanner) Check(k Key, v Value, _ EntryGet) ScanVerdict {
 	debug := log.GetLevel() >= log.DebugLevel
 
+	if v.Flags()&FlagSNAT != 0 {
+		// The BPF programs SNATed the flow on its way out of a workload, it is not
+		// related to any service.
+		return ScanVerdictOK
+	}
+
 	switch v.Type() {
 	case TypeNormal:
 		// skip non-NAT entry
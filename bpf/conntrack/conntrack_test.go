@@ -17,7 +17,10 @@ package conntrack_test
 import (
 	"encoding/binary"
 	"fmt"
+	"io/ioutil"
 	"net"
+	"os"
+	"path"
 	"time"
 
 	"github.com/projectcalico/felix/bpf"
@@ -235,4 +238,81 @@ var _ = Describe("BPF Conntrack StaleNATScanner", func() {
 			conntrack.ScanVerdictOK,
 		),
 	)
+
+	It("should leave the entries of SNATed flows alone", func() {
+		staleNATScanner := conntrack.NewStaleNATScanner(dummyNATChecker{
+			check: func(fIP net.IP, fPort uint16, bIP net.IP, bPort uint16, proto uint8) bool {
+				Fail("SNAT entries have no frontend")
+				return false
+			},
+		})
+
+		hostIP := net.IPv4(10, 0, 0, 1)
+		revKey := conntrack.NewKey(123, hostIP, 61000, backendIP, backendPort)
+		fwd := conntrack.NewValueNATForward(0, 0, conntrack.FlagSNAT, revKey)
+		rev := conntrack.NewValueNATReverse(0, 0, conntrack.FlagSNAT, conntrack.Leg{}, conntrack.Leg{},
+			nil, clientIP, clientPort)
+
+		Expect(staleNATScanner.Check(conntrack.NewKey(123, clientIP, clientPort, backendIP, backendPort), fwd, nil)).
+			To(Equal(conntrack.ScanVerdictOK))
+		Expect(staleNATScanner.Check(revKey, rev, nil)).To(Equal(conntrack.ScanVerdictOK))
+	})
+})
+
+var _ = Describe("BPF Conntrack in-kernel cleanup binary", func() {
+	It("should patch the timeouts in seconds", func() {
+		dir, err := ioutil.TempDir("", "ct-gc-test")
+		Expect(err).NotTo(HaveOccurred())
+		defer os.RemoveAll(dir)
+
+		// The placeholders are loaded as 32-bit immediates, which have two bytes of opcode before them.
+		ldImm := func(imm []byte) []byte {
+			return append([]byte{0xff, 0, 0}, imm...)
+		}
+		var raw []byte
+		for _, p := range []string{"CTGP", "CTPE", "CTES", "CTFN", "CTRS", "CTUD", "CTGN", "CTIC"} {
+			raw = append(raw, ldImm([]byte(p))...)
+		}
+		in := path.Join(dir, "in.o")
+		Expect(ioutil.WriteFile(in, raw, 0600)).To(Succeed())
+
+		b, err := bpf.BinaryFromFile(in)
+		Expect(err).NotTo(HaveOccurred())
+		timeouts := conntrack.DefaultTimeouts()
+		timeouts.UDPLastSeen = 1500 * time.Millisecond
+		Expect(conntrack.PatchGCBinary(b, timeouts, false)).To(Succeed())
+		out := path.Join(dir, "out.o")
+		Expect(b.WriteToFile(out)).To(Succeed())
+		patched, err := ioutil.ReadFile(out)
+		Expect(err).NotTo(HaveOccurred())
+
+		var expected []byte
+		for _, secs := range []uint32{10, 20, 3600, 30, 40, 2, 600, 5} {
+			imm := make([]byte, 4)
+			binary.LittleEndian.PutUint32(imm, secs)
+			expected = append(expected, ldImm(imm)...)
+		}
+		// WriteToFile appends a random UUID.
+		Expect(patched[:len(expected)]).To(Equal(expected))
+	})
+})
+
+var _ = Describe("BPF Conntrack map upgrades", func() {
+	It("should keep the version 2 entries with zero tunnel MACs", func() {
+		Expect(conntrack.MapUpgrades).To(HaveLen(1))
+		u := conntrack.MapUpgrades[0]
+		Expect(u.From.VersionedName()).To(Equal("cali_v4_ct2"))
+
+		rev := conntrack.NewValueNATReverse(now-time.Minute, now-time.Second, 0,
+			conntrack.Leg{Opener: true}, conntrack.Leg{}, ip2, ip1, 80)
+		k, v := u.Convert(tcpKey.AsBytes(), rev[:u.From.ValueSize])
+		Expect(k).To(Equal(tcpKey.AsBytes()))
+		Expect(v).To(Equal(rev.AsBytes()))
+
+		var upgraded conntrack.Value
+		copy(upgraded[:], v)
+		src, dst := upgraded.TunnelMACs()
+		Expect(src).To(Equal(net.HardwareAddr{0, 0, 0, 0, 0, 0}))
+		Expect(dst).To(Equal(net.HardwareAddr{0, 0, 0, 0, 0, 0}))
+	})
 })
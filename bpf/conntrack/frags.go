@@ -0,0 +1,37 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack
+
+import (
+	"github.com/projectcalico/felix/bpf"
+)
+
+// FragsMapParams describes the map in which the programs remember the ports of the first
+// fragment of a fragmented UDP datagram, so that the trailing fragments, which have no UDP header,
+// can go through conntrack like the first one.  The entries are keyed on the addresses, the
+// protocol and the IP ID of the datagram.
+// WARNING: must be kept in sync with cali_v4_frags in bpf-gpl/frags.h.
+var FragsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_frags",
+	Type:       "lru_hash",
+	KeySize:    12,
+	ValueSize:  4,
+	MaxEntries: 10000,
+	Name:       "cali_v4_frags",
+}
+
+func FragsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(FragsMapParams)
+}
@@ -0,0 +1,186 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack
+
+import (
+	"fmt"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path"
+	"strings"
+	"sync"
+	"time"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/jitter"
+)
+
+// KernelGCPeriod determines how often the in-kernel cleanup runs over the conntrack table.  A pass
+// does not copy anything to userspace so it is much cheaper than a Scan and can keep pace with
+// the flow churn.
+const KernelGCPeriod = time.Second
+
+// kernelGCPinDir is where the cleanup program is pinned, relative to the BPF filesystem.
+const kernelGCPinDir = "calico_ct_gc"
+
+// GCProgFilename returns the name of the pre-compiled in-kernel cleanup program for the log level.
+// WARNING: must be kept in sync with bpf-gpl/list-objs.
+func GCProgFilename(logLevel string) string {
+	logLevel = strings.ToLower(logLevel)
+	if logLevel == "off" {
+		logLevel = "no_log"
+	}
+	return fmt.Sprintf("conntrack_gc_%s.o", logLevel)
+}
+
+// PatchGCBinary patches the timeouts into the in-kernel cleanup program and makes it use the LRU
+// conntrack map, if lru is set.
+// WARNING: the placeholders must be kept in sync with bpf-gpl/conntrack_gc.c.
+func PatchGCBinary(b *bpf.Binary, timeouts Timeouts, lru bool) error {
+	b.PatchConntrackGCTimeout("CTGP", timeouts.CreationGracePeriod)
+	b.PatchConntrackGCTimeout("CTPE", timeouts.TCPPreEstablished)
+	b.PatchConntrackGCTimeout("CTES", timeouts.TCPEstablished)
+	b.PatchConntrackGCTimeout("CTFN", timeouts.TCPFinsSeen)
+	b.PatchConntrackGCTimeout("CTRS", timeouts.TCPResetSeen)
+	b.PatchConntrackGCTimeout("CTUD", timeouts.UDPLastSeen)
+	b.PatchConntrackGCTimeout("CTGN", timeouts.GenericIPLastSeen)
+	b.PatchConntrackGCTimeout("CTIC", timeouts.ICMPLastSeen)
+	return PatchBinary(b, lru)
+}
+
+// KernelGC periodically runs a BPF map iterator over the conntrack map, which deletes the expired
+// entries in place.  It does the job of the LivenessScanner without copying the table to
+// userspace, and it removes the NAT_FWD and NAT_REV entries of a flow together.  The
+// StaleNATScanner still needs the userspace Scanner.
+type KernelGC struct {
+	ctMap  bpf.Map
+	progFD bpf.ProgFD
+
+	wg       sync.WaitGroup
+	stopCh   chan struct{}
+	stopOnce sync.Once
+}
+
+// NewKernelGC loads the in-kernel cleanup program for the conntrack map, which must exist, and
+// runs it once.  It returns an error if the kernel does not support BPF map iterators (5.9+ with
+// BTF), in which case the caller should fall back to the LivenessScanner.
+func NewKernelGC(ctMap bpf.Map, timeouts Timeouts, lru bool, logLevel string) (*KernelGC, error) {
+	bpfMount, err := bpf.MaybeMountBPFfs()
+	if err != nil {
+		return nil, fmt.Errorf("failed to mount bpffs: %w", err)
+	}
+
+	tempDir, err := ioutil.TempDir("", "calico-ct-gc")
+	if err != nil {
+		return nil, fmt.Errorf("failed to create temporary directory: %w", err)
+	}
+	defer func() {
+		_ = os.RemoveAll(tempDir)
+	}()
+
+	filename := GCProgFilename(logLevel)
+	b, err := bpf.BinaryFromFile(path.Join(bpf.ObjectDir, filename))
+	if err != nil {
+		return nil, fmt.Errorf("failed to read pre-compiled BPF binary: %w", err)
+	}
+	err = PatchGCBinary(b, timeouts, lru)
+	if err != nil {
+		return nil, err
+	}
+	tempBinary := path.Join(tempDir, filename)
+	err = b.WriteToFile(tempBinary)
+	if err != nil {
+		return nil, fmt.Errorf("failed to write patched BPF binary: %w", err)
+	}
+
+	pinDir := path.Join(bpfMount, kernelGCPinDir)
+	_ = os.RemoveAll(pinDir)
+
+	// libbpf infers the BPF_PROG_TYPE_TRACING type and the iterator target from the section.
+	cmd := exec.Command("bpftool", "prog", "loadall", tempBinary, pinDir,
+		"map", "name", ctMap.GetName(), "pinned", ctMap.Path())
+	log.WithField("args", cmd.Args).Info("About to run bpftool")
+	out, err := cmd.CombinedOutput()
+	if err != nil {
+		return nil, fmt.Errorf("failed to load conntrack cleanup program: %w: %s", err, out)
+	}
+
+	// The pin name depends on the libbpf version, the object has only one program.
+	pins, err := ioutil.ReadDir(pinDir)
+	if err != nil || len(pins) != 1 {
+		return nil, fmt.Errorf("failed to find pinned conntrack cleanup program in %s: %v", pinDir, err)
+	}
+	progFD, err := bpf.GetProgFDByPin(path.Join(pinDir, pins[0].Name()))
+	if err != nil {
+		return nil, fmt.Errorf("failed to open conntrack cleanup program: %w", err)
+	}
+
+	gc := &KernelGC{
+		ctMap:  ctMap,
+		progFD: progFD,
+		stopCh: make(chan struct{}),
+	}
+
+	// Attaching the iterator is where an unsupported kernel fails.
+	err = gc.Run()
+	if err != nil {
+		_ = progFD.Close()
+		return nil, fmt.Errorf("failed to run conntrack cleanup program: %w", err)
+	}
+
+	return gc, nil
+}
+
+// Run executes one pass of the in-kernel cleanup.
+func (gc *KernelGC) Run() error {
+	return bpf.RunMapIterator(gc.progFD, gc.ctMap.MapFD())
+}
+
+// Start the periodic cleanup.
+func (gc *KernelGC) Start() {
+	gc.wg.Add(1)
+	go func() {
+		defer gc.wg.Done()
+
+		log.Debug("Conntrack in-kernel cleanup thread started")
+		defer log.Debug("Conntrack in-kernel cleanup thread stopped")
+
+		ticker := jitter.NewTicker(KernelGCPeriod, 10*time.Millisecond)
+
+		for {
+			select {
+			case <-ticker.C:
+				if err := gc.Run(); err != nil {
+					log.WithError(err).Warn("Failed to run conntrack in-kernel cleanup")
+				}
+			case <-gc.stopCh:
+				log.Debug("Conntrack in-kernel cleanup got stop signal")
+				return
+			}
+		}
+	}()
+}
+
+// Stop stops the KernelGC and waits for it finishing.
+func (gc *KernelGC) Stop() {
+	gc.stopOnce.Do(func() {
+		close(gc.stopCh)
+		gc.wg.Wait()
+		_ = gc.progFD.Close()
+	})
+}
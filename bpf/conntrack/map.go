@@ -32,7 +32,7 @@ import (
 //   uint16_t port_a, port_b; // HBO
 // };
 const KeySize = 16
-const ValueSize = 64
+const ValueSize = 80
 const MaxEntries = 512000
 
 type Key [KeySize]byte
@@ -99,6 +99,8 @@ func NewKey(proto uint8, ipA net.IP, portA uint16, ipB net.IP, portB uint16) Key
 //      __u8 pad1[2];                      // 54
 //      __u32 tun_ip;                      // 56
 //      __u32 pad3;                        // 60
+//      struct calico_ct_tun_nh tun_nh;    // 64
+//      __u32 pad4;                        // 76
 //    };
 //
 //    // CALI_CT_TYPE_NAT_FWD; key for the CALI_CT_TYPE_NAT_REV entry.
@@ -136,6 +138,13 @@ func (e Value) OrigPort() uint16 {
 	return binary.LittleEndian.Uint16(e[52:54])
 }
 
+// TunnelMACs returns the source and destination MACs of the packets that go back through the
+// VXLAN tunnel that the flow arrived through, valid only if Type() is TypeNATReverse.  They are
+// zero if the programs haven't seen a packet through the tunnel yet.
+func (e Value) TunnelMACs() (src, dst net.HardwareAddr) {
+	return net.HardwareAddr(e[64:70]), net.HardwareAddr(e[70:76])
+}
+
 const (
 	TypeNormal uint8 = iota
 	TypeNATForward
@@ -145,7 +154,7 @@ const (
 	FlagNATFwdDsr uint8 = (1 << 1)
 	FlagNATNPFwd  uint8 = (1 << 2)
 	FlagSkipFIB   uint8 = (1 << 3)
-	FlagReserved4 uint8 = (1 << 4)
+	FlagSNAT      uint8 = (1 << 4)
 	FlagReserved5 uint8 = (1 << 5)
 	FlagExtLocal  uint8 = (1 << 6)
 )
@@ -354,6 +363,10 @@ func (e Value) String() string {
 		if flags&FlagExtLocal != 0 {
 			flagsStr += " ext-local"
 		}
+
+		if flags&FlagSNAT != 0 {
+			flagsStr += " snat"
+		}
 	}
 
 	ret := fmt.Sprintf("Entry{Type:%d, Created:%d, LastSeen:%d, Flags:%s ",
@@ -383,11 +396,67 @@ var MapParams = bpf.MapParameters{
 	MaxEntries: MaxEntries,
 	Name:       "cali_v4_ct",
 	Flags:      unix.BPF_F_NO_PREALLOC,
-	Version:    2,
+	Version:    3,
+}
+
+// mapParamsV2 describes the conntrack map before the NAT reverse entries recorded the MACs of the
+// tunnel next hop.
+var mapParamsV2 = func() bpf.MapParameters {
+	mp := MapParams
+	mp.ValueSize = 64
+	mp.Version = 2
+	return mp
+}()
+
+// LRUMapParams describes the conntrack map when it is an LRU hash map.  The kernel then evicts the
+// least recently used entries when the map is full instead of failing to create new entries.  LRU maps
+// must be preallocated.
+var LRUMapParams = func() bpf.MapParameters {
+	mp := MapParams
+	mp.Type = "lru_hash"
+	mp.Flags = 0
+	return mp
+}()
+
+// MapUpgrades converts the entries of the older versions of the conntrack map when a release
+// bumps Version, so that the flows of the node survive the upgrade.  When changing the layout of
+// the entries, add the conversion from the previous version here.
+var MapUpgrades = []bpf.MapUpgrade{
+	{
+		// The tunnel MACs start zero, the programs fill them in from the next packet that
+		// arrives through the tunnel.
+		From: mapParamsV2,
+		Convert: func(k, v []byte) ([]byte, []byte) {
+			var newV Value
+			copy(newV[:], v)
+			return k, newV[:]
+		},
+	},
 }
 
 func Map(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(MapParams)
+	return mc.NewPinnedMapWithUpgrades(MapParams, MapUpgrades...)
+}
+
+// PatchBinary makes a program binary use the LRU conntrack map, if lru is set.
+func PatchBinary(b *bpf.Binary, lru bool) error {
+	b.PatchConntrackLRU(lru)
+	if !lru {
+		return nil
+	}
+	err := b.PatchMapParams(LRUMapParams)
+	if err != nil {
+		return fmt.Errorf("failed to patch conntrack map into BPF binary: %w", err)
+	}
+	return nil
+}
+
+// MapForType returns the conntrack map with the given type, "hash" or "lru_hash".
+func MapForType(mc *bpf.MapContext, mapType string) bpf.Map {
+	if mapType == LRUMapParams.Type {
+		return mc.NewPinnedMapWithUpgrades(LRUMapParams, MapUpgrades...)
+	}
+	return Map(mc)
 }
 
 const (
@@ -0,0 +1,395 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack
+
+import (
+	"crypto/hmac"
+	"crypto/sha256"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"net"
+	"sync"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/timeshim"
+)
+
+// The replication datagrams start with a header of a uint32 magic number, a uint16 version and a
+// uint16 count, followed by count records, each a conntrack key and value, and end with an
+// HMAC-SHA256 of the rest of the datagram under the key that the peers share.  The timestamps of
+// the value are replaced by ages, in nanoseconds, because the kernel clocks of the nodes are not
+// comparable.  The records come in pairs, a NAT reverse entry followed by its forward entry.
+const (
+	replicationMagic   uint32 = 0xca11c7d0
+	replicationVersion uint16 = 2
+
+	replicationHdrSize = 8
+	replicationMACSize = sha256.Size
+	// replicationValueSize leaves out the tunnel MACs at the end of the value, which are only
+	// valid on the node that recorded them.
+	replicationValueSize  = 64
+	replicationRecordSize = KeySize + replicationValueSize
+
+	// replicationMaxDatagram keeps the datagrams under a typical MTU so that they don't fragment.
+	// A datagram carries whole pairs of records.
+	replicationMaxDatagram = 1400
+	replicationMaxRecords  = (replicationMaxDatagram - replicationHdrSize - replicationMACSize) /
+		(2 * replicationRecordSize) * 2
+
+	// legFlagWhitelisted is the bit of calico_ct_leg's flags that records that policy allowed the
+	// leg.
+	legFlagWhitelisted uint32 = 1 << 4
+)
+
+// Replicator replicates the conntrack entries of the connections that this node forwards to a
+// NodePort backend on another node, with or without DSR, to a set of peers.  Those entries only
+// exist on the node that the connection came in through; if the upstream load balancer moves the
+// connection to a peer, the peer would otherwise treat it as a mid-flow miss.
+//
+// The Replicator is an EntryScannerSynced, it collects the entries while the Scanner iterates over
+// the conntrack map and sends them in batches at the end of each iteration.  Start() runs the
+// receiving side, which installs the entries that the peers send unless there is an entry for the
+// connection already.  It only accepts datagrams that the peers signed with the shared key and
+// only the entries of forwarded NodePort connections; the policy verdicts of the entries are left
+// for this node's programs to make again.
+type Replicator struct {
+	ctMap bpf.Map
+	port  int
+	peers []net.IP
+	key   []byte
+	time  timeshim.Interface
+
+	now         int64
+	recordsLock sync.Mutex
+	records     []byte
+
+	conn     *net.UDPConn
+	wg       sync.WaitGroup
+	stopCh   chan struct{}
+	stopOnce sync.Once
+}
+
+type ReplicatorOpt func(r *Replicator)
+
+func WithReplicatorTimeShim(shim timeshim.Interface) ReplicatorOpt {
+	return func(r *Replicator) {
+		r.time = shim
+	}
+}
+
+// NewReplicator returns a Replicator that exchanges entries of ctMap with the peers on the given
+// UDP port, authenticated with the given key.
+func NewReplicator(ctMap bpf.Map, port int, peers []net.IP, key []byte, opts ...ReplicatorOpt) *Replicator {
+	r := &Replicator{
+		ctMap: ctMap,
+		port:  port,
+		peers: peers,
+		key:   key,
+		time:  timeshim.RealTime(),
+
+		stopCh: make(chan struct{}),
+	}
+	for _, opt := range opts {
+		opt(r)
+	}
+	return r
+}
+
+// IterationStart satisfies EntryScannerSynced
+func (r *Replicator) IterationStart() {
+	r.now = r.time.KTimeNanos()
+	r.records = r.records[:0]
+}
+
+// Check satisfies EntryScanner, it collects the entries to replicate.
+func (r *Replicator) Check(k Key, v Value, get EntryGet) ScanVerdict {
+	if v.Type() != TypeNATForward {
+		return ScanVerdictOK
+	}
+	revKey := v.ReverseNATKey()
+	revVal, err := get(revKey)
+	if err != nil {
+		return ScanVerdictOK
+	}
+	if revVal.Flags()&(FlagNATNPFwd|FlagNATFwdDsr) == 0 {
+		return ScanVerdictOK
+	}
+
+	// The BPF programs look up the reverse entry when they find the forward entry so, like them,
+	// install the reverse entry first.
+	r.recordsLock.Lock()
+	r.records = appendReplicationRecord(r.records, revKey, revVal, r.now)
+	r.records = appendReplicationRecord(r.records, k, v, r.now)
+	r.recordsLock.Unlock()
+	return ScanVerdictOK
+}
+
+// IterationEnd satisfies EntryScannerSynced, it sends the entries that we collected.
+func (r *Replicator) IterationEnd() {
+	if len(r.records) == 0 || len(r.peers) == 0 {
+		return
+	}
+
+	datagrams := replicationDatagrams(r.records, r.key)
+	sent := 0
+	for _, peer := range r.peers {
+		addr := &net.UDPAddr{IP: peer, Port: r.port}
+		conn, err := net.DialUDP("udp4", nil, addr)
+		if err != nil {
+			log.WithError(err).WithField("peer", peer).Warn("Failed to connect to conntrack replication peer.")
+			continue
+		}
+		for _, d := range datagrams {
+			_, err = conn.Write(d)
+			if err != nil {
+				log.WithError(err).WithField("peer", peer).Debug("Failed to send conntrack entries.")
+				break
+			}
+		}
+		_ = conn.Close()
+		sent++
+	}
+
+	log.WithFields(log.Fields{
+		"entries": len(r.records) / replicationRecordSize,
+		"peers":   sent,
+	}).Debug("Sent conntrack entries to replication peers.")
+}
+
+func appendReplicationRecord(records []byte, k Key, v Value, now int64) []byte {
+	var age [16]byte
+	binary.LittleEndian.PutUint64(age[0:8], uint64(now-v.Created()))
+	binary.LittleEndian.PutUint64(age[8:16], uint64(now-v.LastSeen()))
+
+	records = append(records, k[:]...)
+	records = append(records, age[:]...)
+	return append(records, v[16:replicationValueSize]...)
+}
+
+// replicationDatagrams splits the records into signed datagrams.
+func replicationDatagrams(records []byte, key []byte) [][]byte {
+	var datagrams [][]byte
+
+	for len(records) > 0 {
+		n := len(records) / replicationRecordSize
+		if n > replicationMaxRecords {
+			n = replicationMaxRecords
+		}
+		d := make([]byte, replicationHdrSize, replicationHdrSize+n*replicationRecordSize+replicationMACSize)
+		binary.LittleEndian.PutUint32(d[0:4], replicationMagic)
+		binary.LittleEndian.PutUint16(d[4:6], replicationVersion)
+		binary.LittleEndian.PutUint16(d[6:8], uint16(n))
+		d = append(d, records[:n*replicationRecordSize]...)
+		mac := hmac.New(sha256.New, key)
+		mac.Write(d)
+		datagrams = append(datagrams, mac.Sum(d))
+		records = records[n*replicationRecordSize:]
+	}
+
+	return datagrams
+}
+
+// ReplicationEntry is an entry received from a peer.
+type ReplicationEntry struct {
+	Key   Key
+	Value Value
+}
+
+// parseReplicationDatagram checks the signature of the datagram and returns its entries, with their
+// timestamps converted to our clock.  It rejects the datagram unless it holds only pairs of NAT
+// entries of forwarded NodePort connections.  The interfaces that the entry recorded are
+// meaningless on this node so it clears them; the BPF programs then let the kernel check the route
+// of the next packets.  It clears the policy verdicts too, so that our programs check the policy.
+func parseReplicationDatagram(d []byte, key []byte, now int64) ([]ReplicationEntry, error) {
+	if len(d) < replicationHdrSize+replicationMACSize {
+		return nil, errors.New("datagram too short")
+	}
+	d, sum := d[:len(d)-replicationMACSize], d[len(d)-replicationMACSize:]
+	mac := hmac.New(sha256.New, key)
+	mac.Write(d)
+	if !hmac.Equal(sum, mac.Sum(nil)) {
+		return nil, errors.New("bad signature")
+	}
+	if binary.LittleEndian.Uint32(d[0:4]) != replicationMagic {
+		return nil, errors.New("bad magic")
+	}
+	if v := binary.LittleEndian.Uint16(d[4:6]); v != replicationVersion {
+		return nil, fmt.Errorf("unsupported version %d", v)
+	}
+	n := int(binary.LittleEndian.Uint16(d[6:8]))
+	if len(d) != replicationHdrSize+n*replicationRecordSize {
+		return nil, fmt.Errorf("bad length %d for %d entries", len(d), n)
+	}
+	if n%2 != 0 {
+		return nil, fmt.Errorf("odd number of entries %d", n)
+	}
+
+	entries := make([]ReplicationEntry, n)
+	d = d[replicationHdrSize:]
+	for i := range entries {
+		e := &entries[i]
+		rec := d[i*replicationRecordSize : (i+1)*replicationRecordSize]
+		copy(e.Key[:], rec[:KeySize])
+		copy(e.Value[:], rec[KeySize:])
+
+		created := now - int64(binary.LittleEndian.Uint64(e.Value[0:8]))
+		lastSeen := now - int64(binary.LittleEndian.Uint64(e.Value[8:16]))
+		binary.LittleEndian.PutUint64(e.Value[0:8], uint64(created))
+		binary.LittleEndian.PutUint64(e.Value[8:16], uint64(lastSeen))
+
+		if e.Value.Type() == TypeNATReverse {
+			clearReplicatedLeg(e.Value[24:36])
+			clearReplicatedLeg(e.Value[36:48])
+		}
+	}
+
+	for i := 0; i < n; i += 2 {
+		rev, fwd := &entries[i], &entries[i+1]
+		if rev.Value.Type() != TypeNATReverse || rev.Value.Flags()&(FlagNATNPFwd|FlagNATFwdDsr) == 0 {
+			return nil, fmt.Errorf("unexpected entry %v", rev.Key)
+		}
+		if fwd.Value.Type() != TypeNATForward || fwd.Value.ReverseNATKey() != rev.Key {
+			return nil, fmt.Errorf("unexpected entry %v", fwd.Key)
+		}
+	}
+
+	return entries, nil
+}
+
+// clearReplicatedLeg clears the interface and the policy verdict of a calico_ct_leg.
+func clearReplicatedLeg(leg []byte) {
+	flags := binary.LittleEndian.Uint32(leg[4:8])
+	binary.LittleEndian.PutUint32(leg[4:8], flags&^legFlagWhitelisted)
+	binary.LittleEndian.PutUint32(leg[8:12], 0)
+}
+
+// Start starts receiving the entries that the peers send, on the address that we send them from.
+func (r *Replicator) Start() error {
+	localIP, err := r.localIP()
+	if err != nil {
+		return err
+	}
+	conn, err := net.ListenUDP("udp4", &net.UDPAddr{IP: localIP, Port: r.port})
+	if err != nil {
+		return fmt.Errorf("failed to listen for conntrack replication: %w", err)
+	}
+	r.conn = conn
+
+	r.wg.Add(1)
+	go func() {
+		defer r.wg.Done()
+
+		log.WithField("addr", conn.LocalAddr()).Info("Conntrack replication receiver started")
+		defer log.Info("Conntrack replication receiver stopped")
+
+		buf := make([]byte, replicationMaxDatagram)
+		for {
+			n, from, err := conn.ReadFromUDP(buf)
+			if err != nil {
+				select {
+				case <-r.stopCh:
+					return
+				default:
+				}
+				log.WithError(err).Warn("Failed to receive conntrack entries.")
+				continue
+			}
+			if !r.isPeer(from.IP) {
+				log.WithField("from", from).Debug("Ignoring conntrack entries from unknown peer.")
+				continue
+			}
+			entries, err := parseReplicationDatagram(buf[:n], r.key, r.time.KTimeNanos())
+			if err != nil {
+				log.WithError(err).WithField("from", from).Warn("Ignoring bad conntrack replication datagram.")
+				continue
+			}
+			r.install(entries)
+		}
+	}()
+
+	return nil
+}
+
+// localIP returns the source address of the routes to the peers, which must all be the same.
+func (r *Replicator) localIP() (net.IP, error) {
+	var localIP net.IP
+	for _, peer := range r.peers {
+		// Connecting a UDP socket only picks the route, it doesn't send anything.
+		conn, err := net.DialUDP("udp4", nil, &net.UDPAddr{IP: peer, Port: r.port})
+		if err != nil {
+			return nil, fmt.Errorf("failed to find the route to conntrack replication peer %v: %w", peer, err)
+		}
+		ip := conn.LocalAddr().(*net.UDPAddr).IP
+		_ = conn.Close()
+		if localIP == nil {
+			localIP = ip
+		} else if !localIP.Equal(ip) {
+			return nil, fmt.Errorf("conntrack replication peers are reachable from both %v and %v", localIP, ip)
+		}
+	}
+	if localIP == nil {
+		return nil, errors.New("no conntrack replication peers")
+	}
+	return localIP, nil
+}
+
+func (r *Replicator) isPeer(ip net.IP) bool {
+	for _, p := range r.peers {
+		if p.Equal(ip) {
+			return true
+		}
+	}
+	return false
+}
+
+// install adds the entries to the conntrack map, leaving alone the connections that we know
+// about, as our entries are more up to date than the peer's.
+func (r *Replicator) install(entries []ReplicationEntry) {
+	installed := 0
+	for _, e := range entries {
+		_, err := r.ctMap.Get(e.Key.AsBytes())
+		if err == nil {
+			continue
+		}
+		if !bpf.IsNotExists(err) {
+			log.WithError(err).WithField("key", e.Key).Warn("Failed to look up conntrack entry.")
+			continue
+		}
+		err = r.ctMap.Update(e.Key.AsBytes(), e.Value.AsBytes())
+		if err != nil {
+			log.WithError(err).WithField("key", e.Key).Warn("Failed to install replicated conntrack entry.")
+			continue
+		}
+		installed++
+	}
+
+	if installed > 0 {
+		log.WithField("entries", installed).Debug("Installed replicated conntrack entries.")
+	}
+}
+
+// Stop stops the receiver and waits for it to finish.
+func (r *Replicator) Stop() {
+	r.stopOnce.Do(func() {
+		close(r.stopCh)
+		if r.conn != nil {
+			_ = r.conn.Close()
+		}
+		r.wg.Wait()
+	})
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack_test
+
+import (
+	"net"
+	"sync"
+	"time"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/timeshim/mocktime"
+)
+
+// lockedMap lets the test look at the map that the replication receiver updates in the background.
+type lockedMap struct {
+	lock sync.Mutex
+	*mock.Map
+}
+
+func (m *lockedMap) Get(k []byte) ([]byte, error) {
+	m.lock.Lock()
+	defer m.lock.Unlock()
+	return m.Map.Get(k)
+}
+
+func (m *lockedMap) Update(k, v []byte) error {
+	m.lock.Lock()
+	defer m.lock.Unlock()
+	return m.Map.Update(k, v)
+}
+
+var _ = Describe("BPF Conntrack Replicator", func() {
+	const port = 18765
+	key := []byte("conntrack-replication-test-key")
+
+	var (
+		srcMap, dstMap     *lockedMap
+		srcTime, dstTime   *mocktime.MockTime
+		sender, receiver   *conntrack.Replicator
+		scanner            *conntrack.Scanner
+		clientIP, svcIP    = net.ParseIP("10.0.0.1"), net.ParseIP("10.96.0.10")
+		backendIP, tunIP   = net.ParseIP("10.65.1.2"), net.ParseIP("192.168.0.2")
+		fwdKey, revKey     conntrack.Key
+		fwdValue, revValue conntrack.Value
+	)
+
+	BeforeEach(func() {
+		srcMap = &lockedMap{Map: mock.NewMockMap(conntrack.MapParams)}
+		dstMap = &lockedMap{Map: mock.NewMockMap(conntrack.MapParams)}
+		srcTime = mocktime.New()
+		dstTime = mocktime.New()
+		// The peer's clock is unrelated to ours.
+		dstTime.IncrementTime(time.Hour)
+
+		localhost := []net.IP{net.ParseIP("127.0.0.1")}
+		sender = conntrack.NewReplicator(srcMap, port, localhost, key, conntrack.WithReplicatorTimeShim(srcTime))
+		receiver = conntrack.NewReplicator(dstMap, port, localhost, key, conntrack.WithReplicatorTimeShim(dstTime))
+		Expect(receiver.Start()).To(Succeed())
+		scanner = conntrack.NewScanner(srcMap, sender)
+
+		fwdKey = conntrack.NewKey(conntrack.ProtoTCP, clientIP, 54321, svcIP, 80)
+		revKey = conntrack.NewKey(conntrack.ProtoTCP, clientIP, 54321, backendIP, 8080)
+		fwdValue = conntrack.NewValueNATForward(now-time.Minute, now-time.Second, 0, revKey)
+		revValue = conntrack.NewValueNATReverse(now-time.Minute, now-time.Second, conntrack.FlagNATNPFwd,
+			conntrack.Leg{SynSeen: true, AckSeen: true, Whitelisted: true, Ifindex: 3},
+			conntrack.Leg{SynSeen: true, AckSeen: true, Whitelisted: true, Ifindex: 4},
+			tunIP, svcIP, 80)
+	})
+
+	AfterEach(func() {
+		receiver.Stop()
+	})
+
+	It("should replicate the entries of forwarded NodePort connections", func() {
+		Expect(srcMap.Update(fwdKey.AsBytes(), fwdValue.AsBytes())).To(Succeed())
+		Expect(srcMap.Update(revKey.AsBytes(), revValue.AsBytes())).To(Succeed())
+
+		scanner.Scan()
+
+		getEntry := func(k conntrack.Key) func() []byte {
+			return func() []byte {
+				v, _ := dstMap.Get(k.AsBytes())
+				return v
+			}
+		}
+		Eventually(getEntry(revKey)).ShouldNot(BeNil())
+		Eventually(getEntry(fwdKey)).ShouldNot(BeNil())
+
+		By("rebasing the timestamps on the peer's clock")
+		rev := conntrack.ValueFromBytes(getEntry(revKey)())
+		Expect(rev.Created()).To(BeNumerically("==", now+time.Hour-time.Minute))
+		Expect(rev.LastSeen()).To(BeNumerically("==", now+time.Hour-time.Second))
+		Expect(rev.Flags()).To(Equal(conntrack.FlagNATNPFwd))
+		Expect(rev.Data().TunIP.Equal(tunIP)).To(BeTrue())
+
+		By("clearing the interfaces, which are meaningless on the peer")
+		Expect(rev.Data().A2B.Ifindex).To(BeZero())
+		Expect(rev.Data().B2A.Ifindex).To(BeZero())
+		Expect(rev.Data().Established()).To(BeTrue())
+
+		By("clearing the policy verdicts, which the peer makes itself")
+		Expect(rev.Data().A2B.Whitelisted).To(BeFalse())
+		Expect(rev.Data().B2A.Whitelisted).To(BeFalse())
+
+		fwd := conntrack.ValueFromBytes(getEntry(fwdKey)())
+		Expect(fwd.Type()).To(Equal(conntrack.TypeNATForward))
+		Expect(fwd.ReverseNATKey()).To(Equal(revKey))
+	})
+
+	It("should ignore entries signed with another key", func() {
+		sender = conntrack.NewReplicator(srcMap, port, []net.IP{net.ParseIP("127.0.0.1")},
+			[]byte("some-other-key"), conntrack.WithReplicatorTimeShim(srcTime))
+		scanner = conntrack.NewScanner(srcMap, sender)
+		Expect(srcMap.Update(fwdKey.AsBytes(), fwdValue.AsBytes())).To(Succeed())
+		Expect(srcMap.Update(revKey.AsBytes(), revValue.AsBytes())).To(Succeed())
+
+		scanner.Scan()
+
+		Consistently(func() int {
+			dstMap.lock.Lock()
+			defer dstMap.lock.Unlock()
+			return len(dstMap.Contents)
+		}, "200ms").Should(BeZero())
+	})
+
+	It("should not replicate local NAT connections", func() {
+		revValue = conntrack.NewValueNATReverse(now-time.Minute, now-time.Second, 0,
+			conntrack.Leg{}, conntrack.Leg{}, nil, svcIP, 80)
+		Expect(srcMap.Update(fwdKey.AsBytes(), fwdValue.AsBytes())).To(Succeed())
+		Expect(srcMap.Update(revKey.AsBytes(), revValue.AsBytes())).To(Succeed())
+
+		scanner.Scan()
+
+		Consistently(func() int {
+			dstMap.lock.Lock()
+			defer dstMap.lock.Unlock()
+			return len(dstMap.Contents)
+		}, "200ms").Should(BeZero())
+	})
+})
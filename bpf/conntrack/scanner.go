@@ -19,6 +19,7 @@ import (
 	"time"
 
 	log "github.com/sirupsen/logrus"
+	"golang.org/x/sys/unix"
 
 	"github.com/projectcalico/felix/bpf"
 	"github.com/projectcalico/felix/jitter"
@@ -35,13 +36,24 @@ const (
 
 	// ScanPeriod determines how often we iterate over the conntrack table.
 	ScanPeriod = 10 * time.Second
+
+	// scanChunkSize is the number of entries that the Scanner checks between pauses, and that it
+	// shares out between its workers.
+	scanChunkSize = 1024
+	// scanMaxSpread limits how long a budgeted scan may take; the scanners that hold locks across
+	// the iteration, like the StaleNATScanner, hold them across the pauses.
+	scanMaxSpread = ScanPeriod / 4
+	// scanGetCacheTTL is how long the Scanner reuses an entry that an EntryScanner fetched.  Like
+	// LastSeenGranularity, it may make an entry look older than it is by up to this much.
+	scanGetCacheTTL = time.Second
 )
 
 // EntryGet is a function prototype provided to EntryScanner in case it needs to
 // evaluate other entries to make a verdict
 type EntryGet func(Key) (Value, error)
 
-// EntryScanner is a function prototype to be called on every entry by the scanner
+// EntryScanner is a function prototype to be called on every entry by the scanner.  If the
+// Scanner has more than one worker, see WithScanWorkers, Check is called concurrently.
 type EntryScanner interface {
 	Check(Key, Value, EntryGet) ScanVerdict
 }
@@ -64,35 +76,107 @@ type Scanner struct {
 	ctMap    bpf.Map
 	scanners []EntryScanner
 
+	workers   int
+	cpuBudget float64
+
+	cacheLock sync.Mutex
+	getCache  map[Key]cachedEntry
+
 	wg       sync.WaitGroup
 	stopCh   chan struct{}
 	stopOnce sync.Once
 }
 
+type cachedEntry struct {
+	value   Value
+	err     error
+	fetched time.Time
+}
+
 // NewScanner returns a scanner for the given conntrack map and the set of
 // EntryScanner. They are executed in the provided order on each entry.
 func NewScanner(ctMap bpf.Map, scanners ...EntryScanner) *Scanner {
 	return &Scanner{
 		ctMap:    ctMap,
 		scanners: scanners,
+		workers:  1,
 		stopCh:   make(chan struct{}),
 	}
 }
 
+type ScannerOpt func(s *Scanner)
+
+// WithScanWorkers makes the Scanner share each chunk of entries between n goroutines.  All the
+// EntryScanners must then support concurrent calls to Check.
+func WithScanWorkers(n int) ScannerOpt {
+	return func(s *Scanner) {
+		if n < 1 {
+			n = 1
+		}
+		s.workers = n
+	}
+}
+
+// WithScanCPUBudget makes the Scanner pause between chunks of entries so that, while it scans, it
+// is busy for about percent of the time, rather than scanning the whole table in one burst.  The
+// pauses stop once the scan has taken a quarter of the ScanPeriod.  Zero, or 100, disables them.
+func WithScanCPUBudget(percent int) ScannerOpt {
+	return func(s *Scanner) {
+		s.cpuBudget = 0
+		if percent > 0 && percent < 100 {
+			s.cpuBudget = float64(percent) / 100
+		}
+	}
+}
+
+// ConfigureUnlocked applies the options to a non-running Scanner.
+func (s *Scanner) ConfigureUnlocked(opts ...ScannerOpt) {
+	for _, opt := range opts {
+		opt(s)
+	}
+}
+
 // Scan executes a scanning iteration
 func (s *Scanner) Scan() {
 	s.iterStart()
 	defer s.iterEnd()
 
+	s.cacheLock.Lock()
+	s.getCache = map[Key]cachedEntry{}
+	s.cacheLock.Unlock()
+	defer func() {
+		s.cacheLock.Lock()
+		s.getCache = nil
+		s.cacheLock.Unlock()
+	}()
+
+	var err error
+	if s.workers > 1 {
+		err = s.scanParallel()
+	} else {
+		err = s.scanSerial()
+	}
+	if err != nil {
+		log.WithError(err).Warn("Failed to iterate over conntrack map")
+	}
+}
+
+func (s *Scanner) scanSerial() error {
 	debug := log.GetLevel() >= log.DebugLevel
+	p := s.newPacer()
 
 	var ctKey Key
 	var ctVal Value
+	n := 0
 
-	err := s.ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
+	return s.ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
 		copy(ctKey[:], k[:])
 		copy(ctVal[:], v[:])
 
+		if n++; n%scanChunkSize == 0 {
+			p.pause()
+		}
+
 		if debug {
 			log.WithFields(log.Fields{
 				"key":   ctKey,
@@ -100,30 +184,173 @@ func (s *Scanner) Scan() {
 			}).Debug("Examining conntrack entry")
 		}
 
-		for _, scanner := range s.scanners {
-			if verdict := scanner.Check(ctKey, ctVal, s.get); verdict == ScanVerdictDelete {
-				if debug {
-					log.Debug("Deleting conntrack entry.")
-				}
-				return bpf.IterDelete
+		if s.check(ctKey, ctVal) == ScanVerdictDelete {
+			if debug {
+				log.Debug("Deleting conntrack entry.")
 			}
+			return bpf.IterDelete
 		}
 		return bpf.IterNone
 	})
+}
+
+type scanEntry struct {
+	key     Key
+	value   Value
+	verdict ScanVerdict
+}
 
+// scanParallel checks the entries that the iterator returns in chunks, sharing each chunk between
+// the workers.  The verdict of the entry that completes a chunk is returned to the iterator as
+// usual; the other entries in the chunk have been iterated over already so we delete them
+// ourselves.  Deleting the iterator's current key would restart a non-batched iteration.
+func (s *Scanner) scanParallel() error {
+	p := s.newPacer()
+	chunk := make([]scanEntry, 0, scanChunkSize)
+
+	err := s.ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		var e scanEntry
+		copy(e.key[:], k)
+		copy(e.value[:], v)
+		chunk = append(chunk, e)
+		if len(chunk) < scanChunkSize {
+			return bpf.IterNone
+		}
+
+		s.checkChunk(chunk)
+		last := chunk[len(chunk)-1]
+		s.deleteEntries(chunk[:len(chunk)-1])
+		chunk = chunk[:0]
+		p.pause()
+
+		if last.verdict == ScanVerdictDelete {
+			return bpf.IterDelete
+		}
+		return bpf.IterNone
+	})
 	if err != nil {
-		log.WithError(err).Warn("Failed to iterate over conntrack map")
+		return err
+	}
+
+	s.checkChunk(chunk)
+	s.deleteEntries(chunk)
+	return nil
+}
+
+func (s *Scanner) checkChunk(chunk []scanEntry) {
+	var wg sync.WaitGroup
+	per := (len(chunk) + s.workers - 1) / s.workers
+	for start := 0; start < len(chunk); start += per {
+		end := start + per
+		if end > len(chunk) {
+			end = len(chunk)
+		}
+		wg.Add(1)
+		go func(part []scanEntry) {
+			defer wg.Done()
+			for i := range part {
+				part[i].verdict = s.check(part[i].key, part[i].value)
+			}
+		}(chunk[start:end])
+	}
+	wg.Wait()
+}
+
+func (s *Scanner) deleteEntries(entries []scanEntry) {
+	for _, e := range entries {
+		if e.verdict != ScanVerdictDelete {
+			continue
+		}
+		err := s.ctMap.Delete(e.key.AsBytes())
+		if err != nil && !bpf.IsNotExists(err) {
+			log.WithError(err).WithField("key", e.key).Warn("Failed to delete conntrack entry.")
+		}
+	}
+}
+
+// check runs the EntryScanners on the entry until one of them returns ScanVerdictDelete.
+func (s *Scanner) check(k Key, v Value) ScanVerdict {
+	for _, scanner := range s.scanners {
+		if verdict := scanner.Check(k, v, s.get); verdict == ScanVerdictDelete {
+			s.forget(k)
+			return ScanVerdictDelete
+		}
 	}
+	return ScanVerdictOK
 }
 
+// get fetches an entry for an EntryScanner.  Several scanners look up the reverse entry of each
+// forward NAT entry so we reuse what we fetched for a short while.
 func (s *Scanner) get(k Key) (Value, error) {
+	s.cacheLock.Lock()
+	c, ok := s.getCache[k]
+	s.cacheLock.Unlock()
+	if ok && time.Since(c.fetched) < scanGetCacheTTL {
+		return c.value, c.err
+	}
+
 	v, err := s.ctMap.Get(k.AsBytes())
+	c = cachedEntry{err: err, fetched: time.Now()}
+	if err == nil {
+		c.value = ValueFromBytes(v)
+	}
 
-	if err != nil {
-		return Value{}, err
+	s.cacheLock.Lock()
+	if s.getCache != nil {
+		s.getCache[k] = c
+	}
+	s.cacheLock.Unlock()
+
+	return c.value, c.err
+}
+
+// forget records that the entry is going away, so the scanners that look it up later in the
+// iteration find it gone.
+func (s *Scanner) forget(k Key) {
+	s.cacheLock.Lock()
+	defer s.cacheLock.Unlock()
+	if s.getCache != nil {
+		s.getCache[k] = cachedEntry{err: unix.ENOENT, fetched: time.Now()}
+	}
+}
+
+// scanPacer spreads a scan out so that it uses about the CPU budget.
+type scanPacer struct {
+	budget    float64
+	deadline  time.Time
+	workStart time.Time
+	stopCh    chan struct{}
+}
+
+func (s *Scanner) newPacer() *scanPacer {
+	now := time.Now()
+	return &scanPacer{
+		budget:    s.cpuBudget,
+		deadline:  now.Add(scanMaxSpread),
+		workStart: now,
+		stopCh:    s.stopCh,
 	}
+}
 
-	return ValueFromBytes(v), nil
+// pause sleeps long enough that the work since the last pause is the budgeted share of the time.
+func (p *scanPacer) pause() {
+	if p.budget == 0 {
+		return
+	}
+	now := time.Now()
+	d := time.Duration(float64(now.Sub(p.workStart)) * (1 - p.budget) / p.budget)
+	if left := p.deadline.Sub(now); d > left {
+		d = left
+	}
+	if d > 0 {
+		select {
+		case <-time.After(d):
+		case <-p.stopCh:
+			// Finish the scan without pausing.
+			p.budget = 0
+		}
+	}
+	p.workStart = time.Now()
 }
 
 // Start the periodic scanner
@@ -0,0 +1,127 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack_test
+
+import (
+	"net"
+	"time"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/ginkgo/extensions/table"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/timeshim/mocktime"
+)
+
+var _ = Describe("BPF Conntrack Scanner", func() {
+	// More entries than fit in one chunk so that the parallel scan deletes some itself.
+	const numFlows = 2500
+
+	var (
+		ctMap    *lockedMap
+		mockTime *mocktime.MockTime
+		live     []conntrack.Key
+		expired  []conntrack.Key
+	)
+
+	BeforeEach(func() {
+		ctMap = &lockedMap{Map: mock.NewMockMap(conntrack.MapParams)}
+		mockTime = mocktime.New()
+		live, expired = nil, nil
+
+		client := net.ParseIP("10.0.0.1")
+		svc := net.ParseIP("10.96.0.10")
+		backend := net.ParseIP("10.65.0.2")
+		for i := 0; i < numFlows; i++ {
+			port := uint16(10000 + i)
+			switch i % 3 {
+			case 0:
+				k := conntrack.NewKey(conntrack.ProtoUDP, client, port, svc, 53)
+				Expect(ctMap.Update(k.AsBytes(), udpJustCreated[:])).To(Succeed())
+				live = append(live, k)
+			case 1:
+				k := conntrack.NewKey(conntrack.ProtoUDP, client, port, svc, 53)
+				Expect(ctMap.Update(k.AsBytes(), udpTimedOut[:])).To(Succeed())
+				expired = append(expired, k)
+			case 2:
+				// A NAT pair whose reverse entry has timed out; both must go.
+				fwdKey := conntrack.NewKey(conntrack.ProtoUDP, client, port, svc, 80)
+				revKey := conntrack.NewKey(conntrack.ProtoUDP, client, port, backend, 8080)
+				fwd := conntrack.NewValueNATForward(now-2*time.Minute, now-2*time.Minute, 0, revKey)
+				rev := conntrack.NewValueNATReverse(now-2*time.Minute, now-61*time.Second, 0,
+					conntrack.Leg{}, conntrack.Leg{}, nil, svc, 80)
+				Expect(ctMap.Update(fwdKey.AsBytes(), fwd.AsBytes())).To(Succeed())
+				Expect(ctMap.Update(revKey.AsBytes(), rev.AsBytes())).To(Succeed())
+				expired = append(expired, fwdKey, revKey)
+			}
+		}
+	})
+
+	DescribeTable("scan modes",
+		func(opts ...conntrack.ScannerOpt) {
+			lc := conntrack.NewLivenessScanner(timeouts, false, conntrack.WithTimeShim(mockTime))
+			scanner := conntrack.NewScanner(ctMap, lc)
+			scanner.ConfigureUnlocked(opts...)
+
+			scanner.Scan()
+			// A forward entry that the scan came across before its reverse entry goes in the
+			// next scan.
+			scanner.Scan()
+
+			for _, k := range live {
+				_, err := ctMap.Get(k.AsBytes())
+				Expect(err).NotTo(HaveOccurred(), "Scan() deleted entry unexpectedly")
+			}
+			for _, k := range expired {
+				_, err := ctMap.Get(k.AsBytes())
+				Expect(err).To(HaveOccurred(), "Scan() should have cleaned up entry")
+			}
+		},
+		Entry("serial"),
+		Entry("parallel", conntrack.WithScanWorkers(4)),
+		Entry("parallel with a CPU budget", conntrack.WithScanWorkers(4), conntrack.WithScanCPUBudget(50)),
+		Entry("serial with a CPU budget", conntrack.WithScanCPUBudget(50)),
+	)
+
+	It("should fetch each reverse entry once per scan", func() {
+		ctMap = &lockedMap{Map: mock.NewMockMap(conntrack.MapParams)}
+		client := net.ParseIP("10.0.0.1")
+		svc := net.ParseIP("10.96.0.10")
+		backend := net.ParseIP("10.65.0.2")
+		const numPairs = 100
+		for i := 0; i < numPairs; i++ {
+			port := uint16(10000 + i)
+			fwdKey := conntrack.NewKey(conntrack.ProtoUDP, client, port, svc, 80)
+			revKey := conntrack.NewKey(conntrack.ProtoUDP, client, port, backend, 8080)
+			fwd := conntrack.NewValueNATForward(now-time.Minute, now-time.Second, 0, revKey)
+			rev := conntrack.NewValueNATReverse(now-time.Minute, now-time.Second, conntrack.FlagNATNPFwd,
+				conntrack.Leg{}, conntrack.Leg{}, nil, svc, 80)
+			Expect(ctMap.Update(fwdKey.AsBytes(), fwd.AsBytes())).To(Succeed())
+			Expect(ctMap.Update(revKey.AsBytes(), rev.AsBytes())).To(Succeed())
+		}
+
+		// Both scanners look up the reverse entry of each forward entry.
+		lc := conntrack.NewLivenessScanner(timeouts, false, conntrack.WithTimeShim(mockTime))
+		scanner := conntrack.NewScanner(ctMap, lc, conntrack.NewReplicator(ctMap, 0, nil, nil))
+		ctMap.GetCount = 0
+
+		scanner.Scan()
+
+		Expect(ctMap.GetCount).To(Equal(numPairs))
+		Expect(ctMap.Contents).To(HaveLen(2 * numPairs))
+	})
+})
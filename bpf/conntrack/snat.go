@@ -0,0 +1,36 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package conntrack
+
+import (
+	"github.com/projectcalico/felix/bpf"
+)
+
+// SNATPortMapParams describes the per-CPU cursor from which the programs look for a free source
+// port when they SNAT a NAT-outgoing flow themselves.  The ports in use are the ones that the
+// conntrack entries flagged with FlagSNAT hold, so the map is just a hint.
+// WARNING: must be kept in sync with cali_v4_snat_port in bpf-gpl/snat.h.
+var SNATPortMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_snat_port",
+	Type:       "percpu_array",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 1,
+	Name:       "cali_v4_snat_port",
+}
+
+func SNATPortMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(SNATPortMapParams)
+}
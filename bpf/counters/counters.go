@@ -0,0 +1,466 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package counters
+
+import (
+	"encoding/binary"
+	"fmt"
+	"hash/fnv"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// Counter is an index into the counters array.
+// WARNING: must be kept in sync with enum cali_counter in bpf-gpl/counters.h.
+type Counter int
+
+const (
+	TotalPackets Counter = iota
+	Accepted
+	Dropped
+
+	ReasonUnknown
+	ReasonShort
+	ReasonNotIP
+	ReasonV6Workload
+	ReasonFailsafe
+	ReasonDNT
+	ReasonPreDNAT
+	ReasonPolicy
+	ReasonCT
+	ReasonBypass
+	ReasonCTNAT
+	ReasonCsumFail
+	ReasonEncapFail
+	ReasonDecapFail
+	ReasonICMPDF
+	ReasonIPOptions
+	ReasonIPMalformed
+	ReasonUnauthSource
+	ReasonRTUnknown
+
+	CTHit
+	CTMiss
+	CTNew
+
+	NATFEHit
+	NATFEMiss
+
+	FIBSuccess
+	FIBFallback
+	RedirSuccess
+	RedirFailed
+
+	FIBBlackhole
+	FIBUnreachable
+	FIBProhibit
+	FIBNotFwded
+	FIBFwdDisabled
+	FIBUnsuppLWT
+	FIBNoNeigh
+	FIBFragNeeded
+	FIBBadInput
+	FIBTTLExceeded
+	RedirNeigh
+
+	ICMPRateLimited
+
+	SynCookieSent
+	SynCookieValid
+	SynCookieInvalid
+
+	CPUSteered
+
+	EDTDelayed
+	EDTDropped
+
+	MaxCounter
+)
+
+var counterNames = [MaxCounter]string{
+	TotalPackets: "total packets",
+	Accepted:     "accepted",
+	Dropped:      "dropped",
+
+	ReasonUnknown:      "reason: unknown",
+	ReasonShort:        "reason: short packet",
+	ReasonNotIP:        "reason: not IP",
+	ReasonV6Workload:   "reason: IPv6 workload",
+	ReasonFailsafe:     "reason: failsafe",
+	ReasonDNT:          "reason: do-not-track",
+	ReasonPreDNAT:      "reason: pre-DNAT",
+	ReasonPolicy:       "reason: policy",
+	ReasonCT:           "reason: conntrack",
+	ReasonBypass:       "reason: bypass mark",
+	ReasonCTNAT:        "reason: conntrack NAT",
+	ReasonCsumFail:     "reason: checksum failure",
+	ReasonEncapFail:    "reason: encap failure",
+	ReasonDecapFail:    "reason: decap failure",
+	ReasonICMPDF:       "reason: ICMP DF",
+	ReasonIPOptions:    "reason: IP options",
+	ReasonIPMalformed:  "reason: malformed IP",
+	ReasonUnauthSource: "reason: unauthorised source",
+	ReasonRTUnknown:    "reason: unknown route",
+
+	CTHit:  "conntrack hit",
+	CTMiss: "conntrack mid-flow miss",
+	CTNew:  "conntrack new",
+
+	NATFEHit:  "NAT frontend hit",
+	NATFEMiss: "NAT frontend miss",
+
+	FIBSuccess:   "FIB lookup success",
+	FIBFallback:  "FIB lookup fallback",
+	RedirSuccess: "redirect success",
+	RedirFailed:  "redirect failed",
+
+	FIBBlackhole:   "FIB blackhole",
+	FIBUnreachable: "FIB unreachable",
+	FIBProhibit:    "FIB prohibit",
+	FIBNotFwded:    "FIB not forwarded",
+	FIBFwdDisabled: "FIB forwarding disabled",
+	FIBUnsuppLWT:   "FIB unsupported LWT",
+	FIBNoNeigh:     "FIB no neighbour",
+	FIBFragNeeded:  "FIB fragmentation needed",
+	FIBBadInput:    "FIB lookup error",
+	FIBTTLExceeded: "FIB TTL exceeded",
+	RedirNeigh:     "redirect to next hop",
+
+	ICMPRateLimited: "ICMP reply rate limited",
+
+	SynCookieSent:    "SYN cookie sent",
+	SynCookieValid:   "SYN cookie valid",
+	SynCookieInvalid: "SYN cookie invalid",
+
+	CPUSteered: "steered to another CPU",
+
+	EDTDelayed: "delayed by bandwidth limit",
+	EDTDropped: "dropped by bandwidth limit",
+}
+
+func (c Counter) String() string {
+	if c < 0 || c >= MaxCounter {
+		return fmt.Sprintf("counter(%d)", int(c))
+	}
+	return counterNames[c]
+}
+
+// Hook is the key into the counters map; the programs at each hook keep their own counters.
+// WARNING: must be kept in sync with enum cali_counters_hook in bpf-gpl/counters.h.
+type Hook uint32
+
+const (
+	HookToHost Hook = iota
+	HookFromHost
+	HookXDP
+
+	MaxHook
+)
+
+func (h Hook) String() string {
+	switch h {
+	case HookToHost:
+		return "to host"
+	case HookFromHost:
+		return "from host"
+	case HookXDP:
+		return "XDP"
+	}
+	return fmt.Sprintf("hook(%d)", uint32(h))
+}
+
+const ValueSize = 8 * int(MaxCounter)
+
+var MapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_counters",
+	Type:       "percpu_array",
+	KeySize:    4,
+	ValueSize:  ValueSize,
+	MaxEntries: int(MaxHook),
+	Name:       "cali_counters",
+}
+
+func Map(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MapParams)
+}
+
+// Counters holds the values of all the counters for one hook, summed over all CPUs.
+type Counters [MaxCounter]uint64
+
+// PolicyDropped returns the number of packets that were seen but for which none of the C programs recorded a
+// verdict.  Those are the packets that the policy program dropped (or that failed a tail call).
+func (c *Counters) PolicyDropped() uint64 {
+	done := c[Accepted] + c[Dropped]
+	if done > c[TotalPackets] {
+		// Counters are read CPU-by-CPU, not atomically, so we can see a skew.
+		return 0
+	}
+	return c[TotalPackets] - done
+}
+
+// Read reads the counters for the given hook, summing the per-CPU values.
+func Read(m bpf.Map, hook Hook) (Counters, error) {
+	var k [4]byte
+	binary.LittleEndian.PutUint32(k[:], uint32(hook))
+
+	v, err := m.Get(k[:])
+	if err != nil {
+		return Counters{}, fmt.Errorf("failed to read counters for hook %v: %w", hook, err)
+	}
+
+	return SumPerCPU(v), nil
+}
+
+// SumPerCPU sums the per-CPU values returned by a lookup in the counters map.
+func SumPerCPU(v []byte) Counters {
+	var c Counters
+	for _, cpuVal := range bpf.PerCPUValues(v, ValueSize) {
+		for i := range c {
+			c[i] += binary.LittleEndian.Uint64(cpuVal[i*8 : i*8+8])
+		}
+	}
+	return c
+}
+
+// PolicyLatencyBuckets is the number of buckets of the policy latency histograms; bucket i counts
+// the policy evaluations that took [2^i, 2^(i+1)) ns.
+// WARNING: must be kept in sync with CALI_POL_LAT_BUCKETS in bpf-gpl/pol_lat.h.
+const PolicyLatencyBuckets = 32
+
+// PolicyLatencyMapParams describes the map of policy latency histograms, one per Hook.
+var PolicyLatencyMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_pol_lat",
+	Type:       "percpu_array",
+	KeySize:    4,
+	ValueSize:  8 * PolicyLatencyBuckets,
+	MaxEntries: int(MaxHook),
+	Name:       "cali_pol_lat",
+}
+
+func PolicyLatencyMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(PolicyLatencyMapParams)
+}
+
+// Latency is a log2 latency histogram, summed over all CPUs; bucket i counts the events that took
+// [2^i, 2^(i+1)) ns.
+type Latency [PolicyLatencyBuckets]uint64
+
+// ReadPolicyLatency reads the policy latency histogram for the given hook.
+func ReadPolicyLatency(m bpf.Map, hook Hook) (Latency, error) {
+	l, err := readLatency(m, uint32(hook))
+	if err != nil {
+		return Latency{}, fmt.Errorf("failed to read policy latency for hook %v: %w", hook, err)
+	}
+	return l, nil
+}
+
+func readLatency(m bpf.Map, key uint32) (Latency, error) {
+	var k [4]byte
+	binary.LittleEndian.PutUint32(k[:], key)
+
+	v, err := m.Get(k[:])
+	if err != nil {
+		return Latency{}, err
+	}
+
+	var l Latency
+	for _, cpuVal := range bpf.PerCPUValues(v, 8*PolicyLatencyBuckets) {
+		for i := range l {
+			l[i] += binary.LittleEndian.Uint64(cpuVal[i*8 : i*8+8])
+		}
+	}
+	return l, nil
+}
+
+// ProgLatencyHook is the hook that a TC program is attached to, as far as the program latency
+// histograms are concerned.
+// WARNING: must be kept in sync with enum cali_prog_lat_hook in bpf-gpl/prog_lat.h.
+type ProgLatencyHook uint32
+
+const (
+	ProgLatencyFromHEP ProgLatencyHook = iota
+	ProgLatencyToHEP
+	ProgLatencyFromWEP
+	ProgLatencyToWEP
+	ProgLatencyFromTunnel
+	ProgLatencyToTunnel
+	ProgLatencyFromWireguard
+	ProgLatencyToWireguard
+
+	MaxProgLatencyHook
+)
+
+func (h ProgLatencyHook) String() string {
+	switch h {
+	case ProgLatencyFromHEP:
+		return "from-hep"
+	case ProgLatencyToHEP:
+		return "to-hep"
+	case ProgLatencyFromWEP:
+		return "from-wep"
+	case ProgLatencyToWEP:
+		return "to-wep"
+	case ProgLatencyFromTunnel:
+		return "from-tunnel"
+	case ProgLatencyToTunnel:
+		return "to-tunnel"
+	case ProgLatencyFromWireguard:
+		return "from-wireguard"
+	case ProgLatencyToWireguard:
+		return "to-wireguard"
+	}
+	return fmt.Sprintf("hook-%d", uint32(h))
+}
+
+// ProgLatencyPath is the path that a packet took through the TC programs.
+// WARNING: must be kept in sync with enum cali_prog_lat_path in bpf-gpl/prog_lat.h.
+type ProgLatencyPath uint32
+
+const (
+	// ProgLatencyFast is a packet of a known flow that isn't NATted.
+	ProgLatencyFast ProgLatencyPath = iota
+	// ProgLatencyNew is a packet that started a flow and went through policy.
+	ProgLatencyNew
+	// ProgLatencyNAT is a packet of a NATted flow, known or new.
+	ProgLatencyNAT
+
+	MaxProgLatencyPath
+)
+
+func (p ProgLatencyPath) String() string {
+	switch p {
+	case ProgLatencyFast:
+		return "fast"
+	case ProgLatencyNew:
+		return "new"
+	case ProgLatencyNAT:
+		return "nat"
+	}
+	return fmt.Sprintf("path-%d", uint32(p))
+}
+
+// ProgLatencyMapParams describes the map of the latency histograms of the TC programs, which
+// they keep if bpf.Binary.PatchProgLatency is set.
+var ProgLatencyMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_prog_lat",
+	Type:       "percpu_array",
+	KeySize:    4,
+	ValueSize:  8 * PolicyLatencyBuckets,
+	MaxEntries: int(MaxProgLatencyHook * MaxProgLatencyPath),
+	Name:       "cali_prog_lat",
+}
+
+func ProgLatencyMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(ProgLatencyMapParams)
+}
+
+// ReadProgLatency reads the latency histogram of the TC programs at the given hook for the packets
+// that took the given path.
+func ReadProgLatency(m bpf.Map, hook ProgLatencyHook, path ProgLatencyPath) (Latency, error) {
+	l, err := readLatency(m, uint32(hook*MaxProgLatencyPath)+uint32(path))
+	if err != nil {
+		return Latency{}, fmt.Errorf("failed to read program latency for %v/%v: %w", hook, path, err)
+	}
+	return l, nil
+}
+
+// RuleMapParams describes the map of the per-rule hit counters that the policy programs keep if
+// polprog.Builder.EnableRuleCounters is set, keyed by RuleCounterKey.  It is an LRU map so that the
+// counters of the rules that no longer exist age out.
+var RuleMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_rule_ctrs",
+	Type:       "lru_percpu_hash",
+	KeySize:    8,
+	ValueSize:  8,
+	MaxEntries: 64 * 1024,
+	Name:       "cali_rule_ctrs",
+}
+
+func RuleMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(RuleMapParams)
+}
+
+// RuleCounterKey returns the key of the hit counter of the given rule of the given policy.
+func RuleCounterKey(policy, ruleID string) uint64 {
+	h := fnv.New64a()
+	_, _ = h.Write([]byte(policy))
+	_, _ = h.Write([]byte{0})
+	_, _ = h.Write([]byte(ruleID))
+	return h.Sum64()
+}
+
+// ReadRuleCounter reads the hit counter with the given key, summing the per-CPU values.  The
+// counter doesn't exist until the rule first matches.
+func ReadRuleCounter(m bpf.Map, key uint64) (uint64, error) {
+	var k [8]byte
+	binary.LittleEndian.PutUint64(k[:], key)
+
+	v, err := m.Get(k[:])
+	if err != nil {
+		return 0, err
+	}
+
+	var n uint64
+	for _, cpuVal := range bpf.PerCPUValues(v, RuleMapParams.ValueSize) {
+		n += binary.LittleEndian.Uint64(cpuVal)
+	}
+	return n, nil
+}
+
+// MapStatsMap identifies a map whose failed updates the programs count.
+// WARNING: must be kept in sync with enum cali_map_stats_map in bpf-gpl/map_stats.h.
+type MapStatsMap uint32
+
+const (
+	MapStatsCT MapStatsMap = iota
+	MapStatsNATAffinity
+	MapStatsARP
+	MapStatsCTNATs
+	MapStatsSendRecvMsg
+	MapStatsFrags
+
+	MaxMapStatsMap
+)
+
+// MapErrorsMapParams describes the map of the failed updates, per MapStatsMap.
+var MapErrorsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_map_errs",
+	Type:       "percpu_array",
+	KeySize:    4,
+	ValueSize:  8,
+	MaxEntries: int(MaxMapStatsMap),
+	Name:       "cali_map_errs",
+}
+
+func MapErrorsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MapErrorsMapParams)
+}
+
+// ReadMapErrors reads the number of failed updates of the given map, summing the per-CPU values.
+func ReadMapErrors(m bpf.Map, id MapStatsMap) (uint64, error) {
+	var k [4]byte
+	binary.LittleEndian.PutUint32(k[:], uint32(id))
+
+	v, err := m.Get(k[:])
+	if err != nil {
+		return 0, fmt.Errorf("failed to read the failed updates of map %d: %w", uint32(id), err)
+	}
+
+	var n uint64
+	for _, cpuVal := range bpf.PerCPUValues(v, MapErrorsMapParams.ValueSize) {
+		n += binary.LittleEndian.Uint64(cpuVal)
+	}
+	return n, nil
+}
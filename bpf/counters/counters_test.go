@@ -0,0 +1,154 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package counters
+
+import (
+	"encoding/binary"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+func TestCountersSumPerCPU(t *testing.T) {
+	RegisterTestingT(t)
+
+	const numCPUs = 3
+	v := make([]byte, ValueSize*numCPUs)
+	for cpu := 0; cpu < numCPUs; cpu++ {
+		off := cpu * ValueSize
+		binary.LittleEndian.PutUint64(v[off+int(TotalPackets)*8:], 10)
+		binary.LittleEndian.PutUint64(v[off+int(Accepted)*8:], 7)
+		binary.LittleEndian.PutUint64(v[off+int(Dropped)*8:], 2)
+		binary.LittleEndian.PutUint64(v[off+int(RedirFailed)*8:], uint64(cpu))
+	}
+
+	c := SumPerCPU(v)
+	Expect(c[TotalPackets]).To(Equal(uint64(30)))
+	Expect(c[Accepted]).To(Equal(uint64(21)))
+	Expect(c[Dropped]).To(Equal(uint64(6)))
+	Expect(c[RedirFailed]).To(Equal(uint64(3)))
+	Expect(c.PolicyDropped()).To(Equal(uint64(3)))
+}
+
+func TestCountersRead(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(MapParams)
+	v := make([]byte, ValueSize)
+	binary.LittleEndian.PutUint64(v[int(CTHit)*8:], 42)
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(HookFromHost))
+	Expect(m.Update(k, v)).To(Succeed())
+
+	c, err := Read(m, HookFromHost)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(c[CTHit]).To(Equal(uint64(42)))
+
+	_, err = Read(m, HookToHost)
+	Expect(err).To(HaveOccurred())
+}
+
+func TestReadPolicyLatency(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(PolicyLatencyMapParams)
+	// Two CPUs.
+	v := make([]byte, 2*PolicyLatencyMapParams.ValueSize)
+	binary.LittleEndian.PutUint64(v[10*8:], 5)
+	binary.LittleEndian.PutUint64(v[PolicyLatencyMapParams.ValueSize+10*8:], 2)
+	binary.LittleEndian.PutUint64(v[PolicyLatencyMapParams.ValueSize+12*8:], 1)
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(HookToHost))
+	// Per-CPU values are larger than the map's value size so bypass Update.
+	m.Contents[string(k)] = string(v)
+
+	l, err := ReadPolicyLatency(m, HookToHost)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(l[10]).To(Equal(uint64(7)))
+	Expect(l[12]).To(Equal(uint64(1)))
+	Expect(l[11]).To(BeZero())
+}
+
+func TestReadProgLatency(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(ProgLatencyMapParams)
+	v := make([]byte, ProgLatencyMapParams.ValueSize)
+	binary.LittleEndian.PutUint64(v[8*8:], 3)
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(ProgLatencyToWEP)*uint32(MaxProgLatencyPath)+uint32(ProgLatencyNAT))
+	m.Contents[string(k)] = string(v)
+
+	l, err := ReadProgLatency(m, ProgLatencyToWEP, ProgLatencyNAT)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(l[8]).To(Equal(uint64(3)))
+
+	_, err = ReadProgLatency(m, ProgLatencyToWEP, ProgLatencyNew)
+	Expect(err).To(HaveOccurred())
+}
+
+func TestRuleCounters(t *testing.T) {
+	RegisterTestingT(t)
+
+	key := RuleCounterKey("default.allow-dns", "abc")
+	Expect(RuleCounterKey("default.allow-dns", "abc")).To(Equal(key))
+	Expect(RuleCounterKey("default.allow-dn", "sabc")).NotTo(Equal(key))
+
+	m := mock.NewMockMap(RuleMapParams)
+	k := make([]byte, 8)
+	binary.LittleEndian.PutUint64(k, key)
+	v := make([]byte, 3*8)
+	for cpu := 0; cpu < 3; cpu++ {
+		binary.LittleEndian.PutUint64(v[cpu*8:], uint64(cpu+1))
+	}
+	m.Contents[string(k)] = string(v)
+
+	n, err := ReadRuleCounter(m, key)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(n).To(Equal(uint64(6)))
+
+	_, err = ReadRuleCounter(m, key+1)
+	Expect(err).To(HaveOccurred())
+}
+
+func TestCounterNames(t *testing.T) {
+	RegisterTestingT(t)
+
+	for c := Counter(0); c < MaxCounter; c++ {
+		Expect(c.String()).NotTo(BeEmpty(), "Counter %d has no name", int(c))
+	}
+}
+
+func TestReadMapErrors(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(MapErrorsMapParams)
+	// Two CPUs.
+	v := make([]byte, 2*MapErrorsMapParams.ValueSize)
+	binary.LittleEndian.PutUint64(v[0:], 3)
+	binary.LittleEndian.PutUint64(v[8:], 4)
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(MapStatsCTNATs))
+	m.Contents[string(k)] = string(v)
+
+	n, err := ReadMapErrors(m, MapStatsCTNATs)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(n).To(Equal(uint64(7)))
+
+	_, err = ReadMapErrors(m, MapStatsCT)
+	Expect(err).To(HaveOccurred())
+}
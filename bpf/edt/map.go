@@ -0,0 +1,82 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package edt
+
+import (
+	"encoding/binary"
+	"fmt"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// MapParams are the parameters of the map of the egress rates of the workloads, keyed on the
+// ifindex of their veths.  The host endpoint programs give the packets of these workloads their
+// earliest departure time, see tc.AttachPoint.EDT.
+// WARNING: must be kept in sync with struct cali_edt_val in bpf-gpl/edt.h.
+var MapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_edt",
+	Type:       "hash",
+	KeySize:    KeySize,
+	ValueSize:  ValueSize,
+	MaxEntries: 16 * 1024,
+	Name:       "cali_v4_edt",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func Map(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MapParams)
+}
+
+const KeySize = 4
+
+type Key [KeySize]byte
+
+func NewKey(ifIndex int) Key {
+	var k Key
+	binary.LittleEndian.PutUint32(k[:], uint32(ifIndex))
+	return k
+}
+
+func (k Key) IfIndex() int {
+	return int(binary.LittleEndian.Uint32(k[:]))
+}
+
+const ValueSize = 16
+
+type Value [ValueSize]byte
+
+// NewValue returns the entry of a workload whose egress is limited to bitsPerSec.  The departure
+// time of the last packet starts at zero, the programs keep it up to date.
+func NewValue(bitsPerSec uint64) Value {
+	var v Value
+	binary.LittleEndian.PutUint64(v[0:8], bitsPerSec/8)
+	return v
+}
+
+// Rate returns the limit in bytes per second.
+func (v Value) Rate() uint64 {
+	return binary.LittleEndian.Uint64(v[0:8])
+}
+
+// LastDeparture returns the departure time of the last packet, in monotonic nanoseconds.
+func (v Value) LastDeparture() uint64 {
+	return binary.LittleEndian.Uint64(v[8:16])
+}
+
+func (v Value) String() string {
+	return fmt.Sprintf("edt{rate: %dB/s, lastDeparture: %d}", v.Rate(), v.LastDeparture())
+}
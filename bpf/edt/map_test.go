@@ -0,0 +1,36 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package edt
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestValue(t *testing.T) {
+	RegisterTestingT(t)
+
+	v := NewValue(10 * 1000 * 1000)
+	Expect(v.Rate()).To(Equal(uint64(1250 * 1000)))
+	Expect(v.LastDeparture()).To(BeZero())
+	Expect(v[0:8]).To(Equal([]byte{0xd0, 0x12, 0x13, 0, 0, 0, 0, 0}))
+}
+
+func TestKey(t *testing.T) {
+	RegisterTestingT(t)
+	Expect(NewKey(258)).To(Equal(Key{2, 1, 0, 0}))
+	Expect(NewKey(258).IfIndex()).To(Equal(258))
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package events
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io"
+	"net"
+	"time"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// CaptureSnapLen is the number of bytes of each packet that the programs capture.
+// WARNING: must be kept in sync with CALI_CAPTURE_SNAPLEN in bpf-gpl/events.h.
+const CaptureSnapLen = 128
+
+// PacketEventHdrSize is the size of struct cali_event_packet without the packet data.
+const PacketEventHdrSize = 24
+
+// PacketEvent is a captured packet along with the verdict of the program that captured it.
+// WARNING: must be kept in sync with struct cali_event_packet in bpf-gpl/events.h.
+type PacketEvent struct {
+	IfIndex uint32
+	// Len is the length of the whole packet; Data only holds its first CaptureSnapLen bytes.
+	Len      uint32
+	Dropped  bool
+	ToHost   bool
+	Reason   uint16
+	CTResult int16
+	Data     []byte
+}
+
+func (e PacketEvent) String() string {
+	verdict := "allow"
+	if e.Dropped {
+		verdict = "drop"
+	}
+	dir := "from-host"
+	if e.ToHost {
+		dir = "to-host"
+	}
+	return fmt.Sprintf("if=%d %s len=%d ct=0x%x reason=0x%x %s",
+		e.IfIndex, dir, e.Len, uint16(e.CTResult), e.Reason, verdict)
+}
+
+// EventType returns the type of a raw event record.
+func EventType(raw []byte) (Type, error) {
+	if len(raw) < 4 {
+		return 0, fmt.Errorf("event too short: %d bytes", len(raw))
+	}
+	return Type(binary.LittleEndian.Uint32(raw[0:4])), nil
+}
+
+// ParsePacketEvent decodes a raw packet event record.  The returned event's Data refers to the
+// record.
+func ParsePacketEvent(raw []byte) (PacketEvent, error) {
+	if len(raw) < PacketEventHdrSize {
+		return PacketEvent{}, fmt.Errorf("packet event too short: %d bytes", len(raw))
+	}
+	if t := Type(binary.LittleEndian.Uint32(raw[0:4])); t != TypePacket {
+		return PacketEvent{}, fmt.Errorf("unexpected event type %d", t)
+	}
+	capLen := int(binary.LittleEndian.Uint16(raw[12:14]))
+	if capLen > CaptureSnapLen || PacketEventHdrSize+capLen > len(raw) {
+		return PacketEvent{}, fmt.Errorf("bad captured length %d", capLen)
+	}
+
+	return PacketEvent{
+		IfIndex:  binary.LittleEndian.Uint32(raw[4:8]),
+		Len:      binary.LittleEndian.Uint32(raw[8:12]),
+		Dropped:  raw[14] != 0,
+		ToHost:   raw[15] == 0,
+		Reason:   binary.LittleEndian.Uint16(raw[16:18]),
+		CTResult: int16(binary.LittleEndian.Uint16(raw[18:20])),
+		Data:     raw[PacketEventHdrSize : PacketEventHdrSize+capLen],
+	}, nil
+}
+
+// CaptureVerdict selects the packets to capture by their verdict.
+// WARNING: must be kept in sync with enum cali_capture_verdict in bpf-gpl/events.h.
+type CaptureVerdict uint8
+
+const (
+	CaptureAny CaptureVerdict = iota
+	CaptureDropped
+	CaptureAllowed
+)
+
+const captureFlagEnabled = 1
+
+// CaptureFilterMapParams describes the capture filter, a single entry that selects the packets that
+// the "ev" programs capture into the events ring buffer.
+// WARNING: must be kept in sync with cali_capture in bpf-gpl/events.h.
+var CaptureFilterMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_capture",
+	Type:       "array",
+	KeySize:    4,
+	ValueSize:  CaptureFilterSize,
+	MaxEntries: 1,
+	Name:       "cali_capture",
+}
+
+func CaptureFilterMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(CaptureFilterMapParams)
+}
+
+// CaptureFilterSize is the size of struct cali_capture_filter.
+const CaptureFilterSize = 24
+
+// CaptureFilter selects the packets to capture; the zero value of each field matches any packet.
+// WARNING: must be kept in sync with struct cali_capture_filter in bpf-gpl/events.h.
+type CaptureFilter struct {
+	IfIndex uint32
+	SrcAddr net.IP
+	DstAddr net.IP
+	SrcPort uint16
+	DstPort uint16
+	Proto   uint8
+	Verdict CaptureVerdict
+	Reason  uint16
+}
+
+// CaptureFilterKey is the key of the only entry of the capture filter map.
+var CaptureFilterKey = make([]byte, 4)
+
+// AsBytes encodes the filter as the enabled map value.
+func (f CaptureFilter) AsBytes() []byte {
+	b := make([]byte, CaptureFilterSize)
+	binary.LittleEndian.PutUint32(b[0:4], captureFlagEnabled)
+	binary.LittleEndian.PutUint32(b[4:8], f.IfIndex)
+	if ip := f.SrcAddr.To4(); ip != nil {
+		copy(b[8:12], ip)
+	}
+	if ip := f.DstAddr.To4(); ip != nil {
+		copy(b[12:16], ip)
+	}
+	binary.LittleEndian.PutUint16(b[16:18], f.SrcPort)
+	binary.LittleEndian.PutUint16(b[18:20], f.DstPort)
+	b[20] = f.Proto
+	b[21] = uint8(f.Verdict)
+	binary.LittleEndian.PutUint16(b[22:24], f.Reason)
+	return b
+}
+
+// CaptureDisabled is the map value that captures no packets.
+var CaptureDisabled = make([]byte, CaptureFilterSize)
+
+const (
+	pcapMagic        = 0xa1b2c3d4
+	pcapLinkEthernet = 1
+)
+
+// PcapWriter writes captured packets in the libpcap file format, which tcpdump and wireshark read.
+type PcapWriter struct {
+	w io.Writer
+}
+
+// NewPcapWriter writes the file header and returns a PcapWriter for the packets.
+func NewPcapWriter(w io.Writer) (*PcapWriter, error) {
+	hdr := make([]byte, 24)
+	binary.LittleEndian.PutUint32(hdr[0:4], pcapMagic)
+	binary.LittleEndian.PutUint16(hdr[4:6], 2)
+	binary.LittleEndian.PutUint16(hdr[6:8], 4)
+	binary.LittleEndian.PutUint32(hdr[16:20], CaptureSnapLen)
+	binary.LittleEndian.PutUint32(hdr[20:24], pcapLinkEthernet)
+	if _, err := w.Write(hdr); err != nil {
+		return nil, err
+	}
+	return &PcapWriter{w: w}, nil
+}
+
+// WritePacket writes a packet record.
+func (p *PcapWriter) WritePacket(t time.Time, e PacketEvent) error {
+	hdr := make([]byte, 16)
+	binary.LittleEndian.PutUint32(hdr[0:4], uint32(t.Unix()))
+	binary.LittleEndian.PutUint32(hdr[4:8], uint32(t.Nanosecond()/1000))
+	binary.LittleEndian.PutUint32(hdr[8:12], uint32(len(e.Data)))
+	binary.LittleEndian.PutUint32(hdr[12:16], e.Len)
+	if _, err := p.w.Write(hdr); err != nil {
+		return err
+	}
+	_, err := p.w.Write(e.Data)
+	return err
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package events
+
+import (
+	"bytes"
+	"net"
+	"testing"
+	"time"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestParsePacketEvent(t *testing.T) {
+	RegisterTestingT(t)
+
+	raw := []byte{
+		2, 0, 0, 0, // type
+		5, 0, 0, 0, // ifindex
+		0xdc, 0x05, 0, 0, // len 1500
+		4, 0, // cap len
+		1,          // dropped
+		1,          // hook, from host
+		0xbe, 0x00, // reason
+		0x02, 0x01, // ct rc
+		0, 0, 0, 0, // pad
+		0xde, 0xad, 0xbe, 0xef, // data
+	}
+
+	typ, err := EventType(raw)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(typ).To(Equal(TypePacket))
+
+	ev, err := ParsePacketEvent(raw)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(ev.IfIndex).To(Equal(uint32(5)))
+	Expect(ev.Len).To(Equal(uint32(1500)))
+	Expect(ev.Dropped).To(BeTrue())
+	Expect(ev.ToHost).To(BeFalse())
+	Expect(ev.Reason).To(Equal(uint16(0xbe)))
+	Expect(ev.CTResult).To(Equal(int16(0x102)))
+	Expect(ev.Data).To(Equal([]byte{0xde, 0xad, 0xbe, 0xef}))
+
+	_, err = ParsePacketEvent(raw[:26])
+	Expect(err).To(HaveOccurred())
+
+	raw[0] = 1
+	_, err = ParsePacketEvent(raw)
+	Expect(err).To(HaveOccurred())
+}
+
+func TestCaptureFilterAsBytes(t *testing.T) {
+	RegisterTestingT(t)
+
+	f := CaptureFilter{
+		IfIndex: 3,
+		SrcAddr: net.ParseIP("10.0.0.1"),
+		DstPort: 80,
+		Proto:   6,
+		Verdict: CaptureDropped,
+		Reason:  0xbe,
+	}
+	Expect(f.AsBytes()).To(Equal([]byte{
+		1, 0, 0, 0, // flags
+		3, 0, 0, 0, // ifindex
+		10, 0, 0, 1, // src
+		0, 0, 0, 0, // dst
+		0, 0, // sport
+		80, 0, // dport
+		6,          // proto
+		1,          // verdict
+		0xbe, 0x00, // reason
+	}))
+}
+
+func TestPcapWriter(t *testing.T) {
+	RegisterTestingT(t)
+
+	var buf bytes.Buffer
+	w, err := NewPcapWriter(&buf)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(buf.Len()).To(Equal(24))
+	Expect(buf.Bytes()[0:4]).To(Equal([]byte{0xd4, 0xc3, 0xb2, 0xa1}))
+
+	err = w.WritePacket(time.Unix(10, 2000), PacketEvent{Len: 1500, Data: []byte{1, 2, 3}})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(buf.Bytes()[24:]).To(Equal([]byte{
+		10, 0, 0, 0,
+		2, 0, 0, 0,
+		3, 0, 0, 0,
+		0xdc, 0x05, 0, 0,
+		1, 2, 3,
+	}))
+}
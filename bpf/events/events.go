@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package events
+
+import (
+	"encoding/binary"
+	"fmt"
+	"net"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// Type is the type of an event record.
+// WARNING: must be kept in sync with enum cali_event_type in bpf-gpl/events.h.
+type Type uint32
+
+const (
+	TypeFlow   Type = 1
+	TypePacket Type = 2
+)
+
+// RingBufSize is the size of the data area of the events ring buffer in bytes.
+// WARNING: must be kept in sync with the definition of cali_events in bpf-gpl/events.h.
+const RingBufSize = 256 * 1024
+
+var MapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_events",
+	Type:       "ringbuf",
+	MaxEntries: RingBufSize,
+	Name:       "cali_events",
+}
+
+func Map(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MapParams)
+}
+
+// FlowEventSize is the size of struct cali_event_flow.
+const FlowEventSize = 32
+
+// FlowEvent is a sampled packet verdict.
+// WARNING: must be kept in sync with struct cali_event_flow in bpf-gpl/events.h.
+type FlowEvent struct {
+	IfIndex  uint32
+	SrcAddr  net.IP
+	DstAddr  net.IP
+	SrcPort  uint16
+	DstPort  uint16
+	Proto    uint8
+	Dropped  bool
+	Reason   uint16
+	CTResult int16
+	NATAddr  net.IP
+	NATPort  uint16
+}
+
+func (e FlowEvent) String() string {
+	verdict := "allow"
+	if e.Dropped {
+		verdict = "drop"
+	}
+	nat := ""
+	if !e.NATAddr.Equal(net.IPv4zero) {
+		nat = fmt.Sprintf(" nat=%s:%d", e.NATAddr, e.NATPort)
+	}
+	return fmt.Sprintf("if=%d proto=%d %s:%d -> %s:%d%s ct=0x%x reason=0x%x %s",
+		e.IfIndex, e.Proto, e.SrcAddr, e.SrcPort, e.DstAddr, e.DstPort, nat,
+		uint16(e.CTResult), e.Reason, verdict)
+}
+
+// ParseFlowEvent decodes a raw flow event record.
+func ParseFlowEvent(raw []byte) (FlowEvent, error) {
+	if len(raw) < FlowEventSize {
+		return FlowEvent{}, fmt.Errorf("flow event too short: %d bytes", len(raw))
+	}
+	if t := Type(binary.LittleEndian.Uint32(raw[0:4])); t != TypeFlow {
+		return FlowEvent{}, fmt.Errorf("unexpected event type %d", t)
+	}
+
+	return FlowEvent{
+		IfIndex:  binary.LittleEndian.Uint32(raw[4:8]),
+		SrcAddr:  net.IPv4(raw[8], raw[9], raw[10], raw[11]),
+		DstAddr:  net.IPv4(raw[12], raw[13], raw[14], raw[15]),
+		SrcPort:  binary.LittleEndian.Uint16(raw[16:18]),
+		DstPort:  binary.LittleEndian.Uint16(raw[18:20]),
+		Proto:    raw[20],
+		Dropped:  raw[21] != 0,
+		Reason:   binary.LittleEndian.Uint16(raw[22:24]),
+		CTResult: int16(binary.LittleEndian.Uint16(raw[24:26])),
+		NATPort:  binary.LittleEndian.Uint16(raw[26:28]),
+		NATAddr:  net.IPv4(raw[28], raw[29], raw[30], raw[31]),
+	}, nil
+}
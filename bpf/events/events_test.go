@@ -0,0 +1,62 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package events
+
+import (
+	"net"
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestParseFlowEvent(t *testing.T) {
+	RegisterTestingT(t)
+
+	raw := []byte{
+		1, 0, 0, 0, // type
+		5, 0, 0, 0, // ifindex
+		10, 0, 0, 1, // src
+		10, 0, 0, 2, // dst
+		0x39, 0x30, // sport 12345
+		0x50, 0x00, // dport 80
+		6,          // proto
+		1,          // dropped
+		0xbe, 0x00, // reason
+		0x02, 0x01, // ct rc
+		0x90, 0x1f, // nat port 8080
+		192, 168, 0, 1, // nat addr
+	}
+
+	ev, err := ParseFlowEvent(raw)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(ev.IfIndex).To(Equal(uint32(5)))
+	Expect(ev.SrcAddr.Equal(net.ParseIP("10.0.0.1"))).To(BeTrue())
+	Expect(ev.DstAddr.Equal(net.ParseIP("10.0.0.2"))).To(BeTrue())
+	Expect(ev.SrcPort).To(Equal(uint16(12345)))
+	Expect(ev.DstPort).To(Equal(uint16(80)))
+	Expect(ev.Proto).To(Equal(uint8(6)))
+	Expect(ev.Dropped).To(BeTrue())
+	Expect(ev.Reason).To(Equal(uint16(0xbe)))
+	Expect(ev.CTResult).To(Equal(int16(0x102)))
+	Expect(ev.NATPort).To(Equal(uint16(8080)))
+	Expect(ev.NATAddr.Equal(net.ParseIP("192.168.0.1"))).To(BeTrue())
+
+	_, err = ParseFlowEvent(raw[:10])
+	Expect(err).To(HaveOccurred())
+
+	raw[0] = 7
+	_, err = ParseFlowEvent(raw)
+	Expect(err).To(HaveOccurred())
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package events
+
+import (
+	"fmt"
+	"os"
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// Ring buffer record header flags, see BPF_RINGBUF_BUSY_BIT and BPF_RINGBUF_DISCARD_BIT in linux/bpf.h.
+const (
+	ringBufBusyBit    = 1 << 31
+	ringBufDiscardBit = 1 << 30
+	ringBufHdrSize    = 8
+)
+
+// RingBuf is a consumer for a BPF_MAP_TYPE_RINGBUF map.  It maps the ring buffer's consumer position page
+// read-write and the producer position page, followed by the data area, read-only.  The kernel maps the data
+// area twice back-to-back so that a record that wraps around the end can be read as a single slice.
+type RingBuf struct {
+	fd       bpf.MapFD
+	mask     uint64
+	consumer []byte
+	producer []byte
+	data     []byte
+}
+
+// OpenRingBuf opens and maps the pinned ring buffer.
+func OpenRingBuf(m bpf.Map) (*RingBuf, error) {
+	if err := m.Open(); err != nil {
+		return nil, fmt.Errorf("failed to open ring buffer map: %w", err)
+	}
+	return NewRingBuf(m.MapFD(), RingBufSize)
+}
+
+// NewRingBuf maps the ring buffer with the given FD and data area size, which must match the map's max_entries.
+func NewRingBuf(fd bpf.MapFD, size int) (*RingBuf, error) {
+	pageSize := os.Getpagesize()
+
+	consumer, err := unix.Mmap(int(fd), 0, pageSize, unix.PROT_READ|unix.PROT_WRITE, unix.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("failed to mmap ring buffer consumer page: %w", err)
+	}
+	producer, err := unix.Mmap(int(fd), int64(pageSize), pageSize+2*size, unix.PROT_READ, unix.MAP_SHARED)
+	if err != nil {
+		_ = unix.Munmap(consumer)
+		return nil, fmt.Errorf("failed to mmap ring buffer data: %w", err)
+	}
+
+	return &RingBuf{
+		fd:       fd,
+		mask:     uint64(size - 1),
+		consumer: consumer,
+		producer: producer,
+		data:     producer[pageSize:],
+	}, nil
+}
+
+func (r *RingBuf) consumerPos() *uint64 {
+	return (*uint64)(unsafe.Pointer(&r.consumer[0]))
+}
+
+func (r *RingBuf) producerPos() *uint64 {
+	return (*uint64)(unsafe.Pointer(&r.producer[0]))
+}
+
+// Poll consumes all the records that are currently available, passing each one to f.  The record slice is only
+// valid for the duration of the callback.  Returns the number of records consumed.
+func (r *RingBuf) Poll(f func(record []byte)) int {
+	n := 0
+	cons := atomic.LoadUint64(r.consumerPos())
+	for {
+		prod := atomic.LoadUint64(r.producerPos())
+		if cons >= prod {
+			return n
+		}
+
+		hdr := atomic.LoadUint32((*uint32)(unsafe.Pointer(&r.data[cons&r.mask])))
+		if hdr&ringBufBusyBit != 0 {
+			// Producer hasn't committed this record yet.
+			return n
+		}
+		length := uint64(hdr &^ (ringBufBusyBit | ringBufDiscardBit))
+		start := (cons & r.mask) + ringBufHdrSize
+
+		if hdr&ringBufDiscardBit == 0 {
+			f(r.data[start : start+length])
+			n++
+		}
+
+		cons += (length + ringBufHdrSize + 7) &^ 7
+		atomic.StoreUint64(r.consumerPos(), cons)
+	}
+}
+
+// Wait blocks until the kernel signals that there is data available or the timeout expires.
+func (r *RingBuf) Wait(timeout time.Duration) error {
+	fds := []unix.PollFd{{Fd: int32(r.fd), Events: unix.POLLIN}}
+	_, err := unix.Poll(fds, int(timeout/time.Millisecond))
+	if err == unix.EINTR {
+		return nil
+	}
+	return err
+}
+
+func (r *RingBuf) Close() error {
+	err := unix.Munmap(r.consumer)
+	if err2 := unix.Munmap(r.producer); err == nil {
+		err = err2
+	}
+	r.consumer, r.producer, r.data = nil, nil, nil
+	return err
+}
@@ -33,6 +33,8 @@ type failsafeTest struct {
 	InitialMapContents  map[string]string
 	In, Out             []config.ProtoPort
 	ExpectedMapContents map[string]string
+	// ExpectedPortsMapContents, if set, is checked against the ports map.
+	ExpectedPortsMapContents map[string]string
 }
 
 func (f *failsafeTest) Run(t *testing.T) {
@@ -42,17 +44,24 @@ func (f *failsafeTest) Run(t *testing.T) {
 		mockMap.Contents = f.InitialMapContents
 	}
 
+	mockPortsMap := mock.NewMockMap(PortsMapParams)
+
 	opReporter := logutils.NewSummarizer("test")
-	mgr := NewManager(mockMap, f.In, f.Out, opReporter)
+	mgr := NewManager(mockMap, mockPortsMap, f.In, f.Out, opReporter)
 
 	err := mgr.CompleteDeferredWork()
 	Expect(err).NotTo(HaveOccurred())
 	Expect(mockMap.Contents).To(Equal(f.ExpectedMapContents))
+	if f.ExpectedPortsMapContents != nil {
+		Expect(mockPortsMap.Contents).To(Equal(f.ExpectedPortsMapContents))
+	}
 
 	opCount := mockMap.OpCount()
+	portsOpCount := mockPortsMap.OpCount()
 	err = mgr.CompleteDeferredWork()
 	Expect(err).NotTo(HaveOccurred())
 	Expect(mockMap.OpCount()).To(Equal(opCount), "failsafes manager should only execute if not in sync")
+	Expect(mockPortsMap.OpCount()).To(Equal(portsOpCount), "failsafes manager should only execute if not in sync")
 }
 
 var tests = []failsafeTest{
@@ -101,6 +110,28 @@ var tests = []failsafeTest{
 			string(Key{Port: 53, IPProto: 17, Flags: FlagOutbound, IP: "0.0.0.0", IPMask: 0}.ToSlice()): zeroValue,
 		},
 	},
+	{
+		Name: "ShouldIndexPortsByScope",
+		In: []config.ProtoPort{
+			{Protocol: "tcp", Port: 22, Net: "0.0.0.0/0"},
+			{Protocol: "tcp", Port: 22, Net: "10.0.0.0/8"},
+			{Protocol: "tcp", Port: 179, Net: "10.0.0.0/8"},
+		},
+		Out: []config.ProtoPort{
+			{Protocol: "tcp", Port: 179, Net: "0.0.0.0/0"},
+		},
+		ExpectedMapContents: map[string]string{
+			string(Key{Port: 22, IPProto: 6, IP: "0.0.0.0", IPMask: 0}.ToSlice()):                       zeroValue,
+			string(Key{Port: 22, IPProto: 6, IP: "10.0.0.0", IPMask: 8}.ToSlice()):                      zeroValue,
+			string(Key{Port: 179, IPProto: 6, IP: "10.0.0.0", IPMask: 8}.ToSlice()):                     zeroValue,
+			string(Key{Port: 179, IPProto: 6, Flags: FlagOutbound, IP: "0.0.0.0", IPMask: 0}.ToSlice()): zeroValue,
+		},
+		ExpectedPortsMapContents: map[string]string{
+			string(PortKey{Port: 22, IPProto: 6}.ToSlice()):                       string(PortValue(PortFlagAnyAddr | PortFlagAddrScoped)),
+			string(PortKey{Port: 179, IPProto: 6}.ToSlice()):                      string(PortValue(PortFlagAddrScoped)),
+			string(PortKey{Port: 179, IPProto: 6, Flags: FlagOutbound}.ToSlice()): string(PortValue(PortFlagAnyAddr)),
+		},
+	},
 	{
 		Name: "ShouldRemoveAll",
 		InitialMapContents: map[string]string{
@@ -110,7 +141,8 @@ var tests = []failsafeTest{
 			string(Key{Port: 53, IPProto: 17, Flags: FlagOutbound, IP: "0.0.0.0", IPMask: 0}.ToSlice()):  zeroValue,
 			string(Key{Port: 57, IPProto: 17, Flags: FlagOutbound, IP: "0.0.0.0", IPMask: 0}.ToSlice()):  zeroValue,
 		},
-		ExpectedMapContents: map[string]string{},
+		ExpectedMapContents:      map[string]string{},
+		ExpectedPortsMapContents: map[string]string{},
 	},
 }
 
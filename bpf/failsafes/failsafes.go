@@ -33,6 +33,8 @@ import (
 type Manager struct {
 	// failsafesMap is the BPF map containing host enpodint failsafe ports.
 	failsafesMap bpf.Map
+	// portsMap is the BPF map that indexes the failsafe ports by port, see PortsMapParams.
+	portsMap bpf.Map
 	// failsafesInSync is set to true if the failsafe map is in sync.
 	failsafesInSync bool
 	// failsafesIn the inbound failsafe ports, from configuration.
@@ -48,11 +50,13 @@ func (m *Manager) OnUpdate(_ interface{}) {
 
 func NewManager(
 	failsafesMap bpf.Map,
+	portsMap bpf.Map,
 	failsafesIn, failsafesOut []config.ProtoPort,
 	opReporter logutils.OpRecorder,
 ) *Manager {
 	return &Manager{
 		failsafesMap: failsafesMap,
+		portsMap:     portsMap,
 		failsafesIn:  failsafesIn,
 		failsafesOut: failsafesOut,
 		opReporter:   opReporter,
@@ -74,8 +78,14 @@ func (m *Manager) ResyncFailsafes() error {
 		log.WithError(err).Panic("Failed to open failsafe port map.")
 	}
 
+	err = m.portsMap.EnsureExists()
+	if err != nil {
+		log.WithError(err).Panic("Failed to open failsafe port index map.")
+	}
+
 	syncFailed := false
 	unknownKeys := set.New()
+	ports := map[PortKey]uint32{}
 	err = m.failsafesMap.Iter(func(rawKey, _ []byte) bpf.IteratorAction {
 		key := KeyFromSlice(rawKey)
 		unknownKeys.Add(key)
@@ -128,6 +138,11 @@ func (m *Manager) ResyncFailsafes() error {
 		maskedIP := ipv4.Mask(ipnet.Mask)
 
 		k := MakeKey(ipProto, p.Port, outbound, maskedIP.String(), mask)
+		if mask == 0 {
+			ports[PortKeyOf(k)] |= PortFlagAnyAddr
+		} else {
+			ports[PortKeyOf(k)] |= PortFlagAddrScoped
+		}
 		unknownKeys.Discard(k)
 		err = m.failsafesMap.Update(k.ToSlice(), Value())
 		if err != nil {
@@ -153,9 +168,49 @@ func (m *Manager) ResyncFailsafes() error {
 		return nil
 	})
 
+	// Sync the index after the LPM map so that the programs find the address-scoped rules that
+	// it points them to.
+	if err := m.resyncPorts(ports); err != nil {
+		log.WithError(err).Error("Failed to sync failsafe port index.")
+		syncFailed = true
+	}
+
 	m.failsafesInSync = !syncFailed
 	if syncFailed {
 		return errors.New("failed to sync failsafe ports")
 	}
 	return nil
 }
+
+func (m *Manager) resyncPorts(ports map[PortKey]uint32) error {
+	var unknownKeys []PortKey
+	err := m.portsMap.Iter(func(rawKey, rawValue []byte) bpf.IteratorAction {
+		k := PortKeyFromSlice(rawKey)
+		if flags, ok := ports[k]; ok && string(PortValue(flags)) == string(rawValue) {
+			delete(ports, k)
+		} else if !ok {
+			unknownKeys = append(unknownKeys, k)
+		}
+		return bpf.IterNone
+	})
+	if err != nil {
+		return err
+	}
+
+	var lastErr error
+	for k, flags := range ports {
+		err := m.portsMap.Update(k.ToSlice(), PortValue(flags))
+		if err != nil {
+			log.WithError(err).WithField("key", k).Warn("Failed to update failsafe port index.")
+			lastErr = err
+		}
+	}
+	for _, k := range unknownKeys {
+		err := m.portsMap.Delete(k.ToSlice())
+		if err != nil && !bpf.IsNotExists(err) {
+			log.WithError(err).WithField("key", k).Warn("Failed to remove failsafe port from index.")
+			lastErr = err
+		}
+	}
+	return lastErr
+}
@@ -59,6 +59,68 @@ func Map(mc *bpf.MapContext) bpf.Map {
 	return mc.NewPinnedMap(MapParams)
 }
 
+// PortKeySize is the size of the keys of the cali_v4_fsafe_ports map: Port (2) + Proto (1) + Flags (1).
+const (
+	PortKeySize   = 4
+	PortValueSize = 4
+
+	// PortFlagAnyAddr marks a port that is failsafe for all addresses.
+	PortFlagAnyAddr = 1
+	// PortFlagAddrScoped marks a port that is failsafe for some addresses, which the programs then
+	// look up in the cali_v4_fsafes LPM map.
+	PortFlagAddrScoped = 2
+)
+
+// PortsMapParams describes the cali_v4_fsafe_ports map, which indexes the failsafe rules by port so
+// that the programs only go to the LPM map for the ports that have rules for specific addresses.
+// WARNING: must be kept in sync with cali_v4_fsafe_ports in bpf-gpl/failsafe.h.
+var PortsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_fsafe_ports",
+	Type:       "hash",
+	KeySize:    PortKeySize,
+	ValueSize:  PortValueSize,
+	MaxEntries: 65536,
+	Name:       "cali_v4_fsafe_ports",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func PortsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(PortsMapParams)
+}
+
+type PortKey struct {
+	Port    uint16
+	IPProto uint8
+	Flags   uint8
+}
+
+// PortKeyOf returns the key of the ports map entry that covers k.
+func PortKeyOf(k Key) PortKey {
+	return PortKey{Port: k.Port, IPProto: k.IPProto, Flags: k.Flags}
+}
+
+func (k PortKey) ToSlice() []byte {
+	key := make([]byte, PortKeySize)
+	binary.LittleEndian.PutUint16(key[0:2], k.Port)
+	key[2] = k.IPProto
+	key[3] = k.Flags
+	return key
+}
+
+func PortKeyFromSlice(data []byte) PortKey {
+	return PortKey{
+		Port:    binary.LittleEndian.Uint16(data[0:2]),
+		IPProto: data[2],
+		Flags:   data[3],
+	}
+}
+
+func PortValue(flags uint32) []byte {
+	v := make([]byte, PortValueSize)
+	binary.LittleEndian.PutUint32(v, flags)
+	return v
+}
+
 func MakeKey(ipProto uint8, port uint16, outbound bool, ip string, mask int) Key {
 	var flags uint8
 	if outbound {
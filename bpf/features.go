@@ -0,0 +1,166 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf
+
+import (
+	"strings"
+	"sync"
+
+	log "github.com/sirupsen/logrus"
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf/asm"
+)
+
+// Features records which of the optional kernel features that the dataplane can use are available.
+// Unlike the kernel version checks, the probes find the features that distributions backport.
+type Features struct {
+	// RedirectNeigh and RedirectPeer are set if TC programs can call bpf_redirect_neigh() and
+	// bpf_redirect_peer().
+	RedirectNeigh bool
+	RedirectPeer  bool
+	// RingBuf is set if the kernel has BPF_MAP_TYPE_RINGBUF, which the "ev" programs need.
+	RingBuf bool
+	// MapBatchOps is set if the kernel supports the BPF_MAP_*_BATCH commands.
+	MapBatchOps bool
+	// LRUNoCommon is set if LRU maps can have per-CPU LRU lists (BPF_F_NO_COMMON_LRU).
+	LRUNoCommon bool
+	// BoundedLoops is set if the verifier accepts bounded loops.
+	BoundedLoops bool
+	// Timer is set if programs can use bpf_timer.
+	Timer bool
+	// KtimeCoarse is set if programs can call bpf_ktime_get_coarse_ns().
+	KtimeCoarse bool
+}
+
+func (f Features) logFields() log.Fields {
+	return log.Fields{
+		"redirectNeigh": f.RedirectNeigh,
+		"redirectPeer":  f.RedirectPeer,
+		"ringBuf":       f.RingBuf,
+		"mapBatchOps":   f.MapBatchOps,
+		"lruNoCommon":   f.LRUNoCommon,
+		"boundedLoops":  f.BoundedLoops,
+		"timer":         f.Timer,
+		"ktimeCoarse":   f.KtimeCoarse,
+	}
+}
+
+var (
+	featuresOnce sync.Once
+	features     Features
+)
+
+// DetectFeatures probes the kernel for the optional features, once, and returns the result.
+func DetectFeatures() Features {
+	featuresOnce.Do(func() {
+		features = probeFeatures()
+		log.WithFields(features.logFields()).Info("Detected BPF kernel features.")
+	})
+	return features
+}
+
+// helperTimerInit is bpf_timer_init() and helperKtimeGetCoarseNs is bpf_ktime_get_coarse_ns(),
+// which our vendored libbpf headers predate.
+const (
+	helperKtimeGetCoarseNs asm.Helper = 160
+	helperTimerInit        asm.Helper = 169
+)
+
+const (
+	mapTypeLRUHash = 9
+	mapTypeRingBuf = 27
+
+	mapFlagNoCommonLRU = 1 << 1
+)
+
+func probeFeatures() Features {
+	if !SyscallSupport() {
+		return Features{}
+	}
+
+	var f Features
+	f.RedirectNeigh = probeHelper(asm.HelperRedirectNeigh)
+	f.RedirectPeer = probeHelper(asm.HelperRedirectPeer)
+	f.Timer = probeHelper(helperTimerInit)
+	f.KtimeCoarse = probeHelper(helperKtimeGetCoarseNs)
+	f.BoundedLoops = probeBoundedLoops()
+	// The data area of a ring buffer must be a power-of-2 multiple of the page size.
+	f.RingBuf = ProbeMapType(mapTypeRingBuf, 0, 0, uint32(unix.Getpagesize()), 0) == nil
+	f.LRUNoCommon = ProbeMapType(mapTypeLRUHash, 4, 4, 1, mapFlagNoCommonLRU) == nil
+	f.MapBatchOps = ProbeMapBatchOps() == nil
+	if !f.MapBatchOps {
+		// Save every map iteration from discovering it.
+		noteMapBatchOpsUnsupported()
+	}
+	return f
+}
+
+// helperProbeInsns returns a program that calls the helper with all-zero arguments.  The verifier
+// rejects many helpers' arguments but it only says that the function is unknown if the helper
+// is missing.
+func helperProbeInsns(helper asm.Helper) (asm.Insns, error) {
+	b := asm.NewBlock()
+	for _, r := range []asm.Reg{asm.R1, asm.R2, asm.R3, asm.R4, asm.R5} {
+		b.MovImm64(r, 0)
+	}
+	b.Call(helper)
+	b.MovImm64(asm.R0, 0)
+	b.Exit()
+	return b.Assemble()
+}
+
+// isUnknownHelperLog returns true if the verifier log says that the program called a helper that
+// the kernel lacks, or that the program type may not call.
+func isUnknownHelperLog(verifierLog string) bool {
+	return strings.Contains(verifierLog, "invalid func") || strings.Contains(verifierLog, "unknown func")
+}
+
+func probeHelper(helper asm.Helper) bool {
+	insns, err := helperProbeInsns(helper)
+	if err != nil {
+		log.WithError(err).Panic("Failed to assemble BPF helper probe.")
+	}
+	verifierLog, err := ProbeProgram(insns)
+	if err == nil {
+		return true
+	}
+	if verifierLog == "" {
+		log.WithError(err).WithField("helper", helper).Debug("BPF helper probe failed without a verifier log.")
+		return false
+	}
+	return !isUnknownHelperLog(verifierLog)
+}
+
+// boundedLoopProbeInsns returns a program with a loop that runs four times.
+func boundedLoopProbeInsns() (asm.Insns, error) {
+	b := asm.NewBlock()
+	b.MovImm64(asm.R0, 0)
+	b.LabelNextInsn("loop")
+	b.AddImm64(asm.R0, 1)
+	b.JumpLTImm64(asm.R0, 4, "loop")
+	b.MovImm64(asm.R0, 0)
+	b.Exit()
+	return b.Assemble()
+}
+
+func probeBoundedLoops() bool {
+	insns, err := boundedLoopProbeInsns()
+	if err != nil {
+		log.WithError(err).Panic("Failed to assemble BPF bounded loop probe.")
+	}
+	_, err = ProbeProgram(insns)
+	return err == nil
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/asm"
+)
+
+func TestHelperProbeInsns(t *testing.T) {
+	RegisterTestingT(t)
+
+	insns, err := helperProbeInsns(asm.HelperRedirectPeer)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(insns).To(HaveLen(8))
+	Expect(insns[5].OpCode()).To(Equal(asm.Call))
+	Expect(insns[5].Imm()).To(Equal(int32(155)))
+	Expect(insns[7].OpCode()).To(Equal(asm.Exit))
+}
+
+func TestBoundedLoopProbeInsns(t *testing.T) {
+	RegisterTestingT(t)
+
+	insns, err := boundedLoopProbeInsns()
+	Expect(err).NotTo(HaveOccurred())
+	Expect(insns).To(HaveLen(5))
+	Expect(insns[2].OpCode()).To(Equal(asm.JumpLTImm64))
+	// Back to the increment.
+	Expect(insns[2].Off()).To(Equal(int16(-2)))
+}
+
+func TestIsUnknownHelperLog(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(isUnknownHelperLog("0: (b7) r1 = 0\n5: (85) call unknown#169\ninvalid func unknown#169")).To(BeTrue())
+	Expect(isUnknownHelperLog("unknown func bpf_redirect_peer#155")).To(BeTrue())
+	Expect(isUnknownHelperLog("R1 type=inv expected=map_value")).To(BeFalse())
+}
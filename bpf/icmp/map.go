@@ -0,0 +1,84 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package icmp
+
+import (
+	"encoding/binary"
+	"net"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// RateLimitMapParams are the parameters of the per-CPU token buckets that limit the rate at which
+// the BPF programs generate ICMP errors, keyed by the /24 prefix of the destination of the reply.
+// WARNING: must be kept in sync with struct icmp_rl_value in bpf-gpl/icmp.h.
+var RateLimitMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_icmp_rl",
+	Type:       "lru_percpu_hash",
+	KeySize:    RateLimitKeySize,
+	ValueSize:  RateLimitValueSize,
+	MaxEntries: 16384,
+	Name:       "cali_v4_icmp_rl",
+}
+
+func RateLimitMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(RateLimitMapParams)
+}
+
+// RateLimitPrefixLen is the length of the prefixes that share a token bucket.
+const RateLimitPrefixLen = 24
+
+const RateLimitKeySize = 4
+
+type RateLimitKey [RateLimitKeySize]byte
+
+// NewRateLimitKey returns the key of the bucket for the replies to the given IP.
+func NewRateLimitKey(ip net.IP) RateLimitKey {
+	var k RateLimitKey
+
+	ip = ip.To4()
+	if len(ip) != 4 {
+		log.WithField("ip", ip).Panic("Bad IP")
+	}
+
+	copy(k[:], ip.Mask(net.CIDRMask(RateLimitPrefixLen, 32)))
+
+	return k
+}
+
+const RateLimitValueSize = 16
+
+type RateLimitValue [RateLimitValueSize]byte
+
+// NewRateLimitValue returns a bucket with the given tokens that has been credited up to
+// lastRefill, in the kernel's monotonic clock.
+func NewRateLimitValue(lastRefill uint64, tokens uint32) RateLimitValue {
+	var v RateLimitValue
+
+	binary.LittleEndian.PutUint64(v[0:8], lastRefill)
+	binary.LittleEndian.PutUint32(v[8:12], tokens)
+
+	return v
+}
+
+func (v RateLimitValue) LastRefill() uint64 {
+	return binary.LittleEndian.Uint64(v[0:8])
+}
+
+func (v RateLimitValue) Tokens() uint32 {
+	return binary.LittleEndian.Uint32(v[8:12])
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ifcfg
+
+import (
+	"encoding/binary"
+	"fmt"
+	"net"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// MapParams are the parameters of the per-interface configuration map, keyed on ifindex.  When
+// it is in use, the programs read their per-interface values from it rather than from the
+// constants that are patched into the binary, see tc.AttachPoint.IfaceConfig.
+// WARNING: must be kept in sync with struct cali_iface_cfg in bpf-gpl/ifcfg.h.
+var MapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ifcfg",
+	Type:       "hash",
+	KeySize:    KeySize,
+	ValueSize:  ValueSize,
+	MaxEntries: 16 * 1024,
+	Name:       "cali_v4_ifcfg",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func Map(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MapParams)
+}
+
+const KeySize = 4
+
+type Key [KeySize]byte
+
+func NewKey(ifIndex int) Key {
+	var k Key
+	binary.LittleEndian.PutUint32(k[:], uint32(ifIndex))
+	return k
+}
+
+func (k Key) IfIndex() int {
+	return int(binary.LittleEndian.Uint32(k[:]))
+}
+
+const ValueSize = 16
+
+type Value [ValueSize]byte
+
+func NewValue(hostIP, intfIP net.IP, extToSvcMark uint32, tunnelMTU, vxlanPort uint16) Value {
+	var v Value
+
+	copy(v[0:4], hostIP.To4())
+	copy(v[4:8], intfIP.To4())
+	binary.LittleEndian.PutUint32(v[8:12], extToSvcMark)
+	binary.LittleEndian.PutUint16(v[12:14], tunnelMTU)
+	binary.LittleEndian.PutUint16(v[14:16], vxlanPort)
+
+	return v
+}
+
+func (v Value) HostIP() net.IP {
+	return net.IP(v[0:4])
+}
+
+func (v Value) IntfIP() net.IP {
+	return net.IP(v[4:8])
+}
+
+func (v Value) ExtToSvcMark() uint32 {
+	return binary.LittleEndian.Uint32(v[8:12])
+}
+
+func (v Value) TunnelMTU() uint16 {
+	return binary.LittleEndian.Uint16(v[12:14])
+}
+
+func (v Value) VXLANPort() uint16 {
+	return binary.LittleEndian.Uint16(v[14:16])
+}
+
+func (v Value) String() string {
+	return fmt.Sprintf("ifcfg{hostIP: %v, intfIP: %v, extToSvcMark: %#x, tunnelMTU: %d, vxlanPort: %d}",
+		v.HostIP(), v.IntfIP(), v.ExtToSvcMark(), v.TunnelMTU(), v.VXLANPort())
+}
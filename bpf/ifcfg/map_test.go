@@ -0,0 +1,41 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ifcfg
+
+import (
+	"net"
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestValue(t *testing.T) {
+	RegisterTestingT(t)
+
+	v := NewValue(net.ParseIP("10.0.0.1"), net.ParseIP("169.254.1.1"), 0x1000000, 1410, 4789)
+	Expect(v.HostIP().String()).To(Equal("10.0.0.1"))
+	Expect(v.IntfIP().String()).To(Equal("169.254.1.1"))
+	Expect(v.ExtToSvcMark()).To(Equal(uint32(0x1000000)))
+	Expect(v.TunnelMTU()).To(Equal(uint16(1410)))
+	Expect(v.VXLANPort()).To(Equal(uint16(4789)))
+	// The IPs are in network order like struct cali_iface_cfg.
+	Expect(v[0:4]).To(Equal([]byte{10, 0, 0, 1}))
+}
+
+func TestKey(t *testing.T) {
+	RegisterTestingT(t)
+	Expect(NewKey(258)).To(Equal(Key{2, 1, 0, 0}))
+	Expect(NewKey(258).IfIndex()).To(Equal(258))
+}
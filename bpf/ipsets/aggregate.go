@@ -0,0 +1,203 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ipsets
+
+import (
+	"encoding/binary"
+	"fmt"
+)
+
+// v4Prefix is an IPv4 CIDR in host byte order, with its host bits zeroed.
+type v4Prefix struct {
+	addr uint32
+	len  uint8
+}
+
+func newV4Prefix(addr uint32, len uint8) v4Prefix {
+	return v4Prefix{addr: addr & prefixMask(len), len: len}
+}
+
+func prefixMask(len uint8) uint32 {
+	if len == 0 {
+		return 0
+	}
+	return ^uint32(0) << (32 - len)
+}
+
+func (p v4Prefix) parent() v4Prefix {
+	return newV4Prefix(p.addr, p.len-1)
+}
+
+func (p v4Prefix) sibling() v4Prefix {
+	return v4Prefix{addr: p.addr ^ (1 << (32 - p.len)), len: p.len}
+}
+
+func (p v4Prefix) contains(o v4Prefix) bool {
+	return o.len >= p.len && o.addr&prefixMask(p.len) == p.addr
+}
+
+// entry returns the LPM map entry of the prefix in the given IP set.
+func (p v4Prefix) entry(setID uint64) IPSetEntry {
+	var e IPSetEntry
+	binary.LittleEndian.PutUint32(e[0:4], uint32(64 /* ID */ +p.len))
+	binary.BigEndian.PutUint64(e[4:12], setID)
+	binary.BigEndian.PutUint32(e[12:16], p.addr)
+	return e
+}
+
+func (p v4Prefix) String() string {
+	return fmt.Sprintf("%d.%d.%d.%d/%d", byte(p.addr>>24), byte(p.addr>>16), byte(p.addr>>8), byte(p.addr), p.len)
+}
+
+// entryPrefix returns the CIDR of a plain (not named port) entry.
+func entryPrefix(e IPSetEntry) v4Prefix {
+	return newV4Prefix(binary.BigEndian.Uint32(e[12:16]), uint8(e.PrefixLen()-64 /* ID */))
+}
+
+// cidrAggregator maintains the smallest set of CIDRs that covers exactly the addresses of a set of
+// member CIDRs: members that other members cover are left out and sibling CIDRs are merged into
+// their parent, so that a /24 that is fully populated with /32 members is stored as one entry.
+//
+// Updates are incremental, each one only visits the path from the member to the CIDR that covers
+// it, unless the member is itself a prefix, in which case the members and CIDRs under it are
+// scanned.  Each update returns the CIDRs that it added to the aggregate (true) and removed from
+// it (false).
+type cidrAggregator struct {
+	members map[v4Prefix]struct{}
+	cidrs   map[v4Prefix]struct{}
+
+	// changes accumulates the net changes of the current update.
+	changes map[v4Prefix]bool
+}
+
+func newCIDRAggregator() *cidrAggregator {
+	return &cidrAggregator{
+		members: map[v4Prefix]struct{}{},
+		cidrs:   map[v4Prefix]struct{}{},
+	}
+}
+
+// Add adds a member.  Idempotent.
+func (a *cidrAggregator) Add(m v4Prefix) map[v4Prefix]bool {
+	if _, ok := a.members[m]; ok {
+		return nil
+	}
+	a.members[m] = struct{}{}
+	a.changes = map[v4Prefix]bool{}
+	a.insert(m)
+	return a.takeChanges()
+}
+
+// Remove removes a member.  Idempotent.
+func (a *cidrAggregator) Remove(m v4Prefix) map[v4Prefix]bool {
+	if _, ok := a.members[m]; !ok {
+		return nil
+	}
+	delete(a.members, m)
+	a.changes = map[v4Prefix]bool{}
+
+	n, ok := a.covering(m)
+	if !ok {
+		// Can't happen, every member is covered by the aggregate.
+		return nil
+	}
+	for l := n.len; l <= m.len; l++ {
+		if _, ok := a.members[newV4Prefix(m.addr, l)]; ok {
+			// Another member still covers the addresses of the member.
+			return nil
+		}
+	}
+
+	// Split the covering CIDR: everything in it but the member is still covered, which is the
+	// siblings of the path from the CIDR down to the member.
+	a.removeCIDR(n)
+	for l := n.len + 1; l <= m.len; l++ {
+		a.addCIDR(newV4Prefix(m.addr, l).sibling())
+	}
+	if m.len < 32 {
+		// The members under the removed one are no longer covered by it.
+		for o := range a.members {
+			if m.contains(o) {
+				a.insert(o)
+			}
+		}
+	}
+	return a.takeChanges()
+}
+
+// CIDRs returns the number of CIDRs in the aggregate.
+func (a *cidrAggregator) CIDRs() int {
+	return len(a.cidrs)
+}
+
+func (a *cidrAggregator) insert(m v4Prefix) {
+	if _, ok := a.covering(m); ok {
+		return
+	}
+	if m.len < 32 {
+		for c := range a.cidrs {
+			if m.contains(c) {
+				a.removeCIDR(c)
+			}
+		}
+	}
+	// The aggregate never holds two siblings, so a sibling that is fully covered is in the
+	// aggregate itself.
+	n := m
+	for n.len > 0 {
+		s := n.sibling()
+		if _, ok := a.cidrs[s]; !ok {
+			break
+		}
+		a.removeCIDR(s)
+		n = n.parent()
+	}
+	a.addCIDR(n)
+}
+
+// covering returns the CIDR of the aggregate that covers the given prefix, if any.
+func (a *cidrAggregator) covering(p v4Prefix) (v4Prefix, bool) {
+	for l := int(p.len); l >= 0; l-- {
+		c := newV4Prefix(p.addr, uint8(l))
+		if _, ok := a.cidrs[c]; ok {
+			return c, true
+		}
+	}
+	return v4Prefix{}, false
+}
+
+func (a *cidrAggregator) addCIDR(c v4Prefix) {
+	a.cidrs[c] = struct{}{}
+	if added, ok := a.changes[c]; ok && !added {
+		delete(a.changes, c)
+	} else {
+		a.changes[c] = true
+	}
+}
+
+func (a *cidrAggregator) removeCIDR(c v4Prefix) {
+	delete(a.cidrs, c)
+	if added, ok := a.changes[c]; ok && added {
+		delete(a.changes, c)
+	} else {
+		a.changes[c] = false
+	}
+}
+
+func (a *cidrAggregator) takeChanges() map[v4Prefix]bool {
+	c := a.changes
+	a.changes = nil
+	return c
+}
@@ -0,0 +1,162 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ipsets
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/ip"
+)
+
+func mustParsePrefix(s string) v4Prefix {
+	cidr := ip.MustParseCIDROrIP(s).(ip.V4CIDR)
+	return newV4Prefix(cidr.Addr().(ip.V4Addr).AsUint32(), cidr.Prefix())
+}
+
+func prefixes(ss ...string) map[v4Prefix]struct{} {
+	m := map[v4Prefix]struct{}{}
+	for _, s := range ss {
+		m[mustParsePrefix(s)] = struct{}{}
+	}
+	return m
+}
+
+func TestCIDRAggregation(t *testing.T) {
+	RegisterTestingT(t)
+
+	a := newCIDRAggregator()
+	// The changes of each update are applied to this copy, which must track the aggregate.
+	programmed := map[v4Prefix]struct{}{}
+	apply := func(changes map[v4Prefix]bool) {
+		for c, added := range changes {
+			if added {
+				Expect(programmed).NotTo(HaveKey(c))
+				programmed[c] = struct{}{}
+			} else {
+				Expect(programmed).To(HaveKey(c))
+				delete(programmed, c)
+			}
+		}
+		Expect(programmed).To(Equal(a.cidrs))
+	}
+	add := func(s string) { apply(a.Add(mustParsePrefix(s))) }
+	remove := func(s string) { apply(a.Remove(mustParsePrefix(s))) }
+
+	add("10.0.0.0")
+	add("10.0.0.1")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/31")))
+	add("10.0.0.3")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/31", "10.0.0.3/32")))
+	add("10.0.0.2")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/30")))
+
+	// Members that are covered by other members do not change the aggregate.
+	add("10.0.0.0/24")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/24")))
+	add("10.0.0.128/25")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/24")))
+
+	// Removing the prefix uncovers the members under it.
+	remove("10.0.0.0/24")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/30", "10.0.0.128/25")))
+
+	// Removing an address from an aggregate splits it.
+	remove("10.0.0.1")
+	Expect(a.cidrs).To(Equal(prefixes("10.0.0.0/32", "10.0.0.2/31", "10.0.0.128/25")))
+	remove("10.0.0.128/25")
+	remove("10.0.0.0")
+	remove("10.0.0.2")
+	remove("10.0.0.3")
+	Expect(a.cidrs).To(BeEmpty())
+
+	// Idempotent.
+	Expect(a.Remove(mustParsePrefix("10.0.0.3"))).To(BeEmpty())
+	add("10.0.0.3")
+	Expect(a.Add(mustParsePrefix("10.0.0.3"))).To(BeEmpty())
+}
+
+func TestCIDRAggregationWholeBlock(t *testing.T) {
+	RegisterTestingT(t)
+
+	a := newCIDRAggregator()
+	base := mustParsePrefix("192.168.1.0/24").addr
+	for i := uint32(0); i < 256; i++ {
+		a.Add(newV4Prefix(base+i, 32))
+	}
+	Expect(a.cidrs).To(Equal(prefixes("192.168.1.0/24")))
+
+	changes := a.Remove(newV4Prefix(base+77, 32))
+	Expect(changes).To(HaveLen(9), "expected the /24 to be replaced by 8 CIDRs")
+	Expect(a.CIDRs()).To(Equal(8))
+	_, ok := a.covering(newV4Prefix(base+77, 32))
+	Expect(ok).To(BeFalse())
+	for i := uint32(0); i < 256; i++ {
+		if i == 77 {
+			continue
+		}
+		_, ok := a.covering(newV4Prefix(base+i, 32))
+		Expect(ok).To(BeTrue())
+	}
+}
+
+func TestMemberTableInheritsCoveringBits(t *testing.T) {
+	RegisterTestingT(t)
+
+	bpfMap := mock.NewMockMap(MembersMapParameters)
+	mt := newMemberTable(bpfMap)
+
+	value := func(member string) memberBits {
+		var v memberBits
+		b, err := bpfMap.Get(memberKeyOfEntry(*ProtoIPSetMemberToBPFEntry(1, member)).AsBytes())
+		Expect(err).NotTo(HaveOccurred())
+		copy(v[:], b)
+		return v
+	}
+	bits := func(bs ...int) memberBits {
+		var v memberBits
+		for _, b := range bs {
+			v.set(b)
+		}
+		return v
+	}
+
+	net, _ := mt.AllocBit()
+	addr, _ := mt.AllocBit()
+	port, _ := mt.AllocBit()
+	Expect(mt.Add(*ProtoIPSetMemberToBPFEntry(1, "10.0.0.1"), addr)).To(BeTrue())
+	Expect(mt.Add(*ProtoIPSetMemberToBPFEntry(2, "10.0.0.1,tcp:80"), port)).To(BeTrue())
+	mt.Apply()
+	Expect(mt.Clean()).To(BeTrue())
+	Expect(value("10.0.0.1")).To(Equal(bits(addr)))
+	Expect(value("10.0.0.1,tcp:80")).To(Equal(bits(addr, port)))
+
+	// A covering CIDR adds its bit to the keys under it.
+	Expect(mt.Add(*ProtoIPSetMemberToBPFEntry(3, "10.0.0.0/8"), net)).To(BeTrue())
+	mt.Apply()
+	Expect(value("10.0.0.0/8")).To(Equal(bits(net)))
+	Expect(value("10.0.0.1")).To(Equal(bits(net, addr)))
+	Expect(value("10.0.0.1,tcp:80")).To(Equal(bits(net, addr, port)))
+
+	Expect(mt.Remove(*ProtoIPSetMemberToBPFEntry(1, "10.0.0.1"), addr)).To(BeTrue())
+	Expect(mt.Remove(*ProtoIPSetMemberToBPFEntry(1, "10.0.0.1"), addr)).To(BeFalse())
+	mt.Apply()
+	_, err := bpfMap.Get(memberKeyOfEntry(*ProtoIPSetMemberToBPFEntry(1, "10.0.0.1")).AsBytes())
+	Expect(err).To(HaveOccurred())
+	Expect(value("10.0.0.1,tcp:80")).To(Equal(bits(net, port)))
+	Expect(bpfMap.Contents).To(HaveLen(2))
+}
@@ -15,6 +15,7 @@
 package ipsets
 
 import (
+	"encoding/binary"
 	"fmt"
 	"time"
 
@@ -22,6 +23,7 @@ import (
 	log "github.com/sirupsen/logrus"
 
 	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/polcache"
 	"github.com/projectcalico/felix/idalloc"
 	"github.com/projectcalico/felix/ipsets"
 	"github.com/projectcalico/felix/logutils"
@@ -49,10 +51,23 @@ type bpfIPSets struct {
 	ipSetIDAllocator *idalloc.IDAllocator
 
 	bpfMap bpf.Map
+	// exactMap holds a copy of the full-length entries of all IP sets, see ExactMapParameters.
+	exactMap bpf.Map
+	// members, if set, stores the first MemberSetBits IP sets in the member map rather than in
+	// bpfMap and exactMap, see MembersMapParameters.
+	members *memberTable
 
 	dirtyIPSetIDs   set.Set
 	resyncScheduled bool
 
+	// ipSetsWithNewPrefixes contains the string IDs of the IP sets that had no prefix members and
+	// gained one since the last call to TakeIPSetsWithNewPrefixes().
+	ipSetsWithNewPrefixes set.Set
+
+	// polGeneration, if set, is bumped after IP set members change to invalidate the policy
+	// verdict cache.
+	polGeneration *polcache.Generation
+
 	opRecorder logutils.OpRecorder
 }
 
@@ -60,19 +75,34 @@ func NewBPFIPSets(
 	ipVersionConfig *ipsets.IPVersionConfig,
 	ipSetIDAllocator *idalloc.IDAllocator,
 	ipSetsMap bpf.Map,
+	ipSetsExactMap bpf.Map,
+	ipSetsMembersMap bpf.Map,
 	opRecorder logutils.OpRecorder,
 ) *bpfIPSets {
+	var members *memberTable
+	if ipSetsMembersMap != nil {
+		members = newMemberTable(ipSetsMembersMap)
+	}
 	return &bpfIPSets{
-		IPVersionConfig:  ipVersionConfig,
-		ipSets:           map[uint64]*bpfIPSet{},
-		dirtyIPSetIDs:    set.New(), /*set entries are uint64 IDs */
-		bpfMap:           ipSetsMap,
-		resyncScheduled:  true,
-		ipSetIDAllocator: ipSetIDAllocator,
-		opRecorder:       opRecorder,
+		IPVersionConfig:       ipVersionConfig,
+		ipSets:                map[uint64]*bpfIPSet{},
+		dirtyIPSetIDs:         set.New(), /*set entries are uint64 IDs */
+		bpfMap:                ipSetsMap,
+		exactMap:              ipSetsExactMap,
+		members:               members,
+		resyncScheduled:       true,
+		ipSetIDAllocator:      ipSetIDAllocator,
+		opRecorder:            opRecorder,
+		ipSetsWithNewPrefixes: set.New(), /* set entries are string IDs */
 	}
 }
 
+// SetPolicyGeneration makes ApplyUpdates bump the policy verdict cache generation after it changes
+// the members of the IP sets, since cached verdicts may depend on them.
+func (m *bpfIPSets) SetPolicyGeneration(g *polcache.Generation) {
+	m.polGeneration = g
+}
+
 // getExistingIPSetString gets the IP set data given the string set ID; returns nil if the IP set wasn't present.
 // Never allocates an IP set ID from the allocator.
 func (m *bpfIPSets) getExistingIPSetString(setID string) *bpfIPSet {
@@ -101,8 +131,18 @@ func (m *bpfIPSets) getOrCreateIPSet(setID string) *bpfIPSet {
 			ID:             id,
 			OriginalID:     setID,
 			DesiredEntries: set.New(),
-			PendingAdds:    set.New(),
-			PendingRemoves: set.New(),
+			lpm:            newEntryTracker(),
+			exact:          newEntryTracker(),
+			aggregator:     newCIDRAggregator(),
+			memberBit:      -1,
+		}
+		if m.members != nil {
+			if bit, ok := m.members.AllocBit(); ok {
+				ipSet.members = m.members
+				ipSet.memberBit = bit
+			} else {
+				log.WithField("setID", setID).Info("IP set member map is full, storing the IP set on its own")
+			}
 		}
 		m.ipSets[id] = ipSet
 	} else {
@@ -115,6 +155,9 @@ func (m *bpfIPSets) getOrCreateIPSet(setID string) *bpfIPSet {
 // deleteIPSetAndReleaseID deleted the IP set tracking struct from the map and releases the ID.
 func (m *bpfIPSets) deleteIPSetAndReleaseID(ipSet *bpfIPSet) {
 	delete(m.ipSets, ipSet.ID)
+	if ipSet.members != nil {
+		ipSet.members.ReleaseBit(ipSet.memberBit)
+	}
 	err := m.ipSetIDAllocator.ReleaseUintID(ipSet.ID)
 	if err != nil {
 		log.WithField("id", ipSet.ID).WithError(err).Panic("Failed to release IP set UID")
@@ -128,7 +171,9 @@ func (m *bpfIPSets) AddOrReplaceIPSet(setMetadata ipsets.IPSetMetadata, members
 	ipSet := m.getOrCreateIPSet(setMetadata.SetID)
 	ipSet.Type = setMetadata.Type
 	log.WithFields(log.Fields{"stringID": setMetadata.SetID, "uint64ID": ipSet.ID}).Info("IP set added")
+	wasExact := ipSet.Exact()
 	ipSet.ReplaceMembers(members)
+	m.noteExactnessChange(ipSet, wasExact)
 	m.markIPSetDirty(ipSet)
 }
 
@@ -166,12 +211,14 @@ func (m *bpfIPSets) AddMembers(setID string, newMembers []string) {
 		"uint64ID": ipSet.ID,
 		"added":    len(newMembers),
 	}).Info("IP delta update (adding)")
+	wasExact := ipSet.Exact()
 	for _, member := range newMembers {
 		entry := ProtoIPSetMemberToBPFEntry(ipSet.ID, member)
 		if entry != nil {
 			ipSet.AddMember(*entry)
 		}
 	}
+	m.noteExactnessChange(ipSet, wasExact)
 	m.markIPSetDirty(ipSet)
 }
 
@@ -207,6 +254,48 @@ func (m *bpfIPSets) QueueResync() {
 	m.resyncScheduled = true
 }
 
+// IPSetIsExact returns true if the IP set is known and has no prefix members, in which case all its
+// members are also present in the exact-match map.  It is safe to call concurrently with other
+// readers but not with updates to the IP sets.
+func (m *bpfIPSets) IPSetIsExact(setID uint64) bool {
+	ipSet := m.getExistingIPSet(setID)
+	return ipSet != nil && !ipSet.Deleted && ipSet.Exact()
+}
+
+// IPSetMemberBit returns the bit of the IP set in the member map, or false if the IP set is not in
+// the member map.  Like IPSetIsExact, it is safe to call concurrently with other readers.  An IP
+// set keeps its bit for as long as it exists.
+func (m *bpfIPSets) IPSetMemberBit(setID uint64) (int, bool) {
+	ipSet := m.getExistingIPSet(setID)
+	if ipSet == nil || ipSet.Deleted || ipSet.members == nil {
+		return 0, false
+	}
+	return ipSet.memberBit, true
+}
+
+// TakeIPSetsWithNewPrefixes returns the IDs of the IP sets that gained a prefix member since the
+// previous call.  Policy programs that look up those IP sets in the exact-match map need to be
+// regenerated.
+func (m *bpfIPSets) TakeIPSetsWithNewPrefixes() []string {
+	var setIDs []string
+	m.ipSetsWithNewPrefixes.Iter(func(item interface{}) error {
+		setIDs = append(setIDs, item.(string))
+		return set.RemoveItem
+	})
+	return setIDs
+}
+
+func (m *bpfIPSets) noteExactnessChange(ipSet *bpfIPSet, wasExact bool) {
+	if ipSet.members != nil {
+		// Not looked up in the exact-match map.
+		return
+	}
+	if wasExact && !ipSet.Exact() {
+		log.WithField("setID", ipSet.OriginalID).Debug("IP set gained a prefix member")
+		m.ipSetsWithNewPrefixes.Add(ipSet.OriginalID)
+	}
+}
+
 func (m *bpfIPSets) GetIPFamily() ipsets.IPFamily {
 	return m.IPVersionConfig.Family
 }
@@ -227,30 +316,42 @@ func (m *bpfIPSets) GetMembers(setID string) (set.Set, error) {
 
 func (m *bpfIPSets) ApplyUpdates() {
 	var numAdds, numDels uint
+	resynced := false
 	startTime := time.Now()
 
 	err := m.bpfMap.EnsureExists()
 	if err != nil {
 		log.WithError(err).Panic("Failed to create IP set map")
 	}
+	err = m.exactMap.EnsureExists()
+	if err != nil {
+		log.WithError(err).Panic("Failed to create exact-match IP set map")
+	}
+	if m.members != nil {
+		err = m.members.bpfMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create IP set member map")
+		}
+	}
 
 	debug := log.GetLevel() >= log.DebugLevel
 	if m.resyncScheduled {
 		log.Debug("Doing full resync of BPF IP sets map")
 		m.opRecorder.RecordOperation("resync-bpf-ipsets")
 		m.resyncScheduled = false
+		resynced = true
 
 		m.dirtyIPSetIDs.Clear()
 
 		// Start by configuring every IP set to add all its entries to the dataplane.  Then, as we scan the dataplane,
 		// we'll make sure that each gets cleaned up.
 		for _, ipSet := range m.ipSets {
-			ipSet.PendingAdds = ipSet.DesiredEntries.Copy()
-			ipSet.PendingRemoves.Clear()
+			ipSet.lpm.QueueResync()
+			ipSet.exact.QueueResync()
 		}
 
 		var unknownEntries []IPSetEntry
-		err := m.bpfMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		err = m.bpfMap.Iter(func(k, v []byte) bpf.IteratorAction {
 			var entry IPSetEntry
 			copy(entry[:], k)
 			setID := entry.SetID()
@@ -265,11 +366,7 @@ func (m *bpfIPSets) ApplyUpdates() {
 				unknownEntries = append(unknownEntries, entry)
 			} else {
 				// Entry is from a known IP set.  Check if the entry is wanted.
-				if ipSet.DesiredEntries.Contains(entry) {
-					ipSet.PendingAdds.Discard(entry)
-				} else {
-					ipSet.PendingRemoves.Add(entry)
-				}
+				ipSet.lpm.Found(entry)
 			}
 			return bpf.IterNone
 		})
@@ -286,6 +383,38 @@ func (m *bpfIPSets) ApplyUpdates() {
 			}
 		}
 
+		var unknownExactKeys [][]byte
+		err = m.exactMap.Iter(func(k, v []byte) bpf.IteratorAction {
+			entry := exactKeyToEntry(k)
+			ipSet := m.ipSets[entry.SetID()]
+			if ipSet == nil {
+				unknownExactKeys = append(unknownExactKeys, entry.ExactKey())
+			} else {
+				ipSet.exact.Found(entry)
+			}
+			return bpf.IterNone
+		})
+		if err != nil {
+			log.WithError(err).Error("Failed to iterate over BPF map; IP sets may be out of sync")
+			m.resyncScheduled = true
+		}
+
+		for _, key := range unknownExactKeys {
+			err := m.exactMap.Delete(key)
+			if err != nil && !bpf.IsNotExists(err) {
+				log.WithError(err).WithField("key", key).Error("Failed to remove unexpected IP set entry")
+				m.resyncScheduled = true
+			}
+		}
+
+		if m.members != nil {
+			err := m.members.QueueResync()
+			if err != nil {
+				log.WithError(err).Error("Failed to iterate over BPF map; IP sets may be out of sync")
+				m.resyncScheduled = true
+			}
+		}
+
 		for _, ipSet := range m.ipSets {
 			if ipSet.Dirty() {
 				m.markIPSetDirty(ipSet)
@@ -293,6 +422,15 @@ func (m *bpfIPSets) ApplyUpdates() {
 		}
 	}
 
+	// The IP sets in the member map share its entries, write them all before releasing the bits of
+	// removed IP sets.
+	if m.members != nil {
+		numAdds += m.members.Apply()
+		if !m.members.Clean() {
+			m.resyncScheduled = true
+		}
+	}
+
 	m.dirtyIPSetIDs.Iter(func(item interface{}) error {
 		setID := item.(uint64)
 		leaveDirty := false
@@ -303,35 +441,50 @@ func (m *bpfIPSets) ApplyUpdates() {
 			return set.RemoveItem
 		}
 
-		ipSet.PendingRemoves.Iter(func(item interface{}) error {
-			entry := item.(IPSetEntry)
-			if debug {
-				log.WithFields(log.Fields{"setID": setID, "entry": entry}).Debug("Removing entry from IP set")
-			}
-			err := m.bpfMap.Delete(entry[:])
-			if err != nil {
-				log.WithFields(log.Fields{"setID": setID, "entry": entry}).WithError(err).Error("Failed to remove IP set entry")
-				leaveDirty = true
-				return nil
-			}
-			numDels++
-			return set.RemoveItem
-		})
+		for _, t := range []struct {
+			name    string
+			tracker *entryTracker
+			bpfMap  bpf.Map
+			key     func(IPSetEntry) []byte
+		}{
+			{"", &ipSet.lpm, m.bpfMap, func(e IPSetEntry) []byte { return e[:] }},
+			{"exact-match ", &ipSet.exact, m.exactMap, func(e IPSetEntry) []byte { return e.ExactKey() }},
+		} {
+			t.tracker.PendingRemoves.Iter(func(item interface{}) error {
+				entry := item.(IPSetEntry)
+				if debug {
+					log.WithFields(log.Fields{"setID": setID, "entry": entry}).Debugf("Removing %sentry from IP set", t.name)
+				}
+				err := t.bpfMap.Delete(t.key(entry))
+				if err != nil && !bpf.IsNotExists(err) {
+					log.WithFields(log.Fields{"setID": setID, "entry": entry}).WithError(err).Errorf("Failed to remove %sIP set entry", t.name)
+					leaveDirty = true
+					return nil
+				}
+				numDels++
+				return set.RemoveItem
+			})
+
+			t.tracker.PendingAdds.Iter(func(item interface{}) error {
+				entry := item.(IPSetEntry)
+				if debug {
+					log.WithFields(log.Fields{"setID": setID, "entry": entry}).Debugf("Adding %sentry to IP set", t.name)
+				}
+				err := t.bpfMap.Update(t.key(entry), DummyValue)
+				if err != nil {
+					log.WithFields(log.Fields{"setID": setID, "entry": entry}).WithError(err).Errorf("Failed to add %sIP set entry", t.name)
+					leaveDirty = true
+					return nil
+				}
+				numAdds++
+				return set.RemoveItem
+			})
+		}
 
-		ipSet.PendingAdds.Iter(func(item interface{}) error {
-			entry := item.(IPSetEntry)
-			if debug {
-				log.WithFields(log.Fields{"setID": setID, "entry": entry}).Debug("Adding entry to IP set")
-			}
-			err := m.bpfMap.Update(entry[:], DummyValue)
-			if err != nil {
-				log.WithFields(log.Fields{"setID": setID, "entry": entry}).WithError(err).Error("Failed to add IP set entry")
-				leaveDirty = true
-				return nil
-			}
-			numAdds++
-			return set.RemoveItem
-		})
+		if ipSet.Deleted && ipSet.members != nil && !m.members.Clean() {
+			// The bit of the IP set may still be set in the dataplane.
+			leaveDirty = true
+		}
 
 		if leaveDirty {
 			log.WithField("setID", setID).Debug("IP set still dirty, queueing resync")
@@ -348,6 +501,14 @@ func (m *bpfIPSets) ApplyUpdates() {
 		return set.RemoveItem
 	})
 
+	if m.polGeneration != nil && (numDels > 0 || numAdds > 0 || resynced) {
+		err := m.polGeneration.Bump()
+		if err != nil {
+			log.WithError(err).Error("Failed to invalidate policy verdict cache; will retry")
+			m.resyncScheduled = true
+		}
+	}
+
 	duration := time.Since(startTime)
 	if numDels > 0 || numAdds > 0 {
 		log.WithFields(log.Fields{
@@ -374,17 +535,90 @@ type bpfIPSet struct {
 	OriginalID string
 	ID         uint64
 
-	// DesiredEntries contains all the entries that we _want_ to be in the set.
+	// DesiredEntries contains all the members of the set, as entries of the LPM map.
 	DesiredEntries set.Set /* of IPSetEntry */
-	// PendingAdds contains all the entries that we need to add to bring the dataplane into sync with DesiredEntries.
+
+	// lpm tracks the entries of the set in the LPM map.  Plain members go through aggregator so
+	// the LPM map holds the aggregated CIDRs rather than the members themselves.
+	lpm        entryTracker
+	aggregator *cidrAggregator
+	// exact tracks the full-length members of the set in the exact-match map.
+	exact entryTracker
+
+	// members is set if the set is stored in the member map, under memberBit, rather than in the
+	// LPM and exact-match maps.
+	members   *memberTable
+	memberBit int
+
+	// numPrefixEntries is the number of DesiredEntries that are not full-length.
+	numPrefixEntries int
+
+	Deleted bool
+
+	Type ipsets.IPSetType
+}
+
+// entryTracker tracks the entries of an IP set in one of the maps.
+type entryTracker struct {
+	// Desired contains all the entries that we _want_ to be in the map.
+	Desired set.Set /* of IPSetEntry */
+	// PendingAdds contains all the entries that we need to add to bring the dataplane into sync with Desired.
 	PendingAdds set.Set /* of IPSetEntry */
 	// PendingRemoves contains all the entries that we need to remove from the dataplane to bring the
-	// dataplane into sync with DesiredEntries.
+	// dataplane into sync with Desired.
 	PendingRemoves set.Set /* of IPSetEntry */
+}
 
-	Deleted bool
+func newEntryTracker() entryTracker {
+	return entryTracker{
+		Desired:        set.New(),
+		PendingAdds:    set.New(),
+		PendingRemoves: set.New(),
+	}
+}
 
-	Type ipsets.IPSetType
+func (t *entryTracker) Add(entry IPSetEntry) {
+	if t.Desired.Contains(entry) {
+		return
+	}
+	t.Desired.Add(entry)
+	if t.PendingRemoves.Contains(entry) {
+		t.PendingRemoves.Discard(entry)
+	} else {
+		t.PendingAdds.Add(entry)
+	}
+}
+
+func (t *entryTracker) Remove(entry IPSetEntry) {
+	if !t.Desired.Contains(entry) {
+		return
+	}
+	t.Desired.Discard(entry)
+	if t.PendingAdds.Contains(entry) {
+		t.PendingAdds.Discard(entry)
+	} else {
+		t.PendingRemoves.Add(entry)
+	}
+}
+
+// QueueResync starts a resync, assuming that none of the entries are in the dataplane until Found
+// says otherwise.
+func (t *entryTracker) QueueResync() {
+	t.PendingAdds = t.Desired.Copy()
+	t.PendingRemoves.Clear()
+}
+
+// Found records that the dataplane has the entry, during a resync.
+func (t *entryTracker) Found(entry IPSetEntry) {
+	if t.Desired.Contains(entry) {
+		t.PendingAdds.Discard(entry)
+	} else {
+		t.PendingRemoves.Add(entry)
+	}
+}
+
+func (t *entryTracker) Dirty() bool {
+	return t.PendingRemoves.Len() > 0 || t.PendingAdds.Len() > 0
 }
 
 func (m *bpfIPSet) ReplaceMembers(members []string) {
@@ -415,11 +649,22 @@ func (m *bpfIPSet) AddMember(entry IPSetEntry) {
 		return
 	}
 	m.DesiredEntries.Add(entry)
-	if m.PendingRemoves.Contains(entry) {
-		m.PendingRemoves.Discard(entry)
-	} else {
-		m.PendingAdds.Add(entry)
+	if !entry.IsExact() {
+		m.numPrefixEntries++
+	}
+	if m.members != nil {
+		m.members.Add(entry, m.memberBit)
+		return
+	}
+	if entry.IsExact() {
+		m.exact.Add(entry)
+	}
+	if entry.Protocol() != 0 {
+		// Named ports are not aggregated.
+		m.lpm.Add(entry)
+		return
 	}
+	m.applyAggregateChanges(m.aggregator.Add(entryPrefix(entry)))
 }
 
 // RemoveMember removes a member from the set of desired entries. Idempotent, if the member is no present, makes no
@@ -429,13 +674,50 @@ func (m *bpfIPSet) RemoveMember(entry IPSetEntry) {
 		return
 	}
 	m.DesiredEntries.Discard(entry)
-	if m.PendingAdds.Contains(entry) {
-		m.PendingAdds.Discard(entry)
-	} else {
-		m.PendingRemoves.Add(entry)
+	if !entry.IsExact() {
+		m.numPrefixEntries--
+	}
+	if m.members != nil {
+		m.members.Remove(entry, m.memberBit)
+		return
+	}
+	if entry.IsExact() {
+		m.exact.Remove(entry)
+	}
+	if entry.Protocol() != 0 {
+		m.lpm.Remove(entry)
+		return
+	}
+	m.applyAggregateChanges(m.aggregator.Remove(entryPrefix(entry)))
+}
+
+func (m *bpfIPSet) applyAggregateChanges(changes map[v4Prefix]bool) {
+	for cidr, added := range changes {
+		if added {
+			m.lpm.Add(cidr.entry(m.ID))
+		} else {
+			m.lpm.Remove(cidr.entry(m.ID))
+		}
 	}
 }
 
+// Exact returns true if all the desired entries of the IP set are full-length.
+func (m *bpfIPSet) Exact() bool {
+	return m.numPrefixEntries == 0
+}
+
 func (m *bpfIPSet) Dirty() bool {
-	return m.PendingRemoves.Len() > 0 || m.PendingAdds.Len() > 0 || m.Deleted
+	return m.lpm.Dirty() || m.exact.Dirty() || m.Deleted
+}
+
+// exactKeyToEntry returns the entry of a key of the exact-match map.
+func exactKeyToEntry(key []byte) IPSetEntry {
+	var entry IPSetEntry
+	binary.LittleEndian.PutUint32(entry[:4], 64 /* ID */ +32 /* IP */)
+	copy(entry[4:], key)
+	if entry.Protocol() != 0 {
+		// Named port entry, uses the full length of the key.
+		binary.LittleEndian.PutUint32(entry[:4], 64 /* ID */ +32 /* IP */ +16 /* Port */ +8 /* protocol */)
+	}
+	return entry
 }
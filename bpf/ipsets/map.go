@@ -40,16 +40,84 @@ const IPSetEntrySize = 20
 
 type IPSetEntry [IPSetEntrySize]byte
 
+var MapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ip_sets",
+	Type:       "lpm_trie",
+	KeySize:    IPSetEntrySize,
+	ValueSize:  4,
+	MaxEntries: 1024 * 1024,
+	Name:       "cali_v4_ip_sets",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+// MapReplicaParameters, ExactMapReplicaParameters and MembersMapReplicaParameters describe the
+// replicas of the IP set maps on the second NUMA node, see bpf.NUMAReplicatedMap.  Only the policy
+// programs use the IP set maps, polprog.Builder.EnableNUMAReplicas makes them pick the replicas.
+var (
+	MapReplicaParameters        = MapParameters.NUMAReplica("cali_v4_ips_n1")
+	ExactMapReplicaParameters   = ExactMapParameters.NUMAReplica("cali_v4_ipx_n1")
+	MembersMapReplicaParameters = MembersMapParameters.NUMAReplica("cali_v4_ipm_n1")
+)
+
 func Map(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(bpf.MapParameters{
-		Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ip_sets",
-		Type:       "lpm_trie",
-		KeySize:    IPSetEntrySize,
-		ValueSize:  4,
-		MaxEntries: 1024 * 1024,
-		Name:       "cali_v4_ip_sets",
-		Flags:      unix.BPF_F_NO_PREALLOC,
-	})
+	return mc.NewNUMAReplicatedMap(MapParameters, MapReplicaParameters)
+}
+
+// IPSetExactKeySize is the size of the key of the exact-match IP set map.  The key is the
+// IPSetEntry without its prefix length.
+// uint64 set_id BE     8
+// uint32 addr BE       +4 = 12
+// uint16 port HE       +2 = 14
+// uint8 proto          +1 = 15
+// uint8 pad            +1 = 16
+const IPSetExactKeySize = IPSetEntrySize - 4
+
+// ExactMapParameters describes a hash map that holds a copy of the full-length (/32 and named
+// port) members of every IP set.  Policy programs look up IP sets that have no prefix members in
+// this map instead of walking the LPM trie.
+var ExactMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ip_setx",
+	Type:       "hash",
+	KeySize:    IPSetExactKeySize,
+	ValueSize:  4,
+	MaxEntries: 1024 * 1024,
+	Name:       "cali_v4_ip_setx",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func ExactMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewNUMAReplicatedMap(ExactMapParameters, ExactMapReplicaParameters)
+}
+
+// MemberKeySize is the size of the key of the IP set member map.  The key is a member of one or
+// more IP sets, without the set ID.
+// uint32 prefixLen HE  4
+// uint32 addr BE       +4 = 8
+// uint16 port HE       +2 = 10
+// uint8 proto          +1 = 11
+// uint8 pad            +1 = 12
+const MemberKeySize = 12
+
+// MemberSetBits is the number of IP sets that the member map can hold.  Each of those IP sets has
+// a bit in the value of the map.
+const MemberSetBits = 512
+
+// MembersMapParameters describes an LPM trie that holds one entry per member of the IP sets that
+// are stored in it, rather than one per member of each IP set.  The value of an entry is a bitmap
+// with a bit for each IP set that contains the member, or a CIDR that covers it.  Policy programs
+// test the bit of the IP set after a single lookup of the address.
+var MembersMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ip_memb",
+	Type:       "lpm_trie",
+	KeySize:    MemberKeySize,
+	ValueSize:  MemberSetBits / 8,
+	MaxEntries: 1024 * 1024,
+	Name:       "cali_v4_ip_memb",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func MembersMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewNUMAReplicatedMap(MembersMapParameters, MembersMapReplicaParameters)
 }
 
 func (e IPSetEntry) SetID() uint64 {
@@ -72,6 +140,17 @@ func (e IPSetEntry) Port() uint16 {
 	return binary.LittleEndian.Uint16(e[16:18])
 }
 
+// IsExact returns true if the entry matches a single address (and port), i.e. if it can be stored
+// in the exact-match map.
+func (e IPSetEntry) IsExact() bool {
+	return e.PrefixLen() >= 64 /* ID */ +32 /* IP */
+}
+
+// ExactKey returns the key of the entry in the exact-match map.
+func (e IPSetEntry) ExactKey() []byte {
+	return e[4:]
+}
+
 func MakeBPFIPSetEntry(setID uint64, cidr ip.V4CIDR, port uint16, proto uint8) *IPSetEntry {
 	var entry IPSetEntry
 	// TODO Detect endianness
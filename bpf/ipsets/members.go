@@ -0,0 +1,290 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ipsets
+
+import (
+	"encoding/binary"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+
+	"github.com/projectcalico/libcalico-go/lib/set"
+)
+
+// memberKey is a key of the member map, see MembersMapParameters.
+type memberKey struct {
+	// addr is in host byte order.
+	addr  uint32
+	port  uint16
+	proto uint8
+	// prefixLen is the number of bits of the address, port and protocol that the key matches, at
+	// most 32 for a CIDR and 56 for a named port.
+	prefixLen uint8
+}
+
+const namedPortPrefixLen = 32 /* IP */ + 16 /* Port */ + 8 /* protocol */
+
+func memberKeyOfEntry(e IPSetEntry) memberKey {
+	return memberKey{
+		addr:      binary.BigEndian.Uint32(e[12:16]),
+		port:      e.Port(),
+		proto:     e.Protocol(),
+		prefixLen: uint8(e.PrefixLen() - 64 /* ID */),
+	}
+}
+
+func memberKeyFromBytes(b []byte) memberKey {
+	return memberKey{
+		prefixLen: uint8(binary.LittleEndian.Uint32(b[0:4])),
+		addr:      binary.BigEndian.Uint32(b[4:8]),
+		port:      binary.LittleEndian.Uint16(b[8:10]),
+		proto:     b[10],
+	}
+}
+
+func (k memberKey) AsBytes() []byte {
+	b := make([]byte, MemberKeySize)
+	binary.LittleEndian.PutUint32(b[0:4], uint32(k.prefixLen))
+	binary.BigEndian.PutUint32(b[4:8], k.addr)
+	binary.LittleEndian.PutUint16(b[8:10], k.port)
+	b[10] = k.proto
+	return b
+}
+
+func (k memberKey) isNamedPort() bool {
+	return k.prefixLen > 32
+}
+
+// contains returns true if a lookup that matches o also matches k.
+func (k memberKey) contains(o memberKey) bool {
+	if k.isNamedPort() {
+		return k == o
+	}
+	return o.prefixLen >= k.prefixLen && newV4Prefix(o.addr, k.prefixLen).addr == k.addr
+}
+
+// memberBits is the value of the member map, a bitmap with a bit per IP set.  Bit i is bit i%8 of
+// byte i/8, see polprog.Builder.EnableMemberIPSets.
+type memberBits [MemberSetBits / 8]byte
+
+func (b *memberBits) set(i int) {
+	b[i/8] |= 1 << (i % 8)
+}
+
+func (b *memberBits) clear(i int) {
+	b[i/8] &^= 1 << (i % 8)
+}
+
+func (b *memberBits) isZero() bool {
+	return *b == memberBits{}
+}
+
+func (b *memberBits) or(o *memberBits) {
+	for i := range b {
+		b[i] |= o[i]
+	}
+}
+
+// memberTable keeps the member map in sync with the members of the IP sets that are stored in it.
+// The IP sets are given the bits of the map's value, MemberSetBits of them; IP sets that come
+// after those are stored per set.
+//
+// The member map is an LPM trie, so a lookup only finds the longest key that matches.  The value
+// of each key therefore carries the bits of the keys that cover it as well as its own: with
+// 10.0.0.0/8 in one IP set and 10.0.0.1 in another, the key of 10.0.0.1 has both bits.  Changing
+// the IP sets of a key rewrites the keys under it too, which is cheap for addresses, the common
+// case, and needs a scan of the table for a CIDR.
+type memberTable struct {
+	bpfMap bpf.Map
+
+	// own holds the bits of the IP sets that have each key as a member.
+	own map[memberKey]*memberBits
+	// namedPorts indexes the named port keys by address, they are under the key of the address.
+	namedPorts map[uint32]map[memberKey]struct{}
+
+	dirtyKeys set.Set /* of memberKey */
+
+	freeBits []int
+	nextBit  int
+}
+
+func newMemberTable(bpfMap bpf.Map) *memberTable {
+	return &memberTable{
+		bpfMap:     bpfMap,
+		own:        map[memberKey]*memberBits{},
+		namedPorts: map[uint32]map[memberKey]struct{}{},
+		dirtyKeys:  set.New(),
+	}
+}
+
+// AllocBit returns a free bit for an IP set, or false if all of them are in use.
+func (t *memberTable) AllocBit() (int, bool) {
+	if n := len(t.freeBits); n > 0 {
+		bit := t.freeBits[n-1]
+		t.freeBits = t.freeBits[:n-1]
+		return bit, true
+	}
+	if t.nextBit >= MemberSetBits {
+		return 0, false
+	}
+	t.nextBit++
+	return t.nextBit - 1, true
+}
+
+// ReleaseBit makes the bit of a removed IP set available again.  It must only be called once the
+// bit is clear in the dataplane, see Clean.
+func (t *memberTable) ReleaseBit(bit int) {
+	t.freeBits = append(t.freeBits, bit)
+}
+
+// Add adds the entry to the IP set with the given bit.  Returns false if it was already present.
+func (t *memberTable) Add(e IPSetEntry, bit int) bool {
+	k := memberKeyOfEntry(e)
+	bits := t.own[k]
+	if bits == nil {
+		bits = &memberBits{}
+		t.own[k] = bits
+		if k.isNamedPort() {
+			if t.namedPorts[k.addr] == nil {
+				t.namedPorts[k.addr] = map[memberKey]struct{}{}
+			}
+			t.namedPorts[k.addr][k] = struct{}{}
+		}
+	}
+	before := *bits
+	bits.set(bit)
+	if *bits == before {
+		return false
+	}
+	t.markDirty(k)
+	return true
+}
+
+// Remove removes the entry from the IP set with the given bit.  Returns false if it was not
+// present.
+func (t *memberTable) Remove(e IPSetEntry, bit int) bool {
+	k := memberKeyOfEntry(e)
+	bits := t.own[k]
+	if bits == nil {
+		return false
+	}
+	before := *bits
+	bits.clear(bit)
+	if *bits == before {
+		return false
+	}
+	if bits.isZero() {
+		delete(t.own, k)
+		if k.isNamedPort() {
+			delete(t.namedPorts[k.addr], k)
+			if len(t.namedPorts[k.addr]) == 0 {
+				delete(t.namedPorts, k.addr)
+			}
+		}
+	}
+	t.markDirty(k)
+	return true
+}
+
+// markDirty marks the key and the keys under it for rewriting.
+func (t *memberTable) markDirty(k memberKey) {
+	t.dirtyKeys.Add(k)
+	switch {
+	case k.isNamedPort():
+	case k.prefixLen == 32:
+		for o := range t.namedPorts[k.addr] {
+			t.dirtyKeys.Add(o)
+		}
+	default:
+		for o := range t.own {
+			if k.contains(o) {
+				t.dirtyKeys.Add(o)
+			}
+		}
+	}
+}
+
+// value returns the bits of the key and of the keys that cover it.
+func (t *memberTable) value(k memberKey) memberBits {
+	var v memberBits
+	maxLen := k.prefixLen
+	if k.isNamedPort() {
+		if bits := t.own[k]; bits != nil {
+			v.or(bits)
+		}
+		maxLen = 32
+	}
+	for l := 0; l <= int(maxLen); l++ {
+		a := memberKey{addr: newV4Prefix(k.addr, uint8(l)).addr, prefixLen: uint8(l)}
+		if bits := t.own[a]; bits != nil {
+			v.or(bits)
+		}
+	}
+	return v
+}
+
+// Clean returns true if the dataplane is in sync.
+func (t *memberTable) Clean() bool {
+	return t.dirtyKeys.Len() == 0
+}
+
+// QueueResync rewrites every key on the next Apply and removes the keys that the dataplane has
+// but the IP sets do not.
+func (t *memberTable) QueueResync() error {
+	var unknownKeys [][]byte
+	err := t.bpfMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		if _, ok := t.own[memberKeyFromBytes(k)]; !ok {
+			unknownKeys = append(unknownKeys, append([]byte(nil), k...))
+		}
+		return bpf.IterNone
+	})
+	for _, k := range unknownKeys {
+		t.dirtyKeys.Add(memberKeyFromBytes(k))
+	}
+	for k := range t.own {
+		t.dirtyKeys.Add(k)
+	}
+	return err
+}
+
+// Apply writes the dirty keys to the dataplane.  It returns the number of keys that it wrote or
+// removed.  Keys that fail stay dirty.
+func (t *memberTable) Apply() (numUpdates uint) {
+	debug := log.GetLevel() >= log.DebugLevel
+	t.dirtyKeys.Iter(func(item interface{}) error {
+		k := item.(memberKey)
+		if _, ok := t.own[k]; !ok {
+			err := t.bpfMap.Delete(k.AsBytes())
+			if err != nil && !bpf.IsNotExists(err) {
+				log.WithError(err).WithField("key", k).Error("Failed to remove IP set member entry")
+				return nil
+			}
+		} else {
+			v := t.value(k)
+			if debug {
+				log.WithFields(log.Fields{"key": k, "value": v}).Debug("Writing IP set member entry")
+			}
+			err := t.bpfMap.Update(k.AsBytes(), v[:])
+			if err != nil {
+				log.WithError(err).WithField("key", k).Error("Failed to write IP set member entry")
+				return nil
+			}
+		}
+		numUpdates++
+		return set.RemoveItem
+	})
+	return
+}
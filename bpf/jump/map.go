@@ -18,13 +18,22 @@ import (
 	"github.com/projectcalico/felix/bpf"
 )
 
-func MapForTest(mc *bpf.MapContext) bpf.Map {
+// MaxEntries is the size of the cali_jump map of the TC programs.
+// WARNING: must be kept in sync with cali_jump in bpf-gpl/jump.h.
+const MaxEntries = 16
+
+// Map returns a cali_jump map that is pinned at filename.
+func Map(mc *bpf.MapContext, filename string) bpf.Map {
 	return mc.NewPinnedMap(bpf.MapParameters{
-		Filename:   "/sys/fs/bpf/tc/globals/cali_v4_jump",
+		Filename:   filename,
 		Type:       "prog_array",
 		KeySize:    4,
 		ValueSize:  4,
-		MaxEntries: 8,
+		MaxEntries: MaxEntries,
 		Name:       "cali_jump",
 	})
 }
+
+func MapForTest(mc *bpf.MapContext) bpf.Map {
+	return Map(mc, "/sys/fs/bpf/tc/globals/cali_v4_jump")
+}
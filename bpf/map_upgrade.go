@@ -0,0 +1,152 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf
+
+import (
+	"os"
+	"time"
+
+	"github.com/pkg/errors"
+	"github.com/sirupsen/logrus"
+)
+
+// MapUpgrade describes how to carry the entries of an older version of a map over to the current
+// one.  When a release changes the layout of a map's entries it bumps the map's version, so the new
+// programs get a new map; without an upgrade the new map starts empty, which, for the conntrack
+// map, means that every existing flow is treated as a mid-flow miss.
+type MapUpgrade struct {
+	// From describes the older version of the map.  Only its Filename, Version, KeySize,
+	// ValueSize and MaxEntries are used.
+	From MapParameters
+	// Convert returns the entry in the current layout, or a nil key to drop it.  k and v are only
+	// valid for the duration of the call.
+	Convert func(k, v []byte) (newK, newV []byte)
+}
+
+// NewPinnedMapWithUpgrades is like NewPinnedMap but, when EnsureExists creates the map, it first
+// looks for the older versions of the map, newest first, and converts the entries of the first one
+// that is pinned.  The older map is then unpinned; the programs that still use it keep it alive
+// until they are replaced.
+func (c *MapContext) NewPinnedMapWithUpgrades(params MapParameters, upgrades ...MapUpgrade) Map {
+	m := c.NewPinnedMap(params).(*PinnedMap)
+	m.upgrades = upgrades
+	return m
+}
+
+func (b *PinnedMap) upgradeFromOlderVersions() {
+	for i := len(b.upgrades) - 1; i >= 0; i-- {
+		u := b.upgrades[i]
+		path := u.From.versionedFilename()
+		if _, err := os.Stat(path); err != nil {
+			continue
+		}
+		log := logrus.WithFields(logrus.Fields{"from": path, "to": b.versionedFilename()})
+		fd, err := GetMapFDByPin(path)
+		if err != nil {
+			log.WithError(err).Warn("Failed to open the previous version of the map, its entries are lost.")
+			return
+		}
+		b.migrateFrom(fd, u.From, u.Convert)
+		_ = fd.Close()
+		if err := os.Remove(path); err != nil {
+			log.WithError(err).Warn("Failed to unpin the previous version of the map.")
+		}
+		return
+	}
+}
+
+// migrateBatchNumKeys is the number of entries that migrateFrom writes per batch.
+const migrateBatchNumKeys = MapDeleteBatchNumKeys
+
+// migrateFrom copies the entries of the map open at fromFD into the map, which must be open and
+// empty, converting them with convert if it is set.  Entries are read and written in batches where
+// the kernel supports it.  Failures are logged, the map is usable even if only some of the entries
+// made it.
+func (b *PinnedMap) migrateFrom(fromFD MapFD, from MapParameters, convert func(k, v []byte) ([]byte, []byte)) {
+	log := logrus.WithFields(logrus.Fields{"from": from.versionedFilename(), "to": b.versionedFilename()})
+	if b.perCPU || from.KeySize == 0 || from.ValueSize == 0 {
+		log.Info("Not migrating the entries of a per-CPU map.")
+		return
+	}
+	if convert == nil && (from.KeySize != b.KeySize || from.ValueSize != b.ValueSize) {
+		log.Warn("Map layout changed without a conversion, its entries are lost.")
+		return
+	}
+
+	start := time.Now()
+	n, err := b.copyEntries(fromFD, from, convert)
+	log = log.WithFields(logrus.Fields{"entries": n, "timeTaken": time.Since(start)})
+	if err != nil {
+		log.WithError(err).Error("Failed to migrate all the entries of the map.")
+		return
+	}
+	log.Info("Migrated the entries of the map.")
+}
+
+func (b *PinnedMap) copyEntries(fromFD MapFD, from MapParameters, convert func(k, v []byte) ([]byte, []byte)) (int, error) {
+	it, err := NewMapIterator(fromFD, from.KeySize, from.ValueSize, from.MaxEntries)
+	if err != nil {
+		return 0, errors.Wrap(err, "failed to create BPF map iterator")
+	}
+	defer func() {
+		err := it.Close()
+		if err != nil {
+			logrus.WithError(err).Panic("Unexpected error from map iterator Close().")
+		}
+	}()
+
+	keys := make([]byte, 0, migrateBatchNumKeys*b.KeySize)
+	values := make([]byte, 0, migrateBatchNumKeys*b.ValueSize)
+	numCopied := 0
+	flush := func() error {
+		if len(keys) == 0 {
+			return nil
+		}
+		err := UpdateMapEntries(b.fd, keys, values, b.KeySize, b.ValueSize)
+		if err != nil {
+			return errors.Wrap(err, "failed to write map entries")
+		}
+		numCopied += len(keys) / b.KeySize
+		keys, values = keys[:0], values[:0]
+		return nil
+	}
+
+	for {
+		k, v, err := it.Next()
+		if err == ErrIterationFinished {
+			break
+		}
+		if err != nil {
+			return numCopied, errors.Wrap(err, "failed to read map entries")
+		}
+		if convert != nil {
+			k, v = convert(k, v)
+			if k == nil {
+				continue
+			}
+		}
+		if len(k) != b.KeySize || len(v) != b.ValueSize {
+			logrus.WithFields(logrus.Fields{"key": k, "value": v}).Panic("Bug: map entry conversion returned the wrong sizes")
+		}
+		keys = append(keys, k...)
+		values = append(values, v...)
+		if len(keys) >= migrateBatchNumKeys*b.KeySize {
+			if err := flush(); err != nil {
+				return numCopied, err
+			}
+		}
+	}
+	return numCopied, flush()
+}
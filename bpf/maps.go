@@ -17,9 +17,12 @@ package bpf
 import (
 	"encoding/json"
 	"fmt"
+	"io/ioutil"
 	"os"
 	"os/exec"
+	"strconv"
 	"strings"
+	"sync"
 
 	"golang.org/x/sys/unix"
 
@@ -53,6 +56,27 @@ type Map interface {
 	Delete(k []byte) error
 }
 
+// MapGroup is a Map that is made up of several pinned maps, which must all be given to a program
+// that uses it.
+type MapGroup interface {
+	Map
+	Maps() []Map
+}
+
+// PinnedMaps expands the MapGroups among the maps into the maps that they are made up of.  A group
+// may itself be made up of groups, such as the NUMA replicated tiers of the NAT frontend map.
+func PinnedMaps(maps []Map) []Map {
+	var ret []Map
+	for _, m := range maps {
+		if g, ok := m.(MapGroup); ok {
+			ret = append(ret, PinnedMaps(g.Maps())...)
+		} else {
+			ret = append(ret, m)
+		}
+	}
+	return ret
+}
+
 type MapParameters struct {
 	Filename   string
 	Type       string
@@ -62,6 +86,24 @@ type MapParameters struct {
 	Name       string
 	Flags      int
 	Version    int
+	// NUMANode is the NUMA node that the kernel allocates the map on if Flags has
+	// BPF_F_NUMA_NODE, see MapContext.NUMANodes.
+	NUMANode int
+}
+
+// mapTypes maps the bpftool names of the map types that we use to their kernel values.
+var mapTypes = map[string]uint32{
+	"hash":            unix.BPF_MAP_TYPE_HASH,
+	"array":           unix.BPF_MAP_TYPE_ARRAY,
+	"prog_array":      unix.BPF_MAP_TYPE_PROG_ARRAY,
+	"percpu_array":    unix.BPF_MAP_TYPE_PERCPU_ARRAY,
+	"lru_hash":        unix.BPF_MAP_TYPE_LRU_HASH,
+	"lru_percpu_hash": unix.BPF_MAP_TYPE_LRU_PERCPU_HASH,
+	"lpm_trie":        unix.BPF_MAP_TYPE_LPM_TRIE,
+	"sock_hash":       unix.BPF_MAP_TYPE_SOCKHASH,
+	"devmap_hash":     unix.BPF_MAP_TYPE_DEVMAP_HASH,
+	"cpumap":          unix.BPF_MAP_TYPE_CPUMAP,
+	"ringbuf":         unix.BPF_MAP_TYPE_RINGBUF,
 }
 
 func versionedStr(ver int, str string) string {
@@ -76,18 +118,40 @@ func (mp *MapParameters) versionedName() string {
 	return versionedStr(mp.Version, mp.Name)
 }
 
+// VersionedName returns the name of the map as it appears in the BPF programs and in MapContext.MapSizes.
+func (mp *MapParameters) VersionedName() string {
+	return mp.versionedName()
+}
+
 func (mp *MapParameters) versionedFilename() string {
 	return versionedStr(mp.Version, mp.Filename)
 }
 
 type MapContext struct {
 	RepinningEnabled bool
+	// MapSizes overrides the MaxEntries of the maps, indexed by versioned map name.  The same
+	// sizes must be patched into the programs that use the maps.
+	MapSizes map[string]uint32
+	// NUMANodes places the maps on NUMA nodes, indexed by versioned map name.  The maps are
+	// created with BPF_F_NUMA_NODE, which must be patched into the programs that use them too,
+	// see Binary.PatchMapNUMANode.
+	NUMANodes map[string]int
+	// NUMAReplicasEnabled makes NewNUMAReplicatedMap replicate the read-mostly maps to the
+	// second NUMA node.
+	NUMAReplicasEnabled bool
 }
 
 func (c *MapContext) NewPinnedMap(params MapParameters) Map {
 	if len(params.versionedName()) >= unix.BPF_OBJ_NAME_LEN {
 		logrus.WithField("name", params.Name).Panic("Bug: BPF map name too long")
 	}
+	if size := c.MapSizes[params.versionedName()]; size != 0 {
+		params.MaxEntries = int(size)
+	}
+	if node, ok := c.NUMANodes[params.versionedName()]; ok {
+		params.Flags |= unix.BPF_F_NUMA_NODE
+		params.NUMANode = node
+	}
 	m := &PinnedMap{
 		context:       c,
 		MapParameters: params,
@@ -103,6 +167,8 @@ type PinnedMap struct {
 	fdLoaded bool
 	fd       MapFD
 	perCPU   bool
+	// upgrades lists the older versions of the map whose entries EnsureExists carries over.
+	upgrades []MapUpgrade
 }
 
 func (b *PinnedMap) GetName() string {
@@ -127,6 +193,11 @@ func (b *PinnedMap) Close() error {
 	return err
 }
 
+// Context returns the MapContext that the map was created with.
+func (b *PinnedMap) Context() *MapContext {
+	return b.context
+}
+
 func (b *PinnedMap) RepinningEnabled() bool {
 	if b.context == nil {
 		return false
@@ -202,6 +273,10 @@ func IterMapCmdOutput(output []byte, f IterCallback) error {
 // Iter iterates over the map, passing each key/value pair to the provided callback function.  Warning:
 // The key and value are owned by the iterator and will be clobbered by the next iteration so they must not be
 // retained or modified.
+//
+// When the kernel supports batch operations, the map is read with BPF_MAP_LOOKUP_BATCH and keys that the callback
+// asks us to delete are queued up and removed with BPF_MAP_DELETE_BATCH.  Deleting entries behind the batch cursor
+// doesn't disturb the iteration so the deletes can be deferred safely.
 func (b *PinnedMap) Iter(f IterCallback) error {
 	it, err := NewMapIterator(b.MapFD(), b.KeySize, b.ValueSize, b.MaxEntries)
 	if err != nil {
@@ -214,12 +289,22 @@ func (b *PinnedMap) Iter(f IterCallback) error {
 		}
 	}()
 
+	var pendingDeletes []byte
+	flushDeletes := func() error {
+		err := DeleteMapEntriesBatch(b.MapFD(), pendingDeletes, b.KeySize)
+		pendingDeletes = pendingDeletes[:0]
+		if err != nil && !IsNotExists(err) {
+			return fmt.Errorf("failed to delete map entries: %w", err)
+		}
+		return nil
+	}
+
 	keyToDelete := make([]byte, b.KeySize)
 	var action IteratorAction
 	for {
 		k, v, err := it.Next()
 
-		if action == IterDelete {
+		if action == IterDelete && !it.Batched() {
 			// The previous iteration asked us to delete its key; do that now before we check for the end of
 			// the iteration.
 			err := DeleteMapEntry(b.MapFD(), keyToDelete, b.ValueSize)
@@ -229,6 +314,9 @@ func (b *PinnedMap) Iter(f IterCallback) error {
 		}
 
 		if err != nil {
+			if ferr := flushDeletes(); ferr != nil {
+				return ferr
+			}
 			if err == ErrIterationFinished {
 				return nil
 			}
@@ -238,28 +326,254 @@ func (b *PinnedMap) Iter(f IterCallback) error {
 		action = f(k, v)
 
 		if action == IterDelete {
-			// k will become invalid once we call Next again so take a copy.
-			copy(keyToDelete, k)
+			if it.Batched() {
+				pendingDeletes = append(pendingDeletes, k...)
+				if len(pendingDeletes) >= MapDeleteBatchNumKeys*b.KeySize {
+					if err := flushDeletes(); err != nil {
+						return err
+					}
+				}
+			} else {
+				// k will become invalid once we call Next again so take a copy.
+				copy(keyToDelete, k)
+			}
+		}
+	}
+}
+
+// BatchCallback is called by LoadBatches with n key/value pairs, packed back-to-back.  The slices are only valid
+// for the duration of the call.
+type BatchCallback func(keys, values []byte, n int)
+
+// LoadBatches passes all the entries of the map to the callback, a batch at a time.  For pinned maps, the batches
+// are the ones that the kernel returns, so loading a whole map costs a call per batch rather than per entry.  Other
+// maps are read with Iter and their entries passed on in batches of up to MapIteratorBatchNumKeys.  For a
+// NUMAReplicatedMap, it reads the primary map.
+func LoadBatches(m Map, f BatchCallback) error {
+	if g, ok := m.(*NUMAReplicatedMap); ok {
+		m = g.primary
+	}
+	if pm, ok := m.(*PinnedMap); ok && !pm.perCPU {
+		return pm.loadBatches(f)
+	}
+
+	var keys, values []byte
+	n := 0
+	err := m.Iter(func(k, v []byte) IteratorAction {
+		keys = append(keys, k...)
+		values = append(values, v...)
+		n++
+		if n == MapIteratorBatchNumKeys {
+			f(keys, values, n)
+			keys, values, n = keys[:0], values[:0], 0
+		}
+		return IterNone
+	})
+	if err != nil {
+		return err
+	}
+	if n > 0 {
+		f(keys, values, n)
+	}
+	return nil
+}
+
+func (b *PinnedMap) loadBatches(f BatchCallback) error {
+	it, err := NewMapIterator(b.MapFD(), b.KeySize, b.ValueSize, b.MaxEntries)
+	if err != nil {
+		return fmt.Errorf("failed to create BPF map iterator: %w", err)
+	}
+	defer func() {
+		err := it.Close()
+		if err != nil {
+			logrus.WithError(err).Panic("Unexpected error from map iterator Close().")
+		}
+	}()
+
+	for {
+		keys, values, n, err := it.NextBatch()
+		if err == ErrIterationFinished {
+			return nil
+		}
+		if err != nil {
+			return errors.Errorf("iterating the map failed: %s", err)
 		}
+		f(keys, values, n)
 	}
 }
 
+// DeleteAll removes all entries from the map.  It uses BPF_MAP_LOOKUP_AND_DELETE_BATCH where possible, falling back
+// to iterating over the map and deleting each entry.
+func DeleteAll(m Map) error {
+	if g, ok := m.(*NUMAReplicatedMap); ok {
+		for _, r := range g.Maps() {
+			if err := DeleteAll(r); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+	if pm, ok := m.(*PinnedMap); ok && MapBatchOpsSupported() {
+		n, err := DrainMap(pm.MapFD(), pm.KeySize, pm.ValueSize)
+		if err == nil {
+			logrus.WithFields(logrus.Fields{"map": pm.GetName(), "deleted": n}).Debug("Drained map")
+			return nil
+		}
+		if err != ErrBatchNotSupported {
+			return fmt.Errorf("failed to drain map: %w", err)
+		}
+	}
+
+	return m.Iter(func(k, v []byte) IteratorAction {
+		return IterDelete
+	})
+}
+
+// UpdateBatch sets the values of the given keys, which must be packed back-to-back at keySize and valueSize.  It
+// uses BPF_MAP_UPDATE_BATCH where possible, falling back to updating each entry.  If it fails, some of the entries
+// may have been updated.
+func UpdateBatch(m Map, keys, values []byte, keySize, valueSize int) error {
+	if len(keys) == 0 {
+		return nil
+	}
+	if g, ok := m.(*NUMAReplicatedMap); ok {
+		for _, r := range g.Maps() {
+			if err := UpdateBatch(r, keys, values, keySize, valueSize); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+	if pm, ok := m.(*PinnedMap); ok && !pm.perCPU {
+		return UpdateMapEntries(pm.MapFD(), keys, values, keySize, valueSize)
+	}
+
+	for i, j := 0, 0; i+keySize <= len(keys); i, j = i+keySize, j+valueSize {
+		err := m.Update(keys[i:i+keySize], values[j:j+valueSize])
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// DeleteBatch deletes the given keys, which must be packed back-to-back at keySize, skipping the ones that don't
+// exist.  It uses BPF_MAP_DELETE_BATCH where possible, falling back to deleting each entry.
+func DeleteBatch(m Map, keys []byte, keySize int) error {
+	if g, ok := m.(*NUMAReplicatedMap); ok {
+		for _, r := range g.Maps() {
+			if err := DeleteBatch(r, keys, keySize); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+	if pm, ok := m.(*PinnedMap); ok {
+		return DeleteMapEntriesBatch(pm.MapFD(), keys, keySize)
+	}
+
+	for i := 0; i+keySize <= len(keys); i += keySize {
+		err := m.Delete(keys[i : i+keySize])
+		if err != nil && !IsNotExists(err) {
+			return err
+		}
+	}
+	return nil
+}
+
+// Update sets the value for the given key.  For per-CPU maps, v may either hold the values for all the possible
+// CPUs, laid out like the ones returned by Get, or a single value that is then set for every CPU.
 func (b *PinnedMap) Update(k, v []byte) error {
-	if b.perCPU {
-		// Per-CPU maps need a buffer of value-size * num-CPUs.
-		logrus.Panic("Per-CPU operations not implemented")
+	if b.perCPU && len(v) == b.ValueSize {
+		numCPUs, err := NumPossibleCPUs()
+		if err != nil {
+			return err
+		}
+		stride := align64(b.ValueSize)
+		buf := make([]byte, stride*numCPUs)
+		for i := 0; i < numCPUs; i++ {
+			copy(buf[i*stride:], v)
+		}
+		v = buf
 	}
 	return UpdateMapEntry(b.fd, k, v)
 }
 
+// Get looks up the value for the given key.  For per-CPU maps, the returned slice contains one value for each
+// possible CPU, each padded to a multiple of 8 bytes; see PerCPUValues.
 func (b *PinnedMap) Get(k []byte) ([]byte, error) {
 	if b.perCPU {
-		// Per-CPU maps need a buffer of value-size * num-CPUs.
-		logrus.Panic("Per-CPU operations not implemented")
+		numCPUs, err := NumPossibleCPUs()
+		if err != nil {
+			return nil, err
+		}
+		return GetMapEntryPerCPU(b.fd, k, b.ValueSize, numCPUs)
 	}
 	return GetMapEntry(b.fd, k, b.ValueSize)
 }
 
+// PerCPUValues splits the value returned by Get on a per-CPU map into one slice per CPU.
+func PerCPUValues(v []byte, valueSize int) [][]byte {
+	stride := align64(valueSize)
+	var values [][]byte
+	for i := 0; i+stride <= len(v); i += stride {
+		values = append(values, v[i:i+valueSize])
+	}
+	return values
+}
+
+// align64 rounds up the given size to the nearest 8-bytes.
+func align64(size int) int {
+	if size%8 == 0 {
+		return size
+	}
+	return size + (8 - (size % 8))
+}
+
+var (
+	numPossibleCPUsOnce sync.Once
+	numPossibleCPUs     int
+	numPossibleCPUsErr  error
+)
+
+// NumPossibleCPUs returns the number of possible CPUs, which is the number of values that the kernel returns for
+// a per-CPU map.  That may be more than the number of online CPUs.
+func NumPossibleCPUs() (int, error) {
+	numPossibleCPUsOnce.Do(func() {
+		var data []byte
+		data, numPossibleCPUsErr = ioutil.ReadFile("/sys/devices/system/cpu/possible")
+		if numPossibleCPUsErr != nil {
+			return
+		}
+		numPossibleCPUs, numPossibleCPUsErr = parseCPURanges(strings.TrimSpace(string(data)))
+	})
+	return numPossibleCPUs, numPossibleCPUsErr
+}
+
+// parseCPURanges parses a CPU list in the kernel's format, such as "0-3,5", and returns the number of CPUs.
+func parseCPURanges(s string) (int, error) {
+	n := 0
+	for _, r := range strings.Split(s, ",") {
+		parts := strings.SplitN(r, "-", 2)
+		first, err := strconv.Atoi(parts[0])
+		if err != nil {
+			return 0, fmt.Errorf("failed to parse CPU range %q: %w", r, err)
+		}
+		last := first
+		if len(parts) == 2 {
+			last, err = strconv.Atoi(parts[1])
+			if err != nil {
+				return 0, fmt.Errorf("failed to parse CPU range %q: %w", r, err)
+			}
+		}
+		if last < first {
+			return 0, fmt.Errorf("bad CPU range %q", r)
+		}
+		n += last - first + 1
+	}
+	return n, nil
+}
+
 func (b *PinnedMap) Delete(k []byte) error {
 	if b.perCPU {
 		logrus.Panic("Per-CPU operations not implemented")
@@ -320,10 +634,44 @@ func (b *PinnedMap) EnsureExists() error {
 	}
 
 	if err := b.Open(); err == nil {
+		if !b.paramsMismatch() {
+			return nil
+		}
+		// The type and size of some maps are configurable.  The programs can't use a pinned map
+		// that doesn't match their definition so we have to replace it.  We keep the old map open
+		// to copy its entries into the new one.
+		logrus.WithField("name", b.versionedFilename()).Warn(
+			"Existing map has a different type or size to the one configured, recreating it.")
+		oldFD := b.fd
+		b.fd = 0
+		b.fdLoaded = false
+		defer oldFD.Close()
+		from := b.MapParameters
+		if info, err := GetMapInfo(oldFD); err == nil {
+			from.MaxEntries = info.MaxEntries
+		}
+		if err := os.Remove(b.versionedFilename()); err != nil {
+			return err
+		}
+		if err := b.create(); err != nil {
+			return err
+		}
+		b.migrateFrom(oldFD, from, nil)
 		return nil
 	}
 
 	logrus.Debug("Map didn't exist, creating it")
+	if err := b.create(); err != nil {
+		return err
+	}
+	b.upgradeFromOlderVersions()
+	return nil
+}
+
+func (b *PinnedMap) create() error {
+	if b.Flags&unix.BPF_F_NUMA_NODE != 0 {
+		return b.createOnNUMANode()
+	}
 	cmd := exec.Command("bpftool", "map", "create", b.versionedFilename(),
 		"type", b.Type,
 		"key", fmt.Sprint(b.KeySize),
@@ -346,6 +694,51 @@ func (b *PinnedMap) EnsureExists() error {
 	return err
 }
 
+// createOnNUMANode creates the map with the BPF syscall, bpftool can't place a map on a NUMA node.
+func (b *PinnedMap) createOnNUMANode() error {
+	mapType, ok := mapTypes[b.Type]
+	if !ok {
+		return errors.Errorf("unknown map type %q", b.Type)
+	}
+	fd, err := CreateMap(mapType, uint32(b.KeySize), uint32(b.ValueSize), uint32(b.MaxEntries),
+		uint32(b.Flags), uint32(b.NUMANode), b.versionedName())
+	if err != nil {
+		logrus.WithError(err).WithFields(logrus.Fields{
+			"name": b.versionedName(),
+			"node": b.NUMANode,
+		}).Error("Failed to create map on NUMA node")
+		return err
+	}
+	err = PinMap(fd, b.versionedFilename())
+	if err != nil {
+		_ = fd.Close()
+		return err
+	}
+	b.fd = fd
+	b.fdLoaded = true
+	logrus.WithFields(logrus.Fields{"fd": fd, "name": b.versionedFilename(), "node": b.NUMANode}).
+		Info("Created map on NUMA node.")
+	return nil
+}
+
+func (b *PinnedMap) paramsMismatch() bool {
+	want, ok := mapTypes[b.Type]
+	if !ok {
+		return false
+	}
+	info, err := GetMapInfo(b.fd)
+	if err != nil {
+		logrus.WithError(err).WithField("name", b.versionedFilename()).Warn("Failed to get map info.")
+		return false
+	}
+	// Only compare the flags that are configurable, the programs may create maps with flags
+	// that the parameters don't mention.  The kernel doesn't tell us the NUMA node of a map, only
+	// whether it has one.
+	const configurableFlags = unix.BPF_F_NO_COMMON_LRU | unix.BPF_F_NUMA_NODE
+	return uint32(info.Type) != want || info.MaxEntries != b.MaxEntries ||
+		info.Flags&configurableFlags != b.Flags&configurableFlags
+}
+
 type bpftoolMapMeta struct {
 	ID   int    `json:"id"`
 	Name string `json:"name"`
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf_test
+
+import (
+	"fmt"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+func TestLoadBatchesFallback(t *testing.T) {
+	RegisterTestingT(t)
+
+	params := bpf.MapParameters{Name: "cali_test", KeySize: 4, ValueSize: 1, MaxEntries: 4096}
+	m := mock.NewMockMap(params)
+	for i := 0; i < bpf.MapIteratorBatchNumKeys+10; i++ {
+		m.Contents[fmt.Sprintf("%04d", i)] = "v"
+	}
+
+	loaded := map[string]string{}
+	var batches []int
+	err := bpf.LoadBatches(m, func(keys, values []byte, n int) {
+		Expect(keys).To(HaveLen(n * params.KeySize))
+		Expect(values).To(HaveLen(n * params.ValueSize))
+		for i := 0; i < n; i++ {
+			loaded[string(keys[i*4:i*4+4])] = string(values[i : i+1])
+		}
+		batches = append(batches, n)
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(loaded).To(Equal(m.Contents))
+	Expect(batches).To(Equal([]int{bpf.MapIteratorBatchNumKeys, 10}))
+}
@@ -93,6 +93,11 @@ type SockopsInfo struct {
 type SkMsgInfo struct {
 }
 
+type SkMsgConfig struct {
+	ApplyBytes uint32
+	CorkBytes  uint32
+}
+
 type MockBPFLib struct {
 	binDir              string
 	XDPProgs            map[string]XDPInfo      // iface -> []maps
@@ -101,6 +106,7 @@ type MockBPFLib struct {
 	SockMap             *SockMap
 	SkMsgProg           *SkMsgInfo
 	SockmapEndpointsMap *CIDRMap
+	SkMsgConfig         *SkMsgConfig
 	FailsafeMap         FailsafeMap
 	CgroupV2Dir         string
 }
@@ -756,3 +762,32 @@ func (b *MockBPFLib) RemoveSockmapEndpointsMap() error {
 
 	return nil
 }
+
+func (b *MockBPFLib) NewSockmapMsgConfigMap() (string, error) {
+	if b.SkMsgConfig == nil {
+		b.SkMsgConfig = &SkMsgConfig{}
+	}
+
+	return "/sys/fs/bpf/calico/sockmap/calico_sk_msg_cfg", nil
+}
+
+func (b *MockBPFLib) UpdateSockmapMsgConfig(applyBytes, corkBytes uint32) error {
+	if b.SkMsgConfig == nil {
+		return errors.New("sk_msg config map not found")
+	}
+
+	b.SkMsgConfig.ApplyBytes = applyBytes
+	b.SkMsgConfig.CorkBytes = corkBytes
+
+	return nil
+}
+
+func (b *MockBPFLib) RemoveSockmapMsgConfigMap() error {
+	if b.SkMsgConfig == nil {
+		return errors.New("sk_msg config map not found")
+	}
+
+	b.SkMsgConfig = nil
+
+	return nil
+}
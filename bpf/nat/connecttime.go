@@ -97,7 +97,7 @@ func installProgram(name, ipver, bpfMount, cgroupPath, logLevel string, maps ...
 		filename = path.Join(bpf.ObjectDir, ProgFileName(logLevel, 4))
 	}
 	args := []string{"prog", "loadall", filename, progPinDir, "type", "cgroup/" + name + ipver}
-	for _, m := range maps {
+	for _, m := range bpf.PinnedMaps(maps) {
 		args = append(args, "map", "name", m.GetName(), "pinned", m.Path())
 	}
 
@@ -127,7 +127,11 @@ out:
 	return nil
 }
 
-func InstallConnectTimeLoadBalancer(frontendMap, backendMap, rtMap bpf.Map, cgroupv2 string, logLevel string) error {
+// InstallConnectTimeLoadBalancer attaches the connect-time load balancing programs to the cgroup.
+// If ipv6Enabled is set, the IPv6 programs also balance to the IPv6 services, whose frontends and
+// backends are in FrontendMapV6 and BackendMapV6.
+func InstallConnectTimeLoadBalancer(frontendMap, backendMap, rtMap, rtExactMap bpf.Map, cgroupv2 string, logLevel string,
+	ipv6Enabled bool) error {
 	bpfMount, err := bpf.MaybeMountBPFfs()
 	if err != nil {
 		log.WithError(err).Error("Failed to mount bpffs, unable to do connect-time load balancing")
@@ -139,27 +143,47 @@ func InstallConnectTimeLoadBalancer(frontendMap, backendMap, rtMap bpf.Map, cgro
 		return errors.Wrap(err, "failed to set-up cgroupv2")
 	}
 
-	repin := false
-	if pm, ok := frontendMap.(*bpf.PinnedMap); ok {
-		repin = pm.RepinningEnabled()
+	// Create the connect-time maps with the same repinning and sizing config as the NAT maps.
+	mc := &bpf.MapContext{}
+	if cm, ok := backendMap.(interface{ Context() *bpf.MapContext }); ok && cm.Context() != nil {
+		mc = cm.Context()
 	}
 
-	sendrecvMap := SendRecvMsgMap(&bpf.MapContext{
-		RepinningEnabled: repin,
-	})
+	sendrecvMap := SendRecvMsgMap(mc)
 	err = sendrecvMap.EnsureExists()
 	if err != nil {
 		return errors.WithMessage(err, "failed to create sendrecv BPF Map")
 	}
-	allNATsMap := AllNATsMsgMap(&bpf.MapContext{
-		RepinningEnabled: repin,
-	})
+	allNATsMap := AllNATsMsgMap(mc)
 	err = allNATsMap.EnsureExists()
 	if err != nil {
 		return errors.WithMessage(err, "failed to create all-NATs BPF Map")
 	}
+	ctlbMaps := []bpf.Map{CTLBGenMap(mc), CTLBCacheMap(mc)}
+	for _, m := range ctlbMaps {
+		err = m.EnsureExists()
+		if err != nil {
+			return errors.WithMessagef(err, "failed to create %s BPF Map", m.GetName())
+		}
+	}
 
-	maps := []bpf.Map{frontendMap, backendMap, rtMap, sendrecvMap, allNATsMap}
+	frontendMapV6 := FrontendMapV6(mc)
+	if !ipv6Enabled {
+		// Do not leave stale IPv6 services behind, nothing keeps them in sync.
+		_ = os.Remove(frontendMapV6.Path())
+	}
+	v6Maps := []bpf.Map{frontendMapV6, BackendMapV6(mc), SendRecvMsgMapV6(mc), CTLBCacheMapV6(mc)}
+	for _, m := range v6Maps {
+		err = m.EnsureExists()
+		if err != nil {
+			return errors.WithMessagef(err, "failed to create %s BPF Map", m.GetName())
+		}
+	}
+
+	maps := append([]bpf.Map{frontendMap, backendMap, rtMap, rtExactMap, sendrecvMap, allNATsMap}, ctlbMaps...)
+	// The IPv6 programs share the IPv4 NAT maps, minus the routes, for the v4-mapped addresses.
+	maps6 := append([]bpf.Map{frontendMap, backendMap, sendrecvMap, allNATsMap}, ctlbMaps...)
+	maps6 = append(maps6, v6Maps...)
 
 	err = installProgram("connect", "4", bpfMount, cgroupPath, logLevel, maps...)
 	if err != nil {
@@ -176,12 +200,19 @@ func InstallConnectTimeLoadBalancer(frontendMap, backendMap, rtMap bpf.Map, cgro
 		return err
 	}
 
-	err = installProgram("sendmsg", "6", bpfMount, cgroupPath, logLevel)
+	if ipv6Enabled {
+		err = installProgram("connect", "6", bpfMount, cgroupPath, logLevel, maps6...)
+		if err != nil {
+			return err
+		}
+	}
+
+	err = installProgram("sendmsg", "6", bpfMount, cgroupPath, logLevel, maps6...)
 	if err != nil {
 		return err
 	}
 
-	err = installProgram("recvmsg", "6", bpfMount, cgroupPath, logLevel, sendrecvMap)
+	err = installProgram("recvmsg", "6", bpfMount, cgroupPath, logLevel, maps6...)
 	if err != nil {
 		return err
 	}
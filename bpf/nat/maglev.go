@@ -0,0 +1,91 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"hash/fnv"
+	"sort"
+)
+
+// MaglevTableSize is the number of slots of a Maglev lookup table.  It must be a prime and it
+// should be much larger than the number of backends of a service.
+// WARNING: must be kept in sync with NAT_MAGLEV_TABLE_SIZE in bpf-gpl/nat_types.h.
+const MaglevTableSize = 1021
+
+// NewMaglevTable populates a Maglev lookup table (Eisenbud et al., "Maglev: A Fast and Reliable
+// Software Network Load Balancer") for the backends.  The backends are identified by their
+// IP:port and the returned table holds, for each slot, the index of a backend in the slice.
+//
+// The table depends only on the set of backends, not on their order, so all nodes build the same
+// table (modulo the ordinals) and pick the same backend for a flow.  When a backend is added or
+// removed, only about 1/N of the slots change.  It returns nil if there are no backends or too
+// many to fit.
+func NewMaglevTable(backends []string) []uint32 {
+	n := len(backends)
+	if n == 0 || n >= MaglevTableSize {
+		return nil
+	}
+
+	// Populate in the order of the names so that the result does not depend on the order of the
+	// backends.
+	order := make([]int, n)
+	for i := range order {
+		order[i] = i
+	}
+	sort.Slice(order, func(i, j int) bool {
+		return backends[order[i]] < backends[order[j]]
+	})
+
+	offsets := make([]uint32, n)
+	skips := make([]uint32, n)
+	for i, b := range backends {
+		offsets[i] = maglevHash(b, 0) % MaglevTableSize
+		skips[i] = maglevHash(b, 1)%(MaglevTableSize-1) + 1
+	}
+
+	const empty = ^uint32(0)
+	table := make([]uint32, MaglevTableSize)
+	for i := range table {
+		table[i] = empty
+	}
+
+	next := make([]uint32, n)
+	filled := 0
+	for {
+		for _, i := range order {
+			// Find the next preferred slot of the backend that is not taken yet.
+			var slot uint32
+			for {
+				slot = (offsets[i] + next[i]*skips[i]) % MaglevTableSize
+				next[i]++
+				if table[slot] == empty {
+					break
+				}
+			}
+			table[slot] = uint32(i)
+			filled++
+			if filled == MaglevTableSize {
+				return table
+			}
+		}
+	}
+}
+
+func maglevHash(s string, seed byte) uint32 {
+	h := fnv.New32a()
+	_, _ = h.Write([]byte{seed})
+	_, _ = h.Write([]byte(s))
+	return h.Sum32()
+}
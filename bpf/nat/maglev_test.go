@@ -0,0 +1,89 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"fmt"
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func maglevTestBackends(n int) []string {
+	var backends []string
+	for i := 0; i < n; i++ {
+		backends = append(backends, fmt.Sprintf("10.65.%d.%d:8080", i/250, i%250+1))
+	}
+	return backends
+}
+
+func TestMaglevTableIsBalanced(t *testing.T) {
+	RegisterTestingT(t)
+
+	backends := maglevTestBackends(7)
+	table := NewMaglevTable(backends)
+	Expect(table).To(HaveLen(MaglevTableSize))
+
+	counts := make([]int, len(backends))
+	for _, i := range table {
+		Expect(int(i)).To(BeNumerically("<", len(backends)))
+		counts[i]++
+	}
+	for _, c := range counts {
+		Expect(c).To(BeNumerically("~", MaglevTableSize/len(backends), 1))
+	}
+}
+
+func TestMaglevTableDoesNotDependOnOrder(t *testing.T) {
+	RegisterTestingT(t)
+
+	backends := maglevTestBackends(5)
+	reversed := make([]string, len(backends))
+	for i, b := range backends {
+		reversed[len(backends)-1-i] = b
+	}
+
+	table := NewMaglevTable(backends)
+	revTable := NewMaglevTable(reversed)
+	for slot := range table {
+		Expect(reversed[revTable[slot]]).To(Equal(backends[table[slot]]))
+	}
+}
+
+func TestMaglevTableChurn(t *testing.T) {
+	RegisterTestingT(t)
+
+	backends := maglevTestBackends(10)
+	table := NewMaglevTable(backends)
+	// Remove the last backend.
+	smaller := NewMaglevTable(backends[:9])
+
+	moved := 0
+	for slot := range table {
+		if table[slot] != 9 && smaller[slot] != table[slot] {
+			moved++
+		}
+	}
+	// Only the slots of the removed backend must move, allow for a little extra disruption.
+	Expect(moved).To(BeNumerically("<", MaglevTableSize/10))
+}
+
+func TestMaglevTableLimits(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(NewMaglevTable(nil)).To(BeNil())
+	Expect(NewMaglevTable(maglevTestBackends(MaglevTableSize))).To(BeNil())
+	Expect(NewMaglevTable(maglevTestBackends(1))).To(Equal(make([]uint32, MaglevTableSize)))
+}
@@ -51,8 +51,13 @@ const frontendAffKeySize = 8
 //    uint32_t count;
 //    uint32_t local;
 //    uint32_t affinity_timeo;
+//    uint32_t affinity_gen;
 // };
-const frontendValueSize = 16
+const frontendValueSize = 20
+
+// frontendValueV2Size is the size of the values of the versions of the frontend maps before the
+// affinity generation, see frontendMapUpgrade.
+const frontendValueV2Size = 16
 
 // struct calico_nat_secondary_v4_key {
 //   uint32_t id;
@@ -140,12 +145,33 @@ func (k FrontendKey) String() string {
 
 type FrontendValue [frontendValueSize]byte
 
+// NATFlgPreferLocal makes the connect-time load balancer only pick from the local backends of a
+// frontend, if there are any.  The flags share the field of the affinity timeout, which is at most
+// a day.
+// WARNING: must be kept in sync with NAT_FE_FLG_PREFER_LOCAL in bpf-gpl/nat_types.h.
+const (
+	NATFlgPreferLocal uint32 = 0x01000000
+
+	natAffinityTimeoMask uint32 = 0x00ffffff
+)
+
 func NewNATValue(id uint32, count, local, affinityTimeo uint32) FrontendValue {
+	return NewNATValueWithFlags(id, count, local, affinityTimeo, 0)
+}
+
+func NewNATValueWithFlags(id uint32, count, local, affinityTimeo, flags uint32) FrontendValue {
+	return NewNATValueWithAffinityGen(id, count, local, affinityTimeo, flags, 0)
+}
+
+// NewNATValueWithAffinityGen returns a frontend value whose affinity entries are only valid if
+// they have the generation affinityGen, see AffinityValue.
+func NewNATValueWithAffinityGen(id uint32, count, local, affinityTimeo, flags, affinityGen uint32) FrontendValue {
 	var v FrontendValue
 	binary.LittleEndian.PutUint32(v[:4], id)
 	binary.LittleEndian.PutUint32(v[4:8], count)
 	binary.LittleEndian.PutUint32(v[8:12], local)
-	binary.LittleEndian.PutUint32(v[12:16], affinityTimeo)
+	binary.LittleEndian.PutUint32(v[12:16], affinityTimeo&natAffinityTimeoMask|flags)
+	binary.LittleEndian.PutUint32(v[16:20], affinityGen)
 	return v
 }
 
@@ -162,13 +188,21 @@ func (v FrontendValue) LocalCount() uint32 {
 }
 
 func (v FrontendValue) AffinityTimeout() time.Duration {
-	secs := binary.LittleEndian.Uint32(v[12:16])
+	secs := binary.LittleEndian.Uint32(v[12:16]) & natAffinityTimeoMask
 	return time.Duration(secs) * time.Second
 }
 
+func (v FrontendValue) Flags() uint32 {
+	return binary.LittleEndian.Uint32(v[12:16]) &^ natAffinityTimeoMask
+}
+
+func (v FrontendValue) AffinityGen() uint32 {
+	return binary.LittleEndian.Uint32(v[16:20])
+}
+
 func (v FrontendValue) String() string {
-	return fmt.Sprintf("NATValue{ID:%d,Count:%d,LocalCount:%d,AffinityTimeout:%d}",
-		v.ID(), v.Count(), v.LocalCount(), v.AffinityTimeout())
+	return fmt.Sprintf("NATValue{ID:%d,Count:%d,LocalCount:%d,AffinityTimeout:%d,Flags:%#x,AffinityGen:%d}",
+		v.ID(), v.Count(), v.LocalCount(), v.AffinityTimeout(), v.Flags(), v.AffinityGen())
 }
 
 func (v FrontendValue) AsBytes() []byte {
@@ -237,11 +271,301 @@ var FrontendMapParameters = bpf.MapParameters{
 	MaxEntries: 511000,
 	Name:       "cali_v4_nat_fe",
 	Flags:      unix.BPF_F_NO_PREALLOC,
+	Version:    3,
+}
+
+// FrontendExactMapParameters describe the exact-match tier of the frontend map, which holds the
+// frontends without a source CIDR, see FrontendMap.
+// WARNING: must be kept in sync with cali_v4_fex in bpf-gpl/nat_types.h.
+var FrontendExactMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_fex",
+	Type:       "hash",
+	KeySize:    frontendExactKeySize,
+	ValueSize:  frontendValueSize,
+	MaxEntries: 511000,
+	Name:       "cali_v4_fex",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+	Version:    2,
+}
+
+// NodePortMapParameters describe the NodePort tier of the frontend map, see FrontendMap.
+// WARNING: must be kept in sync with cali_v4_nat_np in bpf-gpl/nat_types.h.
+var NodePortMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_nat_np",
+	Type:       "hash",
+	KeySize:    nodePortKeySize,
+	ValueSize:  frontendValueSize,
+	MaxEntries: 393216, // Every port of TCP, UDP and SCTP, local and remote.
+	Name:       "cali_v4_nat_np",
+	Flags:      unix.BPF_F_NO_PREALLOC,
 	Version:    2,
 }
 
+// FrontendMapReplicaParameters, FrontendExactMapReplicaParameters and NodePortMapReplicaParameters
+// describe the replicas of the tiers of the frontend map on the second NUMA node, see
+// bpf.NUMAReplicatedMap.
+// WARNING: must be kept in sync with cali_v4_fe3_n1, cali_v4_fex2_n1 and cali_v4_np2_n1 in
+// bpf-gpl/nat_types.h.
+var (
+	FrontendMapReplicaParameters      = FrontendMapParameters.NUMAReplica("cali_v4_fe3_n1")
+	FrontendExactMapReplicaParameters = FrontendExactMapParameters.NUMAReplica("cali_v4_fex2_n1")
+	NodePortMapReplicaParameters      = NodePortMapParameters.NUMAReplica("cali_v4_np2_n1")
+)
+
+// frontendMapUpgrade carries the frontends of the version of a frontend map before the affinity
+// generation over, with the generation zero.  The new maps then serve the services until the
+// syncer rewrites them.  The versioned names of some of the maps would not fit in
+// BPF_OBJ_NAME_LEN so they got shorter names, filename is the pin of the old map.
+func frontendMapUpgrade(params bpf.MapParameters, filename string, version int) bpf.MapUpgrade {
+	from := params
+	from.Filename = filename
+	from.Version = version
+	from.ValueSize = frontendValueV2Size
+	return bpf.MapUpgrade{
+		From: from,
+		Convert: func(k, v []byte) ([]byte, []byte) {
+			var newV FrontendValue
+			copy(newV[:], v)
+			return k, newV[:]
+		},
+	}
+}
+
+// NodePortLocalHostIP and NodePortRemoteHostsIP are the addresses of the frontends of a NodePort
+// that apply to all the addresses of this host and of the other hosts respectively.
+var (
+	NodePortLocalHostIP   = net.IPv4(0, 0, 0, 0)
+	NodePortRemoteHostsIP = net.IPv4(255, 255, 255, 255)
+)
+
+// FrontendMap returns the NAT frontend map.  It is made up of three tiers: the frontends without a
+// source CIDR live in an exact-match hash map and only the frontends of the services with
+// LoadBalancer source ranges live in the LPM trie.  Such services also have a BlackHoleCount entry
+// in the hash map, which tells the dataplane to look up the trie.  The frontends of the NodePorts,
+// with the NodePortLocalHostIP or NodePortRemoteHostsIP address, live in a hash map keyed on the
+// port only, which the dataplane looks up if the destination is the address of a host.  The
+// returned map takes and returns FrontendKeys and puts each of them in the right tier.
 func FrontendMap(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(FrontendMapParameters)
+	return &frontendMap{
+		lpm: mc.NewNUMAReplicatedMapWithUpgrades(FrontendMapParameters,
+			[]bpf.MapParameters{FrontendMapReplicaParameters},
+			frontendMapUpgrade(FrontendMapParameters, FrontendMapParameters.Filename, 2)),
+		exact: mc.NewNUMAReplicatedMapWithUpgrades(FrontendExactMapParameters,
+			[]bpf.MapParameters{FrontendExactMapReplicaParameters},
+			frontendMapUpgrade(FrontendExactMapParameters, "/sys/fs/bpf/tc/globals/cali_v4_nat_fex", 1)),
+		nodePort: mc.NewNUMAReplicatedMapWithUpgrades(NodePortMapParameters,
+			[]bpf.MapParameters{NodePortMapReplicaParameters},
+			frontendMapUpgrade(NodePortMapParameters, NodePortMapParameters.Filename, 1)),
+	}
+}
+
+// struct calico_nat_v4_exact_key {
+//    uint32_t addr; // NBO
+//    uint16_t port; // HBO
+//    uint8_t protocol;
+//    uint8_t pad;
+// };
+const frontendExactKeySize = 8
+
+func (k FrontendKey) hasSrcCIDR() bool {
+	return k.PrefixLen() > ZeroCIDRPrefixLen
+}
+
+func (k FrontendKey) exactKey() []byte {
+	var ek [frontendExactKeySize]byte
+	copy(ek[:7], k[4:11])
+	return ek[:]
+}
+
+func frontendKeyFromExact(ek []byte) FrontendKey {
+	var k FrontendKey
+	binary.LittleEndian.PutUint32(k[:4], ZeroCIDRPrefixLen)
+	copy(k[4:11], ek[:7])
+	return k
+}
+
+// struct calico_nat_np_key {
+//    uint16_t port; // HBO
+//    uint8_t protocol;
+//    uint8_t remote;
+// };
+const nodePortKeySize = 4
+
+// nodePortKey returns the key of the NodePort tier if k is the frontend of a NodePort.
+func (k FrontendKey) nodePortKey() ([]byte, bool) {
+	var remote byte
+	switch {
+	case k.Addr().Equal(NodePortLocalHostIP):
+	case k.Addr().Equal(NodePortRemoteHostsIP):
+		remote = 1
+	default:
+		return nil, false
+	}
+	var nk [nodePortKeySize]byte
+	copy(nk[:3], k[8:11])
+	nk[3] = remote
+	return nk[:], true
+}
+
+func frontendKeyFromNodePort(nk []byte) FrontendKey {
+	addr := NodePortLocalHostIP
+	if nk[3] != 0 {
+		addr = NodePortRemoteHostsIP
+	}
+	return NewNATKey(addr, binary.LittleEndian.Uint16(nk[:2]), nk[2])
+}
+
+type frontendMap struct {
+	lpm, exact, nodePort bpf.Map
+}
+
+func (m *frontendMap) Maps() []bpf.Map {
+	return []bpf.Map{m.lpm, m.exact, m.nodePort}
+}
+
+func (m *frontendMap) GetName() string {
+	return m.exact.GetName()
+}
+
+func (m *frontendMap) EnsureExists() error {
+	for _, tier := range m.Maps() {
+		if err := tier.EnsureExists(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func (m *frontendMap) Open() error {
+	for _, tier := range m.Maps() {
+		if err := tier.Open(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func (m *frontendMap) MapFD() bpf.MapFD {
+	return m.exact.MapFD()
+}
+
+func (m *frontendMap) Path() string {
+	return m.exact.Path()
+}
+
+func (m *frontendMap) route(k []byte) (bpf.Map, []byte) {
+	var key FrontendKey
+	copy(key[:], k)
+	if key.hasSrcCIDR() {
+		return m.lpm, k
+	}
+	if nk, ok := key.nodePortKey(); ok {
+		return m.nodePort, nk
+	}
+	return m.exact, key.exactKey()
+}
+
+func (m *frontendMap) Update(k, v []byte) error {
+	tier, key := m.route(k)
+	return tier.Update(key, v)
+}
+
+func (m *frontendMap) Get(k []byte) ([]byte, error) {
+	tier, key := m.route(k)
+	return tier.Get(key)
+}
+
+func (m *frontendMap) Delete(k []byte) error {
+	tier, key := m.route(k)
+	return tier.Delete(key)
+}
+
+func (m *frontendMap) Iter(f bpf.IterCallback) error {
+	// move puts an entry that an older version wrote to another tier where the dataplane looks
+	// for it now.
+	move := func(key FrontendKey, v []byte) bpf.IteratorAction {
+		tier, k := m.route(key[:])
+		if err := tier.Update(k, v); err != nil {
+			log.WithError(err).WithField("key", key).Warn("Failed to move NAT frontend to its tier")
+			return bpf.IterNone
+		}
+		return bpf.IterDelete
+	}
+
+	err := m.lpm.Iter(func(k, v []byte) bpf.IteratorAction {
+		var key FrontendKey
+		copy(key[:], k)
+		if !key.hasSrcCIDR() {
+			// Older versions kept all frontends in the trie.
+			return move(key, v)
+		}
+		return f(k, v)
+	})
+	if err != nil {
+		return err
+	}
+
+	err = m.exact.Iter(func(k, v []byte) bpf.IteratorAction {
+		key := frontendKeyFromExact(k)
+		if _, ok := key.nodePortKey(); ok {
+			// Older versions kept the wildcard NodePorts in the exact-match tier.
+			return move(key, v)
+		}
+		return f(key[:], v)
+	})
+	if err != nil {
+		return err
+	}
+
+	return m.nodePort.Iter(func(k, v []byte) bpf.IteratorAction {
+		key := frontendKeyFromNodePort(k)
+		return f(key[:], v)
+	})
+}
+
+// FrontendCallback is called by LoadFrontendBatches with each frontend.
+type FrontendCallback func(k FrontendKey, v FrontendValue)
+
+// LoadFrontendBatches passes the frontends of a FrontendMap to the callback, reading each tier a
+// batch at a time, see bpf.LoadBatches.  Unlike Iter, it never writes to the map: the entries that
+// older versions left in another tier are passed on as they are.  That makes it safe for
+// diagnostic tools to call while Felix is running.
+func LoadFrontendBatches(m bpf.Map, f FrontendCallback) error {
+	fm, ok := m.(*frontendMap)
+	if !ok {
+		return bpf.LoadBatches(m, frontendBatchCallback(frontendKeySize, frontendKeyFromBytes, f))
+	}
+
+	for _, tier := range []struct {
+		m       bpf.Map
+		keySize int
+		key     func(k []byte) FrontendKey
+	}{
+		{fm.lpm, frontendKeySize, frontendKeyFromBytes},
+		{fm.exact, frontendExactKeySize, frontendKeyFromExact},
+		{fm.nodePort, nodePortKeySize, frontendKeyFromNodePort},
+	} {
+		if err := bpf.LoadBatches(tier.m, frontendBatchCallback(tier.keySize, tier.key, f)); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func frontendKeyFromBytes(k []byte) FrontendKey {
+	var key FrontendKey
+	copy(key[:], k)
+	return key
+}
+
+func frontendBatchCallback(keySize int, key func(k []byte) FrontendKey, f FrontendCallback) bpf.BatchCallback {
+	return func(keys, values []byte, n int) {
+		for i := 0; i < n; i++ {
+			var v FrontendValue
+			copy(v[:], values[i*frontendValueSize:])
+			f(key(keys[i*keySize:(i+1)*keySize]), v)
+		}
+	}
 }
 
 var BackendMapParameters = bpf.MapParameters{
@@ -254,8 +578,12 @@ var BackendMapParameters = bpf.MapParameters{
 	Flags:      unix.BPF_F_NO_PREALLOC,
 }
 
+// BackendMapReplicaParameters describes the replica of the backend map on the second NUMA node.
+// WARNING: must be kept in sync with cali_v4_be_n1 in bpf-gpl/nat_types.h.
+var BackendMapReplicaParameters = BackendMapParameters.NUMAReplica("cali_v4_be_n1")
+
 func BackendMap(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(BackendMapParameters)
+	return mc.NewNUMAReplicatedMap(BackendMapParameters, BackendMapReplicaParameters)
 }
 
 // NATMapMem represents FrontendMap loaded into memory
@@ -310,6 +638,38 @@ func MapMemIter(m MapMem) bpf.IterCallback {
 	}
 }
 
+// FrontendExactMapMemIter returns bpf.MapIter that loads the exact-match tier of the frontend map
+// into the provided MapMem.
+func FrontendExactMapMemIter(m MapMem) bpf.IterCallback {
+	vs := len(FrontendValue{})
+
+	return func(k, v []byte) bpf.IteratorAction {
+		key := frontendKeyFromExact(k)
+
+		var val FrontendValue
+		copy(val[:vs], v[:vs])
+
+		m[key] = val
+		return bpf.IterNone
+	}
+}
+
+// NodePortMapMemIter returns bpf.MapIter that loads the NodePort tier of the frontend map into the
+// provided MapMem.
+func NodePortMapMemIter(m MapMem) bpf.IterCallback {
+	vs := len(FrontendValue{})
+
+	return func(k, v []byte) bpf.IteratorAction {
+		key := frontendKeyFromNodePort(k)
+
+		var val FrontendValue
+		copy(val[:vs], v[:vs])
+
+		m[key] = val
+		return bpf.IterNone
+	}
+}
+
 // BackendMapMem represents a NATBackend loaded into memory
 type BackendMapMem map[BackendKey]BackendValue
 
@@ -415,9 +775,11 @@ func (k AffinityKey) AsBytes() []byte {
 // struct calico_nat_v4_affinity_val {
 //    struct calico_nat_dest;
 //    uint64_t ts;
+//    uint32_t gen;
+//    uint32_t pad;
 // };
 
-const affinityValueSize = backendValueSize + 8
+const affinityValueSize = backendValueSize + 16
 
 // AffinityValue represents a backend picked by the affinity and the timestamp
 // of its creating
@@ -425,18 +787,25 @@ type AffinityValue [affinityValueSize]byte
 
 // NewAffinityValue creates a value from a timestamp and a backend
 func NewAffinityValue(ts uint64, backend BackendValue) AffinityValue {
+	return NewAffinityValueWithGen(ts, 0, backend)
+}
+
+// NewAffinityValueWithGen creates a value from a timestamp, the affinity generation of the frontend
+// and a backend.  The dataplane ignores the value once the frontend has a different generation.
+func NewAffinityValueWithGen(ts uint64, gen uint32, backend BackendValue) AffinityValue {
 	var v AffinityValue
 
 	copy(v[:], backend[:])
 	binary.LittleEndian.PutUint64(v[backendValueSize:backendValueSize+8], ts)
+	binary.LittleEndian.PutUint32(v[backendValueSize+8:backendValueSize+12], gen)
 
 	return v
 }
 
 // Timestamp returns the timestamp of the entry. It is generated by
-// bpf_ktime_get_ns which returns the time since the system boot in nanoseconds
-// - it is the monotonic clock reading, which is compatible with time operations
-// in time package.
+// bpf_ktime_get_ns or, where the kernel has it, bpf_ktime_get_coarse_ns which
+// return the time since the system boot in nanoseconds - it is the monotonic
+// clock reading, which is compatible with time operations in time package.
 func (v AffinityValue) Timestamp() time.Duration {
 	nano := binary.LittleEndian.Uint64(v[backendValueSize : backendValueSize+8])
 	return time.Duration(nano) * time.Nanosecond
@@ -451,8 +820,13 @@ func (v AffinityValue) Backend() BackendValue {
 	return b
 }
 
+// Gen returns the affinity generation of the frontend when the entry was created.
+func (v AffinityValue) Gen() uint32 {
+	return binary.LittleEndian.Uint32(v[backendValueSize+8 : backendValueSize+12])
+}
+
 func (v AffinityValue) String() string {
-	return fmt.Sprintf("AffinityValue{Timestamp:%d,Backend:%v}", v.Timestamp(), v.Backend())
+	return fmt.Sprintf("AffinityValue{Timestamp:%d,Gen:%d,Backend:%v}", v.Timestamp(), v.Gen(), v.Backend())
 }
 
 // AsBytes returns the value as []byte
@@ -462,17 +836,65 @@ func (v AffinityValue) AsBytes() []byte {
 
 // AffinityMapParameters describe the AffinityMap
 var AffinityMapParameters = bpf.MapParameters{
-	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_nat_aff",
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_aff",
 	Type:       "lru_hash",
 	KeySize:    affinityKeySize,
 	ValueSize:  affinityValueSize,
 	MaxEntries: 510000,
-	Name:       "cali_v4_nat_aff",
+	Name:       "cali_v4_aff",
+	Version:    2,
 }
 
+// affinityMapUpgrade drops the entries of cali_v4_nat_aff, the affinity map before the
+// generations, which could point to backends that the services no longer have.  It unpins the old
+// map.
+var affinityMapUpgrade = bpf.MapUpgrade{
+	From: func() bpf.MapParameters {
+		mp := AffinityMapParameters
+		mp.Filename = "/sys/fs/bpf/tc/globals/cali_v4_nat_aff"
+		mp.Version = 1
+		mp.ValueSize = backendValueSize + 8
+		return mp
+	}(),
+	Convert: func(k, v []byte) ([]byte, []byte) {
+		return nil, nil
+	},
+}
+
+// AffinityMapPerCPULRUParameters describe the AffinityMap when each CPU has its own LRU list.  The
+// BPF programs then don't contend on the lock of the common LRU list when they update the affinity
+// of new flows, at the cost of evicting entries from the list of the CPU rather than the least
+// recently used entry overall.
+var AffinityMapPerCPULRUParameters = func() bpf.MapParameters {
+	mp := AffinityMapParameters
+	mp.Flags = unix.BPF_F_NO_COMMON_LRU
+	return mp
+}()
+
 // AffinityMap returns an instance of an affinity map
 func AffinityMap(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(AffinityMapParameters)
+	return mc.NewPinnedMapWithUpgrades(AffinityMapParameters, affinityMapUpgrade)
+}
+
+// AffinityMapWithLRU returns the affinity map, with per-CPU LRU lists if perCPULRU is set.
+func AffinityMapWithLRU(mc *bpf.MapContext, perCPULRU bool) bpf.Map {
+	if perCPULRU {
+		return mc.NewPinnedMapWithUpgrades(AffinityMapPerCPULRUParameters, affinityMapUpgrade)
+	}
+	return AffinityMap(mc)
+}
+
+// PatchAffinityMap makes a program binary use the affinity map with per-CPU LRU lists, if
+// perCPULRU is set.
+func PatchAffinityMap(b *bpf.Binary, perCPULRU bool) error {
+	if !perCPULRU {
+		return nil
+	}
+	err := b.PatchMapParams(AffinityMapPerCPULRUParameters)
+	if err != nil {
+		return fmt.Errorf("failed to patch affinity map into BPF binary: %w", err)
+	}
+	return nil
 }
 
 // AffinityMapMem represents affinity map in memory
@@ -507,6 +929,78 @@ func AffinityMapMemIter(m AffinityMapMem) bpf.IterCallback {
 	}
 }
 
+// struct calico_nat_maglev_key {
+//    uint32_t id;
+//    uint32_t slot;
+// };
+const maglevKeySize = 8
+
+// The value is the ordinal of the backend.
+const maglevValueSize = 4
+
+// MaglevKey is a key into the Maglev lookup table of a service, which is identified by the ID of
+// its frontend, see NewMaglevTable.
+type MaglevKey [maglevKeySize]byte
+
+func NewMaglevKey(id, slot uint32) MaglevKey {
+	var k MaglevKey
+	binary.LittleEndian.PutUint32(k[:4], id)
+	binary.LittleEndian.PutUint32(k[4:8], slot)
+	return k
+}
+
+func (k MaglevKey) ID() uint32 {
+	return binary.LittleEndian.Uint32(k[:4])
+}
+
+func (k MaglevKey) Slot() uint32 {
+	return binary.LittleEndian.Uint32(k[4:8])
+}
+
+func (k MaglevKey) String() string {
+	return fmt.Sprintf("MaglevKey{ID:%d,Slot:%d}", k.ID(), k.Slot())
+}
+
+func (k MaglevKey) AsBytes() []byte {
+	return k[:]
+}
+
+type MaglevValue [maglevValueSize]byte
+
+func NewMaglevValue(ordinal uint32) MaglevValue {
+	var v MaglevValue
+	binary.LittleEndian.PutUint32(v[:], ordinal)
+	return v
+}
+
+func (v MaglevValue) Ordinal() uint32 {
+	return binary.LittleEndian.Uint32(v[:])
+}
+
+func (v MaglevValue) String() string {
+	return fmt.Sprintf("MaglevValue{Ordinal:%d}", v.Ordinal())
+}
+
+func (v MaglevValue) AsBytes() []byte {
+	return v[:]
+}
+
+// MaglevMapParameters describe the map of the per-service Maglev lookup tables.
+// WARNING: must be kept in sync with cali_v4_maglev in bpf-gpl/nat_types.h.
+var MaglevMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_maglev",
+	Type:       "hash",
+	KeySize:    maglevKeySize,
+	ValueSize:  maglevValueSize,
+	MaxEntries: MaglevTableSize * 500,
+	Name:       "cali_v4_maglev",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func MaglevMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(MaglevMapParameters)
+}
+
 // struct sendrecv4_key {
 // 	uint64_t cookie;
 // 	uint32_t ip;
@@ -594,6 +1088,48 @@ func AllNATsMsgMap(mc *bpf.MapContext) bpf.Map {
 	return mc.NewPinnedMap(CTNATsMapParameters)
 }
 
+// CTLBGenMapParameters define CTLBGenMap
+// WARNING: must be kept in sync with cali_ctlb_gen in bpf-gpl/ctlb_cache.h.
+var CTLBGenMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_ctlb_gen",
+	Type:       "array",
+	KeySize:    4,
+	ValueSize:  8,
+	MaxEntries: 1,
+	Name:       "cali_ctlb_gen",
+}
+
+// CTLBGenMap holds the generation of the NAT maps.  The sendmsg programs of the connect-time load
+// balancer drop the backends that the sockets cached for an older generation.
+func CTLBGenMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(CTLBGenMapParameters)
+}
+
+// SetCTLBGen sets the generation in the CTLBGenMap.
+func SetCTLBGen(m bpf.Map, gen uint64) error {
+	k := make([]byte, 4)
+	v := make([]byte, 8)
+	binary.LittleEndian.PutUint64(v, gen)
+	return m.Update(k, v)
+}
+
+// CTLBCacheMapParameters define CTLBCacheMap
+// WARNING: must be kept in sync with cali_v4_ctlb_cache in bpf-gpl/ctlb_cache.h.
+var CTLBCacheMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_ctlb_cache",
+	Type:       "lru_hash",
+	KeySize:    8,
+	ValueSize:  32,
+	MaxEntries: 65536,
+	Name:       "cali_v4_ctlb_cache",
+}
+
+// CTLBCacheMap caches, by socket cookie, the backend that the sendmsg program picked for the
+// last destination of an unconnected UDP socket.
+func CTLBCacheMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(CTLBCacheMapParameters)
+}
+
 // SendRecvMsgMapMem represents affinity map in memory
 type SendRecvMsgMapMem map[SendRecvMsgKey]SendRecvMsgValue
 
@@ -0,0 +1,185 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"encoding/binary"
+	"fmt"
+	"net"
+
+	log "github.com/sirupsen/logrus"
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// The IPv6 maps are only used by the connect-time load balancer, the frontends are exact-match
+// and they use the same FrontendValue and BackendKey as the IPv4 maps.
+
+// struct calico_nat_v6_key {
+//    uint32_t addr[4]; // NBO
+//    uint16_t port; // HBO
+//    uint8_t protocol;
+//    uint8_t pad;
+// };
+const frontendKeyV6Size = 20
+
+// struct calico_nat_v6_dest {
+//    uint32_t addr[4];
+//    uint16_t port;
+//    uint8_t pad[2];
+// };
+const backendValueV6Size = 20
+
+type FrontendKeyV6 [frontendKeyV6Size]byte
+
+func NewNATKeyV6(addr net.IP, port uint16, protocol uint8) FrontendKeyV6 {
+	var k FrontendKeyV6
+	addr = addr.To16()
+	if len(addr) != 16 || addr.To4() != nil {
+		log.WithField("ip", addr).Panic("Bad IPv6")
+	}
+	copy(k[:16], addr)
+	binary.LittleEndian.PutUint16(k[16:18], port)
+	k[18] = protocol
+	return k
+}
+
+func (k FrontendKeyV6) Addr() net.IP {
+	return k[:16]
+}
+
+func (k FrontendKeyV6) Port() uint16 {
+	return binary.LittleEndian.Uint16(k[16:18])
+}
+
+func (k FrontendKeyV6) Proto() uint8 {
+	return k[18]
+}
+
+func (k FrontendKeyV6) AsBytes() []byte {
+	return k[:]
+}
+
+func (k FrontendKeyV6) String() string {
+	return fmt.Sprintf("NATKeyV6{Proto:%v Addr:%v Port:%v}", k.Proto(), k.Addr(), k.Port())
+}
+
+type BackendValueV6 [backendValueV6Size]byte
+
+func NewNATBackendValueV6(addr net.IP, port uint16) BackendValueV6 {
+	var v BackendValueV6
+	addr = addr.To16()
+	if len(addr) != 16 || addr.To4() != nil {
+		log.WithField("ip", addr).Panic("Bad IPv6")
+	}
+	copy(v[:16], addr)
+	binary.LittleEndian.PutUint16(v[16:18], port)
+	return v
+}
+
+func (v BackendValueV6) Addr() net.IP {
+	return v[:16]
+}
+
+func (v BackendValueV6) Port() uint16 {
+	return binary.LittleEndian.Uint16(v[16:18])
+}
+
+func (v BackendValueV6) String() string {
+	return fmt.Sprintf("NATBackendValueV6{Addr:%v Port:%v}", v.Addr(), v.Port())
+}
+
+func (v BackendValueV6) AsBytes() []byte {
+	return v[:]
+}
+
+// FrontendMapV6Parameters describe the IPv6 frontend map.
+// WARNING: must be kept in sync with cali_v6_nat_fe in bpf-gpl/nat6.h.
+var FrontendMapV6Parameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v6_nat_fe",
+	Type:       "hash",
+	KeySize:    frontendKeyV6Size,
+	ValueSize:  frontendValueSize,
+	MaxEntries: 511000,
+	Name:       "cali_v6_nat_fe",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+	Version:    2,
+}
+
+func FrontendMapV6(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMapWithUpgrades(FrontendMapV6Parameters, frontendMapUpgrade(FrontendMapV6Parameters, FrontendMapV6Parameters.Filename, 1))
+}
+
+// BackendMapV6Parameters describe the IPv6 backend map.
+// WARNING: must be kept in sync with cali_v6_nat_be in bpf-gpl/nat6.h.
+var BackendMapV6Parameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v6_nat_be",
+	Type:       "hash",
+	KeySize:    backendKeySize,
+	ValueSize:  backendValueV6Size,
+	MaxEntries: 510000,
+	Name:       "cali_v6_nat_be",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func BackendMapV6(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(BackendMapV6Parameters)
+}
+
+// struct sendrecv6_key {
+// 	uint64_t cookie;
+// 	uint32_t ip[4];
+// 	uint32_t port;
+// 	uint32_t pad;
+// };
+//
+// struct sendrecv6_val {
+// 	uint32_t ip[4];
+// 	uint32_t port;
+// };
+
+// SendRecvMsgMapV6Parameters define SendRecvMsgMapV6
+// WARNING: must be kept in sync with cali_v6_srmsg in bpf-gpl/nat6.h.
+var SendRecvMsgMapV6Parameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v6_srmsg",
+	Type:       "lru_hash",
+	KeySize:    32,
+	ValueSize:  20,
+	MaxEntries: 510000,
+	Name:       "cali_v6_srmsg",
+}
+
+// SendRecvMsgMapV6 tracks reverse translations for sendmsg/recvmsg of
+// unconnected IPv6 UDP
+func SendRecvMsgMapV6(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(SendRecvMsgMapV6Parameters)
+}
+
+// CTLBCacheMapV6Parameters define CTLBCacheMapV6
+// WARNING: must be kept in sync with cali_v6_ctlb_cache in bpf-gpl/nat6.h.
+var CTLBCacheMapV6Parameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v6_ctlb_cache",
+	Type:       "lru_hash",
+	KeySize:    8,
+	ValueSize:  56,
+	MaxEntries: 65536,
+	Name:       "cali_v6_ctlb_cache",
+}
+
+// CTLBCacheMapV6 is the IPv6 twin of CTLBCacheMap.
+func CTLBCacheMapV6(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(CTLBCacheMapV6Parameters)
+}
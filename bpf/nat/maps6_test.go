@@ -0,0 +1,41 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"net"
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestNATKeyV6(t *testing.T) {
+	RegisterTestingT(t)
+
+	addr := net.ParseIP("fd00:96::a")
+	k := NewNATKeyV6(addr, 53, 17)
+	Expect(k.AsBytes()).To(HaveLen(FrontendMapV6Parameters.KeySize))
+	Expect(k.Addr().Equal(addr)).To(BeTrue())
+	Expect(k.Port()).To(Equal(uint16(53)))
+	Expect(k.Proto()).To(Equal(uint8(17)))
+	Expect(k[16:]).To(Equal([]byte{53, 0, 17, 0}), "port is in host byte order")
+
+	v := NewNATBackendValueV6(net.ParseIP("fd00:10::1"), 8080)
+	Expect(v.AsBytes()).To(HaveLen(BackendMapV6Parameters.ValueSize))
+	Expect(v.Addr().Equal(net.ParseIP("fd00:10::1"))).To(BeTrue())
+	Expect(v.Port()).To(Equal(uint16(8080)))
+
+	Expect(func() { NewNATKeyV6(net.IPv4(10, 0, 0, 1), 80, 6) }).To(Panic())
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"net"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/ip"
+)
+
+func newTestFrontendMap() (*frontendMap, *mock.Map, *mock.Map, *mock.Map) {
+	lpm := mock.NewMockMap(FrontendMapParameters)
+	exact := mock.NewMockMap(FrontendExactMapParameters)
+	np := mock.NewMockMap(NodePortMapParameters)
+	return &frontendMap{lpm: lpm, exact: exact, nodePort: np}, lpm, exact, np
+}
+
+func TestFrontendMapTiers(t *testing.T) {
+	RegisterTestingT(t)
+
+	m, lpm, exact, _ := newTestFrontendMap()
+
+	plain := NewNATKey(net.IPv4(10, 96, 0, 10), 53, 17)
+	ranged := NewNATKeySrc(net.IPv4(10, 96, 0, 11), 80, 6, ip.MustParseCIDROrIP("192.168.0.0/16").(ip.V4CIDR))
+	val := NewNATValue(1, 2, 0, 0)
+
+	Expect(m.Update(plain.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(m.Update(ranged.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(exact.Contents).To(HaveLen(1))
+	Expect(exact.Contents).To(HaveKey(string([]byte{10, 96, 0, 10, 53, 0, 17, 0})))
+	Expect(lpm.Contents).To(HaveLen(1))
+	Expect(lpm.Contents).To(HaveKey(string(ranged.AsBytes())))
+
+	v, err := m.Get(plain.AsBytes())
+	Expect(err).NotTo(HaveOccurred())
+	Expect(v).To(Equal(val.AsBytes()))
+
+	mem := make(MapMem)
+	Expect(m.Iter(MapMemIter(mem))).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{plain: val, ranged: val}))
+
+	Expect(m.Delete(plain.AsBytes())).NotTo(HaveOccurred())
+	Expect(exact.Contents).To(BeEmpty())
+	Expect(m.Delete(ranged.AsBytes())).NotTo(HaveOccurred())
+	Expect(lpm.Contents).To(BeEmpty())
+}
+
+func TestFrontendMapMovesLegacyEntries(t *testing.T) {
+	RegisterTestingT(t)
+
+	m, lpm, exact, _ := newTestFrontendMap()
+
+	plain := NewNATKey(net.IPv4(10, 96, 0, 10), 53, 17)
+	val := NewNATValue(1, 2, 0, 0)
+	// Written straight into the trie, as older versions did.
+	Expect(lpm.Update(plain.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+
+	mem := make(MapMem)
+	Expect(m.Iter(MapMemIter(mem))).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{plain: val}))
+	Expect(lpm.Contents).To(BeEmpty())
+	Expect(exact.Contents).To(HaveLen(1))
+
+	// The entry is only seen once on the next pass.
+	mem = make(MapMem)
+	Expect(m.Iter(MapMemIter(mem))).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{plain: val}))
+}
+
+func TestFrontendMapNodePorts(t *testing.T) {
+	RegisterTestingT(t)
+
+	m, lpm, exact, np := newTestFrontendMap()
+
+	local := NewNATKey(NodePortLocalHostIP, 30080, 6)
+	remote := NewNATKey(NodePortRemoteHostsIP, 30080, 6)
+	hostIP := NewNATKey(net.IPv4(192, 168, 0, 1), 30080, 6)
+	val := NewNATValue(1, 2, 1, 0)
+
+	Expect(m.Update(local.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(m.Update(remote.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(m.Update(hostIP.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(np.Contents).To(Equal(map[string]string{
+		string([]byte{0x80, 0x75, 6, 0}): string(val.AsBytes()),
+		string([]byte{0x80, 0x75, 6, 1}): string(val.AsBytes()),
+	}))
+	Expect(exact.Contents).To(HaveLen(1))
+	Expect(lpm.Contents).To(BeEmpty())
+
+	mem := make(MapMem)
+	Expect(m.Iter(MapMemIter(mem))).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{local: val, remote: val, hostIP: val}))
+
+	Expect(m.Delete(remote.AsBytes())).NotTo(HaveOccurred())
+	Expect(np.Contents).To(HaveLen(1))
+}
+
+func TestFrontendMapMovesLegacyNodePorts(t *testing.T) {
+	RegisterTestingT(t)
+
+	m, _, exact, np := newTestFrontendMap()
+
+	remote := NewNATKey(NodePortRemoteHostsIP, 30080, 17)
+	val := NewNATValue(1, 2, 1, 0)
+	// Written to the exact-match tier, as older versions did.
+	Expect(exact.Update(remote.exactKey(), val.AsBytes())).NotTo(HaveOccurred())
+
+	mem := make(MapMem)
+	Expect(m.Iter(MapMemIter(mem))).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{remote: val}))
+	Expect(exact.Contents).To(BeEmpty())
+	Expect(np.Contents).To(HaveLen(1))
+}
+
+func TestLoadFrontendBatchesIsReadOnly(t *testing.T) {
+	RegisterTestingT(t)
+
+	m, lpm, exact, _ := newTestFrontendMap()
+
+	legacy := NewNATKey(net.IPv4(10, 96, 0, 10), 53, 17)
+	remote := NewNATKey(NodePortRemoteHostsIP, 30080, 6)
+	val := NewNATValue(1, 2, 1, 0)
+	Expect(lpm.Update(legacy.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+	Expect(m.Update(remote.AsBytes(), val.AsBytes())).NotTo(HaveOccurred())
+
+	mem := make(MapMem)
+	err := LoadFrontendBatches(m, func(k FrontendKey, v FrontendValue) {
+		mem[k] = v
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(mem).To(Equal(MapMem{legacy: val, remote: val}))
+	// The legacy entry is left where it is.
+	Expect(lpm.Contents).To(HaveLen(1))
+	Expect(exact.Contents).To(BeEmpty())
+}
+
+func TestFrontendMapUpgrade(t *testing.T) {
+	RegisterTestingT(t)
+
+	u := frontendMapUpgrade(FrontendExactMapParameters, "/sys/fs/bpf/tc/globals/cali_v4_nat_fex", 1)
+	Expect(u.From.Filename).To(Equal("/sys/fs/bpf/tc/globals/cali_v4_nat_fex"))
+	Expect(u.From.Version).To(Equal(1))
+	Expect(u.From.ValueSize).To(Equal(frontendValueV2Size))
+
+	val := NewNATValueWithFlags(1, 2, 1, 10, NATFlgPreferLocal)
+	k := []byte{10, 96, 0, 10, 53, 0, 17, 0}
+	newK, newV := u.Convert(k, val[:frontendValueV2Size])
+	Expect(newK).To(Equal(k))
+	Expect(newV).To(Equal(val.AsBytes()))
+	Expect(NewNATValueWithAffinityGen(1, 2, 1, 10, NATFlgPreferLocal, 7).AffinityGen()).To(Equal(uint32(7)))
+}
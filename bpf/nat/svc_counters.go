@@ -0,0 +1,97 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"encoding/binary"
+	"fmt"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// ServiceCounter is an index into the per-service counters.
+// WARNING: must be kept in sync with enum cali_svc_ctr in bpf-gpl/svc_ctrs.h.
+type ServiceCounter int
+
+const (
+	// ServiceNewFlows counts the flows that got a backend.
+	ServiceNewFlows ServiceCounter = iota
+	// ServiceNoBackend counts the flows that were refused because the service had no backend.
+	ServiceNoBackend
+	// ServiceSrcRangeDrops counts the flows that were dropped because their source was not in
+	// the source ranges of the load balancer.
+	ServiceSrcRangeDrops
+
+	MaxServiceCounter
+)
+
+func (c ServiceCounter) String() string {
+	switch c {
+	case ServiceNewFlows:
+		return "new flows"
+	case ServiceNoBackend:
+		return "no backend"
+	case ServiceSrcRangeDrops:
+		return "source range drops"
+	}
+	return fmt.Sprintf("service-counter(%d)", int(c))
+}
+
+const serviceCountersValueSize = 8 * int(MaxServiceCounter)
+
+// ServiceCountersMapParams describes the map of the per-service counters that the programs keep if
+// bpf.Binary.PatchServiceCounters is set, keyed by the ID of the service in the frontend map.  The
+// IDs are not dense and a service changes ID when most of its backends change, so it is an LRU map
+// and the counters of the old IDs age out.
+// WARNING: must be kept in sync with cali_v4_svc_ctrs in bpf-gpl/svc_ctrs.h.
+var ServiceCountersMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_svc_ctrs",
+	Type:       "lru_percpu_hash",
+	KeySize:    4,
+	ValueSize:  serviceCountersValueSize,
+	MaxEntries: 16 * 1024,
+	Name:       "cali_v4_svc_ctrs",
+}
+
+func ServiceCountersMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(ServiceCountersMapParams)
+}
+
+// ServiceCounters holds the counters of a service, summed over all CPUs.
+type ServiceCounters [MaxServiceCounter]uint64
+
+// ServiceCountersFromBytes sums the per-CPU values of a lookup in the per-service counters map.
+func ServiceCountersFromBytes(v []byte) ServiceCounters {
+	var c ServiceCounters
+	for _, cpuVal := range bpf.PerCPUValues(v, serviceCountersValueSize) {
+		for i := range c {
+			c[i] += binary.LittleEndian.Uint64(cpuVal[i*8 : i*8+8])
+		}
+	}
+	return c
+}
+
+// ReadServiceCounters reads the counters of the service with the given ID.  The counters don't
+// exist until the programs first look the service up.
+func ReadServiceCounters(m bpf.Map, id uint32) (ServiceCounters, error) {
+	var k [4]byte
+	binary.LittleEndian.PutUint32(k[:], id)
+
+	v, err := m.Get(k[:])
+	if err != nil {
+		return ServiceCounters{}, err
+	}
+	return ServiceCountersFromBytes(v), nil
+}
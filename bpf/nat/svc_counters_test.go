@@ -0,0 +1,55 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nat
+
+import (
+	"encoding/binary"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+func TestReadServiceCounters(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(ServiceCountersMapParams)
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, 7)
+	// Two CPUs.
+	v := make([]byte, 2*serviceCountersValueSize)
+	for cpu := 0; cpu < 2; cpu++ {
+		for c := ServiceCounter(0); c < MaxServiceCounter; c++ {
+			binary.LittleEndian.PutUint64(v[cpu*serviceCountersValueSize+int(c)*8:], uint64(cpu+1)*uint64(c+1))
+		}
+	}
+	m.Contents[string(k)] = string(v)
+
+	ctrs, err := ReadServiceCounters(m, 7)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(ctrs).To(Equal(ServiceCounters{3, 6, 9}))
+
+	_, err = ReadServiceCounters(m, 8)
+	Expect(err).To(HaveOccurred())
+}
+
+func TestServiceCounterNames(t *testing.T) {
+	RegisterTestingT(t)
+
+	for c := ServiceCounter(0); c < MaxServiceCounter; c++ {
+		Expect(c.String()).NotTo(ContainSubstring("service-counter"), "ServiceCounter %d has no name", int(c))
+	}
+}
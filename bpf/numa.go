@@ -0,0 +1,239 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf
+
+import (
+	"fmt"
+	"io/ioutil"
+	"path"
+	"strings"
+
+	"github.com/sirupsen/logrus"
+)
+
+// NumNUMANodes returns the number of NUMA nodes that are online.
+func NumNUMANodes() (int, error) {
+	data, err := ioutil.ReadFile("/sys/devices/system/node/online")
+	if err != nil {
+		return 0, err
+	}
+	// The node list has the same format as the CPU lists.
+	return parseCPURanges(strings.TrimSpace(string(data)))
+}
+
+// NUMAReplica returns the parameters of the replica of the map with the given name, which must fit
+// in BPF_OBJ_NAME_LEN, see NUMAReplicatedMap.
+func (mp MapParameters) NUMAReplica(name string) MapParameters {
+	mp.Name = name
+	mp.Filename = path.Join(path.Dir(mp.Filename), name)
+	mp.Version = 0
+	return mp
+}
+
+// NUMAReplicatedMap is a read-mostly map that has a replica on the second NUMA node, so that the
+// programs that run on that node look up a local copy instead of paying the cross-socket latency on
+// every lookup, see CALI_MAP_NUMA in bpf-gpl/bpf.h.  It writes every update and delete to the
+// primary map first and then to the replica, and reads from the primary.
+type NUMAReplicatedMap struct {
+	primary  Map
+	replicas []Map
+	synced   bool
+}
+
+// NewNUMAReplicatedMap returns the map with the given parameters.  If NUMAReplicasEnabled is set,
+// it is a NUMAReplicatedMap with the replicas that replicaParams describe.
+func (c *MapContext) NewNUMAReplicatedMap(params MapParameters, replicaParams ...MapParameters) Map {
+	primary := c.NewPinnedMap(params)
+	if !c.NUMAReplicasEnabled {
+		return primary
+	}
+	var replicas []Map
+	for _, rp := range replicaParams {
+		replicas = append(replicas, c.NewPinnedMap(rp))
+	}
+	return NewNUMAReplicatedMap(primary, replicas...)
+}
+
+// NewNUMAReplicatedMapWithUpgrades is like NewNUMAReplicatedMap but the primary map carries the
+// entries of its older versions over, see NewPinnedMapWithUpgrades.  The replicas don't need
+// upgrades, EnsureExists syncs them with the primary map.
+func (c *MapContext) NewNUMAReplicatedMapWithUpgrades(params MapParameters, replicaParams []MapParameters,
+	upgrades ...MapUpgrade) Map {
+	primary := c.NewPinnedMapWithUpgrades(params, upgrades...)
+	if !c.NUMAReplicasEnabled {
+		return primary
+	}
+	var replicas []Map
+	for _, rp := range replicaParams {
+		replicas = append(replicas, c.NewPinnedMap(rp))
+	}
+	return NewNUMAReplicatedMap(primary, replicas...)
+}
+
+func NewNUMAReplicatedMap(primary Map, replicas ...Map) *NUMAReplicatedMap {
+	return &NUMAReplicatedMap{primary: primary, replicas: replicas}
+}
+
+func (m *NUMAReplicatedMap) Maps() []Map {
+	return append([]Map{m.primary}, m.replicas...)
+}
+
+// Replicas returns the replicas, without the primary map.
+func (m *NUMAReplicatedMap) Replicas() []Map {
+	return m.replicas
+}
+
+// Context returns the MapContext of the primary map.
+func (m *NUMAReplicatedMap) Context() *MapContext {
+	if pm, ok := m.primary.(*PinnedMap); ok {
+		return pm.Context()
+	}
+	return nil
+}
+
+func (m *NUMAReplicatedMap) GetName() string {
+	return m.primary.GetName()
+}
+
+func (m *NUMAReplicatedMap) MapFD() MapFD {
+	return m.primary.MapFD()
+}
+
+func (m *NUMAReplicatedMap) Path() string {
+	return m.primary.Path()
+}
+
+// EnsureExists creates the maps that don't exist yet and, the first time, brings the replicas in
+// sync with the primary map.  The managers only reconcile the primary map with the dataplane
+// state; a replica may have missed updates while Felix was down or had replicas disabled.
+func (m *NUMAReplicatedMap) EnsureExists() error {
+	for _, r := range m.Maps() {
+		if err := r.EnsureExists(); err != nil {
+			return err
+		}
+	}
+	if m.synced {
+		return nil
+	}
+	for _, r := range m.replicas {
+		if err := m.syncReplica(r); err != nil {
+			return fmt.Errorf("failed to sync NUMA replica %s: %w", r.GetName(), err)
+		}
+	}
+	m.synced = true
+	return nil
+}
+
+// syncReplica copies the entries of the primary map to the replica and then removes the entries
+// that the primary doesn't have.  The replica never misses an entry that both maps have, so the
+// programs that are already using it see no gap.
+func (m *NUMAReplicatedMap) syncReplica(r Map) error {
+	keys := map[string]bool{}
+	var updateErr error
+	err := m.primary.Iter(func(k, v []byte) IteratorAction {
+		keys[string(k)] = true
+		if err := r.Update(k, v); err != nil && updateErr == nil {
+			updateErr = err
+		}
+		return IterNone
+	})
+	if err != nil {
+		return err
+	}
+	if updateErr != nil {
+		return updateErr
+	}
+
+	numStale := 0
+	err = r.Iter(func(k, v []byte) IteratorAction {
+		if keys[string(k)] {
+			return IterNone
+		}
+		numStale++
+		return IterDelete
+	})
+	logrus.WithFields(logrus.Fields{
+		"name":    r.GetName(),
+		"entries": len(keys),
+		"stale":   numStale,
+	}).Info("Synced NUMA replica.")
+	return err
+}
+
+func (m *NUMAReplicatedMap) Open() error {
+	for _, r := range m.Maps() {
+		if err := r.Open(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Iter iterates over the primary map.  The entries that f deletes are deleted from the replicas
+// too.
+func (m *NUMAReplicatedMap) Iter(f IterCallback) error {
+	var deleteErr error
+	err := m.primary.Iter(func(k, v []byte) IteratorAction {
+		action := f(k, v)
+		if action == IterDelete {
+			if err := m.deleteFromReplicas(k); err != nil && deleteErr == nil {
+				deleteErr = err
+			}
+		}
+		return action
+	})
+	if err != nil {
+		return err
+	}
+	return deleteErr
+}
+
+func (m *NUMAReplicatedMap) Update(k, v []byte) error {
+	if err := m.primary.Update(k, v); err != nil {
+		return err
+	}
+	for _, r := range m.replicas {
+		if err := r.Update(k, v); err != nil {
+			return fmt.Errorf("failed to update NUMA replica %s: %w", r.GetName(), err)
+		}
+	}
+	return nil
+}
+
+func (m *NUMAReplicatedMap) Get(k []byte) ([]byte, error) {
+	return m.primary.Get(k)
+}
+
+// Delete deletes the key from all the maps.  It returns the error of the primary map, so that the
+// callers see whether the key existed.
+func (m *NUMAReplicatedMap) Delete(k []byte) error {
+	err := m.primary.Delete(k)
+	if err != nil && !IsNotExists(err) {
+		return err
+	}
+	if rErr := m.deleteFromReplicas(k); rErr != nil {
+		return rErr
+	}
+	return err
+}
+
+func (m *NUMAReplicatedMap) deleteFromReplicas(k []byte) error {
+	for _, r := range m.replicas {
+		if err := r.Delete(k); err != nil && !IsNotExists(err) {
+			return fmt.Errorf("failed to delete from NUMA replica %s: %w", r.GetName(), err)
+		}
+	}
+	return nil
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf_test
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+var numaTestParams = bpf.MapParameters{
+	Filename:  "/sys/fs/bpf/tc/globals/cali_test",
+	Type:      "hash",
+	KeySize:   1,
+	ValueSize: 1,
+	Name:      "cali_test",
+	Version:   2,
+}
+
+func TestNUMAReplicaParams(t *testing.T) {
+	RegisterTestingT(t)
+
+	rp := numaTestParams.NUMAReplica("cali_test2_n1")
+	Expect(rp.VersionedName()).To(Equal("cali_test2_n1"))
+	Expect(rp.Filename).To(Equal("/sys/fs/bpf/tc/globals/cali_test2_n1"))
+	Expect(rp.KeySize).To(Equal(numaTestParams.KeySize))
+}
+
+func TestNUMAReplicatedMapSync(t *testing.T) {
+	RegisterTestingT(t)
+
+	primary := mock.NewMockMap(numaTestParams)
+	replica := mock.NewMockMap(numaTestParams.NUMAReplica("cali_test2_n1"))
+	primary.Contents = map[string]string{"a": "1", "b": "2"}
+	// Left over from before Felix restarted: one stale value and one deleted entry.
+	replica.Contents = map[string]string{"a": "0", "c": "3"}
+
+	m := bpf.NewNUMAReplicatedMap(primary, replica)
+	Expect(m.EnsureExists()).To(Succeed())
+	Expect(replica.Contents).To(Equal(primary.Contents))
+
+	// Only the first EnsureExists syncs.
+	replica.Contents["d"] = "4"
+	Expect(m.EnsureExists()).To(Succeed())
+	Expect(replica.Contents).To(HaveKey("d"))
+}
+
+func TestNUMAReplicatedMapLockstep(t *testing.T) {
+	RegisterTestingT(t)
+
+	primary := mock.NewMockMap(numaTestParams)
+	replica := mock.NewMockMap(numaTestParams.NUMAReplica("cali_test2_n1"))
+	m := bpf.NewNUMAReplicatedMap(primary, replica)
+	Expect(m.EnsureExists()).To(Succeed())
+
+	Expect(m.Update([]byte("a"), []byte("1"))).To(Succeed())
+	Expect(m.Update([]byte("b"), []byte("2"))).To(Succeed())
+	Expect(m.Update([]byte("c"), []byte("3"))).To(Succeed())
+	Expect(replica.Contents).To(Equal(primary.Contents))
+
+	Expect(m.Delete([]byte("a"))).To(Succeed())
+	Expect(replica.Contents).To(Equal(primary.Contents))
+
+	err := m.Iter(func(k, v []byte) bpf.IteratorAction {
+		if string(k) == "b" {
+			return bpf.IterDelete
+		}
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(primary.Contents).To(Equal(map[string]string{"c": "3"}))
+	Expect(replica.Contents).To(Equal(primary.Contents))
+
+	Expect(bpf.DeleteAll(m)).To(Succeed())
+	Expect(primary.Contents).To(BeEmpty())
+	Expect(replica.Contents).To(BeEmpty())
+
+	// Reads only go to the primary.
+	replica.GetCount = 0
+	_, err = m.Get([]byte("c"))
+	Expect(bpf.IsNotExists(err)).To(BeTrue())
+	Expect(replica.GetCount).To(BeZero())
+}
+
+func TestNUMAReplicasDisabled(t *testing.T) {
+	RegisterTestingT(t)
+
+	mc := &bpf.MapContext{}
+	m := mc.NewNUMAReplicatedMap(numaTestParams, numaTestParams.NUMAReplica("cali_test2_n1"))
+	Expect(m).To(BeAssignableToTypeOf(&bpf.PinnedMap{}))
+
+	mc.NUMAReplicasEnabled = true
+	m = mc.NewNUMAReplicatedMap(numaTestParams, numaTestParams.NUMAReplica("cali_test2_n1"))
+	Expect(m).To(BeAssignableToTypeOf(&bpf.NUMAReplicatedMap{}))
+	Expect(bpf.PinnedMaps([]bpf.Map{m})).To(HaveLen(2))
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package polcache
+
+import (
+	"encoding/binary"
+	"fmt"
+	"sync"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// WARNING: must be kept in sync with the definitions in bpf-gpl/policy_cache.h.
+// uint32 ifindex       4
+// uint32 src BE        +4 = 8
+// uint32 dst BE        +4 = 12
+// uint16 dport HE      +2 = 14
+// uint8 proto          +1 = 15
+// uint8 flags          +1 = 16
+const (
+	KeySize   = 16
+	ValueSize = 4
+)
+
+// VerdictMapParams describes the policy verdict cache.  The TC program caches the allow verdicts
+// of the policy program for new flows, keyed on the interface, direction, source and post-DNAT
+// destination, so that further flows from the same client skip the policy program.  Each entry
+// holds the policy generation that it was created in; entries from older generations are ignored.
+var VerdictMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_pol_vc",
+	Type:       "lru_hash",
+	KeySize:    KeySize,
+	ValueSize:  ValueSize,
+	MaxEntries: 64 * 1024,
+	Name:       "cali_v4_pol_vc",
+}
+
+func VerdictMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(VerdictMapParams)
+}
+
+// GenerationMapParams describes the single entry map that holds the current policy generation.
+var GenerationMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_pol_gen",
+	Type:       "array",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 1,
+	Name:       "cali_v4_pol_gen",
+}
+
+func GenerationMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(GenerationMapParams)
+}
+
+// Generation owns the policy generation in the generation map.  It must be bumped whenever the
+// verdict of a policy program may have changed, i.e. after a policy program is installed or
+// removed and after the members of an IP set change.
+type Generation struct {
+	lock sync.Mutex
+	m    bpf.Map
+	gen  uint32
+}
+
+// NewGeneration returns a Generation that continues from the value in the map, so that entries
+// cached before a restart of Felix are invalidated by the first bump.
+func NewGeneration(m bpf.Map) *Generation {
+	g := &Generation{m: m}
+	v, err := m.Get(generationKey())
+	if err == nil && len(v) == ValueSize {
+		g.gen = binary.LittleEndian.Uint32(v)
+	}
+	return g
+}
+
+// Bump invalidates all the verdicts in the cache.  It is safe to call concurrently.
+func (g *Generation) Bump() error {
+	g.lock.Lock()
+	defer g.lock.Unlock()
+
+	g.gen++
+	v := make([]byte, ValueSize)
+	binary.LittleEndian.PutUint32(v, g.gen)
+	err := g.m.Update(generationKey(), v)
+	if err != nil {
+		return fmt.Errorf("failed to update policy generation: %w", err)
+	}
+	log.WithField("generation", g.gen).Debug("Bumped policy generation.")
+	return nil
+}
+
+func generationKey() []byte {
+	return make([]byte, 4)
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package polcache
+
+import (
+	"encoding/binary"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+)
+
+func TestGenerationBump(t *testing.T) {
+	RegisterTestingT(t)
+
+	m := mock.NewMockMap(GenerationMapParams)
+	v := make([]byte, ValueSize)
+	binary.LittleEndian.PutUint32(v, 41)
+	Expect(m.Update(generationKey(), v)).To(Succeed())
+
+	g := NewGeneration(m)
+	Expect(g.Bump()).To(Succeed())
+
+	v, err := m.Get(generationKey())
+	Expect(err).NotTo(HaveOccurred())
+	Expect(binary.LittleEndian.Uint32(v)).To(Equal(uint32(42)))
+}
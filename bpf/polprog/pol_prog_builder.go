@@ -18,6 +18,7 @@ import (
 	"fmt"
 	"math"
 	"math/bits"
+	"sort"
 	"strings"
 
 	"github.com/projectcalico/felix/bpf/ipsets"
@@ -27,6 +28,7 @@ import (
 	log "github.com/sirupsen/logrus"
 
 	. "github.com/projectcalico/felix/bpf/asm"
+	"github.com/projectcalico/felix/bpf/counters"
 	"github.com/projectcalico/felix/bpf/state"
 	"github.com/projectcalico/felix/ip"
 	"github.com/projectcalico/felix/proto"
@@ -38,28 +40,153 @@ type Builder struct {
 	tierID          int
 	policyID        int
 	ruleID          int
+	groupID         int
 	rulePartID      int
 	ipSetIDProvider ipSetIDProvider
-
-	ipSetMapFD bpf.MapFD
-	stateMapFD bpf.MapFD
-	jumpMapFD  bpf.MapFD
+	exactIPSets     exactIPSetProvider
+	memberIPSets    memberIPSetProvider
+	// memberLookupID numbers the labels of the member map lookups.
+	memberLookupID int
+	// numaReplicaFDs maps the IP set maps to their replicas on the second NUMA node, see
+	// EnableNUMAReplicas.
+	numaReplicaFDs map[bpf.MapFD]bpf.MapFD
+	// numaLookupID numbers the labels of the lookups that pick a NUMA replica.
+	numaLookupID int
+	// verdictCache is set if the program may mark its allow verdicts as cacheable, see
+	// EnableVerdictCache.
+	verdictCache bool
+	// cacheable is set if the policy being built allows the verdict to be cached.
+	cacheable bool
+	// ruleGrouping is set if the builder checks the criteria that runs of rules share once per
+	// run, see EnableRuleGrouping.
+	ruleGrouping bool
+	// ruleCounters is set if the program counts the packets that each rule matches, see
+	// EnableRuleCounters.
+	ruleCounters   bool
+	ruleCountersFD bpf.MapFD
+	ruleCounterIDs map[uint64]RuleCounterID
+	policyName     string
+	// xdp is set if the program runs in the XDP program rather than in TC, see EnableXDP.
+	xdp bool
+
+	ipSetMapFD      bpf.MapFD
+	ipSetExactMapFD bpf.MapFD
+	ipSetMemberFD   bpf.MapFD
+	stateMapFD      bpf.MapFD
+	jumpMapFD       bpf.MapFD
+
+	// maxInsnsPerProgram is the size after which Programs() starts a new program in the chain.
+	maxInsnsPerProgram int
+	// splitAt is the limit in use by the current build, 0 if the policy must fit in one program.
+	splitAt int
+	// programs holds the already complete programs of the chain.
+	programs []Insns
+	// resumeIDs maps labels that are jumped to across programs to the ID that the jumping
+	// program stores in the state for the next program to resume at.
+	resumeIDs map[string]int32
+	err       error
 }
 
 type ipSetIDProvider interface {
 	GetNoAlloc(ipSetID string) uint64
 }
 
+type exactIPSetProvider interface {
+	// IPSetIsExact returns true if all the members of the IP set are in the exact-match map.
+	IPSetIsExact(id uint64) bool
+}
+
+type memberIPSetProvider interface {
+	// IPSetMemberBit returns the bit of the IP set in the member map, if the IP set is stored
+	// there.
+	IPSetMemberBit(id uint64) (int, bool)
+}
+
 func NewBuilder(ipSetIDProvider ipSetIDProvider, ipsetMapFD, stateMapFD, jumpMapFD bpf.MapFD) *Builder {
 	b := &Builder{
-		ipSetIDProvider: ipSetIDProvider,
-		ipSetMapFD:      ipsetMapFD,
-		stateMapFD:      stateMapFD,
-		jumpMapFD:       jumpMapFD,
+		ipSetIDProvider:    ipSetIDProvider,
+		ipSetMapFD:         ipsetMapFD,
+		stateMapFD:         stateMapFD,
+		jumpMapFD:          jumpMapFD,
+		maxInsnsPerProgram: DefaultMaxInsnsPerProgram,
 	}
 	return b
 }
 
+// SetMaxInsnsPerProgram sets the number of instructions after which Programs() moves the
+// remaining rules to the next program in the chain.  The limit is checked between rules so a
+// program can exceed it by one rule and its footer.
+func (p *Builder) SetMaxInsnsPerProgram(n int) {
+	p.maxInsnsPerProgram = n
+}
+
+// EnableExactIPSets makes the builder look up IP sets that have no prefix members in the
+// exact-match IP set hash map (see ipsets.ExactMapParameters) rather than in the LPM trie.
+func (p *Builder) EnableExactIPSets(exactIPSets exactIPSetProvider, ipsetExactMapFD bpf.MapFD) {
+	p.exactIPSets = exactIPSets
+	p.ipSetExactMapFD = ipsetExactMapFD
+}
+
+// EnableMemberIPSets makes the builder look up the IP sets that are stored in the IP set member
+// map (see ipsets.MembersMapParameters) there: one lookup of the address, port and protocol, then
+// a test of the IP set's bit in the value.  It takes precedence over EnableExactIPSets.
+func (p *Builder) EnableMemberIPSets(memberIPSets memberIPSetProvider, ipsetMemberMapFD bpf.MapFD) {
+	p.memberIPSets = memberIPSets
+	p.ipSetMemberFD = ipsetMemberMapFD
+}
+
+// EnableNUMAReplicas makes the program look up the IP sets in the replicas of their maps when it
+// runs on the second NUMA node, see bpf.NUMAReplicatedMap.  replicaFDs maps the fd of each IP set
+// map to the fd of its replica.
+func (p *Builder) EnableNUMAReplicas(replicaFDs map[bpf.MapFD]bpf.MapFD) {
+	p.numaReplicaFDs = replicaFDs
+}
+
+// EnableVerdictCache makes the program set FlagPolicyCacheable in the state when it allows a
+// packet and the verdict depends only on the fields of the policy verdict cache key, i.e. when no
+// rule matches on the source port and there is no pre-DNAT policy.  The TC program then caches
+// the verdict for the following new flows that share the key, see polcache.VerdictMapParams.
+func (p *Builder) EnableVerdictCache() {
+	p.verdictCache = true
+}
+
+// EnableRuleGrouping makes the builder split the rules of each policy into runs of consecutive
+// rules that match the same protocol.  The program checks the protocol, the IP sets that all the
+// rules of the run match on and, if every rule matches on destination ports, the union of those
+// ports, once at the start of the run and skips the whole run if they don't match.  The rules of
+// the run then only check their other criteria.  Rules are still evaluated in order.
+func (p *Builder) EnableRuleGrouping() {
+	p.ruleGrouping = true
+}
+
+// EnableXDP makes the builder build the untracked (DoNotTrack) policy of a host endpoint, the tiers
+// in Rules.HostUntrackedTiers, for the XDP program rather than a TC policy program.  The program
+// drops the packets that the policy denies with XDP_DROP.  It stores PolicyAllow, or PolicyNoMatch
+// if no policy matched, in the state and tail calls the epilogue of the XDP program, which lets the
+// allowed packets bypass conntrack and policy in TC and passes the others on as before.
+func (p *Builder) EnableXDP() {
+	p.xdp = true
+}
+
+// RuleCounterID identifies the rule that a hit counter belongs to.
+type RuleCounterID struct {
+	Policy string
+	RuleID string
+}
+
+// EnableRuleCounters makes the program count, in the per-CPU map in ruleCountersMapFD, the packets
+// that each policy rule with a rule ID matches; see counters.RuleMapParams for the keys.  Only the
+// first packet of each flow goes through policy, so the counters count flows.
+func (p *Builder) EnableRuleCounters(ruleCountersMapFD bpf.MapFD) {
+	p.ruleCounters = true
+	p.ruleCountersFD = ruleCountersMapFD
+}
+
+// RuleCounterIDs returns the rules with hit counters in the program from the last build, by key.
+func (p *Builder) RuleCounterIDs() map[uint64]RuleCounterID {
+	return p.ruleCounterIDs
+}
+
 var offset int = 0
 
 func nextOffset(size int, align int) int16 {
@@ -82,6 +209,8 @@ var (
 	offStateKey    = nextOffset(4, 4)
 	offSrcIPSetKey = nextOffset(ipsets.IPSetEntrySize, 8)
 	offDstIPSetKey = nextOffset(ipsets.IPSetEntrySize, 8)
+	offRuleCtrKey  = nextOffset(8, 8)
+	offRuleCtrVal  = nextOffset(8, 8)
 
 	// Offsets within the cal_tc_state struct.
 	// WARNING: must be kept in sync with the definitions in bpf/include/jump.h.
@@ -100,6 +229,7 @@ var (
 	stateOffPostNATDstPort int16 = stateEventHdrSize + 30
 	stateOffIPProto        int16 = stateEventHdrSize + 32
 	stateOffFlags          int16 = stateEventHdrSize + 33
+	stateOffPolResume      int16 = stateEventHdrSize + 112
 
 	// Compile-time check that IPSetEntrySize hasn't changed; if it changes, the code will need to change.
 	_ = [1]struct{}{{}}[20-ipsets.IPSetEntrySize]
@@ -117,6 +247,8 @@ var (
 	// Bits in the state flags field.
 	FlagDestIsHost uint8 = 1 << 2
 	FlagSrcIsHost  uint8 = 1 << 3
+	// FlagPolicyCacheable is set by the program on the allow path if the verdict may be cached.
+	FlagPolicyCacheable uint8 = 1 << 4
 )
 
 type Rule struct {
@@ -154,10 +286,12 @@ type Rules struct {
 	Profiles []Profile
 
 	// Host endpoint policy.
-	HostPreDnatTiers []Tier
-	HostForwardTiers []Tier
-	HostNormalTiers  []Tier
-	HostProfiles     []Profile
+	// HostUntrackedTiers is only evaluated by programs built for XDP, see Builder.EnableXDP.
+	HostUntrackedTiers []Tier
+	HostPreDnatTiers   []Tier
+	HostForwardTiers   []Tier
+	HostNormalTiers    []Tier
+	HostProfiles       []Profile
 }
 
 type Profile = Policy
@@ -170,10 +304,44 @@ const (
 	TierEndPass  TierEndAction = "pass"
 )
 
+// Instructions returns the policy as a single program.
 func (p *Builder) Instructions(rules Rules) (Insns, error) {
+	progs, err := p.build(rules, 0)
+	if err != nil {
+		return nil, err
+	}
+	return progs[0], nil
+}
+
+// Programs returns the policy as a chain of programs, each of them limited to roughly
+// SetMaxInsnsPerProgram() instructions.  The first program goes in the jump map at the policy
+// index, the others at the indices returned by PolicyJumpIndex().  Each program tail calls the
+// next one when evaluation continues past its last rule, storing the point to resume at in the
+// state.
+func (p *Builder) Programs(rules Rules) ([]Insns, error) {
+	return p.build(rules, p.maxInsnsPerProgram)
+}
+
+func (p *Builder) build(rules Rules, splitAt int) ([]Insns, error) {
+	p.tierID, p.policyID, p.ruleID, p.rulePartID, p.groupID = 0, 0, 0, 0, 0
+	p.splitAt = splitAt
+	p.programs = nil
+	p.resumeIDs = map[string]int32{}
+	p.err = nil
+	p.cacheable = p.verdictCache && !p.xdp && verdictIsCacheable(rules)
+	p.ruleCounterIDs = nil
+	if p.ruleCounters {
+		p.ruleCounterIDs = map[uint64]RuleCounterID{}
+	}
+
 	p.b = NewBlock()
 	p.writeProgramHeader()
 
+	if p.xdp {
+		p.writeXDPPolicy(rules)
+		return p.assemble()
+	}
+
 	// Pre-DNAT policy: on a host interface, or host-* policy on a workload interface.  Traffic
 	// is allowed to continue if there is no applicable pre-DNAT policy.
 	p.writeTiers(rules.HostPreDnatTiers, legDestPreNAT, "allowed_by_host_policy")
@@ -226,7 +394,30 @@ func (p *Builder) Instructions(rules Rules) (Insns, error) {
 	}
 
 	p.writeProgramFooter()
-	return p.b.Assemble()
+	return p.assemble()
+}
+
+// writeXDPPolicy emits the untracked policy, see EnableXDP.  Untracked policy doesn't end its tiers
+// with a deny, a packet that no policy matches falls through to the rest of the processing.
+func (p *Builder) writeXDPPolicy(rules Rules) {
+	p.writeTiers(rules.HostUntrackedTiers, legDest, "allow")
+
+	p.b.MovImm32(R1, int32(state.PolicyNoMatch))
+	p.b.Store32(R9, R1, stateOffPolResult)
+	p.b.Jump("epilogue")
+
+	p.writeProgramFooter()
+}
+
+func (p *Builder) assemble() ([]Insns, error) {
+	if p.err != nil {
+		return nil, p.err
+	}
+	insns, err := p.b.Assemble()
+	if err != nil {
+		return nil, err
+	}
+	return append(p.programs, insns), nil
 }
 
 // writeProgramHeader emits instructions to load the state from the state map, leaving
@@ -258,10 +449,28 @@ const (
 	jumpIdxEpilogue
 	jumpIdxICMP
 
-	_ = jumpIdxPolicy
 	_ = jumpIdxICMP
 )
 
+const (
+	// WARNING: must be kept in sync with PROG_INDEX_POLICY_CONT in bpf-gpl/jump.h.
+	jumpIdxPolicyCont = 8
+	// MaxPolicyContinuations is the number of jump map slots for policy programs after the first.
+	MaxPolicyContinuations = 8
+	// DefaultMaxInsnsPerProgram keeps each program well clear of the verifier limits and of the
+	// range of 16-bit jump offsets.
+	DefaultMaxInsnsPerProgram = 8192
+)
+
+// PolicyJumpIndex returns the jump map index of the given program in the chain returned by
+// Programs().
+func PolicyJumpIndex(i int) int {
+	if i == 0 {
+		return jumpIdxPolicy
+	}
+	return jumpIdxPolicyCont + i - 1
+}
+
 func (p *Builder) writeJumpIfToOrFromHost(label string) {
 	// Load state flags.
 	p.b.Load8(R1, R9, stateOffFlags)
@@ -277,14 +486,26 @@ func (p *Builder) writeJumpIfToOrFromHost(label string) {
 func (p *Builder) writeProgramFooter() {
 	// Fall through here if there's no match.  Also used when we hit an error or if policy rejects packet.
 	p.b.LabelNextInsn("deny")
-	p.b.MovImm64(R0, 2 /* TC_ACT_SHOT */)
+	p.b.MovImm64(R0, p.dropAction())
 	p.b.Exit()
 
 	if p.b.TargetIsUsed("allow") {
 		p.b.LabelNextInsn("allow")
+		if p.cacheable {
+			// Tell the next program that it may cache the verdict.
+			p.b.Load8(R1, R9, stateOffFlags)
+			p.b.OrImm32(R1, int32(FlagPolicyCacheable))
+			p.b.Store8(R9, R1, stateOffFlags)
+		}
 		// Store the policy result in the state for the next program to see.
 		p.b.MovImm32(R1, int32(state.PolicyAllow))
 		p.b.Store32(R9, R1, stateOffPolResult)
+	}
+	if p.xdp {
+		// The XDP epilogue also takes the packets that no policy matched.
+		p.b.LabelNextInsn("epilogue")
+	}
+	if p.b.TargetIsUsed("allow") || p.xdp {
 		// Execute the tail call.
 		p.b.Mov64(R1, R6)                      // First arg is the context.
 		p.b.LoadMapFD(R2, uint32(p.jumpMapFD)) // Second arg is the map.
@@ -294,26 +515,75 @@ func (p *Builder) writeProgramFooter() {
 		// Fall through if tail call fails.
 		p.b.MovImm32(R1, state.PolicyTailCallFailed)
 		p.b.Store32(R9, R1, stateOffPolResult)
-		p.b.MovImm64(R0, 2 /* TC_ACT_SHOT */)
+		p.b.MovImm64(R0, p.dropAction())
 		p.b.Exit()
 	}
 }
 
-func (p *Builder) setUpIPSetKey(ipsetID uint64, keyOffset, ipOffset, portOffset int16) {
+// dropAction returns the return code with which the program drops a packet.
+func (p *Builder) dropAction() int32 {
+	if p.xdp {
+		return 1 /* XDP_DROP */
+	}
+	return 2 /* TC_ACT_SHOT */
+}
+
+// verdictIsCacheable returns true if the verdict of the policy depends only on the fields of the
+// policy verdict cache key: the source and post-DNAT destination IPs, protocol and post-DNAT
+// destination port (or ICMP type and code).
+func verdictIsCacheable(rules Rules) bool {
+	for _, t := range rules.HostPreDnatTiers {
+		for _, pol := range t.Policies {
+			if len(pol.Rules) > 0 {
+				// Pre-DNAT policy matches the pre-DNAT destination, which isn't in the key.
+				return false
+			}
+		}
+	}
+	tierSets := [][]Tier{rules.HostForwardTiers, rules.HostNormalTiers, rules.Tiers}
+	for _, tiers := range tierSets {
+		for _, t := range tiers {
+			if !policiesAreCacheable(t.Policies) {
+				return false
+			}
+		}
+	}
+	return policiesAreCacheable(rules.HostProfiles) && policiesAreCacheable(rules.Profiles)
+}
+
+func policiesAreCacheable(policies []Policy) bool {
+	for _, pol := range policies {
+		for _, r := range pol.Rules {
+			if len(r.SrcPorts) > 0 || len(r.SrcNamedPortIpSetIds) > 0 ||
+				len(r.NotSrcPorts) > 0 || len(r.NotSrcNamedPortIpSetIds) > 0 {
+				return false
+			}
+		}
+	}
+	return true
+}
+
+func (p *Builder) setUpIPSetKey(ipsetID uint64, keyOffset, ipOffset, portOffset int16, zeroPortAndProto bool) {
 	// TODO track whether we've already done an initialisation and skip the parts that don't change.
 	// Zero the padding.
 	p.b.MovImm64(R1, 0) // R1 = 0
 	p.b.StoreStack8(R1, keyOffset+ipsKeyPad)
+	if zeroPortAndProto {
+		p.b.StoreStack16(R1, keyOffset+ipsKeyPort)
+		p.b.StoreStack8(R1, keyOffset+ipsKeyProto)
+	}
 	p.b.MovImm64(R1, 128) // R1 = 128
 	p.b.StoreStack32(R1, keyOffset+ipsKeyPrefix)
 
 	// Store the IP address, port and protocol.
 	p.b.Load32(R1, R9, ipOffset)
 	p.b.StoreStack32(R1, keyOffset+ipsKeyAddr)
-	p.b.Load16(R1, R9, portOffset)
-	p.b.StoreStack16(R1, keyOffset+ipsKeyPort)
-	p.b.Load8(R1, R9, stateOffIPProto)
-	p.b.StoreStack8(R1, keyOffset+ipsKeyProto)
+	if !zeroPortAndProto {
+		p.b.Load16(R1, R9, portOffset)
+		p.b.StoreStack16(R1, keyOffset+ipsKeyPort)
+		p.b.Load8(R1, R9, stateOffIPProto)
+		p.b.StoreStack8(R1, keyOffset+ipsKeyProto)
+	}
 
 	// Store the IP set ID.  It is 64-bit but, since it's a packed struct, we have to write it in two
 	// 32-bit chunks.
@@ -366,6 +636,10 @@ func (p *Builder) writeProfiles(profiles []Policy, allowLabel string) {
 }
 
 func (p *Builder) writePolicyRules(policy Policy, actionLabels map[string]string, destLeg matchLeg) {
+	if p.ruleGrouping {
+		p.writeGroupedPolicyRules(policy, actionLabels, destLeg)
+		return
+	}
 	for ruleIdx, rule := range policy.Rules {
 		log.Debugf("Start of rule %d", ruleIdx)
 		action := strings.ToLower(rule.Action)
@@ -378,9 +652,222 @@ func (p *Builder) writePolicyRules(policy Policy, actionLabels map[string]string
 	}
 }
 
+// ruleGroup is a run of consecutive rules that match the same protocol, with the criteria that
+// they share hoisted out of the rules.
+type ruleGroup struct {
+	protocol    uint8
+	rules       []Rule
+	actions     []string
+	srcIPSetIDs []string
+	dstIPSetID  string
+	dstPorts    []*proto.PortRange
+}
+
+func (p *Builder) writeGroupedPolicyRules(policy Policy, actionLabels map[string]string, destLeg matchLeg) {
+	var groupable []Rule
+	var actions []string
+	for _, rule := range policy.Rules {
+		action := strings.ToLower(rule.Action)
+		if action == "log" {
+			log.Debug("Skipping log rule.  Not supported in BPF mode.")
+			continue
+		}
+		r := rules.FilterRuleToIPVersion(4, rule.Rule)
+		if r == nil {
+			log.Debugf("Version mismatch, skipping rule")
+			continue
+		}
+		groupable = append(groupable, Rule{Rule: r})
+		actions = append(actions, actionLabels[action])
+	}
+
+	for len(groupable) > 0 {
+		n := 1
+		if groupable[0].Protocol != nil {
+			pcol := protocolToNumber(groupable[0].Protocol)
+			for n < len(groupable) && groupable[n].Protocol != nil && protocolToNumber(groupable[n].Protocol) == pcol {
+				n++
+			}
+		}
+		if n == 1 {
+			p.writeRule(groupable[0], actions[0], destLeg)
+		} else {
+			p.writeRuleGroup(makeRuleGroup(groupable[:n], actions[:n]), destLeg)
+		}
+		groupable, actions = groupable[n:], actions[n:]
+	}
+}
+
+// makeRuleGroup finds the criteria that all the rules share and returns the group with copies of
+// the rules that no longer check them.
+func makeRuleGroup(rules []Rule, actions []string) *ruleGroup {
+	g := &ruleGroup{
+		protocol: protocolToNumber(rules[0].Protocol),
+		actions:  actions,
+	}
+
+	// All the source IP sets of a rule must match so any set that every rule has can be checked
+	// once.  A rule has at most one destination IP set, see writeRule.
+	for _, id := range rules[0].SrcIpSetIds {
+		shared := true
+		for _, r := range rules[1:] {
+			if !containsString(r.SrcIpSetIds, id) {
+				shared = false
+				break
+			}
+		}
+		if shared {
+			g.srcIPSetIDs = append(g.srcIPSetIDs, id)
+		}
+	}
+	if len(rules[0].DstIpSetIds) == 1 {
+		g.dstIPSetID = rules[0].DstIpSetIds[0]
+		for _, r := range rules[1:] {
+			if len(r.DstIpSetIds) != 1 || r.DstIpSetIds[0] != g.dstIPSetID {
+				g.dstIPSetID = ""
+				break
+			}
+		}
+	}
+
+	// If every rule needs one of its destination ports then the packet must be in the union of
+	// them.  The rules still check their own ports.
+	var ports []*proto.PortRange
+	for _, r := range rules {
+		if len(r.DstPorts) == 0 || len(r.DstNamedPortIpSetIds) > 0 {
+			ports = nil
+			break
+		}
+		ports = append(ports, r.DstPorts...)
+	}
+	g.dstPorts = mergePortRanges(ports)
+
+	for _, r := range rules {
+		rCopy := *r.Rule
+		rCopy.Protocol = nil
+		if len(g.srcIPSetIDs) > 0 {
+			rCopy.SrcIpSetIds = nil
+			for _, id := range r.SrcIpSetIds {
+				if !containsString(g.srcIPSetIDs, id) {
+					rCopy.SrcIpSetIds = append(rCopy.SrcIpSetIds, id)
+				}
+			}
+		}
+		if g.dstIPSetID != "" {
+			rCopy.DstIpSetIds = nil
+		}
+		g.rules = append(g.rules, Rule{Rule: &rCopy})
+	}
+
+	return g
+}
+
+// mergePortRanges returns the ranges sorted and with overlapping and adjacent ranges merged.
+func mergePortRanges(ranges []*proto.PortRange) []*proto.PortRange {
+	if len(ranges) == 0 {
+		return nil
+	}
+	sorted := make([]*proto.PortRange, len(ranges))
+	copy(sorted, ranges)
+	sort.Slice(sorted, func(i, j int) bool {
+		return sorted[i].First < sorted[j].First
+	})
+
+	merged := []*proto.PortRange{{First: sorted[0].First, Last: sorted[0].Last}}
+	for _, r := range sorted[1:] {
+		last := merged[len(merged)-1]
+		if r.First <= last.Last+1 {
+			if r.Last > last.Last {
+				last.Last = r.Last
+			}
+			continue
+		}
+		merged = append(merged, &proto.PortRange{First: r.First, Last: r.Last})
+	}
+	return merged
+}
+
+func containsString(strs []string, s string) bool {
+	for _, x := range strs {
+		if x == s {
+			return true
+		}
+	}
+	return false
+}
+
+func (p *Builder) writeRuleGroup(g *ruleGroup, destLeg matchLeg) {
+	groupID := p.groupID
+	p.groupID++
+	noMatchLabel := fmt.Sprintf("group_%d_no_match", groupID)
+	log.WithFields(log.Fields{
+		"proto":     g.protocol,
+		"rules":     len(g.rules),
+		"srcIPSets": g.srcIPSetIDs,
+		"dstIPSet":  g.dstIPSetID,
+		"dstPorts":  g.dstPorts,
+	}).Debugf("Start of rule group")
+
+	p.writeStartOfRule()
+	p.b.Load8(R1, R9, stateOffIPProto)
+	p.b.JumpNEImm64(R1, int32(g.protocol), noMatchLabel)
+	for _, id := range g.srcIPSetIDs {
+		p.writeIPSetLookup(legSource, id, false)
+		p.b.JumpEqImm64(R0, 0, noMatchLabel)
+	}
+	if g.dstIPSetID != "" {
+		p.writeIPSetLookup(destLeg, g.dstIPSetID, false)
+		p.b.JumpEqImm64(R0, 0, noMatchLabel)
+	}
+	if len(g.dstPorts) > 0 {
+		p.b.Load16(R1, R9, destLeg.offsetToStatePortField())
+		partID := 0
+		p.writePortRangesSearch(g.dstPorts, noMatchLabel, func() string {
+			partID++
+			return fmt.Sprintf("group_%d_part_%d", groupID, partID)
+		})
+	}
+
+	for i, r := range g.rules {
+		p.writeRule(r, g.actions[i], destLeg)
+	}
+
+	p.b.LabelNextInsn(noMatchLabel)
+	log.Debugf("End of rule group")
+}
+
+// writePortRangesSearch emits a binary search of the sorted, disjoint ranges for the port in R1,
+// jumping to noMatchLabel if the port isn't in any of them and falling through if it is.
+func (p *Builder) writePortRangesSearch(ranges []*proto.PortRange, noMatchLabel string, freshLabel func() string) {
+	if len(ranges) <= 4 {
+		matchLabel := freshLabel()
+		for _, r := range ranges {
+			if r.First > 0 {
+				p.b.JumpLTImm64(R1, r.First, noMatchLabel)
+			}
+			p.b.JumpLEImm64(R1, r.Last, matchLabel)
+		}
+		p.b.Jump(noMatchLabel)
+		p.b.LabelNextInsn(matchLabel)
+		return
+	}
+
+	mid := len(ranges) / 2
+	upperLabel := freshLabel()
+	doneLabel := freshLabel()
+	p.b.JumpGEImm64(R1, ranges[mid].First, upperLabel)
+	p.writePortRangesSearch(ranges[:mid], noMatchLabel, freshLabel)
+	p.b.Jump(doneLabel)
+	p.b.LabelNextInsn(upperLabel)
+	p.writePortRangesSearch(ranges[mid:], noMatchLabel, freshLabel)
+	p.b.LabelNextInsn(doneLabel)
+}
+
 func (p *Builder) writePolicy(policy Policy, actionLabels map[string]string, destLeg matchLeg) {
 	log.Debugf("Start of policy %q %d", policy.Name, p.policyID)
+	p.policyName = policy.Name
 	p.writePolicyRules(policy, actionLabels, destLeg)
+	p.policyName = ""
 	log.Debugf("End of policy %q %d", policy.Name, p.policyID)
 	p.policyID++
 }
@@ -393,7 +880,9 @@ func (p *Builder) writeProfile(profile Profile, idx int, allowLabel string) {
 		"next-tier": "deny",
 	}
 	log.Debugf("Start of profile %q %d", profile.Name, idx)
+	p.policyName = profile.Name
 	p.writePolicyRules(profile, actionLabels, legDest)
+	p.policyName = ""
 	log.Debugf("End of profile %q %d", profile.Name, idx)
 	p.policyID++
 }
@@ -542,17 +1031,118 @@ func (p *Builder) writeRule(r Rule, actionLabel string, destLeg matchLeg) {
 }
 
 func (p *Builder) writeStartOfRule() {
+	if p.splitAt <= 0 || p.b.NumInsns() < p.splitAt {
+		return
+	}
+	if len(p.programs) >= MaxPolicyContinuations {
+		if p.err == nil {
+			p.err = fmt.Errorf("policy needs more than %d programs of %d instructions",
+				MaxPolicyContinuations+1, p.splitAt)
+		}
+		return
+	}
+	p.startNextProgram()
+}
+
+// startNextProgram completes the current program and continues the policy in a new one.  Jumps
+// to labels that the current program doesn't define (including falling through to the next rule)
+// become tail calls to the next program, which dispatches on the resume ID in the state.  If a
+// label isn't in the next program either, that program passes it on in the same way.
+func (p *Builder) startNextProgram() {
+	resumeLabel := fmt.Sprintf("resume_rule_%d", p.ruleID)
+	p.b.Jump(resumeLabel)
+	p.writeProgramFooter()
+
+	carriedLabels := p.b.UnresolvedLabels()
+	nextIdx := PolicyJumpIndex(len(p.programs) + 1)
+	for _, label := range carriedLabels {
+		id, ok := p.resumeIDs[label]
+		if !ok {
+			id = int32(len(p.resumeIDs) + 1)
+			p.resumeIDs[label] = id
+		}
+		p.b.LabelNextInsn(label)
+		p.b.MovImm32(R1, id)
+		p.b.Store32(R9, R1, stateOffPolResume)
+		p.b.Jump("next_program")
+	}
+	p.b.LabelNextInsn("next_program")
+	p.b.Mov64(R1, R6)                      // First arg is the context.
+	p.b.LoadMapFD(R2, uint32(p.jumpMapFD)) // Second arg is the map.
+	p.b.MovImm32(R3, int32(nextIdx))       // Third arg is the index.
+	p.b.Call(HelperTailCall)
+
+	// Fall through if tail call fails.
+	p.b.MovImm32(R1, state.PolicyTailCallFailed)
+	p.b.Store32(R9, R1, stateOffPolResult)
+	p.b.MovImm64(R0, p.dropAction())
+	p.b.Exit()
+
+	insns, err := p.b.Assemble()
+	if err != nil && p.err == nil {
+		p.err = err
+	}
+	log.WithFields(log.Fields{"program": len(p.programs), "insns": len(insns)}).Debug(
+		"Policy program complete, continuing in next program")
+	p.programs = append(p.programs, insns)
+
+	p.b = NewBlock()
+	p.writeProgramHeader()
+	p.b.Load32(R1, R9, stateOffPolResume)
+	for _, label := range carriedLabels {
+		p.b.JumpEqImm32(R1, p.resumeIDs[label], label)
+	}
+	p.b.Jump("deny")
+	p.b.LabelNextInsn(resumeLabel)
 }
 
 func (p *Builder) writeEndOfRule(rule Rule, actionLabel string) {
 	// If all the match criteria are met, we fall through to the end of the rule
 	// so all that's left to do is to jump to the relevant action.
 	// TODO log and log-and-xxx actions
+	if p.ruleCounters && p.policyName != "" && rule.RuleId != "" {
+		p.writeRuleCounterInc(p.policyName, rule.RuleId)
+	}
 	p.b.Jump(actionLabel)
 
 	p.b.LabelNextInsn(p.endOfRuleLabel())
 }
 
+// writeRuleCounterInc emits an increment of the rule's hit counter, creating the counter if this
+// is the rule's first hit on this CPU.
+func (p *Builder) writeRuleCounterInc(policy, ruleID string) {
+	key := counters.RuleCounterKey(policy, ruleID)
+	p.ruleCounterIDs[key] = RuleCounterID{Policy: policy, RuleID: ruleID}
+	incLabel := p.freshPerRuleLabel()
+	doneLabel := p.freshPerRuleLabel()
+
+	p.b.LoadImm64(R1, int64(key))
+	p.b.StoreStack64(R1, offRuleCtrKey)
+	p.b.LoadMapFD(R1, uint32(p.ruleCountersFD))
+	p.b.Mov64(R2, R10)
+	p.b.AddImm64(R2, int32(offRuleCtrKey))
+	p.b.Call(HelperMapLookupElem)
+	p.b.JumpNEImm64(R0, 0, incLabel)
+
+	p.b.MovImm64(R1, 1)
+	p.b.StoreStack64(R1, offRuleCtrVal)
+	p.b.LoadMapFD(R1, uint32(p.ruleCountersFD))
+	p.b.Mov64(R2, R10)
+	p.b.AddImm64(R2, int32(offRuleCtrKey))
+	p.b.Mov64(R3, R10)
+	p.b.AddImm64(R3, int32(offRuleCtrVal))
+	p.b.MovImm64(R4, 0 /* BPF_ANY */)
+	p.b.Call(HelperMapUpdateElem)
+	p.b.Jump(doneLabel)
+
+	// Per-CPU map so no need for an atomic add.
+	p.b.LabelNextInsn(incLabel)
+	p.b.Load64(R1, R0, 0)
+	p.b.AddImm64(R1, 1)
+	p.b.Store64(R0, R1, 0)
+	p.b.LabelNextInsn(doneLabel)
+}
+
 func (p *Builder) writeProtoMatch(negate bool, protocol *proto.Protocol) {
 	p.b.Load8(R1, R9, stateOffIPProto)
 	protoNum := protocolToNumber(protocol)
@@ -612,17 +1202,7 @@ func (p *Builder) writeIPSetMatch(negate bool, leg matchLeg, ipSets []string) {
 	// IP sets are different to CIDRs, if we have multiple IP sets then they all have to match
 	// so we treat them as independent match criteria.
 	for _, ipSetID := range ipSets {
-		id := p.ipSetIDProvider.GetNoAlloc(ipSetID)
-		if id == 0 {
-			log.WithField("setID", ipSetID).Panic("Failed to look up IP set ID.")
-		}
-
-		keyOffset := leg.stackOffsetToIPSetKey()
-		p.setUpIPSetKey(id, keyOffset, leg.offsetToStateIPAddressField(), leg.offsetToStatePortField())
-		p.b.LoadMapFD(R1, uint32(p.ipSetMapFD))
-		p.b.Mov64(R2, R10)
-		p.b.AddImm64(R2, int32(keyOffset))
-		p.b.Call(HelperMapLookupElem)
+		p.writeIPSetLookup(leg, ipSetID, false)
 
 		if negate {
 			// Negated; if we got a hit (non-0) then the rule doesn't match.
@@ -642,17 +1222,7 @@ func (p *Builder) writeIPSetOrMatch(leg matchLeg, ipSets []string) {
 	onMatchLabel := p.freshPerRuleLabel()
 
 	for _, ipSetID := range ipSets {
-		id := p.ipSetIDProvider.GetNoAlloc(ipSetID)
-		if id == 0 {
-			log.WithField("setID", ipSetID).Panic("Failed to look up IP set ID.")
-		}
-
-		keyOffset := leg.stackOffsetToIPSetKey()
-		p.setUpIPSetKey(id, keyOffset, leg.offsetToStateIPAddressField(), leg.offsetToStatePortField())
-		p.b.LoadMapFD(R1, uint32(p.ipSetMapFD))
-		p.b.Mov64(R2, R10)
-		p.b.AddImm64(R2, int32(keyOffset))
-		p.b.Call(HelperMapLookupElem)
+		p.writeIPSetLookup(leg, ipSetID, false)
 
 		// If we got a hit (non-0) then packet matches one of the IP sets.
 		// (Otherwise we fall through to try the next IP set.)
@@ -701,17 +1271,7 @@ func (p *Builder) writePortsMatch(negate bool, leg matchLeg, ports []*proto.Port
 	}
 
 	for _, ipSetID := range namedPorts {
-		id := p.ipSetIDProvider.GetNoAlloc(ipSetID)
-		if id == 0 {
-			log.WithField("setID", ipSetID).Panic("Failed to look up IP set ID.")
-		}
-
-		keyOffset := leg.stackOffsetToIPSetKey()
-		p.setUpIPSetKey(id, keyOffset, leg.offsetToStateIPAddressField(), leg.offsetToStatePortField())
-		p.b.LoadMapFD(R1, uint32(p.ipSetMapFD))
-		p.b.Mov64(R2, R10)
-		p.b.AddImm64(R2, int32(keyOffset))
-		p.b.Call(HelperMapLookupElem)
+		p.writeIPSetLookup(leg, ipSetID, true)
 
 		p.b.JumpNEImm64(R0, 0, onMatchLabel)
 	}
@@ -724,6 +1284,100 @@ func (p *Builder) writePortsMatch(negate bool, leg matchLeg, ports []*proto.Port
 	}
 }
 
+// writeIPSetLookup emits a lookup of the packet's address (and port) in the given IP set, leaving
+// the result of the map lookup in R0.  Named port IP sets match on port and protocol as well.
+func (p *Builder) writeIPSetLookup(leg matchLeg, ipSetID string, namedPort bool) {
+	id := p.ipSetIDProvider.GetNoAlloc(ipSetID)
+	if id == 0 {
+		log.WithField("setID", ipSetID).Panic("Failed to look up IP set ID.")
+	}
+
+	keyOffset := leg.stackOffsetToIPSetKey()
+	if p.memberIPSets != nil {
+		if bit, ok := p.memberIPSets.IPSetMemberBit(id); ok {
+			p.writeIPSetMemberLookup(keyOffset, leg, bit)
+			return
+		}
+	}
+	if p.exactIPSets != nil && p.exactIPSets.IPSetIsExact(id) {
+		// All members are full-length so a hash lookup is enough.  Plain members are stored
+		// with zero port and protocol.  The exact-match key is the LPM key without its prefix
+		// length.
+		p.setUpIPSetKey(id, keyOffset, leg.offsetToStateIPAddressField(), leg.offsetToStatePortField(), !namedPort)
+		p.writeMapLookup(p.ipSetExactMapFD, keyOffset+ipsKeyID)
+		return
+	}
+
+	p.setUpIPSetKey(id, keyOffset, leg.offsetToStateIPAddressField(), leg.offsetToStatePortField(), false)
+	p.writeMapLookup(p.ipSetMapFD, keyOffset)
+}
+
+// writeMapLookup emits a lookup of the key at the stack offset in the map, leaving the result in
+// R0.  If the map has a NUMA replica, the program looks up the replica when it runs on the second
+// NUMA node.  Each map gets its own call so that the verifier can still inline the lookups.
+func (p *Builder) writeMapLookup(mapFD bpf.MapFD, keyOffset int16) {
+	replicaFD, ok := p.numaReplicaFDs[mapFD]
+	if !ok {
+		p.b.LoadMapFD(R1, uint32(mapFD))
+		p.b.Mov64(R2, R10)
+		p.b.AddImm64(R2, int32(keyOffset))
+		p.b.Call(HelperMapLookupElem)
+		return
+	}
+
+	replicaLabel := fmt.Sprint("numa_replica_", p.numaLookupID)
+	doneLabel := fmt.Sprint("numa_lookup_done_", p.numaLookupID)
+	p.numaLookupID++
+	p.b.Call(HelperGetNumaNodeId)
+	p.b.JumpEqImm64(R0, 1, replicaLabel)
+	p.b.LoadMapFD(R1, uint32(mapFD))
+	p.b.Mov64(R2, R10)
+	p.b.AddImm64(R2, int32(keyOffset))
+	p.b.Call(HelperMapLookupElem)
+	p.b.Jump(doneLabel)
+	p.b.LabelNextInsn(replicaLabel)
+	p.b.LoadMapFD(R1, uint32(replicaFD))
+	p.b.Mov64(R2, R10)
+	p.b.AddImm64(R2, int32(keyOffset))
+	p.b.Call(HelperMapLookupElem)
+	p.b.LabelNextInsn(doneLabel)
+}
+
+// writeIPSetMemberLookup emits a lookup of the packet's address, port and protocol in the member
+// map, leaving the IP set's bit of the value in R0, or 0 on a miss.  The member key is laid out in
+// the tail of the IP set key, its prefix length overwrites the low half of the IP set ID:
+//
+//	offset  ip4_set_key     member key
+//	 8      set_id[4:8]     prefixLen
+//	12      addr            addr
+//	16      port            port
+//	18      protocol        protocol
+//	19      pad             pad
+//
+// A named port set matches the full key, other sets match an entry that covers the address.
+func (p *Builder) writeIPSetMemberLookup(keyOffset int16, leg matchLeg, bit int) {
+	memberKeyOffset := keyOffset + ipsKeyID + 4
+	p.b.MovImm64(R1, 0) // R1 = 0
+	p.b.StoreStack8(R1, keyOffset+ipsKeyPad)
+	p.b.MovImm64(R1, 64) // R1 = 64, the full length of the member key.
+	p.b.StoreStack32(R1, memberKeyOffset)
+	p.b.Load32(R1, R9, leg.offsetToStateIPAddressField())
+	p.b.StoreStack32(R1, keyOffset+ipsKeyAddr)
+	p.b.Load16(R1, R9, leg.offsetToStatePortField())
+	p.b.StoreStack16(R1, keyOffset+ipsKeyPort)
+	p.b.Load8(R1, R9, stateOffIPProto)
+	p.b.StoreStack8(R1, keyOffset+ipsKeyProto)
+
+	p.writeMapLookup(p.ipSetMemberFD, memberKeyOffset)
+
+	missLabel := fmt.Sprint("ipset_member_miss_", p.memberLookupID)
+	p.memberLookupID++
+	p.b.JumpEqImm64(R0, 0, missLabel)
+	p.b.Load8(R0, R0, int16(bit/8))
+	p.b.AndImm64(R0, int32(1)<<(bit%8))
+	p.b.LabelNextInsn(missLabel)
+}
+
 func (p *Builder) freshPerRuleLabel() string {
 	part := p.rulePartID
 	p.rulePartID++
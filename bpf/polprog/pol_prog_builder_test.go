@@ -15,10 +15,14 @@
 package polprog
 
 import (
+	"fmt"
 	"testing"
 
 	. "github.com/onsi/gomega"
 
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/asm"
+	"github.com/projectcalico/felix/bpf/counters"
 	"github.com/projectcalico/felix/idalloc"
 	"github.com/projectcalico/felix/proto"
 )
@@ -99,3 +103,286 @@ func TestLogActionIgnored(t *testing.T) {
 	Expect(err).NotTo(HaveOccurred())
 	Expect(noOpInsns).To(Equal(insns))
 }
+
+func manyRules(n int) Rules {
+	var rules []Rule
+	for i := 0; i < n; i++ {
+		rules = append(rules, Rule{Rule: &proto.Rule{
+			Action:   "Allow",
+			DstPorts: []*proto.PortRange{{First: int32(1000 + i), Last: int32(1000 + i)}},
+		}})
+	}
+	return Rules{
+		Tiers: []Tier{{
+			Name:      "default",
+			EndAction: TierEndPass,
+			Policies:  []Policy{{Name: "many rules", Rules: rules}},
+		}},
+		Profiles: []Profile{{Name: "prof", Rules: []Rule{{Rule: &proto.Rule{Action: "Allow"}}}}},
+	}
+}
+
+func TestPolicySplitAcrossPrograms(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	single, err := pg.Instructions(manyRules(200))
+	Expect(err).NotTo(HaveOccurred())
+
+	pg.SetMaxInsnsPerProgram(200)
+	progs, err := pg.Programs(manyRules(200))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(len(progs)).To(BeNumerically(">", 1))
+	Expect(len(progs)).To(BeNumerically("<=", MaxPolicyContinuations+1))
+	total := 0
+	for _, p := range progs {
+		// Limit is checked between rules, allow for one rule, the footer and the resume jumps.
+		Expect(len(p)).To(BeNumerically("<", 200+50))
+		total += len(p)
+	}
+	Expect(total).To(BeNumerically(">", len(single)))
+
+	// With the default limit, a small policy stays in one program.
+	pg = NewBuilder(alloc, 1, 2, 3)
+	progs, err = pg.Programs(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(progs).To(HaveLen(1))
+	single, err = pg.Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(progs[0]).To(Equal(single))
+}
+
+func TestPolicyTooLargeForChain(t *testing.T) {
+	RegisterTestingT(t)
+
+	pg := NewBuilder(idalloc.New(), 1, 2, 3)
+	pg.SetMaxInsnsPerProgram(50)
+	_, err := pg.Programs(manyRules(500))
+	Expect(err).To(HaveOccurred())
+}
+
+func TestPolicyJumpIndex(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(PolicyJumpIndex(0)).To(Equal(0))
+	Expect(PolicyJumpIndex(1)).To(Equal(8))
+	Expect(PolicyJumpIndex(MaxPolicyContinuations)).To(Equal(15))
+}
+
+func TestVerdictCacheFlag(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	plain, err := pg.Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+
+	pg.EnableVerdictCache()
+	cacheable, err := pg.Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	// The allow path sets the cacheable flag: load, or and store.
+	Expect(cacheable).To(HaveLen(len(plain) + 3))
+
+	srcPortRules := manyRules(10)
+	srcPortRules.Profiles[0].Rules[0].SrcPorts = []*proto.PortRange{{First: 53, Last: 53}}
+	srcPortPlain, err := NewBuilder(alloc, 1, 2, 3).Instructions(srcPortRules)
+	Expect(err).NotTo(HaveOccurred())
+	notCacheable, err := pg.Instructions(srcPortRules)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(notCacheable).To(Equal(srcPortPlain))
+}
+
+func TestRuleGrouping(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+	alloc.GetOrAlloc("s:namespace")
+
+	tcpRules := func(n int) Rules {
+		rules := manyRules(n)
+		for i := range rules.Tiers[0].Policies[0].Rules {
+			r := rules.Tiers[0].Policies[0].Rules[i].Rule
+			r.Protocol = &proto.Protocol{NumberOrName: &proto.Protocol_Name{Name: "TCP"}}
+			r.SrcIpSetIds = []string{"s:namespace"}
+		}
+		return rules
+	}
+
+	plain, err := NewBuilder(alloc, 1, 2, 3).Instructions(tcpRules(50))
+	Expect(err).NotTo(HaveOccurred())
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	pg.EnableRuleGrouping()
+	grouped, err := pg.Instructions(tcpRules(50))
+	Expect(err).NotTo(HaveOccurred())
+	// The rules no longer check the protocol and look up the IP set.
+	Expect(len(grouped)).To(BeNumerically("<", len(plain)))
+
+	// Rules that don't share a protocol are written as before.
+	plain, err = NewBuilder(alloc, 1, 2, 3).Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	ungrouped, err := pg.Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(ungrouped).To(Equal(plain))
+
+	// Grouped rules can still be split across programs.
+	pg.SetMaxInsnsPerProgram(200)
+	progs, err := pg.Programs(tcpRules(200))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(len(progs)).To(BeNumerically(">", 1))
+}
+
+func TestRuleCounters(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+
+	withIDs := func(n int) Rules {
+		rules := manyRules(n)
+		for i := range rules.Tiers[0].Policies[0].Rules {
+			rules.Tiers[0].Policies[0].Rules[i].RuleId = fmt.Sprintf("rule-%d", i)
+		}
+		return rules
+	}
+
+	plain, err := NewBuilder(alloc, 1, 2, 3).Instructions(withIDs(10))
+	Expect(err).NotTo(HaveOccurred())
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	pg.EnableRuleCounters(4)
+	counted, err := pg.Instructions(withIDs(10))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(len(counted)).To(BeNumerically(">", len(plain)))
+
+	ids := pg.RuleCounterIDs()
+	Expect(ids).To(HaveLen(10))
+	Expect(ids).To(HaveKeyWithValue(counters.RuleCounterKey("many rules", "rule-3"),
+		RuleCounterID{Policy: "many rules", RuleID: "rule-3"}))
+
+	// Rules without an ID, like the profile's, have no counter.
+	plain, err = NewBuilder(alloc, 1, 2, 3).Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	uncounted, err := pg.Instructions(manyRules(10))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(uncounted).To(Equal(plain))
+	Expect(pg.RuleCounterIDs()).To(BeEmpty())
+}
+
+func TestNUMAReplicaIPSetLookups(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+	alloc.GetOrAlloc("s:abcdef1234567890")
+	rules := Rules{
+		Tiers: []Tier{{
+			Policies: []Policy{{
+				Rules: []Rule{{Rule: &proto.Rule{
+					Action:      "Allow",
+					SrcIpSetIds: []string{"s:abcdef1234567890"},
+				}}},
+			}},
+		}},
+	}
+
+	mapLoads := func(insns asm.Insns, fd int32) int {
+		n := 0
+		for _, in := range insns {
+			if in.OpCode() == asm.LoadImm64 && in.Src() == asm.RPseudoMapFD && in.Imm() == fd {
+				n++
+			}
+		}
+		return n
+	}
+	numaCalls := func(insns asm.Insns) int {
+		n := 0
+		for _, in := range insns {
+			if in.OpCode() == asm.Call && in.Imm() == int32(asm.HelperGetNumaNodeId) {
+				n++
+			}
+		}
+		return n
+	}
+
+	plain, err := NewBuilder(alloc, 1, 2, 3).Instructions(rules)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(numaCalls(plain)).To(BeZero())
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	pg.EnableNUMAReplicas(map[bpf.MapFD]bpf.MapFD{1: 9})
+	replicated, err := pg.Instructions(rules)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(numaCalls(replicated)).To(Equal(1))
+	Expect(mapLoads(replicated, 1)).To(Equal(mapLoads(plain, 1)))
+	Expect(mapLoads(replicated, 9)).To(Equal(1))
+}
+
+func TestXDPUntrackedPolicy(t *testing.T) {
+	RegisterTestingT(t)
+	alloc := idalloc.New()
+
+	untracked := []Tier{{
+		Name:      "default",
+		EndAction: TierEndPass,
+		Policies: []Policy{{
+			Name: "dns",
+			Rules: []Rule{
+				{Rule: &proto.Rule{Action: "Allow", DstPorts: []*proto.PortRange{{First: 53, Last: 53}}}},
+				{Rule: &proto.Rule{Action: "Deny", SrcNet: []string{"10.0.0.0/8"}}},
+			},
+		}},
+	}}
+
+	returnCodes := func(insns asm.Insns) []int32 {
+		var rcs []int32
+		for _, in := range insns {
+			if in.OpCode() == asm.MovImm64 && in.Dst() == asm.R0 {
+				rcs = append(rcs, in.Imm())
+			}
+		}
+		return rcs
+	}
+
+	pg := NewBuilder(alloc, 1, 2, 3)
+	pg.EnableXDP()
+	insns, err := pg.Instructions(Rules{ForHostInterface: true, HostUntrackedTiers: untracked})
+	Expect(err).NotTo(HaveOccurred())
+	// It drops with XDP_DROP, never with TC_ACT_SHOT.
+	Expect(returnCodes(insns)).NotTo(BeEmpty())
+	for _, rc := range returnCodes(insns) {
+		Expect(rc).To(Equal(int32(1)))
+	}
+
+	// Without untracked policy, the program still hands the packet to the epilogue.
+	insns, err = pg.Instructions(Rules{ForHostInterface: true})
+	Expect(err).NotTo(HaveOccurred())
+	tailCalls := 0
+	for _, in := range insns {
+		if in.OpCode() == asm.Call && in.Imm() == int32(asm.HelperTailCall) {
+			tailCalls++
+		}
+	}
+	Expect(tailCalls).To(Equal(1))
+
+	// The TC programs ignore untracked policy.
+	plain, err := NewBuilder(alloc, 1, 2, 3).Instructions(Rules{ForHostInterface: true})
+	Expect(err).NotTo(HaveOccurred())
+	withUntracked, err := NewBuilder(alloc, 1, 2, 3).Instructions(Rules{ForHostInterface: true, HostUntrackedTiers: untracked})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(withUntracked).To(Equal(plain))
+}
+
+func TestMergePortRanges(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(mergePortRanges(nil)).To(BeNil())
+	Expect(mergePortRanges([]*proto.PortRange{
+		{First: 8080, Last: 8080},
+		{First: 80, Last: 80},
+		{First: 81, Last: 90},
+		{First: 85, Last: 86},
+		{First: 1000, Last: 2000},
+		{First: 1500, Last: 2500},
+	})).To(Equal([]*proto.PortRange{
+		{First: 80, Last: 90},
+		{First: 1000, Last: 2500},
+		{First: 8080, Last: 8080},
+	}))
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package polprog
+
+import (
+	"github.com/projectcalico/felix/bpf"
+	. "github.com/projectcalico/felix/bpf/asm"
+	"github.com/projectcalico/felix/bpf/state"
+)
+
+// Trampoline returns a program that tail calls the policy program of an attach point from a
+// program that is shared between attach points.  Shared programs cannot use a jump map of their
+// own for the policy, so they find the trampoline of the attach point in the cali_pol_progs map
+// and the trampoline jumps to the policy program in the attach point's jump map.
+//
+// If the attach point has no policy program, the trampoline does what the main program would
+// have done: it allows the packet if allowIfNoPolicy is set (host endpoints) and drops it
+// otherwise.
+func Trampoline(stateMapFD, jumpMapFD bpf.MapFD, allowIfNoPolicy bool) (Insns, error) {
+	b := NewBlock()
+
+	b.Mov64(R6, R1) // Save R1 (context) in R6.
+	b.Mov64(R1, R6)
+	b.LoadMapFD(R2, uint32(jumpMapFD))
+	b.MovImm32(R3, jumpIdxPolicy)
+	b.Call(HelperTailCall)
+
+	// Fall through if there is no policy program.
+	if allowIfNoPolicy {
+		b.MovImm64(R1, 0)
+		b.StoreStack32(R1, offStateKey)
+		b.Mov64(R2, R10)
+		b.AddImm64(R2, int32(offStateKey))
+		b.LoadMapFD(R1, uint32(stateMapFD))
+		b.Call(HelperMapLookupElem)
+		b.JumpEqImm64(R0, 0, "deny")
+
+		b.MovImm32(R1, int32(state.PolicyAllow))
+		b.Store32(R0, R1, stateOffPolResult)
+		b.Mov64(R1, R6)
+		b.LoadMapFD(R2, uint32(jumpMapFD))
+		b.MovImm32(R3, jumpIdxEpilogue)
+		b.Call(HelperTailCall)
+	}
+
+	b.LabelNextInsn("deny")
+	b.MovImm64(R0, 2 /* TC_ACT_SHOT */)
+	b.Exit()
+
+	return b.Assemble()
+}
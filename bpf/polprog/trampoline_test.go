@@ -0,0 +1,52 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package polprog
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	. "github.com/projectcalico/felix/bpf/asm"
+)
+
+func countTailCalls(insns Insns) int {
+	n := 0
+	for _, insn := range insns {
+		if insn.OpCode() == Call && insn.Imm() == int32(HelperTailCall) {
+			n++
+		}
+	}
+	return n
+}
+
+func TestTrampolineDenyIfNoPolicy(t *testing.T) {
+	RegisterTestingT(t)
+
+	insns, err := Trampoline(1, 2, false)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(countTailCalls(insns)).To(Equal(1))
+	Expect(insns[len(insns)-1].OpCode()).To(Equal(Exit))
+}
+
+func TestTrampolineAllowIfNoPolicy(t *testing.T) {
+	RegisterTestingT(t)
+
+	insns, err := Trampoline(1, 2, true)
+	Expect(err).NotTo(HaveOccurred())
+	// One tail call to the policy program and one to the epilogue.
+	Expect(countTailCalls(insns)).To(Equal(2))
+	Expect(insns[len(insns)-1].OpCode()).To(Equal(Exit))
+}
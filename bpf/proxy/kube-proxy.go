@@ -15,11 +15,14 @@
 package proxy
 
 import (
+	"context"
 	"net"
 	"sync"
 
 	"github.com/pkg/errors"
 	log "github.com/sirupsen/logrus"
+	v1 "k8s.io/api/core/v1"
+	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
 	"k8s.io/client-go/kubernetes"
 
 	"github.com/projectcalico/felix/bpf/cachingmap"
@@ -35,6 +38,8 @@ import (
 type KubeProxy struct {
 	proxy  Proxy
 	syncer DPSyncer
+	// proxyV6 is the proxy of the IPv6 services, it is only set WithIPv6.
+	proxyV6 Proxy
 
 	hostIPUpdates chan []net.IP
 	stopOnce      sync.Once
@@ -47,16 +52,27 @@ type KubeProxy struct {
 	frontendMap bpf.Map
 	backendMap  bpf.Map
 	affinityMap bpf.Map
+	maglevMap   bpf.Map
 	ctMap       bpf.Map
 	rt          *RTCache
 	opts        []Option
 
-	dsrEnabled bool
+	frontendMapV6 bpf.Map
+	backendMapV6  bpf.Map
+	// ctlbGenMap is the nat.CTLBGenMap, it is only set WithConnectTimeLBGenMap.
+	ctlbGenMap bpf.Map
+
+	dsrEnabled    bool
+	maglevEnabled bool
+
+	localBackendWeight int
+	topologyHints      bool
 }
 
-// StartKubeProxy start a new kube-proxy if there was no error
+// StartKubeProxy start a new kube-proxy if there was no error.  The maglevMap is optional, see
+// WithMaglevEnabled.
 func StartKubeProxy(k8s kubernetes.Interface, hostname string,
-	frontendMap, backendMap, affinityMap, ctMap bpf.Map, opts ...Option) (*KubeProxy, error) {
+	frontendMap, backendMap, affinityMap, maglevMap, ctMap bpf.Map, opts ...Option) (*KubeProxy, error) {
 
 	kp := &KubeProxy{
 		k8s:         k8s,
@@ -64,10 +80,13 @@ func StartKubeProxy(k8s kubernetes.Interface, hostname string,
 		frontendMap: frontendMap,
 		backendMap:  backendMap,
 		affinityMap: affinityMap,
+		maglevMap:   maglevMap,
 		ctMap:       ctMap,
 		opts:        opts,
 		rt:          NewRTCache(),
 
+		localBackendWeight: 1,
+
 		hostIPUpdates: make(chan []net.IP, 1),
 		exiting:       make(chan struct{}),
 	}
@@ -96,7 +115,7 @@ func (kp *KubeProxy) Stop() {
 
 		close(kp.exiting)
 		close(kp.hostIPUpdates)
-		kp.proxy.Stop()
+		kp.stopProxies()
 		kp.wg.Wait()
 	})
 }
@@ -106,9 +125,9 @@ func (kp *KubeProxy) run(hostIPs []net.IP) error {
 	kp.lock.Lock()
 	defer kp.lock.Unlock()
 
-	withLocalNP := make([]net.IP, len(hostIPs), len(hostIPs)+1)
-	copy(withLocalNP, hostIPs)
-	withLocalNP = append(withLocalNP, podNPIP)
+	// The dataplane matches the NodePort frontends against all the addresses of the hosts, so
+	// they do not depend on the host IPs.
+	withLocalNP := []net.IP{nat.NodePortLocalHostIP, podNPIP}
 
 	feCache := cachingmap.New(nat.FrontendMapParameters, kp.frontendMap)
 	beCache := cachingmap.New(nat.BackendMapParameters, kp.backendMap)
@@ -118,6 +137,22 @@ func (kp *KubeProxy) run(hostIPs []net.IP) error {
 		return errors.WithMessage(err, "new bpf syncer")
 	}
 
+	if kp.maglevMap != nil {
+		err = syncer.SetMaglevMap(cachingmap.New(nat.MaglevMapParameters, kp.maglevMap), kp.maglevEnabled)
+		if err != nil {
+			return errors.WithMessage(err, "loading maglev map")
+		}
+	}
+
+	zone := ""
+	if kp.topologyHints {
+		zone = kp.nodeZone()
+	}
+	syncer.SetBackendSelection(kp.localBackendWeight, zone)
+	if kp.ctlbGenMap != nil {
+		syncer.SetCTLBGenMap(kp.ctlbGenMap)
+	}
+
 	proxy, err := New(kp.k8s, syncer, kp.hostname, kp.opts...)
 	if err != nil {
 		return errors.WithMessage(err, "new proxy")
@@ -128,9 +163,32 @@ func (kp *KubeProxy) run(hostIPs []net.IP) error {
 	kp.proxy = proxy
 	kp.syncer = syncer
 
+	if kp.frontendMapV6 != nil {
+		feCacheV6 := cachingmap.New(nat.FrontendMapV6Parameters, kp.frontendMapV6)
+		beCacheV6 := cachingmap.New(nat.BackendMapV6Parameters, kp.backendMapV6)
+
+		opts := append([]Option{withIPFamily(v1.IPv6Protocol)}, kp.opts...)
+		syncerV6 := NewSyncerV6(feCacheV6, beCacheV6)
+		if kp.ctlbGenMap != nil {
+			syncerV6.SetCTLBGenMap(kp.ctlbGenMap)
+		}
+		kp.proxyV6, err = New(kp.k8s, syncerV6, kp.hostname, opts...)
+		if err != nil {
+			return errors.WithMessage(err, "new IPv6 proxy")
+		}
+		log.Info("IPv6 kube-proxy started")
+	}
+
 	return nil
 }
 
+func (kp *KubeProxy) stopProxies() {
+	kp.proxy.Stop()
+	if kp.proxyV6 != nil {
+		kp.proxyV6.Stop()
+	}
+}
+
 func (kp *KubeProxy) start() error {
 
 	// wait for the initial update
@@ -148,7 +206,7 @@ func (kp *KubeProxy) start() error {
 			hostIPs, ok := <-kp.hostIPUpdates
 			if !ok {
 				defer log.Error("kube-proxy stopped since hostIPUpdates closed")
-				kp.proxy.Stop()
+				kp.stopProxies()
 				return
 			}
 
@@ -157,7 +215,7 @@ func (kp *KubeProxy) start() error {
 			go func() {
 				defer close(stopped)
 				defer log.Info("kube-proxy stopped to restart with updated host IPs")
-				kp.proxy.Stop()
+				kp.stopProxies()
 			}()
 
 		waitforstop:
@@ -248,3 +306,27 @@ func (kp *KubeProxy) ConntrackFrontendHasBackend(ip net.IP, port uint16, backend
 	// We cannot say yet, so do not break anything
 	return true
 }
+
+// ServiceNames returns the names of the IPv4 services by the IDs of their frontends, see
+// Syncer.ServiceNames, or nil if the proxy hasn't started yet.
+func (kp *KubeProxy) ServiceNames() map[uint32]string {
+	kp.lock.RLock()
+	defer kp.lock.RUnlock()
+
+	if s, ok := kp.syncer.(*Syncer); ok {
+		return s.ServiceNames()
+	}
+	return nil
+}
+
+// nodeZone returns the topology zone of this node, or an empty string if the zone is not known.
+func (kp *KubeProxy) nodeZone() string {
+	node, err := kp.k8s.CoreV1().Nodes().Get(context.Background(), kp.hostname, metav1.GetOptions{})
+	if err != nil {
+		log.WithError(err).Warn("Failed to get the zone of this node, ignoring topology aware hints.")
+		return ""
+	}
+	zone := node.Labels[v1.LabelTopologyZone]
+	log.Infof("kube-proxy: zone of this node is %q", zone)
+	return zone
+}
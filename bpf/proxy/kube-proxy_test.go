@@ -25,6 +25,7 @@ import (
 
 	"github.com/projectcalico/felix/bpf/conntrack"
 	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/bpf/nat"
 	proxy "github.com/projectcalico/felix/bpf/proxy"
 )
 
@@ -78,70 +79,40 @@ var _ = Describe("BPF kube-proxy", func() {
 		}
 
 		k8s := fake.NewSimpleClientset(testSvc, testSvcEps)
-		p, _ = proxy.StartKubeProxy(k8s, "test-node", front, back, aff, ct, proxy.WithImmediateSync())
+		p, _ = proxy.StartKubeProxy(k8s, "test-node", front, back, aff, nil, ct, proxy.WithImmediateSync())
 	})
 
 	AfterEach(func() {
 		p.Stop()
 	})
 
-	It("should update nodeports after host ip changes", func() {
-		By("checking nodeport has the initial IP", func() {
-			p.OnHostIPsUpdate([]net.IP{initIP})
-			Eventually(func() bool {
-				front.Lock()
-				defer front.Unlock()
-
-				for k := range front.m {
-					if k.Addr().String() == initIP.String() {
-						return true
-					}
-				}
-				return false
-			}).Should(BeTrue())
-		})
-
-		By("checking nodeport has the updated IP and not the initial IP", func() {
-			updatedIP := net.IPv4(2, 2, 2, 2)
-			p.OnHostIPsUpdate([]net.IP{updatedIP})
-
-			Eventually(func() bool {
-				front.Lock()
-				defer front.Unlock()
-
-				for k := range front.m {
-					if k.Addr().String() == initIP.String() {
-						return false
-					}
-					if k.Addr().String() == updatedIP.String() {
-						return true
-					}
-				}
-				return false
-			}).Should(BeTrue())
-		})
+	It("should keep the nodeports independent of the host ips", func() {
+		local := nat.NewNATKey(nat.NodePortLocalHostIP, 666, 6)
+		remote := nat.NewNATKey(nat.NodePortRemoteHostsIP, 666, 6)
 
-		By("checking nodeport has 2 updated IPs", func() {
-			ip1 := net.IPv4(3, 3, 3, 3)
-			ip2 := net.IPv4(4, 4, 4, 4)
-			p.OnHostIPsUpdate([]net.IP{ip1, ip2})
+		hasNodePortsOnly := func() bool {
+			front.Lock()
+			defer front.Unlock()
 
-			Eventually(func() bool {
-				front.Lock()
-				defer front.Unlock()
+			for k := range front.m {
+				if k.Port() == 666 && !k.Addr().Equal(nat.NodePortLocalHostIP) &&
+					!k.Addr().Equal(nat.NodePortRemoteHostsIP) {
+					return false
+				}
+			}
+			_, hasLocal := front.m[local]
+			_, hasRemote := front.m[remote]
+			return hasLocal && hasRemote
+		}
 
-				ip1ok := false
-				ip2ok := false
+		By("checking the nodeports with the initial IP", func() {
+			p.OnHostIPsUpdate([]net.IP{initIP})
+			Eventually(hasNodePortsOnly).Should(BeTrue())
+		})
 
-				for k := range front.m {
-					if k.Addr().String() == ip1.String() {
-						ip1ok = true
-					} else if k.Addr().String() == ip2.String() {
-						ip2ok = true
-					}
-				}
-				return ip1ok && ip2ok
-			}).Should(BeTrue())
+		By("checking the nodeports after host IP changes", func() {
+			p.OnHostIPsUpdate([]net.IP{net.IPv4(3, 3, 3, 3), net.IPv4(4, 4, 4, 4)})
+			Consistently(hasNodePortsOnly, "200ms").Should(BeTrue())
 		})
 	})
 })
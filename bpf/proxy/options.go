@@ -18,6 +18,9 @@ import (
 	"time"
 
 	log "github.com/sirupsen/logrus"
+	v1 "k8s.io/api/core/v1"
+
+	"github.com/projectcalico/felix/bpf"
 )
 
 // Option defines Proxy options
@@ -76,3 +79,58 @@ func WithDSREnabled() Option {
 		return nil
 	})
 }
+
+// WithMaglevEnabled makes the services without client IP affinity select their backends by the
+// consistent hash of the flow, so that all nodes pick the same backend for a flow.
+func WithMaglevEnabled() Option {
+	return makeKubeProxyOption(func(kp *KubeProxy) error {
+		kp.maglevEnabled = true
+		return nil
+	})
+}
+
+// WithLocalBackendWeight makes the services pick each local backend weight times as often as a
+// remote backend, so that more of the traffic stays on this node.
+func WithLocalBackendWeight(weight int) Option {
+	return makeKubeProxyOption(func(kp *KubeProxy) error {
+		kp.localBackendWeight = weight
+		return nil
+	})
+}
+
+// WithTopologyAwareHints makes the services with topology aware hints use only the backends that
+// are hinted for the zone of this node.
+func WithTopologyAwareHints() Option {
+	return makeKubeProxyOption(func(kp *KubeProxy) error {
+		kp.topologyHints = true
+		return nil
+	})
+}
+
+// WithIPv6 makes KubeProxy also run a proxy for the IPv6 services, which it writes into the given
+// IPv6 NAT maps for the connect-time load balancer.
+func WithIPv6(frontendMap, backendMap bpf.Map) Option {
+	return makeKubeProxyOption(func(kp *KubeProxy) error {
+		kp.frontendMapV6 = frontendMap
+		kp.backendMapV6 = backendMap
+		return nil
+	})
+}
+
+// WithConnectTimeLBGenMap makes the syncers move the generation in the nat.CTLBGenMap on whenever
+// they update the NAT maps, so that the connect-time load balancer drops the backends that it
+// cached for the sockets.
+func WithConnectTimeLBGenMap(m bpf.Map) Option {
+	return makeKubeProxyOption(func(kp *KubeProxy) error {
+		kp.ctlbGenMap = m
+		return nil
+	})
+}
+
+func withIPFamily(family v1.IPFamily) Option {
+	return makeOption(func(p *proxy) error {
+		p.ipFamily = family
+		log.Infof("proxy.withIPFamily(%s)", family)
+		return nil
+	})
+}
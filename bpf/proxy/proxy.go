@@ -79,6 +79,9 @@ type proxy struct {
 
 	endpointSlicesEnabled bool
 
+	// ipFamily is the family of the services and endpoints that the proxy tracks.
+	ipFamily v1.IPFamily
+
 	dpSyncer DPSyncer
 	// executes periodic the dataplane updates
 	runner *async.BoundedFrequencyRunner
@@ -127,6 +130,8 @@ func New(k8s kubernetes.Interface, dp DPSyncer, hostname string, opts ...Option)
 
 		minDPSyncPeriod: 30 * time.Second, // XXX revisit the default
 
+		ipFamily: v1.IPv4Protocol,
+
 		stopCh: make(chan struct{}),
 	}
 
@@ -142,16 +147,19 @@ func New(k8s kubernetes.Interface, dp DPSyncer, hostname string, opts ...Option)
 		p.invokeDPSyncer, p.minDPSyncPeriod, time.Hour /* XXX might be infinite? */, 1)
 	dp.SetTriggerFn(p.runner.Run)
 
-	p.svcHealthServer = healthcheck.NewServiceHealthServer(p.hostname, p.recorder)
+	if p.ipFamily == v1.IPv4Protocol {
+		// The health check node ports are per node, not per family, only one proxy serves them.
+		p.svcHealthServer = healthcheck.NewServiceHealthServer(p.hostname, p.recorder)
+	}
 
 	p.epsChanges = k8sp.NewEndpointChangeTracker(p.hostname,
 		nil, // change if you want to provide more ctx
-		v1.IPv4Protocol,
+		p.ipFamily,
 		p.recorder,
 		p.endpointSlicesEnabled,
 		nil,
 	)
-	p.svcChanges = k8sp.NewServiceChangeTracker(nil, v1.IPv4Protocol, p.recorder, nil)
+	p.svcChanges = k8sp.NewServiceChangeTracker(nil, p.ipFamily, p.recorder, nil)
 
 	noProxyName, err := labels.NewRequirement(apis.LabelServiceProxyName, selection.DoesNotExist, nil)
 	if err != nil {
@@ -234,11 +242,13 @@ func (p *proxy) invokeDPSyncer() {
 	svcUpdateResult := p.svcMap.Update(p.svcChanges)
 	epsUpdateResult := p.epsMap.Update(p.epsChanges)
 
-	if err := p.svcHealthServer.SyncServices(svcUpdateResult.HCServiceNodePorts); err != nil {
-		log.WithError(err).Error("Error syncing healthcheck services")
-	}
-	if err := p.svcHealthServer.SyncEndpoints(epsUpdateResult.HCEndpointsLocalIPSize); err != nil {
-		log.WithError(err).Error("Error syncing healthcheck endpoints")
+	if p.svcHealthServer != nil {
+		if err := p.svcHealthServer.SyncServices(svcUpdateResult.HCServiceNodePorts); err != nil {
+			log.WithError(err).Error("Error syncing healthcheck services")
+		}
+		if err := p.svcHealthServer.SyncEndpoints(epsUpdateResult.HCEndpointsLocalIPSize); err != nil {
+			log.WithError(err).Error("Error syncing healthcheck endpoints")
+		}
 	}
 
 	err := p.dpSyncer.Apply(DPSyncerState{
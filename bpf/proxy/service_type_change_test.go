@@ -97,7 +97,7 @@ var _ = Describe("BPF service type change", func() {
 	var p *proxy.KubeProxy
 
 	BeforeEach(func() {
-		p, _ = proxy.StartKubeProxy(k8s, "test-node", front, back, aff, ct, proxy.WithImmediateSync())
+		p, _ = proxy.StartKubeProxy(k8s, "test-node", front, back, aff, nil, ct, proxy.WithImmediateSync())
 		p.OnHostIPsUpdate([]net.IP{initIP})
 	})
 
@@ -37,13 +37,18 @@ import (
 	"github.com/projectcalico/felix/ip"
 )
 
-var podNPIP = net.IPv4(255, 255, 255, 255)
+// podNPIP is the address of the NodePort frontends that apply to the addresses of the other nodes.
+var podNPIP = nat.NodePortRemoteHostsIP
 
 type svcInfo struct {
 	id         uint32
 	count      int
 	localCount int
 	svc        k8sp.ServicePort
+	slots      backendSlots
+	// affinityGen is the affinity generation of the frontends of a service with client IP
+	// affinity, see newAffinityGen.
+	affinityGen uint32
 }
 
 type svcKey struct {
@@ -95,7 +100,7 @@ func isSvcKeyDerived(skey svcKey) bool {
 }
 
 type stickyFrontend struct {
-	id    uint32
+	gen   uint32
 	timeo time.Duration
 }
 
@@ -105,8 +110,20 @@ type Syncer struct {
 	bpfSvcs *cachingmap.CachingMap
 	bpfEps  *cachingmap.CachingMap
 	bpfAff  bpf.Map
+	// bpfMaglev, if set, holds the Maglev lookup tables of the services, see SetMaglevMap.
+	bpfMaglev     *cachingmap.CachingMap
+	maglevEnabled bool
+	// bpfCTLBGen, if set, is the nat.CTLBGenMap, see SetCTLBGenMap.
+	bpfCTLBGen bpf.Map
+
+	// localWeight is the number of ordinals that each local backend gets, see SetBackendSelection.
+	localWeight int
+	// zone is the topology zone of this node, it enables the topology aware hints if not empty.
+	zone string
 
 	nextSvcID uint32
+	// nextAffinityGen is the next affinity generation that newAffinityGen hands out.
+	nextAffinityGen uint32
 
 	nodePortIPs []net.IP
 	rt          Routes
@@ -127,6 +144,11 @@ type Syncer struct {
 
 	// synced is true after reconciling the first Apply
 	synced bool
+	// origsDone is closed once the background load of the NAT maps, which NewSyncer starts, has
+	// finished, with origsErr set if it failed.  The load overlaps with the proxy's initial listing
+	// of the services and endpoints, see waitForOrigs.
+	origsDone chan struct{}
+	origsErr  error
 
 	expFixupWg   sync.WaitGroup
 	expFixupStop chan struct{}
@@ -134,8 +156,9 @@ type Syncer struct {
 	stop     chan struct{}
 	stopOnce sync.Once
 
+	// stickySvcs holds the frontends with client IP affinity during the first Apply, which
+	// cleans up the affinity map after the previous Felix, see cleanupSticky.
 	stickySvcs map[nat.FrontEndAffinityKey]stickyFrontend
-	stickyEps  map[uint32]map[nat.BackendValue]struct{}
 
 	// triggerFn is called when one of the syncer's background threads needs to trigger an Apply().
 	// The proxy sets this to the runner's Run() method.  We assume that the method doesn't block.
@@ -197,18 +220,55 @@ func NewSyncer(nodePortIPs []net.IP, svcsmap, epsmap *cachingmap.CachingMap, aff
 		bpfAff:      affmap,
 		rt:          rt,
 		nodePortIPs: uniqueIPs(nodePortIPs),
+		localWeight: 1,
 		prevSvcMap:  make(map[svcKey]svcInfo),
 		prevEpsMap:  make(k8sp.EndpointsMap),
 		stop:        make(chan struct{}),
+		origsDone:   make(chan struct{}),
+		// Start from the time so that the generations are newer than those that the
+		// previous Felix handed out to the services that it deleted, see startupBuildPrev.
+		nextAffinityGen: uint32(time.Now().Unix()),
 	}
 
-	if err := s.loadOrigs(); err != nil {
-		return nil, err
-	}
+	go func() {
+		defer close(s.origsDone)
+		s.origsErr = s.loadOrigs()
+	}()
 
 	return s, nil
 }
 
+// SetMaglevMap sets the map of the per-service Maglev lookup tables, which the syncer then keeps in
+// sync with the services.  If enabled is false, the syncer only removes the tables that are left in
+// the map.  It must be called before the first Apply.
+func (s *Syncer) SetMaglevMap(mgmap *cachingmap.CachingMap, enabled bool) error {
+	if err := mgmap.LoadCacheFromDataplane(); err != nil {
+		return err
+	}
+	s.bpfMaglev = mgmap
+	s.maglevEnabled = enabled
+	return nil
+}
+
+// SetCTLBGenMap sets the map of the generation of the NAT maps, which the syncer moves on after
+// each Apply so that the connect-time load balancer drops the backends that it cached.
+func (s *Syncer) SetCTLBGenMap(m bpf.Map) {
+	s.bpfCTLBGen = m
+}
+
+// SetBackendSelection sets how the syncer lays out the backends of the services in the backend map.
+// Each local backend gets localWeight of the local ordinals, rather than one, so that the random
+// selection picks it localWeight times as often as a remote backend.  If zone is not empty, the
+// services with topology aware hints only use the backends hinted for the zone, like kube-proxy does.
+// It must be called before the first Apply.
+func (s *Syncer) SetBackendSelection(localWeight int, zone string) {
+	if localWeight < 1 {
+		localWeight = 1
+	}
+	s.localWeight = localWeight
+	s.zone = zone
+}
+
 func (s *Syncer) loadOrigs() error {
 	err := s.bpfEps.LoadCacheFromDataplane()
 	if err != nil {
@@ -221,6 +281,16 @@ func (s *Syncer) loadOrigs() error {
 	return nil
 }
 
+// waitForOrigs waits for the background load of the NAT maps and, if it failed, retries it.
+func (s *Syncer) waitForOrigs() error {
+	<-s.origsDone
+	if s.origsErr != nil {
+		log.WithError(s.origsErr).Warn("Failed to load NAT maps from dataplane, retrying.")
+		s.origsErr = s.loadOrigs()
+	}
+	return s.origsErr
+}
+
 type syncRef struct {
 	svc  k8sp.ServicePortName
 	info k8sp.ServicePort
@@ -276,6 +346,10 @@ func (s *Syncer) startupBuildPrev(state DPSyncerState) error {
 		copy(svck[:], k)
 		copy(svcv[:], v)
 
+		if gen := svcv.AffinityGen(); gen >= s.nextAffinityGen {
+			s.nextAffinityGen = gen + 1
+		}
+
 		xref, ok := svcRef[svck]
 		if !ok {
 			return
@@ -292,10 +366,11 @@ func (s *Syncer) startupBuildPrev(state DPSyncerState) error {
 		id := svcv.ID()
 		count := int(svcv.Count())
 		s.prevSvcMap[*svckey] = svcInfo{
-			id:         id,
-			count:      count,
-			localCount: int(svcv.LocalCount()),
-			svc:        state.SvcMap[svckey.sname],
+			id:          id,
+			count:       count,
+			localCount:  int(svcv.LocalCount()),
+			svc:         state.SvcMap[svckey.sname],
+			affinityGen: svcv.AffinityGen(),
 		}
 
 		if id >= s.nextSvcID {
@@ -305,13 +380,19 @@ func (s *Syncer) startupBuildPrev(state DPSyncerState) error {
 		if svckey.extra != "" {
 			return
 		}
+		slots := backendSlots{local: int(svcv.LocalCount())}
+		defer func() {
+			info := s.prevSvcMap[*svckey]
+			info.slots = slots
+			s.prevSvcMap[*svckey] = info
+		}()
 
 		if count > 0 {
 			s.prevEpsMap[svckey.sname] = make([]k8sp.Endpoint, 0, count)
 		}
 		for i := 0; i < count; i++ {
 			epk := nat.NewNATBackendKey(id, uint32(i))
-			epSlice := s.bpfEps.GetDataplaneCache(epk[:])
+			epSlice := s.bpfEps.PeekDataplaneCache(epk[:])
 			if epSlice == nil {
 				log.Warnf("inconsistent backed map, missing ep %s", epk)
 				inconsistent = true
@@ -319,6 +400,7 @@ func (s *Syncer) startupBuildPrev(state DPSyncerState) error {
 			}
 			var ep nat.BackendValue
 			copy(ep[:], epSlice)
+			slots.backends = append(slots.backends, ep)
 			s.prevEpsMap[svckey.sname] = append(s.prevEpsMap[svckey.sname],
 				&k8sp.BaseEndpointInfo{
 					Endpoint: net.JoinHostPort(ep.Addr().String(), strconv.Itoa(int(ep.Port()))),
@@ -336,6 +418,10 @@ func (s *Syncer) startupBuildPrev(state DPSyncerState) error {
 }
 
 func (s *Syncer) startupSync(state DPSyncerState) error {
+	if err := s.waitForOrigs(); err != nil {
+		return err
+	}
+
 	// Try to build the previous maps based on the current state and what is in bpf maps.
 	// Once we have the previous map, we can apply the the current state as if we never
 	// restarted and apply only the diff using the regular code path.
@@ -348,24 +434,57 @@ func (s *Syncer) startupSync(state DPSyncerState) error {
 
 func (s *Syncer) applySvc(skey svcKey, sinfo k8sp.ServicePort, eps []k8sp.Endpoint) error {
 
-	var id uint32
+	var (
+		id   uint32
+		prev backendSlots
+	)
+
+	selected := s.filterEndpointsWithHints(sinfo, eps)
 
 	old, exists := s.prevSvcMap[skey]
-	if exists && ServicePortEqual(old.svc, sinfo) {
+	exists = exists && ServicePortEqual(old.svc, sinfo)
+	if exists {
+		prev = old.slots
+	}
+	slots, gone, err := s.layoutBackends(prev, selected)
+	if err != nil {
+		return err
+	}
+
+	// The backends keep their ordinals, so adding or removing a few of them only rewrites a few
+	// backend entries.  If most of the backends went away, write the new set under a new ID, so
+	// that the update of the frontend switches the service to the complete new set at once and
+	// the backends of the old ID are removed afterwards.  Otherwise, the dataplane would see a
+	// mix of the old and new backends while we rewrite them one by one.
+	if exists && gone*2 <= len(prev.backends) {
 		id = old.id
 	} else {
 		id = s.newSvcID()
 	}
-	count, local, err := s.updateService(skey.sname, sinfo, id, eps)
+
+	// The affinities to the backends that the service still has stay valid, so the generation
+	// only moves on when the service loses a backend.
+	var affinityGen uint32
+	if sinfo.SessionAffinityType() == v1.ServiceAffinityClientIP {
+		if exists && gone == 0 && old.affinityGen != 0 {
+			affinityGen = old.affinityGen
+		} else {
+			affinityGen = s.newAffinityGen()
+		}
+	}
+
+	count, local, err := s.updateService(skey.sname, sinfo, id, slots, affinityGen)
 	if err != nil {
 		return err
 	}
 
 	s.newSvcMap[skey] = svcInfo{
-		id:         id,
-		count:      count,
-		localCount: local,
-		svc:        sinfo,
+		id:          id,
+		count:       count,
+		localCount:  local,
+		svc:         sinfo,
+		slots:       slots,
+		affinityGen: affinityGen,
 	}
 
 	s.newEpsMap[skey.sname] = eps
@@ -377,6 +496,112 @@ func (s *Syncer) applySvc(skey svcKey, sinfo k8sp.ServicePort, eps []k8sp.Endpoi
 	return nil
 }
 
+// backendSlots are the backends of a service by their ordinal.  The local backends take the
+// first local ordinals.
+type backendSlots struct {
+	backends []nat.BackendValue
+	eps      []k8sp.Endpoint
+	local    int
+}
+
+// remove removes the backend with the ordinal i and moves the last local and the last backend
+// into the gaps so that only those change their ordinals.
+func (b *backendSlots) remove(i int) {
+	last := len(b.backends) - 1
+	if i < b.local {
+		b.moveTo(i, b.local-1)
+		i = b.local - 1
+		b.local--
+	}
+	b.moveTo(i, last)
+	b.backends = b.backends[:last]
+	b.eps = b.eps[:last]
+}
+
+func (b *backendSlots) moveTo(i, from int) {
+	b.backends[i] = b.backends[from]
+	b.eps[i] = b.eps[from]
+}
+
+// addLocal adds a local backend by moving the first of the others to the end.
+func (b *backendSlots) addLocal(be nat.BackendValue, ep k8sp.Endpoint) {
+	b.add(be, ep)
+	if b.local < len(b.backends)-1 {
+		last := len(b.backends) - 1
+		b.backends[last], b.backends[b.local] = b.backends[b.local], be
+		b.eps[last], b.eps[b.local] = b.eps[b.local], ep
+	}
+	b.local++
+}
+
+func (b *backendSlots) add(be nat.BackendValue, ep k8sp.Endpoint) {
+	b.backends = append(b.backends, be)
+	b.eps = append(b.eps, ep)
+}
+
+// layoutBackends assigns ordinals to the endpoints, the local ones localWeight times.  The
+// backends that the service already had keep their ordinals, apart from those that move into the
+// gaps that the removed ones leave.  It returns the new layout and how many of the ordinals of prev
+// were taken by backends that the service no longer has.
+func (s *Syncer) layoutBackends(prev backendSlots, eps []k8sp.Endpoint) (backendSlots, int, error) {
+	wantLocal := make(map[nat.BackendValue]int)
+	wantRemote := make(map[nat.BackendValue]int)
+	bes := make([]nat.BackendValue, len(eps))
+	for i, ep := range eps {
+		be, err := backendValue(ep)
+		if err != nil {
+			return backendSlots{}, 0, err
+		}
+		bes[i] = be
+		if ep.GetIsLocal() {
+			wantLocal[be] += s.localWeight
+		} else {
+			wantRemote[be]++
+		}
+	}
+
+	slots := backendSlots{
+		backends: append([]nat.BackendValue(nil), prev.backends...),
+		eps:      make([]k8sp.Endpoint, len(prev.backends)),
+		local:    prev.local,
+	}
+	epOf := make(map[nat.BackendValue]k8sp.Endpoint, len(eps))
+	for i, ep := range eps {
+		epOf[bes[i]] = ep
+	}
+	for i, be := range slots.backends {
+		slots.eps[i] = epOf[be]
+	}
+
+	// Walk down so that the backends that move into the gaps have been kept already.
+	gone := 0
+	for i := len(slots.backends) - 1; i >= 0; i-- {
+		want := wantRemote
+		if i < slots.local {
+			want = wantLocal
+		}
+		if be := slots.backends[i]; want[be] > 0 {
+			want[be]--
+			continue
+		}
+		slots.remove(i)
+		gone++
+	}
+
+	for i, ep := range eps {
+		for be := bes[i]; ep.GetIsLocal() && wantLocal[be] > 0; wantLocal[be]-- {
+			slots.addLocal(be, ep)
+		}
+	}
+	for i, ep := range eps {
+		for be := bes[i]; !ep.GetIsLocal() && wantRemote[be] > 0; wantRemote[be]-- {
+			slots.add(be, ep)
+		}
+	}
+
+	return slots, gone, nil
+}
+
 func (s *Syncer) addActiveEps(id uint32, svc k8sp.ServicePort, eps []k8sp.Endpoint) {
 	svcKey := servicePortToIPPortProto(svc)
 
@@ -496,17 +721,18 @@ func (s *Syncer) applyDerived(
 	}
 
 	newInfo := svcInfo{
-		id:         svc.id,
-		count:      count,
-		localCount: local,
-		svc:        sinfo,
+		id:          svc.id,
+		count:       count,
+		localCount:  local,
+		svc:         sinfo,
+		affinityGen: svc.affinityGen,
 	}
 
-	if err := s.writeSvc(sinfo, svc.id, count, local); err != nil {
+	if err := s.writeSvc(sinfo, svc.id, count, local, svc.affinityGen); err != nil {
 		return err
 	}
 	if svcTypeLoadBalancer == t || svcTypeExternalIP == t {
-		err := s.writeLBSrcRangeSvcNATKeys(sinfo, svc.id, count, local)
+		err := s.writeLBSrcRangeSvcNATKeys(sinfo, svc.id, count, local, svc.affinityGen)
 		if err != nil {
 			log.Debug("Failed to write LB source range NAT keys")
 		}
@@ -537,6 +763,9 @@ func (s *Syncer) apply(state DPSyncerState) error {
 	// let CachingMap calculate deltas...
 	s.bpfSvcs.DeleteAllDesired()
 	s.bpfEps.DeleteAllDesired()
+	if s.bpfMaglev != nil {
+		s.bpfMaglev.DeleteAllDesired()
+	}
 
 	// insert or update existing services
 	for sname, sinfo := range state.SvcMap {
@@ -606,11 +835,26 @@ func (s *Syncer) apply(state DPSyncerState) error {
 	if err != nil {
 		return err
 	}
+	// The Maglev tables only point to backends that exist by now.  Until a table is complete, the
+	// dataplane picks a random backend for the slots that are missing.
+	if s.bpfMaglev != nil {
+		err = s.bpfMaglev.ApplyUpdatesOnly()
+		if err != nil {
+			return err
+		}
+	}
 	// Update the frontends, after this is done we should be handling packets correctly.
 	err = s.bpfSvcs.ApplyUpdatesOnly()
 	if err != nil {
 		return err
 	}
+	// Remove the tables of the removed services before their backends.
+	if s.bpfMaglev != nil {
+		err = s.bpfMaglev.ApplyDeletionsOnly()
+		if err != nil {
+			return err
+		}
+	}
 	// Remove any unused backends.
 	err = s.bpfEps.ApplyDeletionsOnly()
 	if err != nil {
@@ -619,6 +863,8 @@ func (s *Syncer) apply(state DPSyncerState) error {
 
 	log.Info("new state written")
 
+	updateCTLBGen(s.bpfCTLBGen)
+
 	s.runExpandNPFixup(expNPMisses)
 
 	return nil
@@ -640,15 +886,17 @@ func (s *Syncer) Apply(state DPSyncerState) error {
 		s.prevEpsMap = s.newEpsMap
 	}
 
-	// preallocate maps to track sticky services for cleanup
-	s.stickySvcs = make(map[nat.FrontEndAffinityKey]stickyFrontend)
-	s.stickyEps = make(map[uint32]map[nat.BackendValue]struct{})
-
-	defer func() {
-		// not needed anymore
-		s.stickySvcs = nil
-		s.stickyEps = nil
-	}()
+	// The dataplane ignores the affinities of the older generations of a service, so they don't
+	// need to be cleaned up as the services change.  Only the first Apply cleans up after the
+	// previous Felix, which may have deleted services that we know nothing about.
+	startup := !s.synced
+	if startup {
+		s.stickySvcs = make(map[nat.FrontEndAffinityKey]stickyFrontend)
+		defer func() {
+			// not needed anymore
+			s.stickySvcs = nil
+		}()
+	}
 
 	s.mapsLck.Lock()
 	defer s.mapsLck.Unlock()
@@ -664,50 +912,39 @@ func (s *Syncer) Apply(state DPSyncerState) error {
 		s.synced = true
 	}
 
-	// We wrote all updates, noone will create new records in affinity table
-	// that we would clean up now, so do it!
+	if !startup {
+		return nil
+	}
+	// We wrote all updates, the dataplane only creates records in the affinity table of the
+	// current generations, which the cleanup keeps.
 	return s.cleanupSticky()
 }
 
-func (s *Syncer) updateService(sname k8sp.ServicePortName, sinfo k8sp.ServicePort, id uint32, eps []k8sp.Endpoint) (int, int, error) {
-
-	cpEps := make([]k8sp.Endpoint, 0, len(eps))
+func (s *Syncer) updateService(sname k8sp.ServicePortName, sinfo k8sp.ServicePort, id uint32,
+	slots backendSlots, affinityGen uint32) (int, int, error) {
 
-	cnt := 0
-	local := 0
+	// cpEps holds each of the endpoints once and ordinals its first ordinal.
+	cpEps := make([]k8sp.Endpoint, 0, len(slots.eps))
+	ordinals := make([]uint32, 0, len(slots.eps))
+	seen := make(map[nat.BackendValue]bool, len(slots.eps))
 
-	if sinfo.SessionAffinityType() == v1.ServiceAffinityClientIP {
-		// since we write the backend before we write the frontend, we need to
-		// preallocate the map for it
-		s.stickyEps[id] = make(map[nat.BackendValue]struct{})
-	}
-
-	for _, ep := range eps {
-		if !ep.GetIsLocal() {
-			continue
+	for ord, be := range slots.backends {
+		s.writeSvcBackend(id, uint32(ord), be)
+		if !seen[be] {
+			seen[be] = true
+			cpEps = append(cpEps, slots.eps[ord])
+			ordinals = append(ordinals, uint32(ord))
 		}
-		if err := s.writeSvcBackend(id, uint32(cnt), ep); err != nil {
-			return 0, 0, err
-		}
-
-		cpEps = append(cpEps, ep)
-		cnt++
-		local++
 	}
 
-	for _, ep := range eps {
-		if ep.GetIsLocal() {
-			continue
-		}
-		if err := s.writeSvcBackend(id, uint32(cnt), ep); err != nil {
-			return 0, 0, err
-		}
+	cnt := len(slots.backends)
+	local := slots.local
 
-		cpEps = append(cpEps, ep)
-		cnt++
+	if err := s.writeMaglevTable(sinfo, id, cpEps, ordinals); err != nil {
+		return 0, 0, err
 	}
 
-	if err := s.writeSvc(sinfo, id, cnt, local); err != nil {
+	if err := s.writeSvc(sinfo, id, cnt, local, affinityGen); err != nil {
 		return 0, 0, err
 	}
 
@@ -716,32 +953,105 @@ func (s *Syncer) updateService(sname k8sp.ServicePortName, sinfo k8sp.ServicePor
 	return cnt, local, nil
 }
 
-func (s *Syncer) writeSvcBackend(svcID uint32, idx uint32, ep k8sp.Endpoint) error {
+func backendValue(ep k8sp.Endpoint) (nat.BackendValue, error) {
+	tgtPort, err := ep.Port()
+	if err != nil {
+		return nat.BackendValue{}, errors.Errorf("no port for endpoint %q: %s", ep, err)
+	}
+	return nat.NewNATBackendValue(net.ParseIP(ep.IP()), uint16(tgtPort)), nil
+}
+
+func (s *Syncer) writeSvcBackend(svcID uint32, idx uint32, val nat.BackendValue) {
 	if log.GetLevel() >= log.DebugLevel {
 		log.WithFields(log.Fields{
 			"svcID": svcID,
 			"idx":   idx,
-			"ep":    ep,
+			"be":    val,
 		}).Debug("Writing service backend.")
 	}
-	ip := net.ParseIP(ep.IP())
 
 	key := nat.NewNATBackendKey(svcID, uint32(idx))
+	s.bpfEps.SetDesired(key[:], val[:])
+}
 
-	tgtPort, err := ep.Port()
-	if err != nil {
-		return errors.Errorf("no port for endpoint %q: %s", ep, err)
+// filterEndpointsWithHints returns the eps that are hinted for our zone if the service uses
+// topology aware hints.  Like kube-proxy, it returns all the eps unless all of them have hints and
+// at least one is hinted for our zone.
+func (s *Syncer) filterEndpointsWithHints(svc k8sp.ServicePort, eps []k8sp.Endpoint) []k8sp.Endpoint {
+	if s.zone == "" || len(eps) == 0 {
+		return eps
+	}
+	if hints := svc.HintsAnnotation(); hints != "Auto" && hints != "auto" {
+		return eps
+	}
+
+	filtered := make([]k8sp.Endpoint, 0, len(eps))
+	for _, ep := range eps {
+		zones := ep.GetZoneHints()
+		if zones.Len() == 0 {
+			log.WithField("ep", ep).Debug("Endpoint without zone hints, ignoring the hints of the service.")
+			return eps
+		}
+		if zones.Has(s.zone) {
+			filtered = append(filtered, ep)
+		}
+	}
+
+	if len(filtered) == 0 {
+		log.WithField("svc", svc).Debugf("No endpoints hinted for zone %q, ignoring the hints.", s.zone)
+		return eps
+	}
+
+	return filtered
+}
+
+// writeMaglevTable writes the Maglev lookup table of the service, whose backends are the eps, with
+// the given ordinals.  A weighted local backend has several ordinals, the table only uses the first
+// as Maglev already spreads the flows evenly over the backends.  Services with client IP affinity
+// do not get a table as the affinity already pins their clients.
+func (s *Syncer) writeMaglevTable(svc k8sp.ServicePort, svcID uint32, eps []k8sp.Endpoint,
+	ordinals []uint32) error {
+	if !s.maglevEnabled || svc.SessionAffinityType() == v1.ServiceAffinityClientIP {
+		return nil
 	}
-	val := nat.NewNATBackendValue(ip, uint16(tgtPort))
-	s.bpfEps.SetDesired(key[:], val[:])
 
-	if s.stickyEps[svcID] != nil {
-		s.stickyEps[svcID][val] = struct{}{}
+	backends := make([]string, len(eps))
+	for i, ep := range eps {
+		backends[i] = ep.String()
+	}
+
+	table := nat.NewMaglevTable(backends)
+	if table == nil {
+		if len(eps) > 0 {
+			log.WithFields(log.Fields{
+				"svc":      svc,
+				"backends": len(eps),
+			}).Warn("Too many backends for a Maglev table, using random backend selection.")
+		}
+		return nil
+	}
+
+	for slot, idx := range table {
+		key := nat.NewMaglevKey(svcID, uint32(slot))
+		val := nat.NewMaglevValue(ordinals[idx])
+		s.bpfMaglev.SetDesired(key[:], val[:])
 	}
 
 	return nil
 }
 
+// updateCTLBGen moves the generation of the NAT maps on, if there is a map for it.  The time makes
+// a generation that is newer than those that a previous Felix wrote.
+func updateCTLBGen(m bpf.Map) {
+	if m == nil {
+		return
+	}
+	if err := nat.SetCTLBGen(m, uint64(time.Now().UnixNano())); err != nil {
+		log.WithError(err).Warn("Failed to update the generation of the NAT maps, " +
+			"the connect-time load balancer may use stale backends.")
+	}
+}
+
 func getSvcNATKey(svc k8sp.ServicePort) (nat.FrontendKey, error) {
 	ip := svc.ClusterIP()
 	port := svc.Port()
@@ -779,7 +1089,8 @@ func getSvcNATKeyLBSrcRange(svc k8sp.ServicePort) ([]nat.FrontendKey, error) {
 	return keys, nil
 }
 
-func (s *Syncer) writeLBSrcRangeSvcNATKeys(svc k8sp.ServicePort, svcID uint32, count, local int) error {
+func (s *Syncer) writeLBSrcRangeSvcNATKeys(svc k8sp.ServicePort, svcID uint32, count, local int,
+	affinityGen uint32) error {
 	var key nat.FrontendKey
 	affinityTimeo := uint32(0)
 	if svc.SessionAffinityType() == v1.ServiceAffinityClientIP {
@@ -793,7 +1104,8 @@ func (s *Syncer) writeLBSrcRangeSvcNATKeys(svc k8sp.ServicePort, svcID uint32, c
 	if err != nil {
 		return err
 	}
-	val := nat.NewNATValue(svcID, uint32(count), uint32(local), affinityTimeo)
+	val := nat.NewNATValueWithAffinityGen(svcID, uint32(count), uint32(local), affinityTimeo,
+		frontendFlags(svc), affinityGen)
 	for _, key := range keys {
 		if log.GetLevel() >= log.DebugLevel {
 			log.Debugf("bpf map writing %s:%s", key, val)
@@ -809,7 +1121,20 @@ func (s *Syncer) writeLBSrcRangeSvcNATKeys(svc k8sp.ServicePort, svcID uint32, c
 	return nil
 }
 
-func (s *Syncer) writeSvc(svc k8sp.ServicePort, svcID uint32, count, local int) error {
+// frontendFlags returns the nat.NATFlg* flags of the frontends of the service.  The connect-time
+// load balancer prefers the local backends of the services that ask for them to be preferred
+// through their topology keys or require them through their internal traffic policy.
+func frontendFlags(svc k8sp.ServicePort) uint32 {
+	if keys := svc.TopologyKeys(); len(keys) > 0 && keys[0] == v1.LabelHostname {
+		return nat.NATFlgPreferLocal
+	}
+	if p := svc.InternalTrafficPolicy(); p != nil && *p == v1.ServiceInternalTrafficPolicyLocal {
+		return nat.NATFlgPreferLocal
+	}
+	return 0
+}
+
+func (s *Syncer) writeSvc(svc k8sp.ServicePort, svcID uint32, count, local int, affinityGen uint32) error {
 	key, err := getSvcNATKey(svc)
 	if err != nil {
 		return err
@@ -820,19 +1145,19 @@ func (s *Syncer) writeSvc(svc k8sp.ServicePort, svcID uint32, count, local int)
 		affinityTimeo = uint32(svc.StickyMaxAgeSeconds())
 	}
 
-	val := nat.NewNATValue(svcID, uint32(count), uint32(local), affinityTimeo)
+	val := nat.NewNATValueWithAffinityGen(svcID, uint32(count), uint32(local), affinityTimeo,
+		frontendFlags(svc), affinityGen)
 
 	if log.GetLevel() >= log.DebugLevel {
 		log.Debugf("bpf map writing %s:%s", key, val)
 	}
 	s.bpfSvcs.SetDesired(key[:], val[:])
 
-	var affkey nat.FrontEndAffinityKey
-	copy(affkey[:], key.Affinitykey())
-	// we must have written the backends by now so the map exists
-	if s.stickyEps[svcID] != nil {
+	if s.stickySvcs != nil && svc.SessionAffinityType() == v1.ServiceAffinityClientIP {
+		var affkey nat.FrontEndAffinityKey
+		copy(affkey[:], key.Affinitykey())
 		s.stickySvcs[affkey] = stickyFrontend{
-			id:    svcID,
+			gen:   affinityGen,
 			timeo: time.Duration(affinityTimeo) * time.Second,
 		}
 	}
@@ -872,6 +1197,19 @@ func (s *Syncer) newSvcID() uint32 {
 	return id
 }
 
+// newAffinityGen returns a new affinity generation for the frontends of a service.  The dataplane
+// treats the affinities of the other generations as expired, which is how the affinities to the
+// backends that are gone expire without having to find them in the affinity map.  Zero is never
+// handed out, it is the generation of the frontends without affinity.
+func (s *Syncer) newAffinityGen() uint32 {
+	gen := s.nextAffinityGen
+	if gen == 0 {
+		gen++
+	}
+	s.nextAffinityGen = gen + 1
+	return gen
+}
+
 func (s *Syncer) matchBpfSvc(bpfSvc nat.FrontendKey, k8sSvc k8sp.ServicePortName, k8sInfo k8sp.ServicePort) *svcKey {
 	matchNP := func() *svcKey {
 		if bpfSvc.Port() == uint16(k8sInfo.NodePort()) {
@@ -1062,6 +1400,9 @@ func (s *Syncer) Stop() {
 	})
 }
 
+// cleanupSticky removes the affinities of the services that are gone, of the older generations of
+// the services and those that have expired.  It walks the whole affinity map so it only runs after
+// the first Apply, the dataplane ignores such affinities anyway.
 func (s *Syncer) cleanupSticky() error {
 	debug := log.GetLevel() >= log.DebugLevel
 	_ = debug // Work around linter false-positive.
@@ -1088,9 +1429,9 @@ func (s *Syncer) cleanupSticky() error {
 			return bpf.IterDelete
 		}
 
-		if _, ok := s.stickyEps[fend.id][val.Backend()]; !ok {
+		if val.Gen() != fend.gen {
 			if debug {
-				log.Debugf("cleaning affinity %v:%v - no such a backend", key, val)
+				log.Debugf("cleaning affinity %v:%v - older generation", key, val)
 			}
 			return bpf.IterDelete
 		}
@@ -1167,6 +1508,19 @@ func (s *Syncer) ConntrackScanStart() {
 	}
 }
 
+// ServiceNames returns the names of the services, as namespace/name:port, by the IDs of their
+// frontends in the NAT maps.  The derived frontends, such as the NodePorts, have IDs of their own.
+func (s *Syncer) ServiceNames() map[uint32]string {
+	s.mapsLck.Lock()
+	defer s.mapsLck.Unlock()
+
+	names := make(map[uint32]string, len(s.newSvcMap))
+	for skey, sinfo := range s.newSvcMap {
+		names[sinfo.id] = skey.sname.String()
+	}
+	return names
+}
+
 // ConntrackScanEnd enables Apply and frees active maps
 func (s *Syncer) ConntrackScanEnd() {
 	// free the maps when the iteration is complete
@@ -1405,3 +1759,25 @@ func K8sSvcWithStickyClientIP(seconds int) K8sServicePortOption {
 		s.(*serviceInfo).sessionAffinityType = v1.ServiceAffinityClientIP
 	}
 }
+
+// K8sSvcWithTopologyKeys sets the topology keys
+func K8sSvcWithTopologyKeys(keys []string) K8sServicePortOption {
+	return func(s interface{}) {
+		s.(*serviceInfo).topologyKeys = keys
+	}
+}
+
+// K8sSvcWithInternalTrafficPolicyLocal sets the internal traffic policy to Local
+func K8sSvcWithInternalTrafficPolicyLocal() K8sServicePortOption {
+	return func(s interface{}) {
+		local := v1.ServiceInternalTrafficPolicyLocal
+		s.(*serviceInfo).internalTrafficPolicy = &local
+	}
+}
+
+// K8sSvcWithHintsAnnotation sets the topology aware hints annotation
+func K8sSvcWithHintsAnnotation(hints string) K8sServicePortOption {
+	return func(s interface{}) {
+		s.(*serviceInfo).hintsAnnotation = hints
+	}
+}
@@ -15,6 +15,8 @@
 package proxy_test
 
 import (
+	"encoding/binary"
+	"fmt"
 	"net"
 	"sync"
 	"time"
@@ -28,6 +30,7 @@ import (
 	"github.com/sirupsen/logrus"
 	v1 "k8s.io/api/core/v1"
 	"k8s.io/apimachinery/pkg/types"
+	"k8s.io/apimachinery/pkg/util/sets"
 	k8sp "k8s.io/kubernetes/pkg/proxy"
 
 	"github.com/projectcalico/felix/bpf"
@@ -782,6 +785,9 @@ var _ = Describe("BPF Syncer", func() {
 				NotTo(Equal(eps.m[nat.NewNATBackendKey(val1.ID(), 3)]))
 		}))
 
+		var affGen uint32
+		svc2FEKey := nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))
+
 		By("inserting service with affinity v1.ServiceAffinityClientIP", makestep(func() {
 			state.SvcMap[svcKey2] = proxy.NewK8sServicePort(
 				net.IPv4(10, 0, 0, 2),
@@ -800,9 +806,11 @@ var _ = Describe("BPF Syncer", func() {
 			Expect(svcs.m).To(HaveLen(1))
 			Expect(eps.m).To(HaveLen(1))
 
-			val, ok := svcs.m[nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))]
+			val, ok := svcs.m[svc2FEKey]
 			Expect(ok).To(BeTrue())
 			Expect(val.AffinityTimeout()).To(Equal(5 * time.Second))
+			affGen = val.AffinityGen()
+			Expect(affGen).NotTo(BeZero())
 		}))
 
 		By("inserting another ep for service with affinity v1.ServiceAffinityClientIP", makestep(func() {
@@ -817,8 +825,9 @@ var _ = Describe("BPF Syncer", func() {
 					net.IPv4(5, 5, 5, 5),
 					nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP)),
 				).AsBytes(),
-				nat.NewAffinityValue(
+				nat.NewAffinityValueWithGen(
 					uint64(bpf.KTimeNanos()),
+					affGen,
 					nat.NewNATBackendValue(net.IPv4(10, 2, 0, 1), 2222),
 				).AsBytes(),
 			)
@@ -830,8 +839,9 @@ var _ = Describe("BPF Syncer", func() {
 					net.IPv4(5, 5, 4, 4),
 					nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP)),
 				).AsBytes(),
-				nat.NewAffinityValue(
+				nat.NewAffinityValueWithGen(
 					uint64(bpf.KTimeNanos())-uint64(10*time.Second),
+					affGen,
 					nat.NewNATBackendValue(net.IPv4(10, 2, 0, 1), 2222),
 				).AsBytes(),
 			)
@@ -843,7 +853,10 @@ var _ = Describe("BPF Syncer", func() {
 
 			Expect(svcs.m).To(HaveLen(1))
 			Expect(eps.m).To(HaveLen(2))
-			Expect(aff.m).To(HaveLen(1))
+			// The dataplane ignores the expired entry, it is not worth a walk of the map.
+			Expect(aff.m).To(HaveLen(2))
+			// No backend is gone, the affinity stays valid.
+			Expect(svcs.m[svc2FEKey].AffinityGen()).To(Equal(affGen))
 		}))
 
 		By("deleting an ep for service with affinity v1.ServiceAffinityClientIP", makestep(func() {
@@ -856,8 +869,9 @@ var _ = Describe("BPF Syncer", func() {
 					net.IPv4(6, 6, 6, 6),
 					nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP)),
 				).AsBytes(),
-				nat.NewAffinityValue(
+				nat.NewAffinityValueWithGen(
 					uint64(bpf.KTimeNanos()),
+					affGen,
 					nat.NewNATBackendValue(net.IPv4(10, 3, 0, 1), 3333),
 				).AsBytes(),
 			)
@@ -868,24 +882,28 @@ var _ = Describe("BPF Syncer", func() {
 					net.IPv4(7, 7, 7, 7),
 					nat.NewNATKey(net.IPv4(10, 0, 0, 2), 2222, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP)),
 				).AsBytes(),
-				nat.NewAffinityValue(
+				nat.NewAffinityValueWithGen(
 					uint64(bpf.KTimeNanos()),
+					affGen,
 					nat.NewNATBackendValue(net.IPv4(10, 3, 0, 1), 3333),
 				).AsBytes(),
 			)
 			Expect(err).NotTo(HaveOccurred())
 
-			Expect(aff.m).To(HaveLen(3))
+			Expect(aff.m).To(HaveLen(4))
 
 			err = s.Apply(state)
 			Expect(err).NotTo(HaveOccurred())
 
 			Expect(svcs.m).To(HaveLen(1))
 			Expect(eps.m).To(HaveLen(1))
-			Expect(aff.m).To(HaveLen(2))
+			// A backend is gone, the new generation expires all the affinities of the
+			// service in the dataplane without touching the map.
+			Expect(aff.m).To(HaveLen(4))
+			Expect(svcs.m[svc2FEKey].AffinityGen()).To(BeNumerically(">", affGen))
 		}))
 
-		By("by removing all services and cleaning affinity table", makestep(func() {
+		By("by removing all services and leaving the affinity table to the dataplane", makestep(func() {
 			delete(state.SvcMap, svcKey2)
 			delete(state.EpsMap, svcKey2)
 
@@ -906,6 +924,14 @@ var _ = Describe("BPF Syncer", func() {
 
 			Expect(svcs.m).To(HaveLen(0))
 			Expect(eps.m).To(HaveLen(0))
+			Expect(aff.m).To(HaveLen(5))
+		}))
+
+		By("restarting Syncer, which cleans up the affinity table", makestep(func() {
+			s, _ = proxy.NewSyncer(append(nodeIPs, net.IPv4(255, 255, 255, 255)), feCache, beCache, aff, rt)
+			err := s.Apply(state)
+			Expect(err).NotTo(HaveOccurred())
+
 			Expect(aff.m).To(HaveLen(0))
 		}))
 
@@ -935,6 +961,454 @@ var _ = Describe("BPF Syncer", func() {
 	})
 })
 
+var _ = Describe("BPF Syncer with Maglev", func() {
+	var (
+		svcs   *mockNATMap
+		eps    *mockNATBackendMap
+		maglev *mock.Map
+		s      *proxy.Syncer
+	)
+
+	svcKey := k8sp.ServicePortName{
+		NamespacedName: types.NamespacedName{
+			Namespace: "default",
+			Name:      "maglev-service",
+		},
+	}
+	svcIP := net.IPv4(10, 0, 0, 5)
+
+	BeforeEach(func() {
+		svcs = newMockNATMap()
+		eps = newMockNATBackendMap()
+		maglev = mock.NewMockMap(nat.MaglevMapParameters)
+
+		var err error
+		s, err = proxy.NewSyncer([]net.IP{net.IPv4(192, 168, 0, 1)},
+			cachingmap.New(nat.FrontendMapParameters, svcs),
+			cachingmap.New(nat.BackendMapParameters, eps),
+			newMockAffinityMap(), proxy.NewRTCache())
+		Expect(err).NotTo(HaveOccurred())
+		err = s.SetMaglevMap(cachingmap.New(nat.MaglevMapParameters, maglev), true)
+		Expect(err).NotTo(HaveOccurred())
+	})
+
+	stateWithEps := func(svc k8sp.ServicePort, endpoints ...string) proxy.DPSyncerState {
+		var epsl []k8sp.Endpoint
+		for _, ep := range endpoints {
+			epsl = append(epsl, &k8sp.BaseEndpointInfo{Endpoint: ep})
+		}
+		return proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{svcKey: svc},
+			EpsMap: k8sp.EndpointsMap{svcKey: epsl},
+		}
+	}
+
+	// backendsBySlot resolves the table of the service to the backends that it points to.
+	backendsBySlot := func() map[uint32]nat.BackendValue {
+		val, ok := svcs.m[nat.NewNATKey(svcIP, 80, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))]
+		Expect(ok).To(BeTrue())
+
+		m := make(map[uint32]nat.BackendValue)
+		for k, v := range maglev.Contents {
+			var key nat.MaglevKey
+			var mv nat.MaglevValue
+			copy(key[:], k)
+			copy(mv[:], v)
+			Expect(key.ID()).To(Equal(val.ID()))
+			be, ok := eps.m[nat.NewNATBackendKey(val.ID(), mv.Ordinal())]
+			Expect(ok).To(BeTrue())
+			m[key.Slot()] = be
+		}
+		return m
+	}
+
+	It("should write a table with all the backends and update it on churn", func() {
+		svc := proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP)
+
+		err := s.Apply(stateWithEps(svc, "10.1.0.1:8080", "10.1.0.2:8080", "10.1.0.3:8080"))
+		Expect(err).NotTo(HaveOccurred())
+		Expect(maglev.Contents).To(HaveLen(nat.MaglevTableSize))
+		before := backendsBySlot()
+
+		err = s.Apply(stateWithEps(svc, "10.1.0.1:8080", "10.1.0.2:8080", "10.1.0.3:8080", "10.1.0.4:8080"))
+		Expect(err).NotTo(HaveOccurred())
+		Expect(maglev.Contents).To(HaveLen(nat.MaglevTableSize))
+		after := backendsBySlot()
+
+		moved := 0
+		for slot, be := range after {
+			if be != before[slot] && be != nat.NewNATBackendValue(net.IPv4(10, 1, 0, 4), 8080) {
+				moved++
+			}
+		}
+		Expect(moved).To(BeNumerically("<", nat.MaglevTableSize/10))
+
+		err = s.Apply(proxy.DPSyncerState{SvcMap: k8sp.ServiceMap{}, EpsMap: k8sp.EndpointsMap{}})
+		Expect(err).NotTo(HaveOccurred())
+		Expect(maglev.Contents).To(BeEmpty())
+	})
+
+	It("should not write a table for a service with client IP affinity", func() {
+		svc := proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP, proxy.K8sSvcWithStickyClientIP(10))
+
+		err := s.Apply(stateWithEps(svc, "10.1.0.1:8080", "10.1.0.2:8080"))
+		Expect(err).NotTo(HaveOccurred())
+		Expect(maglev.Contents).To(BeEmpty())
+	})
+})
+
+var _ = Describe("BPF Syncer backend selection", func() {
+	var (
+		svcs *mockNATMap
+		eps  *mockNATBackendMap
+		s    *proxy.Syncer
+	)
+
+	svcKey := k8sp.ServicePortName{
+		NamespacedName: types.NamespacedName{
+			Namespace: "default",
+			Name:      "zonal-service",
+		},
+	}
+	svcIP := net.IPv4(10, 0, 0, 6)
+
+	BeforeEach(func() {
+		svcs = newMockNATMap()
+		eps = newMockNATBackendMap()
+
+		var err error
+		s, err = proxy.NewSyncer([]net.IP{net.IPv4(192, 168, 0, 1)},
+			cachingmap.New(nat.FrontendMapParameters, svcs),
+			cachingmap.New(nat.BackendMapParameters, eps),
+			newMockAffinityMap(), proxy.NewRTCache())
+		Expect(err).NotTo(HaveOccurred())
+	})
+
+	endpoints := []k8sp.Endpoint{
+		&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.1:8080", ZoneHints: sets.NewString("zone-a")},
+		&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.2:8080", ZoneHints: sets.NewString("zone-b"), IsLocal: true},
+		&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.3:8080", ZoneHints: sets.NewString("zone-a")},
+	}
+
+	apply := func(svc k8sp.ServicePort, epsl []k8sp.Endpoint) nat.FrontendValue {
+		err := s.Apply(proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{svcKey: svc},
+			EpsMap: k8sp.EndpointsMap{svcKey: epsl},
+		})
+		Expect(err).NotTo(HaveOccurred())
+
+		val, ok := svcs.m[nat.NewNATKey(svcIP, 80, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))]
+		Expect(ok).To(BeTrue())
+		return val
+	}
+
+	backends := func(val nat.FrontendValue) []nat.BackendValue {
+		var bes []nat.BackendValue
+		for i := uint32(0); i < val.Count(); i++ {
+			be, ok := eps.m[nat.NewNATBackendKey(val.ID(), i)]
+			Expect(ok).To(BeTrue())
+			bes = append(bes, be)
+		}
+		return bes
+	}
+
+	It("should give the local backends more ordinals", func() {
+		s.SetBackendSelection(3, "")
+
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP), endpoints)
+		Expect(val.Count()).To(Equal(uint32(5)))
+		Expect(val.LocalCount()).To(Equal(uint32(3)))
+
+		local := nat.NewNATBackendValue(net.IPv4(10, 1, 0, 2), 8080)
+		Expect(backends(val)).To(Equal([]nat.BackendValue{
+			local, local, local,
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 1), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 3), 8080),
+		}))
+	})
+
+	It("should only use the backends hinted for our zone", func() {
+		s.SetBackendSelection(1, "zone-a")
+
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP,
+			proxy.K8sSvcWithHintsAnnotation("Auto")), endpoints)
+		Expect(backends(val)).To(ConsistOf(
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 1), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 3), 8080),
+		))
+		Expect(val.LocalCount()).To(BeZero())
+	})
+
+	It("should ignore the hints if the service does not use them", func() {
+		s.SetBackendSelection(1, "zone-a")
+
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP), endpoints)
+		Expect(val.Count()).To(Equal(uint32(3)))
+	})
+
+	It("should ignore the hints if no backend is hinted for our zone", func() {
+		s.SetBackendSelection(1, "zone-c")
+
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP,
+			proxy.K8sSvcWithHintsAnnotation("Auto")), endpoints)
+		Expect(val.Count()).To(Equal(uint32(3)))
+	})
+
+	It("should ignore the hints if a backend has none", func() {
+		s.SetBackendSelection(1, "zone-a")
+
+		epsl := append([]k8sp.Endpoint{&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.4:8080"}}, endpoints...)
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP,
+			proxy.K8sSvcWithHintsAnnotation("Auto")), epsl)
+		Expect(val.Count()).To(Equal(uint32(4)))
+	})
+
+	It("should let the connect-time balancer prefer the local backends if the topology asks for it", func() {
+		val := apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP), endpoints)
+		Expect(val.Flags()).To(BeZero())
+
+		val = apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP,
+			proxy.K8sSvcWithTopologyKeys([]string{v1.LabelHostname, "*"}),
+			proxy.K8sSvcWithStickyClientIP(180)), endpoints)
+		Expect(val.Flags()).To(Equal(nat.NATFlgPreferLocal))
+		Expect(val.AffinityTimeout()).To(Equal(180 * time.Second))
+		Expect(val.LocalCount()).To(Equal(uint32(1)))
+
+		val = apply(proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP,
+			proxy.K8sSvcWithInternalTrafficPolicyLocal()), endpoints)
+		Expect(val.Flags()).To(Equal(nat.NATFlgPreferLocal))
+	})
+
+	It("should update the backends in place", func() {
+		svc := proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP)
+		val1 := apply(svc, endpoints)
+		local := nat.NewNATBackendValue(net.IPv4(10, 1, 0, 2), 8080)
+		Expect(backends(val1)).To(Equal([]nat.BackendValue{
+			local,
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 1), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 3), 8080),
+		}))
+
+		By("keeping the ordinals if the backends do not change")
+		reordered := []k8sp.Endpoint{endpoints[2], endpoints[0], endpoints[1]}
+		val := apply(svc, reordered)
+		Expect(val.ID()).To(Equal(val1.ID()))
+		Expect(backends(val)).To(Equal(backends(val1)))
+
+		By("moving the last backend into the gap of a removed one")
+		val = apply(svc, []k8sp.Endpoint{endpoints[1], endpoints[2]})
+		Expect(val.ID()).To(Equal(val1.ID()))
+		Expect(backends(val)).To(Equal([]nat.BackendValue{
+			local,
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 3), 8080),
+		}))
+		Expect(eps.m).To(HaveLen(2))
+
+		By("appending a new backend")
+		val = apply(svc, []k8sp.Endpoint{endpoints[1], endpoints[2],
+			&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.4:8080"}})
+		Expect(val.ID()).To(Equal(val1.ID()))
+		Expect(backends(val)).To(Equal([]nat.BackendValue{
+			local,
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 3), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 4), 8080),
+		}))
+	})
+
+	It("should only rewrite the ordinals that change", func() {
+		svc := proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP)
+		var epsl []k8sp.Endpoint
+		for i := 0; i < 10; i++ {
+			epsl = append(epsl, &k8sp.BaseEndpointInfo{Endpoint: fmt.Sprintf("10.1.1.%d:8080", i)})
+		}
+		val1 := apply(svc, epsl)
+		before := backends(val1)
+
+		epsl = append(epsl[:3], epsl[4:]...)
+		val := apply(svc, epsl)
+		Expect(val.ID()).To(Equal(val1.ID()))
+		after := backends(val)
+		Expect(after).To(HaveLen(9))
+		for i := range after {
+			if i == 3 {
+				Expect(after[i]).To(Equal(before[9]))
+			} else {
+				Expect(after[i]).To(Equal(before[i]))
+			}
+		}
+		Expect(eps.m).NotTo(HaveKey(nat.NewNATBackendKey(val1.ID(), 9)))
+	})
+
+	It("should switch to a new set of backends under a new ID if most of them change", func() {
+		svc := proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP)
+		val1 := apply(svc, endpoints)
+
+		val2 := apply(svc, []k8sp.Endpoint{
+			endpoints[0],
+			&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.5:8080"},
+			&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.6:8080"},
+		})
+		Expect(val2.ID()).NotTo(Equal(val1.ID()))
+		Expect(val2.Count()).To(Equal(uint32(3)))
+		Expect(backends(val2)).To(ConsistOf(
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 1), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 5), 8080),
+			nat.NewNATBackendValue(net.IPv4(10, 1, 0, 6), 8080),
+		))
+
+		By("removing the backends of the old ID")
+		Expect(eps.m).To(HaveLen(3))
+		for i := uint32(0); i < val1.Count(); i++ {
+			Expect(eps.m).NotTo(HaveKey(nat.NewNATBackendKey(val1.ID(), i)))
+		}
+	})
+})
+
+var _ = Describe("BPF Syncer connect-time LB generation", func() {
+	It("should move the generation on with every Apply", func() {
+		genMap := mock.NewMockMap(nat.CTLBGenMapParameters)
+		s, err := proxy.NewSyncer([]net.IP{net.IPv4(192, 168, 0, 1)},
+			cachingmap.New(nat.FrontendMapParameters, newMockNATMap()),
+			cachingmap.New(nat.BackendMapParameters, newMockNATBackendMap()),
+			newMockAffinityMap(), proxy.NewRTCache())
+		Expect(err).NotTo(HaveOccurred())
+		s.SetCTLBGenMap(genMap)
+
+		gen := func() uint64 {
+			v, err := genMap.Get(make([]byte, 4))
+			Expect(err).NotTo(HaveOccurred())
+			return binary.LittleEndian.Uint64(v)
+		}
+
+		state := proxy.DPSyncerState{SvcMap: k8sp.ServiceMap{}, EpsMap: k8sp.EndpointsMap{}}
+		Expect(s.Apply(state)).To(Succeed())
+		first := gen()
+		Expect(first).NotTo(BeZero())
+
+		Expect(s.Apply(state)).To(Succeed())
+		Expect(gen()).To(BeNumerically(">", first))
+	})
+})
+
+var _ = Describe("BPF Syncer affinity generations", func() {
+	var (
+		s     *proxy.Syncer
+		svcs  *mockNATMap
+		eps   *mockNATBackendMap
+		aff   *mockAffinityMap
+		state proxy.DPSyncerState
+	)
+
+	svcKey := k8sp.ServicePortName{
+		NamespacedName: types.NamespacedName{Namespace: "default", Name: "sticky"},
+	}
+	feKey := nat.NewNATKey(net.IPv4(10, 0, 0, 1), 80, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))
+	clientKey := func(a byte) nat.AffinityKey {
+		return nat.NewAffinityKey(net.IPv4(5, 5, 5, a), feKey)
+	}
+
+	newSyncer := func() {
+		var err error
+		s, err = proxy.NewSyncer([]net.IP{net.IPv4(192, 168, 0, 1)},
+			cachingmap.New(nat.FrontendMapParameters, svcs),
+			cachingmap.New(nat.BackendMapParameters, eps),
+			aff, proxy.NewRTCache())
+		Expect(err).NotTo(HaveOccurred())
+	}
+
+	BeforeEach(func() {
+		svcs = newMockNATMap()
+		eps = newMockNATBackendMap()
+		aff = newMockAffinityMap()
+		newSyncer()
+
+		state = proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{
+				svcKey: proxy.NewK8sServicePort(net.IPv4(10, 0, 0, 1), 80, v1.ProtocolTCP,
+					proxy.K8sSvcWithStickyClientIP(60)),
+			},
+			EpsMap: k8sp.EndpointsMap{
+				svcKey: []k8sp.Endpoint{
+					&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.1:8080"},
+					&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.2:8080"},
+				},
+			},
+		}
+		Expect(s.Apply(state)).To(Succeed())
+	})
+
+	gen := func() uint32 {
+		Expect(svcs.m).To(HaveKey(feKey))
+		return svcs.m[feKey].AffinityGen()
+	}
+
+	It("should only move the generation on when the service loses a backend", func() {
+		first := gen()
+		Expect(first).NotTo(BeZero())
+
+		state.EpsMap[svcKey] = append(state.EpsMap[svcKey], &k8sp.BaseEndpointInfo{Endpoint: "10.1.0.3:8080"})
+		Expect(s.Apply(state)).To(Succeed())
+		Expect(gen()).To(Equal(first))
+
+		state.EpsMap[svcKey] = state.EpsMap[svcKey][1:]
+		Expect(s.Apply(state)).To(Succeed())
+		Expect(gen()).To(BeNumerically(">", first))
+	})
+
+	It("should keep the generation and the current affinities over a restart", func() {
+		current := gen()
+		now := uint64(bpf.KTimeNanos())
+		be := nat.NewNATBackendValue(net.IPv4(10, 1, 0, 1), 8080)
+		Expect(aff.Update(clientKey(1).AsBytes(), nat.NewAffinityValueWithGen(now, current, be).AsBytes())).To(Succeed())
+		Expect(aff.Update(clientKey(2).AsBytes(), nat.NewAffinityValueWithGen(now, current-1, be).AsBytes())).To(Succeed())
+		Expect(aff.Update(clientKey(3).AsBytes(),
+			nat.NewAffinityValueWithGen(now-uint64(2*time.Minute), current, be).AsBytes())).To(Succeed())
+
+		newSyncer()
+		Expect(s.Apply(state)).To(Succeed())
+		Expect(gen()).To(Equal(current))
+		Expect(aff.m).To(HaveLen(1))
+		Expect(aff.m).To(HaveKey(clientKey(1)))
+
+		// A new generation is newer than any that the frontends had.
+		state.EpsMap[svcKey] = state.EpsMap[svcKey][1:]
+		Expect(s.Apply(state)).To(Succeed())
+		Expect(gen()).To(BeNumerically(">", current))
+	})
+})
+
+var _ = Describe("BPF Syncer service names", func() {
+	It("should name the services by the IDs of their frontends", func() {
+		svcs := newMockNATMap()
+		s, err := proxy.NewSyncer([]net.IP{net.IPv4(192, 168, 0, 1)},
+			cachingmap.New(nat.FrontendMapParameters, svcs),
+			cachingmap.New(nat.BackendMapParameters, newMockNATBackendMap()),
+			newMockAffinityMap(), proxy.NewRTCache())
+		Expect(err).NotTo(HaveOccurred())
+
+		svcKey := k8sp.ServicePortName{
+			NamespacedName: types.NamespacedName{
+				Namespace: "default",
+				Name:      "named-service",
+			},
+			Port: "http",
+		}
+		svcIP := net.IPv4(10, 0, 0, 6)
+		state := proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{svcKey: proxy.NewK8sServicePort(svcIP, 80, v1.ProtocolTCP)},
+			EpsMap: k8sp.EndpointsMap{svcKey: []k8sp.Endpoint{&k8sp.BaseEndpointInfo{Endpoint: "10.1.0.1:8080"}}},
+		}
+		Expect(s.Apply(state)).To(Succeed())
+
+		val, ok := svcs.m[nat.NewNATKey(svcIP, 80, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))]
+		Expect(ok).To(BeTrue())
+		Expect(s.ServiceNames()).To(Equal(map[uint32]string{val.ID(): "default/named-service:http"}))
+
+		Expect(s.Apply(proxy.DPSyncerState{SvcMap: k8sp.ServiceMap{}, EpsMap: k8sp.EndpointsMap{}})).To(Succeed())
+		Expect(s.ServiceNames()).To(BeEmpty())
+	})
+})
+
 type mockNATMap struct {
 	mock.DummyMap
 	sync.Mutex
@@ -0,0 +1,188 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package proxy
+
+import (
+	"net"
+
+	"github.com/pkg/errors"
+	log "github.com/sirupsen/logrus"
+	v1 "k8s.io/api/core/v1"
+	k8sp "k8s.io/kubernetes/pkg/proxy"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/cachingmap"
+	"github.com/projectcalico/felix/bpf/nat"
+)
+
+// SyncerV6 is the DPSyncer of the IPv6 services.  It only programs the frontends that the
+// connect-time load balancer can use, i.e. the cluster IPs, the external IPs and the
+// LoadBalancer IPs without source ranges, and it picks the backends at random.  There is no
+// IPv6 NAT on the packet path, so there is no conntrack to clean up either.
+type SyncerV6 struct {
+	bpfSvcs *cachingmap.CachingMap
+	bpfEps  *cachingmap.CachingMap
+	// bpfCTLBGen, if set, is the nat.CTLBGenMap, see SetCTLBGenMap.
+	bpfCTLBGen bpf.Map
+
+	// ids are the IDs of the frontends, stable between the updates so that the unchanged
+	// services do not get rewritten.
+	ids    map[svcKey]uint32
+	nextID uint32
+
+	triggerFn func()
+}
+
+// NewSyncerV6 returns a new SyncerV6 that writes the given caching maps of the
+// nat.FrontendMapV6 and nat.BackendMapV6.
+func NewSyncerV6(svcsmap, epsmap *cachingmap.CachingMap) *SyncerV6 {
+	return &SyncerV6{
+		bpfSvcs: svcsmap,
+		bpfEps:  epsmap,
+		ids:     make(map[svcKey]uint32),
+	}
+}
+
+// SetCTLBGenMap sets the map of the generation of the NAT maps, like Syncer.SetCTLBGenMap.
+func (s *SyncerV6) SetCTLBGenMap(m bpf.Map) {
+	s.bpfCTLBGen = m
+}
+
+// Apply applies the new state
+func (s *SyncerV6) Apply(state DPSyncerState) error {
+	log.Infof("Applying new IPv6 state, %d service", len(state.SvcMap))
+
+	s.bpfSvcs.DeleteAllDesired()
+	s.bpfEps.DeleteAllDesired()
+
+	ids := make(map[svcKey]uint32, len(state.SvcMap))
+
+	for sname, sinfo := range state.SvcMap {
+		ips := []net.IP{sinfo.ClusterIP()}
+		for _, extIP := range sinfo.ExternalIPStrings() {
+			ips = append(ips, net.ParseIP(extIP))
+		}
+		if len(sinfo.LoadBalancerSourceRanges()) == 0 {
+			for _, lbIP := range sinfo.LoadBalancerIPStrings() {
+				ips = append(ips, net.ParseIP(lbIP))
+			}
+		}
+
+		proto, err := ProtoV1ToInt(sinfo.Protocol())
+		if err != nil {
+			log.WithError(err).WithField("service", sname).Debug("Skipping IPv6 service.")
+			continue
+		}
+
+		if sinfo.SessionAffinityType() == v1.ServiceAffinityClientIP {
+			log.WithField("service", sname).Debug("Session affinity is not supported for IPv6, ignoring.")
+		}
+
+		skey := getSvcKey(sname, "")
+		id, ok := s.ids[skey]
+		if !ok {
+			id = s.nextID
+			s.nextID++
+		}
+		ids[skey] = id
+
+		count, local, err := s.writeBackends(id, state.EpsMap[sname])
+		if err != nil {
+			return err
+		}
+
+		val := nat.NewNATValue(id, count, local, 0)
+		for _, ip := range ips {
+			if ip == nil || ip.To4() != nil {
+				continue
+			}
+			key := nat.NewNATKeyV6(ip, uint16(sinfo.Port()), proto)
+			s.bpfSvcs.SetDesired(key[:], val[:])
+		}
+	}
+
+	s.ids = ids
+
+	// Same order as in Syncer.apply, the frontends never point to missing backends.
+	if err := s.bpfSvcs.ApplyDeletionsOnly(); err != nil {
+		return err
+	}
+	if err := s.bpfEps.ApplyUpdatesOnly(); err != nil {
+		return err
+	}
+	if err := s.bpfSvcs.ApplyUpdatesOnly(); err != nil {
+		return err
+	}
+	if err := s.bpfEps.ApplyDeletionsOnly(); err != nil {
+		return err
+	}
+
+	log.Info("new IPv6 state written")
+
+	updateCTLBGen(s.bpfCTLBGen)
+
+	return nil
+}
+
+func (s *SyncerV6) writeBackends(id uint32, eps []k8sp.Endpoint) (uint32, uint32, error) {
+	var cnt, local uint32
+
+	// The local backends go first, like in Syncer.updateService.
+	for _, wantLocal := range []bool{true, false} {
+		for _, ep := range eps {
+			if ep.GetIsLocal() != wantLocal {
+				continue
+			}
+			ip := net.ParseIP(ep.IP())
+			if ip == nil || ip.To4() != nil {
+				continue
+			}
+			port, err := ep.Port()
+			if err != nil {
+				return 0, 0, errors.Errorf("no port for endpoint %q: %s", ep, err)
+			}
+
+			key := nat.NewNATBackendKey(id, cnt)
+			val := nat.NewNATBackendValueV6(ip, uint16(port))
+			s.bpfEps.SetDesired(key[:], val[:])
+
+			cnt++
+			if wantLocal {
+				local++
+			}
+		}
+	}
+
+	return cnt, local, nil
+}
+
+// ConntrackScanStart to satisfy DPSyncer, there is no IPv6 conntrack.
+func (s *SyncerV6) ConntrackScanStart() {}
+
+// ConntrackScanEnd to satisfy DPSyncer, there is no IPv6 conntrack.
+func (s *SyncerV6) ConntrackScanEnd() {}
+
+// ConntrackFrontendHasBackend to satisfy DPSyncer, there is no IPv6 conntrack.
+func (s *SyncerV6) ConntrackFrontendHasBackend(ip net.IP, port uint16, backendIP net.IP,
+	backendPort uint16, proto uint8) bool {
+	return true
+}
+
+func (s *SyncerV6) SetTriggerFn(f func()) {
+	s.triggerFn = f
+}
+
+// Stop stops the syncer
+func (s *SyncerV6) Stop() {}
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package proxy_test
+
+import (
+	"net"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+	v1 "k8s.io/api/core/v1"
+	"k8s.io/apimachinery/pkg/types"
+	k8sp "k8s.io/kubernetes/pkg/proxy"
+
+	"github.com/projectcalico/felix/bpf/cachingmap"
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/bpf/nat"
+	proxy "github.com/projectcalico/felix/bpf/proxy"
+)
+
+var _ = Describe("BPF IPv6 Syncer", func() {
+	var (
+		svcs, eps *mock.Map
+		s         *proxy.SyncerV6
+	)
+
+	svcKey := k8sp.ServicePortName{
+		NamespacedName: types.NamespacedName{
+			Namespace: "default",
+			Name:      "test-service",
+		},
+	}
+	clusterIP := net.ParseIP("fd00:96::10")
+
+	BeforeEach(func() {
+		svcs = mock.NewMockMap(nat.FrontendMapV6Parameters)
+		eps = mock.NewMockMap(nat.BackendMapV6Parameters)
+		s = proxy.NewSyncerV6(
+			cachingmap.New(nat.FrontendMapV6Parameters, svcs),
+			cachingmap.New(nat.BackendMapV6Parameters, eps),
+		)
+	})
+
+	It("should program the frontends and the local backends first", func() {
+		state := proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{
+				svcKey: proxy.NewK8sServicePort(clusterIP, 1234, v1.ProtocolTCP),
+			},
+			EpsMap: k8sp.EndpointsMap{
+				svcKey: []k8sp.Endpoint{
+					&k8sp.BaseEndpointInfo{Endpoint: "[fd00:10::1]:5555"},
+					&k8sp.BaseEndpointInfo{Endpoint: "[fd00:10::2]:5555", IsLocal: true},
+				},
+			},
+		}
+
+		Expect(s.Apply(state)).NotTo(HaveOccurred())
+
+		key := nat.NewNATKeyV6(clusterIP, 1234, proxy.ProtoV1ToIntPanic(v1.ProtocolTCP))
+		Expect(svcs.Contents).To(HaveLen(1))
+		Expect(svcs.Contents).To(HaveKey(string(key.AsBytes())))
+		var val nat.FrontendValue
+		copy(val[:], svcs.Contents[string(key.AsBytes())])
+		Expect(val.Count()).To(Equal(uint32(2)))
+		Expect(val.LocalCount()).To(Equal(uint32(1)))
+
+		Expect(eps.Contents).To(HaveLen(2))
+		first := nat.NewNATBackendKey(val.ID(), 0)
+		Expect(eps.Contents[string(first.AsBytes())]).To(
+			Equal(string(nat.NewNATBackendValueV6(net.ParseIP("fd00:10::2"), 5555).AsBytes())))
+
+		By("removing the service")
+		Expect(s.Apply(proxy.DPSyncerState{
+			SvcMap: k8sp.ServiceMap{},
+			EpsMap: k8sp.EndpointsMap{},
+		})).NotTo(HaveOccurred())
+		Expect(svcs.Contents).To(BeEmpty())
+		Expect(eps.Contents).To(BeEmpty())
+	})
+})
@@ -64,6 +64,9 @@ const (
 	FlagLocal       Flags = 0x08
 	FlagHost        Flags = 0x10
 	FlagSameSubnet  Flags = 0x20
+	// FlagNextHopGroup marks the remote workload routes whose next hop is a next-hop group, see
+	// NextHopGroupMapParameters.
+	FlagNextHopGroup Flags = 0x40
 
 	FlagsUnknown        Flags = 0
 	FlagsRemoteWorkload       = FlagWorkload
@@ -80,6 +83,7 @@ const (
 //   union {
 //     __u32 next_hop;
 //     __u32 ifIndex;
+//     __u32 nh_group;
 //   };
 // };
 const ValueSize = 8
@@ -138,7 +142,11 @@ func (v Value) String() string {
 	}
 
 	if typeFlags&FlagLocal == 0 && typeFlags&FlagWorkload != 0 {
-		parts = append(parts, "nh", fmt.Sprint(v.NextHop()))
+		if typeFlags&FlagNextHopGroup != 0 {
+			parts = append(parts, "nh-group", fmt.Sprint(v.NextHopGroup()))
+		} else {
+			parts = append(parts, "nh", fmt.Sprint(v.NextHop()))
+		}
 	}
 
 	if len(parts) == 0 {
@@ -187,8 +195,60 @@ var MapParameters = bpf.MapParameters{
 	Flags:      unix.BPF_F_NO_PREALLOC,
 }
 
+// MapReplicaParameters describes the replica of the routes map on the second NUMA node, see
+// bpf.NUMAReplicatedMap.
+// WARNING: must be kept in sync with cali_v4_rt_n1 in bpf-gpl/routes.h.
+var MapReplicaParameters = MapParameters.NUMAReplica("cali_v4_rt_n1")
+
 func Map(mc *bpf.MapContext) bpf.Map {
-	return mc.NewPinnedMap(MapParameters)
+	return mc.NewNUMAReplicatedMap(MapParameters, MapReplicaParameters)
+}
+
+// ExactMapParameters describes a hash map that holds a copy of the /32 routes of the routes map.
+// The programs look an address up in it before they walk the LPM trie.
+// WARNING: must be kept in sync with cali_v4_rt32 in bpf-gpl/routes.h.
+var ExactMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_rt32",
+	Type:       "hash",
+	KeySize:    ExactKeySize,
+	ValueSize:  ValueSize,
+	MaxEntries: 256 * 1024,
+	Name:       "cali_v4_rt32",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+// ExactMapReplicaParameters describes the replica of the exact map on the second NUMA node.
+// WARNING: must be kept in sync with cali_v4_rt32_n1 in bpf-gpl/routes.h.
+var ExactMapReplicaParameters = ExactMapParameters.NUMAReplica("cali_v4_rt32_n1")
+
+func ExactMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewNUMAReplicatedMap(ExactMapParameters, ExactMapReplicaParameters)
+}
+
+// ExactKeySize is the size of the exact map's key, the address in network byte order.
+const ExactKeySize = 4
+
+type ExactKey [ExactKeySize]byte
+
+// IsExact returns true if the route is for a single address, in which case the exact map holds a
+// copy of it.
+func (k Key) IsExact() bool {
+	return k.PrefixLen() == 32
+}
+
+// ExactKey returns the key of the route in the exact map.
+func (k Key) ExactKey() ExactKey {
+	var ek ExactKey
+	copy(ek[:], k[4:8])
+	return ek
+}
+
+// Key returns the key of the /32 route in the routes map.
+func (ek ExactKey) Key() Key {
+	var k Key
+	binary.LittleEndian.PutUint32(k[:4], 32)
+	copy(k[4:8], ek[:])
+	return k
 }
 
 type MapMem map[Key]Value
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package routes
+
+import (
+	"bytes"
+	"encoding/binary"
+	"sort"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/ip"
+)
+
+// NextHopGroupMax is the largest number of next hops in a next-hop group.
+// WARNING: must be kept in sync with CALI_RT_NH_GROUP_MAX in bpf-gpl/routes.h.
+const NextHopGroupMax = 8
+
+// NextHopGroupSize is the size of struct cali_rt_nh_group.
+const NextHopGroupSize = 4 + 4*NextHopGroupMax
+
+// NextHopGroupMapParameters describe the array of next-hop groups that the routes with FlagNextHopGroup
+// refer to.  Group 0 is never used so that a zeroed route can't refer to a group.
+// WARNING: must be kept in sync with cali_v4_nh_grp in bpf-gpl/routes.h.
+var NextHopGroupMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_nh_grp",
+	Type:       "array",
+	KeySize:    4,
+	ValueSize:  NextHopGroupSize,
+	MaxEntries: 16 * 1024,
+	Name:       "cali_v4_nh_grp",
+}
+
+func NextHopGroupMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(NextHopGroupMapParameters)
+}
+
+// NextHopGroupKey returns the key of the group in the next-hop group map.
+func NextHopGroupKey(id uint32) []byte {
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, id)
+	return k
+}
+
+//
+// struct cali_rt_nh_group {
+//   __u32 count;
+//   __be32 next_hops[CALI_RT_NH_GROUP_MAX];
+// };
+type NextHopGroup [NextHopGroupSize]byte
+
+// NewNextHopGroup returns the group of the distinct next hops.  It sorts them, so that the same next hops
+// always make the same group, and keeps the first NextHopGroupMax.
+func NewNextHopGroup(nextHops []ip.V4Addr) NextHopGroup {
+	sorted := make([]ip.V4Addr, len(nextHops))
+	copy(sorted, nextHops)
+	sort.Slice(sorted, func(i, j int) bool {
+		return bytes.Compare(sorted[i][:], sorted[j][:]) < 0
+	})
+
+	var g NextHopGroup
+	count := 0
+	for i, nh := range sorted {
+		if count == NextHopGroupMax {
+			break
+		}
+		if i > 0 && nh == sorted[i-1] {
+			continue
+		}
+		copy(g[4+4*count:8+4*count], nh[:])
+		count++
+	}
+	binary.LittleEndian.PutUint32(g[:4], uint32(count))
+	return g
+}
+
+func (g NextHopGroup) NextHops() []ip.V4Addr {
+	count := int(binary.LittleEndian.Uint32(g[:4]))
+	if count > NextHopGroupMax {
+		count = NextHopGroupMax
+	}
+	nextHops := make([]ip.V4Addr, count)
+	for i := range nextHops {
+		copy(nextHops[i][:], g[4+4*i:8+4*i])
+	}
+	return nextHops
+}
+
+func (g NextHopGroup) AsBytes() []byte {
+	return g[:]
+}
+
+func NewValueWithNextHopGroup(flags Flags, id uint32) Value {
+	var v Value
+	binary.LittleEndian.PutUint32(v[:4], uint32(flags|FlagNextHopGroup))
+	binary.LittleEndian.PutUint32(v[4:8], id)
+	return v
+}
+
+// NextHopGroup returns the ID of the next-hop group of a route with FlagNextHopGroup.
+func (v Value) NextHopGroup() uint32 {
+	return binary.LittleEndian.Uint32(v[4:8])
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package routes
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/ip"
+)
+
+func TestNextHopGroup(t *testing.T) {
+	RegisterTestingT(t)
+
+	a := ip.FromString("10.0.0.1").(ip.V4Addr)
+	b := ip.FromString("10.0.0.2").(ip.V4Addr)
+	c := ip.FromString("10.0.1.1").(ip.V4Addr)
+
+	grp := NewNextHopGroup([]ip.V4Addr{c, a, b, a})
+	Expect(grp.NextHops()).To(Equal([]ip.V4Addr{a, b, c}))
+	Expect(grp).To(Equal(NewNextHopGroup([]ip.V4Addr{b, c, a})), "the order of the next hops shouldn't matter")
+
+	var many []ip.V4Addr
+	for i := 0; i < NextHopGroupMax+2; i++ {
+		many = append(many, ip.V4Addr{10, 0, 2, byte(i)})
+	}
+	Expect(NewNextHopGroup(many).NextHops()).To(Equal(many[:NextHopGroupMax]))
+
+	v := NewValueWithNextHopGroup(FlagsRemoteWorkload, 7)
+	Expect(v.Flags()).To(Equal(FlagsRemoteWorkload | FlagNextHopGroup))
+	Expect(v.NextHopGroup()).To(Equal(uint32(7)))
+	Expect(v.String()).To(Equal("remote workload nh-group 7"))
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package routes
+
+import (
+	"encoding/binary"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/ip"
+)
+
+// TunMTUMapParameters describe the map of the MTUs of the tunnels to the remote nodes, keyed by the IP of the
+// node, which is the next hop of the routes to its workloads.
+// WARNING: must be kept in sync with cali_v4_tun_mtu in bpf-gpl/tun_mtu.h.
+var TunMTUMapParameters = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_tun_mtu",
+	Type:       "hash",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 64 * 1024,
+	Name:       "cali_v4_tun_mtu",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func TunMTUMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(TunMTUMapParameters)
+}
+
+// TunMTUKey returns the key of the node in the tunnel MTU map.
+func TunMTUKey(node ip.V4Addr) []byte {
+	k := node
+	return k[:]
+}
+
+// TunMTUValue returns the value of the tunnel MTU map for the given MTU.
+func TunMTUValue(mtu int) []byte {
+	v := make([]byte, 4)
+	binary.LittleEndian.PutUint32(v, uint32(mtu))
+	return v
+}
@@ -46,6 +46,11 @@ const (
 //    struct calico_ct_result ct_result;
 //    struct calico_nat_dest nat_dest;
 //    __u64 prog_start_time;
+//    struct cali_rt_cache rt_cache;
+//    __u32 pol_resume;
+//    __u32 pol_gen;
+//    __u64 pol_start_time;
+//    __u64 now;
 // };
 type State struct {
 	SrcAddr             uint32
@@ -68,9 +73,20 @@ type State struct {
 	ConntrackIfIndexCtd uint32
 	NATData             uint64
 	ProgStartTime       uint64
+	// RouteCache is the per-packet route lookup cache, which is only meaningful to the BPF
+	// programs.
+	RouteCache [32]byte
+	// PolicyResume is only used between the programs of a split policy program.
+	PolicyResume uint32
+	// PolicyGeneration is the policy verdict cache generation seen by the TC program.
+	PolicyGeneration uint32
+	// PolicyStartTime is when the TC program handed the packet to the policy program.
+	PolicyStartTime uint64
+	// Now is the conntrack and NAT bookkeeping timestamp of the packet.
+	Now uint64
 }
 
-const expectedSize = 80
+const expectedSize = 136
 
 func (s *State) AsBytes() []byte {
 	size := unsafe.Sizeof(State{})
@@ -98,7 +114,7 @@ func Map(mc *bpf.MapContext) bpf.Map {
 		ValueSize:  expectedSize,
 		MaxEntries: 1,
 		Name:       "cali_v4_state",
-		Version:    3,
+		Version:    7,
 	})
 }
 
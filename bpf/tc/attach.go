@@ -37,6 +37,9 @@ import (
 	"github.com/projectcalico/libcalico-go/lib/set"
 
 	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/ifcfg"
+	"github.com/projectcalico/felix/bpf/nat"
 )
 
 type AttachPoint struct {
@@ -53,6 +56,67 @@ type AttachPoint struct {
 	TunnelMTU            uint16
 	VXLANPort            uint16
 	ExtToServiceConnmark uint32
+	// EventsSampleRate, if non-zero, selects the program variant that emits one sampled flow event per
+	// EventsSampleRate packets per CPU to the cali_events ring buffer.
+	EventsSampleRate uint32
+	// PacketCapture selects the same variant, which copies the packets that match the cali_capture
+	// filter to the ring buffer, even if EventsSampleRate is zero.
+	PacketCapture bool
+	// ConntrackLRU is set if the conntrack map is an LRU map, see conntrack.LRUMapParams.
+	ConntrackLRU bool
+	// NATAffinityPerCPULRU is set if the NAT affinity map has per-CPU LRU lists, see
+	// nat.AffinityMapPerCPULRUParameters.
+	NATAffinityPerCPULRU bool
+	// PolicyCache enables the policy verdict cache, see polcache.VerdictMapParams.
+	PolicyCache bool
+	// RedirectNeigh makes the program forward with bpf_redirect_neigh() and bpf_redirect_peer()
+	// rather than relying on the ARP map and resolved FIB neighbours, see bpf.SupportsRedirectNeigh.
+	RedirectNeigh bool
+	// GSOSize makes the program check the segments of GSO packets against the tunnel MTU, see
+	// bpf.SupportsGSOSize.
+	GSOSize bool
+	// KtimeCoarse makes the program use the jiffy-precision clock for the conntrack and NAT
+	// bookkeeping, see bpf.SupportsKtimeCoarse.
+	KtimeCoarse bool
+	// ProgLatency makes the program record how long it takes with each packet, see
+	// counters.ProgLatencyMapParams.
+	ProgLatency bool
+	// LeanTunnel makes the tunnel and wireguard programs skip conntrack and NAT, which the
+	// endpoint programs that the packets go through next do anyway.
+	LeanTunnel bool
+	// WorkloadInline makes host endpoint programs hand packets for local workloads to the
+	// to-workload program inline, see WEPProgsMapParams.
+	WorkloadInline bool
+	// IfaceConfig makes the program read HostIP, IntfIP, TunnelMTU, VXLANPort and
+	// ExtToServiceConnmark from the cali_v4_ifcfg map, see IfaceConfigValue, rather than patching
+	// them into the binary.
+	IfaceConfig bool
+	// ConntrackAccounting makes the program count the packets and bytes of each flow, see
+	// conntrack.AcctMapParams.
+	ConntrackAccounting bool
+	// SNATIP, SNATPortMin and SNATPortMax make the program of a workload SNAT its NAT-outgoing
+	// flows itself, to SNATIP and a port in the range, rather than leave them to iptables.  A nil
+	// SNATIP or a zero SNATPortMax disables it.  SNATIfindex is the interface that owns SNATIP,
+	// the flows that leave through other interfaces are still left to iptables.
+	SNATIP      net.IP
+	SNATIfindex int
+	SNATPortMin uint16
+	SNATPortMax uint16
+	// EDT makes the program of a host endpoint give the packets of the workloads in edt.MapParams
+	// their earliest departure time, for the fq qdisc of the interface, see EnsureFQ.
+	EDT bool
+	// ServiceCounters makes the program count the NAT lookups of new flows per service, see
+	// nat.ServiceCountersMapParams.
+	ServiceCounters bool
+	// MapSizes overrides the sizes of the maps in the program, see bpf.MapContext.MapSizes.
+	MapSizes map[string]uint32
+	// NUMAReplicas makes the program look up the replicas of the read-mostly maps when it runs on
+	// the second NUMA node, see bpf.NUMAReplicatedMap.
+	NUMAReplicas bool
+	// MapNUMANodes lists the maps that are placed on NUMA nodes, see bpf.MapContext.NUMANodes.
+	MapNUMANodes map[string]int
+	// Variant selects the specialised program variant, see ProgVariant.
+	Variant ProgVariant
 }
 
 var tcLock sync.RWMutex
@@ -61,27 +125,24 @@ var ErrDeviceNotFound = errors.New("device not found")
 var ErrInterrupted = errors.New("dump interrupted")
 var prefHandleRe = regexp.MustCompile(`pref ([^ ]+) .* handle ([^ ]+)`)
 
-// AttachProgram attaches a BPF program from a file to the TC attach point
+// AttachProgram attaches a BPF program from a file to the TC attach point.  The patched binary is
+// handed to tc as a memory-backed file rather than being written out to disk.
 func (ap AttachPoint) AttachProgram() error {
 	logCxt := log.WithField("attachPoint", ap)
 
-	tempDir, err := ioutil.TempDir("", "calico-tc")
-	if err != nil {
-		return fmt.Errorf("failed to create temporary directory: %w", err)
-	}
-	defer func() {
-		_ = os.RemoveAll(tempDir)
-	}()
-
 	filename := ap.FileName()
-	preCompiledBinary := path.Join(bpf.ObjectDir, filename)
-	tempBinary := path.Join(tempDir, filename)
-
-	err = ap.patchBinary(logCxt, preCompiledBinary, tempBinary)
+	b, err := ap.patchedBinary(logCxt, path.Join(bpf.ObjectDir, filename), false)
 	if err != nil {
 		logCxt.WithError(err).Error("Failed to patch binary")
 		return err
 	}
+	obj, err := b.MemFile(filename)
+	if err != nil {
+		return fmt.Errorf("failed to write patched BPF binary: %w", err)
+	}
+	defer func() {
+		_ = obj.Close()
+	}()
 
 	// Using the RLock allows multiple attach calls to proceed in parallel unless
 	// CleanUpJumpMaps() (which takes the writer lock) is running.
@@ -90,15 +151,25 @@ func (ap AttachPoint) AttachProgram() error {
 	defer tcLock.RUnlock()
 	logCxt.Debug("AttachProgram got lock.")
 
+	return ap.replaceFilter([]*os.File{obj}, "obj", childFilePath(0), "sec", SectionName(ap.Type, ap.ToOrFrom))
+}
+
+// replaceFilter adds a tc filter with the given BPF program arguments to the attach point and
+// then removes the calico programs that were attached before.  files are passed to tc, see
+// childFilePath.  The caller must hold tcLock.
+func (ap AttachPoint) replaceFilter(files []*os.File, progArgs ...string) error {
 	progsToClean, err := ap.listAttachedPrograms()
 	if err != nil {
 		return err
 	}
 
-	_, err = ExecTC("filter", "add", "dev", ap.Iface, string(ap.Hook),
-		"bpf", "da", "obj", tempBinary,
-		"sec", SectionName(ap.Type, ap.ToOrFrom),
-	)
+	args := append([]string{"filter", "add", "dev", ap.Iface, string(ap.Hook), "bpf", "da"}, progArgs...)
+	_, err = execTC(files, args...)
+	if err != nil {
+		return err
+	}
+	// A program that a tcx link attached, see AttachSharedProgram, runs ahead of the filters.
+	err = ap.removeTCXLink()
 	if err != nil {
 		return err
 	}
@@ -134,7 +205,13 @@ func (ap AttachPoint) AttachProgram() error {
 }
 
 func ExecTC(args ...string) (out string, err error) {
+	return execTC(nil, args...)
+}
+
+// execTC runs tc, passing it the given files, see childFilePath.
+func execTC(files []*os.File, args ...string) (out string, err error) {
 	tcCmd := exec.Command("tc", args...)
+	tcCmd.ExtraFiles = files
 	outBytes, err := tcCmd.Output()
 	if err != nil {
 		if isCannotFindDevice(err) {
@@ -152,6 +229,12 @@ func ExecTC(args ...string) (out string, err error) {
 	return
 }
 
+// childFilePath returns the path through which a child process can open the i'th of the extra
+// files that it was passed, see exec.Cmd.ExtraFiles.
+func childFilePath(i int) string {
+	return fmt.Sprintf("/proc/self/fd/%d", 3+i)
+}
+
 func isCannotFindDevice(err error) bool {
 	if errors.Is(err, ErrDeviceNotFound) {
 		return true
@@ -209,38 +292,98 @@ func (ap AttachPoint) listAttachedPrograms() ([]attachedProg, error) {
 	return progsToClean, nil
 }
 
-func (ap AttachPoint) patchBinary(logCtx *log.Entry, ifile, ofile string) error {
+// patchedBinary reads the pre-compiled binary and patches in the parameters of the attach point.  If
+// shared is set, the program is patched to be shared between interfaces, see AttachSharedProgram,
+// and so it cannot log the name of the interface.
+func (ap AttachPoint) patchedBinary(logCtx *log.Entry, ifile string, shared bool) (*bpf.Binary, error) {
 	b, err := bpf.BinaryFromFile(ifile)
 	if err != nil {
-		return fmt.Errorf("failed to read pre-compiled BPF binary: %w", err)
+		return nil, fmt.Errorf("failed to read pre-compiled BPF binary: %w", err)
 	}
 
-	logCtx.WithField("ip", ap.HostIP).Debug("Patching in IP")
-	err = b.PatchIPv4(ap.HostIP)
-	if err != nil {
-		return fmt.Errorf("failed to patch IPv4 into BPF binary: %w", err)
+	// With IfaceConfig, the per-interface values come from the map so that the binary doesn't depend
+	// on them.
+	cfg := ap
+	if ap.IfaceConfig {
+		cfg.HostIP = net.IPv4zero
+		cfg.IntfIP = net.IPv4zero
+		cfg.TunnelMTU = 0
+		cfg.VXLANPort = 0
+		cfg.ExtToServiceConnmark = 0
 	}
 
-	b.PatchLogPrefix(ap.Iface)
-	b.PatchTunnelMTU(ap.TunnelMTU)
-	vxlanPort := ap.VXLANPort
-	if vxlanPort == 0 {
-		vxlanPort = 4789
+	logCtx.WithField("ip", cfg.HostIP).Debug("Patching in IP")
+	err = b.PatchIPv4(cfg.HostIP)
+	if err != nil {
+		return nil, fmt.Errorf("failed to patch IPv4 into BPF binary: %w", err)
+	}
+
+	if shared {
+		b.PatchLogPrefix("shared")
+	} else {
+		b.PatchLogPrefix(ap.Iface)
+	}
+	b.PatchTunnelMTU(cfg.TunnelMTU)
+	b.PatchVXLANPort(cfg.vxlanPort())
+	b.PatchExtToServiceConnmark(cfg.ExtToServiceConnmark)
+	b.PatchEventsSampleRate(ap.EventsSampleRate)
+	b.PatchPolicyCache(ap.PolicyCache)
+	b.PatchRedirectNeigh(ap.RedirectNeigh)
+	b.PatchGSOSize(ap.GSOSize)
+	b.PatchKtimeCoarse(ap.KtimeCoarse)
+	b.PatchProgLatency(ap.ProgLatency)
+	b.PatchLeanTunnel(ap.LeanTunnel)
+	b.PatchWorkloadInline(ap.WorkloadInline)
+	b.PatchSharedProgs(shared)
+	b.PatchIfaceConfig(ap.IfaceConfig)
+	b.PatchConntrackAccounting(ap.ConntrackAccounting)
+	err = b.PatchNATOutgoing(ap.SNATIP, ap.SNATIfindex, ap.SNATPortMin, ap.SNATPortMax)
+	if err != nil {
+		return nil, err
 	}
-	b.PatchVXLANPort(vxlanPort)
-	b.PatchExtToServiceConnmark(uint32(ap.ExtToServiceConnmark))
-
-	err = b.PatchIntfAddr(ap.IntfIP)
+	b.PatchEDT(ap.EDT)
+	b.PatchServiceCounters(ap.ServiceCounters)
+	b.PatchNUMAReplicas(ap.NUMAReplicas)
+	err = conntrack.PatchBinary(b, ap.ConntrackLRU)
+	if err != nil {
+		return nil, err
+	}
+	err = nat.PatchAffinityMap(b, ap.NATAffinityPerCPULRU)
 	if err != nil {
-		return fmt.Errorf("failed to patch interface IPv4 into BPF binary: %w", err)
+		return nil, err
+	}
+	for name, size := range ap.MapSizes {
+		err = b.PatchMapSize(name, size)
+		if err != nil {
+			return nil, fmt.Errorf("failed to patch size of map %s into BPF binary: %w", name, err)
+		}
+	}
+	for name := range ap.MapNUMANodes {
+		err = b.PatchMapNUMANode(name)
+		if err != nil {
+			return nil, fmt.Errorf("failed to patch NUMA node of map %s into BPF binary: %w", name, err)
+		}
 	}
 
-	err = b.WriteToFile(ofile)
+	err = b.PatchIntfAddr(cfg.IntfIP)
 	if err != nil {
-		return fmt.Errorf("failed to write pre-compiled BPF binary: %w", err)
+		return nil, fmt.Errorf("failed to patch interface IPv4 into BPF binary: %w", err)
 	}
 
-	return nil
+	return b, nil
+}
+
+// vxlanPort returns the VXLAN port of the attach point, defaulting to the IANA port.
+func (ap AttachPoint) vxlanPort() uint16 {
+	if ap.VXLANPort == 0 {
+		return 4789
+	}
+	return ap.VXLANPort
+}
+
+// IfaceConfigValue returns the entry of the attach point's interface in the cali_v4_ifcfg map.
+func (ap AttachPoint) IfaceConfigValue() ifcfg.Value {
+	return ifcfg.NewValue(ap.HostIP, ap.IntfIP, ap.ExtToServiceConnmark, ap.TunnelMTU, ap.vxlanPort())
 }
 
 // ProgramName returns the name of the program associated with this AttachPoint
@@ -250,10 +393,55 @@ func (ap AttachPoint) ProgramName() string {
 
 // FileName return the file the AttachPoint will load the program from
 func (ap AttachPoint) FileName() string {
-	return ProgFilename(ap.Type, ap.ToOrFrom, ap.ToHostDrop, ap.FIB, ap.DSR, ap.LogLevel)
+	return ProgFilename(ap.Type, ap.ToOrFrom, ap.ToHostDrop, ap.FIB, ap.DSR, ap.EventsSampleRate > 0 || ap.PacketCapture, ap.Variant, ap.LogLevel)
+}
+
+var progIDRe = regexp.MustCompile(`id (\d+)`)
+
+// ProgramID returns the ID of the program that is attached to the attach point.
+func (ap AttachPoint) ProgramID() (int, error) {
+	if info := ap.tcxLinkInfo(); info != nil {
+		return info.ProgID, nil
+	}
+	out, err := ExecTC("filter", "show", "dev", ap.Iface, string(ap.Hook))
+	if err != nil {
+		return 0, fmt.Errorf("failed to find TC filter for interface %v: %w", ap.Iface, err)
+	}
+
+	progName := ap.ProgramName()
+	for _, line := range strings.Split(out, "\n") {
+		if strings.Contains(line, progName) {
+			m := progIDRe.FindStringSubmatch(line)
+			if len(m) == 0 {
+				return 0, errors.New("failed to find program ID")
+			}
+			return strconv.Atoi(m[1])
+		}
+	}
+	return 0, errors.New("failed to find TC program")
+}
+
+// ProgramInfo returns the kernel's information about the program that is attached to the attach
+// point, including its verifier and runtime statistics.
+func (ap AttachPoint) ProgramInfo() (*bpf.ProgInfo, error) {
+	progID, err := ap.ProgramID()
+	if err != nil {
+		return nil, err
+	}
+	progFD, err := bpf.GetProgFDByID(progID)
+	if err != nil {
+		return nil, fmt.Errorf("failed to get program FD from ID: %w", err)
+	}
+	defer func() {
+		_ = progFD.Close()
+	}()
+	return bpf.GetProgInfo(progFD)
 }
 
 func (ap AttachPoint) IsAttached() (bool, error) {
+	if ap.tcxLinkInfo() != nil {
+		return true, nil
+	}
 	hasQ, err := HasQdisc(ap.Iface)
 	if err != nil {
 		return false, err
@@ -335,6 +523,10 @@ func CleanUpJumpMaps() {
 		log.WithField("prog", prog).Debug("Adding prog to attached set")
 		attachedProgs.Add(prog.ID)
 	}
+	for _, id := range tcxLinkedProgIDs() {
+		log.WithField("prog", id).Debug("Adding prog of tcx link to attached set")
+		attachedProgs.Add(id)
+	}
 
 	// Find all the maps that the attached programs refer to and remove them from consideration.
 	progsJSON, err := exec.Command("bpftool", "prog", "list", "--json").Output()
@@ -428,6 +620,57 @@ func EnsureQdisc(ifaceName string) error {
 	return nil
 }
 
+// EnsureFQ makes the root qdisc of the interface fq, or mq with an fq per transmit queue if the
+// interface has several, so that the departure times that the programs set are honoured.  fq keeps
+// a lock per transmit queue, unlike the per-workload qdiscs of the CNI bandwidth plugin.
+func EnsureFQ(ifaceName string) error {
+	queues, err := ioutil.ReadDir(fmt.Sprintf("/sys/class/net/%s/queues", ifaceName))
+	if err != nil {
+		if os.IsNotExist(err) {
+			return ErrDeviceNotFound
+		}
+		return fmt.Errorf("failed to list the queues of interface '%s': %w", ifaceName, err)
+	}
+	txQueues := 0
+	for _, q := range queues {
+		if strings.HasPrefix(q.Name(), "tx-") {
+			txQueues++
+		}
+	}
+
+	out, err := ExecTC("qdisc", "show", "dev", ifaceName)
+	if err != nil {
+		return fmt.Errorf("failed to list the qdiscs of interface '%s': %w", ifaceName, err)
+	}
+	// Replacing the qdiscs drops what they hold so only do it if they aren't already right.
+	if txQueues <= 1 {
+		if strings.Contains(out, "qdisc fq ") && strings.Contains(out, " root ") &&
+			!strings.Contains(out, "qdisc mq ") {
+			return nil
+		}
+		_, err = ExecTC("qdisc", "replace", "dev", ifaceName, "root", "fq")
+		if err != nil {
+			return fmt.Errorf("failed to add fq qdisc to interface '%s': %w", ifaceName, err)
+		}
+		return nil
+	}
+
+	if strings.Contains(out, "qdisc mq 1: root") && strings.Count(out, "qdisc fq ") == txQueues {
+		return nil
+	}
+	_, err = ExecTC("qdisc", "replace", "dev", ifaceName, "root", "handle", "1:", "mq")
+	if err != nil {
+		return fmt.Errorf("failed to add mq qdisc to interface '%s': %w", ifaceName, err)
+	}
+	for i := 1; i <= txQueues; i++ {
+		_, err = ExecTC("qdisc", "replace", "dev", ifaceName, "parent", fmt.Sprintf("1:%x", i), "fq")
+		if err != nil {
+			return fmt.Errorf("failed to add fq qdisc to queue %d of interface '%s': %w", i, ifaceName, err)
+		}
+	}
+	return nil
+}
+
 func HasQdisc(ifaceName string) (bool, error) {
 	out, err := ExecTC("qdisc", "show", "dev", ifaceName, "clsact")
 	if err != nil {
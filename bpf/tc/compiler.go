@@ -52,7 +52,40 @@ func SectionName(endpointType EndpointType, fromOrTo ToOrFromEp) string {
 	return fmt.Sprintf("calico_%s_%s_ep", fromOrTo, endpointType)
 }
 
-func ProgFilename(epType EndpointType, toOrFrom ToOrFromEp, epToHostDrop, fib, dsr bool, logLevel string) string {
+// ProgVariant selects a specialised variant of the workload and host endpoint programs that
+// compiles out the stages that the node's config doesn't use.  The zero value selects the full
+// program.  The variants are only built with logging off.
+type ProgVariant struct {
+	// NoNAT compiles out the NAT frontend lookup, for nodes that don't run the BPF kube-proxy.  It
+	// implies NoNodePortTunnel and NoCTLBReverse.
+	NoNAT bool
+	// NoNodePortTunnel compiles out the VXLAN encap and decap of node port traffic that is
+	// forwarded between nodes.
+	NoNodePortTunnel bool
+	// NoCTLBReverse compiles out the lookup of the pre-DNAT destination of the host's sockets, for
+	// nodes without the connect-time load balancer.
+	NoCTLBReverse bool
+}
+
+func (v ProgVariant) filenamePart(epType EndpointType, toOrFrom ToOrFromEp) string {
+	if epType != EpTypeWorkload && epType != EpTypeHost {
+		return ""
+	}
+	if v.NoNAT {
+		return "nonat_"
+	}
+	part := ""
+	if v.NoNodePortTunnel && (epType == EpTypeHost || toOrFrom == FromEp) {
+		// The to-workload program doesn't use the tunnel.
+		part += "nonptun_"
+	}
+	if v.NoCTLBReverse {
+		part += "noctlbrev_"
+	}
+	return part
+}
+
+func ProgFilename(epType EndpointType, toOrFrom ToOrFromEp, epToHostDrop, fib, dsr, events bool, variant ProgVariant, logLevel string) string {
 	if epToHostDrop && (epType != EpTypeWorkload || toOrFrom == ToEp) {
 		// epToHostDrop only makes sense in the from-workload program.
 		logrus.Debug("Ignoring epToHostDrop, doesn't apply to this target")
@@ -80,6 +113,25 @@ func ProgFilename(epType EndpointType, toOrFrom ToOrFromEp, epToHostDrop, fib, d
 	if logLevel == "off" {
 		logLevel = "no_log"
 	}
+	if variant != (ProgVariant{}) && logLevel != "no_log" {
+		logrus.Debug("Ignoring program variant, only built with logging off")
+		variant = ProgVariant{}
+	}
+	variantPart := variant.filenamePart(epType, toOrFrom)
+	if dsrPart != "" && (variant.NoNAT || variant.NoNodePortTunnel) {
+		// DSR only changes how the node port tunnel is used.
+		logrus.Debug("Ignoring DSR, the node port tunnel is compiled out")
+		dsrPart = ""
+	}
+	eventsPart := ""
+	if events {
+		if logLevel == "no_log" {
+			eventsPart = "ev_"
+		} else {
+			// Events are only compiled into the no_log programs.
+			logrus.Debug("Ignoring events enabled, only supported with logging off")
+		}
+	}
 	var epTypeShort string
 	switch epType {
 	case EpTypeWorkload:
@@ -91,7 +143,7 @@ func ProgFilename(epType EndpointType, toOrFrom ToOrFromEp, epToHostDrop, fib, d
 	case EpTypeWireguard:
 		epTypeShort = "wg"
 	}
-	oFileName := fmt.Sprintf("%v_%v_%s%s%s%v.o",
-		toOrFrom, epTypeShort, hostDropPart, fibPart, dsrPart, logLevel)
+	oFileName := fmt.Sprintf("%v_%v_%s%s%s%s%s%v.o",
+		toOrFrom, epTypeShort, hostDropPart, fibPart, dsrPart, variantPart, eventsPart, logLevel)
 	return oFileName
 }
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tc
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+)
+
+func TestProgFilenameVariants(t *testing.T) {
+	RegisterTestingT(t)
+
+	noNAT := ProgVariant{NoNAT: true, NoNodePortTunnel: true, NoCTLBReverse: true}
+	noTunnel := ProgVariant{NoNodePortTunnel: true, NoCTLBReverse: true}
+
+	Expect(ProgFilename(EpTypeHost, FromEp, false, true, false, false, ProgVariant{}, "off")).
+		To(Equal("from_hep_fib_no_log.o"))
+	Expect(ProgFilename(EpTypeHost, FromEp, false, true, false, true, noNAT, "off")).
+		To(Equal("from_hep_fib_nonat_ev_no_log.o"))
+	Expect(ProgFilename(EpTypeWorkload, FromEp, true, false, false, false, noTunnel, "Off")).
+		To(Equal("from_wep_host_drop_nonptun_noctlbrev_no_log.o"))
+	Expect(ProgFilename(EpTypeWorkload, ToEp, false, false, false, false, noTunnel, "off")).
+		To(Equal("to_wep_noctlbrev_no_log.o"), "The to-workload program doesn't use the tunnel")
+
+	// DSR only applies with the node port tunnel.
+	Expect(ProgFilename(EpTypeHost, ToEp, false, false, true, false, ProgVariant{NoCTLBReverse: true}, "off")).
+		To(Equal("to_hep_dsr_noctlbrev_no_log.o"))
+	Expect(ProgFilename(EpTypeHost, ToEp, false, false, true, false, noTunnel, "off")).
+		To(Equal("to_hep_nonptun_noctlbrev_no_log.o"))
+
+	// The variants are only built with logging off and for the workload and host endpoints.
+	Expect(ProgFilename(EpTypeHost, ToEp, false, false, false, false, noNAT, "Debug")).
+		To(Equal("to_hep_debug.o"))
+	Expect(ProgFilename(EpTypeTunnel, FromEp, false, false, false, false, noNAT, "off")).
+		To(Equal("from_tnl_no_log.o"))
+}
+
+func TestAttachPointFileNameEvents(t *testing.T) {
+	RegisterTestingT(t)
+
+	ap := AttachPoint{Type: EpTypeHost, ToOrFrom: FromEp, FIB: true, LogLevel: "off"}
+	Expect(ap.FileName()).To(Equal("from_hep_fib_no_log.o"))
+
+	ap.PacketCapture = true
+	Expect(ap.FileName()).To(Equal("from_hep_fib_ev_no_log.o"), "Capture needs the events variant")
+
+	ap.PacketCapture = false
+	ap.EventsSampleRate = 100
+	Expect(ap.FileName()).To(Equal("from_hep_fib_ev_no_log.o"))
+}
@@ -0,0 +1,539 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tc
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"os/exec"
+	"path"
+	"strings"
+	"sync"
+
+	log "github.com/sirupsen/logrus"
+	"github.com/vishvananda/netlink"
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/jump"
+	"github.com/projectcalico/felix/bpf/polprog"
+)
+
+// polProgsMaxIfIndex is the number of interfaces that the cali_pol_progs map has room for.
+// WARNING: must be kept in sync with POL_PROGS_MAX_IFINDEX in bpf-gpl/jump.h.
+const polProgsMaxIfIndex = 64 * 1024
+
+// PolProgsMapParams describes the map of policy trampolines of the shared programs, keyed on the
+// ifindex of the interface and the policy direction, see PolProgsKey.  A program that is shared
+// between interfaces tail calls the trampoline of its interface, which jumps to the policy program
+// in the jump map of the attach point.
+// WARNING: must be kept in sync with cali_pol_progs in bpf-gpl/jump.h.
+var PolProgsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_pol_progs",
+	Type:       "prog_array",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 2 * polProgsMaxIfIndex,
+	Name:       "cali_pol_progs",
+}
+
+func PolProgsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(PolProgsMapParams)
+}
+
+// PolProgsKey returns the key of the cali_pol_progs entry of the interface for ingress or egress
+// policy.
+func PolProgsKey(ifIndex int, polIngress bool) []byte {
+	idx := uint32(ifIndex) * 2
+	if polIngress {
+		idx++
+	}
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, idx)
+	return k
+}
+
+// RemovePolProgs removes the entries of the interface from the cali_pol_progs map.
+func RemovePolProgs(m bpf.Map, ifIndex int) error {
+	if ifIndex >= polProgsMaxIfIndex {
+		return nil
+	}
+	for _, polIngress := range []bool{false, true} {
+		err := m.Delete(PolProgsKey(ifIndex, polIngress))
+		if err != nil && !bpf.IsNotExists(err) {
+			return err
+		}
+	}
+	return nil
+}
+
+// polIngress returns true if the program of the attach point applies ingress policy.  Like
+// CALI_F_INGRESS, ingress is relative to the workload for workload endpoints.
+func (ap AttachPoint) polIngress() bool {
+	return (ap.Type == EpTypeWorkload) == (ap.ToOrFrom == ToEp)
+}
+
+const (
+	// sharedProgsDir is where the shared programs are pinned, one directory per variant.
+	sharedProgsDir = "/sys/fs/bpf/tc/calico_shared"
+	// globalPinDir is where iproute2 pins the maps with MAP_PIN_GLOBAL.
+	globalPinDir = "/sys/fs/bpf/tc/globals"
+)
+
+// sharedProg is a variant of the program, loaded once and pinned so that it can be attached to any
+// number of interfaces.
+type sharedProg struct {
+	dir string
+}
+
+// sharedAttachPoint is an attach point of a shared program.
+type sharedAttachPoint struct {
+	prog        *sharedProg
+	polProgsMap bpf.Map
+	polProgsKey []byte
+	// trampFD is the policy trampoline of the attach point, which goes back in polProgsMap when
+	// the attach point stops using a shared policy program, see SetSharedPolicyProgram.
+	trampFD bpf.ProgFD
+}
+
+// progPin returns the pin of the program in the given section.  bpftool pins each program
+// after its section, with '/' replaced by '_'.
+func (p *sharedProg) progPin(section string) string {
+	return path.Join(p.dir, section)
+}
+
+var (
+	sharedProgsLock sync.Mutex
+	sharedProgs     map[string]*sharedProg
+	// attachPointJumpMaps maps the jump maps that AttachSharedProgram returned to their attach
+	// points.
+	attachPointJumpMaps = map[bpf.MapFD]*sharedAttachPoint{}
+	// policyJumpMapSeq makes the temporary pins of the policy jump maps unique.
+	policyJumpMapSeq int
+)
+
+// AttachSharedProgram attaches the program of the attach point like AttachProgram but, rather than
+// loading a copy of the program for each interface, it loads each variant of the patched binary
+// once and attaches the same program to all the interfaces that need that variant.  Once the
+// variant is loaded, attaching it only takes a few syscalls and netlink requests, it doesn't run tc.  The policy
+// of the interface lives in a jump map of the attach point, which the program reaches through the
+// trampoline in polProgsMap.  It returns the jump map, which the caller owns.
+//
+// It returns an error, and leaves the attach point alone, if the program cannot be shared, for
+// example if a map that it uses is not pinned yet.  The caller should then fall back to
+// AttachProgram.
+func (ap AttachPoint) AttachSharedProgram(polProgsMap, stateMap bpf.Map, ifIndex int) (bpf.MapFD, error) {
+	logCxt := log.WithField("attachPoint", ap)
+
+	if ifIndex >= polProgsMaxIfIndex {
+		return 0, fmt.Errorf("ifindex %d of %s is too large for the policy trampoline map", ifIndex, ap.Iface)
+	}
+
+	b, err := ap.patchedBinary(logCxt, path.Join(bpf.ObjectDir, ap.FileName()), true)
+	if err != nil {
+		logCxt.WithError(err).Error("Failed to patch binary")
+		return 0, err
+	}
+
+	prog, err := loadSharedProgram(b, ap.FileName(), ap.ProgramName())
+	if err != nil {
+		return 0, err
+	}
+
+	jumpMapFD, err := newAttachPointJumpMap(prog, fmt.Sprintf("jump_%d_%s", ifIndex, ap.Hook))
+	if err != nil {
+		return 0, err
+	}
+	defer func() {
+		if err != nil {
+			_ = jumpMapFD.Close()
+		}
+	}()
+
+	insns, err := polprog.Trampoline(stateMap.MapFD(), jumpMapFD, ap.Type != EpTypeWorkload)
+	if err != nil {
+		return 0, fmt.Errorf("failed to assemble policy trampoline: %w", err)
+	}
+	trampFD, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
+	if err != nil {
+		return 0, fmt.Errorf("failed to load policy trampoline: %w", err)
+	}
+	defer func() {
+		if err != nil {
+			_ = trampFD.Close()
+		}
+	}()
+	polProgsKey := PolProgsKey(ifIndex, ap.polIngress())
+	err = polProgsMap.Update(polProgsKey, progFDValue(trampFD))
+	if err != nil {
+		return 0, fmt.Errorf("failed to install policy trampoline: %w", err)
+	}
+
+	logCxt.Debug("AttachSharedProgram waiting for lock...")
+	tcLock.RLock()
+	defer tcLock.RUnlock()
+	logCxt.Debug("AttachSharedProgram got lock.")
+
+	err = ap.attachPinnedProgram(prog.progPin(ap.ProgramName()))
+	if err != nil {
+		return 0, err
+	}
+
+	sharedProgsLock.Lock()
+	attachPointJumpMaps[jumpMapFD] = &sharedAttachPoint{
+		prog:        prog,
+		polProgsMap: polProgsMap,
+		polProgsKey: polProgsKey,
+		trampFD:     trampFD,
+	}
+	sharedProgsLock.Unlock()
+
+	return jumpMapFD, nil
+}
+
+// SharedJumpMapVariant returns the variant of the shared program whose attach point owns the jump
+// map, or "" if the jump map did not come from AttachSharedProgram.  The policy programs of the
+// attach points of one variant only differ in the jump map that they tail call, so attach points
+// with the same policy can share a policy program that uses a jump map from
+// NewSharedPolicyJumpMap.
+func SharedJumpMapVariant(jumpMapFD bpf.MapFD) string {
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+	if sap := attachPointJumpMaps[jumpMapFD]; sap != nil {
+		return path.Base(sap.prog.dir)
+	}
+	return ""
+}
+
+// SetSharedPolicyProgram puts a policy program from NewSharedPolicyJumpMap straight into the
+// policy trampoline entry of the attach point that owns the jump map.  The shared program then
+// tail calls the policy program directly rather than through the trampoline and the attach
+// point's jump map, which saves a tail call for every packet that goes through policy.  Unlike
+// the trampoline, the policy program doesn't fall back to the default policy so the caller must
+// call ResetSharedPolicyProgram before it removes the policy of the attach point.
+func SetSharedPolicyProgram(jumpMapFD bpf.MapFD, progFD bpf.ProgFD) error {
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+	sap := attachPointJumpMaps[jumpMapFD]
+	if sap == nil {
+		return fmt.Errorf("jump map %d is not the jump map of a shared program", jumpMapFD)
+	}
+	err := sap.polProgsMap.Update(sap.polProgsKey, progFDValue(progFD))
+	if err != nil {
+		return fmt.Errorf("failed to install shared policy program: %w", err)
+	}
+	return nil
+}
+
+// ResetSharedPolicyProgram puts the policy trampoline of the attach point that owns the jump map
+// back, see SetSharedPolicyProgram.
+func ResetSharedPolicyProgram(jumpMapFD bpf.MapFD) error {
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+	sap := attachPointJumpMaps[jumpMapFD]
+	if sap == nil {
+		return nil
+	}
+	err := sap.polProgsMap.Update(sap.polProgsKey, progFDValue(sap.trampFD))
+	if err != nil {
+		return fmt.Errorf("failed to reinstall policy trampoline: %w", err)
+	}
+	return nil
+}
+
+// NewSharedPolicyJumpMap creates a jump map for a policy program that attach points of the variant
+// share.  Like the jump map of an attach point, it holds the programs of the variant that policy
+// programs tail call.  The caller owns it.
+func NewSharedPolicyJumpMap(variant string) (bpf.MapFD, error) {
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+	p := sharedProgs[variant]
+	if p == nil {
+		return 0, fmt.Errorf("shared program variant %s is not loaded", variant)
+	}
+	policyJumpMapSeq++
+	return newAttachPointJumpMap(p, fmt.Sprintf("jump_pol_%d", policyJumpMapSeq))
+}
+
+// ForgetJumpMap drops the record of a jump map that AttachSharedProgram returned, along with the
+// attach point's trampoline fd.  The caller must call it before closing the jump map since the
+// kernel may reuse the file descriptor.
+func ForgetJumpMap(jumpMapFD bpf.MapFD) {
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+	if sap := attachPointJumpMaps[jumpMapFD]; sap != nil {
+		_ = sap.trampFD.Close()
+		delete(attachPointJumpMaps, jumpMapFD)
+	}
+}
+
+// loadSharedProgram returns the variant of the program for the patched binary, loading it if it is
+// not loaded yet.  The variants are keyed on the hash of the patched binary, which covers both the
+// pre-compiled binary that we started from and the values that we patched into it.
+func loadSharedProgram(b *bpf.Binary, filename, section string) (*sharedProg, error) {
+	hash := b.Hash()
+
+	sharedProgsLock.Lock()
+	defer sharedProgsLock.Unlock()
+
+	if sharedProgs == nil {
+		// The variants that a previous Felix loaded may not match our patches, start afresh.
+		// The programs that are still attached live on until they are replaced.
+		_ = os.RemoveAll(sharedProgsDir)
+		sharedProgs = map[string]*sharedProg{}
+	}
+	if p := sharedProgs[hash]; p != nil {
+		if _, err := os.Stat(p.progPin(section)); err == nil {
+			return p, nil
+		}
+	}
+
+	logCxt := log.WithFields(log.Fields{"file": filename, "hash": hash})
+	logCxt.Info("Loading shared program variant")
+
+	p := &sharedProg{
+		dir: path.Join(sharedProgsDir, hash),
+	}
+	_ = os.RemoveAll(p.dir)
+	err := os.MkdirAll(p.dir, 0700)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create directory for shared program: %w", err)
+	}
+	cleanUp := func() {
+		_ = os.RemoveAll(p.dir)
+	}
+
+	// The jump map of the variant only holds the programs of the variant itself, the policy of
+	// each interface goes in the jump map of its attach point.
+	jumpMap := jump.Map(&bpf.MapContext{}, path.Join(p.dir, "cali_jump"))
+	err = jumpMap.EnsureExists()
+	if err != nil {
+		cleanUp()
+		return nil, fmt.Errorf("failed to create jump map of shared program: %w", err)
+	}
+	defer func() {
+		_ = jumpMap.MapFD().Close()
+	}()
+
+	pinning, err := b.MapPinning()
+	if err != nil {
+		cleanUp()
+		return nil, err
+	}
+	args := []string{"prog", "loadall", "", p.dir, "type", "classifier"}
+	for name, pin := range pinning {
+		switch pin {
+		case bpf.MapPinObject:
+			if name != "cali_jump" {
+				cleanUp()
+				return nil, fmt.Errorf("unexpected map %s with per-object pinning", name)
+			}
+			args = append(args, "map", "name", name, "pinned", jumpMap.Path())
+		case bpf.MapPinGlobal:
+			mapPath := path.Join(globalPinDir, name)
+			if _, err := os.Stat(mapPath); err != nil {
+				cleanUp()
+				return nil, fmt.Errorf("map %s is not pinned yet: %w", name, err)
+			}
+			args = append(args, "map", "name", name, "pinned", mapPath)
+		}
+	}
+
+	err = b.StripIPRoute2MapDefs()
+	if err != nil {
+		cleanUp()
+		return nil, err
+	}
+	obj, err := b.MemFile(filename)
+	if err != nil {
+		cleanUp()
+		return nil, fmt.Errorf("failed to write patched BPF binary: %w", err)
+	}
+	defer func() {
+		_ = obj.Close()
+	}()
+	args[2] = childFilePath(0)
+
+	cmd := exec.Command("bpftool", args...)
+	cmd.ExtraFiles = []*os.File{obj}
+	logCxt.WithField("args", cmd.Args).Info("About to run bpftool")
+	out, err := cmd.CombinedOutput()
+	if err != nil {
+		cleanUp()
+		return nil, fmt.Errorf("failed to load shared program: %w: %s", err, out)
+	}
+
+	for idx, section := range map[int]string{1: "1_1", 2: "1_2"} {
+		err = setJumpMapEntry(jumpMap.MapFD(), idx, p.progPin(section))
+		if err != nil {
+			cleanUp()
+			return nil, err
+		}
+	}
+
+	sharedProgs[hash] = p
+	return p, nil
+}
+
+// hookParent returns the parent of the filters of the hook in the clsact qdisc.
+func hookParent(hook Hook) uint32 {
+	if hook == HookEgress {
+		return netlink.HANDLE_MIN_EGRESS
+	}
+	return netlink.HANDLE_MIN_INGRESS
+}
+
+// attachPinnedProgram attaches the program that is pinned at progPin to the attach point and then
+// removes the calico programs that were attached before, like replaceFilter, but it talks netlink
+// directly rather than running tc.  If the kernel supports tcx, it attaches the program through a
+// tcx link, see attachTCXLink.  The caller must hold tcLock.
+func (ap AttachPoint) attachPinnedProgram(progPin string) error {
+	progFD, err := bpf.GetProgFDByPin(progPin)
+	if err != nil {
+		return fmt.Errorf("failed to open program %s: %w", progPin, err)
+	}
+	defer func() {
+		_ = progFD.Close()
+	}()
+
+	link, err := netlink.LinkByName(ap.Iface)
+	if err != nil {
+		if _, ok := err.(netlink.LinkNotFoundError); ok {
+			return ErrDeviceNotFound
+		}
+		return fmt.Errorf("failed to look up interface %s: %w", ap.Iface, err)
+	}
+	parent := hookParent(ap.Hook)
+	oldFilters, err := netlink.FilterList(link, parent)
+	if err != nil {
+		return fmt.Errorf("failed to list tc filters on interface: %w", err)
+	}
+
+	linked, err := ap.attachTCXLink(progFD, link.Attrs().Index)
+	if err != nil {
+		return err
+	}
+	if !linked {
+		err = ap.addFilter(link, parent, progFD)
+		if err != nil {
+			return err
+		}
+	}
+
+	// Success: clean up the old programs.  The program that a tcx link attached runs ahead of
+	// them so, from here, packets that it hands on would also go through the old filters; they
+	// are only around for the next few syscalls.
+	return removeCalicoFilters(oldFilters)
+}
+
+// addFilter adds a tc filter that runs the program ahead of the existing filters.
+func (ap AttachPoint) addFilter(link netlink.Link, parent uint32, progFD bpf.ProgFD) error {
+	// As with tc, leaving the priority and handle unset lets the kernel pick a priority ahead of
+	// the existing filters.  The name includes the section name, which ProgramID looks for.
+	filter := &netlink.BpfFilter{
+		FilterAttrs: netlink.FilterAttrs{
+			LinkIndex: link.Attrs().Index,
+			Parent:    parent,
+			Protocol:  unix.ETH_P_ALL,
+		},
+		Fd:           int(progFD),
+		Name:         ap.ProgramName(),
+		DirectAction: true,
+	}
+	err := netlink.FilterAdd(filter)
+	if err != nil {
+		return fmt.Errorf("failed to add tc filter to interface %s: %w", ap.Iface, err)
+	}
+	return nil
+}
+
+// removeCalicoFilters deletes the calico programs among the filters.
+func removeCalicoFilters(oldFilters []netlink.Filter) error {
+	var progErrs []error
+	for _, f := range oldFilters {
+		bf, ok := f.(*netlink.BpfFilter)
+		if !ok || !strings.Contains(bf.Name, "calico") {
+			continue
+		}
+		log.WithField("prog", bf.Name).Debug("Cleaning up old calico program")
+		err := netlink.FilterDel(f)
+		if err != nil && !errors.Is(err, unix.ENOENT) && !errors.Is(err, unix.ENODEV) {
+			log.WithError(err).WithField("prog", bf.Name).Warn("Failed to clean up old calico program.")
+			progErrs = append(progErrs, err)
+		}
+	}
+
+	if len(progErrs) != 0 {
+		return fmt.Errorf("failed to clean up one or more old calico programs: %v", progErrs)
+	}
+
+	return nil
+}
+
+// newAttachPointJumpMap creates the jump map of an attach point of a shared program.  It starts
+// with the default policy program of the variant.  The map is not pinned, it lives as long as the
+// returned file descriptor and the trampoline that refers to it.
+func newAttachPointJumpMap(prog *sharedProg, name string) (bpf.MapFD, error) {
+	// bpftool can only create pinned maps so pin it temporarily.
+	jumpMap := jump.Map(&bpf.MapContext{}, path.Join(prog.dir, name))
+	_ = os.Remove(jumpMap.Path())
+	err := jumpMap.EnsureExists()
+	if err != nil {
+		return 0, fmt.Errorf("failed to create jump map: %w", err)
+	}
+	fd := jumpMap.MapFD()
+	err = os.Remove(jumpMap.Path())
+	if err != nil {
+		_ = fd.Close()
+		return 0, fmt.Errorf("failed to unpin jump map: %w", err)
+	}
+
+	for idx, section := range map[int]string{0: "1_0", 1: "1_1", 2: "1_2"} {
+		err = setJumpMapEntry(fd, idx, prog.progPin(section))
+		if err != nil {
+			_ = fd.Close()
+			return 0, err
+		}
+	}
+
+	return fd, nil
+}
+
+// setJumpMapEntry puts the program that is pinned at progPin in the jump map at index idx.
+func setJumpMapEntry(jumpMapFD bpf.MapFD, idx int, progPin string) error {
+	progFD, err := bpf.GetProgFDByPin(progPin)
+	if err != nil {
+		return fmt.Errorf("failed to open program %s: %w", progPin, err)
+	}
+	defer func() {
+		_ = progFD.Close()
+	}()
+
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(idx))
+	err = bpf.UpdateMapEntry(jumpMapFD, k, progFDValue(progFD))
+	if err != nil {
+		return fmt.Errorf("failed to update jump map: %w", err)
+	}
+	return nil
+}
+
+func progFDValue(fd bpf.ProgFD) []byte {
+	v := make([]byte, 4)
+	binary.LittleEndian.PutUint32(v, uint32(fd))
+	return v
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tc
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+func TestPolProgsKey(t *testing.T) {
+	RegisterTestingT(t)
+	Expect(PolProgsKey(3, false)).To(Equal([]byte{6, 0, 0, 0}))
+	Expect(PolProgsKey(3, true)).To(Equal([]byte{7, 0, 0, 0}))
+	Expect(PolProgsKey(polProgsMaxIfIndex-1, true)).To(Equal([]byte{0xff, 0xff, 0x01, 0}))
+}
+
+func TestPolIngress(t *testing.T) {
+	RegisterTestingT(t)
+	// Workload policy is relative to the workload.
+	Expect(AttachPoint{Type: EpTypeWorkload, ToOrFrom: ToEp}.polIngress()).To(BeTrue())
+	Expect(AttachPoint{Type: EpTypeWorkload, ToOrFrom: FromEp}.polIngress()).To(BeFalse())
+	Expect(AttachPoint{Type: EpTypeHost, ToOrFrom: FromEp}.polIngress()).To(BeTrue())
+	Expect(AttachPoint{Type: EpTypeHost, ToOrFrom: ToEp}.polIngress()).To(BeFalse())
+	Expect(AttachPoint{Type: EpTypeTunnel, ToOrFrom: FromEp}.polIngress()).To(BeTrue())
+}
+
+func TestHookParent(t *testing.T) {
+	RegisterTestingT(t)
+	// The minor numbers of the clsact qdisc's ingress and egress hooks.
+	Expect(hookParent(HookIngress)).To(Equal(uint32(0xfffffff2)))
+	Expect(hookParent(HookEgress)).To(Equal(uint32(0xfffffff3)))
+}
+
+func TestTCXLinkPin(t *testing.T) {
+	RegisterTestingT(t)
+	// The pins must start with cali_ for CleanUpProgramsAndPins to detach the programs.
+	ap := AttachPoint{Iface: "cali1234", Hook: HookEgress}
+	Expect(ap.tcxLinkPin()).To(Equal("/sys/fs/bpf/tc/calico_links/cali_cali1234_egress"))
+	Expect(ap.tcxAttachType()).To(Equal(bpf.LinkAttachTCXEgress))
+	ap.Hook = HookIngress
+	Expect(ap.tcxAttachType()).To(Equal(bpf.LinkAttachTCXIngress))
+}
@@ -0,0 +1,166 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tc
+
+import (
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path"
+	"sync/atomic"
+
+	log "github.com/sirupsen/logrus"
+	"github.com/vishvananda/netlink"
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// tcxLinksDir is where the tcx links of the attach points are pinned so that their programs stay
+// attached across Felix restarts.  The pins are named cali_* so that CleanUpProgramsAndPins
+// removes them, which detaches the programs.
+const tcxLinksDir = "/sys/fs/bpf/tc/calico_links"
+
+// tcxUnsupported is set once the kernel turned down a tcx link, kernels before 6.6 lack tcx.
+var tcxUnsupported int32
+
+func (ap AttachPoint) tcxLinkPin() string {
+	return path.Join(tcxLinksDir, fmt.Sprintf("cali_%s_%s", ap.Iface, ap.Hook))
+}
+
+func (ap AttachPoint) tcxAttachType() bpf.LinkAttachType {
+	if ap.Hook == HookEgress {
+		return bpf.LinkAttachTCXEgress
+	}
+	return bpf.LinkAttachTCXIngress
+}
+
+// attachTCXLink attaches the program to the attach point through a pinned tcx link.  If the attach
+// point already has a link, it swaps the program of the link, which is atomic: unlike adding a tc
+// filter ahead of the old one and then deleting the old one, each packet sees exactly one of the
+// programs.  It returns false, and leaves the attach point alone, if the kernel does not support
+// tcx; the caller should then attach a tc filter.
+func (ap AttachPoint) attachTCXLink(progFD bpf.ProgFD, ifIndex int) (bool, error) {
+	if atomic.LoadInt32(&tcxUnsupported) != 0 {
+		return false, nil
+	}
+	logCxt := log.WithField("attachPoint", ap)
+
+	pin := ap.tcxLinkPin()
+	if linkFD, err := bpf.GetLinkFDByPin(pin); err == nil {
+		defer func() {
+			_ = linkFD.Close()
+		}()
+		info, err := bpf.GetLinkInfo(linkFD)
+		if err == nil && info.IfIndex == ifIndex {
+			err = bpf.UpdateLink(linkFD, progFD)
+			if err == nil {
+				logCxt.Debug("Replaced program of tcx link")
+				return true, nil
+			}
+		}
+		// The interface of the link has gone, maybe it was recreated under the same name.
+		logCxt.WithError(err).Debug("Replacing stale tcx link")
+	}
+	err := os.Remove(pin)
+	if err != nil && !os.IsNotExist(err) {
+		return false, fmt.Errorf("failed to remove stale tcx link: %w", err)
+	}
+
+	err = os.MkdirAll(tcxLinksDir, 0700)
+	if err != nil {
+		return false, fmt.Errorf("failed to create directory for tcx links: %w", err)
+	}
+	linkFD, err := bpf.CreateLink(progFD, ifIndex, ap.tcxAttachType())
+	if err == unix.EINVAL || err == unix.EOPNOTSUPP {
+		logCxt.WithError(err).Info("Kernel does not support tcx links, attaching programs as tc filters.")
+		atomic.StoreInt32(&tcxUnsupported, 1)
+		return false, nil
+	}
+	if err != nil {
+		return false, fmt.Errorf("failed to create tcx link: %w", err)
+	}
+	defer func() {
+		_ = linkFD.Close()
+	}()
+	err = bpf.PinLink(linkFD, pin)
+	if err != nil {
+		return false, fmt.Errorf("failed to pin tcx link: %w", err)
+	}
+	logCxt.Debug("Attached program through tcx link")
+	return true, nil
+}
+
+// tcxLinkInfo returns the information about the tcx link of the attach point, or nil if it has no
+// link that is still attached to the interface.
+func (ap AttachPoint) tcxLinkInfo() *bpf.LinkInfo {
+	linkFD, err := bpf.GetLinkFDByPin(ap.tcxLinkPin())
+	if err != nil {
+		return nil
+	}
+	defer func() {
+		_ = linkFD.Close()
+	}()
+	info, err := bpf.GetLinkInfo(linkFD)
+	if err != nil || info.IfIndex == 0 {
+		return nil
+	}
+	link, err := netlink.LinkByName(ap.Iface)
+	if err != nil || link.Attrs().Index != info.IfIndex {
+		return nil
+	}
+	return info
+}
+
+// removeTCXLink detaches the program that the attach point has through a tcx link, if any.
+func (ap AttachPoint) removeTCXLink() error {
+	err := os.Remove(ap.tcxLinkPin())
+	if err != nil && !os.IsNotExist(err) {
+		return fmt.Errorf("failed to remove tcx link: %w", err)
+	}
+	return nil
+}
+
+// RemoveTCXLinks detaches the programs that are attached to the interface through tcx links.
+func RemoveTCXLinks(iface string) error {
+	for _, hook := range []Hook{HookIngress, HookEgress} {
+		err := AttachPoint{Iface: iface, Hook: hook}.removeTCXLink()
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// tcxLinkedProgIDs returns the IDs of the programs that the pinned tcx links attach.
+func tcxLinkedProgIDs() []int {
+	files, err := ioutil.ReadDir(tcxLinksDir)
+	if err != nil {
+		return nil
+	}
+	var ids []int
+	for _, f := range files {
+		linkFD, err := bpf.GetLinkFDByPin(path.Join(tcxLinksDir, f.Name()))
+		if err != nil {
+			continue
+		}
+		info, err := bpf.GetLinkInfo(linkFD)
+		_ = linkFD.Close()
+		if err == nil && info.IfIndex != 0 {
+			ids = append(ids, info.ProgID)
+		}
+	}
+	return ids
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tc
+
+import (
+	"encoding/binary"
+	"fmt"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// WEPProgsMapParams describes the map of to-workload programs, keyed on the ifindex of the
+// workload's veth.  When AttachPoint.WorkloadInline is set, a host endpoint program that forwards a
+// packet to a local workload tail calls the workload's program from this map instead of redirecting
+// the packet to the veth.  The workload's program applies its policy and then delivers the packet
+// straight into the workload's namespace with bpf_redirect_peer().  Workloads with an ifindex
+// beyond the size of the map fall back to the veth.
+// WARNING: must be kept in sync with cali_wep_progs in bpf-gpl/wep_inline.h.
+var WEPProgsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_wep_progs",
+	Type:       "prog_array",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 64 * 1024,
+	Name:       "cali_wep_progs",
+}
+
+func WEPProgsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(WEPProgsMapParams)
+}
+
+// WEPProgsKey returns the key of the cali_wep_progs entry for the interface.
+func WEPProgsKey(ifIndex int) []byte {
+	k := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(ifIndex))
+	return k
+}
+
+// AddWEPProg adds the program attached to the attach point, which must be a to-workload program,
+// to the cali_wep_progs map.
+func AddWEPProg(m bpf.Map, ap *AttachPoint, ifIndex int) error {
+	if ifIndex >= WEPProgsMapParams.MaxEntries {
+		return fmt.Errorf("ifindex %d of %s is too large for the workload program map", ifIndex, ap.Iface)
+	}
+
+	progID, err := ap.ProgramID()
+	if err != nil {
+		return err
+	}
+	progFD, err := bpf.GetProgFDByID(progID)
+	if err != nil {
+		return fmt.Errorf("failed to get program FD from ID: %w", err)
+	}
+	defer func() {
+		_ = progFD.Close()
+	}()
+
+	v := make([]byte, 4)
+	binary.LittleEndian.PutUint32(v, uint32(progFD))
+	return m.Update(WEPProgsKey(ifIndex), v)
+}
+
+// RemoveWEPProg removes the entry of the interface from the cali_wep_progs map.
+func RemoveWEPProg(m bpf.Map, ifIndex int) error {
+	if ifIndex >= WEPProgsMapParams.MaxEntries {
+		return nil
+	}
+	err := m.Delete(WEPProgsKey(ifIndex))
+	if bpf.IsNotExists(err) {
+		return nil
+	}
+	return err
+}
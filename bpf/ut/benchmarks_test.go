@@ -17,8 +17,13 @@ package ut_test
 import (
 	"fmt"
 	"testing"
+	"time"
 
+	"github.com/google/gopacket/layers"
 	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
 )
 
 func BenchmarkHEP(b *testing.B) {
@@ -46,3 +51,39 @@ func BenchmarkHEP(b *testing.B) {
 		fmt.Printf("%7d iterations avg %d\n", b.N, res.Duration)
 	})
 }
+
+// BenchmarkHEPEstablishedTCP measures the per-packet cost of an established TCP flow, which is
+// dominated by the conntrack lookup and update.  Rebuild the programs with
+// EXTRA_CFLAGS=-DCALI_CT_LAST_SEEN_GRANULARITY=0 to compare with updating last_seen on every packet.
+func BenchmarkHEPEstablishedTCP(b *testing.B) {
+	RegisterTestingT(b)
+
+	tcpAck := &layers.TCP{
+		SrcPort:    54321,
+		DstPort:    7890,
+		ACK:        true,
+		DataOffset: 5,
+	}
+	_, ipv4, _, _, pktBytes, err := testPacket(nil, nil, tcpAck, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	cleanUpMaps()
+	defer cleanUpMaps()
+
+	now := time.Duration(bpf.KTimeNanos())
+	leg := conntrack.Leg{SynSeen: true, AckSeen: true, Whitelisted: true}
+	ctKey := conntrack.NewKey(uint8(ipv4.Protocol), ipv4.SrcIP, uint16(tcpAck.SrcPort),
+		ipv4.DstIP, uint16(tcpAck.DstPort))
+	ctVal := conntrack.NewValueNormal(now, now, 0, leg, leg)
+	err = ctMap.Update(ctKey.AsBytes(), ctVal[:])
+	Expect(err).NotTo(HaveOccurred())
+
+	setupAndRun(b, "no_log", "calico_from_host_ep", nil, func(progName string) {
+		b.ResetTimer()
+		res, err := bpftoolProgRunN(progName, pktBytes, b.N)
+		b.StopTimer()
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+		fmt.Printf("%7d iterations avg %d\n", b.N, res.Duration)
+	})
+}
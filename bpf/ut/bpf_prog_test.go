@@ -44,6 +44,7 @@ import (
 	"github.com/projectcalico/felix/bpf/ipsets"
 	"github.com/projectcalico/felix/bpf/jump"
 	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/polcache"
 	"github.com/projectcalico/felix/bpf/polprog"
 	"github.com/projectcalico/felix/bpf/routes"
 	"github.com/projectcalico/felix/bpf/state"
@@ -107,6 +108,14 @@ const (
 	resTC_ACT_UNSPEC = (1 << 32) - 1
 )
 
+const (
+	resXDP_ABORTED int = iota
+	resXDP_DROP
+	resXDP_PASS
+	resXDP_TX
+	resXDP_REDIRECT
+)
+
 var retvalToStr = map[int]string{
 	resTC_ACT_OK:         "TC_ACT_OK",
 	resTC_ACT_RECLASSIFY: "TC_ACT_RECLASSIFY",
@@ -152,6 +161,7 @@ func setupAndRun(logger testLogger, loglevel string, section string, rules *polp
 	topts := testOpts{
 		subtests: true,
 		logLevel: log.DebugLevel,
+		objDir:   "../../bpf-gpl/bin/",
 	}
 
 	for _, o := range opts {
@@ -182,7 +192,7 @@ outter:
 	Expect(err).NotTo(HaveOccurred())
 	defer os.RemoveAll(bpfFsDir)
 
-	obj := "../../bpf-gpl/bin/test_"
+	obj := path.Join(topts.objDir, "test_")
 	if strings.Contains(section, "from") {
 		obj += "from_"
 	} else {
@@ -221,6 +231,22 @@ outter:
 	Expect(err).NotTo(HaveOccurred())
 	bin.PatchTunnelMTU(natTunnelMTU)
 	bin.PatchVXLANPort(testVxlanPort)
+	bin.PatchPolicyCache(topts.polCache)
+	bin.PatchRedirectNeigh(false)
+	bin.PatchGSOSize(bpf.SupportsGSOSize() == nil)
+	bin.PatchKtimeCoarse(bpf.SupportsKtimeCoarse() == nil)
+	bin.PatchProgLatency(false)
+	bin.PatchLeanTunnel(false)
+	bin.PatchWorkloadInline(false)
+	bin.PatchSharedProgs(false)
+	bin.PatchIfaceConfig(false)
+	bin.PatchConntrackAccounting(topts.ctAcct)
+	// The test packets don't leave through an interface that owns hostIP, skip that check.
+	err = bin.PatchNATOutgoing(hostIP, 0, topts.snatPortMin, topts.snatPortMax)
+	Expect(err).NotTo(HaveOccurred())
+	bin.PatchEDT(false)
+	bin.PatchServiceCounters(topts.svcCtrs)
+	bin.PatchNUMAReplicas(false)
 	tempObj := tempDir + "bpf.o"
 	err = bin.WriteToFile(tempObj)
 	Expect(err).NotTo(HaveOccurred())
@@ -236,6 +262,9 @@ outter:
 	if rules != nil {
 		alloc := &forceAllocator{alloc: idalloc.New()}
 		pg := polprog.NewBuilder(alloc, ipsMap.MapFD(), stateMap.MapFD(), jumpMap.MapFD())
+		if topts.polCache {
+			pg.EnableVerdictCache()
+		}
 		insns, err := pg.Instructions(*rules)
 		Expect(err).NotTo(HaveOccurred())
 		polProgFD, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
@@ -267,6 +296,59 @@ func runBpfTest(t *testing.T, section string, rules *polprog.Rules, testFn func(
 	}, opts...)
 }
 
+// runBpfXDPTest runs the XDP program of host interfaces, with SYN cookies enabled, in isolation.
+// Unlike the TC programs, it only shares the given maps with the test.
+func runBpfXDPTest(t *testing.T, testFn func(bpfProgRunFn), maps ...bpf.Map) {
+	RegisterTestingT(t)
+
+	tempDir, err := ioutil.TempDir("", "calico-bpf-")
+	Expect(err).NotTo(HaveOccurred())
+	defer os.RemoveAll(tempDir)
+
+	bpfFsDir := "/sys/fs/bpf/" + path.Base(tempDir)
+	err = os.Mkdir(bpfFsDir, os.ModePerm)
+	Expect(err).NotTo(HaveOccurred())
+	defer os.RemoveAll(bpfFsDir)
+
+	obj := "../../bpf-gpl/bin/xdp_debug.o"
+	log.Infof("Patching binary %s", obj)
+	bin, err := bpf.BinaryFromFile(obj)
+	Expect(err).NotTo(HaveOccurred())
+	bin.PatchLogPrefix("XDP-" + bpfIfaceName)
+	err = bin.PatchIPv4(hostIP)
+	Expect(err).NotTo(HaveOccurred())
+	bin.PatchTunnelMTU(natTunnelMTU)
+	bin.PatchVXLANPort(testVxlanPort)
+	bin.PatchSynCookies(true)
+	bin.PatchCPUSteering(0)
+	bin.PatchConntrackAccounting(false)
+	bin.PatchEDT(false)
+	bin.PatchNUMAReplicas(false)
+	bin.PatchKtimeCoarse(bpf.SupportsKtimeCoarse() == nil)
+	tempObj := tempDir + "bpf.o"
+	err = bin.WriteToFile(tempObj)
+	Expect(err).NotTo(HaveOccurred())
+
+	args := []string{"prog", "loadall", tempObj, bpfFsDir, "type", "xdp"}
+	for _, m := range bpf.PinnedMaps(maps) {
+		args = append(args, "map", "name", m.GetName(), "pinned", m.Path())
+	}
+	_, err = bpftool(args...)
+	Expect(err).NotTo(HaveOccurred())
+
+	t.Run("calico_xdp", func(_ *testing.T) {
+		testFn(func(dataIn []byte) (bpfRunResult, error) {
+			// bpftool pins the programs by section.
+			res, err := bpftoolProgRun(bpfFsDir+"/prog", dataIn)
+			log.Debugf("dataIn  = %+v", dataIn)
+			if err == nil {
+				log.Debugf("dataOut = %+v", res.dataOut)
+			}
+			return res, err
+		})
+	})
+}
+
 type forceAllocator struct {
 	alloc *idalloc.IDAllocator
 }
@@ -294,8 +376,9 @@ func bpftool(args ...string) ([]byte, error) {
 var (
 	mapInitOnce sync.Once
 
-	natMap, natBEMap, ctMap, rtMap, ipsMap, stateMap, testStateMap, jumpMap, affinityMap, arpMap, fsafeMap bpf.Map
-	allMaps, progMaps                                                                                      []bpf.Map
+	natMap, natBEMap, ctMap, rtMap, ipsMap, ipsExactMap, stateMap, testStateMap, jumpMap, affinityMap, arpMap, fsafeMap       bpf.Map
+	polVCMap, polGenMap, fsafePortsMap, rtExactMap, rtNHGroupMap, ctAcctMap, fragsMap, ipsMembersMap, snatPortMap, svcCtrsMap bpf.Map
+	allMaps, progMaps                                                                                                         []bpf.Map
 )
 
 func initMapsOnce() {
@@ -305,16 +388,28 @@ func initMapsOnce() {
 		natMap = nat.FrontendMap(mc)
 		natBEMap = nat.BackendMap(mc)
 		ctMap = conntrack.Map(mc)
+		ctAcctMap = conntrack.AcctMap(mc)
+		fragsMap = conntrack.FragsMap(mc)
+		snatPortMap = conntrack.SNATPortMap(mc)
+		svcCtrsMap = nat.ServiceCountersMap(mc)
 		rtMap = routes.Map(mc)
+		rtExactMap = routes.ExactMap(mc)
+		rtNHGroupMap = routes.NextHopGroupMap(mc)
 		ipsMap = ipsets.Map(mc)
+		ipsExactMap = ipsets.ExactMap(mc)
+		ipsMembersMap = ipsets.MembersMap(mc)
 		stateMap = state.Map(mc)
 		testStateMap = state.MapForTest(mc)
 		jumpMap = jump.MapForTest(mc)
 		affinityMap = nat.AffinityMap(mc)
 		arpMap = arp.Map(mc)
 		fsafeMap = failsafes.Map(mc)
+		fsafePortsMap = failsafes.PortsMap(mc)
+		polVCMap = polcache.VerdictMap(mc)
+		polGenMap = polcache.GenerationMap(mc)
 
-		allMaps = []bpf.Map{natMap, natBEMap, ctMap, rtMap, ipsMap, stateMap, testStateMap, jumpMap, affinityMap, arpMap, fsafeMap}
+		allMaps = []bpf.Map{natMap, natBEMap, ctMap, rtMap, ipsMap, ipsExactMap, stateMap, testStateMap, jumpMap, affinityMap, arpMap, fsafeMap,
+			polVCMap, polGenMap, fsafePortsMap, rtExactMap, rtNHGroupMap, ctAcctMap, fragsMap, ipsMembersMap, snatPortMap, svcCtrsMap}
 		for _, m := range allMaps {
 			err := m.EnsureExists()
 			if err != nil {
@@ -332,6 +427,13 @@ func initMapsOnce() {
 			affinityMap,
 			arpMap,
 			fsafeMap,
+			polVCMap,
+			polGenMap,
+			fsafePortsMap,
+			ctAcctMap,
+			fragsMap,
+			snatPortMap,
+			svcCtrsMap,
 		}
 
 	})
@@ -345,7 +447,7 @@ func cleanUpMaps() {
 	defer log.SetLevel(logLevel)
 
 	for _, m := range allMaps {
-		if m == stateMap || m == testStateMap || m == jumpMap {
+		if m == stateMap || m == testStateMap || m == jumpMap || m == polGenMap {
 			continue // Can't clean up array maps
 		}
 		log.WithField("map", m.GetName()).Info("Cleaning")
@@ -362,7 +464,7 @@ func cleanUpMaps() {
 func bpftoolProgLoadAll(fname, bpfFsDir string, polProg bool, maps ...bpf.Map) error {
 	args := []string{"prog", "loadall", fname, bpfFsDir, "type", "classifier"}
 
-	for _, m := range maps {
+	for _, m := range bpf.PinnedMaps(maps) {
 		args = append(args, "map", "name", m.GetName(), "pinned", m.Path())
 	}
 
@@ -418,6 +520,15 @@ func bpftoolProgRun(progName string, dataIn []byte) (bpfRunResult, error) {
 }
 
 func bpftoolProgRunN(progName string, dataIn []byte, N int) (bpfRunResult, error) {
+	return bpftoolProgRunProg([]string{"pinned", progName}, dataIn, N)
+}
+
+// bpftoolProgRunID runs the program with the given ID, for example one that was attached by tc.
+func bpftoolProgRunID(progID int, dataIn []byte, N int) (bpfRunResult, error) {
+	return bpftoolProgRunProg([]string{"id", fmt.Sprint(progID)}, dataIn, N)
+}
+
+func bpftoolProgRunProg(prog []string, dataIn []byte, N int) (bpfRunResult, error) {
 	var res bpfRunResult
 
 	tempDir, err := ioutil.TempDir("", "bpftool-data-")
@@ -432,7 +543,8 @@ func bpftoolProgRunN(progName string, dataIn []byte, N int) (bpfRunResult, error
 		return res, errors.Errorf("failed to write input data in file: %s", err)
 	}
 
-	args := []string{"prog", "run", "pinned", progName, "data_in", dataInFname, "data_out", dataOutFname}
+	args := append([]string{"prog", "run"}, prog...)
+	args = append(args, "data_in", dataInFname, "data_out", dataOutFname)
 	if N > 1 {
 		args = append(args, "repeat", fmt.Sprintf("%d", N))
 	}
@@ -542,6 +654,12 @@ type testOpts struct {
 	subtests  bool
 	logLevel  log.Level
 	extraMaps []bpf.Map
+	polCache  bool
+	ctAcct    bool
+	svcCtrs   bool
+	objDir    string
+
+	snatPortMin, snatPortMax uint16
 }
 
 type testOption func(opts *testOpts)
@@ -570,6 +688,40 @@ func withExtraMap(m bpf.Map) testOption {
 
 var _ = withExtraMap
 
+func withPolicyCache() testOption {
+	return func(o *testOpts) {
+		o.polCache = true
+	}
+}
+
+func withConntrackAccounting() testOption {
+	return func(o *testOpts) {
+		o.ctAcct = true
+	}
+}
+
+func withServiceCounters() testOption {
+	return func(o *testOpts) {
+		o.svcCtrs = true
+	}
+}
+
+// withNATOutgoingSNAT makes the programs SNAT the NAT-outgoing flows of the workloads to hostIP
+// and a port in the range.
+func withNATOutgoingSNAT(minPort, maxPort uint16) testOption {
+	return func(o *testOpts) {
+		o.snatPortMin = minPort
+		o.snatPortMax = maxPort
+	}
+}
+
+// withObjDir loads the programs from another build of the UT binaries.
+func withObjDir(dir string) testOption {
+	return func(o *testOpts) {
+		o.objDir = dir
+	}
+}
+
 // layersMatchFields matches all Exported fields and ignore the ones explicitly
 // listed. It always ignores BaseLayer as that is not set by the tests.
 func layersMatchFields(l gopacket.Layer, ignore ...string) GomegaMatcher {
@@ -837,6 +989,7 @@ func resetBPFMaps() {
 	resetCTMap(ctMap)
 	resetRTMap(rtMap)
 	resetMap(fsafeMap)
+	resetMap(fsafePortsMap)
 }
 
 func TestMapIterWithDelete(t *testing.T) {
@@ -940,6 +1093,77 @@ func TestMapIterWithDeleteLastOfBatch(t *testing.T) {
 	}
 }
 
+func TestMapUpgrade(t *testing.T) {
+	RegisterTestingT(t)
+
+	params := bpf.MapParameters{
+		Filename:   "/sys/fs/bpf/tc/globals/cali_tupg",
+		Type:       "hash",
+		KeySize:    8,
+		ValueSize:  4,
+		MaxEntries: 1000,
+		Name:       "cali_tupg",
+		Flags:      unix.BPF_F_NO_PREALLOC,
+	}
+	old := (&bpf.MapContext{}).NewPinnedMap(params)
+	err := old.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+	defer func() {
+		_ = old.(*bpf.PinnedMap).Close()
+		_ = os.Remove(params.Filename)
+	}()
+
+	// Enough entries to span several batches.
+	const n = 2*bpf.MapDeleteBatchNumKeys + 3
+	for i := 0; i < n; i++ {
+		var k [8]byte
+		var v [4]byte
+
+		binary.LittleEndian.PutUint64(k[:], uint64(i))
+		binary.LittleEndian.PutUint32(v[:], uint32(i*7))
+
+		err := old.Update(k[:], v[:])
+		Expect(err).NotTo(HaveOccurred())
+	}
+
+	// The new version widens the value and drops the odd keys.
+	newParams := params
+	newParams.Version = 2
+	newParams.ValueSize = 8
+	m := (&bpf.MapContext{}).NewPinnedMapWithUpgrades(newParams, bpf.MapUpgrade{
+		From: params,
+		Convert: func(k, v []byte) ([]byte, []byte) {
+			if binary.LittleEndian.Uint64(k)%2 == 1 {
+				return nil, nil
+			}
+			newV := make([]byte, 8)
+			binary.LittleEndian.PutUint64(newV, uint64(binary.LittleEndian.Uint32(v)))
+			return k, newV
+		},
+	})
+	err = m.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+	defer func() {
+		_ = m.(*bpf.PinnedMap).Close()
+		_ = os.Remove(m.Path())
+	}()
+
+	_, err = os.Stat(params.Filename)
+	Expect(os.IsNotExist(err)).To(BeTrue(), "the old version of the map should be unpinned")
+
+	out := make(map[uint64]uint64)
+	err = m.Iter(func(K, V []byte) bpf.IteratorAction {
+		out[binary.LittleEndian.Uint64(K)] = binary.LittleEndian.Uint64(V)
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+
+	Expect(out).To(HaveLen((n + 1) / 2))
+	for i := 0; i < n; i += 2 {
+		Expect(out).To(HaveKeyWithValue(uint64(i), uint64(i*7)))
+	}
+}
+
 func TestJumpMap(t *testing.T) {
 	RegisterTestingT(t)
 
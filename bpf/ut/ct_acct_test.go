@@ -0,0 +1,67 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"testing"
+
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+func TestConntrackAccounting(t *testing.T) {
+	RegisterTestingT(t)
+
+	_, ipv4, l4, _, pktBytes, err := testPacket(nil, nil, nil, nil)
+	Expect(err).NotTo(HaveOccurred())
+	udp := l4.(*layers.UDP)
+
+	ctKey := conntrack.NewKey(uint8(ipv4.Protocol),
+		ipv4.SrcIP, uint16(udp.SrcPort), ipv4.DstIP, uint16(udp.DstPort))
+
+	defer resetRTMap(rtMap)
+	rtKey := routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal := routes.NewValueWithIfIndex(routes.FlagsLocalWorkload, 1).AsBytes()
+	err = rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
+
+	resetCTMap(ctMap)
+	defer resetCTMap(ctMap)
+	resetMap(ctAcctMap)
+	defer resetMap(ctAcctMap)
+
+	usage := func() conntrack.Usage {
+		b, err := ctAcctMap.Get(ctKey.AsBytes())
+		Expect(err).NotTo(HaveOccurred())
+		return conntrack.UsageFromBytes(b)
+	}
+
+	// The first packet creates the entry and is counted with it, the second one is counted
+	// by the lookup.
+	for i := 1; i <= 2; i++ {
+		runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+			res, err := bpfrun(pktBytes)
+			Expect(err).NotTo(HaveOccurred())
+			Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
+		}, withConntrackAccounting())
+
+		u := usage()
+		Expect(u.PacketsAToB + u.PacketsBToA).To(Equal(uint64(i)))
+		Expect(u.Bytes()).To(Equal(uint64(i * len(pktBytes))))
+	}
+}
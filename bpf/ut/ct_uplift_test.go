@@ -0,0 +1,115 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"testing"
+
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/tc"
+)
+
+// TestCTUpliftMidFlowHEP checks that a mid-flow TCP packet that Linux conntrack knows about gets a
+// BPF conntrack entry when it leaves through a host endpoint, so that the return traffic no longer
+// misses and falls through to iptables.
+func TestCTUpliftMidFlowHEP(t *testing.T) {
+	RegisterTestingT(t)
+
+	bpfIfaceName = "CTup"
+	defer func() { bpfIfaceName = "" }()
+	defer cleanUpMaps()
+
+	resetCTMap(ctMap) // ensure it is clean
+
+	tcpFin := &layers.TCP{
+		SrcPort:    54321,
+		DstPort:    7890,
+		ACK:        true,
+		FIN:        true,
+		DataOffset: 5,
+	}
+	_, _, _, _, finPkt, err := testPacket(nil, nil, tcpFin, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	tcpAck := &layers.TCP{
+		SrcPort:    54321,
+		DstPort:    7890,
+		ACK:        true,
+		DataOffset: 5,
+	}
+	_, ipv4, _, _, ackPkt, err := testPacket(nil, nil, tcpAck, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	ctKey := conntrack.NewKey(uint8(layers.IPProtocolTCP), ipv4.SrcIP, 54321, ipv4.DstIP, 7890)
+
+	skbMark = tc.MarkLinuxConntrackEstablished
+	defer func() { skbMark = 0 }()
+
+	// A closing connection is not worth uplifting.
+	runBpfTest(t, "calico_to_host_ep", nil, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(finPkt)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		ct, err := conntrack.LoadMapMem(ctMap)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(ct).NotTo(HaveKey(ctKey))
+	})
+
+	runBpfTest(t, "calico_to_host_ep", nil, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(ackPkt)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		ct, err := conntrack.LoadMapMem(ctMap)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(ct).To(HaveKey(ctKey))
+
+		ctr := ct[ctKey]
+		Expect(ctr.Type()).To(Equal(conntrack.TypeNormal))
+		Expect(ctr.Flags() & conntrack.FlagSkipFIB).NotTo(BeZero())
+		// We did not see who opened the connection, the host stack accepted both directions.
+		Expect(ctr.Data().A2B.Whitelisted).To(BeTrue())
+		Expect(ctr.Data().B2A.Whitelisted).To(BeTrue())
+		Expect(ctr.Data().Established()).To(BeTrue())
+	})
+
+	skbMark = 0
+
+	// The return traffic now hits the entry.
+	tcpAckRet := &layers.TCP{
+		SrcPort:    7890,
+		DstPort:    54321,
+		ACK:        true,
+		DataOffset: 5,
+	}
+	ipv4Ret := *ipv4
+	ipv4Ret.SrcIP, ipv4Ret.DstIP = ipv4Ret.DstIP, ipv4Ret.SrcIP
+	_, _, _, _, ackRetPkt, err := testPacket(nil, &ipv4Ret, tcpAckRet, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(ackRetPkt)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		ct, err := conntrack.LoadMapMem(ctMap)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(ct).To(HaveKey(ctKey))
+	})
+}
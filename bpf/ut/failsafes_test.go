@@ -211,6 +211,15 @@ func TestFailsafes(t *testing.T) {
 	)
 	Expect(err).NotTo(HaveOccurred())
 
+	// Both rules are for specific addresses, so the index sends the programs to the LPM map.
+	for _, outbound := range []bool{false, true} {
+		err = fsafePortsMap.Update(
+			failsafes.PortKeyOf(failsafes.MakeKey(17, 5678, outbound, "0.0.0.0", 0)).ToSlice(),
+			failsafes.PortValue(failsafes.PortFlagAddrScoped),
+		)
+		Expect(err).NotTo(HaveOccurred())
+	}
+
 	for _, test := range failsafeTests {
 		_, _, _, _, pktBytes, err := testPacket(nil, test.IPHeaderIPv4, test.IPHeaderUDP, nil)
 		Expect(err).NotTo(HaveOccurred())
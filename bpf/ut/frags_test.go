@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"testing"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+func TestUDPFragments(t *testing.T) {
+	RegisterTestingT(t)
+
+	defer resetRTMap(rtMap)
+	rtKey := routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal := routes.NewValueWithIfIndex(routes.FlagsLocalWorkload, 1).AsBytes()
+	err := rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
+
+	resetCTMap(ctMap)
+	defer resetCTMap(ctMap)
+	resetMap(fragsMap)
+	defer resetMap(fragsMap)
+
+	fragsEntries := func() int {
+		n := 0
+		err := fragsMap.Iter(func(_, _ []byte) bpf.IteratorAction {
+			n++
+			return bpf.IterNone
+		})
+		Expect(err).NotTo(HaveOccurred())
+		return n
+	}
+
+	// The first fragment carries the UDP header, it creates the conntrack entry and records
+	// its ports.
+	first := *ipv4Default
+	first.Flags = layers.IPv4MoreFragments
+	first.Id = 4321
+
+	_, _, _, _, pktBytes, err := testPacket(nil, &first, nil, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
+	})
+
+	Expect(fragsEntries()).To(Equal(1))
+	ctBefore := saveCTMap(ctMap)
+
+	// A trailing fragment has no UDP header.  It must find the ports of the first one and
+	// follow its conntrack entry, so even a policy that denies everything lets it through.
+	tail := *ipv4Default
+	tail.Flags = 0
+	tail.Id = 4321
+	tail.FragOffset = 3
+	payload := []byte("0123456789ABCDEF")
+	tail.Length = uint16(5*4 + len(payload))
+
+	pkt := gopacket.NewSerializeBuffer()
+	err = gopacket.SerializeLayers(pkt, gopacket.SerializeOptions{ComputeChecksums: true},
+		ethDefault, &tail, gopacket.Payload(payload))
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", denyAllRulesWorkloads, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pkt.Bytes())
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
+	})
+
+	Expect(saveCTMap(ctMap)).To(Equal(ctBefore))
+
+	// A trailing fragment of a datagram that we have not seen is subject to policy.
+	tail.Id = 1234
+	pkt = gopacket.NewSerializeBuffer()
+	err = gopacket.SerializeLayers(pkt, gopacket.SerializeOptions{ComputeChecksums: true},
+		ethDefault, &tail, gopacket.Payload(payload))
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", denyAllRulesWorkloads, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pkt.Bytes())
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
+	})
+}
@@ -17,6 +17,7 @@ package ut_test
 import (
 	"encoding/binary"
 	"fmt"
+	"math"
 	"net"
 	"testing"
 
@@ -24,6 +25,9 @@ import (
 	"github.com/google/gopacket/layers"
 	"github.com/google/netstack/tcpip/header"
 	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/icmp"
 )
 
 func TestICMPTooBig(t *testing.T) {
@@ -64,10 +68,62 @@ func TestICMPTooBigIPOptions(t *testing.T) {
 	runBpfUnitTest(t, "icmp_too_big.c", func(bpfrun bpfProgRunFn) {
 		res, err := bpfrun(pktBytes)
 		Expect(err).NotTo(HaveOccurred())
-		Expect(res.Retval).To(Equal(0xffffffff))
+		Expect(res.Retval).To(Equal(0))
+
+		// The reply quotes the original header with its options.
+		pktR := gopacket.NewPacket(res.dataOut, layers.LayerTypeEthernet, gopacket.Default)
+		icmpL := pktR.Layer(layers.LayerTypeICMPv4)
+		Expect(icmpL).NotTo(BeNil())
+		icmpR := icmpL.(*layers.ICMPv4)
+		Expect(icmpR.TypeCode).To(Equal(
+			layers.CreateICMPv4TypeCode(
+				layers.ICMPv4TypeDestinationUnreachable,
+				layers.ICMPv4CodeFragmentationNeeded,
+			)))
+
+		icmpData := gopacket.NewPacket(icmpR.Payload, layers.LayerTypeIPv4, gopacket.Default)
+		ipv4L := icmpData.Layer(layers.LayerTypeIPv4)
+		Expect(ipv4L).NotTo(BeNil())
+		Expect(ipv4L.(*layers.IPv4).IHL).To(Equal(uint8(6)))
+		Expect(ipv4L.(*layers.IPv4).SrcIP.String()).To(Equal(ipv4.SrcIP.String()))
 	})
 }
 
+func TestICMPTooBigRateLimited(t *testing.T) {
+	RegisterTestingT(t)
+
+	_, ipv4, _, _, pktBytes, err := testPacketUDPDefault()
+	Expect(err).NotTo(HaveOccurred())
+
+	rlMap := icmp.RateLimitMap(&bpf.MapContext{})
+	Expect(rlMap.EnsureExists()).To(Succeed())
+
+	rlKey := icmp.NewRateLimitKey(ipv4.SrcIP)
+	defer func() { _ = rlMap.Delete(rlKey[:]) }()
+
+	// An empty bucket that does not get any tokens before the end of time.
+	rlVal := icmp.NewRateLimitValue(math.MaxUint64, 0)
+	Expect(rlMap.Update(rlKey[:], rlVal[:])).To(Succeed())
+
+	runBpfUnitTest(t, "icmp_too_big.c", func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(0xffffffff))
+	}, withExtraMap(rlMap))
+
+	// Without a bucket, the first reply creates one with the full burst.
+	Expect(rlMap.Delete(rlKey[:])).To(Succeed())
+
+	runBpfUnitTest(t, "icmp_too_big.c", func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(0))
+
+		_, err = rlMap.Get(rlKey[:])
+		Expect(err).NotTo(HaveOccurred())
+	}, withExtraMap(rlMap))
+}
+
 func checkICMPTooBig(pktR gopacket.Packet, ipv4 *layers.IPv4, udp *layers.UDP, expMTU uint16) {
 	ipv4L := pktR.Layer(layers.LayerTypeIPv4)
 	Expect(ipv4L).NotTo(BeNil())
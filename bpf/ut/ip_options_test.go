@@ -15,11 +15,17 @@
 package ut_test
 
 import (
+	"fmt"
+	"net"
 	"testing"
 
+	"github.com/google/gopacket/layers"
 	. "github.com/onsi/gomega"
 
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
 	"github.com/projectcalico/felix/bpf/routes"
+	"github.com/projectcalico/felix/bpf/xdp"
 	"github.com/projectcalico/felix/ip"
 )
 
@@ -61,60 +67,127 @@ func TestIPOptions(t *testing.T) {
 
 	iphdr := *ipv4Default
 	iphdr.IHL = 6
+	// Router alert, as IGMP sets it.
+	iphdr.Options = []layers.IPv4Option{{OptionType: 148, OptionLength: 4, OptionData: []byte{0, 0}}}
 
-	_, _, _, _, pktBytes, err := testPacket(nil, &iphdr, nil, nil)
+	_, ipv4, l4, _, pktBytes, err := testPacket(nil, &iphdr, nil, nil)
 	Expect(err).NotTo(HaveOccurred())
+	udp := l4.(*layers.UDP)
 
-	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
-		res, err := bpfrun(pktBytes)
-		Expect(err).NotTo(HaveOccurred())
-		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
-	})
+	ctKey := conntrack.NewKey(uint8(ipv4.Protocol),
+		ipv4.SrcIP, uint16(udp.SrcPort), ipv4.DstIP, uint16(udp.DstPort))
 
-	runBpfTest(t, "calico_to_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+	// Insert a reverse route for the source workload.
+	defer resetRTMap(rtMap)
+	rtKey := routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal := routes.NewValueWithIfIndex(routes.FlagsLocalWorkload, 1).AsBytes()
+	err = rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
+
+	resetCTMap(ctMap)
+	defer resetCTMap(ctMap)
+
+	// The programs parse the UDP header past the options and track the flow.
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
 		res, err := bpfrun(pktBytes)
 		Expect(err).NotTo(HaveOccurred())
-		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
 
-	})
-	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
-		res, err := bpfrun(pktBytes)
+		ct, err := conntrack.LoadMapMem(ctMap)
 		Expect(err).NotTo(HaveOccurred())
-		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
+		Expect(ct).To(HaveKey(ctKey))
 	})
 
 	runBpfTest(t, "calico_to_host_ep", nil, func(bpfrun bpfProgRunFn) {
 		res, err := bpfrun(pktBytes)
 		Expect(err).NotTo(HaveOccurred())
 		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
+	})
+}
+
+func TestIPOptionsTooShort(t *testing.T) {
+	RegisterTestingT(t)
 
+	// The IHL claims more options than the packet has room for before the UDP header.
+	iphdr := *ipv4Default
+	iphdr.IHL = 15
+
+	_, _, _, _, pktBytes, err := testPacket(nil, &iphdr, nil, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
 	})
 }
+
 func TestIPOptionsWithHostIP(t *testing.T) {
 	RegisterTestingT(t)
 
 	iphdr := *ipv4Default
 	iphdr.IHL = 6
 	iphdr.DstIP = hostIP
+	iphdr.Options = []layers.IPv4Option{{OptionType: 148, OptionLength: 4, OptionData: []byte{0, 0}}}
 
 	_, _, _, _, pktBytes, err := testPacket(nil, &iphdr, nil, nil)
 	Expect(err).NotTo(HaveOccurred())
 
+	defer resetRTMap(rtMap)
 	rtKey := routes.NewKey(ip.CIDRFromNetIP(hostIP).(ip.V4CIDR)).AsBytes()
 	rtVal := routes.NewValueWithIfIndex(routes.FlagsLocalHost, 1).AsBytes()
 	err = rtMap.Update(rtKey, rtVal)
 	Expect(err).NotTo(HaveOccurred())
+	rtKey = routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal = routes.NewValueWithIfIndex(routes.FlagsLocalWorkload, 1).AsBytes()
+	err = rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
 
 	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
 		res, err := bpfrun(pktBytes)
 		Expect(err).NotTo(HaveOccurred())
-		Expect(res.RetvalStr()).To(Equal("TC_ACT_SHOT"), "expected program to return TC_ACT_SHOT")
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
 	})
 
 	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
 		res, err := bpfrun(pktBytes)
 		Expect(err).NotTo(HaveOccurred())
 		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
-
 	})
 }
+
+func TestIPOptionsSynCookie(t *testing.T) {
+	RegisterTestingT(t)
+
+	// A listener for the SYN cookies to be issued for.
+	l, err := net.Listen("tcp4", ":0")
+	Expect(err).NotTo(HaveOccurred())
+	defer l.Close()
+	port := uint16(l.Addr().(*net.TCPAddr).Port)
+
+	scMap := xdp.SynCookiePortsMap(&bpf.MapContext{})
+	Expect(scMap.EnsureExists()).To(Succeed())
+	k, v := xdp.SynCookiePortKeyValue(port)
+	Expect(scMap.Update(k, v)).To(Succeed())
+	defer func() { _ = scMap.Delete(k) }()
+
+	tcpSyn := &layers.TCP{
+		SrcPort:    54321,
+		DstPort:    layers.TCPPort(port),
+		SYN:        true,
+		DataOffset: 5,
+	}
+
+	iphdr := *ipv4Default
+	iphdr.IHL = 6
+	iphdr.Options = []layers.IPv4Option{{OptionType: 148, OptionLength: 4, OptionData: []byte{0, 0}}}
+	_, _, _, _, pktBytes, err := testPacket(nil, &iphdr, tcpSyn, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	// The SYN-ACK would be built over a 20-byte header, the SYN goes to the stack instead.
+	runBpfXDPTest(t, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resXDP_PASS), fmt.Sprintf("expected XDP_PASS, got %d", res.Retval))
+	}, scMap)
+}
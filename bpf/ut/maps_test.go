@@ -90,6 +90,55 @@ func TestMapIterationDeleteAfter(t *testing.T) {
 	Expect(err2).NotTo(HaveOccurred(), "Failed to delete map entry")
 }
 
+func TestMapIterDeleteManyBatched(t *testing.T) {
+	RegisterTestingT(t)
+	defer cleanUpMaps()
+
+	// Enough entries to span several lookup and delete batches.
+	const n = 3*bpf.MapIteratorBatchNumKeys + 17
+	for i := 0; i < n; i++ {
+		var k conntrack.Key
+		var v conntrack.Value
+		binary.LittleEndian.PutUint32(k[:], uint32(i))
+		err := ctMap.Update(k.AsBytes(), v[:])
+		Expect(err).NotTo(HaveOccurred())
+	}
+
+	seen := map[uint32]bool{}
+	err := ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		idx := binary.LittleEndian.Uint32(k)
+		Expect(seen[idx]).To(BeFalse(), "Saw same key twice")
+		seen[idx] = true
+		if idx%2 == 0 {
+			return bpf.IterDelete
+		}
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(seen).To(HaveLen(n))
+
+	remaining := 0
+	err = ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		idx := binary.LittleEndian.Uint32(k)
+		Expect(idx%2).To(Equal(uint32(1)), "Saw key that should have been deleted")
+		remaining++
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(remaining).To(Equal(n / 2))
+
+	err = bpf.DeleteAll(ctMap)
+	Expect(err).NotTo(HaveOccurred())
+
+	remaining = 0
+	err = ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		remaining++
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+	Expect(remaining).To(BeZero())
+}
+
 func setUpMapTestWithSingleKV(t *testing.T) (conntrack.Key, error) {
 	RegisterTestingT(t)
 	k := conntrack.NewKey(1, net.ParseIP("10.0.0.1"), 51234, net.ParseIP("10.0.0.2"), 8080)
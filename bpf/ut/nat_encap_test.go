@@ -15,7 +15,9 @@
 package ut_test
 
 import (
+	"encoding/binary"
 	"fmt"
+	"net"
 	"testing"
 
 	"github.com/google/gopacket"
@@ -44,6 +46,10 @@ func TestNatEncap(t *testing.T) {
 
 		checkVxlanEncap(pktR, true, ipv4, udp, payload)
 
+		udpR := pktR.Layer(layers.LayerTypeUDP).(*layers.UDP)
+		Expect(uint16(udpR.SrcPort)).To(Equal(vxlanSrcPort(ipv4.SrcIP, ipv4.DstIP,
+			uint8(layers.IPProtocolUDP), uint16(udp.SrcPort), uint16(udp.DstPort))))
+
 		ipv4L := pktR.Layer(layers.LayerTypeIPv4)
 		ipv4R := ipv4L.(*layers.IPv4)
 		Expect(ipv4R).To(layersMatchFields(ipv4, "Length", "SrcIP", "Checksum"))
@@ -88,7 +94,7 @@ func checkVxlan(pktR gopacket.Packet) gopacket.Packet {
 	udpL := pktR.Layer(layers.LayerTypeUDP)
 	Expect(udpL).NotTo(BeNil())
 	udpR := udpL.(*layers.UDP)
-	Expect(udpR.SrcPort).To(Equal(layers.UDPPort(testVxlanPort)))
+	checkVxlanSrcPort(udpR)
 	Expect(udpR.DstPort).To(Equal(layers.UDPPort(testVxlanPort)))
 	Expect(udpR.Checksum).To(Equal(uint16(0)))
 
@@ -112,6 +118,31 @@ func checkVxlan(pktR gopacket.Packet) gopacket.Packet {
 	return gopacket.NewPacket(ethL.LayerPayload(), layers.LayerTypeIPv4, gopacket.Default)
 }
 
+// checkVxlanSrcPort checks that the outer source port is from the flow hash, within the ephemeral
+// range, see vxlan_src_port() in bpf-gpl/nat.h.
+func checkVxlanSrcPort(udpR *layers.UDP) {
+	Expect(udpR.SrcPort).To(BeNumerically(">=", 32768))
+	Expect(udpR.SrcPort).To(BeNumerically("<", 61000))
+}
+
+// vxlanSrcPort is the Go version of vxlan_src_port() in bpf-gpl/nat.h.
+func vxlanSrcPort(src, dst net.IP, proto uint8, sport, dport uint16) uint16 {
+	mix := func(h uint32) uint32 {
+		h ^= h >> 16
+		h *= 0x85ebca6b
+		h ^= h >> 13
+		h *= 0xc2b2ae35
+		h ^= h >> 16
+		return h
+	}
+
+	h := mix((uint32(sport)<<16 | uint32(dport)) ^ uint32(proto))
+	h = mix(h ^ binary.LittleEndian.Uint32(dst.To4()))
+	h = mix(h ^ binary.LittleEndian.Uint32(src.To4()))
+
+	return 32768 + uint16((uint64(h)*(61000-32768))>>32)
+}
+
 func encapedResponse(pktR gopacket.Packet) []byte {
 	ethL := pktR.Layer(layers.LayerTypeEthernet)
 	Expect(ethL).NotTo(BeNil())
@@ -127,6 +158,8 @@ func encapedResponse(pktR gopacket.Packet) []byte {
 	Expect(udpL).NotTo(BeNil())
 	udpR := udpL.(*layers.UDP)
 	udpR.Checksum = 0
+	// The other side picks its own source port, which need not be the VXLAN port.
+	udpR.DstPort = layers.UDPPort(testVxlanPort)
 
 	payloadL := pktR.ApplicationLayer()
 	Expect(payloadL).NotTo(BeNil())
@@ -154,7 +187,7 @@ func getVxlanVNI(pktR gopacket.Packet) uint32 {
 	udpL := pktR.Layer(layers.LayerTypeUDP)
 	Expect(udpL).NotTo(BeNil())
 	udpR := udpL.(*layers.UDP)
-	Expect(udpR.SrcPort).To(Equal(layers.UDPPort(testVxlanPort)))
+	checkVxlanSrcPort(udpR)
 	Expect(udpR.DstPort).To(Equal(layers.UDPPort(testVxlanPort)))
 	Expect(udpR.Checksum).To(Equal(uint16(0)))
 
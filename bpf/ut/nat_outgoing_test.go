@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"testing"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+func TestNATOutgoingSNAT(t *testing.T) {
+	RegisterTestingT(t)
+
+	const snatPortMin, snatPortMax = 61000, 61009
+
+	_, ipv4, l4, _, pktBytes, err := testPacket(nil, nil, nil, nil)
+	Expect(err).NotTo(HaveOccurred())
+	udp := l4.(*layers.UDP)
+
+	hostIP = node1ip
+	defer func() { hostIP = node1ip }()
+
+	defer resetRTMap(rtMap)
+	rtKey := routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal := routes.NewValueWithIfIndex(
+		routes.FlagsLocalWorkload|routes.FlagInIPAMPool|routes.FlagNATOutgoing, 1).AsBytes()
+	err = rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
+
+	resetCTMap(ctMap)
+	defer resetCTMap(ctMap)
+
+	// The destination is not in a pool, the program SNATs the flow to the host IP and a port
+	// in the range.
+	var snatPort uint16
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.RetvalStr()).To(Equal("TC_ACT_UNSPEC"), "expected program to return TC_ACT_UNSPEC")
+
+		pktR := gopacket.NewPacket(res.dataOut, layers.LayerTypeEthernet, gopacket.Default)
+		ipv4R := pktR.Layer(layers.LayerTypeIPv4).(*layers.IPv4)
+		udpR := pktR.Layer(layers.LayerTypeUDP).(*layers.UDP)
+
+		Expect(ipv4R.SrcIP.String()).To(Equal(node1ip.String()))
+		Expect(ipv4R.DstIP.String()).To(Equal(ipv4.DstIP.String()))
+		Expect(udpR.DstPort).To(Equal(udp.DstPort))
+		snatPort = uint16(udpR.SrcPort)
+		Expect(snatPort).To(BeNumerically(">=", snatPortMin))
+		Expect(snatPort).To(BeNumerically("<=", snatPortMax))
+	}, withNATOutgoingSNAT(snatPortMin, snatPortMax))
+
+	ct, err := conntrack.LoadMapMem(ctMap)
+	Expect(err).NotTo(HaveOccurred())
+
+	fwdKey := conntrack.NewKey(uint8(ipv4.Protocol), ipv4.SrcIP, uint16(udp.SrcPort), ipv4.DstIP, uint16(udp.DstPort))
+	revKey := conntrack.NewKey(uint8(ipv4.Protocol), node1ip, snatPort, ipv4.DstIP, uint16(udp.DstPort))
+
+	Expect(ct).To(HaveKey(fwdKey))
+	Expect(ct[fwdKey].Type()).To(Equal(conntrack.TypeNATForward))
+	Expect(ct[fwdKey].Flags() & conntrack.FlagSNAT).NotTo(BeZero())
+	Expect(ct[fwdKey].ReverseNATKey()).To(Equal(revKey))
+
+	Expect(ct).To(HaveKey(revKey))
+	Expect(ct[revKey].Type()).To(Equal(conntrack.TypeNATReverse))
+	Expect(ct[revKey].Flags() & conntrack.FlagSNAT).NotTo(BeZero())
+	Expect(ct[revKey].OrigIP().String()).To(Equal(ipv4.SrcIP.String()))
+	Expect(ct[revKey].OrigPort()).To(Equal(uint16(udp.SrcPort)))
+
+	// The reply arrives at the host endpoint, addressed to the host, and goes back to the
+	// workload.
+	respPkt := gopacket.NewPacket(pktBytes, layers.LayerTypeEthernet, gopacket.Default)
+	respIPv4 := respPkt.Layer(layers.LayerTypeIPv4).(*layers.IPv4)
+	respUDP := respPkt.Layer(layers.LayerTypeUDP).(*layers.UDP)
+	respIPv4.SrcIP = node1ip
+	respUDP.SrcPort = layers.UDPPort(snatPort)
+	_ = respUDP.SetNetworkLayerForChecksum(respIPv4)
+	snatted := gopacket.NewSerializeBuffer()
+	err = gopacket.SerializePacket(snatted, gopacket.SerializeOptions{ComputeChecksums: true}, respPkt)
+	Expect(err).NotTo(HaveOccurred())
+	reply := udpResposeRaw(snatted.Bytes())
+
+	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(reply)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		pktR := gopacket.NewPacket(res.dataOut, layers.LayerTypeEthernet, gopacket.Default)
+		ipv4R := pktR.Layer(layers.LayerTypeIPv4).(*layers.IPv4)
+		udpR := pktR.Layer(layers.LayerTypeUDP).(*layers.UDP)
+
+		Expect(ipv4R.SrcIP.String()).To(Equal(ipv4.DstIP.String()))
+		Expect(ipv4R.DstIP.String()).To(Equal(ipv4.SrcIP.String()))
+		Expect(udpR.SrcPort).To(Equal(udp.DstPort))
+		Expect(udpR.DstPort).To(Equal(udp.SrcPort))
+	}, withNATOutgoingSNAT(snatPortMin, snatPortMax))
+}
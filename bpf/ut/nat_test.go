@@ -26,7 +26,6 @@ import (
 	"github.com/google/gopacket/layers"
 	. "github.com/onsi/gomega"
 
-	"github.com/projectcalico/felix/bpf/arp"
 	"github.com/projectcalico/felix/bpf/conntrack"
 	"github.com/projectcalico/felix/bpf/nat"
 	"github.com/projectcalico/felix/bpf/routes"
@@ -495,15 +494,15 @@ func TestNATNodePort(t *testing.T) {
 	Expect(v.Type()).To(Equal(conntrack.TypeNATReverse))
 	Expect(v.Flags()).To(Equal(conntrack.FlagExtLocal))
 
-	dumpARPMap(arpMap)
-
+	// The conntrack entry records the MACs of the tunnel next hop, the decap doesn't write them
+	// to the ARP map.
 	arpMapN2 = saveARPMap(arpMap)
-	Expect(arpMapN2).To(HaveLen(1))
-	arpKey := arp.NewKey(node1ip, 1 /* ifindex is always 1 in UT */)
-	Expect(arpMapN2).To(HaveKey(arpKey))
+	Expect(arpMapN2).To(HaveLen(0))
 	macDst := encapedPkt[0:6]
 	macSrc := encapedPkt[6:12]
-	Expect(arpMapN2[arpKey]).To(Equal(arp.NewValue(macDst, macSrc)))
+	tunMACSrc, tunMACDst := v.TunnelMACs()
+	Expect(tunMACSrc).To(Equal(net.HardwareAddr(macDst)))
+	Expect(tunMACDst).To(Equal(net.HardwareAddr(macSrc)))
 
 	// try a spoofed tunnel packet, should be dropped and have no effect
 	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
@@ -1006,6 +1005,72 @@ func TestNATNodePortNoFWD(t *testing.T) {
 	dumpCTMap(ctMap)
 }
 
+// TestNATNodePortAnyHostIP checks that a single NodePort frontend covers all the addresses of the
+// host and that the frontend for the other hosts does not apply to them.
+func TestNATNodePortAnyHostIP(t *testing.T) {
+	RegisterTestingT(t)
+
+	bpfIfaceName = "NPAH"
+	defer func() { bpfIfaceName = "" }()
+
+	_, ipv4, l4, _, pktBytes, err := testPacketUDPDefaultNP(node1ip2)
+	Expect(err).NotTo(HaveOccurred())
+	udp := l4.(*layers.UDP)
+
+	defer resetMap(natMap)
+	defer resetMap(natBEMap)
+	err = natBEMap.Update(
+		nat.NewNATBackendKey(0, 0).AsBytes(),
+		nat.NewNATBackendValue(net.IPv4(8, 8, 8, 8), 666).AsBytes(),
+	)
+	Expect(err).NotTo(HaveOccurred())
+
+	defer resetRTMap(rtMap)
+	err = rtMap.Update(
+		routes.NewKey(ip.CIDRFromAddrAndPrefix(ip.FromNetIP(node1ip2), 32).(ip.V4CIDR)).AsBytes(),
+		routes.NewValue(routes.FlagsLocalHost).AsBytes(),
+	)
+	Expect(err).NotTo(HaveOccurred())
+
+	hostIP = node1ip
+	skbMark = 0
+
+	ctKey := conntrack.NewKey(uint8(ipv4.Protocol),
+		ipv4.SrcIP, uint16(udp.SrcPort), ipv4.DstIP, uint16(udp.DstPort))
+
+	for _, c := range []struct {
+		addr net.IP
+		nat  bool
+	}{
+		{nat.NodePortRemoteHostsIP, false},
+		{nat.NodePortLocalHostIP, true},
+	} {
+		resetMap(natMap)
+		resetCTMap(ctMap)
+		err = natMap.Update(
+			nat.NewNATKey(c.addr, uint16(udp.DstPort), uint8(ipv4.Protocol)).AsBytes(),
+			nat.NewNATValue(0, 1, 0, 0).AsBytes(),
+		)
+		Expect(err).NotTo(HaveOccurred())
+
+		runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
+			res, err := bpfrun(pktBytes)
+			Expect(err).NotTo(HaveOccurred())
+			Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+			ct, err := conntrack.LoadMapMem(ctMap)
+			Expect(err).NotTo(HaveOccurred())
+			Expect(ct).Should(HaveKey(ctKey))
+			if c.nat {
+				Expect(ct[ctKey].Type()).To(Equal(conntrack.TypeNATForward))
+			} else {
+				Expect(ct[ctKey].Type()).To(Equal(conntrack.TypeNormal))
+			}
+		})
+	}
+	resetCTMap(ctMap)
+}
+
 func TestNATNodePortMultiNIC(t *testing.T) {
 	RegisterTestingT(t)
 
@@ -1441,6 +1506,87 @@ func TestNATSYNRetryGoesToSameBackend(t *testing.T) {
 	})
 }
 
+func TestNATMaglevPicksTableBackend(t *testing.T) {
+	RegisterTestingT(t)
+
+	mc := &bpf.MapContext{}
+	natMap := nat.FrontendMap(mc)
+	err := natMap.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+
+	natBEMap := nat.BackendMap(mc)
+	err = natBEMap.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+
+	maglevMap := nat.MaglevMap(mc)
+	err = maglevMap.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+
+	ctMap := conntrack.Map(mc)
+	err = ctMap.EnsureExists()
+	Expect(err).NotTo(HaveOccurred())
+	defer resetCTMap(ctMap)
+
+	tcpSyn := &layers.TCP{
+		SrcPort:    54321,
+		DstPort:    7890,
+		SYN:        true,
+		DataOffset: 5,
+	}
+
+	_, ipv4, _, _, _, err := testPacket(nil, nil, tcpSyn, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	err = natMap.Update(
+		nat.NewNATKey(ipv4.DstIP, uint16(tcpSyn.DstPort), uint8(ipv4.Protocol)).AsBytes(),
+		nat.NewNATValue(0, 2, 0, 0).AsBytes(),
+	)
+	Expect(err).NotTo(HaveOccurred())
+
+	natIPs := []net.IP{net.IPv4(192, 0, 0, 1), net.IPv4(192, 0, 0, 2)}
+	natPort := uint16(666)
+	for i, natIP := range natIPs {
+		err = natBEMap.Update(
+			nat.NewNATBackendKey(0, uint32(i)).AsBytes(),
+			nat.NewNATBackendValue(natIP, natPort).AsBytes(),
+		)
+		Expect(err).NotTo(HaveOccurred())
+	}
+
+	// A table that points all the slots to the second backend.
+	for slot := uint32(0); slot < nat.MaglevTableSize; slot++ {
+		err = maglevMap.Update(nat.NewMaglevKey(0, slot).AsBytes(), nat.NewMaglevValue(1).AsBytes())
+		Expect(err).NotTo(HaveOccurred())
+	}
+	defer func() {
+		for slot := uint32(0); slot < nat.MaglevTableSize; slot++ {
+			_ = maglevMap.Delete(nat.NewMaglevKey(0, slot).AsBytes())
+		}
+	}()
+
+	// Insert a reverse route for the source workload.
+	rtKey := routes.NewKey(srcV4CIDR).AsBytes()
+	rtVal := routes.NewValueWithIfIndex(routes.FlagsLocalWorkload, 1).AsBytes()
+	defer resetRTMap(rtMap)
+	err = rtMap.Update(rtKey, rtVal)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+		for attempt := 0; attempt < 20; attempt++ {
+			resetCTMap(ctMap)
+			tcpSyn.SrcPort++
+			_, _, _, _, synPkt, err := testPacket(nil, nil, tcpSyn, nil)
+			Expect(err).NotTo(HaveOccurred())
+			res, err := bpfrun(synPkt)
+			Expect(err).NotTo(HaveOccurred())
+			Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+			pktR := gopacket.NewPacket(res.dataOut, layers.LayerTypeEthernet, gopacket.Default)
+			ipv4L := pktR.Layer(layers.LayerTypeIPv4).(*layers.IPv4)
+			Expect(ipv4L.DstIP.Equal(natIPs[1])).To(BeTrue(), "new flows should follow the Maglev table")
+		}
+	})
+}
+
 func TestNATAffinity(t *testing.T) {
 	RegisterTestingT(t)
 
@@ -1529,6 +1675,15 @@ func TestNATAffinity(t *testing.T) {
 		Expect(aff).To(HaveKey(affKey))
 		affEntry = aff[affKey]
 		Expect(affEntry.Backend()).To(Equal(nat.NewNATBackendValue(natIP, natPort)))
+
+		// The program reads the clock once per packet, the conntrack entries of the flow
+		// carry the same timestamp as the affinity.
+		ct, err := conntrack.LoadMapMem(ctMap)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(ct).NotTo(BeEmpty())
+		for _, v := range ct {
+			Expect(v.Created()).To(Equal(int64(affEntry.Timestamp())))
+		}
 	})
 	resetCTMap(ctMap)
 
@@ -1604,6 +1759,35 @@ func TestNATAffinity(t *testing.T) {
 		Expect(affEntry.Backend()).To(Equal(nat.NewNATBackendValue(natIP2, natPort2)))
 	})
 	resetCTMap(ctMap)
+
+	// replace the backend and move the generation of the frontend on, the affinity has not
+	// expired yet but it is of an older generation so a new selection is made
+	err = natMap.Update(
+		nat.NewNATKey(ipv4.DstIP, uint16(udp.DstPort), uint8(ipv4.Protocol)).AsBytes(),
+		nat.NewNATValueWithAffinityGen(0, 1, 0, 1 /* second */, 0, 1).AsBytes(),
+	)
+	Expect(err).NotTo(HaveOccurred())
+
+	err = natBEMap.Update(
+		nat.NewNATBackendKey(0, 0).AsBytes(),
+		nat.NewNATBackendValue(natIP, natPort).AsBytes(),
+	)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_from_workload_ep", rulesDefaultAllow, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		aff, err := nat.LoadAffinityMap(natAffMap)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(aff).To(HaveLen(1))
+		Expect(aff).To(HaveKey(affKey))
+		affEntry = aff[affKey]
+		Expect(affEntry.Backend()).To(Equal(nat.NewNATBackendValue(natIP, natPort)))
+		Expect(affEntry.Gen()).To(Equal(uint32(1)))
+	})
+	resetCTMap(ctMap)
 }
 
 func TestNATNodePortIngressDSR(t *testing.T) {
@@ -1692,3 +1876,33 @@ func TestNATNodePortIngressDSR(t *testing.T) {
 	Expect(v.Type()).To(Equal(conntrack.TypeNATReverse))
 	Expect(v.Flags()).To(Equal(conntrack.FlagNATFwdDsr | conntrack.FlagNATNPFwd))
 }
+
+func TestNATServiceCountersNoBackend(t *testing.T) {
+	RegisterTestingT(t)
+
+	resetMap(svcCtrsMap)
+	defer resetMap(svcCtrsMap)
+
+	_, ipv4, l4, _, pktBytes, err := testPacketUDPDefault()
+	Expect(err).NotTo(HaveOccurred())
+	udp := l4.(*layers.UDP)
+
+	const svcID = 7
+	natkey := nat.NewNATKey(ipv4.DstIP, uint16(udp.DstPort), uint8(ipv4.Protocol)).AsBytes()
+	err = natMap.Update(natkey, nat.NewNATValue(svcID, 0, 0, 0).AsBytes())
+	Expect(err).NotTo(HaveOccurred())
+	defer func() {
+		err := natMap.Delete(natkey)
+		Expect(err).NotTo(HaveOccurred())
+	}()
+
+	runBpfTest(t, "calico_from_host_ep", nil, func(bpfrun bpfProgRunFn) {
+		_, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+	}, withServiceCounters())
+
+	ctrs, err := nat.ReadServiceCounters(svcCtrsMap, svcID)
+	Expect(err).NotTo(HaveOccurred())
+	Expect(ctrs[nat.ServiceNoBackend]).To(Equal(uint64(1)))
+	Expect(ctrs[nat.ServiceNewFlows]).To(Equal(uint64(0)))
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"encoding/binary"
+	"testing"
+
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/polcache"
+	"github.com/projectcalico/felix/bpf/polprog"
+	"github.com/projectcalico/felix/bpf/tc"
+	"github.com/projectcalico/felix/proto"
+)
+
+var rulesAllowUDPDstPort = &polprog.Rules{
+	Tiers: []polprog.Tier{{
+		Name: "base tier",
+		Policies: []polprog.Policy{{
+			Name: "allow udp",
+			Rules: []polprog.Rule{{Rule: &proto.Rule{
+				Action:   "Allow",
+				Protocol: &proto.Protocol{NumberOrName: &proto.Protocol_Name{Name: "udp"}},
+				DstPorts: []*proto.PortRange{{First: 5678, Last: 5678}},
+			}}},
+		}},
+	}},
+}
+
+func TestPolicyVerdictCache(t *testing.T) {
+	RegisterTestingT(t)
+
+	bpfIfaceName = "PVC"
+	defer func() { bpfIfaceName = "" }()
+	defer cleanUpMaps()
+
+	defer func(mark uint32) { skbMark = mark }(skbMark)
+	skbMark = tc.MarkSeen
+
+	resetCTMap(ctMap)
+	resetMap(polVCMap)
+
+	_, _, _, _, pktBytes, err := testPacketUDPDefault()
+	Expect(err).NotTo(HaveOccurred())
+
+	gen := polcache.NewGeneration(polGenMap)
+
+	runBpfTest(t, "calico_to_workload_ep", rulesAllowUDPDstPort, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+	}, withPolicyCache())
+
+	Expect(polCacheGenerations()).To(ConsistOf(polCacheGeneration()),
+		"allow verdict should have been cached in the current generation")
+
+	// With a policy that denies everything, a new flow from another source port is still allowed
+	// because its verdict comes from the cache.
+	resetCTMap(ctMap)
+	udp := *udpDefault
+	udp.SrcPort = 4321
+	_, _, _, _, pktBytes, err = testPacket(nil, nil, &udp, nil)
+	Expect(err).NotTo(HaveOccurred())
+
+	runBpfTest(t, "calico_to_workload_ep", &polprog.Rules{}, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+
+		// Once the generation is bumped, the cached verdict is ignored.
+		resetCTMap(ctMap)
+		Expect(gen.Bump()).To(Succeed())
+
+		res, err = bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_SHOT))
+	}, withPolicyCache())
+}
+
+func TestPolicyVerdictCacheSrcPortMatch(t *testing.T) {
+	RegisterTestingT(t)
+
+	bpfIfaceName = "PVCs"
+	defer func() { bpfIfaceName = "" }()
+	defer cleanUpMaps()
+
+	defer func(mark uint32) { skbMark = mark }(skbMark)
+	skbMark = tc.MarkSeen
+
+	resetCTMap(ctMap)
+	resetMap(polVCMap)
+
+	_, _, _, _, pktBytes, err := testPacketUDPDefault()
+	Expect(err).NotTo(HaveOccurred())
+
+	rules := &polprog.Rules{
+		Tiers: []polprog.Tier{{
+			Name: "base tier",
+			Policies: []polprog.Policy{{
+				Name: "allow udp from port",
+				Rules: []polprog.Rule{{Rule: &proto.Rule{
+					Action:   "Allow",
+					Protocol: &proto.Protocol{NumberOrName: &proto.Protocol_Name{Name: "udp"}},
+					SrcPorts: []*proto.PortRange{{First: 1234, Last: 1234}},
+				}}},
+			}},
+		}},
+	}
+
+	runBpfTest(t, "calico_to_workload_ep", rules, func(bpfrun bpfProgRunFn) {
+		res, err := bpfrun(pktBytes)
+		Expect(err).NotTo(HaveOccurred())
+		Expect(res.Retval).To(Equal(resTC_ACT_UNSPEC))
+	}, withPolicyCache())
+
+	Expect(polCacheGenerations()).To(BeEmpty(),
+		"verdicts of policy that matches on the source port must not be cached")
+}
+
+func polCacheGenerations() []uint32 {
+	var gens []uint32
+	err := polVCMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		gens = append(gens, binary.LittleEndian.Uint32(v))
+		return bpf.IterNone
+	})
+	Expect(err).NotTo(HaveOccurred())
+	return gens
+}
+
+func polCacheGeneration() uint32 {
+	v, err := polGenMap.Get(make([]byte, 4))
+	Expect(err).NotTo(HaveOccurred())
+	return binary.LittleEndian.Uint32(v)
+}
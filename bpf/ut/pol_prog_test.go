@@ -31,6 +31,8 @@ import (
 	"github.com/projectcalico/felix/bpf/polprog"
 	"github.com/projectcalico/felix/bpf/state"
 	"github.com/projectcalico/felix/idalloc"
+	felixipsets "github.com/projectcalico/felix/ipsets"
+	"github.com/projectcalico/felix/logutils"
 	"github.com/projectcalico/felix/proto"
 )
 
@@ -1408,13 +1410,65 @@ func wrap(p polProgramTest) polProgramTestWrapper {
 
 func TestPolicyPrograms(t *testing.T) {
 	for i, p := range polProgramTests {
-		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p)) })
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsPerSet, false, 0) })
+	}
+}
+
+func TestPolicyProgramsExactIPSets(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsExact, false, 0) })
+	}
+}
+
+func TestPolicyProgramsAggregatedIPSets(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsAggregated, false, 0) })
+	}
+}
+
+func TestPolicyProgramsMemberIPSets(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsMembers, false, 0) })
+	}
+}
+
+// splitTestMaxInsns is small enough to split the bigger test policies into several programs while
+// keeping all of them within MaxPolicyContinuations.
+const splitTestMaxInsns = 100
+
+func TestPolicyProgramsSplit(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) {
+			runTest(t, wrap(p), ipSetsPerSet, false, splitTestMaxInsns)
+		})
+	}
+}
+
+func TestPolicyProgramsGrouped(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsPerSet, true, 0) })
+	}
+}
+
+func TestPolicyProgramsGroupedSplit(t *testing.T) {
+	for i, p := range polProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) {
+			runTest(t, wrap(p), ipSetsPerSet, true, splitTestMaxInsns)
+		})
 	}
 }
 
 func TestHostPolicyPrograms(t *testing.T) {
 	for i, p := range hostPolProgramTests {
-		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p)) })
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) { runTest(t, wrap(p), ipSetsPerSet, false, 0) })
+	}
+}
+
+func TestHostPolicyProgramsSplit(t *testing.T) {
+	for i, p := range hostPolProgramTests {
+		t.Run(fmt.Sprintf("%d:Policy=%s", i, p.PolicyName), func(t *testing.T) {
+			runTest(t, wrap(p), ipSetsPerSet, false, splitTestMaxInsns)
+		})
 	}
 }
 
@@ -1531,8 +1585,10 @@ func (p packet) MatchStateOut(stateOut state.State) {
 	// Zero parts we do not care about
 
 	expectedStateOut.PolicyRC = 0 // PolicyRC tested by the caller
+	expectedStateOut.PolicyResume = 0
 
 	stateOut.PolicyRC = 0
+	stateOut.PolicyResume = 0 // Scratch space for split policy programs.
 
 	Expect(stateOut).To(Equal(expectedStateOut), "policy program modified unexpected parts of the state")
 }
@@ -1563,7 +1619,26 @@ type testCase interface {
 	MatchStateOut(stateOut state.State)
 }
 
-func runTest(t *testing.T, tp testPolicy) {
+// ipSetsMode is the way that runTest stores the IP sets of the test policy.
+type ipSetsMode int
+
+const (
+	// ipSetsPerSet writes each member of each IP set to the LPM map.
+	ipSetsPerSet ipSetsMode = iota
+	// ipSetsExact also writes the full-length members to the exact-match map and looks up the IP
+	// sets that have no prefixes there.
+	ipSetsExact
+	// ipSetsAggregated programs the IP sets through the BPF IP sets dataplane, which aggregates
+	// the members in the LPM map.
+	ipSetsAggregated
+	// ipSetsMembers programs the IP sets through the BPF IP sets dataplane with the member map.
+	ipSetsMembers
+)
+
+// runTest runs the test policy; if maxInsns is non-zero, the policy is split into a chain of
+// programs of about that size.  If groupRules is set, the policy is built with
+// Builder.EnableRuleGrouping.
+func runTest(t *testing.T, tp testPolicy, mode ipSetsMode, groupRules bool, maxInsns int) {
 	RegisterTestingT(t)
 
 	// The prog builder refuses to allocate IDs as a precaution, give it an allocator that forces allocations.
@@ -1574,22 +1649,65 @@ func runTest(t *testing.T, tp testPolicy) {
 	cleanIPSetMap()
 	// FIXME should clean up the maps at the end of each test but recreating the maps seems to be racy
 
-	setUpIPSets(tp.IPSets(), realAlloc, ipsMap)
-
 	// Build the program.
 	pg := polprog.NewBuilder(forceAlloc, ipsMap.MapFD(), testStateMap.MapFD(), jumpMap.MapFD())
-	insns, err := pg.Instructions(tp.Policy())
-	Expect(err).NotTo(HaveOccurred(), "failed to assemble program")
+	switch mode {
+	case ipSetsPerSet, ipSetsExact:
+		exactness := setUpIPSets(tp.IPSets(), realAlloc, ipsMap)
+		if mode == ipSetsExact {
+			pg.EnableExactIPSets(exactness, ipsExactMap.MapFD())
+		}
+	case ipSetsAggregated:
+		dpIPSets := setUpDataplaneIPSets(tp.IPSets(), realAlloc, nil)
+		pg.EnableExactIPSets(dpIPSets, ipsExactMap.MapFD())
+	case ipSetsMembers:
+		dpIPSets := setUpDataplaneIPSets(tp.IPSets(), realAlloc, ipsMembersMap)
+		pg.EnableExactIPSets(dpIPSets, ipsExactMap.MapFD())
+		pg.EnableMemberIPSets(dpIPSets, ipsMembersMap.MapFD())
+	}
+	if groupRules {
+		pg.EnableRuleGrouping()
+	}
+	var progs []asm.Insns
+	if maxInsns > 0 {
+		pg.SetMaxInsnsPerProgram(maxInsns)
+		var err error
+		progs, err = pg.Programs(tp.Policy())
+		Expect(err).NotTo(HaveOccurred(), "failed to assemble programs")
+	} else {
+		insns, err := pg.Instructions(tp.Policy())
+		Expect(err).NotTo(HaveOccurred(), "failed to assemble program")
+		progs = []asm.Insns{insns}
+	}
 
-	// Load the program into the kernel.  We don't pin it so it'll be removed when the
-	// test process exits (or by the defer).
-	polProgFD, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
-	Expect(err).NotTo(HaveOccurred(), "failed to load program into the kernel")
-	Expect(polProgFD).NotTo(BeZero())
+	// Load the programs into the kernel.  We don't pin them so they'll be removed when the
+	// test process exits (or by the defer).  The continuations of a split program go in the
+	// jump map, we run the first one directly.
+	var progFDs []bpf.ProgFD
 	defer func() {
-		err := polProgFD.Close()
-		Expect(err).NotTo(HaveOccurred())
+		for i, fd := range progFDs {
+			if i > 0 {
+				k := make([]byte, 4)
+				binary.LittleEndian.PutUint32(k, uint32(polprog.PolicyJumpIndex(i)))
+				Expect(jumpMap.Delete(k)).NotTo(HaveOccurred())
+			}
+			Expect(fd.Close()).NotTo(HaveOccurred())
+		}
 	}()
+	for i, insns := range progs {
+		fd, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
+		Expect(err).NotTo(HaveOccurred(), "failed to load program into the kernel")
+		Expect(fd).NotTo(BeZero())
+		progFDs = append(progFDs, fd)
+		if i > 0 {
+			k := make([]byte, 4)
+			v := make([]byte, 4)
+			binary.LittleEndian.PutUint32(k, uint32(polprog.PolicyJumpIndex(i)))
+			binary.LittleEndian.PutUint32(v, uint32(fd))
+			Expect(jumpMap.Update(k, v)).NotTo(HaveOccurred())
+		}
+	}
+	polProgFD := progFDs[0]
 
 	// Give the policy program somewhere to jump to.
 	epiFD := installEpilogueProgram(jumpMap)
@@ -1662,30 +1780,80 @@ func runProgram(tc testCase, stateMap bpf.Map, progFD bpf.ProgFD, expProgRC int,
 	tc.MatchStateOut(stateOut)
 }
 
-func setUpIPSets(ipSets map[string][]string, alloc *idalloc.IDAllocator, ipsMap bpf.Map) {
+// testExactIPSets records which of the test IP sets have only full-length members.
+type testExactIPSets map[uint64]bool
+
+func (e testExactIPSets) IPSetIsExact(id uint64) bool {
+	return e[id]
+}
+
+// setUpIPSets writes the IP sets to the LPM map and their full-length members to the exact-match
+// map, the same way the BPF IP sets dataplane does.
+func setUpIPSets(ipSets map[string][]string, alloc *idalloc.IDAllocator, ipsMap bpf.Map) testExactIPSets {
+	exactness := testExactIPSets{}
 	for name, members := range ipSets {
 		id := alloc.GetOrAlloc(name)
+		exactness[id] = true
 		for _, m := range members {
 			entry := ipsets.ProtoIPSetMemberToBPFEntry(id, m)
 			err := ipsMap.Update(entry[:], ipsets.DummyValue)
 			Expect(err).NotTo(HaveOccurred())
+			if entry.IsExact() {
+				err = ipsExactMap.Update(entry.ExactKey(), ipsets.DummyValue)
+				Expect(err).NotTo(HaveOccurred())
+			} else {
+				exactness[id] = false
+			}
+		}
+	}
+	return exactness
+}
+
+// dataplaneIPSets is the part of the BPF IP sets dataplane that the policy program builder uses.
+type dataplaneIPSets interface {
+	IPSetIsExact(id uint64) bool
+	IPSetMemberBit(id uint64) (int, bool)
+}
+
+// setUpDataplaneIPSets programs the IP sets through the BPF IP sets dataplane.  If membersMap is
+// set, the IP sets are stored in it.
+func setUpDataplaneIPSets(ipSets map[string][]string, alloc *idalloc.IDAllocator, membersMap bpf.Map) dataplaneIPSets {
+	dp := ipsets.NewBPFIPSets(
+		felixipsets.NewIPVersionConfig(felixipsets.IPFamilyV4, "cali", nil, nil),
+		alloc,
+		ipsMap,
+		ipsExactMap,
+		membersMap,
+		logutils.NewSummarizer("test"),
+	)
+	for name, members := range ipSets {
+		setType := felixipsets.IPSetTypeHashNet
+		for _, m := range members {
+			if strings.Contains(m, ",") {
+				setType = felixipsets.IPSetTypeHashIPPort
+			}
 		}
+		dp.AddOrReplaceIPSet(felixipsets.IPSetMetadata{SetID: name, Type: setType}, members)
 	}
+	dp.ApplyUpdates()
+	return dp
 }
 
 func cleanIPSetMap() {
 	// Clean out any existing IP sets.  (The other maps have a fixed number of keys that
 	// we set as needed.)
-	var keys [][]byte
-	err := ipsMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		kCopy := make([]byte, len(k))
-		copy(kCopy, k)
-		keys = append(keys, kCopy)
-		return bpf.IterNone
-	})
-	Expect(err).NotTo(HaveOccurred(), "failed to clean out map before test")
-	for _, k := range keys {
-		err = ipsMap.Delete(k)
+	for _, m := range []bpf.Map{ipsMap, ipsExactMap, ipsMembersMap} {
+		var keys [][]byte
+		err := m.Iter(func(k, v []byte) bpf.IteratorAction {
+			kCopy := make([]byte, len(k))
+			copy(kCopy, k)
+			keys = append(keys, kCopy)
+			return bpf.IterNone
+		})
 		Expect(err).NotTo(HaveOccurred(), "failed to clean out map before test")
+		for _, k := range keys {
+			err = m.Delete(k)
+			Expect(err).NotTo(HaveOccurred(), "failed to clean out map before test")
+		}
 	}
 }
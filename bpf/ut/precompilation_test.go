@@ -27,6 +27,7 @@ import (
 	"github.com/vishvananda/netlink"
 
 	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
 	"github.com/projectcalico/felix/bpf/tc"
 )
 
@@ -76,31 +77,41 @@ func TestPrecompiledBinariesAreLoadable(t *testing.T) {
 								continue
 							}
 
-							ap := tc.AttachPoint{
-								Type:       epType,
-								ToOrFrom:   toOrFrom,
-								Hook:       tc.HookIngress,
-								ToHostDrop: epToHostDrop,
-								FIB:        fibEnabled,
-								DSR:        dsr,
-								LogLevel:   logLevel,
-								HostIP:     net.ParseIP("10.0.0.1"),
-								IntfIP:     net.ParseIP("10.0.0.2"),
+							for _, events := range []bool{false, true} {
+								if events && logLevel != "OFF" {
+									log.Debug("Events are only compiled into the no_log programs")
+									continue
+								}
+
+								ap := tc.AttachPoint{
+									Type:       epType,
+									ToOrFrom:   toOrFrom,
+									Hook:       tc.HookIngress,
+									ToHostDrop: epToHostDrop,
+									FIB:        fibEnabled,
+									DSR:        dsr,
+									LogLevel:   logLevel,
+									HostIP:     net.ParseIP("10.0.0.1"),
+									IntfIP:     net.ParseIP("10.0.0.2"),
+								}
+								if events {
+									ap.EventsSampleRate = 100
+								}
+
+								t.Run(ap.FileName(), func(t *testing.T) {
+									RegisterTestingT(t)
+									logCxt.Debugf("Testing %v in %v", ap.ProgramName(), ap.FileName())
+
+									vethName, veth := createVeth()
+									defer deleteLink(veth)
+
+									ap.Iface = vethName
+									err := tc.EnsureQdisc(ap.Iface)
+									Expect(err).NotTo(HaveOccurred())
+									err = ap.AttachProgram()
+									Expect(err).NotTo(HaveOccurred())
+								})
 							}
-
-							t.Run(ap.FileName(), func(t *testing.T) {
-								RegisterTestingT(t)
-								logCxt.Debugf("Testing %v in %v", ap.ProgramName(), ap.FileName())
-
-								vethName, veth := createVeth()
-								defer deleteLink(veth)
-
-								ap.Iface = vethName
-								err := tc.EnsureQdisc(ap.Iface)
-								Expect(err).NotTo(HaveOccurred())
-								err = ap.AttachProgram()
-								Expect(err).NotTo(HaveOccurred())
-							})
 						}
 					}
 				}
@@ -109,6 +120,46 @@ func TestPrecompiledBinariesAreLoadable(t *testing.T) {
 	}
 }
 
+func TestPrecompiledBinariesAreLoadableWithLRUConntrack(t *testing.T) {
+	RegisterTestingT(t)
+
+	_, err := bpf.MaybeMountBPFfs()
+	Expect(err).NotTo(HaveOccurred())
+
+	// Replace the conntrack map with an LRU one for the duration of the test.
+	mc := &bpf.MapContext{}
+	ctMap := conntrack.MapForType(mc, "lru_hash")
+	Expect(ctMap.EnsureExists()).NotTo(HaveOccurred())
+	defer func() {
+		Expect(conntrack.Map(mc).EnsureExists()).NotTo(HaveOccurred())
+	}()
+
+	for _, toOrFrom := range []tc.ToOrFromEp{tc.FromEp, tc.ToEp} {
+		ap := tc.AttachPoint{
+			Type:         tc.EpTypeHost,
+			ToOrFrom:     toOrFrom,
+			Hook:         tc.HookIngress,
+			LogLevel:     "DEBUG",
+			HostIP:       net.ParseIP("10.0.0.1"),
+			IntfIP:       net.ParseIP("10.0.0.2"),
+			ConntrackLRU: true,
+		}
+
+		t.Run(ap.FileName(), func(t *testing.T) {
+			RegisterTestingT(t)
+
+			vethName, veth := createVeth()
+			defer deleteLink(veth)
+
+			ap.Iface = vethName
+			err := tc.EnsureQdisc(ap.Iface)
+			Expect(err).NotTo(HaveOccurred())
+			err = ap.AttachProgram()
+			Expect(err).NotTo(HaveOccurred())
+		})
+	}
+}
+
 func createVeth() (string, netlink.Link) {
 	vethName := fmt.Sprintf("test%xa", rand.Uint32())
 	var veth netlink.Link = &netlink.Veth{
@@ -127,3 +178,46 @@ func deleteLink(veth netlink.Link) {
 	err := netlink.LinkDel(veth)
 	Expect(err).NotTo(HaveOccurred(), "failed to delete test veth")
 }
+
+func TestPrecompiledVariantsAreLoadable(t *testing.T) {
+	RegisterTestingT(t)
+
+	_, err := bpf.MaybeMountBPFfs()
+	Expect(err).NotTo(HaveOccurred())
+
+	variants := []tc.ProgVariant{
+		{NoNAT: true},
+		{NoNodePortTunnel: true},
+		{NoCTLBReverse: true},
+		{NoNodePortTunnel: true, NoCTLBReverse: true},
+	}
+	for _, variant := range variants {
+		for _, epType := range []tc.EndpointType{tc.EpTypeWorkload, tc.EpTypeHost} {
+			for _, toOrFrom := range []tc.ToOrFromEp{tc.FromEp, tc.ToEp} {
+				ap := tc.AttachPoint{
+					Type:     epType,
+					ToOrFrom: toOrFrom,
+					Hook:     tc.HookIngress,
+					FIB:      toOrFrom == tc.FromEp,
+					LogLevel: "OFF",
+					HostIP:   net.ParseIP("10.0.0.1"),
+					IntfIP:   net.ParseIP("10.0.0.2"),
+					Variant:  variant,
+				}
+
+				t.Run(ap.FileName(), func(t *testing.T) {
+					RegisterTestingT(t)
+
+					vethName, veth := createVeth()
+					defer deleteLink(veth)
+
+					ap.Iface = vethName
+					err := tc.EnsureQdisc(ap.Iface)
+					Expect(err).NotTo(HaveOccurred())
+					err = ap.AttachProgram()
+					Expect(err).NotTo(HaveOccurred())
+				})
+			}
+		}
+	}
+}
@@ -0,0 +1,311 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"net"
+	"os"
+	"path"
+	"sort"
+	"strconv"
+	"testing"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	"github.com/google/gopacket/pcapgo"
+	. "github.com/onsi/gomega"
+	"github.com/pkg/errors"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+// TestReplay replays a pcap that was captured on a node through two builds of the programs and
+// reports where their verdicts differ and what each packet cost.  It is driven by environment
+// variables so that it can qualify a build against real traffic:
+//
+//	REPLAY_PCAP               the capture, an Ethernet pcap (tcpdump -w), required.
+//	REPLAY_CANDIDATE_OBJ_DIR  the UT binaries of the candidate build, required.
+//	REPLAY_BASELINE_OBJ_DIR   the UT binaries to compare against, by default those of this tree.
+//	REPLAY_MAPS               a directory with a snapshot of the maps, one "bpftool map dump -j"
+//	                          output per map, named <map name>.json, for example
+//	                          cali_v4_ct3.json.  Missing maps start empty.
+//	REPLAY_SECTION            the program to run, by default calico_from_host_ep.
+//	REPLAY_HOST_IP            the IP of the node that the capture comes from.
+//	REPLAY_CSV                if set, a file to write the per-packet results to.
+//
+// Both builds start from the same snapshot and see the packets in capture order, so the conntrack
+// entries the programs create carry over from packet to packet as they would on the node.  Policy
+// is not part of the snapshot, the programs run with an allow-all policy.
+func TestReplay(t *testing.T) {
+	pcapFile := os.Getenv("REPLAY_PCAP")
+	candidateDir := os.Getenv("REPLAY_CANDIDATE_OBJ_DIR")
+	if pcapFile == "" || candidateDir == "" {
+		t.Skip("REPLAY_PCAP and REPLAY_CANDIDATE_OBJ_DIR not set")
+	}
+	RegisterTestingT(t)
+
+	baselineDir := envOrDefault("REPLAY_BASELINE_OBJ_DIR", "../../bpf-gpl/bin/")
+	section := envOrDefault("REPLAY_SECTION", "calico_from_host_ep")
+
+	if s := os.Getenv("REPLAY_HOST_IP"); s != "" {
+		ip := net.ParseIP(s).To4()
+		Expect(ip).NotTo(BeNil(), "REPLAY_HOST_IP is not an IPv4 address")
+		defer func(old net.IP) { hostIP = old }(hostIP)
+		hostIP = ip
+	}
+
+	pkts, err := readReplayPcap(pcapFile)
+	Expect(err).NotTo(HaveOccurred())
+	log.WithField("packets", len(pkts)).Info("Loaded capture")
+
+	snapshot := map[bpf.Map][]replayMapEntry{}
+	if dir := os.Getenv("REPLAY_MAPS"); dir != "" {
+		for _, m := range replayMaps() {
+			entries, err := readReplayMapDump(path.Join(dir, m.GetName()+".json"))
+			if os.IsNotExist(errors.Cause(err)) {
+				continue
+			}
+			Expect(err).NotTo(HaveOccurred())
+			snapshot[m] = entries
+		}
+	}
+
+	baseline := replayBuild(t, baselineDir, section, pkts, snapshot)
+	candidate := replayBuild(t, candidateDir, section, pkts, snapshot)
+
+	diffs := 0
+	for i := range pkts {
+		b, c := baseline.results[i], candidate.results[i]
+		if b.Retval == c.Retval && bytes.Equal(b.dataOut, c.dataOut) {
+			continue
+		}
+		diffs++
+		what := "verdict"
+		if b.Retval == c.Retval {
+			what = "output packet"
+		}
+		fmt.Printf("packet %d (%s): %s differs, baseline %s, candidate %s\n",
+			i+1, replayPacketSummary(pkts[i]), what, b.RetvalStr(), c.RetvalStr())
+	}
+
+	fmt.Printf("\n%d packets, %d differ\n", len(pkts), diffs)
+	for _, r := range []*replayRun{baseline, candidate} {
+		r.printSummary()
+	}
+
+	if csvFile := os.Getenv("REPLAY_CSV"); csvFile != "" {
+		Expect(writeReplayCSV(csvFile, baseline, candidate)).To(Succeed())
+	}
+}
+
+func envOrDefault(name, def string) string {
+	if v := os.Getenv(name); v != "" {
+		return v
+	}
+	return def
+}
+
+// replayMaps returns the maps that a snapshot can restore.
+func replayMaps() []bpf.Map {
+	initMapsOnce()
+	return []bpf.Map{natMap, natBEMap, affinityMap, ctMap, rtMap, rtExactMap, rtNHGroupMap, arpMap,
+		fsafeMap, fsafePortsMap, ipsMap, ipsExactMap}
+}
+
+type replayRun struct {
+	objDir    string
+	progInsns int
+	results   []bpfRunResult
+}
+
+// replayBuild restores the snapshot and runs every packet through the build's program, in order.
+func replayBuild(t *testing.T, objDir, section string, pkts [][]byte,
+	snapshot map[bpf.Map][]replayMapEntry) *replayRun {
+
+	cleanUpMaps()
+	defer cleanUpMaps()
+	for m, entries := range snapshot {
+		for _, e := range entries {
+			err := m.Update(e.key, e.value)
+			Expect(err).NotTo(HaveOccurred(), fmt.Sprintf("failed to restore %s", m.GetName()))
+		}
+	}
+
+	opts := []testOption{withObjDir(objDir)}
+	for _, m := range replayMaps() {
+		opts = append(opts, withExtraMap(m))
+	}
+
+	run := &replayRun{objDir: objDir}
+	setupAndRun(t, "no_log", section, rulesDefaultAllow, func(progName string) {
+		run.progInsns = pinnedProgInsns(progName)
+		for i, pkt := range pkts {
+			res, err := bpftoolProgRun(progName, pkt)
+			Expect(err).NotTo(HaveOccurred(), fmt.Sprintf("failed to run packet %d", i+1))
+			run.results = append(run.results, res)
+		}
+	}, opts...)
+
+	return run
+}
+
+// pinnedProgInsns returns the number of instructions of the program after the kernel rewrote it.
+// BPF_PROG_TEST_RUN does not count the instructions that a run executes.
+func pinnedProgInsns(progName string) int {
+	out, err := bpftool("prog", "show", "pinned", progName)
+	Expect(err).NotTo(HaveOccurred())
+	var info struct {
+		BytesXlated int `json:"bytes_xlated"`
+	}
+	Expect(json.Unmarshal(out, &info)).To(Succeed())
+	return info.BytesXlated / 8
+}
+
+func (r *replayRun) printSummary() {
+	verdicts := map[string]int{}
+	var durations []int
+	for _, res := range r.results {
+		verdicts[res.RetvalStr()]++
+		durations = append(durations, res.Duration)
+	}
+	sort.Ints(durations)
+
+	fmt.Printf("\n%s: %d instructions\n", r.objDir, r.progInsns)
+	var names []string
+	for v := range verdicts {
+		names = append(names, v)
+	}
+	sort.Strings(names)
+	for _, v := range names {
+		fmt.Printf("  %-16s %d\n", v, verdicts[v])
+	}
+	if len(durations) == 0 {
+		return
+	}
+	total := 0
+	for _, d := range durations {
+		total += d
+	}
+	pct := func(p int) int { return durations[(len(durations)-1)*p/100] }
+	fmt.Printf("  ns per packet: avg %d p50 %d p90 %d p99 %d max %d\n",
+		total/len(durations), pct(50), pct(90), pct(99), durations[len(durations)-1])
+}
+
+func writeReplayCSV(fname string, baseline, candidate *replayRun) error {
+	var buf bytes.Buffer
+	buf.WriteString("packet,baseline_verdict,baseline_ns,candidate_verdict,candidate_ns\n")
+	for i := range baseline.results {
+		b, c := baseline.results[i], candidate.results[i]
+		fmt.Fprintf(&buf, "%d,%s,%d,%s,%d\n", i+1, b.RetvalStr(), b.Duration, c.RetvalStr(), c.Duration)
+	}
+	return ioutil.WriteFile(fname, buf.Bytes(), 0644)
+}
+
+func readReplayPcap(fname string) ([][]byte, error) {
+	f, err := os.Open(fname)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	r, err := pcapgo.NewReader(f)
+	if err != nil {
+		return nil, errors.Wrapf(err, "failed to read pcap %s", fname)
+	}
+	if r.LinkType() != layers.LinkTypeEthernet {
+		return nil, errors.Errorf("pcap %s has link type %s, expected Ethernet; capture on an interface rather than \"any\"",
+			fname, r.LinkType())
+	}
+
+	var pkts [][]byte
+	for {
+		data, ci, err := r.ReadPacketData()
+		if err == io.EOF {
+			return pkts, nil
+		}
+		if err != nil {
+			return nil, errors.Wrapf(err, "failed to read packet %d of %s", len(pkts)+1, fname)
+		}
+		if ci.CaptureLength < ci.Length {
+			log.WithField("packet", len(pkts)+1).Warn("Packet was truncated by the capture, replaying what was captured")
+		}
+		pkts = append(pkts, data)
+	}
+}
+
+func replayPacketSummary(pkt []byte) string {
+	p := gopacket.NewPacket(pkt, layers.LayerTypeEthernet, gopacket.Default)
+	s := ""
+	if nl := p.NetworkLayer(); nl != nil {
+		s = nl.NetworkFlow().String()
+	}
+	if tl := p.TransportLayer(); tl != nil {
+		s += " " + tl.LayerType().String() + " " + tl.TransportFlow().String()
+	}
+	return s
+}
+
+type replayMapEntry struct {
+	key, value []byte
+}
+
+// readReplayMapDump parses the JSON of "bpftool map dump -j", where keys and values are lists of
+// hex bytes.
+func readReplayMapDump(fname string) ([]replayMapEntry, error) {
+	data, err := ioutil.ReadFile(fname)
+	if err != nil {
+		return nil, errors.WithStack(err)
+	}
+
+	var dump []struct {
+		Key   []string `json:"key"`
+		Value []string `json:"value"`
+	}
+	if err := json.Unmarshal(data, &dump); err != nil {
+		return nil, errors.Wrapf(err, "failed to parse map dump %s", fname)
+	}
+
+	hexBytes := func(hex []string) ([]byte, error) {
+		b := make([]byte, len(hex))
+		for i, h := range hex {
+			v, err := strconv.ParseUint(h, 0, 8)
+			if err != nil {
+				return nil, err
+			}
+			b[i] = byte(v)
+		}
+		return b, nil
+	}
+
+	entries := make([]replayMapEntry, 0, len(dump))
+	for i, d := range dump {
+		k, err := hexBytes(d.Key)
+		if err != nil {
+			return nil, errors.Wrapf(err, "bad key of entry %d in %s", i, fname)
+		}
+		v, err := hexBytes(d.Value)
+		if err != nil {
+			return nil, errors.Wrapf(err, "bad value of entry %d in %s", i, fname)
+		}
+		entries = append(entries, replayMapEntry{key: k, value: v})
+	}
+	return entries, nil
+}
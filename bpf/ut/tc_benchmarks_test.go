@@ -0,0 +1,260 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ut_test
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"math/rand"
+	"net"
+	"regexp"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	. "github.com/onsi/gomega"
+	"github.com/vishvananda/netlink"
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/polprog"
+	"github.com/projectcalico/felix/bpf/tc"
+	"github.com/projectcalico/felix/idalloc"
+)
+
+// tcBenchPacket is one of the canonical packets that BenchmarkTCPrograms runs through each program.
+type tcBenchPacket struct {
+	name  string
+	bytes []byte
+	// setup, if set, fills in the maps that the packet needs, for example, its conntrack entry.
+	setup func()
+}
+
+func tcBenchPackets() []tcBenchPacket {
+	var pkts []tcBenchPacket
+
+	tcpSyn := &layers.TCP{SrcPort: 54321, DstPort: 7890, SYN: true, DataOffset: 5}
+	_, _, _, _, synBytes, err := testPacket(nil, nil, tcpSyn, nil)
+	Expect(err).NotTo(HaveOccurred())
+	pkts = append(pkts, tcBenchPacket{name: "tcp_syn", bytes: synBytes})
+
+	tcpAck := &layers.TCP{SrcPort: 54321, DstPort: 7890, ACK: true, DataOffset: 5}
+	_, ipv4, _, _, ackBytes, err := testPacket(nil, nil, tcpAck, nil)
+	Expect(err).NotTo(HaveOccurred())
+	pkts = append(pkts, tcBenchPacket{name: "tcp_established", bytes: ackBytes, setup: func() {
+		now := time.Duration(bpf.KTimeNanos())
+		leg := conntrack.Leg{SynSeen: true, AckSeen: true, Whitelisted: true}
+		k := conntrack.NewKey(uint8(ipv4.Protocol), ipv4.SrcIP, uint16(tcpAck.SrcPort),
+			ipv4.DstIP, uint16(tcpAck.DstPort))
+		v := conntrack.NewValueNormal(now, now, 0, leg, leg)
+		Expect(ctMap.Update(k.AsBytes(), v[:])).NotTo(HaveOccurred())
+	}})
+
+	_, _, _, _, udpBytes, err := testPacketUDPDefault()
+	Expect(err).NotTo(HaveOccurred())
+	pkts = append(pkts, tcBenchPacket{name: "udp", bytes: udpBytes})
+
+	npIP := *ipv4Default
+	npIP.DstIP = node1ip
+	npUDP := &layers.UDP{SrcPort: 1234, DstPort: 30333}
+	_, _, _, _, npBytes, err := testPacket(nil, &npIP, npUDP, nil)
+	Expect(err).NotTo(HaveOccurred())
+	pkts = append(pkts, tcBenchPacket{name: "nodeport", bytes: npBytes, setup: func() {
+		err := natMap.Update(
+			nat.NewNATKey(node1ip, uint16(npUDP.DstPort), uint8(layers.IPProtocolUDP)).AsBytes(),
+			nat.NewNATValue(0, 1, 0, 0).AsBytes(),
+		)
+		Expect(err).NotTo(HaveOccurred())
+		err = natBEMap.Update(
+			nat.NewNATBackendKey(0, 0).AsBytes(),
+			nat.NewNATBackendValue(net.IPv4(10, 65, 0, 2), 8080).AsBytes(),
+		)
+		Expect(err).NotTo(HaveOccurred())
+	}})
+
+	pkts = append(pkts, tcBenchPacket{name: "vxlan", bytes: tcBenchVXLANPacket(udpBytes)})
+
+	icmpInner := *ipv4Default
+	icmpInner.SrcIP, icmpInner.DstIP = ipv4Default.DstIP, ipv4Default.SrcIP
+	icmpBytes := makeICMPError(&icmpInner, udpDefault, 3 /* Unreachable */, 3 /* Port unreachable */)
+	pkts = append(pkts, tcBenchPacket{name: "icmp_error", bytes: icmpBytes})
+
+	return pkts
+}
+
+// tcBenchVXLANPacket wraps the inner frame in VXLAN from node2 to node1.
+func tcBenchVXLANPacket(inner []byte) []byte {
+	ipv4 := &layers.IPv4{
+		Version:  4,
+		IHL:      5,
+		TTL:      64,
+		Flags:    layers.IPv4DontFragment,
+		SrcIP:    node2ip,
+		DstIP:    node1ip,
+		Protocol: layers.IPProtocolUDP,
+		Length:   uint16(20 + 8 + 8 + len(inner)),
+	}
+	udp := &layers.UDP{SrcPort: 12345, DstPort: 4789, Length: uint16(8 + 8 + len(inner))}
+	vxlan := &layers.VXLAN{ValidIDFlag: true, VNI: 4096}
+
+	pkt := gopacket.NewSerializeBuffer()
+	err := gopacket.SerializeLayers(pkt, gopacket.SerializeOptions{ComputeChecksums: true},
+		ethDefault, ipv4, udp, vxlan, gopacket.Payload(inner))
+	Expect(err).NotTo(HaveOccurred())
+	return pkt.Bytes()
+}
+
+// BenchmarkTCPrograms runs the canonical packets through each of the production (no_log) TC program
+// variants and reports the per-packet run time, as measured by BPF_PROG_TEST_RUN, and the number of
+// instructions in the program.  The programs are attached to a veth by tc, as Felix does, with an
+// allow-all policy.
+func BenchmarkTCPrograms(b *testing.B) {
+	RegisterTestingT(b)
+
+	pkts := tcBenchPackets()
+
+	for _, epType := range []tc.EndpointType{tc.EpTypeWorkload, tc.EpTypeHost, tc.EpTypeTunnel, tc.EpTypeWireguard} {
+		for _, toOrFrom := range []tc.ToOrFromEp{tc.FromEp, tc.ToEp} {
+			for _, fib := range []bool{false, true} {
+				if fib && toOrFrom == tc.ToEp {
+					continue // The FIB only applies in the from-endpoint hooks.
+				}
+				ap := tc.AttachPoint{
+					Type:     epType,
+					ToOrFrom: toOrFrom,
+					Hook:     tc.HookIngress,
+					FIB:      fib,
+					LogLevel: "OFF",
+					HostIP:   node1ip,
+					IntfIP:   intfIP,
+				}
+				benchmarkTCProgram(b, ap, pkts)
+			}
+		}
+	}
+}
+
+func benchmarkTCProgram(b *testing.B, ap tc.AttachPoint, pkts []tcBenchPacket) {
+	vethName := fmt.Sprintf("bench%xa", rand.Uint32())
+	veth := &netlink.Veth{
+		LinkAttrs: netlink.LinkAttrs{Name: vethName, Flags: net.FlagUp},
+		PeerName:  vethName + "b",
+	}
+	Expect(netlink.LinkAdd(veth)).NotTo(HaveOccurred())
+	defer func() {
+		Expect(netlink.LinkDel(veth)).NotTo(HaveOccurred())
+	}()
+
+	ap.Iface = vethName
+	Expect(tc.EnsureQdisc(ap.Iface)).NotTo(HaveOccurred())
+	Expect(ap.AttachProgram()).NotTo(HaveOccurred())
+
+	progID, err := tcAttachedProgID(ap)
+	Expect(err).NotTo(HaveOccurred())
+	info, err := bpftoolProgShow(progID)
+	Expect(err).NotTo(HaveOccurred())
+	installAllowAllPolicy(info.MapIDs)
+
+	insns := float64(info.BytesXlated / 8)
+
+	for _, pkt := range pkts {
+		pkt := pkt
+		b.Run(strings.TrimSuffix(ap.FileName(), ".o")+"/"+pkt.name, func(b *testing.B) {
+			cleanUpMaps()
+			defer cleanUpMaps()
+			if pkt.setup != nil {
+				pkt.setup()
+			}
+
+			b.ResetTimer()
+			res, err := bpftoolProgRunID(progID, pkt.bytes, b.N)
+			b.StopTimer()
+			Expect(err).NotTo(HaveOccurred())
+
+			b.ReportMetric(float64(res.Duration), "ns/pkt")
+			b.ReportMetric(insns, "insns")
+		})
+	}
+}
+
+var tcFilterProgIDRegexp = regexp.MustCompile(`id (\d+)`)
+
+// tcAttachedProgID returns the ID of the program that tc attached at the attach point.
+func tcAttachedProgID(ap tc.AttachPoint) (int, error) {
+	out, err := tc.ExecTC("filter", "show", "dev", ap.Iface, string(ap.Hook))
+	if err != nil {
+		return 0, err
+	}
+	for _, line := range strings.Split(out, "\n") {
+		if !strings.Contains(line, ap.ProgramName()) {
+			continue
+		}
+		if m := tcFilterProgIDRegexp.FindStringSubmatch(line); m != nil {
+			return strconv.Atoi(m[1])
+		}
+	}
+	return 0, fmt.Errorf("no program attached to %s", ap.Iface)
+}
+
+type bpftoolProgInfo struct {
+	MapIDs      []int `json:"map_ids"`
+	BytesXlated int   `json:"bytes_xlated"`
+}
+
+func bpftoolProgShow(progID int) (bpftoolProgInfo, error) {
+	var info bpftoolProgInfo
+	out, err := bpftool("prog", "show", "id", fmt.Sprint(progID))
+	if err != nil {
+		return info, err
+	}
+	err = json.Unmarshal(out, &info)
+	return info, err
+}
+
+// installAllowAllPolicy installs an allow-all policy program in the jump map, which is the program
+// array among the given maps.
+func installAllowAllPolicy(mapIDs []int) {
+	for _, id := range mapIDs {
+		fd, err := bpf.GetMapFDByID(id)
+		Expect(err).NotTo(HaveOccurred())
+		mapInfo, err := bpf.GetMapInfo(fd)
+		Expect(err).NotTo(HaveOccurred())
+		if mapInfo.Type != unix.BPF_MAP_TYPE_PROG_ARRAY {
+			Expect(fd.Close()).NotTo(HaveOccurred())
+			continue
+		}
+
+		alloc := &forceAllocator{alloc: idalloc.New()}
+		pg := polprog.NewBuilder(alloc, ipsMap.MapFD(), stateMap.MapFD(), fd)
+		insns, err := pg.Instructions(*rulesDefaultAllow)
+		Expect(err).NotTo(HaveOccurred())
+		polProgFD, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
+		Expect(err).NotTo(HaveOccurred())
+		progFDBytes := make([]byte, 4)
+		binary.LittleEndian.PutUint32(progFDBytes, uint32(polProgFD))
+		Expect(bpf.UpdateMapEntry(fd, []byte{0, 0, 0, 0}, progFDBytes)).NotTo(HaveOccurred())
+		// The jump map holds references to the program and the attached program holds one to the map.
+		Expect(polProgFD.Close()).NotTo(HaveOccurred())
+		Expect(fd.Close()).NotTo(HaveOccurred())
+		return
+	}
+	Expect(false).To(BeTrue(), "no jump map found")
+}
@@ -0,0 +1,280 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package xdp
+
+import (
+	"fmt"
+	"io/ioutil"
+	"net"
+	"os"
+	"os/exec"
+	"path"
+	"strconv"
+	"strings"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/nat"
+)
+
+// SectionName is the ELF section of the XDP program in bpf-gpl/xdp.c.
+const SectionName = "prog"
+
+// ProgramName is the name under which the kernel knows the XDP program, the name of its function.
+// WARNING: must be kept in sync with calico_xdp in bpf-gpl/xdp.c.
+const ProgramName = "calico_xdp"
+
+// AttachPoint is a host interface that the unified XDP program (prefilter, conntrack fast path and
+// NodePort forwarding) is attached to, or a workload veth that its from-workload variant is
+// attached to.
+type AttachPoint struct {
+	Iface string
+	// Workload is set if Iface is the host side of a workload veth; the program then only does the
+	// RPF check of the workload and forwards its established flows, see bpf-gpl/xdp.c.
+	Workload  bool
+	LogLevel  string
+	HostIP    net.IP
+	TunnelMTU uint16
+	VXLANPort uint16
+	// ConntrackLRU is set if the conntrack map is an LRU map, see conntrack.LRUMapParams.
+	ConntrackLRU bool
+	// NATAffinityPerCPULRU is set if the NAT affinity map has per-CPU LRU lists, see
+	// nat.AffinityMapPerCPULRUParameters.
+	NATAffinityPerCPULRU bool
+	// MapSizes overrides the sizes of the maps in the program, see bpf.MapContext.MapSizes.
+	MapSizes map[string]uint32
+	// SynCookies is set if the program answers the SYNs to the ports in SynCookiePortsMapParams
+	// with SYN cookies.
+	SynCookies bool
+	// CPUSteering is the number of CPUs, the first ones in CPUMapParams, that the program spreads
+	// Calico VXLAN packets over by their inner flow; zero disables the steering.
+	CPUSteering uint32
+	// ConntrackAccounting makes the program count the packets that it forwards in the flows'
+	// conntrack accounting, see conntrack.AcctMapParams.
+	ConntrackAccounting bool
+	// EDT is set if the host endpoint programs shape the egress bandwidth of workloads, the
+	// workload program then leaves the shaped workloads' packets to them, see edt.MapParams.
+	EDT bool
+	// NUMAReplicas makes the program look up the replicas of the read-mostly maps when it runs on
+	// the second NUMA node, see bpf.NUMAReplicatedMap.
+	NUMAReplicas bool
+	// KtimeCoarse makes the program use the jiffy-precision clock for the conntrack bookkeeping,
+	// see bpf.SupportsKtimeCoarse.
+	KtimeCoarse bool
+	// MapNUMANodes lists the maps that are placed on NUMA nodes, see bpf.MapContext.NUMANodes.
+	MapNUMANodes map[string]int
+	// Modes are the XDP attach modes to try, in order.
+	Modes []bpf.XDPMode
+}
+
+// ProgFilename returns the name of the pre-compiled XDP program for the log level and the type of
+// interface.
+// WARNING: must be kept in sync with bpf-gpl/list-objs.
+func ProgFilename(logLevel string, workload bool) string {
+	logLevel = strings.ToLower(logLevel)
+	if logLevel == "off" {
+		logLevel = "no_log"
+	}
+	if workload {
+		return fmt.Sprintf("xdp_wep_%s.o", logLevel)
+	}
+	return fmt.Sprintf("xdp_%s.o", logLevel)
+}
+
+func (ap AttachPoint) FileName() string {
+	return ProgFilename(ap.LogLevel, ap.Workload)
+}
+
+// AttachProgram attaches the XDP program to the interface, replacing any program that is already
+// there.  It returns the mode that the program was attached in.
+func (ap AttachPoint) AttachProgram() (bpf.XDPMode, error) {
+	logCxt := log.WithField("attachPoint", ap)
+
+	tempDir, err := ioutil.TempDir("", "calico-xdp")
+	if err != nil {
+		return 0, fmt.Errorf("failed to create temporary directory: %w", err)
+	}
+	defer func() {
+		_ = os.RemoveAll(tempDir)
+	}()
+
+	filename := ap.FileName()
+	preCompiledBinary := path.Join(bpf.ObjectDir, filename)
+	tempBinary := path.Join(tempDir, filename)
+
+	err = ap.patchBinary(logCxt, preCompiledBinary, tempBinary)
+	if err != nil {
+		logCxt.WithError(err).Error("Failed to patch binary")
+		return 0, err
+	}
+
+	var errs []string
+	for _, mode := range ap.Modes {
+		out, err := exec.Command("ip", "-force", "link", "set", "dev", ap.Iface,
+			mode.String(), "obj", tempBinary, "sec", SectionName).CombinedOutput()
+		if err == nil {
+			logCxt.WithField("mode", mode).Info("Attached XDP program")
+			return mode, nil
+		}
+		logCxt.WithError(err).WithField("mode", mode).Debug("Failed to attach XDP program")
+		errs = append(errs, fmt.Sprintf("%s: %s: %s", mode, err, strings.TrimSpace(string(out))))
+	}
+
+	return 0, fmt.Errorf("failed to attach XDP program to %s: %s", ap.Iface, strings.Join(errs, "; "))
+}
+
+// ProgramID returns the ID of the XDP program that is attached to the interface.
+func (ap AttachPoint) ProgramID() (int, error) {
+	id, _, err := AttachedProgram(ap.Iface)
+	if err != nil {
+		return -1, err
+	}
+	if id < 0 {
+		return -1, fmt.Errorf("no XDP program attached to %s", ap.Iface)
+	}
+	return id, nil
+}
+
+// AttachedProgram returns the ID of the XDP program that is attached to the interface and the mode
+// that it is attached in, or an ID of -1 if there is none.  Programs attached in more than one
+// mode at once are not reported, we never attach them that way.
+func AttachedProgram(iface string) (int, bpf.XDPMode, error) {
+	out, err := exec.Command("ip", "link", "show", "dev", iface).CombinedOutput()
+	if err != nil {
+		return -1, 0, fmt.Errorf("failed to show interface %s: %w: %s", iface, err, out)
+	}
+	return parseAttachedProgram(iface, out)
+}
+
+func parseAttachedProgram(iface string, out []byte) (int, bpf.XDPMode, error) {
+	// The mode follows the MTU, "xdp" for driver mode, and the program is on a line like
+	// "prog/xdp id 175 tag 5199fa060702bbff jited".
+	mode := bpf.XDPDriver
+	s := strings.Fields(string(out))
+	for i := range s {
+		switch s[i] {
+		case "xdpgeneric":
+			mode = bpf.XDPGeneric
+		case "xdpoffload":
+			mode = bpf.XDPOffload
+		case "prog/xdp":
+			if len(s) > i+2 && s[i+1] == "id" {
+				id, err := strconv.Atoi(s[i+2])
+				if err != nil {
+					return -1, 0, fmt.Errorf("failed to parse XDP program ID of %s: %w", iface, err)
+				}
+				return id, mode, nil
+			}
+		}
+	}
+
+	return -1, 0, nil
+}
+
+// DetachCalicoProgram removes the XDP program from the interface if it is ours, see ProgramName,
+// and leaves any other program alone.  It returns whether it removed a program.
+func DetachCalicoProgram(iface string) (bool, error) {
+	id, mode, err := AttachedProgram(iface)
+	if err != nil || id < 0 {
+		return false, err
+	}
+
+	progFD, err := bpf.GetProgFDByID(id)
+	if err != nil {
+		return false, fmt.Errorf("failed to get FD of XDP program %d: %w", id, err)
+	}
+	info, err := bpf.GetProgInfo(progFD)
+	_ = progFD.Close()
+	if err != nil {
+		return false, fmt.Errorf("failed to get information about XDP program %d: %w", id, err)
+	}
+	logCxt := log.WithFields(log.Fields{"iface": iface, "id": id, "name": info.Name})
+	if info.Name != ProgramName {
+		logCxt.Debug("Leaving alone XDP program that isn't ours")
+		return false, nil
+	}
+
+	err = DetachProgram(iface, mode)
+	if err != nil {
+		return false, err
+	}
+	logCxt.Info("Detached XDP program")
+	return true, nil
+}
+
+// DetachProgram removes the XDP program attached in the given mode from the interface.
+func DetachProgram(iface string, mode bpf.XDPMode) error {
+	out, err := exec.Command("ip", "link", "set", "dev", iface, mode.String(), "off").CombinedOutput()
+	if err != nil {
+		return fmt.Errorf("failed to detach XDP program from %s: %w: %s", iface, err, out)
+	}
+	return nil
+}
+
+func (ap AttachPoint) patchBinary(logCtx *log.Entry, ifile, ofile string) error {
+	b, err := bpf.BinaryFromFile(ifile)
+	if err != nil {
+		return fmt.Errorf("failed to read pre-compiled BPF binary: %w", err)
+	}
+
+	logCtx.WithField("ip", ap.HostIP).Debug("Patching in IP")
+	err = b.PatchIPv4(ap.HostIP)
+	if err != nil {
+		return fmt.Errorf("failed to patch IPv4 into BPF binary: %w", err)
+	}
+
+	b.PatchLogPrefix(ap.Iface)
+	b.PatchTunnelMTU(ap.TunnelMTU)
+	vxlanPort := ap.VXLANPort
+	if vxlanPort == 0 {
+		vxlanPort = 4789
+	}
+	b.PatchVXLANPort(vxlanPort)
+	b.PatchSynCookies(ap.SynCookies)
+	b.PatchCPUSteering(ap.CPUSteering)
+	b.PatchConntrackAccounting(ap.ConntrackAccounting)
+	b.PatchEDT(ap.EDT)
+	b.PatchNUMAReplicas(ap.NUMAReplicas)
+	b.PatchKtimeCoarse(ap.KtimeCoarse)
+	err = conntrack.PatchBinary(b, ap.ConntrackLRU)
+	if err != nil {
+		return err
+	}
+	err = nat.PatchAffinityMap(b, ap.NATAffinityPerCPULRU)
+	if err != nil {
+		return err
+	}
+	for name, size := range ap.MapSizes {
+		err = b.PatchMapSize(name, size)
+		if err != nil {
+			return fmt.Errorf("failed to patch size of map %s into BPF binary: %w", name, err)
+		}
+	}
+	for name := range ap.MapNUMANodes {
+		err = b.PatchMapNUMANode(name)
+		if err != nil {
+			return fmt.Errorf("failed to patch NUMA node of map %s into BPF binary: %w", name, err)
+		}
+	}
+
+	err = b.WriteToFile(ofile)
+	if err != nil {
+		return fmt.Errorf("failed to write pre-compiled BPF binary: %w", err)
+	}
+
+	return nil
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package xdp
+
+import (
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf"
+)
+
+func TestParseAttachedProgram(t *testing.T) {
+	RegisterTestingT(t)
+
+	id, mode, err := parseAttachedProgram("eth0", []byte(
+		"2: eth0: <BROADCAST,MULTICAST,UP,LOWER_UP> mtu 1500 xdp qdisc mq state UP mode DEFAULT group default qlen 1000\n"+
+			"    link/ether 52:54:00:12:34:56 brd ff:ff:ff:ff:ff:ff\n"+
+			"    prog/xdp id 175 tag 5199fa060702bbff jited \n"))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(id).To(Equal(175))
+	Expect(mode).To(Equal(bpf.XDPDriver))
+
+	id, mode, err = parseAttachedProgram("eth0", []byte(
+		"2: eth0: <BROADCAST,MULTICAST,UP,LOWER_UP> mtu 1500 xdpgeneric qdisc mq state UP mode DEFAULT group default qlen 1000\n"+
+			"    link/ether 52:54:00:12:34:56 brd ff:ff:ff:ff:ff:ff\n"+
+			"    prog/xdp id 12 tag 5199fa060702bbff jited \n"))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(id).To(Equal(12))
+	Expect(mode).To(Equal(bpf.XDPGeneric))
+
+	id, _, err = parseAttachedProgram("eth0", []byte(
+		"2: eth0: <BROADCAST,MULTICAST,UP,LOWER_UP> mtu 1500 qdisc mq state UP mode DEFAULT group default qlen 1000\n"+
+			"    link/ether 52:54:00:12:34:56 brd ff:ff:ff:ff:ff:ff\n"))
+	Expect(err).NotTo(HaveOccurred())
+	Expect(id).To(Equal(-1))
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package xdp
+
+import (
+	"encoding/binary"
+	"fmt"
+	"net"
+
+	"golang.org/x/sys/unix"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/ip"
+)
+
+// PrefilterMapParams describes the prefilter blocklist, traffic from whose source CIDRs is dropped by
+// the XDP program.
+// WARNING: must be kept in sync with cali_v4_pfilter in bpf-gpl/xdp.c.
+var PrefilterMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_v4_pfilter",
+	Type:       "lpm_trie",
+	KeySize:    PrefilterKeySize,
+	ValueSize:  PrefilterValueSize,
+	MaxEntries: 1024 * 1024,
+	Name:       "cali_v4_pfilter",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func PrefilterMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(PrefilterMapParams)
+}
+
+const PrefilterKeySize = 8
+
+type PrefilterKey [PrefilterKeySize]byte
+
+func NewPrefilterKey(cidr ip.V4CIDR) PrefilterKey {
+	var k PrefilterKey
+
+	binary.LittleEndian.PutUint32(k[:4], uint32(cidr.Prefix()))
+	copy(k[4:8], cidr.Addr().AsNetIP().To4())
+
+	return k
+}
+
+func PrefilterKeyFromBytes(b []byte) PrefilterKey {
+	var k PrefilterKey
+	copy(k[:], b)
+	return k
+}
+
+func (k PrefilterKey) CIDR() ip.V4CIDR {
+	prefix := binary.LittleEndian.Uint32(k[:4])
+	return ip.CIDRFromIPNet(&net.IPNet{
+		IP:   net.IP(k[4:8]),
+		Mask: net.CIDRMask(int(prefix), 32),
+	}).(ip.V4CIDR)
+}
+
+func (k PrefilterKey) AsBytes() []byte {
+	return k[:]
+}
+
+func (k PrefilterKey) String() string {
+	return k.CIDR().String()
+}
+
+const PrefilterValueSize = 16
+
+// PrefilterValue holds the drop counters of a blocked prefix.  A new entry should start with zero
+// counters.
+type PrefilterValue [PrefilterValueSize]byte
+
+func PrefilterValueFromBytes(b []byte) PrefilterValue {
+	var v PrefilterValue
+	copy(v[:], b)
+	return v
+}
+
+func (v PrefilterValue) Packets() uint64 {
+	return binary.LittleEndian.Uint64(v[0:8])
+}
+
+func (v PrefilterValue) Bytes() uint64 {
+	return binary.LittleEndian.Uint64(v[8:16])
+}
+
+func (v PrefilterValue) AsBytes() []byte {
+	return v[:]
+}
+
+func (v PrefilterValue) String() string {
+	return fmt.Sprintf("dropped %d packets %d bytes", v.Packets(), v.Bytes())
+}
+
+// TxMapParams describes the set of interfaces that the XDP fast path may redirect packets to.  Only
+// interfaces that can transmit XDP frames, i.e. the ones that we attach the XDP program to, may be
+// added.
+// WARNING: must be kept in sync with cali_xdp_tx in bpf-gpl/xdp.c.
+var TxMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_xdp_tx",
+	Type:       "devmap_hash",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 512,
+	Name:       "cali_xdp_tx",
+}
+
+func TxMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(TxMapParams)
+}
+
+// TxKeyValue returns the key and value of the cali_xdp_tx entry for the interface.
+func TxKeyValue(ifIndex int) (k, v []byte) {
+	k = make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(ifIndex))
+	return k, k
+}
+
+// CPUMapQueueSize is the number of packets that each CPU in the CPU map queues.
+const CPUMapQueueSize = 2048
+
+// CPUMapParams describes the CPU map, which the XDP program redirects Calico VXLAN packets through to
+// spread them over the CPUs.  The kernel limits its size to the number of CPUs that it supports, so
+// Felix sets it to the number of possible CPUs, see bpf.NumPossibleCPUs().
+// WARNING: must be kept in sync with cali_cpumap in bpf-gpl/xdp.c.
+var CPUMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_cpumap",
+	Type:       "cpumap",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 1,
+	Name:       "cali_cpumap",
+}
+
+func CPUMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(CPUMapParams)
+}
+
+// CPUMapKeyValue returns the key and value of the cali_cpumap entry for the CPU.
+func CPUMapKeyValue(cpu int) (k, v []byte) {
+	k = make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(cpu))
+	v = make([]byte, 4)
+	binary.LittleEndian.PutUint32(v, CPUMapQueueSize)
+	return k, v
+}
+
+// SetCPUMap adds the first cpus of the numCPUs CPUs to the CPU map and removes the others.  The
+// kernel starts a thread for each CPU in the map.
+func SetCPUMap(m bpf.Map, numCPUs, cpus int) error {
+	for cpu := 0; cpu < numCPUs; cpu++ {
+		k, v := CPUMapKeyValue(cpu)
+		var err error
+		if cpu < cpus {
+			err = m.Update(k, v)
+		} else {
+			err = m.Delete(k)
+			if bpf.IsNotExists(err) {
+				err = nil
+			}
+		}
+		if err != nil {
+			return fmt.Errorf("failed to set CPU %d in CPU map: %w", cpu, err)
+		}
+	}
+	return nil
+}
+
+// SynCookiePortsMapParams describes the set of TCP ports of host services whose SYNs the XDP
+// program answers with SYN cookies.
+// WARNING: must be kept in sync with cali_syncookie in bpf-gpl/syncookie.h.
+var SynCookiePortsMapParams = bpf.MapParameters{
+	Filename:   "/sys/fs/bpf/tc/globals/cali_syncookie",
+	Type:       "hash",
+	KeySize:    4,
+	ValueSize:  4,
+	MaxEntries: 256,
+	Name:       "cali_syncookie",
+	Flags:      unix.BPF_F_NO_PREALLOC,
+}
+
+func SynCookiePortsMap(mc *bpf.MapContext) bpf.Map {
+	return mc.NewPinnedMap(SynCookiePortsMapParams)
+}
+
+// SynCookiePortKeyValue returns the key and value of the cali_syncookie entry for the port.
+func SynCookiePortKeyValue(port uint16) (k, v []byte) {
+	k = make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(port))
+	v = make([]byte, 4)
+	binary.LittleEndian.PutUint32(v, 1)
+	return k, v
+}
+
+// SetSynCookiePorts makes the ports the only entries of the SYN cookie map.
+func SetSynCookiePorts(m bpf.Map, ports []uint16) error {
+	want := map[uint16]bool{}
+	for _, p := range ports {
+		want[p] = true
+	}
+
+	err := m.Iter(func(k, v []byte) bpf.IteratorAction {
+		if len(k) == 4 && want[uint16(binary.LittleEndian.Uint32(k))] {
+			return bpf.IterNone
+		}
+		return bpf.IterDelete
+	})
+	if err != nil {
+		return fmt.Errorf("failed to clean up SYN cookie ports: %w", err)
+	}
+
+	for p := range want {
+		k, v := SynCookiePortKeyValue(p)
+		err = m.Update(k, v)
+		if err != nil {
+			return fmt.Errorf("failed to add SYN cookie port %d: %w", p, err)
+		}
+	}
+	return nil
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package xdp
+
+import (
+	"encoding/binary"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/ip"
+)
+
+func TestPrefilterKeyRoundTrip(t *testing.T) {
+	RegisterTestingT(t)
+
+	cidr := ip.MustParseCIDROrIP("10.65.0.0/16").(ip.V4CIDR)
+	k := NewPrefilterKey(cidr)
+	Expect(k[:4]).To(Equal([]byte{16, 0, 0, 0}))
+	Expect(k[4:]).To(Equal([]byte{10, 65, 0, 0}))
+	Expect(PrefilterKeyFromBytes(k.AsBytes()).CIDR()).To(Equal(cidr))
+	Expect(k.String()).To(Equal("10.65.0.0/16"))
+}
+
+func TestPrefilterValueCounters(t *testing.T) {
+	RegisterTestingT(t)
+
+	b := make([]byte, PrefilterValueSize)
+	binary.LittleEndian.PutUint64(b[0:8], 3)
+	binary.LittleEndian.PutUint64(b[8:16], 180)
+	v := PrefilterValueFromBytes(b)
+	Expect(v.Packets()).To(Equal(uint64(3)))
+	Expect(v.Bytes()).To(Equal(uint64(180)))
+}
+
+func TestProgFilename(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(ProgFilename("Debug", false)).To(Equal("xdp_debug.o"))
+	Expect(ProgFilename("off", false)).To(Equal("xdp_no_log.o"))
+	Expect(ProgFilename("Info", true)).To(Equal("xdp_wep_info.o"))
+}
+
+func TestCPUMapKeyValue(t *testing.T) {
+	RegisterTestingT(t)
+
+	k, v := CPUMapKeyValue(3)
+	Expect(k).To(Equal([]byte{3, 0, 0, 0}))
+	Expect(v).To(Equal([]byte{0, 8, 0, 0}))
+}
+
+func TestSynCookiePortKeyValue(t *testing.T) {
+	RegisterTestingT(t)
+
+	k, v := SynCookiePortKeyValue(8443)
+	Expect(k).To(Equal([]byte{0xfb, 0x20, 0, 0}))
+	Expect(v).To(Equal([]byte{1, 0, 0, 0}))
+}
@@ -18,6 +18,7 @@ import (
 	"strings"
 
 	log "github.com/sirupsen/logrus"
+	"k8s.io/apimachinery/pkg/api/resource"
 
 	"fmt"
 
@@ -366,7 +367,31 @@ func ModelWorkloadEndpointToProto(ep *model.WorkloadEndpoint, tiers []*proto.Tie
 		Tiers:      tiers,
 		Ipv4Nat:    natsToProtoNatInfo(ep.IPv4NAT),
 		Ipv6Nat:    natsToProtoNatInfo(ep.IPv6NAT),
+
+		EgressBandwidth: egressBandwidth(ep),
+	}
+}
+
+// EgressBandwidthLabel is the label of a workload endpoint that limits the bandwidth that the
+// workload sends, as a quantity of bits per second, for example "10M".
+const EgressBandwidthLabel = "projectcalico.org/egress-bandwidth"
+
+// egressBandwidth returns the egress bandwidth limit of the endpoint in bits per second, or 0 if it
+// has none or it isn't valid.
+func egressBandwidth(ep *model.WorkloadEndpoint) uint64 {
+	value, ok := ep.Labels[EgressBandwidthLabel]
+	if !ok {
+		return 0
+	}
+	q, err := resource.ParseQuantity(value)
+	if err != nil || q.Sign() <= 0 {
+		log.WithError(err).WithFields(log.Fields{
+			"endpoint": ep.Name,
+			"value":    value,
+		}).Warn("Ignoring invalid egress bandwidth label.")
+		return 0
 	}
+	return uint64(q.Value())
 }
 
 func ModelHostEndpointToProto(ep *model.HostEndpoint, tiers, untrackedTiers, preDNATTiers []*proto.TierInfo, forwardTiers []*proto.TierInfo) *proto.HostEndpoint {
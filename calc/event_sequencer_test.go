@@ -64,6 +64,34 @@ var _ = DescribeTable("ModelWorkloadEndpointToProto",
 		},
 		Ipv6Nat: []*proto.NatInfo{},
 	}),
+	Entry("workload endpoint with an egress bandwidth limit", model.WorkloadEndpoint{
+		State:    "up",
+		Name:     "bill",
+		IPv4Nets: []net.IPNet{mustParseNet("10.28.0.13/32")},
+		Labels:   map[string]string{calc.EgressBandwidthLabel: "10M"},
+	}, proto.WorkloadEndpoint{
+		State:           "up",
+		Name:            "bill",
+		Ipv4Nets:        []string{"10.28.0.13/32"},
+		Ipv6Nets:        []string{},
+		Tiers:           []*proto.TierInfo{},
+		Ipv4Nat:         []*proto.NatInfo{},
+		Ipv6Nat:         []*proto.NatInfo{},
+		EgressBandwidth: 10000000,
+	}),
+	Entry("workload endpoint with an invalid egress bandwidth limit", model.WorkloadEndpoint{
+		State:  "up",
+		Name:   "bill",
+		Labels: map[string]string{calc.EgressBandwidthLabel: "fast"},
+	}, proto.WorkloadEndpoint{
+		State:    "up",
+		Name:     "bill",
+		Ipv4Nets: []string{},
+		Ipv6Nets: []string{},
+		Tiers:    []*proto.TierInfo{},
+		Ipv4Nat:  []*proto.NatInfo{},
+		Ipv6Nat:  []*proto.NatInfo{},
+	}),
 )
 
 var _ = Describe("ParsedRulesToActivePolicyUpdate", func() {
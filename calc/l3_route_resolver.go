@@ -643,6 +643,8 @@ func (c *L3RouteResolver) flush() {
 			Dst:        cidr.String(),
 		}
 		poolAllowsCrossSubnet := false
+		// wepNodeNames are the remote nodes that have a workload with this IP, if it isn't local.
+		var wepNodeNames []string
 		for _, entry := range buf {
 			ri := entry.Data.(RouteInfo)
 			if ri.Pool.Type != proto.IPPoolType_NONE {
@@ -693,6 +695,7 @@ func (c *L3RouteResolver) flush() {
 						rt.LocalWorkload = true
 					} else {
 						rt.Type = proto.RouteType_REMOTE_WORKLOAD
+						wepNodeNames = remoteWEPNodeNames(ri.Refs, c.myNodeName)
 					}
 				} else {
 					// This is a tunnel ref, set type and also store the tunnel type in the route. It is possible for
@@ -729,6 +732,19 @@ func (c *L3RouteResolver) flush() {
 				rt.DstNodeIp = dstNodeInfo.Addr.String()
 			}
 		}
+		if rt.Type == proto.RouteType_REMOTE_WORKLOAD && len(wepNodeNames) > 1 && rt.DstNodeIp != "" {
+			// Several remote nodes have a workload with this IP, an anycast address.  The BPF
+			// dataplane can spread the flows over all of them.
+			rt.DstNodeIps = []string{rt.DstNodeIp}
+			for _, name := range wepNodeNames[1:] {
+				if nodeInfo, exists := c.nodeNameToNodeInfo[name]; exists {
+					rt.DstNodeIps = append(rt.DstNodeIps, nodeInfo.Addr.String())
+				}
+			}
+			if len(rt.DstNodeIps) == 1 {
+				rt.DstNodeIps = nil
+			}
+		}
 		rt.SameSubnet = poolAllowsCrossSubnet && c.nodeInOurSubnet(rt.DstNodeName)
 
 		logrus.WithField("route", rt).Debug("Sending route")
@@ -739,6 +755,22 @@ func (c *L3RouteResolver) flush() {
 	})
 }
 
+// remoteWEPNodeNames returns the distinct nodes of the workload refs, in order, if they are all
+// remote workloads.
+func remoteWEPNodeNames(refs []Ref, myNodeName string) []string {
+	var names []string
+	for _, ref := range refs {
+		if ref.RefType != RefTypeWEP || ref.NodeName == myNodeName {
+			return nil
+		}
+		if len(names) > 0 && names[len(names)-1] == ref.NodeName {
+			continue
+		}
+		names = append(names, ref.NodeName)
+	}
+	return names
+}
+
 // nodeInOurSubnet returns true if the IP of the given node is known and it's in our subnet.
 // Return false if either the remote IP or our subnet is not known.
 func (c *L3RouteResolver) nodeInOurSubnet(name string) bool {
@@ -1067,7 +1067,7 @@ var vxlanWithWEPIPsAndWEP = vxlanWithWEPIPs.withKVUpdates(
 
 // Add in another workload with the same IP, but on a different node - remoteHost1.
 // Since this new host sorts lower than the original, its should mask the route of the
-// WEP on the other node.
+// WEP on the other node.  The route lists both nodes, for the BPF dataplane's ECMP.
 var vxlanWithWEPIPsAndWEPDuplicate = vxlanWithWEPIPsAndWEP.withKVUpdates(
 	KVPair{Key: remoteHostIPKey, Value: &remoteHostIP},
 	KVPair{Key: remoteHostVXLANTunnelConfigKey, Value: remoteHostVXLANTunnelIP},
@@ -1096,6 +1096,7 @@ var vxlanWithWEPIPsAndWEPDuplicate = vxlanWithWEPIPsAndWEP.withKVUpdates(
 		DstNodeName: remoteHostname,
 		DstNodeIp:   remoteHostIP.String(),
 		NatOutgoing: true,
+		DstNodeIps:  []string{remoteHostIP.String(), remoteHost2IP.String()},
 	},
 )
 
@@ -18,6 +18,7 @@ import (
 	"encoding/base64"
 	"fmt"
 	"net"
+	"os"
 	"strings"
 	"time"
 
@@ -53,6 +54,16 @@ var conntrackCmd = &cobra.Command{
 
 type conntrackDumpCmd struct {
 	*cobra.Command
+
+	proto  string
+	src    string
+	dst    string
+	sport  uint16
+	dport  uint16
+	addr   string
+	format string
+
+	filter ctFilter
 }
 
 func newConntrackDumpCmd() *cobra.Command {
@@ -60,9 +71,20 @@ func newConntrackDumpCmd() *cobra.Command {
 		Command: &cobra.Command{
 			Use:   "dump",
 			Short: "Dumps connection tracking table",
+			Long: "Dumps the connection tracking table, a batch of entries at a time.  The filters " +
+				"match either direction of a flow and, for the entries of NATed flows, the " +
+				"original destination too, so --dst and --dport can be a service.",
 		},
 	}
 
+	cmd.Flags().StringVar(&cmd.proto, "proto", "", "only dump this protocol (tcp, udp, icmp or a number)")
+	cmd.Flags().StringVar(&cmd.src, "src", "", "only dump the flows from this IPv4 address")
+	cmd.Flags().StringVar(&cmd.dst, "dst", "", "only dump the flows to this IPv4 address")
+	cmd.Flags().Uint16Var(&cmd.sport, "sport", 0, "only dump the flows from this port")
+	cmd.Flags().Uint16Var(&cmd.dport, "dport", 0, "only dump the flows to this port")
+	cmd.Flags().StringVar(&cmd.addr, "ip", "", "only dump the flows from or to this IPv4 address, e.g. an endpoint")
+	addDumpOutputFlag(cmd.Command, &cmd.format)
+
 	cmd.Command.Args = cmd.Args
 	cmd.Command.Run = cmd.Run
 
@@ -80,65 +102,193 @@ func (cmd *conntrackDumpCmd) Args(c *cobra.Command, args []string) error {
 		return errors.New(err.Error())
 	}
 
+	cmd.filter.proto, err = parseProto(cmd.proto)
+	if err != nil {
+		return err
+	}
+	for _, f := range []struct {
+		name, value string
+		addr        *net.IP
+	}{
+		{"src", cmd.src, &cmd.filter.src},
+		{"dst", cmd.dst, &cmd.filter.dst},
+		{"ip", cmd.addr, &cmd.filter.addr},
+	} {
+		*f.addr, err = parseIPv4Flag(f.name, f.value)
+		if err != nil {
+			return err
+		}
+	}
+	cmd.filter.sport = cmd.sport
+	cmd.filter.dport = cmd.dport
+
 	return nil
 }
 
 func (cmd *conntrackDumpCmd) Run(c *cobra.Command, _ []string) {
+	out, err := newDumpWriter(os.Stdout, cmd.format)
+	if err != nil {
+		log.WithError(err).Fatal("Bad output format")
+	}
+
 	mc := &bpf.MapContext{}
 	ctMap := conntrack.Map(mc)
 	if err := ctMap.Open(); err != nil {
 		log.WithError(err).Fatal("Failed to access ConntrackMap")
 	}
-	err := ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		var ctKey conntrack.Key
-		if len(k) != len(ctKey) {
-			log.Panic("Key has unexpected length")
-		}
-		copy(ctKey[:], k[:])
-
-		var ctVal conntrack.Value
-		if len(v) != len(ctVal) {
-			log.Panic("Value has unexpected length")
-		}
-		copy(ctVal[:], v[:])
-
-		fmt.Printf("%v -> %v", ctKey, ctVal)
-		dumpExtra(ctKey, ctVal)
-		fmt.Printf("\n")
-		return bpf.IterNone
+	err = bpf.LoadBatches(ctMap, func(keys, values []byte, n int) {
+		dumpConntrackBatch(out, &cmd.filter, bpf.KTimeNanos(), keys, values, n)
 	})
 	if err != nil {
 		log.WithError(err).Fatal("Failed to iterate over conntrack entries")
 	}
+	if err := out.Flush(); err != nil {
+		log.WithError(err).Fatal("Failed to write conntrack entries")
+	}
+}
+
+// ctFilter selects the conntrack entries that a dump writes.  The zero values match anything.
+type ctFilter struct {
+	proto uint8
+	src   net.IP
+	sport uint16
+	dst   net.IP
+	dport uint16
+	// addr matches either end of the flow.
+	addr net.IP
+}
+
+// matches returns whether the entry is of a flow that matches the filter in either direction.
+// NAT_REV entries are keyed on the backend, they also match as if it were the original
+// destination, which the entry records.
+func (f *ctFilter) matches(k conntrack.Key, v conntrack.Value) bool {
+	if f.proto != 0 && k.Proto() != f.proto {
+		return false
+	}
+	type end struct {
+		addr net.IP
+		port uint16
+	}
+	ends := []end{{k.AddrA(), k.PortA()}, {k.AddrB(), k.PortB()}}
+	if v.Type() == conntrack.TypeNATReverse {
+		ends = append(ends, end{v.OrigIP(), v.OrigPort()})
+	}
+	if f.addr != nil {
+		found := false
+		for _, e := range ends {
+			found = found || f.addr.Equal(e.addr)
+		}
+		if !found {
+			return false
+		}
+	}
+	for i, from := range ends {
+		for j, to := range ends {
+			if i == j {
+				continue
+			}
+			if ipPortMatches(from.addr, from.port, f.src, f.sport) &&
+				ipPortMatches(to.addr, to.port, f.dst, f.dport) {
+				return true
+			}
+		}
+	}
+	return false
 }
 
-func dumpExtra(k conntrack.Key, v conntrack.Value) {
-	now := bpf.KTimeNanos()
+// ctJSONEntry is the JSON output of a conntrack entry.
+type ctJSONEntry struct {
+	Proto     uint8  `json:"proto"`
+	AddrA     string `json:"addr_a"`
+	PortA     uint16 `json:"port_a"`
+	AddrB     string `json:"addr_b"`
+	PortB     uint16 `json:"port_b"`
+	Type      string `json:"type"`
+	Flags     uint8  `json:"flags"`
+	AgeNanos  int64  `json:"age_ns"`
+	IdleNanos int64  `json:"idle_ns"`
+	State     string `json:"state,omitempty"`
+	// OrigAddr and OrigPort are the original destination of a NAT_REV entry.
+	OrigAddr string `json:"orig_addr,omitempty"`
+	OrigPort uint16 `json:"orig_port,omitempty"`
+	// RevKey is the key of the NAT_REV entry of a NAT_FWD entry.
+	RevKey string `json:"rev_key,omitempty"`
+}
 
-	fmt.Printf(" Age: %s Active ago %s",
-		time.Duration(now-v.Created()), time.Duration(now-v.LastSeen()))
+var ctTypeNames = map[uint8]string{
+	conntrack.TypeNormal:     "normal",
+	conntrack.TypeNATForward: "nat_fwd",
+	conntrack.TypeNATReverse: "nat_rev",
+}
+
+// dumpConntrackBatch writes the entries of a batch that match the filter.
+func dumpConntrackBatch(out *dumpWriter, f *ctFilter, now int64, keys, values []byte, n int) {
+	for i := 0; i < n; i++ {
+		var k conntrack.Key
+		var v conntrack.Value
+		copy(k[:], keys[i*conntrack.KeySize:])
+		copy(v[:], values[i*conntrack.ValueSize:])
+		if !f.matches(k, v) {
+			continue
+		}
+
+		switch out.format {
+		case dumpFormatJSON:
+			e := ctJSONEntry{
+				Proto:     k.Proto(),
+				AddrA:     k.AddrA().String(),
+				PortA:     k.PortA(),
+				AddrB:     k.AddrB().String(),
+				PortB:     k.PortB(),
+				Type:      ctTypeNames[v.Type()],
+				Flags:     v.Flags(),
+				AgeNanos:  now - v.Created(),
+				IdleNanos: now - v.LastSeen(),
+				State:     ctState(k, v),
+			}
+			switch v.Type() {
+			case conntrack.TypeNATReverse:
+				e.OrigAddr = v.OrigIP().String()
+				e.OrigPort = v.OrigPort()
+			case conntrack.TypeNATForward:
+				e.RevKey = v.ReverseNATKey().String()
+			}
+			out.JSON(e)
+		case dumpFormatBinary:
+			out.Binary(k[:], v[:])
+		default:
+			out.Printf("%v -> %v", k, v)
+			out.Printf(" Age: %s Active ago %s",
+				time.Duration(now-v.Created()), time.Duration(now-v.LastSeen()))
+			if s := ctState(k, v); s != "" {
+				out.Printf(" %s", s)
+			}
+			out.Printf("\n")
+		}
+	}
+}
 
+// ctState returns the state of a TCP flow, or "" if the entry doesn't track it.
+func ctState(k conntrack.Key, v conntrack.Value) string {
 	if k.Proto() != conntrack.ProtoTCP {
-		return
+		return ""
 	}
 
 	if v.Type() == conntrack.TypeNATForward {
-		return
+		return ""
 	}
 
 	data := v.Data()
 
 	if (v.IsForwardDSR() && data.FINsSeenDSR()) || data.FINsSeen() {
-		fmt.Printf(" CLOSED")
-		return
+		return "CLOSED"
 	}
 
 	if data.Established() {
-		fmt.Printf(" ESTABLISHED")
-		return
+		return "ESTABLISHED"
 	}
 
-	fmt.Printf(" SYN-SENT")
+	return "SYN-SENT"
 }
 
 type conntrackRemoveCmd struct {
@@ -243,9 +393,7 @@ func runClean(c *cobra.Command, _ []string) {
 	// Disable debug if set while deleting
 	loglevel := log.GetLevel()
 	log.SetLevel(log.WarnLevel)
-	err := ctMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		return bpf.IterDelete
-	})
+	err := bpf.DeleteAll(ctMap)
 
 	log.SetLevel(loglevel)
 	if err != nil {
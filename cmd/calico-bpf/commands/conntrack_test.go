@@ -0,0 +1,93 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package commands
+
+import (
+	"bytes"
+	"net"
+	"testing"
+
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/conntrack"
+)
+
+var (
+	ctTestClient  = net.IPv4(10, 65, 0, 2).To4()
+	ctTestBackend = net.IPv4(10, 65, 1, 3).To4()
+	ctTestService = net.IPv4(10, 96, 0, 10).To4()
+)
+
+func TestConntrackFilter(t *testing.T) {
+	RegisterTestingT(t)
+
+	k := conntrack.NewKey(conntrack.ProtoTCP, ctTestClient, 40000, ctTestBackend, 8080)
+	v := conntrack.NewValueNATReverse(0, 0, 0, conntrack.Leg{}, conntrack.Leg{}, nil, ctTestService, 80)
+
+	for _, f := range []ctFilter{
+		{},
+		{proto: conntrack.ProtoTCP},
+		{src: ctTestClient, dst: ctTestBackend, dport: 8080},
+		// The other direction.
+		{src: ctTestBackend, sport: 8080, dst: ctTestClient},
+		// The original destination.
+		{dst: ctTestService, dport: 80},
+		{addr: ctTestService},
+		{addr: ctTestBackend, sport: 40000},
+	} {
+		Expect(f.matches(k, v)).To(BeTrue(), "%+v should match", f)
+	}
+
+	for _, f := range []ctFilter{
+		{proto: conntrack.ProtoUDP},
+		{src: ctTestClient, dport: 40000},
+		{dst: ctTestService, dport: 8080},
+		{addr: net.IPv4(10, 65, 0, 9).To4()},
+	} {
+		Expect(f.matches(k, v)).To(BeFalse(), "%+v should not match", f)
+	}
+
+	// Only NAT_REV entries record the original destination.
+	v = conntrack.NewValueNormal(0, 0, 0, conntrack.Leg{}, conntrack.Leg{})
+	f := ctFilter{dst: ctTestService}
+	Expect(f.matches(k, v)).To(BeFalse())
+}
+
+func TestConntrackDumpBatch(t *testing.T) {
+	RegisterTestingT(t)
+
+	k1 := conntrack.NewKey(conntrack.ProtoUDP, ctTestClient, 40000, ctTestBackend, 53)
+	v1 := conntrack.NewValueNormal(1000, 2000, 0, conntrack.Leg{}, conntrack.Leg{})
+	k2 := conntrack.NewKey(conntrack.ProtoUDP, ctTestClient, 40001, ctTestBackend, 53)
+	v2 := conntrack.NewValueNormal(1000, 2000, 0, conntrack.Leg{}, conntrack.Leg{})
+	keys := append(k1.AsBytes(), k2.AsBytes()...)
+	values := append(v1.AsBytes(), v2.AsBytes()...)
+	f := ctFilter{sport: 40001}
+
+	var buf bytes.Buffer
+	out, err := newDumpWriter(&buf, dumpFormatJSON)
+	Expect(err).NotTo(HaveOccurred())
+	dumpConntrackBatch(out, &f, 5000, keys, values, 2)
+	Expect(out.Flush()).To(Succeed())
+	Expect(buf.String()).To(MatchJSON(`{"proto":17,"addr_a":"10.65.0.2","port_a":40001,` +
+		`"addr_b":"10.65.1.3","port_b":53,"type":"normal","flags":0,"age_ns":4000,"idle_ns":3000}`))
+
+	buf.Reset()
+	out, err = newDumpWriter(&buf, dumpFormatBinary)
+	Expect(err).NotTo(HaveOccurred())
+	dumpConntrackBatch(out, &f, 5000, keys, values, 2)
+	Expect(out.Flush()).To(Succeed())
+	Expect(buf.Bytes()).To(Equal(append(k2.AsBytes(), v2.AsBytes()...)))
+}
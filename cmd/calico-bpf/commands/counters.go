@@ -0,0 +1,117 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package commands
+
+import (
+	"fmt"
+	"time"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/counters"
+
+	"github.com/pkg/errors"
+	log "github.com/sirupsen/logrus"
+	"github.com/spf13/cobra"
+)
+
+func init() {
+	countersCmd.AddCommand(countersDumpCmd)
+	countersCmd.AddCommand(countersLatencyCmd)
+	rootCmd.AddCommand(countersCmd)
+}
+
+var countersDumpCmd = &cobra.Command{
+	Use:   "dump",
+	Short: "dumps hot-path counters",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := dumpCounters(); err != nil {
+			log.WithError(err).Error("Failed to dump counters.")
+		}
+	},
+}
+
+var countersLatencyCmd = &cobra.Command{
+	Use:   "latency",
+	Short: "dumps the latency histograms of the TC programs",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := dumpLatency(); err != nil {
+			log.WithError(err).Error("Failed to dump latency.")
+		}
+	},
+}
+
+// countersCmd represents the counters command
+var countersCmd = &cobra.Command{
+	Use:   "counters",
+	Short: "Show BPF dataplane counters",
+}
+
+func dumpCounters() error {
+	countersMap := counters.Map(&bpf.MapContext{})
+
+	if err := countersMap.Open(); err != nil {
+		return errors.WithMessage(err, "failed to open map")
+	}
+
+	for hook := counters.Hook(0); hook < counters.MaxHook; hook++ {
+		c, err := counters.Read(countersMap, hook)
+		if err != nil {
+			return err
+		}
+		fmt.Printf("%s:\n", hook)
+		for idx, v := range c {
+			if v == 0 {
+				continue
+			}
+			fmt.Printf("  %-30s %d\n", counters.Counter(idx), v)
+		}
+		fmt.Printf("  %-30s %d\n", "dropped by policy (derived)", c.PolicyDropped())
+	}
+
+	return nil
+}
+
+func dumpLatency() error {
+	latMap := counters.ProgLatencyMap(&bpf.MapContext{})
+
+	if err := latMap.Open(); err != nil {
+		return errors.WithMessage(err, "failed to open map; is BPFProgramLatencyEnabled set?")
+	}
+
+	for hook := counters.ProgLatencyHook(0); hook < counters.MaxProgLatencyHook; hook++ {
+		for path := counters.ProgLatencyPath(0); path < counters.MaxProgLatencyPath; path++ {
+			l, err := counters.ReadProgLatency(latMap, hook, path)
+			if err != nil {
+				return err
+			}
+			var total uint64
+			for _, n := range l {
+				total += n
+			}
+			if total == 0 {
+				continue
+			}
+			fmt.Printf("%s/%s: %d packets\n", hook, path, total)
+			for i, n := range l {
+				if n == 0 {
+					continue
+				}
+				fmt.Printf("  < %-12s %d\n", time.Duration(uint64(1)<<uint(i+1)), n)
+			}
+		}
+	}
+
+	return nil
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package commands
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net"
+	"strconv"
+	"strings"
+
+	"github.com/pkg/errors"
+	"github.com/spf13/cobra"
+)
+
+// The dump commands read the maps a batch at a time, see bpf.LoadBatches, filter the entries as
+// they go and write them out straight away, so that they can run on a node with a full map
+// without holding the map in memory.  Apart from the default text output, they can write one
+// JSON object per line or the raw entries.
+const (
+	dumpFormatText   = "text"
+	dumpFormatJSON   = "json"
+	dumpFormatBinary = "binary"
+)
+
+// addDumpOutputFlag adds the --output flag, which selects the format of a dump command.
+func addDumpOutputFlag(cmd *cobra.Command, format *string) {
+	cmd.Flags().StringVarP(format, "output", "o", dumpFormatText,
+		"output format: text, json (one object per line) or binary (the raw map entries, key then value)")
+}
+
+// dumpWriter buffers the output of a dump command.  It remembers the first write error, which
+// Flush returns, so that the dumps don't have to check every write.
+type dumpWriter struct {
+	format string
+	w      *bufio.Writer
+	err    error
+}
+
+func newDumpWriter(out io.Writer, format string) (*dumpWriter, error) {
+	switch format {
+	case dumpFormatText, dumpFormatJSON, dumpFormatBinary:
+	default:
+		return nil, errors.Errorf("unknown output format %q", format)
+	}
+	return &dumpWriter{format: format, w: bufio.NewWriter(out)}, nil
+}
+
+// Printf writes text output.
+func (d *dumpWriter) Printf(format string, a ...interface{}) {
+	if d.err != nil {
+		return
+	}
+	_, d.err = fmt.Fprintf(d.w, format, a...)
+}
+
+// JSON writes v as a line of JSON.
+func (d *dumpWriter) JSON(v interface{}) {
+	if d.err != nil {
+		return
+	}
+	var b []byte
+	b, d.err = json.Marshal(v)
+	if d.err != nil {
+		return
+	}
+	b = append(b, '\n')
+	_, d.err = d.w.Write(b)
+}
+
+// Binary writes the raw bytes of an entry.
+func (d *dumpWriter) Binary(parts ...[]byte) {
+	for _, p := range parts {
+		if d.err != nil {
+			return
+		}
+		_, d.err = d.w.Write(p)
+	}
+}
+
+func (d *dumpWriter) Flush() error {
+	if d.err != nil {
+		return d.err
+	}
+	return d.w.Flush()
+}
+
+// parseProto parses a protocol flag, a name or a number; an empty flag is protocol 0, which
+// matches any protocol.
+func parseProto(proto string) (uint8, error) {
+	switch strings.ToLower(proto) {
+	case "":
+		return 0, nil
+	case "tcp":
+		return 6, nil
+	case "udp":
+		return 17, nil
+	case "icmp":
+		return 1, nil
+	}
+	p, err := strconv.ParseUint(proto, 0, 8)
+	if err != nil {
+		return 0, errors.Errorf("unknown protocol %q", proto)
+	}
+	return uint8(p), nil
+}
+
+// parseIPv4Flag parses an IPv4 address flag, an empty flag is a nil address.
+func parseIPv4Flag(name, value string) (net.IP, error) {
+	if value == "" {
+		return nil, nil
+	}
+	addr := net.ParseIP(value).To4()
+	if addr == nil {
+		return nil, errors.Errorf("--%s: %q is not an IPv4 address", name, value)
+	}
+	return addr, nil
+}
+
+// ipPortMatches returns whether the address and port match the filter's, a nil address or a zero
+// port match anything.
+func ipPortMatches(addr net.IP, port uint16, fAddr net.IP, fPort uint16) bool {
+	return (fAddr == nil || fAddr.Equal(addr)) && (fPort == 0 || fPort == port)
+}
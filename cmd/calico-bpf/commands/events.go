@@ -0,0 +1,252 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package commands
+
+import (
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"os/signal"
+	"strconv"
+	"strings"
+	"syscall"
+	"time"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/events"
+
+	"github.com/pkg/errors"
+	log "github.com/sirupsen/logrus"
+	"github.com/spf13/cobra"
+)
+
+func init() {
+	eventsCmd.AddCommand(eventsTailCmd)
+	eventsCaptureCmd.Flags().StringVar(&captureIface, "iface", "", "only capture on this interface")
+	eventsCaptureCmd.Flags().StringVar(&captureSrc, "src", "", "only capture packets from this IPv4 address")
+	eventsCaptureCmd.Flags().StringVar(&captureDst, "dst", "", "only capture packets to this IPv4 address")
+	eventsCaptureCmd.Flags().Uint16Var(&captureSport, "sport", 0, "only capture packets from this port")
+	eventsCaptureCmd.Flags().Uint16Var(&captureDport, "dport", 0, "only capture packets to this port")
+	eventsCaptureCmd.Flags().StringVar(&captureProto, "proto", "", "only capture this protocol (tcp, udp, icmp or a number)")
+	eventsCaptureCmd.Flags().StringVar(&captureVerdict, "verdict", "any", "only capture packets with this verdict (any, drop or allow)")
+	eventsCaptureCmd.Flags().StringVar(&captureReason, "reason", "", "only capture packets with this reason code, e.g. 0xbe")
+	eventsCaptureCmd.Flags().StringVarP(&captureFile, "write", "w", "-", "pcap file to write, - for stdout")
+	eventsCaptureCmd.Flags().IntVarP(&captureCount, "count", "c", 0, "stop after this many packets")
+	eventsCmd.AddCommand(eventsCaptureCmd)
+	rootCmd.AddCommand(eventsCmd)
+}
+
+var eventsTailCmd = &cobra.Command{
+	Use:   "tail",
+	Short: "prints sampled flow events as they arrive",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := tailEvents(); err != nil {
+			log.WithError(err).Error("Failed to read events.")
+		}
+	},
+}
+
+var (
+	captureIface   string
+	captureSrc     string
+	captureDst     string
+	captureSport   uint16
+	captureDport   uint16
+	captureProto   string
+	captureVerdict string
+	captureReason  string
+	captureFile    string
+	captureCount   int
+)
+
+var eventsCaptureCmd = &cobra.Command{
+	Use:   "capture",
+	Short: "captures the packets that match a filter, with their verdicts, as pcap",
+	Long: "Captures the first bytes of the packets that match the filter, at the point where " +
+		"the BPF programs decide their verdict, and writes them as pcap.  The verdicts are " +
+		"logged.  It reads the same ring buffer as \"events tail\" so only one of them can " +
+		"run at a time.  Requires BPFPacketCaptureEnabled or BPFEventsSampleRate to be set, which " +
+		"loads the programs that capture.",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := captureEvents(); err != nil {
+			log.WithError(err).Error("Failed to capture packets.")
+		}
+	},
+}
+
+// eventsCmd represents the events command
+var eventsCmd = &cobra.Command{
+	Use:   "events",
+	Short: "Reads sampled events, requires BPFEventsSampleRate to be set",
+}
+
+func tailEvents() error {
+	rb, err := events.OpenRingBuf(events.Map(&bpf.MapContext{}))
+	if err != nil {
+		return errors.WithMessage(err, "failed to open events ring buffer")
+	}
+	defer rb.Close()
+
+	for {
+		rb.Poll(func(record []byte) {
+			if t, err := events.EventType(record); err == nil && t == events.TypePacket {
+				// Captured by "events capture".
+				return
+			}
+			ev, err := events.ParseFlowEvent(record)
+			if err != nil {
+				log.WithError(err).Warn("Failed to parse event")
+				return
+			}
+			fmt.Printf("%s %s\n", time.Now().Format(time.StampMicro), ev)
+		})
+		if err := rb.Wait(time.Second); err != nil {
+			return err
+		}
+	}
+}
+
+func captureFilterFromFlags() (events.CaptureFilter, error) {
+	var f events.CaptureFilter
+
+	if captureIface != "" {
+		iface, err := net.InterfaceByName(captureIface)
+		if err != nil {
+			return f, errors.WithMessage(err, "failed to find interface")
+		}
+		f.IfIndex = uint32(iface.Index)
+	}
+	for _, a := range []struct {
+		flag string
+		ip   *net.IP
+	}{{captureSrc, &f.SrcAddr}, {captureDst, &f.DstAddr}} {
+		if a.flag == "" {
+			continue
+		}
+		ip := net.ParseIP(a.flag).To4()
+		if ip == nil {
+			return f, errors.Errorf("%s is not an IPv4 address", a.flag)
+		}
+		*a.ip = ip
+	}
+	f.SrcPort = captureSport
+	f.DstPort = captureDport
+
+	proto, err := parseProto(captureProto)
+	if err != nil {
+		return f, err
+	}
+	f.Proto = proto
+
+	switch strings.ToLower(captureVerdict) {
+	case "any":
+		f.Verdict = events.CaptureAny
+	case "drop":
+		f.Verdict = events.CaptureDropped
+	case "allow":
+		f.Verdict = events.CaptureAllowed
+	default:
+		return f, errors.Errorf("unknown verdict %q", captureVerdict)
+	}
+
+	if captureReason != "" {
+		r, err := strconv.ParseUint(captureReason, 0, 16)
+		if err != nil {
+			return f, errors.Errorf("bad reason %q", captureReason)
+		}
+		f.Reason = uint16(r)
+	}
+
+	return f, nil
+}
+
+func captureEvents() error {
+	filter, err := captureFilterFromFlags()
+	if err != nil {
+		return err
+	}
+
+	var out io.Writer = os.Stdout
+	if captureFile != "-" {
+		file, err := os.Create(captureFile)
+		if err != nil {
+			return errors.WithMessage(err, "failed to create pcap file")
+		}
+		defer file.Close()
+		out = file
+	}
+	pcap, err := events.NewPcapWriter(out)
+	if err != nil {
+		return errors.WithMessage(err, "failed to write pcap header")
+	}
+
+	rb, err := events.OpenRingBuf(events.Map(&bpf.MapContext{}))
+	if err != nil {
+		return errors.WithMessage(err, "failed to open events ring buffer")
+	}
+	defer rb.Close()
+
+	filterMap := events.CaptureFilterMap(&bpf.MapContext{})
+	if err := filterMap.Open(); err != nil {
+		return errors.WithMessage(err, "failed to open capture filter map")
+	}
+	if err := filterMap.Update(events.CaptureFilterKey, filter.AsBytes()); err != nil {
+		return errors.WithMessage(err, "failed to set capture filter")
+	}
+	defer func() {
+		if err := filterMap.Update(events.CaptureFilterKey, events.CaptureDisabled); err != nil {
+			log.WithError(err).Error("Failed to disable capture.")
+		}
+	}()
+
+	sigCh := make(chan os.Signal, 1)
+	signal.Notify(sigCh, syscall.SIGINT, syscall.SIGTERM)
+	defer signal.Stop(sigCh)
+
+	captured := 0
+	for {
+		rb.Poll(func(record []byte) {
+			if t, err := events.EventType(record); err != nil || t != events.TypePacket {
+				return
+			}
+			ev, err := events.ParsePacketEvent(record)
+			if err != nil {
+				log.WithError(err).Warn("Failed to parse packet event")
+				return
+			}
+			if captureCount > 0 && captured >= captureCount {
+				return
+			}
+			if err := pcap.WritePacket(time.Now(), ev); err != nil {
+				log.WithError(err).Warn("Failed to write packet")
+				return
+			}
+			captured++
+			log.Info(ev.String())
+		})
+		if captureCount > 0 && captured >= captureCount {
+			return nil
+		}
+		select {
+		case <-sigCh:
+			return nil
+		default:
+		}
+		if err := rb.Wait(time.Second); err != nil {
+			return err
+		}
+	}
+}
@@ -16,7 +16,9 @@ package commands
 
 import (
 	"fmt"
+	"os"
 	"sort"
+	"strconv"
 
 	"github.com/projectcalico/felix/bpf"
 	"github.com/projectcalico/felix/bpf/ipsets"
@@ -27,13 +29,23 @@ import (
 )
 
 func init() {
+	ipsetsDumpCmd.Flags().StringVar(&ipsetsDumpSet, "set", "", "only dump the IP set with this ID, e.g. 0x1234")
+	addDumpOutputFlag(ipsetsDumpCmd, &ipsetsDumpFormat)
 	ipsetsCmd.AddCommand(ipsetsDumpCmd)
 	rootCmd.AddCommand(ipsetsCmd)
 }
 
+var (
+	ipsetsDumpSet    string
+	ipsetsDumpFormat string
+)
+
 var ipsetsDumpCmd = &cobra.Command{
 	Use:   "dump",
 	Short: "dumps ipsets",
+	Long: "Dumps the IP set members, a batch at a time.  The text output is grouped by IP set, so " +
+		"it holds the matching members in memory; the json and binary outputs are written as " +
+		"the members load.",
 	Run: func(cmd *cobra.Command, args []string) {
 		if err := dumpIPSets(); err != nil {
 			log.WithError(err).Error("Failed to dump IP sets map.")
@@ -47,7 +59,26 @@ var ipsetsCmd = &cobra.Command{
 	Short: "Manipulates ipsets",
 }
 
+// ipsetJSONMember is the JSON output of an IP set member.
+type ipsetJSONMember struct {
+	Set    string `json:"set"`
+	Member string `json:"member"`
+}
+
 func dumpIPSets() error {
+	var setFilter uint64
+	if ipsetsDumpSet != "" {
+		var err error
+		setFilter, err = strconv.ParseUint(ipsetsDumpSet, 0, 64)
+		if err != nil {
+			return errors.Errorf("bad IP set ID %q", ipsetsDumpSet)
+		}
+	}
+	out, err := newDumpWriter(os.Stdout, ipsetsDumpFormat)
+	if err != nil {
+		return err
+	}
+
 	ipsetMap := ipsets.Map(&bpf.MapContext{})
 
 	if err := ipsetMap.Open(); err != nil {
@@ -55,21 +86,36 @@ func dumpIPSets() error {
 	}
 
 	membersBySet := map[uint64][]string{}
-	err := ipsetMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		var entry ipsets.IPSetEntry
-		copy(entry[:], k[:])
-		var member string
-		if entry.Protocol() == 0 {
-			member = fmt.Sprintf("%s/%d", entry.Addr(), entry.PrefixLen()-64)
-		} else {
-			member = fmt.Sprintf("%s:%d (proto %d)", entry.Addr(), entry.Port(), entry.Protocol())
+	err = bpf.LoadBatches(ipsetMap, func(keys, values []byte, n int) {
+		for i := 0; i < n; i++ {
+			var entry ipsets.IPSetEntry
+			copy(entry[:], keys[i*ipsets.IPSetEntrySize:])
+			if ipsetsDumpSet != "" && entry.SetID() != setFilter {
+				continue
+			}
+			if out.format == dumpFormatBinary {
+				out.Binary(entry[:])
+				continue
+			}
+			var member string
+			if entry.Protocol() == 0 {
+				member = fmt.Sprintf("%s/%d", entry.Addr(), entry.PrefixLen()-64)
+			} else {
+				member = fmt.Sprintf("%s:%d (proto %d)", entry.Addr(), entry.Port(), entry.Protocol())
+			}
+			if out.format == dumpFormatJSON {
+				out.JSON(ipsetJSONMember{Set: fmt.Sprintf("%#x", entry.SetID()), Member: member})
+				continue
+			}
+			membersBySet[entry.SetID()] = append(membersBySet[entry.SetID()], member)
 		}
-		membersBySet[entry.SetID()] = append(membersBySet[entry.SetID()], member)
-		return bpf.IterNone
 	})
 	if err != nil {
 		return err
 	}
+	if out.format != dumpFormatText {
+		return out.Flush()
+	}
 	var setIDs []uint64
 	for k, v := range membersBySet {
 		setIDs = append(setIDs, k)
@@ -79,15 +125,15 @@ func dumpIPSets() error {
 		return setIDs[i] < setIDs[j]
 	})
 	for _, setID := range setIDs {
-		fmt.Printf("IP set %#x\n", setID)
+		out.Printf("IP set %#x\n", setID)
 		for _, member := range membersBySet[setID] {
-			fmt.Println("  ", member)
+			out.Printf("   %s\n", member)
 		}
-		fmt.Println()
+		out.Printf("\n")
 	}
 	if len(setIDs) == 0 {
-		fmt.Println("No IP sets found.")
+		out.Printf("No IP sets found.\n")
 	}
 
-	return nil
+	return out.Flush()
 }
@@ -30,6 +30,12 @@ import (
 )
 
 func init() {
+	natDumpCmd.Flags().StringVar(&natDumpProto, "proto", "", "only dump the frontends of this protocol (tcp, udp or a number)")
+	natDumpCmd.Flags().StringVar(&natDumpIP, "ip", "", "only dump the frontends with this IPv4 address, e.g. a service")
+	natDumpCmd.Flags().Uint16Var(&natDumpPort, "port", 0, "only dump the frontends with this port")
+	natDumpCmd.Flags().StringVar(&natDumpBackend, "backend", "", "only dump the frontends with this IPv4 backend, e.g. an endpoint")
+	natDumpCmd.Flags().Uint16Var(&natDumpBackendPort, "backend-port", 0, "only dump the frontends with a backend with this port")
+	addDumpOutputFlag(natDumpCmd, &natDumpFormat)
 	natCmd.AddCommand(natDumpCmd)
 
 	natSetCmd.AddCommand(newNatSetFrontend())
@@ -51,9 +57,22 @@ var natCmd = &cobra.Command{
 		"which implements the bpf-based replacement for kube-proxy",
 }
 
+var (
+	natDumpProto       string
+	natDumpIP          string
+	natDumpPort        uint16
+	natDumpBackend     string
+	natDumpBackendPort uint16
+	natDumpFormat      string
+)
+
 var natDumpCmd = &cobra.Command{
 	Use:   "dump",
 	Short: "dumps the nat tables",
+	Long: "Dumps the NAT frontends, a batch at a time, with their backends, which it looks up " +
+		"one by one.  In binary output, each frontend's key and value are followed by the " +
+		"values of its backends, zero if missing; the frontend's value has their count, " +
+		"except that a black hole frontend has none.",
 	Run: func(cmd *cobra.Command, args []string) {
 		if err := dump(cmd); err != nil {
 			log.WithError(err).Error("Failed to dump NAT maps")
@@ -72,38 +91,173 @@ var natDelCmd = &cobra.Command{
 }
 
 func dump(cmd *cobra.Command) error {
-	mc := &bpf.MapContext{}
-	natMap, err := nat.LoadFrontendMap(nat.FrontendMap(mc))
+	filter, err := natFilterFromFlags()
+	if err != nil {
+		return err
+	}
+	out, err := newDumpWriter(cmd.OutOrStdout(), natDumpFormat)
 	if err != nil {
 		return err
 	}
 
-	back, err := nat.LoadBackendMap(nat.BackendMap(mc))
+	mc := &bpf.MapContext{}
+	feMap := nat.FrontendMap(mc)
+	if err := feMap.Open(); err != nil {
+		return err
+	}
+	beMap := nat.BackendMap(mc)
+	if err := beMap.Open(); err != nil {
+		return err
+	}
+	lookup := func(k nat.BackendKey) (nat.BackendValue, bool) {
+		var bv nat.BackendValue
+		v, err := beMap.Get(k.AsBytes())
+		if err != nil {
+			if !bpf.IsNotExists(err) {
+				log.WithError(err).WithField("key", k).Warn("Failed to look up NAT backend")
+			}
+			return bv, false
+		}
+		copy(bv[:], v)
+		return bv, true
+	}
+
+	err = nat.LoadFrontendBatches(feMap, func(k nat.FrontendKey, v nat.FrontendValue) {
+		dumpFrontend(out, &filter, lookup, k, v)
+	})
 	if err != nil {
 		return err
 	}
+	return out.Flush()
+}
 
-	dumpNice(cmd.Printf, natMap, back)
-	return nil
+// natFilter selects the frontends that "nat dump" writes.  The zero values match anything.
+type natFilter struct {
+	proto uint8
+	addr  net.IP
+	port  uint16
+	// backend and backendPort match the frontends that have a matching backend.
+	backend     net.IP
+	backendPort uint16
 }
 
-type printfFn func(format string, i ...interface{})
-
-func dumpNice(printf printfFn, natMap nat.MapMem, back nat.BackendMapMem) {
-	for nk, nv := range natMap {
-		count := nv.Count()
-		local := nv.LocalCount()
-		id := nv.ID()
-		printf("%s port %d proto %d id %d count %d local %d\n",
-			nk.Addr(), nk.Port(), nk.Proto(), id, count, local)
-		for i := uint32(0); i < count; i++ {
-			bk := nat.NewNATBackendKey(id, uint32(i))
-			bv, ok := back[bk]
-			printf("\t%d:%d\t ", id, i)
-			if !ok {
-				printf("is missing\n")
+func natFilterFromFlags() (natFilter, error) {
+	var f natFilter
+	var err error
+
+	f.proto, err = parseProto(natDumpProto)
+	if err != nil {
+		return f, err
+	}
+	f.addr, err = parseIPv4Flag("ip", natDumpIP)
+	if err != nil {
+		return f, err
+	}
+	f.backend, err = parseIPv4Flag("backend", natDumpBackend)
+	if err != nil {
+		return f, err
+	}
+	f.port = natDumpPort
+	f.backendPort = natDumpBackendPort
+	return f, nil
+}
+
+func (f *natFilter) filtersBackends() bool {
+	return f.backend != nil || f.backendPort != 0
+}
+
+// natBackendLookupFn returns the backend with the given key, if there is one.
+type natBackendLookupFn func(k nat.BackendKey) (nat.BackendValue, bool)
+
+// natJSONFrontend is the JSON output of a frontend and its backends.
+type natJSONFrontend struct {
+	Addr                string           `json:"addr"`
+	Port                uint16           `json:"port"`
+	Proto               uint8            `json:"proto"`
+	SrcCIDR             string           `json:"src_cidr,omitempty"`
+	ID                  uint32           `json:"id"`
+	Count               uint32           `json:"count"`
+	Local               uint32           `json:"local"`
+	AffinityTimeoutSecs int64            `json:"affinity_timeout_s,omitempty"`
+	Flags               uint32           `json:"flags,omitempty"`
+	BlackHole           bool             `json:"black_hole,omitempty"`
+	Backends            []natJSONBackend `json:"backends"`
+}
+
+type natJSONBackend struct {
+	Addr    string `json:"addr,omitempty"`
+	Port    uint16 `json:"port,omitempty"`
+	Missing bool   `json:"missing,omitempty"`
+}
+
+// dumpFrontend writes the frontend, with its backends, if it matches the filter.
+func dumpFrontend(out *dumpWriter, f *natFilter, lookup natBackendLookupFn, k nat.FrontendKey, v nat.FrontendValue) {
+	if f.proto != 0 && k.Proto() != f.proto {
+		return
+	}
+	if !ipPortMatches(k.Addr(), k.Port(), f.addr, f.port) {
+		return
+	}
+
+	id := v.ID()
+	count := v.Count()
+	blackHole := count == nat.BlackHoleCount
+	if blackHole {
+		// Tells the dataplane to look up the source ranges, it has no backends.
+		count = 0
+	}
+	backends := make([]nat.BackendValue, count)
+	found := make([]bool, count)
+	matched := !f.filtersBackends()
+	for i := uint32(0); i < count; i++ {
+		backends[i], found[i] = lookup(nat.NewNATBackendKey(id, i))
+		matched = matched ||
+			found[i] && ipPortMatches(backends[i].Addr(), backends[i].Port(), f.backend, f.backendPort)
+	}
+	if !matched {
+		return
+	}
+
+	switch out.format {
+	case dumpFormatJSON:
+		e := natJSONFrontend{
+			Addr:                k.Addr().String(),
+			Port:                k.Port(),
+			Proto:               k.Proto(),
+			ID:                  id,
+			Count:               count,
+			Local:               v.LocalCount(),
+			AffinityTimeoutSecs: int64(v.AffinityTimeout().Seconds()),
+			Flags:               v.Flags(),
+			BlackHole:           blackHole,
+			Backends:            make([]natJSONBackend, count),
+		}
+		if k.SrcPrefixLen() > 0 {
+			e.SrcCIDR = k.SrcCIDR().String()
+		}
+		for i := range backends {
+			if !found[i] {
+				e.Backends[i].Missing = true
+				continue
+			}
+			e.Backends[i].Addr = backends[i].Addr().String()
+			e.Backends[i].Port = backends[i].Port()
+		}
+		out.JSON(e)
+	case dumpFormatBinary:
+		out.Binary(k[:], v[:])
+		for i := range backends {
+			out.Binary(backends[i][:])
+		}
+	default:
+		out.Printf("%s port %d proto %d id %d count %d local %d\n",
+			k.Addr(), k.Port(), k.Proto(), id, v.Count(), v.LocalCount())
+		for i := range backends {
+			out.Printf("\t%d:%d\t ", id, i)
+			if !found[i] {
+				out.Printf("is missing\n")
 			} else {
-				printf("%s:%d\n", bv.Addr(), bv.Port())
+				out.Printf("%s:%d\n", backends[i].Addr(), backends[i].Port())
 			}
 		}
 	}
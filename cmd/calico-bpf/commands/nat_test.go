@@ -15,25 +15,72 @@
 package commands
 
 import (
-	"fmt"
+	"bytes"
 	"net"
 	"testing"
 
+	. "github.com/onsi/gomega"
+
 	nat2 "github.com/projectcalico/felix/bpf/nat"
 )
 
-func TestNATDump(t *testing.T) {
-	nat := nat2.MapMem{
+var (
+	testNATFrontends = nat2.MapMem{
 		nat2.NewNATKey(net.IPv4(1, 1, 1, 1), 80, 6):   nat2.NewNATValue(35, 2, 0, 0),
 		nat2.NewNATKey(net.IPv4(2, 1, 1, 1), 553, 17): nat2.NewNATValue(107, 1, 0, 0),
 		nat2.NewNATKey(net.IPv4(3, 1, 1, 1), 553, 17): nat2.NewNATValue(108, 1, 0, 0),
 	}
 
-	back := nat2.BackendMapMem{
+	testNATBackends = nat2.BackendMapMem{
 		nat2.NewNATBackendKey(35, 0):  nat2.NewNATBackendValue(net.IPv4(5, 5, 5, 5), 8080),
 		nat2.NewNATBackendKey(35, 1):  nat2.NewNATBackendValue(net.IPv4(6, 6, 6, 6), 8080),
 		nat2.NewNATBackendKey(108, 0): nat2.NewNATBackendValue(net.IPv4(3, 3, 3, 3), 553),
 	}
+)
+
+func dumpTestNAT(format string, f natFilter) string {
+	var buf bytes.Buffer
+	out, err := newDumpWriter(&buf, format)
+	Expect(err).NotTo(HaveOccurred())
+	lookup := func(k nat2.BackendKey) (nat2.BackendValue, bool) {
+		v, ok := testNATBackends[k]
+		return v, ok
+	}
+	for k, v := range testNATFrontends {
+		dumpFrontend(out, &f, lookup, k, v)
+	}
+	Expect(out.Flush()).To(Succeed())
+	return buf.String()
+}
+
+func TestNATDump(t *testing.T) {
+	RegisterTestingT(t)
+
+	out := dumpTestNAT(dumpFormatText, natFilter{})
+	Expect(out).To(ContainSubstring("1.1.1.1 port 80 proto 6 id 35 count 2 local 0\n" +
+		"\t35:0\t 5.5.5.5:8080\n\t35:1\t 6.6.6.6:8080\n"))
+	Expect(out).To(ContainSubstring("2.1.1.1 port 553 proto 17 id 107 count 1 local 0\n" +
+		"\t107:0\t is missing\n"))
+	Expect(out).To(ContainSubstring("3.1.1.1 port 553 proto 17 id 108 count 1 local 0\n"))
+}
+
+func TestNATDumpFilters(t *testing.T) {
+	RegisterTestingT(t)
+
+	Expect(dumpTestNAT(dumpFormatText, natFilter{proto: 6})).To(HavePrefix("1.1.1.1 port 80"))
+	Expect(dumpTestNAT(dumpFormatText, natFilter{addr: net.IPv4(3, 1, 1, 1).To4(), port: 553})).To(
+		HavePrefix("3.1.1.1 port 553"))
+	Expect(dumpTestNAT(dumpFormatText, natFilter{addr: net.IPv4(3, 1, 1, 1).To4(), port: 80})).To(BeEmpty())
+	Expect(dumpTestNAT(dumpFormatText, natFilter{backend: net.IPv4(6, 6, 6, 6).To4()})).To(
+		HavePrefix("1.1.1.1 port 80"))
+	Expect(dumpTestNAT(dumpFormatText, natFilter{backendPort: 553})).To(HavePrefix("3.1.1.1 port 553"))
+}
+
+func TestNATDumpJSON(t *testing.T) {
+	RegisterTestingT(t)
 
-	dumpNice(func(format string, i ...interface{}) { fmt.Printf(format, i...) }, nat, back)
+	out := dumpTestNAT(dumpFormatJSON, natFilter{proto: 17, addr: net.IPv4(2, 1, 1, 1).To4()})
+	Expect(out).To(MatchJSON(`{"addr":"2.1.1.1","port":553,"proto":17,"id":107,"count":1,"local":0,` +
+		`"backends":[{"missing":true}]}`))
+	Expect(out).To(HaveSuffix("}\n"))
 }
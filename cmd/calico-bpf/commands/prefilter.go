@@ -0,0 +1,134 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package commands
+
+import (
+	"fmt"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/xdp"
+	"github.com/projectcalico/felix/ip"
+
+	"github.com/pkg/errors"
+	log "github.com/sirupsen/logrus"
+	"github.com/spf13/cobra"
+)
+
+func init() {
+	prefilterCmd.AddCommand(prefilterDumpCmd)
+	prefilterCmd.AddCommand(prefilterAddCmd)
+	prefilterCmd.AddCommand(prefilterDelCmd)
+	rootCmd.AddCommand(prefilterCmd)
+}
+
+var prefilterDumpCmd = &cobra.Command{
+	Use:   "dump",
+	Short: "dumps the blocked CIDRs and their drop counters",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := dumpPrefilter(); err != nil {
+			log.WithError(err).Error("Failed to dump prefilter map.")
+		}
+	},
+}
+
+var prefilterAddCmd = &cobra.Command{
+	Use:   "add <CIDR>",
+	Short: "blocks traffic from a CIDR",
+	Args:  cobra.ExactArgs(1),
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := updatePrefilter(args[0], false); err != nil {
+			log.WithError(err).Error("Failed to add CIDR to prefilter map.")
+		}
+	},
+}
+
+var prefilterDelCmd = &cobra.Command{
+	Use:   "del <CIDR>",
+	Short: "unblocks traffic from a CIDR",
+	Args:  cobra.ExactArgs(1),
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := updatePrefilter(args[0], true); err != nil {
+			log.WithError(err).Error("Failed to remove CIDR from prefilter map.")
+		}
+	},
+}
+
+// prefilterCmd represents the prefilter command
+var prefilterCmd = &cobra.Command{
+	Use:   "prefilter",
+	Short: "Manipulates the XDP prefilter blocklist",
+}
+
+func openPrefilterMap() (bpf.Map, error) {
+	pfMap := xdp.PrefilterMap(&bpf.MapContext{})
+
+	if err := pfMap.Open(); err != nil {
+		return nil, errors.WithMessage(err, "failed to open map")
+	}
+
+	return pfMap, nil
+}
+
+func updatePrefilter(s string, del bool) error {
+	cidr, err := ip.ParseCIDROrIP(s)
+	if err != nil {
+		return err
+	}
+	v4CIDR, ok := cidr.(ip.V4CIDR)
+	if !ok {
+		return errors.Errorf("%s is not an IPv4 CIDR", s)
+	}
+
+	pfMap, err := openPrefilterMap()
+	if err != nil {
+		return err
+	}
+
+	k := xdp.NewPrefilterKey(v4CIDR)
+	if del {
+		return pfMap.Delete(k.AsBytes())
+	}
+
+	var v xdp.PrefilterValue
+	return pfMap.Update(k.AsBytes(), v.AsBytes())
+}
+
+func dumpPrefilter() error {
+	pfMap, err := openPrefilterMap()
+	if err != nil {
+		return err
+	}
+
+	var cidrs []ip.CIDR
+	valueByCIDR := map[ip.CIDR]xdp.PrefilterValue{}
+
+	err = pfMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		cidr := xdp.PrefilterKeyFromBytes(k).CIDR()
+		valueByCIDR[cidr] = xdp.PrefilterValueFromBytes(v)
+		cidrs = append(cidrs, cidr)
+		return bpf.IterNone
+	})
+	if err != nil {
+		return err
+	}
+
+	sortCIDRs(cidrs)
+
+	for _, cidr := range cidrs {
+		fmt.Printf("%18v: %s\n", cidr, valueByCIDR[cidr])
+	}
+
+	return nil
+}
@@ -15,7 +15,8 @@
 package commands
 
 import (
-	"fmt"
+	"net"
+	"os"
 	"sort"
 
 	"github.com/projectcalico/felix/bpf"
@@ -29,13 +30,22 @@ import (
 )
 
 func init() {
+	routesDumpCmd.Flags().StringVar(&routesDumpIP, "ip", "", "only dump the routes that contain this IPv4 address")
+	addDumpOutputFlag(routesDumpCmd, &routesDumpFormat)
 	routesCmd.AddCommand(routesDumpCmd)
 	rootCmd.AddCommand(routesCmd)
 }
 
+var (
+	routesDumpIP     string
+	routesDumpFormat string
+)
+
 var routesDumpCmd = &cobra.Command{
 	Use:   "dump",
 	Short: "dumps routes",
+	Long: "Dumps the routes, a batch at a time.  The text output is sorted, so it holds the " +
+		"matching routes in memory; the json and binary outputs are written as the routes load.",
 	Run: func(cmd *cobra.Command, args []string) {
 		if err := dumpRoutes(); err != nil {
 			log.WithError(err).Error("Failed to dump routes map.")
@@ -50,6 +60,15 @@ var routesCmd = &cobra.Command{
 }
 
 func dumpRoutes() error {
+	addr, err := parseIPv4Flag("ip", routesDumpIP)
+	if err != nil {
+		return err
+	}
+	out, err := newDumpWriter(os.Stdout, routesDumpFormat)
+	if err != nil {
+		return err
+	}
+
 	mc := &bpf.MapContext{}
 	routesMap := routes.Map(mc)
 
@@ -60,16 +79,24 @@ func dumpRoutes() error {
 	var dests []ip.CIDR
 	valueByDest := map[ip.CIDR]routes.Value{}
 
-	err := routesMap.Iter(func(k, v []byte) bpf.IteratorAction {
-		var key routes.Key
-		var value routes.Value
-		copy(key[:], k)
-		copy(value[:], v)
+	err = bpf.LoadBatches(routesMap, func(keys, values []byte, n int) {
+		for i := 0; i < n; i++ {
+			var key routes.Key
+			var value routes.Value
+			copy(key[:], keys[i*routes.KeySize:])
+			copy(value[:], values[i*routes.ValueSize:])
+			if !routeMatches(key, addr) {
+				continue
+			}
+			if out.format != dumpFormatText {
+				dumpRoute(out, key, value)
+				continue
+			}
 
-		dest := key.Dest()
-		valueByDest[dest] = value
-		dests = append(dests, dest)
-		return bpf.IterNone
+			dest := key.Dest()
+			valueByDest[dest] = value
+			dests = append(dests, dest)
+		}
 	})
 	if err != nil {
 		return err
@@ -79,10 +106,35 @@ func dumpRoutes() error {
 
 	for _, dest := range dests {
 		v := valueByDest[dest]
-		fmt.Printf("%15v: %s\n", dest, v)
+		out.Printf("%15v: %s\n", dest, v)
+	}
+
+	return out.Flush()
+}
+
+// routeMatches returns whether the route contains the address, a nil address matches any route.
+func routeMatches(k routes.Key, addr net.IP) bool {
+	if addr == nil {
+		return true
 	}
+	dest := k.Dest().ToIPNet()
+	return dest.Contains(addr)
+}
 
-	return nil
+// routeJSON is the JSON output of a route.
+type routeJSON struct {
+	Dest  string       `json:"dest"`
+	Flags routes.Flags `json:"flags"`
+	Desc  string       `json:"desc"`
+}
+
+// dumpRoute writes a route in json or binary output.
+func dumpRoute(out *dumpWriter, k routes.Key, v routes.Value) {
+	if out.format == dumpFormatBinary {
+		out.Binary(k[:], v[:])
+		return
+	}
+	out.JSON(routeJSON{Dest: k.Dest().String(), Flags: v.Flags(), Desc: v.String()})
 }
 
 func sortCIDRs(cidrs []ip.CIDR) {
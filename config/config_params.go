@@ -176,6 +176,56 @@ type Config struct {
 	BPFKubeProxyMinSyncPeriod          time.Duration  `config:"seconds;1"`
 	BPFKubeProxyEndpointSlicesEnabled  bool           `config:"bool;false"`
 	BPFExtToServiceConnmark            int            `config:"int;0"`
+	BPFMaglevEnabled                   bool           `config:"bool;false"`
+	BPFServiceLocalBackendWeight       int            `config:"int(1,100);1"`
+	BPFTopologyAwareHintsEnabled       bool           `config:"bool;false"`
+	BPFEventsSampleRate                int            `config:"int(0,1000000);0"`
+	BPFPacketCaptureEnabled            bool           `config:"bool;false"`
+	BPFXDPEnabled                      bool           `config:"bool;false"`
+	BPFXDPSynCookiePorts               []ProtoPort    `config:"port-list;"`
+	BPFXDPCPUSteeringEnabled           bool           `config:"bool;false"`
+	BPFXDPWorkloadsEnabled             bool           `config:"bool;false"`
+	BPFConntrackMapType                string         `config:"oneof(hash,lru_hash);hash;non-zero"`
+	BPFNATAffinityPerCPULRUEnabled     bool           `config:"bool;false"`
+	BPFConntrackAccountingEnabled      bool           `config:"bool;false"`
+	BPFNATOutgoingSNATEnabled          bool           `config:"bool;false"`
+	BPFEgressBandwidthShapingEnabled   bool           `config:"bool;false"`
+	BPFServiceCountersEnabled          bool           `config:"bool;false"`
+	BPFPolicyVerdictCacheEnabled       bool           `config:"bool;false"`
+	BPFIPSetMembersMapEnabled          bool           `config:"bool;false"`
+	BPFPolicyRuleGroupingEnabled       bool           `config:"bool;false"`
+	BPFPolicyRuleCountersEnabled       bool           `config:"bool;false"`
+	BPFLeanTunnelProgramsEnabled       bool           `config:"bool;false"`
+	BPFRedirectNeighEnabled            bool           `config:"bool;false"`
+	BPFAutoEnableKernelFeatures        bool           `config:"bool;false"`
+	BPFWorkloadInlineEnabled           bool           `config:"bool;false"`
+	BPFSharedProgramsEnabled           bool           `config:"bool;false"`
+	BPFInterfaceConfigMapEnabled       bool           `config:"bool;false"`
+	BPFProgramStatsEnabled             bool           `config:"bool;false"`
+	BPFProgramLatencyEnabled           bool           `config:"bool;false"`
+	BPFMapOccupancyRefreshInterval     time.Duration  `config:"seconds;60"`
+	BPFIPv6ConnectTimeLBEnabled        bool           `config:"bool;false"`
+	BPFConntrackKernelCleanupEnabled   bool           `config:"bool;false"`
+	BPFConntrackScanWorkers            int            `config:"int(1,64);1"`
+	BPFEndpointUpdateWorkers           int            `config:"int(0,1024);0"`
+	BPFConntrackScanCPUBudgetPercent   int            `config:"int(0,100);0"`
+	BPFNodePortTunnelPathMTUEnabled    bool           `config:"bool;false"`
+	BPFNodePortTunnelEnabled           bool           `config:"bool;true"`
+	BPFConntrackReplicationPort        int            `config:"int(0,65535);0"`
+	BPFConntrackReplicationPeers       []net.IP       `config:"ipv4-list;;die-on-fail"`
+	BPFConntrackReplicationKeyFile     string         `config:"file(must-exist);;local"`
+	BPFMapSizeConntrack                int            `config:"int(0,16777216);0"`
+	BPFMapSizeNATFrontend              int            `config:"int(0,16777216);0"`
+	BPFMapSizeNATBackend               int            `config:"int(0,16777216);0"`
+	BPFMapSizeNATAffinity              int            `config:"int(0,16777216);0"`
+	BPFMapSizeRoute                    int            `config:"int(0,16777216);0"`
+	BPFMapSizeIPSets                   int            `config:"int(0,16777216);0"`
+	BPFMapSizeARP                      int            `config:"int(0,16777216);0"`
+	BPFMapSizeCTNATs                   int            `config:"int(0,16777216);0"`
+	BPFMapSizeAutoEnabled              bool           `config:"bool;false"`
+	BPFMapSizeAutoMaxPods              int            `config:"int(1,100000);110"`
+	BPFMapNUMAReplicasEnabled          bool           `config:"bool;false"`
+	BPFConntrackNUMANode               int            `config:"int(-1,1023);-1"`
 
 	// DebugBPFCgroupV2 controls the cgroup v2 path that we apply the connect-time load balancer to.  Most distros
 	// are configured for cgroup v1, which prevents all but hte root cgroup v2 from working so this is only useful
@@ -301,6 +351,11 @@ type Config struct {
 	KubeNodePortRanges []numorstring.Port `config:"portrange-list;30000:32767"`
 	NATPortRange       numorstring.Port   `config:"portrange;"`
 	NATOutgoingAddress net.IP             `config:"ipv4;"`
+	// BPFNATOutgoingPortRange is the range of source ports that the BPF programs SNAT the
+	// NAT-outgoing flows to when BPFNATOutgoingSNATEnabled is set, it must not overlap
+	// NATPortRange.  Felix reserves it in ip_local_reserved_ports so that the host's own
+	// connections don't pick its ports.
+	BPFNATOutgoingPortRange numorstring.Port `config:"portrange;61000:65535"`
 
 	UsageReportingEnabled          bool          `config:"bool;true"`
 	UsageReportingInitialDelaySecs time.Duration `config:"seconds;300"`
@@ -329,8 +384,15 @@ type Config struct {
 	IptablesNATOutgoingInterfaceFilter string `config:"iface-param;"`
 
 	SidecarAccelerationEnabled bool `config:"bool;false"`
-	XDPEnabled                 bool `config:"bool;true"`
-	GenericXDPEnabled          bool `config:"bool;false"`
+	// SidecarAccelerationApplyBytes and SidecarAccelerationCorkBytes batch the messages that sidecar
+	// acceleration redirects: the redirect decision for a message is reused for the next ApplyBytes
+	// bytes and, if CorkBytes is set, the messages are held back until that many bytes have
+	// accumulated.  Corking delays short messages until the next ones arrive, so it only suits
+	// streaming traffic.  0 disables either of them.
+	SidecarAccelerationApplyBytes int  `config:"int(0,16777216);0"`
+	SidecarAccelerationCorkBytes  int  `config:"int(0,65536);0"`
+	XDPEnabled                    bool `config:"bool;true"`
+	GenericXDPEnabled             bool `config:"bool;false"`
 
 	Variant string `config:"string;Calico"`
 
@@ -661,12 +723,28 @@ func (config *Config) Validate() (err error) {
 		}
 	}
 
+	// The BPF programs and iptables MASQUERADE allocate NAT-outgoing ports independently and
+	// Linux conntrack doesn't know about the BPF programs' ports.
+	if config.BPFEnabled && config.BPFNATOutgoingSNATEnabled && config.NATPortRange.MaxPort > 0 &&
+		portRangesOverlap(config.NATPortRange, config.BPFNATOutgoingPortRange) {
+		err = fmt.Errorf("BPFNATOutgoingPortRange %v overlaps NATPortRange %v",
+			config.BPFNATOutgoingPortRange, config.NATPortRange)
+	}
+
+	if config.BPFConntrackReplicationPort != 0 && config.BPFConntrackReplicationKeyFile == "" {
+		err = errors.New("BPFConntrackReplicationPort is set but BPFConntrackReplicationKeyFile is not")
+	}
+
 	if err != nil {
 		config.Err = err
 	}
 	return
 }
 
+func portRangesOverlap(a, b numorstring.Port) bool {
+	return a.MinPort <= b.MaxPort && b.MinPort <= a.MaxPort
+}
+
 var knownParams map[string]param
 
 func loadParams() {
@@ -775,6 +853,8 @@ func loadParams() {
 				Msg: "invalid string"}
 		case "cidr-list":
 			param = &CIDRListParam{}
+		case "ipv4-list":
+			param = &IPv4ListParam{}
 		case "route-table-range":
 			param = &RouteTableRangeParam{}
 		case "keyvaluelist":
@@ -706,6 +706,32 @@ var _ = DescribeTable("Config validation",
 	Entry("invalid RouteTableRange", map[string]string{
 		"RouteTableRange": "abcde",
 	}, false),
+	Entry("BPFNATOutgoingPortRange outside NATPortRange", map[string]string{
+		"BPFEnabled":                "true",
+		"BPFNATOutgoingSNATEnabled": "true",
+		"NATPortRange":              "32768:60999",
+	}, true),
+	Entry("BPFNATOutgoingPortRange overlapping NATPortRange", map[string]string{
+		"BPFEnabled":                "true",
+		"BPFNATOutgoingSNATEnabled": "true",
+		"NATPortRange":              "32768:61000",
+	}, false),
+	Entry("BPFNATOutgoingPortRange overlapping NATPortRange without BPF SNAT", map[string]string{
+		"BPFEnabled":   "true",
+		"NATPortRange": "32768:61000",
+	}, true),
+	Entry("BPFConntrackReplicationPort without a key", map[string]string{
+		"BPFConntrackReplicationPort":  "4797",
+		"BPFConntrackReplicationPeers": "10.0.0.1,10.0.0.2",
+	}, false),
+	Entry("BPFConntrackReplicationPort with a key", map[string]string{
+		"BPFConntrackReplicationPort":    "4797",
+		"BPFConntrackReplicationPeers":   "10.0.0.1,10.0.0.2",
+		"BPFConntrackReplicationKeyFile": "/usr",
+	}, true),
+	Entry("BPFConntrackReplicationPeers with a CIDR", map[string]string{
+		"BPFConntrackReplicationPeers": "10.0.0.0/24",
+	}, false),
 )
 
 var _ = DescribeTable("Config InterfaceExclude",
@@ -521,6 +521,31 @@ func (c *CIDRListParam) Parse(raw string) (result interface{}, err error) {
 	return resultSlice, nil
 }
 
+type IPv4ListParam struct {
+	Metadata
+}
+
+func (p *IPv4ListParam) Parse(raw string) (result interface{}, err error) {
+	resultSlice := []net.IP{}
+	for _, in := range strings.Split(raw, ",") {
+		val := strings.Trim(in, " ")
+		if len(val) == 0 {
+			continue
+		}
+		ip := net.ParseIP(val)
+		if ip == nil {
+			err = p.parseFailed(in, "invalid IP "+val)
+			return
+		}
+		if ip.To4() == nil {
+			err = p.parseFailed(in, "invalid IP (not v4)")
+			return
+		}
+		resultSlice = append(resultSlice, ip.To4())
+	}
+	return resultSlice, nil
+}
+
 type RegionParam struct {
 	Metadata
 }
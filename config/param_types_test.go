@@ -15,6 +15,8 @@
 package config_test
 
 import (
+	"net"
+
 	"github.com/projectcalico/felix/config"
 
 	. "github.com/onsi/ginkgo/extensions/table"
@@ -60,6 +62,27 @@ var _ = DescribeTable("CIDR list parameter parsing",
 	Entry("Reject IPv6", "aabc::1111/32", []string{}, false),
 )
 
+var _ = DescribeTable("IPv4 list parameter parsing",
+	func(raw string, expected interface{}, expectSuccess bool) {
+		p := config.IPv4ListParam{config.Metadata{
+			Name: "IPs",
+		}}
+		actual, err := p.Parse(raw)
+		if expectSuccess {
+			Expect(err).To(BeNil())
+			Expect(actual).To(Equal(expected))
+		} else {
+			Expect(err).NotTo(BeNil())
+		}
+	},
+	Entry("Empty", "", []net.IP{}, true),
+	Entry("Single IPv4", "1.1.1.1", []net.IP{net.ParseIP("1.1.1.1").To4()}, true),
+	Entry("Two IPs extra commas", ",1.1.1.1, 2.2.2.2,",
+		[]net.IP{net.ParseIP("1.1.1.1").To4(), net.ParseIP("2.2.2.2").To4()}, true),
+	Entry("Reject CIDR", "1.1.1.0/24", nil, false),
+	Entry("Reject IPv6", "aabc::1111", nil, false),
+)
+
 var _ = DescribeTable("KeyValue list parameter parsing",
 	func(raw string, expected map[string]string) {
 		p := config.KeyValueListParam{config.Metadata{
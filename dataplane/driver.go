@@ -337,22 +337,77 @@ func StartDataplaneDriver(configParams *config.Config,
 			DebugSimulateDataplaneHangAfter:    configParams.DebugSimulateDataplaneHangAfter,
 			ExternalNodesCidrs:                 configParams.ExternalNodesCIDRList,
 			SidecarAccelerationEnabled:         configParams.SidecarAccelerationEnabled,
+			SidecarAccelerationApplyBytes:      configParams.SidecarAccelerationApplyBytes,
+			SidecarAccelerationCorkBytes:       configParams.SidecarAccelerationCorkBytes,
 			BPFEnabled:                         configParams.BPFEnabled,
 			BPFDisableUnprivileged:             configParams.BPFDisableUnprivileged,
 			BPFConnTimeLBEnabled:               configParams.BPFConnectTimeLoadBalancingEnabled,
 			BPFKubeProxyIptablesCleanupEnabled: configParams.BPFKubeProxyIptablesCleanupEnabled,
 			BPFLogLevel:                        configParams.BPFLogLevel,
 			BPFExtToServiceConnmark:            configParams.BPFExtToServiceConnmark,
-			BPFDataIfacePattern:                configParams.BPFDataIfacePattern,
-			BPFCgroupV2:                        configParams.DebugBPFCgroupV2,
-			BPFMapRepin:                        configParams.DebugBPFMapRepinEnabled,
-			KubeProxyMinSyncPeriod:             configParams.BPFKubeProxyMinSyncPeriod,
-			KubeProxyEndpointSlicesEnabled:     configParams.BPFKubeProxyEndpointSlicesEnabled,
-			XDPEnabled:                         configParams.XDPEnabled,
-			XDPAllowGeneric:                    configParams.GenericXDPEnabled,
-			BPFConntrackTimeouts:               conntrack.DefaultTimeouts(), // FIXME make timeouts configurable
-			RouteTableManager:                  routeTableIndexAllocator,
-			MTUIfacePattern:                    configParams.MTUIfacePattern,
+			BPFMaglevEnabled:                   configParams.BPFMaglevEnabled,
+			BPFServiceLocalBackendWeight:       configParams.BPFServiceLocalBackendWeight,
+			BPFTopologyAwareHintsEnabled:       configParams.BPFTopologyAwareHintsEnabled,
+			BPFEventsSampleRate:                configParams.BPFEventsSampleRate,
+			BPFPacketCaptureEnabled:            configParams.BPFPacketCaptureEnabled,
+			BPFXDPEnabled:                      configParams.BPFXDPEnabled,
+			BPFXDPSynCookiePorts:               configParams.BPFXDPSynCookiePorts,
+			BPFXDPCPUSteeringEnabled:           configParams.BPFXDPCPUSteeringEnabled,
+			BPFXDPWorkloadsEnabled:             configParams.BPFXDPWorkloadsEnabled,
+			BPFConntrackMapType:                configParams.BPFConntrackMapType,
+			BPFNATAffinityPerCPULRU:            configParams.BPFNATAffinityPerCPULRUEnabled,
+			BPFConntrackAccounting:             configParams.BPFConntrackAccountingEnabled,
+			BPFNATOutgoingSNAT:                 configParams.BPFNATOutgoingSNATEnabled,
+			BPFNATOutgoingPortRange:            configParams.BPFNATOutgoingPortRange,
+			BPFEgressBandwidthShaping:          configParams.BPFEgressBandwidthShapingEnabled,
+			BPFServiceCountersEnabled:          configParams.BPFServiceCountersEnabled,
+			BPFPolicyVerdictCacheEnabled:       configParams.BPFPolicyVerdictCacheEnabled,
+			BPFIPSetMembersMapEnabled:          configParams.BPFIPSetMembersMapEnabled,
+			BPFPolicyRuleGroupingEnabled:       configParams.BPFPolicyRuleGroupingEnabled,
+			BPFLeanTunnelProgramsEnabled:       configParams.BPFLeanTunnelProgramsEnabled,
+			BPFPolicyRuleCountersEnabled:       configParams.BPFPolicyRuleCountersEnabled,
+			BPFRedirectNeighEnabled:            configParams.BPFRedirectNeighEnabled,
+			BPFAutoEnableKernelFeatures:        configParams.BPFAutoEnableKernelFeatures,
+			BPFWorkloadInlineEnabled:           configParams.BPFWorkloadInlineEnabled,
+			BPFSharedProgramsEnabled:           configParams.BPFSharedProgramsEnabled,
+			BPFInterfaceConfigMapEnabled:       configParams.BPFInterfaceConfigMapEnabled,
+			BPFProgramStatsEnabled:             configParams.BPFProgramStatsEnabled,
+			BPFProgramLatencyEnabled:           configParams.BPFProgramLatencyEnabled,
+			BPFMapOccupancyRefreshInterval:     configParams.BPFMapOccupancyRefreshInterval,
+			BPFIPv6ConnTimeLBEnabled:           configParams.BPFIPv6ConnectTimeLBEnabled,
+			BPFConntrackKernelCleanup:          configParams.BPFConntrackKernelCleanupEnabled,
+			BPFConntrackScanWorkers:            configParams.BPFConntrackScanWorkers,
+			BPFEndpointUpdateWorkers:           configParams.BPFEndpointUpdateWorkers,
+			BPFConntrackScanCPUBudgetPercent:   configParams.BPFConntrackScanCPUBudgetPercent,
+			BPFNodePortTunnelPathMTUEnabled:    configParams.BPFNodePortTunnelPathMTUEnabled,
+			BPFNodePortTunnelEnabled:           configParams.BPFNodePortTunnelEnabled,
+			BPFConntrackReplicationPort:        configParams.BPFConntrackReplicationPort,
+			BPFConntrackReplicationPeers:       configParams.BPFConntrackReplicationPeers,
+			BPFConntrackReplicationKeyFile:     configParams.BPFConntrackReplicationKeyFile,
+			BPFMapSizes: intdataplane.BPFMapSizes{
+				Conntrack:   configParams.BPFMapSizeConntrack,
+				NATFrontend: configParams.BPFMapSizeNATFrontend,
+				NATBackend:  configParams.BPFMapSizeNATBackend,
+				NATAffinity: configParams.BPFMapSizeNATAffinity,
+				Routes:      configParams.BPFMapSizeRoute,
+				IPSets:      configParams.BPFMapSizeIPSets,
+				ARP:         configParams.BPFMapSizeARP,
+				CTNATs:      configParams.BPFMapSizeCTNATs,
+				AutoEnabled: configParams.BPFMapSizeAutoEnabled,
+				AutoMaxPods: configParams.BPFMapSizeAutoMaxPods,
+			},
+			BPFMapNUMAReplicasEnabled:      configParams.BPFMapNUMAReplicasEnabled,
+			BPFConntrackNUMANode:           configParams.BPFConntrackNUMANode,
+			BPFDataIfacePattern:            configParams.BPFDataIfacePattern,
+			BPFCgroupV2:                    configParams.DebugBPFCgroupV2,
+			BPFMapRepin:                    configParams.DebugBPFMapRepinEnabled,
+			KubeProxyMinSyncPeriod:         configParams.BPFKubeProxyMinSyncPeriod,
+			KubeProxyEndpointSlicesEnabled: configParams.BPFKubeProxyEndpointSlicesEnabled,
+			XDPEnabled:                     configParams.XDPEnabled,
+			XDPAllowGeneric:                configParams.GenericXDPEnabled,
+			BPFConntrackTimeouts:           conntrack.DefaultTimeouts(), // FIXME make timeouts configurable
+			RouteTableManager:              routeTableIndexAllocator,
+			MTUIfacePattern:                configParams.MTUIfacePattern,
 
 			KubeClientSet: k8sClientSet,
 
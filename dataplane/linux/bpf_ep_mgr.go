@@ -19,7 +19,9 @@ package intdataplane
 import (
 	"bytes"
 	"context"
+	"crypto/sha256"
 	"encoding/binary"
+	"encoding/hex"
 	"encoding/json"
 	"errors"
 	"fmt"
@@ -30,22 +32,30 @@ import (
 	"regexp"
 	"runtime"
 	"sort"
+	"strconv"
 	"strings"
 	"sync"
 	"time"
 
 	"github.com/prometheus/client_golang/prometheus"
 	log "github.com/sirupsen/logrus"
+	"github.com/vishvananda/netlink"
 	"golang.org/x/sync/semaphore"
 	"golang.org/x/sys/unix"
 
 	"github.com/projectcalico/felix/logutils"
 
+	cprometheus "github.com/projectcalico/libcalico-go/lib/prometheus"
 	"github.com/projectcalico/libcalico-go/lib/set"
 
 	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/asm"
+	"github.com/projectcalico/felix/bpf/edt"
+	"github.com/projectcalico/felix/bpf/ifcfg"
+	"github.com/projectcalico/felix/bpf/polcache"
 	"github.com/projectcalico/felix/bpf/polprog"
 	"github.com/projectcalico/felix/bpf/tc"
+	"github.com/projectcalico/felix/bpf/xdp"
 	"github.com/projectcalico/felix/idalloc"
 	"github.com/projectcalico/felix/ifacemonitor"
 	"github.com/projectcalico/felix/iptables"
@@ -68,12 +78,32 @@ var (
 		Name: "felix_bpf_happy_dataplane_endpoints",
 		Help: "Number of BPF endpoints that are successfully programmed.",
 	})
+	summaryBPFProgramAttachTime = cprometheus.NewSummary(prometheus.SummaryOpts{
+		Name: "felix_bpf_program_attach_seconds",
+		Help: "Time taken to load and attach a BPF program to an interface, including verification.",
+	})
+	bpfProgramVerifiedInsnsGauge = prometheus.NewGaugeVec(prometheus.GaugeOpts{
+		Name: "felix_bpf_program_verified_insns",
+		Help: "Number of instructions that the verifier processed when it last loaded the BPF program.",
+	}, []string{"program"})
+	bpfEndpointUpdatesQueuedGauge = prometheus.NewGauge(prometheus.GaugeOpts{
+		Name: "felix_bpf_endpoint_updates_queued",
+		Help: "Number of BPF endpoints that are waiting for a worker to update their programs and policy.",
+	})
+	summaryBPFEndpointUpdateTime = cprometheus.NewSummary(prometheus.SummaryOpts{
+		Name: "felix_bpf_endpoint_update_seconds",
+		Help: "Time taken to update the programs and policy of a BPF endpoint, once a worker picked it up.",
+	})
 )
 
 func init() {
 	prometheus.MustRegister(bpfEndpointsGauge)
 	prometheus.MustRegister(bpfDirtyEndpointsGauge)
 	prometheus.MustRegister(bpfHappyEndpointsGauge)
+	prometheus.MustRegister(summaryBPFProgramAttachTime)
+	prometheus.MustRegister(bpfProgramVerifiedInsnsGauge)
+	prometheus.MustRegister(bpfEndpointUpdatesQueuedGauge)
+	prometheus.MustRegister(summaryBPFEndpointUpdateTime)
 }
 
 type bpfDataplane interface {
@@ -83,6 +113,21 @@ type bpfDataplane interface {
 	updatePolicyProgram(jumpMapFD bpf.MapFD, rules polprog.Rules) error
 	removePolicyProgram(jumpMapFD bpf.MapFD) error
 	setAcceptLocal(iface string, val bool) error
+	interfaceOwningIP(ip net.IP) (int, error)
+	ensureXDPAttached(ap *xdp.AttachPoint) error
+	ensureXDPDetached(iface string) error
+	updateXDPPolicy(ap *xdp.AttachPoint, rules *polprog.Rules) error
+	ensureFQ(iface string) error
+	updateEgressBandwidth(iface string, bitsPerSec uint64) error
+}
+
+// bpfExactIPSets tells the endpoint manager which IP sets can be looked up in the exact-match IP
+// set map, see bpfipsets.ExactMapParameters, and which are stored in the member map, see
+// bpfipsets.MembersMapParameters.
+type bpfExactIPSets interface {
+	IPSetIsExact(id uint64) bool
+	IPSetMemberBit(id uint64) (int, bool)
+	TakeIPSetsWithNewPrefixes() []string
 }
 
 type bpfInterface struct {
@@ -102,6 +147,28 @@ type bpfInterfaceInfo struct {
 
 type bpfInterfaceState struct {
 	jumpMapFDs [2]bpf.MapFD
+	// wepProgIfIndex is the ifindex under which the to-workload program of the interface is in the
+	// cali_wep_progs map, or 0.
+	wepProgIfIndex int
+	// polProgsIfIndex is the ifindex under which the policy trampolines of the interface's shared
+	// programs are in the cali_pol_progs map, or 0.
+	polProgsIfIndex int
+	// ifaceCfgIfIndex is the ifindex under which the configuration of the interface is in the
+	// cali_v4_ifcfg map, or 0.
+	ifaceCfgIfIndex int
+	// edtIfIndex is the ifindex under which the egress bandwidth limit of the workload is in the
+	// cali_v4_edt map, or 0, and edtRate is the limit.
+	edtIfIndex int
+	edtRate    uint64
+	// xdpProgID is the ID of the XDP program that we attached to the interface and xdpAP the
+	// attach point that we attached it with, so that we only reattach it when it changes.  An ID of
+	// -1 means that we made sure that none of our XDP programs is attached.
+	xdpProgID int
+	xdpAP     *xdp.AttachPoint
+	// progIDs are the IDs of the programs that we attached to the interface and the files that
+	// they came from, for the program statistics.
+	progIDs   [2]int
+	progFiles [2]string
 }
 
 type bpfEndpointManager struct {
@@ -133,9 +200,77 @@ type bpfEndpointManager struct {
 	vxlanPort               uint16
 	dsrEnabled              bool
 	bpfExtToServiceConnmark int
-
-	ipSetMap bpf.Map
-	stateMap bpf.Map
+	bpfEventsSampleRate     int
+	bpfPacketCapture        bool
+	xdpEnabled              bool
+	xdpAllowGeneric         bool
+	ctLRU                   bool
+	natAffPerCPULRU         bool
+	redirectNeigh           bool
+	polRuleGrouping         bool
+	leanTunnel              bool
+	xdpSynCookies           bool
+	xdpCPUSteering          uint32
+	// xdpWorkloads attaches the from-workload variant of the XDP program to the workload veths.
+	xdpWorkloads bool
+	ctAccounting bool
+	// svcCounters makes the programs count the NAT lookups of new flows per service, see
+	// nat.ServiceCountersMapParams.
+	svcCounters bool
+	// natOutgoingPortMin and natOutgoingPortMax are the source ports to which the workload
+	// programs SNAT the NAT-outgoing flows themselves, a zero natOutgoingPortMax leaves the SNAT to
+	// iptables.
+	natOutgoingPortMin uint16
+	natOutgoingPortMax uint16
+	// endpointWorkers bounds the number of interfaces that are updated in parallel, 0 means one
+	// per CPU.
+	endpointWorkers int
+	gsoSize         bool
+	ktimeCoarse     bool
+	mapSizes        map[string]uint32
+	// numaReplicas is set if the read-mostly maps have a replica on the second NUMA node, see
+	// bpf.NUMAReplicatedMap.
+	numaReplicas bool
+	mapNUMANodes map[string]int
+	progVariant  tc.ProgVariant
+
+	ipSetMap      bpf.Map
+	ipSetExactMap bpf.Map
+	// ipSetMembersMap is set if IP sets may be stored in the member map.
+	ipSetMembersMap bpf.Map
+	exactIPSets     bpfExactIPSets
+	stateMap        bpf.Map
+	xdpTxMap        bpf.Map
+	// wepProgsMap is set if packets from host endpoints to local workloads are delivered inline,
+	// see tc.WEPProgsMapParams.
+	wepProgsMap bpf.Map
+	// polProgsMap is set if the programs are shared between interfaces, see
+	// tc.AttachPoint.AttachSharedProgram.
+	polProgsMap bpf.Map
+	// ifaceCfgMap is set if the programs read their per-interface values from the map rather than
+	// having them patched in, see ifcfg.MapParams.
+	ifaceCfgMap bpf.Map
+	// edtMap is set if the programs of the host endpoints shape the egress bandwidth of the
+	// workloads, see edt.MapParams.
+	edtMap bpf.Map
+	// ruleCountersMap is set if the policy programs count the packets that each rule matches, see
+	// counters.RuleMapParams.  ruleCounterIDs maps the counters' keys back to the rules.
+	ruleCountersMap    bpf.Map
+	ruleCounterIDsLock sync.Mutex
+	ruleCounterIDs     map[uint64]polprog.RuleCounterID
+	// sharedPolicies holds the policy program chains that the attach points of the shared
+	// programs share, keyed on the variant and the hash of the chain, see
+	// updateSharedPolicyProgram.  sharedPolicyOf maps the jump map of each attach point to the
+	// key of the chain that it uses.
+	sharedPoliciesLock sync.Mutex
+	sharedPolicies     map[string]*sharedPolicyProg
+	sharedPolicyOf     map[bpf.MapFD]string
+	// progLatencyMap is set if the programs record how long they take with each packet, see
+	// counters.ProgLatencyMapParams.
+	progLatencyMap bpf.Map
+	// polGeneration is set if the policy verdict cache is enabled; it is bumped whenever a policy
+	// program changes.
+	polGeneration *polcache.Generation
 
 	ruleRenderer        bpfAllowChainRenderer
 	iptablesFilterTable iptablesTable
@@ -174,8 +309,40 @@ func newBPFEndpointManager(
 	vxlanPort uint16,
 	dsrEnabled bool,
 	bpfExtToServiceConnmark int,
+	bpfEventsSampleRate int,
+	bpfPacketCapture bool,
+	xdpEnabled bool,
+	xdpAllowGeneric bool,
+	ctLRU bool,
+	natAffPerCPULRU bool,
+	redirectNeigh bool,
+	polRuleGrouping bool,
+	leanTunnel bool,
+	xdpSynCookies bool,
+	xdpCPUSteering uint32,
+	xdpWorkloads bool,
+	ctAccounting bool,
+	svcCounters bool,
+	natOutgoingPortMin uint16,
+	natOutgoingPortMax uint16,
+	endpointWorkers int,
+	mapSizes map[string]uint32,
+	numaReplicas bool,
+	mapNUMANodes map[string]int,
+	progVariant tc.ProgVariant,
 	ipSetMap bpf.Map,
+	ipSetExactMap bpf.Map,
+	ipSetMembersMap bpf.Map,
+	exactIPSets bpfExactIPSets,
 	stateMap bpf.Map,
+	xdpTxMap bpf.Map,
+	wepProgsMap bpf.Map,
+	polProgsMap bpf.Map,
+	ifaceCfgMap bpf.Map,
+	edtMap bpf.Map,
+	ruleCountersMap bpf.Map,
+	progLatencyMap bpf.Map,
+	polGeneration *polcache.Generation,
 	iptablesRuleRenderer bpfAllowChainRenderer,
 	iptablesFilterTable iptablesTable,
 	livenessCallback func(),
@@ -205,8 +372,44 @@ func newBPFEndpointManager(
 		vxlanPort:               vxlanPort,
 		dsrEnabled:              dsrEnabled,
 		bpfExtToServiceConnmark: bpfExtToServiceConnmark,
+		bpfEventsSampleRate:     bpfEventsSampleRate,
+		bpfPacketCapture:        bpfPacketCapture,
+		xdpEnabled:              xdpEnabled,
+		xdpAllowGeneric:         xdpAllowGeneric,
+		ctLRU:                   ctLRU,
+		natAffPerCPULRU:         natAffPerCPULRU,
+		redirectNeigh:           redirectNeigh,
+		polRuleGrouping:         polRuleGrouping,
+		leanTunnel:              leanTunnel,
+		xdpSynCookies:           xdpSynCookies,
+		xdpCPUSteering:          xdpCPUSteering,
+		xdpWorkloads:            xdpWorkloads,
+		ctAccounting:            ctAccounting,
+		svcCounters:             svcCounters,
+		natOutgoingPortMin:      natOutgoingPortMin,
+		natOutgoingPortMax:      natOutgoingPortMax,
+		endpointWorkers:         endpointWorkers,
+		gsoSize:                 bpf.SupportsGSOSize() == nil,
+		ktimeCoarse:             bpf.SupportsKtimeCoarse() == nil,
+		mapSizes:                mapSizes,
+		numaReplicas:            numaReplicas,
+		mapNUMANodes:            mapNUMANodes,
+		progVariant:             progVariant,
 		ipSetMap:                ipSetMap,
+		ipSetExactMap:           ipSetExactMap,
+		ipSetMembersMap:         ipSetMembersMap,
+		exactIPSets:             exactIPSets,
 		stateMap:                stateMap,
+		xdpTxMap:                xdpTxMap,
+		wepProgsMap:             wepProgsMap,
+		polProgsMap:             polProgsMap,
+		ifaceCfgMap:             ifaceCfgMap,
+		ruleCountersMap:         ruleCountersMap,
+		progLatencyMap:          progLatencyMap,
+		ruleCounterIDs:          map[uint64]polprog.RuleCounterID{},
+		sharedPolicies:          map[string]*sharedPolicyProg{},
+		sharedPolicyOf:          map[bpf.MapFD]string{},
+		polGeneration:           polGeneration,
 		ruleRenderer:            iptablesRuleRenderer,
 		iptablesFilterTable:     iptablesFilterTable,
 		mapCleanupRunner: ratelimited.NewRunner(jumpMapCleanupInterval, func(ctx context.Context) {
@@ -469,6 +672,40 @@ func (m *bpfEndpointManager) markEndpointsDirty(ids set.Set, kind string) {
 	})
 }
 
+// markEndpointsUsingIPSetsDirty marks the endpoints whose policies or profiles match on any of the
+// given IP sets as dirty so that their policy programs get regenerated.
+func (m *bpfEndpointManager) markEndpointsUsingIPSetsDirty(setIDs []string) {
+	if len(setIDs) == 0 {
+		return
+	}
+	ipSets := set.FromArray(setIDs)
+	for polID, pol := range m.policies {
+		if rulesUseIPSets(pol.InboundRules, ipSets) || rulesUseIPSets(pol.OutboundRules, ipSets) {
+			m.markEndpointsDirty(m.policiesToWorkloads[polID], "policy")
+		}
+	}
+	for profID, prof := range m.profiles {
+		if rulesUseIPSets(prof.InboundRules, ipSets) || rulesUseIPSets(prof.OutboundRules, ipSets) {
+			m.markEndpointsDirty(m.profilesToWorkloads[profID], "profile")
+		}
+	}
+}
+
+// rulesUseIPSets returns true if any of the rules matches on one of the given (non-named port) IP
+// sets.  Named port IP sets only ever contain full-length entries.
+func rulesUseIPSets(rules []*proto.Rule, ipSets set.Set) bool {
+	for _, r := range rules {
+		for _, ids := range [][]string{r.SrcIpSetIds, r.DstIpSetIds, r.NotSrcIpSetIds, r.NotDstIpSetIds} {
+			for _, id := range ids {
+				if ipSets.Contains(id) {
+					return true
+				}
+			}
+		}
+	}
+	return false
+}
+
 func (m *bpfEndpointManager) markExistingWEPDirty(wlID proto.WorkloadEndpointID, mapping string) {
 	wep := m.allWEPs[wlID]
 	if wep == nil {
@@ -483,6 +720,10 @@ func (m *bpfEndpointManager) CompleteDeferredWork() error {
 	// Do one-off initialisation.
 	m.dp.ensureStarted()
 
+	if m.exactIPSets != nil {
+		m.markEndpointsUsingIPSetsDirty(m.exactIPSets.TakeIPSetsWithNewPrefixes())
+	}
+
 	m.applyProgramsToDirtyDataInterfaces()
 	m.updateWEPsInDataplane()
 
@@ -500,9 +741,7 @@ func (m *bpfEndpointManager) CompleteDeferredWork() error {
 }
 
 func (m *bpfEndpointManager) applyProgramsToDirtyDataInterfaces() {
-	var mutex sync.Mutex
-	errs := map[string]error{}
-	var wg sync.WaitGroup
+	var ifaces []string
 	m.dirtyIfaceNames.Iter(func(item interface{}) error {
 		iface := item.(string)
 		if !m.isDataIface(iface) {
@@ -516,49 +755,55 @@ func (m *bpfEndpointManager) applyProgramsToDirtyDataInterfaces() {
 		}
 
 		m.opReporter.RecordOperation("update-data-iface")
+		ifaces = append(ifaces, iface)
+		return nil
+	})
+	errs := m.updateEndpoints(ifaces, func(iface string) error {
+		// Attach the qdisc first; it is shared between the directions.
+		err := m.dp.ensureQdisc(iface)
+		if err != nil {
+			return err
+		}
 
-		wg.Add(1)
-		go func() {
-			defer wg.Done()
-
-			// Attach the qdisc first; it is shared between the directions.
-			err := m.dp.ensureQdisc(iface)
-			if err != nil {
-				mutex.Lock()
-				errs[iface] = err
-				mutex.Unlock()
-				return
-			}
-
-			var hepPtr *proto.HostEndpoint
-			if hep, hepExists := m.hostIfaceToEpMap[iface]; hepExists {
-				hepPtr = &hep
-			}
+		var hepPtr *proto.HostEndpoint
+		if hep, hepExists := m.hostIfaceToEpMap[iface]; hepExists {
+			hepPtr = &hep
+		}
 
-			var ingressWG sync.WaitGroup
-			var ingressErr error
-			ingressWG.Add(1)
-			go func() {
-				defer ingressWG.Done()
-				ingressErr = m.attachDataIfaceProgram(iface, hepPtr, PolDirnIngress)
-			}()
-			err = m.attachDataIfaceProgram(iface, hepPtr, PolDirnEgress)
-			ingressWG.Wait()
-			if err == nil {
-				err = ingressErr
-			}
+		var ingressWG sync.WaitGroup
+		var ingressErr error
+		ingressWG.Add(1)
+		go func() {
+			defer ingressWG.Done()
+			ingressErr = m.attachDataIfaceProgram(iface, hepPtr, PolDirnIngress)
+		}()
+		err = m.attachDataIfaceProgram(iface, hepPtr, PolDirnEgress)
+		ingressWG.Wait()
+		if err == nil {
+			err = ingressErr
+		}
+		if err == nil {
+			// This is required to allow NodePort forwarding with
+			// encapsulation with the host's IP as the source address
+			err = m.dp.setAcceptLocal(iface, true)
+		}
+		if err == nil && m.edtMap != nil {
+			// The programs only give the packets their departure time, fq holds them back.
+			err = m.dp.ensureFQ(iface)
+		}
+		if err == nil && m.xdpEnabled {
+			ap := m.calculateXDPAttachPoint(iface)
+			err = m.dp.ensureXDPAttached(ap)
 			if err == nil {
-				// This is required to allow NodePort forwarding with
-				// encapsulation with the host's IP as the source address
-				err = m.dp.setAcceptLocal(iface, true)
+				err = m.dp.updateXDPPolicy(ap, m.xdpUntrackedRules(hepPtr))
 			}
-			mutex.Lock()
-			errs[iface] = err
-			mutex.Unlock()
-		}()
-		return nil
+		} else if err == nil {
+			// A program left by an earlier run would work from maps that we no longer
+			// maintain.
+			err = m.dp.ensureXDPDetached(iface)
+		}
+		return err
 	})
-	wg.Wait()
 	m.dirtyIfaceNames.Iter(func(item interface{}) error {
 		iface := item.(string)
 		if !m.isDataIface(iface) {
@@ -582,43 +827,61 @@ func (m *bpfEndpointManager) applyProgramsToDirtyDataInterfaces() {
 	})
 }
 
-func (m *bpfEndpointManager) updateWEPsInDataplane() {
+// updateEndpoints runs update for each of the interfaces on a bounded pool of workers and returns
+// the errors by interface.  Limiting the number of parallel workers matters: without it, all the
+// workers vie for CPU and complete slowly, and on a constrained system we can end up taking too
+// long and going non-ready.  Each interface appears at most once and the call only returns once
+// all the updates are done so the updates of an interface never overlap or reorder.
+func (m *bpfEndpointManager) updateEndpoints(ifaces []string, update func(iface string) error) map[string]error {
 	var mutex sync.Mutex
 	errs := map[string]error{}
 	var wg sync.WaitGroup
 
-	// Limit the number of parallel workers.  Without this, all the workers vie for CPU and complete slowly.
-	// On a constrained system, we can end up taking too long and going non-ready.
-	maxWorkers := runtime.GOMAXPROCS(0)
+	maxWorkers := m.endpointWorkers
+	if maxWorkers <= 0 {
+		maxWorkers = runtime.GOMAXPROCS(0)
+	}
 	sem := semaphore.NewWeighted(int64(maxWorkers))
 
-	m.dirtyIfaceNames.Iter(func(item interface{}) error {
-		ifaceName := item.(string)
-
-		if !m.isWorkloadIface(ifaceName) {
-			return nil
-		}
-
-		m.opReporter.RecordOperation("update-workload-iface")
-
+	bpfEndpointUpdatesQueuedGauge.Set(float64(len(ifaces)))
+	for _, iface := range ifaces {
 		if err := sem.Acquire(context.Background(), 1); err != nil {
 			// Should only happen if the context finishes.
 			log.WithError(err).Panic("Failed to acquire semaphore")
 		}
+		bpfEndpointUpdatesQueuedGauge.Dec()
 		m.onStillAlive()
 
 		wg.Add(1)
-		go func(ifaceName string) {
+		go func(iface string) {
 			defer wg.Done()
 			defer sem.Release(1)
-			err := m.applyPolicy(ifaceName)
+			start := time.Now()
+			err := update(iface)
+			summaryBPFEndpointUpdateTime.Observe(time.Since(start).Seconds())
 			mutex.Lock()
-			errs[ifaceName] = err
+			errs[iface] = err
 			mutex.Unlock()
-		}(ifaceName)
+		}(iface)
+	}
+	wg.Wait()
+	return errs
+}
+
+func (m *bpfEndpointManager) updateWEPsInDataplane() {
+	var ifaceNames []string
+	m.dirtyIfaceNames.Iter(func(item interface{}) error {
+		ifaceName := item.(string)
+
+		if !m.isWorkloadIface(ifaceName) {
+			return nil
+		}
+
+		m.opReporter.RecordOperation("update-workload-iface")
+		ifaceNames = append(ifaceNames, ifaceName)
 		return nil
 	})
-	wg.Wait()
+	errs := m.updateEndpoints(ifaceNames, m.applyPolicy)
 
 	if m.dirtyIfaceNames.Len() > 0 {
 		// Clean up any left-over jump maps in the background...
@@ -683,13 +946,51 @@ func (m *bpfEndpointManager) applyPolicy(ifaceName string) error {
 			log.WithField("iface", ifaceName).Debug("Interface is down/gone, closing jump maps.")
 			for i := range iface.dpState.jumpMapFDs {
 				if iface.dpState.jumpMapFDs[i] > 0 {
-					err := iface.dpState.jumpMapFDs[i].Close()
+					err := m.closeJumpMap(iface.dpState.jumpMapFDs[i])
 					if err != nil {
 						log.WithError(err).Error("Failed to close jump map.")
 					}
 					iface.dpState.jumpMapFDs[i] = 0
 				}
 			}
+			if err := tc.RemoveTCXLinks(ifaceName); err != nil {
+				log.WithError(err).Warn("Failed to remove tcx links of interface.")
+			}
+			if iface.dpState.wepProgIfIndex != 0 {
+				err := tc.RemoveWEPProg(m.wepProgsMap, iface.dpState.wepProgIfIndex)
+				if err != nil {
+					log.WithError(err).Error("Failed to remove workload program from the inline map.")
+				}
+				iface.dpState.wepProgIfIndex = 0
+			}
+			if iface.dpState.polProgsIfIndex != 0 {
+				err := tc.RemovePolProgs(m.polProgsMap, iface.dpState.polProgsIfIndex)
+				if err != nil {
+					log.WithError(err).Error("Failed to remove policy trampolines.")
+				}
+				iface.dpState.polProgsIfIndex = 0
+			}
+			if iface.dpState.ifaceCfgIfIndex != 0 {
+				k := ifcfg.NewKey(iface.dpState.ifaceCfgIfIndex)
+				err := m.ifaceCfgMap.Delete(k[:])
+				if err != nil && !bpf.IsNotExists(err) {
+					log.WithError(err).Error("Failed to remove interface configuration.")
+				}
+				iface.dpState.ifaceCfgIfIndex = 0
+			}
+			if iface.dpState.edtIfIndex != 0 {
+				k := edt.NewKey(iface.dpState.edtIfIndex)
+				err := m.edtMap.Delete(k[:])
+				if err != nil && !bpf.IsNotExists(err) {
+					log.WithError(err).Error("Failed to remove egress bandwidth limit.")
+				}
+				iface.dpState.edtIfIndex = 0
+				iface.dpState.edtRate = 0
+			}
+			iface.dpState.progIDs = [2]int{}
+			iface.dpState.progFiles = [2]string{}
+			iface.dpState.xdpProgID = 0
+			iface.dpState.xdpAP = nil
 		}
 		return false
 	})
@@ -743,6 +1044,42 @@ func (m *bpfEndpointManager) applyPolicy(ifaceName string) error {
 		return egressErr
 	}
 
+	// The packets that the program SNATs to the host IP would be dropped as martians unless
+	// the interface accepts them.
+	err = m.dp.setAcceptLocal(ifaceName, m.natOutgoingPortMax != 0)
+	if err != nil {
+		return err
+	}
+
+	if m.edtMap != nil {
+		var bitsPerSec uint64
+		if wep != nil {
+			bitsPerSec = wep.EgressBandwidth
+		}
+		err = m.dp.updateEgressBandwidth(ifaceName, bitsPerSec)
+		if err != nil {
+			return err
+		}
+	}
+
+	if m.xdpWorkloads {
+		ap := m.calculateXDPAttachPoint(ifaceName)
+		ap.Workload = true
+		// Generic XDP would run after the kernel has built the skb, which is what we avoid.
+		ap.Modes = []bpf.XDPMode{bpf.XDPDriver}
+		err = m.dp.ensureXDPAttached(ap)
+		if err != nil {
+			return err
+		}
+	} else {
+		// A program left by an earlier run would forward the workload's packets from maps
+		// that we no longer maintain.
+		err = m.dp.ensureXDPDetached(ifaceName)
+		if err != nil {
+			return err
+		}
+	}
+
 	applyTime := time.Since(startTime)
 	log.WithField("timeTaken", applyTime).Info("Finished applying BPF programs for workload")
 	return nil
@@ -772,6 +1109,24 @@ func (m *bpfEndpointManager) attachWorkloadProgram(ifaceName string, endpoint *p
 	ap.TunnelMTU = uint16(m.vxlanMTU - 50)
 	ap.IntfIP = calicoRouterIP
 	ap.ExtToServiceConnmark = uint32(m.bpfExtToServiceConnmark)
+	if ap.ToOrFrom == tc.FromEp && m.natOutgoingPortMax != 0 {
+		// The SNATed packets reach the host with the host IP as their source.  Like MASQUERADE,
+		// we only use it for the flows that leave through the interface that owns it, the
+		// program leaves the others to iptables.  If no interface owns it, iptables does it all.
+		ifindex, err := m.dp.interfaceOwningIP(m.hostIP)
+		if err != nil {
+			return err
+		}
+		if ifindex != 0 {
+			ap.SNATIP = m.hostIP
+			ap.SNATIfindex = ifindex
+			ap.SNATPortMin = m.natOutgoingPortMin
+			ap.SNATPortMax = m.natOutgoingPortMax
+		} else {
+			log.WithField("hostIP", m.hostIP).Debug(
+				"No interface owns the host IP, leaving NAT-outgoing to iptables")
+		}
+	}
 
 	jumpMapFD, err := m.dp.ensureProgramAttached(&ap, polDirection)
 	if err != nil {
@@ -835,6 +1190,23 @@ func (m *bpfEndpointManager) addHostPolicy(rules *polprog.Rules, hostEndpoint *p
 	rules.HostProfiles = m.extractProfiles(hostEndpoint.ProfileIds, polDirection)
 }
 
+// xdpUntrackedRules returns the untracked policy of the host endpoint for its XDP program, or nil if
+// it has none.  Untracked policy applies before conntrack so only its ingress half can run in XDP;
+// packets that it doesn't match carry on to the TC programs and the normal policy.
+func (m *bpfEndpointManager) xdpUntrackedRules(hostEndpoint *proto.HostEndpoint) *polprog.Rules {
+	if hostEndpoint == nil || len(hostEndpoint.UntrackedTiers) != 1 {
+		return nil
+	}
+	tiers := m.extractTiers(hostEndpoint.UntrackedTiers[0], PolDirnIngress, NoEndTierDrop)
+	if len(tiers) == 0 {
+		return nil
+	}
+	return &polprog.Rules{
+		ForHostInterface:   true,
+		HostUntrackedTiers: tiers,
+	}
+}
+
 func (m *bpfEndpointManager) ifaceIsUp(ifaceName string) (up bool) {
 	m.ifacesLock.Lock()
 	defer m.ifacesLock.Unlock()
@@ -931,6 +1303,25 @@ func (m *bpfEndpointManager) calculateTCAttachPoint(policyDirection PolDirection
 	}
 
 	ap.Iface = ifaceName
+	ap.EventsSampleRate = uint32(m.bpfEventsSampleRate)
+	ap.PacketCapture = m.bpfPacketCapture
+	ap.ConntrackLRU = m.ctLRU
+	ap.NATAffinityPerCPULRU = m.natAffPerCPULRU
+	ap.PolicyCache = m.polGeneration != nil
+	ap.RedirectNeigh = m.redirectNeigh
+	ap.GSOSize = m.gsoSize
+	ap.KtimeCoarse = m.ktimeCoarse
+	ap.ProgLatency = m.progLatencyMap != nil
+	ap.LeanTunnel = m.leanTunnel
+	ap.WorkloadInline = m.wepProgsMap != nil
+	ap.IfaceConfig = m.ifaceCfgMap != nil
+	ap.EDT = m.edtMap != nil
+	ap.ConntrackAccounting = m.ctAccounting
+	ap.ServiceCounters = m.svcCounters
+	ap.MapSizes = m.mapSizes
+	ap.NUMAReplicas = m.numaReplicas
+	ap.MapNUMANodes = m.mapNUMANodes
+	ap.Variant = m.progVariant
 	ap.Type = endpointType
 	ap.ToOrFrom = toOrFrom
 	ap.ToHostDrop = (m.epToHostAction == "DROP")
@@ -1250,10 +1641,229 @@ func (m *bpfEndpointManager) setAcceptLocal(iface string, val bool) error {
 	return nil
 }
 
+// interfaceOwningIP returns the index of the interface that has the address ip, or 0 if there is
+// none.
+func (m *bpfEndpointManager) interfaceOwningIP(ip net.IP) (int, error) {
+	if ip == nil {
+		return 0, nil
+	}
+	ifaces, err := net.Interfaces()
+	if err != nil {
+		return 0, err
+	}
+	for _, iface := range ifaces {
+		addrs, err := iface.Addrs()
+		if err != nil {
+			// The interface may have gone away in the meantime.
+			log.WithError(err).WithField("iface", iface.Name).Debug("Failed to list addresses")
+			continue
+		}
+		for _, addr := range addrs {
+			if ipNet, ok := addr.(*net.IPNet); ok && ipNet.IP.Equal(ip) {
+				return iface.Index, nil
+			}
+		}
+	}
+	return 0, nil
+}
+
+func (m *bpfEndpointManager) calculateXDPAttachPoint(iface string) *xdp.AttachPoint {
+	modes := []bpf.XDPMode{bpf.XDPDriver}
+	if m.xdpAllowGeneric {
+		modes = append(modes, bpf.XDPGeneric)
+	}
+	return &xdp.AttachPoint{
+		Iface:                iface,
+		LogLevel:             m.bpfLogLevel,
+		HostIP:               m.hostIP,
+		TunnelMTU:            uint16(m.vxlanMTU),
+		VXLANPort:            m.vxlanPort,
+		ConntrackLRU:         m.ctLRU,
+		NATAffinityPerCPULRU: m.natAffPerCPULRU,
+		MapSizes:             m.mapSizes,
+		NUMAReplicas:         m.numaReplicas,
+		MapNUMANodes:         m.mapNUMANodes,
+		SynCookies:           m.xdpSynCookies,
+		CPUSteering:          m.xdpCPUSteering,
+		ConntrackAccounting:  m.ctAccounting,
+		EDT:                  m.edtMap != nil,
+		KtimeCoarse:          m.ktimeCoarse,
+		Modes:                modes,
+	}
+}
+
+// ensureXDPAttached attaches the XDP program to the data interface and allows the XDP fast path to
+// redirect packets to it.  Workload veths are never redirected to, the workload side has no
+// XDP program to receive the frames.  Like the TC programs, the program is only reattached if it
+// is gone or if the attach point changed, loading it is expensive and would replace its jump map.
+func (m *bpfEndpointManager) ensureXDPAttached(ap *xdp.AttachPoint) error {
+	var attachedID int
+	var attachedAP *xdp.AttachPoint
+	m.ifacesLock.Lock()
+	m.withIface(ap.Iface, func(iface *bpfInterface) bool {
+		attachedID = iface.dpState.xdpProgID
+		attachedAP = iface.dpState.xdpAP
+		return false
+	})
+	m.ifacesLock.Unlock()
+
+	if attachedAP != nil && reflect.DeepEqual(*attachedAP, *ap) {
+		id, err := ap.ProgramID()
+		if err == nil && id == attachedID {
+			log.WithFields(log.Fields{"iface": ap.Iface, "id": id}).Debug("XDP program already attached")
+			return nil
+		}
+	}
+
+	mode, err := ap.AttachProgram()
+	if err != nil {
+		return err
+	}
+	id, err := ap.ProgramID()
+	if err != nil {
+		return err
+	}
+	apCopy := *ap
+	m.setXDPState(ap.Iface, id, &apCopy)
+
+	if ap.Workload {
+		log.WithFields(log.Fields{"iface": ap.Iface, "mode": mode}).Debug("Workload XDP program attached")
+		return nil
+	}
+
+	link, err := net.InterfaceByName(ap.Iface)
+	if err != nil {
+		return err
+	}
+	k, v := xdp.TxKeyValue(link.Index)
+	err = m.xdpTxMap.Update(k, v)
+	if err != nil {
+		return fmt.Errorf("failed to add %s to the XDP redirect map: %w", ap.Iface, err)
+	}
+
+	log.WithFields(log.Fields{"iface": ap.Iface, "mode": mode}).Info("XDP program attached")
+	return nil
+}
+
+// ensureXDPDetached removes our XDP program from the interface, and the interface from the XDP
+// redirect map, if we no longer want the program there.  Once it knows that the interface has none
+// of our programs, it only looks at the interface again after attaching one.
+func (m *bpfEndpointManager) ensureXDPDetached(iface string) error {
+	var attachedID int
+	m.ifacesLock.Lock()
+	m.withIface(iface, func(iface *bpfInterface) bool {
+		attachedID = iface.dpState.xdpProgID
+		return false
+	})
+	m.ifacesLock.Unlock()
+	if attachedID == -1 {
+		return nil
+	}
+
+	_, err := xdp.DetachCalicoProgram(iface)
+	if err != nil {
+		return err
+	}
+	if m.xdpTxMap != nil {
+		link, err := net.InterfaceByName(iface)
+		if err != nil {
+			return err
+		}
+		k, _ := xdp.TxKeyValue(link.Index)
+		err = m.xdpTxMap.Delete(k)
+		if err != nil && !bpf.IsNotExists(err) {
+			return fmt.Errorf("failed to remove %s from the XDP redirect map: %w", iface, err)
+		}
+	}
+	m.setXDPState(iface, -1, nil)
+	return nil
+}
+
+func (m *bpfEndpointManager) setXDPState(name string, id int, ap *xdp.AttachPoint) {
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+
+	m.withIface(name, func(iface *bpfInterface) bool {
+		iface.dpState.xdpProgID = id
+		iface.dpState.xdpAP = ap
+		return false
+	})
+}
+
+// loadXDPState looks at the XDP programs that are attached when we start.  It removes ours from the
+// interfaces that are neither data nor workload interfaces, which an earlier run may have left
+// when the interface patterns changed, and it records the data and workload interfaces that have no
+// XDP program so that ensureXDPDetached doesn't look at each of them again.
+func (m *bpfEndpointManager) loadXDPState() {
+	links, err := netlink.LinkList()
+	if err != nil {
+		log.WithError(err).Warn("Failed to list interfaces, not looking for stale XDP programs.")
+		return
+	}
+	for _, link := range links {
+		name := link.Attrs().Name
+		attached := link.Attrs().Xdp != nil && link.Attrs().Xdp.Attached
+		switch {
+		case m.isDataIface(name) || m.isWorkloadIface(name):
+			if !attached {
+				m.setXDPState(name, -1, nil)
+			}
+		case attached:
+			if _, err := xdp.DetachCalicoProgram(name); err != nil {
+				log.WithError(err).WithField("iface", name).Warn("Failed to detach stale XDP program.")
+			}
+		}
+	}
+}
+
+// updateXDPPolicy installs the untracked policy in the jump map of the XDP program attached to the
+// interface, or removes it if rules is nil, in which case the program skips straight to its fast
+// path.
+func (m *bpfEndpointManager) updateXDPPolicy(ap *xdp.AttachPoint, rules *polprog.Rules) error {
+	progID, err := ap.ProgramID()
+	if err != nil {
+		return err
+	}
+	jumpMapFD, err := findJumpMapOfProg(ap.Iface, progID)
+	if err != nil {
+		return fmt.Errorf("failed to look up XDP jump map: %w", err)
+	}
+	defer func() {
+		if err := jumpMapFD.Close(); err != nil {
+			log.WithError(err).Warn("Failed to close XDP jump map FD.")
+		}
+	}()
+
+	if rules == nil {
+		return removePolicyPrograms(jumpMapFD, 0)
+	}
+
+	pg := m.newPolicyBuilder(jumpMapFD)
+	pg.EnableXDP()
+	progs, err := pg.Programs(*rules)
+	if err != nil {
+		return fmt.Errorf("failed to generate XDP policy bytecode: %w", err)
+	}
+	m.recordRuleCounterIDs(pg.RuleCounterIDs())
+
+	for i := len(progs) - 1; i >= 0; i-- {
+		progFD, err := bpf.LoadXDPProgramFromInsns(progs[i], "Apache-2.0")
+		if err != nil {
+			return fmt.Errorf("failed to load XDP policy program: %w", err)
+		}
+		err = setJumpMapProgram(jumpMapFD, polprog.PolicyJumpIndex(i), progFD)
+		if err != nil {
+			return err
+		}
+	}
+	return removePolicyPrograms(jumpMapFD, len(progs))
+}
+
 func (m *bpfEndpointManager) ensureStarted() {
 	m.startupOnce.Do(func() {
 		log.Info("Starting map cleanup runner.")
 		m.mapCleanupRunner.Start(context.Background())
+		m.loadXDPState()
 	})
 }
 
@@ -1261,8 +1871,72 @@ func (m *bpfEndpointManager) ensureQdisc(iface string) error {
 	return tc.EnsureQdisc(iface)
 }
 
+func (m *bpfEndpointManager) ensureFQ(iface string) error {
+	return tc.EnsureFQ(iface)
+}
+
+// updateEgressBandwidth writes the egress bandwidth limit of the workload behind the interface to
+// the cali_v4_edt map, or removes it if bitsPerSec is 0.  The entry is only rewritten if the limit
+// changes since rewriting it resets the departure time that the programs keep in it.
+func (m *bpfEndpointManager) updateEgressBandwidth(iface string, bitsPerSec uint64) error {
+	var ifIndex int
+	var rate uint64
+	m.ifacesLock.Lock()
+	m.withIface(iface, func(bpfIface *bpfInterface) bool {
+		ifIndex = bpfIface.dpState.edtIfIndex
+		rate = bpfIface.dpState.edtRate
+		return false
+	})
+	m.ifacesLock.Unlock()
+
+	if ifIndex != 0 && rate == bitsPerSec {
+		return nil
+	}
+	if ifIndex == 0 && bitsPerSec == 0 {
+		return nil
+	}
+
+	link, err := net.InterfaceByName(iface)
+	if err != nil {
+		return fmt.Errorf("failed to look up interface %s: %w", iface, err)
+	}
+	k := edt.NewKey(link.Index)
+	ifIndex = link.Index
+	if bitsPerSec == 0 {
+		err = m.edtMap.Delete(k[:])
+		if err != nil && !bpf.IsNotExists(err) {
+			return fmt.Errorf("failed to remove egress bandwidth limit of %s: %w", iface, err)
+		}
+		ifIndex = 0
+	} else {
+		v := edt.NewValue(bitsPerSec)
+		err = m.edtMap.Update(k[:], v[:])
+		if err != nil {
+			return fmt.Errorf("failed to update egress bandwidth limit of %s: %w", iface, err)
+		}
+	}
+
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+	m.withIface(iface, func(bpfIface *bpfInterface) bool {
+		bpfIface.dpState.edtIfIndex = ifIndex
+		bpfIface.dpState.edtRate = bitsPerSec
+		return false
+	})
+	return nil
+}
+
 // Ensure TC program is attached to the specified interface and return its jump map FD.
 func (m *bpfEndpointManager) ensureProgramAttached(ap *tc.AttachPoint, polDirection PolDirection) (bpf.MapFD, error) {
+	if m.ifaceCfgMap != nil {
+		// The program reads its configuration from the map, updating it in place takes effect
+		// without reloading the program.
+		err := m.updateIfaceConfig(ap)
+		if err != nil {
+			return 0, err
+		}
+	}
+
 	jumpMapFD := m.getJumpMapFD(ap.Iface, polDirection)
 	if jumpMapFD != 0 {
 		if attached, err := ap.IsAttached(); err != nil {
@@ -1272,7 +1946,7 @@ func (m *bpfEndpointManager) ensureProgramAttached(ap *tc.AttachPoint, polDirect
 			// Close the now-defunct jump map.
 			log.WithField("iface", ap.Iface).Info(
 				"Detected that BPF program no longer attached to interface.")
-			err := jumpMapFD.Close()
+			err := m.closeJumpMap(jumpMapFD)
 			if err != nil {
 				log.WithError(err).Warn("Failed to close jump map FD. Ignoring.")
 			}
@@ -1281,23 +1955,137 @@ func (m *bpfEndpointManager) ensureProgramAttached(ap *tc.AttachPoint, polDirect
 		}
 	}
 
+	attachStart := time.Now()
+
+	if jumpMapFD == 0 && m.polProgsMap != nil {
+		jumpMapFD = m.attachSharedProgram(ap)
+		if jumpMapFD != 0 {
+			m.setJumpMapFD(ap.Iface, polDirection, jumpMapFD)
+			m.recordProgramAttached(ap, polDirection, time.Since(attachStart))
+		}
+	}
+
 	if jumpMapFD == 0 {
 		// We don't have a program attached to this interface yet, attach one now.
 		err := ap.AttachProgram()
 		if err != nil {
 			return 0, err
 		}
+		m.recordProgramAttached(ap, polDirection, time.Since(attachStart))
 
 		jumpMapFD, err = FindJumpMap(ap)
 		if err != nil {
 			return 0, fmt.Errorf("failed to look up jump map: %w", err)
 		}
 		m.setJumpMapFD(ap.Iface, polDirection, jumpMapFD)
+
+		if m.wepProgsMap != nil && ap.Type == tc.EpTypeWorkload && ap.ToOrFrom == tc.ToEp {
+			m.addWEPProg(ap)
+		}
 	}
 
 	return jumpMapFD, nil
 }
 
+// recordProgramAttached records the cost of loading the program that we just attached, and its ID
+// for the program statistics.
+func (m *bpfEndpointManager) recordProgramAttached(ap *tc.AttachPoint, polDirection PolDirection, loadTime time.Duration) {
+	summaryBPFProgramAttachTime.Observe(loadTime.Seconds())
+
+	logCxt := log.WithFields(log.Fields{"iface": ap.Iface, "hook": ap.Hook, "loadTime": loadTime})
+	info, err := ap.ProgramInfo()
+	if err != nil {
+		logCxt.WithError(err).Warn("Failed to get information about the attached program.")
+		return
+	}
+	// Old kernels don't report the verifier cost.
+	if info.VerifiedInsns > 0 {
+		bpfProgramVerifiedInsnsGauge.WithLabelValues(ap.FileName()).Set(float64(info.VerifiedInsns))
+	}
+	logCxt.WithFields(log.Fields{
+		"progID":        info.ID,
+		"verifiedInsns": info.VerifiedInsns,
+		"xlatedLen":     info.XlatedLen,
+		"jitedLen":      info.JitedLen,
+	}).Info("Attached BPF program.")
+
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+	m.withIface(ap.Iface, func(iface *bpfInterface) bool {
+		iface.dpState.progIDs[polDirection] = info.ID
+		iface.dpState.progFiles[polDirection] = ap.FileName()
+		return false
+	})
+}
+
+// updateIfaceConfig writes the configuration of the attach point's interface to the cali_v4_ifcfg
+// map.
+func (m *bpfEndpointManager) updateIfaceConfig(ap *tc.AttachPoint) error {
+	link, err := net.InterfaceByName(ap.Iface)
+	if err != nil {
+		return fmt.Errorf("failed to look up interface %s: %w", ap.Iface, err)
+	}
+	k := ifcfg.NewKey(link.Index)
+	v := ap.IfaceConfigValue()
+	err = m.ifaceCfgMap.Update(k[:], v[:])
+	if err != nil {
+		return fmt.Errorf("failed to update configuration of interface %s: %w", ap.Iface, err)
+	}
+
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+	m.withIface(ap.Iface, func(iface *bpfInterface) bool {
+		iface.dpState.ifaceCfgIfIndex = link.Index
+		return false
+	})
+	return nil
+}
+
+// attachSharedProgram attaches the shared variant of the program and returns the attach point's
+// jump map.  It returns 0 if the program can't be shared, for example because the first program
+// to use a map hasn't pinned it yet, and the caller should then attach a program of its own.
+func (m *bpfEndpointManager) attachSharedProgram(ap *tc.AttachPoint) bpf.MapFD {
+	link, err := net.InterfaceByName(ap.Iface)
+	var jumpMapFD bpf.MapFD
+	if err == nil {
+		jumpMapFD, err = ap.AttachSharedProgram(m.polProgsMap, m.stateMap, link.Index)
+	}
+	if err != nil {
+		log.WithError(err).WithField("iface", ap.Iface).Info(
+			"Failed to attach shared program; attaching a program of its own.")
+		return 0
+	}
+
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+	m.withIface(ap.Iface, func(iface *bpfInterface) bool {
+		iface.dpState.polProgsIfIndex = link.Index
+		return false
+	})
+	return jumpMapFD
+}
+
+// addWEPProg makes the newly attached to-workload program available to the host endpoint
+// programs for inline delivery.  Failing that is not fatal, packets then go through the veth.
+func (m *bpfEndpointManager) addWEPProg(ap *tc.AttachPoint) {
+	link, err := net.InterfaceByName(ap.Iface)
+	if err == nil {
+		err = tc.AddWEPProg(m.wepProgsMap, ap, link.Index)
+	}
+	if err != nil {
+		log.WithError(err).WithField("iface", ap.Iface).Warn(
+			"Failed to add workload program for inline delivery; packets will go through the veth.")
+		return
+	}
+
+	m.ifacesLock.Lock()
+	defer m.ifacesLock.Unlock()
+	m.withIface(ap.Iface, func(iface *bpfInterface) bool {
+		iface.dpState.wepProgIfIndex = link.Index
+		return false
+	})
+}
+
 func (m *bpfEndpointManager) getJumpMapFD(ifaceName string, direction PolDirection) (fd bpf.MapFD) {
 	m.ifacesLock.Lock()
 	defer m.ifacesLock.Unlock()
@@ -1318,16 +2106,238 @@ func (m *bpfEndpointManager) setJumpMapFD(name string, direction PolDirection, f
 	})
 }
 
-func (m *bpfEndpointManager) updatePolicyProgram(jumpMapFD bpf.MapFD, rules polprog.Rules) error {
+func (m *bpfEndpointManager) newPolicyBuilder(jumpMapFD bpf.MapFD) *polprog.Builder {
 	pg := polprog.NewBuilder(m.ipSetIDAlloc, m.ipSetMap.MapFD(), m.stateMap.MapFD(), jumpMapFD)
-	insns, err := pg.Instructions(rules)
+	if m.exactIPSets != nil {
+		pg.EnableExactIPSets(m.exactIPSets, m.ipSetExactMap.MapFD())
+		if m.ipSetMembersMap != nil {
+			pg.EnableMemberIPSets(m.exactIPSets, m.ipSetMembersMap.MapFD())
+		}
+	}
+	if m.polGeneration != nil {
+		pg.EnableVerdictCache()
+	}
+	if m.polRuleGrouping {
+		pg.EnableRuleGrouping()
+	}
+	if m.ruleCountersMap != nil {
+		pg.EnableRuleCounters(m.ruleCountersMap.MapFD())
+	}
+	if m.numaReplicas {
+		pg.EnableNUMAReplicas(m.ipSetNUMAReplicaFDs())
+	}
+	return pg
+}
+
+// ipSetNUMAReplicaFDs maps the fds of the IP set maps to the fds of their replicas on the second
+// NUMA node.
+func (m *bpfEndpointManager) ipSetNUMAReplicaFDs() map[bpf.MapFD]bpf.MapFD {
+	fds := map[bpf.MapFD]bpf.MapFD{}
+	for _, ipsMap := range []bpf.Map{m.ipSetMap, m.ipSetExactMap, m.ipSetMembersMap} {
+		if r, ok := ipsMap.(*bpf.NUMAReplicatedMap); ok && len(r.Replicas()) > 0 {
+			fds[r.MapFD()] = r.Replicas()[0].MapFD()
+		}
+	}
+	return fds
+}
+
+func (m *bpfEndpointManager) updatePolicyProgram(jumpMapFD bpf.MapFD, rules polprog.Rules) error {
+	if variant := tc.SharedJumpMapVariant(jumpMapFD); variant != "" {
+		err := m.updateSharedPolicyProgram(jumpMapFD, variant, rules)
+		if err != nil {
+			return err
+		}
+		return m.bumpPolicyGeneration()
+	}
+
+	pg := m.newPolicyBuilder(jumpMapFD)
+	progs, err := pg.Programs(rules)
+	if err != nil {
+		return fmt.Errorf("failed to generate policy bytecode: %w", err)
+	}
+	m.recordRuleCounterIDs(pg.RuleCounterIDs())
+
+	// Install the programs from the end of the chain so that a packet entering the first
+	// program never continues into a stale one.
+	for i := len(progs) - 1; i >= 0; i-- {
+		err := installPolicyProgram(jumpMapFD, polprog.PolicyJumpIndex(i), progs[i])
+		if err != nil {
+			return err
+		}
+	}
+
+	// Remove any continuations left over from a longer chain.
+	err = removePolicyPrograms(jumpMapFD, len(progs))
+	if err != nil {
+		return err
+	}
+	return m.bumpPolicyGeneration()
+}
+
+// sharedPolicyProg is a policy program chain that the attach points of a shared program variant
+// with the same policy share.  The chain tail calls through its own jump map, which holds the
+// programs of the variant and the continuations of the chain.
+type sharedPolicyProg struct {
+	jumpMapFD bpf.MapFD
+	// progFD is the first program of the chain, which goes in the jump maps of the attach points.
+	progFD bpf.ProgFD
+	users  int
+}
+
+// updateSharedPolicyProgram points the jump map of an attach point of a shared program at the
+// policy program chain for the rules, loading the chain if no other attach point of the variant
+// has the same policy.  Endpoints of one deployment usually have the same policy so, on a busy
+// node, this saves loading and verifying the same chain over and over and the kernel memory of
+// its copies.
+func (m *bpfEndpointManager) updateSharedPolicyProgram(jumpMapFD bpf.MapFD, variant string, rules polprog.Rules) error {
+	// Only the jump map FD, which the programs embed, differs between the chains of the attach
+	// points so key the chains on the programs generated with a placeholder.
+	pg := m.newPolicyBuilder(0)
+	progs, err := pg.Programs(rules)
 	if err != nil {
 		return fmt.Errorf("failed to generate policy bytecode: %w", err)
 	}
+	m.recordRuleCounterIDs(pg.RuleCounterIDs())
+	h := sha256.New()
+	for _, p := range progs {
+		_, _ = h.Write(p.AsBytes())
+	}
+	key := variant + "/" + hex.EncodeToString(h.Sum(nil))
+
+	m.sharedPoliciesLock.Lock()
+	defer m.sharedPoliciesLock.Unlock()
+
+	sp := m.sharedPolicies[key]
+	if sp == nil {
+		sp, err = m.loadSharedPolicyProgram(variant, rules)
+		if err != nil {
+			return err
+		}
+		m.sharedPolicies[key] = sp
+	}
+
+	k := make([]byte, 4)
+	v := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(polprog.PolicyJumpIndex(0)))
+	binary.LittleEndian.PutUint32(v, uint32(sp.progFD))
+	err = bpf.UpdateMapEntry(jumpMapFD, k, v)
+	if err != nil {
+		return fmt.Errorf("failed to update jump map: %w", err)
+	}
+	// The continuations of the shared chain live in its own jump map.
+	err = removePolicyPrograms(jumpMapFD, 1)
+	if err != nil {
+		return err
+	}
+	err = tc.SetSharedPolicyProgram(jumpMapFD, sp.progFD)
+	if err != nil {
+		return err
+	}
+
+	if old, ok := m.sharedPolicyOf[jumpMapFD]; !ok || old != key {
+		sp.users++
+		m.sharedPolicyOf[jumpMapFD] = key
+		if ok {
+			m.releaseSharedPolicyProgram(old)
+		}
+	}
+	return nil
+}
+
+// loadSharedPolicyProgram loads a policy program chain for the rules with a jump map of its own.
+// The caller must hold sharedPoliciesLock.
+func (m *bpfEndpointManager) loadSharedPolicyProgram(variant string, rules polprog.Rules) (*sharedPolicyProg, error) {
+	polJumpMapFD, err := tc.NewSharedPolicyJumpMap(variant)
+	if err != nil {
+		return nil, err
+	}
+	progs, err := m.newPolicyBuilder(polJumpMapFD).Programs(rules)
+	if err != nil {
+		_ = polJumpMapFD.Close()
+		return nil, fmt.Errorf("failed to generate policy bytecode: %w", err)
+	}
+	for i := len(progs) - 1; i > 0; i-- {
+		err := installPolicyProgram(polJumpMapFD, polprog.PolicyJumpIndex(i), progs[i])
+		if err != nil {
+			_ = polJumpMapFD.Close()
+			return nil, err
+		}
+	}
+	progFD, err := bpf.LoadBPFProgramFromInsns(progs[0], "Apache-2.0")
+	if err != nil {
+		_ = polJumpMapFD.Close()
+		return nil, fmt.Errorf("failed to load BPF policy program: %w", err)
+	}
+	log.WithFields(log.Fields{"variant": variant, "programs": len(progs)}).Debug("Loaded shared policy program.")
+	return &sharedPolicyProg{jumpMapFD: polJumpMapFD, progFD: progFD}, nil
+}
+
+// releaseSharedPolicyProgram drops a user of the shared policy program chain and closes the chain
+// once the last user is gone.  The jump maps of the attach points that still refer to the first
+// program keep it alive until they are updated.  The caller must hold sharedPoliciesLock.
+func (m *bpfEndpointManager) releaseSharedPolicyProgram(key string) {
+	sp := m.sharedPolicies[key]
+	if sp == nil {
+		return
+	}
+	sp.users--
+	if sp.users > 0 {
+		return
+	}
+	delete(m.sharedPolicies, key)
+	if err := sp.progFD.Close(); err != nil {
+		log.WithError(err).Warn("Failed to close shared policy program FD.")
+	}
+	if err := sp.jumpMapFD.Close(); err != nil {
+		log.WithError(err).Warn("Failed to close shared policy jump map FD.")
+	}
+}
+
+// detachSharedPolicyProgram stops the jump map of an attach point using a shared policy program
+// chain, if it used one.
+func (m *bpfEndpointManager) detachSharedPolicyProgram(jumpMapFD bpf.MapFD) {
+	m.sharedPoliciesLock.Lock()
+	defer m.sharedPoliciesLock.Unlock()
+	if key, ok := m.sharedPolicyOf[jumpMapFD]; ok {
+		if err := tc.ResetSharedPolicyProgram(jumpMapFD); err != nil {
+			log.WithError(err).Warn("Failed to reinstall policy trampoline.")
+		}
+		delete(m.sharedPolicyOf, jumpMapFD)
+		m.releaseSharedPolicyProgram(key)
+	}
+}
+
+// closeJumpMap closes the jump map of an attach point, releasing what the attach point holds.
+func (m *bpfEndpointManager) closeJumpMap(jumpMapFD bpf.MapFD) error {
+	m.detachSharedPolicyProgram(jumpMapFD)
+	tc.ForgetJumpMap(jumpMapFD)
+	return jumpMapFD.Close()
+}
+
+// recordRuleCounterIDs remembers the rules that own the counters of a policy program.  The keys
+// are derived from the policy name and rule ID so a rule shares its counter between the programs
+// of all the interfaces that it applies to.
+func (m *bpfEndpointManager) recordRuleCounterIDs(ids map[uint64]polprog.RuleCounterID) {
+	if len(ids) == 0 {
+		return
+	}
+	m.ruleCounterIDsLock.Lock()
+	defer m.ruleCounterIDsLock.Unlock()
+	for k, id := range ids {
+		m.ruleCounterIDs[k] = id
+	}
+}
+
+func installPolicyProgram(jumpMapFD bpf.MapFD, idx int, insns asm.Insns) error {
 	progFD, err := bpf.LoadBPFProgramFromInsns(insns, "Apache-2.0")
 	if err != nil {
 		return fmt.Errorf("failed to load BPF policy program: %w", err)
 	}
+	return setJumpMapProgram(jumpMapFD, idx, progFD)
+}
+
+// setJumpMapProgram puts the program in the jump map at the index and closes its FD.
+func setJumpMapProgram(jumpMapFD bpf.MapFD, idx int, progFD bpf.ProgFD) error {
 	defer func() {
 		// Once we've put the program in the map, we don't need its FD any more.
 		err := progFD.Close()
@@ -1337,8 +2347,9 @@ func (m *bpfEndpointManager) updatePolicyProgram(jumpMapFD bpf.MapFD, rules polp
 	}()
 	k := make([]byte, 4)
 	v := make([]byte, 4)
+	binary.LittleEndian.PutUint32(k, uint32(idx))
 	binary.LittleEndian.PutUint32(v, uint32(progFD))
-	err = bpf.UpdateMapEntry(jumpMapFD, k, v)
+	err := bpf.UpdateMapEntry(jumpMapFD, k, v)
 	if err != nil {
 		return fmt.Errorf("failed to update jump map: %w", err)
 	}
@@ -1346,75 +2357,100 @@ func (m *bpfEndpointManager) updatePolicyProgram(jumpMapFD bpf.MapFD, rules polp
 }
 
 func (m *bpfEndpointManager) removePolicyProgram(jumpMapFD bpf.MapFD) error {
-	k := make([]byte, 4)
-	err := bpf.DeleteMapEntryIfExists(jumpMapFD, k, 4)
+	err := removePolicyPrograms(jumpMapFD, 0)
 	if err != nil {
-		return fmt.Errorf("failed to update jump map: %w", err)
+		return err
+	}
+	m.detachSharedPolicyProgram(jumpMapFD)
+	return m.bumpPolicyGeneration()
+}
+
+// bumpPolicyGeneration invalidates the verdicts in the policy verdict cache, which may have been
+// computed by a policy program that we've just replaced.
+func (m *bpfEndpointManager) bumpPolicyGeneration() error {
+	if m.polGeneration == nil {
+		return nil
+	}
+	return m.polGeneration.Bump()
+}
+
+// removePolicyPrograms removes the programs of the policy program chain from the given position
+// onwards.
+func removePolicyPrograms(jumpMapFD bpf.MapFD, from int) error {
+	k := make([]byte, 4)
+	for i := from; i <= polprog.MaxPolicyContinuations; i++ {
+		binary.LittleEndian.PutUint32(k, uint32(polprog.PolicyJumpIndex(i)))
+		err := bpf.DeleteMapEntryIfExists(jumpMapFD, k, 4)
+		if err == unix.E2BIG {
+			// Jump map of a program that predates policy program chains.
+			return nil
+		}
+		if err != nil {
+			return fmt.Errorf("failed to update jump map: %w", err)
+		}
 	}
 	return nil
 }
 
 func FindJumpMap(ap *tc.AttachPoint) (mapFD bpf.MapFD, err error) {
-	logCtx := log.WithField("iface", ap.Iface)
+	progID, err := ap.ProgramID()
+	if err != nil {
+		return 0, err
+	}
+	return findJumpMapOfProg(ap.Iface, progID)
+}
+
+// findJumpMapOfProg returns an FD of the jump map of the TC or XDP program with the given ID,
+// which is attached to the interface.
+func findJumpMapOfProg(iface string, progID int) (mapFD bpf.MapFD, err error) {
+	logCtx := log.WithField("iface", iface)
 	logCtx.Debug("Looking up jump map.")
-	out, err := tc.ExecTC("filter", "show", "dev", ap.Iface, string(ap.Hook))
+
+	bpftool := exec.Command("bpftool", "prog", "show", "id", strconv.Itoa(progID), "--json")
+	output, err := bpftool.Output()
 	if err != nil {
-		return 0, fmt.Errorf("failed to find TC filter for interface %v: %w", ap.Iface, err)
-	}
-
-	progName := ap.ProgramName()
-	for _, line := range strings.Split(out, "\n") {
-		if strings.Contains(line, progName) {
-			re := regexp.MustCompile(`id (\d+)`)
-			m := re.FindStringSubmatch(line)
-			if len(m) > 0 {
-				progIDStr := m[1]
-				bpftool := exec.Command("bpftool", "prog", "show", "id", progIDStr, "--json")
-				output, err := bpftool.Output()
-				if err != nil {
-					// We can hit this case if the interface was deleted underneath us; check that it's still there.
-					if _, err := os.Stat(fmt.Sprintf("/proc/sys/net/ipv4/conf/%s", ap.Iface)); os.IsNotExist(err) {
-						return 0, tc.ErrDeviceNotFound
-					}
+		// We can hit this case if the interface was deleted underneath us; check that it's still there.
+		if _, err := os.Stat(fmt.Sprintf("/proc/sys/net/ipv4/conf/%s", iface)); os.IsNotExist(err) {
+			return 0, tc.ErrDeviceNotFound
+		}
 
-					return 0, fmt.Errorf("failed to get map metadata: %w", err)
-				}
-				var prog struct {
-					MapIDs []int `json:"map_ids"`
-				}
-				err = json.Unmarshal(output, &prog)
-				if err != nil {
-					return 0, fmt.Errorf("failed to parse bpftool output: %w", err)
-				}
+		return 0, fmt.Errorf("failed to get map metadata: %w", err)
+	}
+	var prog struct {
+		MapIDs []int `json:"map_ids"`
+	}
+	err = json.Unmarshal(output, &prog)
+	if err != nil {
+		return 0, fmt.Errorf("failed to parse bpftool output: %w", err)
+	}
 
-				for _, mapID := range prog.MapIDs {
-					mapFD, err := bpf.GetMapFDByID(mapID)
-					if err != nil {
-						return 0, fmt.Errorf("failed to get map FD from ID: %w", err)
-					}
-					mapInfo, err := bpf.GetMapInfo(mapFD)
-					if err != nil {
-						err = mapFD.Close()
-						if err != nil {
-							log.WithError(err).Panic("Failed to close FD.")
-						}
-						return 0, fmt.Errorf("failed to get map info: %w", err)
-					}
-					if mapInfo.Type == unix.BPF_MAP_TYPE_PROG_ARRAY {
-						logCtx.WithField("fd", mapFD).Debug("Found jump map")
-						return mapFD, nil
-					}
-					err = mapFD.Close()
-					if err != nil {
-						log.WithError(err).Panic("Failed to close FD.")
-					}
-				}
+	for _, mapID := range prog.MapIDs {
+		mapFD, err := bpf.GetMapFDByID(mapID)
+		if err != nil {
+			return 0, fmt.Errorf("failed to get map FD from ID: %w", err)
+		}
+		mapInfo, err := bpf.GetMapInfo(mapFD)
+		if err != nil {
+			err = mapFD.Close()
+			if err != nil {
+				log.WithError(err).Panic("Failed to close FD.")
 			}
-
-			return 0, errors.New("failed to find map")
+			return 0, fmt.Errorf("failed to get map info: %w", err)
+		}
+		// The host endpoint programs also refer to the global cali_wep_progs map, only the
+		// per-program jump map is of interest.
+		if mapInfo.Type == unix.BPF_MAP_TYPE_PROG_ARRAY && mapInfo.MaxEntries != tc.WEPProgsMapParams.MaxEntries &&
+			mapInfo.MaxEntries != tc.PolProgsMapParams.MaxEntries {
+			logCtx.WithField("fd", mapFD).Debug("Found jump map")
+			return mapFD, nil
+		}
+		err = mapFD.Close()
+		if err != nil {
+			log.WithError(err).Panic("Failed to close FD.")
 		}
 	}
-	return 0, errors.New("failed to find TC program")
+
+	return 0, errors.New("failed to find map")
 }
 
 func (m *bpfEndpointManager) getInterfaceIP(ifaceName string) (*net.IP, error) {
@@ -17,6 +17,7 @@
 package intdataplane
 
 import (
+	"net"
 	"regexp"
 	"sync"
 
@@ -31,6 +32,7 @@ import (
 	"github.com/projectcalico/felix/bpf/polprog"
 	"github.com/projectcalico/felix/bpf/state"
 	"github.com/projectcalico/felix/bpf/tc"
+	"github.com/projectcalico/felix/bpf/xdp"
 	"github.com/projectcalico/felix/idalloc"
 	"github.com/projectcalico/felix/ifacemonitor"
 	"github.com/projectcalico/felix/ipsets"
@@ -91,6 +93,30 @@ func (m *mockDataplane) setAcceptLocal(iface string, val bool) error {
 	return nil
 }
 
+func (m *mockDataplane) interfaceOwningIP(ip net.IP) (int, error) {
+	return 0, nil
+}
+
+func (m *mockDataplane) ensureXDPAttached(ap *xdp.AttachPoint) error {
+	return nil
+}
+
+func (m *mockDataplane) ensureXDPDetached(iface string) error {
+	return nil
+}
+
+func (m *mockDataplane) updateXDPPolicy(ap *xdp.AttachPoint, rules *polprog.Rules) error {
+	return nil
+}
+
+func (m *mockDataplane) ensureFQ(iface string) error {
+	return nil
+}
+
+func (m *mockDataplane) updateEgressBandwidth(iface string, bitsPerSec uint64) error {
+	return nil
+}
+
 func (m *mockDataplane) getRules(key string) *polprog.Rules {
 	m.mutex.Lock()
 	defer m.mutex.Unlock()
@@ -125,6 +151,7 @@ var _ = Describe("BPF Endpoint Manager", func() {
 		nodePortDSR          bool
 		bpfMapContext        *bpf.MapContext
 		ipSetsMap            bpf.Map
+		ipSetsExactMap       bpf.Map
 		stateMap             bpf.Map
 		rrConfigNormal       rules.Config
 		ruleRenderer         rules.RuleRenderer
@@ -143,6 +170,7 @@ var _ = Describe("BPF Endpoint Manager", func() {
 			RepinningEnabled: true,
 		}
 		ipSetsMap = bpfipsets.Map(bpfMapContext)
+		ipSetsExactMap = bpfipsets.ExactMap(bpfMapContext)
 		stateMap = state.Map(bpfMapContext)
 		rrConfigNormal = rules.Config{
 			IPIPEnabled:                 true,
@@ -178,8 +206,40 @@ var _ = Describe("BPF Endpoint Manager", func() {
 			uint16(rrConfigNormal.VXLANPort),
 			nodePortDSR,
 			0,
+			0,
+			false,
+			false,
+			false,
+			false,
+			false,
+			false,
+			false,
+			false,
+			false,
+			0,
+			false,
+			false,
+			false,
+			0,
+			0,
+			0,
+			nil,
+			false,
+			nil,
+			tc.ProgVariant{},
 			ipSetsMap,
+			ipSetsExactMap,
+			nil,
+			nil,
 			stateMap,
+			nil,
+			nil,
+			nil,
+			nil,
+			nil,
+			nil,
+			nil,
+			nil,
 			ruleRenderer,
 			filterTableV4,
 			nil,
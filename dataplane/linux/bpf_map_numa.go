@@ -0,0 +1,78 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	bpfipsets "github.com/projectcalico/felix/bpf/ipsets"
+	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+// bpfNUMAReplicatedMaps maps the read-mostly maps that have a replica on the second NUMA node to
+// their replicas, see bpf.NUMAReplicatedMap.
+var bpfNUMAReplicatedMaps = func() map[string]string {
+	m := map[string]string{}
+	for _, p := range [][2]bpf.MapParameters{
+		{routes.MapParameters, routes.MapReplicaParameters},
+		{routes.ExactMapParameters, routes.ExactMapReplicaParameters},
+		{nat.FrontendMapParameters, nat.FrontendMapReplicaParameters},
+		{nat.FrontendExactMapParameters, nat.FrontendExactMapReplicaParameters},
+		{nat.NodePortMapParameters, nat.NodePortMapReplicaParameters},
+		{nat.BackendMapParameters, nat.BackendMapReplicaParameters},
+		{bpfipsets.MapParameters, bpfipsets.MapReplicaParameters},
+		{bpfipsets.ExactMapParameters, bpfipsets.ExactMapReplicaParameters},
+		{bpfipsets.MembersMapParameters, bpfipsets.MembersMapReplicaParameters},
+	} {
+		m[p[0].VersionedName()] = p[1].VersionedName()
+	}
+	return m
+}()
+
+// calculateBPFMapNUMANodes returns whether the read-mostly maps are replicated across the NUMA
+// nodes and the NUMA nodes of the maps, indexed by versioned map name as used by
+// bpf.MapContext.NUMANodes.  The primary maps go on the first node and their replicas on the
+// second; the programs on any further nodes use the primary maps.  A ctNode of -1 leaves the
+// conntrack map wherever the kernel allocates it.
+func calculateBPFMapNUMANodes(replicasEnabled bool, ctNode int, numNodes int) (bool, map[string]int) {
+	nodes := map[string]int{}
+
+	if replicasEnabled && numNodes < 2 {
+		log.WithField("numaNodes", numNodes).Info(
+			"BPF map NUMA replicas enabled but the node has a single NUMA node, not replicating.")
+		replicasEnabled = false
+	}
+	if replicasEnabled {
+		for primary, replica := range bpfNUMAReplicatedMaps {
+			nodes[primary] = 0
+			nodes[replica] = 1
+		}
+	}
+
+	if ctNode >= 0 {
+		if ctNode < numNodes {
+			nodes[conntrack.MapParams.VersionedName()] = ctNode
+		} else {
+			log.WithFields(log.Fields{"node": ctNode, "numaNodes": numNodes}).Warn(
+				"BPFConntrackNUMANode is not an online NUMA node, leaving the conntrack map unpinned.")
+		}
+	}
+
+	log.WithFields(log.Fields{"replicas": replicasEnabled, "nodes": nodes}).Info("Calculated BPF map NUMA nodes")
+	return replicasEnabled, nodes
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"bufio"
+	"fmt"
+	"os"
+	"strings"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf/arp"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	bpfipsets "github.com/projectcalico/felix/bpf/ipsets"
+	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+const (
+	// bpfAutoMapSizeFlowsPerPod is the number of concurrent flows that we size the flow-scaled maps
+	// for, per pod.  With the kubelet's default of 110 pods, it gives roughly the built-in conntrack
+	// map size.
+	bpfAutoMapSizeFlowsPerPod = 4096
+	// bpfAutoMapSizeUDPSocketsPerPod is the number of connected UDP sockets per pod that we size the
+	// connect-time NAT map for.
+	bpfAutoMapSizeUDPSocketsPerPod = 128
+	// bpfAutoMapSizeMemDivisor limits each flow-scaled map to 1/bpfAutoMapSizeMemDivisor of the node's
+	// memory.
+	bpfAutoMapSizeMemDivisor = 100
+	// bpfConntrackEntryCost approximates the kernel memory used by a conntrack entry: key, value and
+	// the hash table's per-element overhead.
+	bpfConntrackEntryCost = conntrack.KeySize + conntrack.ValueSize + 48
+
+	bpfAutoMapSizeMinFlows      = 64 * 1024
+	bpfAutoMapSizeMaxFlows      = 4 * 1024 * 1024
+	bpfAutoMapSizeMinUDPSockets = 10000
+	bpfAutoMapSizeMaxUDPSockets = 1024 * 1024
+)
+
+// BPFMapSizes are the configured sizes of the BPF maps; zero means "use the default".
+type BPFMapSizes struct {
+	Conntrack   int
+	NATFrontend int
+	NATBackend  int
+	NATAffinity int
+	Routes      int
+	IPSets      int
+	ARP         int
+	CTNATs      int
+
+	// AutoEnabled scales the maps whose size depends on the number of flows through the node to the
+	// node's memory and AutoMaxPods.  Explicitly configured sizes take precedence.
+	AutoEnabled bool
+	AutoMaxPods int
+}
+
+// calculateBPFMapSizes returns the max entries of the maps that should differ from their built-in
+// defaults, indexed by versioned map name, as used by bpf.MapContext.MapSizes.
+func calculateBPFMapSizes(conf BPFMapSizes, memTotalBytes uint64) map[string]uint32 {
+	sizes := map[string]uint32{}
+
+	if conf.AutoEnabled {
+		flows := conf.AutoMaxPods * bpfAutoMapSizeFlowsPerPod
+		if memTotalBytes > 0 {
+			flows = minInt(flows, int(memTotalBytes/bpfAutoMapSizeMemDivisor/bpfConntrackEntryCost))
+		}
+		flows = clampInt(flows, bpfAutoMapSizeMinFlows, bpfAutoMapSizeMaxFlows)
+		udpSockets := clampInt(conf.AutoMaxPods*bpfAutoMapSizeUDPSocketsPerPod,
+			bpfAutoMapSizeMinUDPSockets, bpfAutoMapSizeMaxUDPSockets)
+
+		sizes[conntrack.MapParams.VersionedName()] = uint32(flows)
+		sizes[conntrack.AcctMapParams.VersionedName()] = uint32(flows)
+		sizes[nat.AffinityMapParameters.VersionedName()] = uint32(flows)
+		sizes[nat.SendRecvMsgMapParameters.VersionedName()] = uint32(flows)
+		sizes[nat.CTNATsMapParameters.VersionedName()] = uint32(udpSockets)
+	}
+
+	for name, size := range map[string]int{
+		conntrack.MapParams.VersionedName():            conf.Conntrack,
+		conntrack.AcctMapParams.VersionedName():        conf.Conntrack,
+		nat.FrontendMapParameters.VersionedName():      conf.NATFrontend,
+		nat.FrontendExactMapParameters.VersionedName(): conf.NATFrontend,
+		nat.BackendMapParameters.VersionedName():       conf.NATBackend,
+		nat.AffinityMapParameters.VersionedName():      conf.NATAffinity,
+		routes.MapParameters.VersionedName():           conf.Routes,
+		routes.ExactMapParameters.VersionedName():      conf.Routes,
+		bpfipsets.MapParameters.VersionedName():        conf.IPSets,
+		bpfipsets.ExactMapParameters.VersionedName():   conf.IPSets,
+		bpfipsets.MembersMapParameters.VersionedName(): conf.IPSets,
+		arp.MapParams.VersionedName():                  conf.ARP,
+		nat.CTNATsMapParameters.VersionedName():        conf.CTNATs,
+	} {
+		if size > 0 {
+			sizes[name] = uint32(size)
+		}
+	}
+
+	// The NUMA replicas must be able to hold everything that their maps hold.
+	for primary, replica := range bpfNUMAReplicatedMaps {
+		if size, ok := sizes[primary]; ok {
+			sizes[replica] = size
+		}
+	}
+
+	log.WithField("sizes", sizes).Info("Calculated BPF map sizes")
+	return sizes
+}
+
+// readMemTotal returns the total memory of the node, from /proc/meminfo.
+func readMemTotal() (uint64, error) {
+	f, err := os.Open("/proc/meminfo")
+	if err != nil {
+		return 0, err
+	}
+	defer f.Close()
+
+	scanner := bufio.NewScanner(f)
+	for scanner.Scan() {
+		line := scanner.Text()
+		if !strings.HasPrefix(line, "MemTotal:") {
+			continue
+		}
+		var kb uint64
+		_, err := fmt.Sscanf(strings.TrimPrefix(line, "MemTotal:"), "%d kB", &kb)
+		if err != nil {
+			return 0, fmt.Errorf("failed to parse %q: %w", line, err)
+		}
+		return kb * 1024, nil
+	}
+	if err := scanner.Err(); err != nil {
+		return 0, err
+	}
+	return 0, fmt.Errorf("MemTotal not found in /proc/meminfo")
+}
+
+func minInt(a, b int) int {
+	if a < b {
+		return a
+	}
+	return b
+}
+
+func clampInt(v, lo, hi int) int {
+	if v < lo {
+		return lo
+	}
+	if v > hi {
+		return hi
+	}
+	return v
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/arp"
+	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/routes"
+)
+
+var _ = Describe("BPF map sizes", func() {
+	const gib = 1024 * 1024 * 1024
+
+	ctName := conntrack.MapParams.VersionedName()
+	affName := nat.AffinityMapParameters.VersionedName()
+	ctNATsName := nat.CTNATsMapParameters.VersionedName()
+
+	It("should keep the defaults when nothing is configured", func() {
+		Expect(calculateBPFMapSizes(BPFMapSizes{AutoMaxPods: 110}, 64*gib)).To(BeEmpty())
+	})
+
+	It("should use explicitly configured sizes", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{Conntrack: 1000, ARP: 50000}, 64*gib)
+		Expect(sizes).To(Equal(map[string]uint32{
+			ctName:                                  1000,
+			conntrack.AcctMapParams.VersionedName(): 1000,
+			arp.MapParams.VersionedName():           50000,
+		}))
+	})
+
+	It("should size flow maps by pod count on a large node", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{AutoEnabled: true, AutoMaxPods: 110}, 64*gib)
+		Expect(sizes[ctName]).To(BeNumerically("==", 110*bpfAutoMapSizeFlowsPerPod))
+		Expect(sizes[affName]).To(Equal(sizes[ctName]))
+		Expect(sizes[conntrack.AcctMapParams.VersionedName()]).To(Equal(sizes[ctName]))
+		Expect(sizes[ctNATsName]).To(BeNumerically("==", 110*bpfAutoMapSizeUDPSocketsPerPod))
+	})
+
+	It("should limit flow maps by memory on a small node", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{AutoEnabled: true, AutoMaxPods: 110}, 2*gib)
+		Expect(sizes[ctName]).To(BeNumerically("==", 2*gib/bpfAutoMapSizeMemDivisor/bpfConntrackEntryCost))
+		Expect(sizes[ctNATsName]).To(BeNumerically("==", bpfAutoMapSizeMinUDPSockets))
+	})
+
+	It("should clamp to the minimum and maximum", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{AutoEnabled: true, AutoMaxPods: 1}, 64*gib)
+		Expect(sizes[ctName]).To(BeNumerically("==", bpfAutoMapSizeMinFlows))
+		sizes = calculateBPFMapSizes(BPFMapSizes{AutoEnabled: true, AutoMaxPods: 100000}, 1024*gib)
+		Expect(sizes[ctName]).To(BeNumerically("==", bpfAutoMapSizeMaxFlows))
+	})
+
+	It("should size the NUMA replicas like their maps", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{Routes: 5000}, 64*gib)
+		Expect(sizes).To(Equal(map[string]uint32{
+			routes.MapParameters.VersionedName():             5000,
+			routes.MapReplicaParameters.VersionedName():      5000,
+			routes.ExactMapParameters.VersionedName():        5000,
+			routes.ExactMapReplicaParameters.VersionedName(): 5000,
+		}))
+	})
+
+	It("should prefer explicit sizes to automatic ones", func() {
+		sizes := calculateBPFMapSizes(BPFMapSizes{AutoEnabled: true, AutoMaxPods: 110, Conntrack: 1234}, 64*gib)
+		Expect(sizes[ctName]).To(BeNumerically("==", 1234))
+	})
+})
+
+var _ = Describe("BPF map NUMA nodes", func() {
+	ctName := conntrack.MapParams.VersionedName()
+
+	It("should place nothing by default", func() {
+		replicas, nodes := calculateBPFMapNUMANodes(false, -1, 2)
+		Expect(replicas).To(BeFalse())
+		Expect(nodes).To(BeEmpty())
+	})
+
+	It("should put the maps on the first node and their replicas on the second", func() {
+		replicas, nodes := calculateBPFMapNUMANodes(true, -1, 2)
+		Expect(replicas).To(BeTrue())
+		Expect(nodes).To(HaveLen(2 * len(bpfNUMAReplicatedMaps)))
+		Expect(nodes).To(HaveKeyWithValue(nat.BackendMapParameters.VersionedName(), 0))
+		Expect(nodes).To(HaveKeyWithValue(nat.BackendMapReplicaParameters.VersionedName(), 1))
+		Expect(nodes).NotTo(HaveKey(ctName))
+	})
+
+	It("should not replicate on a single node", func() {
+		replicas, nodes := calculateBPFMapNUMANodes(true, -1, 1)
+		Expect(replicas).To(BeFalse())
+		Expect(nodes).To(BeEmpty())
+	})
+
+	It("should pin the conntrack map to an online node only", func() {
+		_, nodes := calculateBPFMapNUMANodes(false, 1, 2)
+		Expect(nodes).To(Equal(map[string]int{ctName: 1}))
+		_, nodes = calculateBPFMapNUMANodes(false, 2, 2)
+		Expect(nodes).To(BeEmpty())
+	})
+})
@@ -0,0 +1,168 @@
+// +build !windows
+
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"sync"
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/counters"
+)
+
+var (
+	bpfMapEntriesDesc = prometheus.NewDesc(
+		"felix_bpf_map_entries",
+		"Number of entries in each BPF map, counted every BPFMapOccupancyRefreshInterval.",
+		[]string{"map"}, nil,
+	)
+	bpfMapEntriesHighWaterDesc = prometheus.NewDesc(
+		"felix_bpf_map_entries_high_water",
+		"Highest number of entries that each BPF map had since Felix started, as far as the "+
+			"counts every BPFMapOccupancyRefreshInterval saw.",
+		[]string{"map"}, nil,
+	)
+	bpfMapMaxEntriesDesc = prometheus.NewDesc(
+		"felix_bpf_map_max_entries",
+		"Capacity of each BPF map.",
+		[]string{"map"}, nil,
+	)
+	bpfMapUpdateFailuresDesc = prometheus.NewDesc(
+		"felix_bpf_map_update_failures_total",
+		"Number of updates of each BPF map that failed in the BPF programs, usually because the "+
+			"map is full.",
+		[]string{"map"}, nil,
+	)
+)
+
+// bpfMapStat is a map that bpfMapStatsCollector reports on.
+type bpfMapStat struct {
+	m bpf.Map
+	// errID is the index of the map's failed updates in the map of failed updates, or
+	// counters.MaxMapStatsMap if only Felix writes to the map.
+	errID counters.MapStatsMap
+
+	entries, highWater, maxEntries int
+	counted                        bool
+}
+
+// bpfMapStatsCollector exports the occupancy of the BPF maps that fill up with the traffic and the
+// failed updates that the BPF programs counted.
+//
+// Counting the entries of a map means reading all of it, so the collector only counts them every
+// refreshInterval, with batched lookups, and reports the last counts in between.  It opens its own
+// file descriptors of the maps so that it doesn't share state with their owners.
+type bpfMapStatsCollector struct {
+	errsMap         bpf.Map
+	refreshInterval time.Duration
+
+	lock        sync.Mutex
+	maps        []*bpfMapStat
+	lastCounted time.Time
+}
+
+func newBPFMapStatsCollector(errsMap bpf.Map, refreshInterval time.Duration,
+	maps map[counters.MapStatsMap]bpf.Map, felixMaps ...bpf.Map) *bpfMapStatsCollector {
+	c := &bpfMapStatsCollector{
+		errsMap:         errsMap,
+		refreshInterval: refreshInterval,
+	}
+	for id := counters.MapStatsMap(0); id < counters.MaxMapStatsMap; id++ {
+		if m, ok := maps[id]; ok {
+			c.maps = append(c.maps, &bpfMapStat{m: m, errID: id})
+		}
+	}
+	for _, m := range felixMaps {
+		c.maps = append(c.maps, &bpfMapStat{m: m, errID: counters.MaxMapStatsMap})
+	}
+	return c
+}
+
+func (c *bpfMapStatsCollector) Describe(ch chan<- *prometheus.Desc) {
+	ch <- bpfMapEntriesDesc
+	ch <- bpfMapEntriesHighWaterDesc
+	ch <- bpfMapMaxEntriesDesc
+	ch <- bpfMapUpdateFailuresDesc
+}
+
+func (c *bpfMapStatsCollector) Collect(ch chan<- prometheus.Metric) {
+	c.lock.Lock()
+	defer c.lock.Unlock()
+
+	if c.refreshInterval > 0 && time.Since(c.lastCounted) >= c.refreshInterval {
+		c.countEntries()
+		c.lastCounted = time.Now()
+	}
+
+	for _, s := range c.maps {
+		name := s.m.GetName()
+		if s.counted {
+			ch <- prometheus.MustNewConstMetric(bpfMapEntriesDesc, prometheus.GaugeValue,
+				float64(s.entries), name)
+			ch <- prometheus.MustNewConstMetric(bpfMapEntriesHighWaterDesc, prometheus.GaugeValue,
+				float64(s.highWater), name)
+		}
+		if s.maxEntries > 0 {
+			ch <- prometheus.MustNewConstMetric(bpfMapMaxEntriesDesc, prometheus.GaugeValue,
+				float64(s.maxEntries), name)
+		}
+		if s.errID == counters.MaxMapStatsMap {
+			continue
+		}
+		n, err := counters.ReadMapErrors(c.errsMap, s.errID)
+		if err != nil {
+			log.WithError(err).Debug("Failed to read BPF map failed updates.")
+			continue
+		}
+		ch <- prometheus.MustNewConstMetric(bpfMapUpdateFailuresDesc, prometheus.CounterValue,
+			float64(n), name)
+	}
+}
+
+func (c *bpfMapStatsCollector) countEntries() {
+	start := time.Now()
+	for _, s := range c.maps {
+		// Some of the maps only exist if the features that use them are enabled.
+		if err := s.m.Open(); err != nil {
+			log.WithError(err).WithField("map", s.m.GetName()).Debug("BPF map not available, not counting it.")
+			continue
+		}
+		if s.maxEntries == 0 {
+			if info, err := bpf.GetMapInfo(s.m.MapFD()); err == nil {
+				s.maxEntries = info.MaxEntries
+			}
+		}
+		n := 0
+		err := s.m.Iter(func(k, v []byte) bpf.IteratorAction {
+			n++
+			return bpf.IterNone
+		})
+		if err != nil {
+			log.WithError(err).WithField("map", s.m.GetName()).Warn("Failed to count the entries of BPF map.")
+			continue
+		}
+		s.entries = n
+		s.counted = true
+		if n > s.highWater {
+			s.highWater = n
+		}
+	}
+	log.WithField("timeTaken", time.Since(start)).Debug("Counted the entries of the BPF maps.")
+}
@@ -0,0 +1,106 @@
+// +build !windows
+
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"github.com/prometheus/client_golang/prometheus"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/counters"
+	"github.com/projectcalico/felix/bpf/polprog"
+)
+
+var (
+	bpfPolicyEvalSecondsDesc = prometheus.NewDesc(
+		"felix_bpf_policy_evaluation_seconds",
+		"Time that the BPF policy programs took to allow the first packet of a flow, by hook.  "+
+			"The sum is estimated from the bucket midpoints.",
+		[]string{"hook"}, nil,
+	)
+	bpfPolicyRuleHitsDesc = prometheus.NewDesc(
+		"felix_bpf_policy_rule_hits_total",
+		"Number of flows that each policy rule matched in the BPF dataplane.  Requires "+
+			"BPFPolicyRuleCountersEnabled.",
+		[]string{"policy", "rule_id"}, nil,
+	)
+)
+
+// bpfPolicyStatsCollector exports the policy latency histograms and, if the policy programs keep
+// them, the hit counters of the policy rules.
+type bpfPolicyStatsCollector struct {
+	m          *bpfEndpointManager
+	latencyMap bpf.Map
+}
+
+func newBPFPolicyStatsCollector(m *bpfEndpointManager, latencyMap bpf.Map) *bpfPolicyStatsCollector {
+	return &bpfPolicyStatsCollector{m: m, latencyMap: latencyMap}
+}
+
+func (c *bpfPolicyStatsCollector) Describe(ch chan<- *prometheus.Desc) {
+	ch <- bpfPolicyEvalSecondsDesc
+	ch <- bpfPolicyRuleHitsDesc
+}
+
+func (c *bpfPolicyStatsCollector) Collect(ch chan<- prometheus.Metric) {
+	for _, hook := range []counters.Hook{counters.HookToHost, counters.HookFromHost} {
+		lat, err := counters.ReadPolicyLatency(c.latencyMap, hook)
+		if err != nil {
+			log.WithError(err).Debug("Failed to read BPF policy latency.")
+			continue
+		}
+		ch <- latencyHistogram(bpfPolicyEvalSecondsDesc, lat, hook.String())
+	}
+
+	if c.m.ruleCountersMap == nil {
+		return
+	}
+	c.m.ruleCounterIDsLock.Lock()
+	ids := make(map[uint64]polprog.RuleCounterID, len(c.m.ruleCounterIDs))
+	for k, id := range c.m.ruleCounterIDs {
+		ids[k] = id
+	}
+	c.m.ruleCounterIDsLock.Unlock()
+
+	for k, id := range ids {
+		n, err := counters.ReadRuleCounter(c.m.ruleCountersMap, k)
+		if err != nil {
+			// The rule hasn't matched yet, or its counter aged out.
+			if !bpf.IsNotExists(err) {
+				log.WithError(err).WithField("rule", id).Debug("Failed to read BPF policy rule counter.")
+			}
+			continue
+		}
+		ch <- prometheus.MustNewConstMetric(bpfPolicyRuleHitsDesc, prometheus.CounterValue, float64(n),
+			id.Policy, id.RuleID)
+	}
+}
+
+// latencyHistogram converts a log2 histogram that a BPF program keeps to a Prometheus histogram.
+// The programs don't keep the sum so we estimate it from the bucket midpoints.
+func latencyHistogram(desc *prometheus.Desc, lat counters.Latency, labels ...string) prometheus.Metric {
+	var count uint64
+	var sum float64
+	buckets := map[float64]uint64{}
+	for i, n := range lat {
+		// Bucket i holds the events that took [2^i, 2^(i+1)) ns.
+		count += n
+		sum += float64(n) * 1.5 * float64(uint64(1)<<uint(i)) / 1e9
+		buckets[float64(uint64(1)<<uint(i+1))/1e9] = count
+	}
+	return prometheus.MustNewConstHistogram(desc, count, sum, buckets, labels...)
+}
@@ -0,0 +1,132 @@
+// +build !windows
+
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"github.com/prometheus/client_golang/prometheus"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/counters"
+)
+
+var (
+	bpfProgRunTimeDesc = prometheus.NewDesc(
+		"felix_bpf_program_run_seconds_total",
+		"Total time spent running the attached BPF programs, by object file.  Requires "+
+			"kernel.bpf_stats_enabled.",
+		[]string{"program"}, nil,
+	)
+	bpfProgRunCountDesc = prometheus.NewDesc(
+		"felix_bpf_program_runs_total",
+		"Number of times that the attached BPF programs ran, by object file.  Requires "+
+			"kernel.bpf_stats_enabled.",
+		[]string{"program"}, nil,
+	)
+	bpfProgLatencyDesc = prometheus.NewDesc(
+		"felix_bpf_program_latency_seconds",
+		"Time that the TC programs took with each packet, by hook and by path: fast for known "+
+			"flows, new for new flows and nat for NATted flows.  Requires BPFProgramLatencyEnabled.",
+		[]string{"hook", "path"}, nil,
+	)
+)
+
+// bpfProgStatsCollector exports the runtime statistics that the kernel keeps for the programs that
+// the endpoint manager attached.
+type bpfProgStatsCollector struct {
+	m *bpfEndpointManager
+}
+
+func newBPFProgStatsCollector(m *bpfEndpointManager) *bpfProgStatsCollector {
+	return &bpfProgStatsCollector{m: m}
+}
+
+func (c *bpfProgStatsCollector) Describe(ch chan<- *prometheus.Desc) {
+	ch <- bpfProgRunTimeDesc
+	ch <- bpfProgRunCountDesc
+}
+
+func (c *bpfProgStatsCollector) Collect(ch chan<- prometheus.Metric) {
+	// Shared programs are attached to many interfaces, only count each program once.
+	progFiles := map[int]string{}
+	c.m.ifacesLock.Lock()
+	for _, iface := range c.m.nameToIface {
+		for i, id := range iface.dpState.progIDs {
+			if id != 0 {
+				progFiles[id] = iface.dpState.progFiles[i]
+			}
+		}
+	}
+	c.m.ifacesLock.Unlock()
+
+	runTime := map[string]float64{}
+	runCount := map[string]uint64{}
+	for id, file := range progFiles {
+		info, err := progInfoByID(id)
+		if err != nil {
+			// The program may have been replaced since we looked.
+			log.WithError(err).WithField("progID", id).Debug("Failed to get BPF program info.")
+			continue
+		}
+		runTime[file] += info.RunTime.Seconds()
+		runCount[file] += info.RunCount
+	}
+
+	for file, t := range runTime {
+		ch <- prometheus.MustNewConstMetric(bpfProgRunTimeDesc, prometheus.CounterValue, t, file)
+		ch <- prometheus.MustNewConstMetric(bpfProgRunCountDesc, prometheus.CounterValue,
+			float64(runCount[file]), file)
+	}
+}
+
+func progInfoByID(id int) (*bpf.ProgInfo, error) {
+	fd, err := bpf.GetProgFDByID(id)
+	if err != nil {
+		return nil, err
+	}
+	defer func() {
+		_ = fd.Close()
+	}()
+	return bpf.GetProgInfo(fd)
+}
+
+// bpfProgLatencyCollector exports the latency histograms that the TC programs keep if
+// BPFProgramLatencyEnabled.
+type bpfProgLatencyCollector struct {
+	latencyMap bpf.Map
+}
+
+func newBPFProgLatencyCollector(latencyMap bpf.Map) *bpfProgLatencyCollector {
+	return &bpfProgLatencyCollector{latencyMap: latencyMap}
+}
+
+func (c *bpfProgLatencyCollector) Describe(ch chan<- *prometheus.Desc) {
+	ch <- bpfProgLatencyDesc
+}
+
+func (c *bpfProgLatencyCollector) Collect(ch chan<- prometheus.Metric) {
+	for hook := counters.ProgLatencyHook(0); hook < counters.MaxProgLatencyHook; hook++ {
+		for path := counters.ProgLatencyPath(0); path < counters.MaxProgLatencyPath; path++ {
+			lat, err := counters.ReadProgLatency(c.latencyMap, hook, path)
+			if err != nil {
+				log.WithError(err).Debug("Failed to read BPF program latency.")
+				continue
+			}
+			ch <- latencyHistogram(bpfProgLatencyDesc, lat, hook.String(), path.String())
+		}
+	}
+}
@@ -15,6 +15,7 @@
 package intdataplane
 
 import (
+	"encoding/binary"
 	"net"
 	"strings"
 	"sync"
@@ -35,6 +36,10 @@ type bpfRouteManager struct {
 	myNodename      string
 	resyncScheduled bool
 	routeMap        bpf.Map
+	// exactRouteMap holds a copy of the /32 routes of routeMap, see routes.ExactMapParameters.
+	exactRouteMap bpf.Map
+	// nhGroupMap holds the next-hop groups of the routes that have several next hops.
+	nhGroupMap bpf.Map
 
 	// These fields contain our cache of the input data, indexed for efficient updates
 	// and lookups:
@@ -74,6 +79,17 @@ type bpfRouteManager struct {
 	desiredRoutes map[routes.Key]routes.Value
 	dirtyRoutes   set.Set
 
+	// The next-hop groups that desiredRoutes refer to, by ID, and their reference counts.  IDs of
+	// groups that lose their last reference go to releasedNHGroupIDs; we clear the groups and free
+	// the IDs once no route in the dataplane refers to them any more.
+	nhGroupIDs         map[routes.NextHopGroup]uint32
+	nhGroups           map[uint32]routes.NextHopGroup
+	nhGroupRefs        map[uint32]int
+	freeNHGroupIDs     []uint32
+	nextNHGroupID      uint32
+	releasedNHGroupIDs []uint32
+	dirtyNHGroupIDs    set.Set
+
 	// Callbacks used to tell kube-proxy about the relevant routes.
 	cbLck           sync.RWMutex
 	hostIPsUpdateCB func([]net.IP)
@@ -117,6 +133,14 @@ func newBPFRouteManager(myNodename string, externalCIDRs []string, mc *bpf.MapCo
 
 		desiredRoutes: map[routes.Key]routes.Value{},
 		routeMap:      routes.Map(mc),
+		exactRouteMap: routes.ExactMap(mc),
+		nhGroupMap:    routes.NextHopGroupMap(mc),
+
+		nhGroupIDs:      map[routes.NextHopGroup]uint32{},
+		nhGroups:        map[uint32]routes.NextHopGroup{},
+		nhGroupRefs:     map[uint32]int{},
+		nextNHGroupID:   1,
+		dirtyNHGroupIDs: set.New(),
 
 		dirtyRoutes:     set.New(),
 		resyncScheduled: true,
@@ -184,6 +208,14 @@ func (m *bpfRouteManager) ensureDataplaneInitialised() {
 	if err != nil {
 		log.WithError(err).Panic("Failed to create route map")
 	}
+	err = m.exactRouteMap.EnsureExists()
+	if err != nil {
+		log.WithError(err).Panic("Failed to create exact route map")
+	}
+	err = m.nhGroupMap.EnsureExists()
+	if err != nil {
+		log.WithError(err).Panic("Failed to create next-hop group map")
+	}
 }
 
 func (m *bpfRouteManager) recalculateRoutesForDirtyCIDRs() {
@@ -199,13 +231,18 @@ func (m *bpfRouteManager) recalculateRoutesForDirtyCIDRs() {
 				// Value is already correct.  We're done.
 				return set.RemoveItem
 			}
+			m.refNHGroup(*newValue)
+			if exists {
+				m.unrefNHGroup(oldValue)
+			}
 			m.desiredRoutes[dataplaneKey] = *newValue
-			m.onRouteUpdateCB(dataplaneKey, *newValue)
+			m.onRouteUpdateCB(dataplaneKey, m.singleNextHopValue(*newValue))
 		} else {
 			if !exists {
 				// Value is already correct.  We're done.
 				return set.RemoveItem
 			}
+			m.unrefNHGroup(oldValue)
 			delete(m.desiredRoutes, dataplaneKey)
 			m.onRouteDeleteCB(dataplaneKey)
 		}
@@ -294,6 +331,11 @@ func (m *bpfRouteManager) calculateRoute(cidr ip.V4CIDR) *routes.Value {
 		}
 		nodeIP := net.ParseIP(cgRoute.DstNodeIp)
 		routeVal := routes.NewValueWithNextHop(flags, ip.FromNetIP(nodeIP).(ip.V4Addr))
+		if len(cgRoute.DstNodeIps) > 1 {
+			if id, ok := m.nhGroupID(cidr, cgRoute.DstNodeIps); ok {
+				routeVal = routes.NewValueWithNextHopGroup(flags, id)
+			}
+		}
 		route = &routeVal
 	case proto.RouteType_REMOTE_HOST:
 		flags |= routes.FlagsRemoteHost
@@ -322,10 +364,99 @@ func (m *bpfRouteManager) calculateRoute(cidr ip.V4CIDR) *routes.Value {
 	return route
 }
 
+// nhGroupID returns the ID of the next-hop group of the node IPs, allocating one if the group is new.
+// It returns false if the route can't have a group, in which case it should use the first node IP.
+func (m *bpfRouteManager) nhGroupID(cidr ip.V4CIDR, nodeIPs []string) (uint32, bool) {
+	var nextHops []ip.V4Addr
+	for _, s := range nodeIPs {
+		if addr, ok := ip.FromString(s).(ip.V4Addr); ok {
+			nextHops = append(nextHops, addr)
+		}
+	}
+	if len(nextHops) > routes.NextHopGroupMax {
+		log.WithFields(log.Fields{"cidr": cidr, "nextHops": nextHops}).Warnf(
+			"Route has more next hops than the BPF dataplane supports, using the first %d.",
+			routes.NextHopGroupMax)
+	}
+	grp := routes.NewNextHopGroup(nextHops)
+	if len(grp.NextHops()) < 2 {
+		return 0, false
+	}
+
+	if id, ok := m.nhGroupIDs[grp]; ok {
+		return id, true
+	}
+
+	var id uint32
+	if n := len(m.freeNHGroupIDs); n > 0 {
+		id = m.freeNHGroupIDs[n-1]
+		m.freeNHGroupIDs = m.freeNHGroupIDs[:n-1]
+	} else if m.nextNHGroupID < uint32(routes.NextHopGroupMapParameters.MaxEntries) {
+		id = m.nextNHGroupID
+		m.nextNHGroupID++
+	} else {
+		log.WithField("cidr", cidr).Warn("Out of BPF next-hop groups, route will use a single next hop.")
+		return 0, false
+	}
+
+	m.nhGroupIDs[grp] = id
+	m.nhGroups[id] = grp
+	m.dirtyNHGroupIDs.Add(id)
+	return id, true
+}
+
+func (m *bpfRouteManager) refNHGroup(v routes.Value) {
+	if v.Flags()&routes.FlagNextHopGroup != 0 {
+		m.nhGroupRefs[v.NextHopGroup()]++
+	}
+}
+
+func (m *bpfRouteManager) unrefNHGroup(v routes.Value) {
+	if v.Flags()&routes.FlagNextHopGroup == 0 {
+		return
+	}
+	id := v.NextHopGroup()
+	m.nhGroupRefs[id]--
+	if m.nhGroupRefs[id] > 0 {
+		return
+	}
+	delete(m.nhGroupRefs, id)
+	delete(m.nhGroupIDs, m.nhGroups[id])
+	delete(m.nhGroups, id)
+	m.dirtyNHGroupIDs.Discard(id)
+	m.releasedNHGroupIDs = append(m.releasedNHGroupIDs, id)
+}
+
+// singleNextHopValue returns the route with the first next hop of its group, if it has one, for the
+// callbacks, which only deal with single next hops.
+func (m *bpfRouteManager) singleNextHopValue(v routes.Value) routes.Value {
+	if v.Flags()&routes.FlagNextHopGroup == 0 {
+		return v
+	}
+	nextHops := m.nhGroups[v.NextHopGroup()].NextHops()
+	if len(nextHops) == 0 {
+		return v
+	}
+	return routes.NewValueWithNextHop(v.Flags()&^routes.FlagNextHopGroup, nextHops[0])
+}
+
 func (m *bpfRouteManager) applyUpdates() (numDels uint, numAdds uint) {
 
 	debug := log.GetLevel() >= log.DebugLevel
 
+	// Write the new groups before the routes that refer to them.
+	m.dirtyNHGroupIDs.Iter(func(item interface{}) error {
+		id := item.(uint32)
+		grp := m.nhGroups[id]
+		err := m.nhGroupMap.Update(routes.NextHopGroupKey(id), grp.AsBytes())
+		if err != nil {
+			log.WithError(err).WithField("id", id).Error("Failed to update BPF next-hop group")
+			m.resyncScheduled = true
+			return nil
+		}
+		return set.RemoveItem
+	})
+
 	m.dirtyRoutes.Iter(func(item interface{}) error {
 		key := item.(routes.Key)
 		value, present := m.desiredRoutes[key]
@@ -335,8 +466,19 @@ func (m *bpfRouteManager) applyUpdates() (numDels uint, numAdds uint) {
 			if debug {
 				log.WithField("k", key).Debug("Deleting route from dataplane")
 			}
+			// Remove the copy first so that the programs never find a route that has gone from the
+			// trie.
+			if key.IsExact() {
+				exactKey := key.ExactKey()
+				err := m.exactRouteMap.Delete(exactKey[:])
+				if err != nil && !bpf.IsNotExists(err) {
+					log.WithFields(log.Fields{"key": key}).Error("Failed to delete from exact BPF map")
+					m.resyncScheduled = true
+					return nil
+				}
+			}
 			err := m.routeMap.Delete(key[:])
-			if err != nil {
+			if err != nil && !bpf.IsNotExists(err) {
 				log.WithFields(log.Fields{"key": key}).Error("Failed to delete from BPF map")
 				m.resyncScheduled = true
 				return nil
@@ -355,9 +497,32 @@ func (m *bpfRouteManager) applyUpdates() (numDels uint, numAdds uint) {
 			m.resyncScheduled = true
 			return nil
 		}
+		if key.IsExact() {
+			exactKey := key.ExactKey()
+			err := m.exactRouteMap.Update(exactKey[:], value[:])
+			if err != nil {
+				log.WithFields(log.Fields{"key": key}).Error("Failed to update exact BPF map")
+				m.resyncScheduled = true
+				return nil
+			}
+		}
 		return set.RemoveItem
 	})
 
+	// Clear the groups that no route refers to any more.  A route that failed to update may still
+	// refer to one; the resync rewrites it and we keep the ID until then.
+	if m.dirtyRoutes.Len() == 0 {
+		var empty routes.NextHopGroup
+		for _, id := range m.releasedNHGroupIDs {
+			err := m.nhGroupMap.Update(routes.NextHopGroupKey(id), empty.AsBytes())
+			if err != nil {
+				log.WithError(err).WithField("id", id).Error("Failed to clear BPF next-hop group")
+			}
+			m.freeNHGroupIDs = append(m.freeNHGroupIDs, id)
+		}
+		m.releasedNHGroupIDs = nil
+	}
+
 	return
 }
 
@@ -365,6 +530,7 @@ func (m *bpfRouteManager) applyUpdates() (numDels uint, numAdds uint) {
 //
 // After this operation, m.dirtyRoutes only contains routes that are out-of-sync with the dataplane.
 // Already-correct routes are removed from the dirty set.  Missing, incorrect, and, superfluous routes are added.
+// A /32 route is only correct if the exact map has a correct copy of it too.
 func (m *bpfRouteManager) resyncWithDataplane() {
 	debug := log.GetLevel() >= log.DebugLevel
 	log.Info("Doing full resync of BPF routes map")
@@ -375,14 +541,66 @@ func (m *bpfRouteManager) resyncWithDataplane() {
 		m.dirtyRoutes.Add(k)
 	}
 
+	// Rewrite the groups that are wrong and queue any that we don't use for clearing.
+	m.dirtyNHGroupIDs.Clear()
+	var empty routes.NextHopGroup
+	err := m.nhGroupMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		id := binary.LittleEndian.Uint32(k)
+		var grp routes.NextHopGroup
+		copy(grp[:], v)
+
+		if desired, ok := m.nhGroups[id]; ok {
+			if desired != grp {
+				m.dirtyNHGroupIDs.Add(id)
+			}
+		} else if grp != empty && !m.nhGroupReleased(id) {
+			m.releasedNHGroupIDs = append(m.releasedNHGroupIDs, id)
+			m.removeFreeNHGroupID(id)
+		}
+		return bpf.IterNone
+	})
+	if err != nil {
+		log.WithError(err).Panic("Failed to scan next-hop group BPF map.")
+	}
+
+	exactRoutes := map[routes.Key]routes.Value{}
+	err = m.exactRouteMap.Iter(func(k, v []byte) bpf.IteratorAction {
+		var exactKey routes.ExactKey
+		var value routes.Value
+		copy(exactKey[:], k)
+		copy(value[:], v)
+
+		key := exactKey.Key()
+		exactRoutes[key] = value
+		if _, ok := m.desiredRoutes[key]; !ok {
+			// Only in the exact map, deleting the route removes it.
+			if debug {
+				log.WithField("k", key).Debug("Unexpected exact route in dataplane.")
+			}
+			m.dirtyRoutes.Add(key)
+		}
+		return bpf.IterNone
+	})
+	if err != nil {
+		log.WithError(err).Panic("Failed to scan exact BPF map.")
+	}
+
 	// Scan the dataplane, discarding any routes that are already correct.
-	err := m.routeMap.Iter(func(k, v []byte) bpf.IteratorAction {
+	err = m.routeMap.Iter(func(k, v []byte) bpf.IteratorAction {
 		var key routes.Key
 		var value routes.Value
 		copy(key[:], k)
 		copy(value[:], v)
 
-		if desired, ok := m.desiredRoutes[key]; ok && desired == value {
+		if key.IsExact() && exactRoutes[key] != value {
+			// The copy is missing or stale, leave the route dirty so that we rewrite both.
+			if debug {
+				log.WithField("k", key).Debug("Exact copy of route missing or incorrect.")
+			}
+			if _, ok := m.desiredRoutes[key]; !ok {
+				m.dirtyRoutes.Add(key)
+			}
+		} else if desired, ok := m.desiredRoutes[key]; ok && desired == value {
 			// Route is already correct.
 			if debug {
 				log.WithField("k", key).WithField("v", value).Debug("Route already correct.")
@@ -407,6 +625,33 @@ func (m *bpfRouteManager) resyncWithDataplane() {
 	}
 }
 
+func (m *bpfRouteManager) nhGroupReleased(id uint32) bool {
+	for _, released := range m.releasedNHGroupIDs {
+		if released == id {
+			return true
+		}
+	}
+	return false
+}
+
+// removeFreeNHGroupID stops us from reusing the ID of a group that is still in the dataplane before we
+// clear it.
+func (m *bpfRouteManager) removeFreeNHGroupID(id uint32) {
+	for i, free := range m.freeNHGroupIDs {
+		if free == id {
+			m.freeNHGroupIDs = append(m.freeNHGroupIDs[:i], m.freeNHGroupIDs[i+1:]...)
+			return
+		}
+	}
+	if id >= m.nextNHGroupID {
+		// Left behind by a previous run: hand out the IDs below it first.
+		for free := m.nextNHGroupID; free < id; free++ {
+			m.freeNHGroupIDs = append(m.freeNHGroupIDs, free)
+		}
+		m.nextNHGroupID = id + 1
+	}
+}
+
 func (m *bpfRouteManager) onIfaceUpdate(msg *ifaceUpdate) {
 	// We're interested in the mapping from interface name to interface index.
 	if msg.State == ifacemonitor.StateUp {
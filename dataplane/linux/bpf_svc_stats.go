@@ -0,0 +1,90 @@
+// +build !windows
+
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"github.com/prometheus/client_golang/prometheus"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/nat"
+)
+
+var bpfServiceCounterDescs = [nat.MaxServiceCounter]*prometheus.Desc{
+	nat.ServiceNewFlows: prometheus.NewDesc(
+		"felix_bpf_service_new_flows_total",
+		"Number of new flows to each service that the BPF programs sent to a backend.  Requires "+
+			"BPFServiceCountersEnabled.",
+		[]string{"service"}, nil,
+	),
+	nat.ServiceNoBackend: prometheus.NewDesc(
+		"felix_bpf_service_no_backend_total",
+		"Number of new flows to each service that the BPF programs refused because the service "+
+			"had no backend.  Requires BPFServiceCountersEnabled.",
+		[]string{"service"}, nil,
+	),
+	nat.ServiceSrcRangeDrops: prometheus.NewDesc(
+		"felix_bpf_service_source_range_drops_total",
+		"Number of new flows to each service that the BPF programs dropped because their source "+
+			"was not in the load balancer source ranges.  Requires BPFServiceCountersEnabled.",
+		[]string{"service"}, nil,
+	),
+}
+
+// bpfServiceStatsCollector exports the per-service counters that the BPF programs keep by ID,
+// under the names of the services.  A service changes ID when most of its backends change, the
+// counters then start again from zero.
+type bpfServiceStatsCollector struct {
+	ctrsMap  bpf.Map
+	svcNames func() map[uint32]string
+}
+
+func newBPFServiceStatsCollector(ctrsMap bpf.Map, svcNames func() map[uint32]string) *bpfServiceStatsCollector {
+	return &bpfServiceStatsCollector{ctrsMap: ctrsMap, svcNames: svcNames}
+}
+
+func (c *bpfServiceStatsCollector) Describe(ch chan<- *prometheus.Desc) {
+	for _, d := range bpfServiceCounterDescs {
+		ch <- d
+	}
+}
+
+func (c *bpfServiceStatsCollector) Collect(ch chan<- prometheus.Metric) {
+	// A service has several IDs if it has NodePorts or external IPs.
+	bySvc := map[string]nat.ServiceCounters{}
+	for id, name := range c.svcNames() {
+		ctrs, err := nat.ReadServiceCounters(c.ctrsMap, id)
+		if err != nil {
+			// The service hasn't had a new flow yet, or its counters aged out.
+			if !bpf.IsNotExists(err) {
+				log.WithError(err).WithField("service", name).Debug("Failed to read BPF service counters.")
+			}
+			continue
+		}
+		sum := bySvc[name]
+		for i := range sum {
+			sum[i] += ctrs[i]
+		}
+		bySvc[name] = sum
+	}
+
+	for name, ctrs := range bySvc {
+		for i, d := range bpfServiceCounterDescs {
+			ch <- prometheus.MustNewConstMetric(d, prometheus.CounterValue, float64(ctrs[i]), name)
+		}
+	}
+}
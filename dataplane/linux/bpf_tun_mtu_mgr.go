@@ -0,0 +1,201 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"fmt"
+	"net"
+
+	log "github.com/sirupsen/logrus"
+	"github.com/vishvananda/netlink"
+
+	"github.com/projectcalico/felix/bpf"
+	"github.com/projectcalico/felix/bpf/routes"
+	"github.com/projectcalico/felix/ip"
+	"github.com/projectcalico/felix/proto"
+)
+
+// tunPath is the path to a remote node as the kernel routes it.
+type tunPath struct {
+	ifIndex int
+	mtu     int
+}
+
+// bpfTunMTUManager maintains the map of the MTUs of the NodePort tunnels to the remote nodes.  It
+// sizes each tunnel to the MTU of the route to the node, so that the nodes that we can reach over
+// jumbo frames get a larger tunnel MTU than the VXLANMTU, which suits the smallest path.
+type bpfTunMTUManager struct {
+	defaultMTU int
+	tunMTUMap  bpf.Map
+
+	// nodes maps the IPs of the remote nodes to their path, which is nil until we look it up.
+	nodes         map[ip.V4Addr]*tunPath
+	dirtyNodes    map[ip.V4Addr]bool
+	resyncPending bool
+
+	// pathMTU returns the interface and the MTU of the route to the given IP.
+	pathMTU func(net.IP) (ifIndex, mtu int, err error)
+}
+
+func newBPFTunMTUManager(defaultMTU int, mc *bpf.MapContext) *bpfTunMTUManager {
+	return newBPFTunMTUManagerWithShims(defaultMTU, routes.TunMTUMap(mc), netlinkPathMTU)
+}
+
+func newBPFTunMTUManagerWithShims(defaultMTU int, tunMTUMap bpf.Map,
+	pathMTU func(net.IP) (int, int, error)) *bpfTunMTUManager {
+	return &bpfTunMTUManager{
+		defaultMTU:    defaultMTU,
+		tunMTUMap:     tunMTUMap,
+		nodes:         map[ip.V4Addr]*tunPath{},
+		dirtyNodes:    map[ip.V4Addr]bool{},
+		resyncPending: true,
+		pathMTU:       pathMTU,
+	}
+}
+
+func (m *bpfTunMTUManager) OnUpdate(msg interface{}) {
+	switch msg := msg.(type) {
+	case *proto.RouteUpdate:
+		if msg.Type != proto.RouteType_REMOTE_HOST {
+			m.onRouteRemove(msg.Dst)
+			return
+		}
+		addr, ok := tunMTUNodeAddr(msg.Dst)
+		if !ok {
+			return
+		}
+		if _, ok := m.nodes[addr]; !ok {
+			m.nodes[addr] = nil
+			m.dirtyNodes[addr] = true
+		}
+	case *proto.RouteRemove:
+		m.onRouteRemove(msg.Dst)
+	case *ifaceUpdate:
+		// The route to a node may have moved to another interface.
+		for addr, path := range m.nodes {
+			if path != nil && path.ifIndex == msg.Index {
+				m.dirtyNodes[addr] = true
+			}
+		}
+	}
+}
+
+func (m *bpfTunMTUManager) onRouteRemove(dst string) {
+	addr, ok := tunMTUNodeAddr(dst)
+	if !ok {
+		return
+	}
+	if _, ok := m.nodes[addr]; ok {
+		delete(m.nodes, addr)
+		m.dirtyNodes[addr] = true
+	}
+}
+
+func tunMTUNodeAddr(dst string) (ip.V4Addr, bool) {
+	cidr, err := ip.ParseCIDROrIP(dst)
+	if err != nil {
+		return ip.V4Addr{}, false
+	}
+	v4CIDR, ok := cidr.(ip.V4CIDR)
+	if !ok || v4CIDR.Prefix() != 32 {
+		return ip.V4Addr{}, false
+	}
+	return v4CIDR.Addr().(ip.V4Addr), true
+}
+
+func (m *bpfTunMTUManager) CompleteDeferredWork() error {
+	if m.resyncPending {
+		err := m.tunMTUMap.EnsureExists()
+		if err != nil {
+			return fmt.Errorf("failed to create tunnel MTU map: %w", err)
+		}
+		// Remove the nodes that disappeared while we were not running.
+		err = m.tunMTUMap.Iter(func(k, v []byte) bpf.IteratorAction {
+			var addr ip.V4Addr
+			copy(addr[:], k)
+			if _, ok := m.nodes[addr]; !ok {
+				m.dirtyNodes[addr] = true
+			}
+			return bpf.IterNone
+		})
+		if err != nil {
+			return fmt.Errorf("failed to load tunnel MTU map: %w", err)
+		}
+		m.resyncPending = false
+	}
+
+	for addr := range m.dirtyNodes {
+		err := m.updateNode(addr)
+		if err != nil {
+			log.WithError(err).WithField("node", addr).Warn("Failed to update the tunnel MTU of node.")
+			continue
+		}
+		delete(m.dirtyNodes, addr)
+	}
+
+	return nil
+}
+
+func (m *bpfTunMTUManager) updateNode(addr ip.V4Addr) error {
+	key := routes.TunMTUKey(addr)
+
+	path, known := m.nodes[addr]
+	if known {
+		ifIndex, mtu, err := m.pathMTU(addr.AsNetIP())
+		if err != nil {
+			// Most likely the node has no route yet; the default MTU will have to do.
+			log.WithError(err).WithField("node", addr).Debug("Failed to look up the path MTU of node.")
+			path = &tunPath{}
+		} else {
+			path = &tunPath{ifIndex: ifIndex, mtu: mtu - vxlanMTUOverhead}
+		}
+		m.nodes[addr] = path
+	}
+
+	if !known || path.mtu <= m.defaultMTU {
+		// The default suits the node.
+		err := m.tunMTUMap.Delete(key)
+		if err != nil && !bpf.IsNotExists(err) {
+			return err
+		}
+		return nil
+	}
+
+	log.WithFields(log.Fields{"node": addr, "mtu": path.mtu}).Debug("Node has a larger tunnel MTU.")
+	return m.tunMTUMap.Update(key, routes.TunMTUValue(path.mtu))
+}
+
+// netlinkPathMTU returns the interface and the MTU of the kernel's route to the given IP, that is the MTU of the
+// route if it sets one, or else of its interface.
+func netlinkPathMTU(dst net.IP) (int, int, error) {
+	rts, err := netlink.RouteGet(dst)
+	if err != nil {
+		return 0, 0, err
+	}
+	if len(rts) == 0 {
+		return 0, 0, fmt.Errorf("no route to %s", dst)
+	}
+	rt := rts[0]
+
+	link, err := netlink.LinkByIndex(rt.LinkIndex)
+	if err != nil {
+		return 0, 0, err
+	}
+	mtu := link.Attrs().MTU
+	if rt.MTU > 0 && rt.MTU < mtu {
+		mtu = rt.MTU
+	}
+	return rt.LinkIndex, mtu, nil
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package intdataplane
+
+import (
+	"errors"
+	"net"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+
+	"github.com/projectcalico/felix/bpf/mock"
+	"github.com/projectcalico/felix/bpf/routes"
+	"github.com/projectcalico/felix/ip"
+	"github.com/projectcalico/felix/proto"
+)
+
+var _ = Describe("BPF tunnel MTU manager", func() {
+	var (
+		tunMap *mock.Map
+		mgr    *bpfTunMTUManager
+		mtus   map[string]int
+	)
+
+	jumboNode := ip.FromString("10.0.1.2").(ip.V4Addr)
+	node := ip.FromString("10.0.2.2").(ip.V4Addr)
+
+	BeforeEach(func() {
+		tunMap = mock.NewMockMap(routes.TunMTUMapParameters)
+		mtus = map[string]int{
+			jumboNode.String(): 9000,
+			node.String():      1500,
+		}
+		mgr = newBPFTunMTUManagerWithShims(1450, tunMap, func(dst net.IP) (int, int, error) {
+			mtu, ok := mtus[dst.String()]
+			if !ok {
+				return 0, 0, errors.New("no route")
+			}
+			return 2, mtu, nil
+		})
+	})
+
+	addNode := func(addr ip.V4Addr) {
+		mgr.OnUpdate(&proto.RouteUpdate{Type: proto.RouteType_REMOTE_HOST, Dst: addr.String() + "/32"})
+	}
+
+	tunMTU := func(addr ip.V4Addr) (int, bool) {
+		v, err := tunMap.Get(routes.TunMTUKey(addr))
+		if err != nil {
+			return 0, false
+		}
+		return int(v[0]) | int(v[1])<<8, true
+	}
+
+	It("should only add the nodes with a larger path MTU", func() {
+		addNode(jumboNode)
+		addNode(node)
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+
+		mtu, ok := tunMTU(jumboNode)
+		Expect(ok).To(BeTrue())
+		Expect(mtu).To(Equal(9000 - vxlanMTUOverhead))
+		_, ok = tunMTU(node)
+		Expect(ok).To(BeFalse())
+	})
+
+	It("should remove the nodes that go away", func() {
+		addNode(jumboNode)
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+
+		mgr.OnUpdate(&proto.RouteRemove{Dst: jumboNode.String() + "/32"})
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+		Expect(tunMap.Contents).To(BeEmpty())
+	})
+
+	It("should remove stale entries on start", func() {
+		Expect(tunMap.Update(routes.TunMTUKey(node), routes.TunMTUValue(8950))).To(Succeed())
+		addNode(jumboNode)
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+
+		_, ok := tunMTU(node)
+		Expect(ok).To(BeFalse())
+		_, ok = tunMTU(jumboNode)
+		Expect(ok).To(BeTrue())
+	})
+
+	It("should recheck the path when its interface changes", func() {
+		addNode(node)
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+		Expect(tunMap.Contents).To(BeEmpty())
+
+		mtus[node.String()] = 9000
+		mgr.OnUpdate(&ifaceUpdate{Name: "eth1", Index: 2})
+		Expect(mgr.CompleteDeferredWork()).To(Succeed())
+		_, ok := tunMTU(node)
+		Expect(ok).To(BeTrue())
+	})
+})
@@ -15,6 +15,7 @@
 package intdataplane
 
 import (
+	"bytes"
 	"fmt"
 	"io/ioutil"
 	"net"
@@ -25,6 +26,7 @@ import (
 	"sync"
 	"time"
 
+	"github.com/projectcalico/api/pkg/lib/numorstring"
 	"github.com/prometheus/client_golang/prometheus"
 	"github.com/sirupsen/logrus"
 	log "github.com/sirupsen/logrus"
@@ -35,13 +37,18 @@ import (
 	"github.com/projectcalico/felix/bpf"
 	"github.com/projectcalico/felix/bpf/arp"
 	"github.com/projectcalico/felix/bpf/conntrack"
+	"github.com/projectcalico/felix/bpf/counters"
+	"github.com/projectcalico/felix/bpf/edt"
 	"github.com/projectcalico/felix/bpf/failsafes"
+	"github.com/projectcalico/felix/bpf/ifcfg"
 	bpfipsets "github.com/projectcalico/felix/bpf/ipsets"
 	"github.com/projectcalico/felix/bpf/nat"
+	"github.com/projectcalico/felix/bpf/polcache"
 	bpfproxy "github.com/projectcalico/felix/bpf/proxy"
 	"github.com/projectcalico/felix/bpf/routes"
 	"github.com/projectcalico/felix/bpf/state"
 	"github.com/projectcalico/felix/bpf/tc"
+	"github.com/projectcalico/felix/bpf/xdp"
 	"github.com/projectcalico/felix/config"
 	"github.com/projectcalico/felix/idalloc"
 	"github.com/projectcalico/felix/ifacemonitor"
@@ -165,18 +172,62 @@ type Config struct {
 	BPFKubeProxyIptablesCleanupEnabled bool
 	BPFLogLevel                        string
 	BPFExtToServiceConnmark            int
+	BPFEventsSampleRate                int
+	BPFPacketCaptureEnabled            bool
+	BPFXDPEnabled                      bool
+	BPFXDPSynCookiePorts               []config.ProtoPort
+	BPFXDPCPUSteeringEnabled           bool
+	BPFXDPWorkloadsEnabled             bool
+	BPFConntrackMapType                string
+	BPFNATAffinityPerCPULRU            bool
+	BPFConntrackAccounting             bool
+	BPFNATOutgoingSNAT                 bool
+	BPFNATOutgoingPortRange            numorstring.Port
+	BPFEgressBandwidthShaping          bool
+	BPFServiceCountersEnabled          bool
+	BPFPolicyVerdictCacheEnabled       bool
+	BPFIPSetMembersMapEnabled          bool
+	BPFPolicyRuleGroupingEnabled       bool
+	BPFLeanTunnelProgramsEnabled       bool
+	BPFPolicyRuleCountersEnabled       bool
+	BPFRedirectNeighEnabled            bool
+	BPFAutoEnableKernelFeatures        bool
+	BPFWorkloadInlineEnabled           bool
+	BPFSharedProgramsEnabled           bool
+	BPFInterfaceConfigMapEnabled       bool
+	BPFProgramStatsEnabled             bool
+	BPFProgramLatencyEnabled           bool
+	BPFMapOccupancyRefreshInterval     time.Duration
+	BPFMapSizes                        BPFMapSizes
+	BPFMapNUMAReplicasEnabled          bool
+	BPFConntrackNUMANode               int
 	BPFDataIfacePattern                *regexp.Regexp
 	XDPEnabled                         bool
 	XDPAllowGeneric                    bool
 	BPFConntrackTimeouts               conntrack.Timeouts
+	BPFConntrackKernelCleanup          bool
+	BPFConntrackScanWorkers            int
+	BPFEndpointUpdateWorkers           int
+	BPFConntrackScanCPUBudgetPercent   int
+	BPFNodePortTunnelPathMTUEnabled    bool
+	BPFNodePortTunnelEnabled           bool
+	BPFConntrackReplicationPort        int
+	BPFConntrackReplicationPeers       []net.IP
+	BPFConntrackReplicationKeyFile     string
 	BPFCgroupV2                        string
 	BPFConnTimeLBEnabled               bool
+	BPFIPv6ConnTimeLBEnabled           bool
 	BPFMapRepin                        bool
 	BPFNodePortDSREnabled              bool
+	BPFMaglevEnabled                   bool
+	BPFServiceLocalBackendWeight       int
+	BPFTopologyAwareHintsEnabled       bool
 	KubeProxyMinSyncPeriod             time.Duration
 	KubeProxyEndpointSlicesEnabled     bool
 
-	SidecarAccelerationEnabled bool
+	SidecarAccelerationEnabled    bool
+	SidecarAccelerationApplyBytes int
+	SidecarAccelerationCorkBytes  int
 
 	LookPathOverride func(file string) (string, error)
 
@@ -483,7 +534,7 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 		if err := bpf.SupportsSockmap(); err != nil {
 			log.WithError(err).Warn("Can't enable Sockmap acceleration.")
 		} else {
-			st, err := NewSockmapState()
+			st, err := NewSockmapState(config.SidecarAccelerationApplyBytes, config.SidecarAccelerationCorkBytes)
 			if err != nil {
 				log.WithError(err).Warn("Can't enable Sockmap acceleration.")
 			} else {
@@ -501,7 +552,7 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 	}
 
 	if dp.sockmapState == nil {
-		st, err := NewSockmapState()
+		st, err := NewSockmapState(0, 0)
 		if err == nil {
 			st.WipeSockmap(bpf.FindInBPFFSOnly)
 		}
@@ -544,25 +595,76 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 
 	if config.BPFEnabled {
 		log.Info("BPF enabled, starting BPF endpoint manager and map manager.")
+		memTotal, err := readMemTotal()
+		if err != nil && config.BPFMapSizes.AutoEnabled {
+			log.WithError(err).Warn("Failed to read node memory, BPF map sizes will only be based on pod count.")
+		}
+		bpfMapContext.MapSizes = calculateBPFMapSizes(config.BPFMapSizes, memTotal)
+		numNUMANodes, err := bpf.NumNUMANodes()
+		if err != nil {
+			log.WithError(err).Warn("Failed to read the NUMA nodes, assuming a single node.")
+			numNUMANodes = 1
+		}
+		bpfMapContext.NUMAReplicasEnabled, bpfMapContext.NUMANodes = calculateBPFMapNUMANodes(
+			config.BPFMapNUMAReplicasEnabled, config.BPFConntrackNUMANode, numNUMANodes)
+		if !config.BPFConntrackAccounting {
+			// The programs refer to the map even if they don't count, keep it small.
+			bpfMapContext.MapSizes[conntrack.AcctMapParams.VersionedName()] = 1
+		}
 		// Register map managers first since they create the maps that will be used by the endpoint manager.
 		// Important that we create the maps before we load a BPF program with TC since we make sure the map
 		// metadata name is set whereas TC doesn't set that field.
 		ipSetIDAllocator := idalloc.New()
 		ipSetsMap := bpfipsets.Map(bpfMapContext)
-		err := ipSetsMap.EnsureExists()
+		err = ipSetsMap.EnsureExists()
 		if err != nil {
 			log.WithError(err).Panic("Failed to create ipsets BPF map.")
 		}
+		ipSetsExactMap := bpfipsets.ExactMap(bpfMapContext)
+		err = ipSetsExactMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create exact-match ipsets BPF map.")
+		}
+		var ipSetsMembersMap bpf.Map
+		if config.BPFIPSetMembersMapEnabled {
+			ipSetsMembersMap = bpfipsets.MembersMap(bpfMapContext)
+			err = ipSetsMembersMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create ipsets member BPF map.")
+			}
+		}
 		ipSetsV4 := bpfipsets.NewBPFIPSets(
 			ipSetsConfigV4,
 			ipSetIDAllocator,
 			ipSetsMap,
+			ipSetsExactMap,
+			ipSetsMembersMap,
 			dp.loopSummarizer,
 		)
 		dp.ipSets = append(dp.ipSets, ipSetsV4)
 		dp.RegisterManager(newIPSetsManager(ipSetsV4, config.MaxIPSetSize))
+
+		// The TC programs refer to the policy verdict cache maps even if the cache is disabled.
+		err = polcache.VerdictMap(bpfMapContext).EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create policy verdict cache BPF map.")
+		}
+		polGenerationMap := polcache.GenerationMap(bpfMapContext)
+		err = polGenerationMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create policy generation BPF map.")
+		}
+		var polGeneration *polcache.Generation
+		if config.BPFPolicyVerdictCacheEnabled {
+			polGeneration = polcache.NewGeneration(polGenerationMap)
+			ipSetsV4.SetPolicyGeneration(polGeneration)
+		}
+
 		bpfRTMgr := newBPFRouteManager(config.Hostname, config.ExternalNodesCidrs, bpfMapContext, dp.loopSummarizer)
 		dp.RegisterManager(bpfRTMgr)
+		if config.BPFNodePortTunnelPathMTUEnabled {
+			dp.RegisterManager(newBPFTunMTUManager(config.VXLANMTU, bpfMapContext))
+		}
 
 		// Forwarding into an IPIP tunnel fails silently because IPIP tunnels are L3 devices and support for
 		// L3 devices in BPF is not available yet.  Disable the FIB lookup in that case.
@@ -579,6 +681,17 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 			log.WithError(err).Panic("Failed to create ARP BPF map.")
 		}
 
+		countersMap := counters.Map(bpfMapContext)
+		err = countersMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create counters BPF map.")
+		}
+		mapErrorsMap := counters.MapErrorsMap(bpfMapContext)
+		err = mapErrorsMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create map failed updates BPF map.")
+		}
+
 		// The failsafe manager sets up the failsafe port map.  It's important that it is registered before the
 		// endpoint managers so that the map is brought up to date before they run for the first time.
 		failsafesMap := failsafes.Map(bpfMapContext)
@@ -586,14 +699,211 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 		if err != nil {
 			log.WithError(err).Panic("Failed to create failsafe port BPF map.")
 		}
+		failsafePortsMap := failsafes.PortsMap(bpfMapContext)
+		err = failsafePortsMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create failsafe port index BPF map.")
+		}
 		failsafeMgr := failsafes.NewManager(
 			failsafesMap,
+			failsafePortsMap,
 			config.RulesConfig.FailsafeInboundHostPorts,
 			config.RulesConfig.FailsafeOutboundHostPorts,
 			dp.loopSummarizer,
 		)
 		dp.RegisterManager(failsafeMgr)
 
+		// The XDP program's maps; the prefilter blocklist is managed externally, with calico-bpf.
+		var xdpTxMap bpf.Map
+		var xdpCPUSteering uint32
+		if config.BPFXDPEnabled {
+			err = xdp.PrefilterMap(bpfMapContext).EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create XDP prefilter BPF map.")
+			}
+			xdpTxMap = xdp.TxMap(bpfMapContext)
+			err = xdpTxMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create XDP redirect BPF map.")
+			}
+			synCookiePortsMap := xdp.SynCookiePortsMap(bpfMapContext)
+			err = synCookiePortsMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create XDP SYN cookie ports BPF map.")
+			}
+			err = xdp.SetSynCookiePorts(synCookiePortsMap, synCookiePorts(config))
+			if err != nil {
+				log.WithError(err).Panic("Failed to set XDP SYN cookie ports.")
+			}
+
+			// The programs refer to the CPU map even if they don't steer, and the kernel only
+			// accepts CPU maps up to the number of CPUs that it supports.
+			numCPUs, err := bpf.NumPossibleCPUs()
+			if err != nil {
+				log.WithError(err).Panic("Failed to get number of possible CPUs.")
+			}
+			bpfMapContext.MapSizes[xdp.CPUMapParams.VersionedName()] = uint32(numCPUs)
+			cpuMap := xdp.CPUMap(bpfMapContext)
+			err = cpuMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create XDP CPU BPF map.")
+			}
+			steerCPUs := 0
+			if config.BPFXDPCPUSteeringEnabled && numCPUs > 1 {
+				steerCPUs = numCPUs
+			}
+			err = xdp.SetCPUMap(cpuMap, numCPUs, steerCPUs)
+			if err != nil {
+				// Typically a CPU that is offline; the programs leave the packets that
+				// they would steer to it on the CPU that received them.
+				log.WithError(err).Warn("Failed to set up XDP CPU steering for all CPUs.")
+			}
+			xdpCPUSteering = uint32(steerCPUs)
+		}
+
+		// With BPFNATOutgoingSNAT, the workload programs SNAT the NAT-outgoing flows to ports of
+		// their own.  The config makes sure that they don't overlap NATPortRange, if set, and
+		// we reserve them so that the host's own connections don't pick them.  If we can't, they
+		// must be outside the ephemeral ports.
+		var natOutgoingPortMin, natOutgoingPortMax uint16
+		if config.BPFNATOutgoingSNAT {
+			portRange := config.BPFNATOutgoingPortRange
+			var ephemeral numorstring.Port
+			err := reserveLocalPorts(portRange)
+			if err != nil {
+				log.WithError(err).WithField("BPFNATOutgoingPortRange", portRange).Warn(
+					"Failed to reserve the NAT-outgoing ports, checking the ephemeral port range.")
+				ephemeral, err = ephemeralPortRange()
+			}
+			if err != nil {
+				log.WithError(err).Warn("Failed to read the ephemeral port range, " +
+					"leaving NAT-outgoing to iptables.")
+			} else if ephemeral.MaxPort > 0 &&
+				portRange.MinPort <= ephemeral.MaxPort && ephemeral.MinPort <= portRange.MaxPort {
+				log.WithFields(log.Fields{
+					"BPFNATOutgoingPortRange": portRange,
+					"ip_local_port_range":     ephemeral,
+				}).Warn("BPFNATOutgoingPortRange overlaps the ephemeral ports, " +
+					"leaving NAT-outgoing to iptables.")
+			} else {
+				natOutgoingPortMin = portRange.MinPort
+				natOutgoingPortMax = portRange.MaxPort
+			}
+		}
+
+		// Pick the program variants from what the kernel supports rather than from its version.
+		features := bpf.DetectFeatures()
+
+		redirectNeigh := config.BPFRedirectNeighEnabled
+		if redirectNeigh {
+			if err := bpf.SupportsRedirectNeigh(); err != nil {
+				log.WithError(err).Warn("BPFRedirectNeighEnabled is set but the kernel lacks the " +
+					"required BPF helpers; forwarding with the ARP map instead.")
+				redirectNeigh = false
+			}
+		} else if config.BPFAutoEnableKernelFeatures && bpf.SupportsRedirectNeigh() == nil {
+			log.Info("Kernel supports bpf_redirect_neigh(), forwarding with it.")
+			redirectNeigh = true
+		}
+
+		eventsSampleRate := config.BPFEventsSampleRate
+		if eventsSampleRate > 0 && bpf.SyscallSupport() && !features.RingBuf {
+			log.Warn("BPFEventsSampleRate is set but the kernel lacks BPF ring buffers; " +
+				"not emitting events.")
+			eventsSampleRate = 0
+		}
+		packetCapture := config.BPFPacketCaptureEnabled
+		if packetCapture && bpf.SyscallSupport() && !features.RingBuf {
+			log.Warn("BPFPacketCaptureEnabled is set but the kernel lacks BPF ring buffers; " +
+				"not capturing packets.")
+			packetCapture = false
+		}
+
+		natAffPerCPULRU := config.BPFNATAffinityPerCPULRU
+		if natAffPerCPULRU && bpf.SyscallSupport() && !features.LRUNoCommon {
+			log.Warn("BPFNATAffinityPerCPULRUEnabled is set but the kernel lacks per-CPU LRU " +
+				"lists; using a common LRU list.")
+			natAffPerCPULRU = false
+		}
+
+		// Inline delivery to workloads relies on bpf_redirect_peer() and on the FIB lookup finding
+		// the workload's veth.
+		var wepProgsMap bpf.Map
+		if config.BPFWorkloadInlineEnabled {
+			if err := bpf.SupportsRedirectNeigh(); err != nil {
+				log.WithError(err).Warn("BPFWorkloadInlineEnabled is set but the kernel lacks the " +
+					"required BPF helpers; delivering to workloads through their veths instead.")
+			} else if !fibLookupEnabled {
+				log.Warn("BPFWorkloadInlineEnabled is set but FIB lookups are disabled; delivering " +
+					"to workloads through their veths instead.")
+			} else {
+				wepProgsMap = tc.WEPProgsMap(bpfMapContext)
+				err = wepProgsMap.EnsureExists()
+				if err != nil {
+					log.WithError(err).Panic("Failed to create workload program BPF map.")
+				}
+			}
+		}
+
+		// Sharing the programs between interfaces needs the map of policy trampolines.
+		var polProgsMap bpf.Map
+		if config.BPFSharedProgramsEnabled {
+			polProgsMap = tc.PolProgsMap(bpfMapContext)
+			err = polProgsMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create policy trampoline BPF map.")
+			}
+		}
+
+		var ifaceCfgMap bpf.Map
+		if config.BPFInterfaceConfigMapEnabled {
+			ifaceCfgMap = ifcfg.Map(bpfMapContext)
+			err = ifaceCfgMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create interface configuration BPF map.")
+			}
+		}
+
+		var svcCtrsMap bpf.Map
+		if config.BPFServiceCountersEnabled {
+			svcCtrsMap = nat.ServiceCountersMap(bpfMapContext)
+			err = svcCtrsMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create service counters BPF map.")
+			}
+		}
+
+		var edtMap bpf.Map
+		if config.BPFEgressBandwidthShaping {
+			edtMap = edt.Map(bpfMapContext)
+			err = edtMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create egress bandwidth BPF map.")
+			}
+		}
+
+		var ruleCountersMap bpf.Map
+		if config.BPFPolicyRuleCountersEnabled {
+			ruleCountersMap = counters.RuleMap(bpfMapContext)
+			err = ruleCountersMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create policy rule counters BPF map.")
+			}
+		}
+		var progLatencyMap bpf.Map
+		if config.BPFProgramLatencyEnabled {
+			progLatencyMap = counters.ProgLatencyMap(bpfMapContext)
+			err = progLatencyMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create program latency BPF map.")
+			}
+		}
+		polLatencyMap := counters.PolicyLatencyMap(bpfMapContext)
+		err = polLatencyMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create policy latency BPF map.")
+		}
+
 		workloadIfaceRegex := regexp.MustCompile(strings.Join(interfaceRegexes, "|"))
 		bpfEndpointManager = newBPFEndpointManager(
 			config.BPFLogLevel,
@@ -607,14 +917,65 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 			uint16(config.VXLANPort),
 			config.BPFNodePortDSREnabled,
 			config.BPFExtToServiceConnmark,
+			eventsSampleRate,
+			packetCapture,
+			config.BPFXDPEnabled,
+			config.XDPAllowGeneric,
+			config.BPFConntrackMapType == conntrack.LRUMapParams.Type,
+			natAffPerCPULRU,
+			redirectNeigh,
+			config.BPFPolicyRuleGroupingEnabled,
+			config.BPFLeanTunnelProgramsEnabled,
+			len(synCookiePorts(config)) > 0,
+			xdpCPUSteering,
+			config.BPFXDPEnabled && config.BPFXDPWorkloadsEnabled,
+			config.BPFConntrackAccounting,
+			svcCtrsMap != nil,
+			natOutgoingPortMin,
+			natOutgoingPortMax,
+			config.BPFEndpointUpdateWorkers,
+			bpfMapContext.MapSizes,
+			bpfMapContext.NUMAReplicasEnabled,
+			bpfMapContext.NUMANodes,
+			bpfProgVariant(config),
 			ipSetsMap,
+			ipSetsExactMap,
+			ipSetsMembersMap,
+			ipSetsV4,
 			stateMap,
+			xdpTxMap,
+			wepProgsMap,
+			polProgsMap,
+			ifaceCfgMap,
+			edtMap,
+			ruleCountersMap,
+			progLatencyMap,
+			polGeneration,
 			ruleRenderer,
 			filterTableV4,
 			dp.reportHealth,
 			dp.loopSummarizer,
 		)
 		dp.RegisterManager(bpfEndpointManager)
+		if config.BPFProgramStatsEnabled {
+			prometheus.MustRegister(newBPFProgStatsCollector(bpfEndpointManager))
+		}
+		prometheus.MustRegister(newBPFPolicyStatsCollector(bpfEndpointManager, polLatencyMap))
+		if progLatencyMap != nil {
+			prometheus.MustRegister(newBPFProgLatencyCollector(progLatencyMap))
+		}
+		prometheus.MustRegister(newBPFMapStatsCollector(mapErrorsMap, config.BPFMapOccupancyRefreshInterval,
+			map[counters.MapStatsMap]bpf.Map{
+				counters.MapStatsCT:          conntrack.MapForType(bpfMapContext, config.BPFConntrackMapType),
+				counters.MapStatsNATAffinity: nat.AffinityMapWithLRU(bpfMapContext, natAffPerCPULRU),
+				counters.MapStatsARP:         arp.Map(bpfMapContext),
+				counters.MapStatsCTNATs:      nat.AllNATsMsgMap(bpfMapContext),
+				counters.MapStatsSendRecvMsg: nat.SendRecvMsgMap(bpfMapContext),
+				counters.MapStatsFrags:       conntrack.FragsMap(bpfMapContext),
+			},
+			bpfipsets.Map(bpfMapContext),
+			bpfipsets.ExactMap(bpfMapContext),
+		))
 
 		// Pre-create the NAT maps so that later operations can assume access.
 		frontendMap := nat.FrontendMap(bpfMapContext)
@@ -627,31 +988,79 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 		if err != nil {
 			log.WithError(err).Panic("Failed to create NAT backend BPF map.")
 		}
-		backendAffinityMap := nat.AffinityMap(bpfMapContext)
+		backendAffinityMap := nat.AffinityMapWithLRU(bpfMapContext, natAffPerCPULRU)
 		err = backendAffinityMap.EnsureExists()
 		if err != nil {
 			log.WithError(err).Panic("Failed to create NAT backend affinity BPF map.")
 		}
+		maglevMap := nat.MaglevMap(bpfMapContext)
+		err = maglevMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create NAT Maglev BPF map.")
+		}
 
 		routeMap := routes.Map(bpfMapContext)
 		err = routeMap.EnsureExists()
 		if err != nil {
 			log.WithError(err).Panic("Failed to create routes BPF map.")
 		}
+		exactRouteMap := routes.ExactMap(bpfMapContext)
+		err = exactRouteMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create exact routes BPF map.")
+		}
 
-		ctMap := conntrack.Map(bpfMapContext)
+		ctMap := conntrack.MapForType(bpfMapContext, config.BPFConntrackMapType)
 		err = ctMap.EnsureExists()
 		if err != nil {
 			log.WithError(err).Panic("Failed to create conntrack BPF map.")
 		}
 
-		conntrackScanner := conntrack.NewScanner(ctMap,
-			conntrack.NewLivenessScanner(config.BPFConntrackTimeouts, config.BPFNodePortDSREnabled))
+		var conntrackScanners []conntrack.EntryScanner
+		livenessInKernel := false
+		if config.BPFConntrackKernelCleanup {
+			// The in-kernel cleanup expires the entries without copying the table to userspace.
+			// It runs once when it is loaded.
+			kernelGC, err := conntrack.NewKernelGC(ctMap, config.BPFConntrackTimeouts,
+				config.BPFConntrackMapType == conntrack.LRUMapParams.Type, config.BPFLogLevel)
+			if err != nil {
+				log.WithError(err).Warn("Failed to load the in-kernel conntrack cleanup, falling back to userspace.")
+			} else {
+				kernelGC.Start()
+				livenessInKernel = true
+			}
+		}
+		if !livenessInKernel {
+			conntrackScanners = append(conntrackScanners,
+				conntrack.NewLivenessScanner(config.BPFConntrackTimeouts, config.BPFNodePortDSREnabled))
+		}
+		ctAcctMap := conntrack.AcctMap(bpfMapContext)
+		err = ctAcctMap.EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create conntrack accounting BPF map.")
+		}
+		err = conntrack.FragsMap(bpfMapContext).EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create IP fragments BPF map.")
+		}
+		err = conntrack.SNATPortMap(bpfMapContext).EnsureExists()
+		if err != nil {
+			log.WithError(err).Panic("Failed to create NAT-outgoing ports BPF map.")
+		}
+		if config.BPFConntrackAccounting {
+			// After the liveness scanner so that the flows that it expires are not reported.
+			conntrackScanners = append(conntrackScanners,
+				conntrack.NewAccountingScanner(ctAcctMap, bpfConntrackTopFlows))
+		}
+		conntrackScanner := conntrack.NewScanner(ctMap, conntrackScanners...)
+		conntrackScanner.ConfigureUnlocked(conntrack.WithScanWorkers(config.BPFConntrackScanWorkers))
 
 		// Before we start, scan for all finished / timed out connections to
 		// free up the conntrack table asap as it may take time to sync up the
 		// proxy and kick off the first full cleaner scan.
 		conntrackScanner.Scan()
+		// Only pace the periodic scans, the first one should finish as soon as it can.
+		conntrackScanner.ConfigureUnlocked(conntrack.WithScanCPUBudget(config.BPFConntrackScanCPUBudgetPercent))
 
 		bpfproxyOpts := []bpfproxy.Option{
 			bpfproxy.WithMinSyncPeriod(config.KubeProxyMinSyncPeriod),
@@ -665,6 +1074,45 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithDSREnabled())
 		}
 
+		if config.BPFMaglevEnabled {
+			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithMaglevEnabled())
+		}
+
+		if config.BPFConnTimeLBEnabled {
+			ctlbGenMap := nat.CTLBGenMap(bpfMapContext)
+			err = ctlbGenMap.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create connect-time load balancer generation BPF map.")
+			}
+			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithConnectTimeLBGenMap(ctlbGenMap))
+		}
+
+		if config.BPFServiceLocalBackendWeight > 1 {
+			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithLocalBackendWeight(config.BPFServiceLocalBackendWeight))
+		}
+
+		if config.BPFTopologyAwareHintsEnabled {
+			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithTopologyAwareHints())
+		}
+
+		ipv6ConnTimeLB := config.BPFIPv6ConnTimeLBEnabled && config.BPFConnTimeLBEnabled
+		if config.BPFIPv6ConnTimeLBEnabled && !ipv6ConnTimeLB {
+			log.Warn("BPFIPv6ConnectTimeLBEnabled is set but connect-time load balancing is disabled; ignoring.")
+		}
+		if ipv6ConnTimeLB {
+			frontendMapV6 := nat.FrontendMapV6(bpfMapContext)
+			err = frontendMapV6.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create IPv6 NAT frontend BPF map.")
+			}
+			backendMapV6 := nat.BackendMapV6(bpfMapContext)
+			err = backendMapV6.EnsureExists()
+			if err != nil {
+				log.WithError(err).Panic("Failed to create IPv6 NAT backend BPF map.")
+			}
+			bpfproxyOpts = append(bpfproxyOpts, bpfproxy.WithIPv6(frontendMapV6, backendMapV6))
+		}
+
 		if config.KubeClientSet != nil {
 			// We have a Kubernetes connection, start watching services and populating the NAT maps.
 			kp, err := bpfproxy.StartKubeProxy(
@@ -673,6 +1121,7 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 				frontendMap,
 				backendMap,
 				backendAffinityMap,
+				maglevMap,
 				ctMap,
 				bpfproxyOpts...,
 			)
@@ -680,8 +1129,28 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 				log.WithError(err).Panic("Failed to start kube-proxy.")
 			}
 			bpfRTMgr.setHostIPUpdatesCallBack(kp.OnHostIPsUpdate)
+			if svcCtrsMap != nil {
+				prometheus.MustRegister(newBPFServiceStatsCollector(svcCtrsMap, kp.ServiceNames))
+			}
 			bpfRTMgr.setRoutesCallBacks(kp.OnRouteUpdate, kp.OnRouteDelete)
 			conntrackScanner.AddUnlocked(conntrack.NewStaleNATScanner(kp))
+			if config.BPFConntrackReplicationPort != 0 && len(config.BPFConntrackReplicationPeers) > 0 {
+				key, err := ioutil.ReadFile(config.BPFConntrackReplicationKeyFile)
+				if err == nil && len(bytes.TrimSpace(key)) == 0 {
+					err = fmt.Errorf("empty key file %v", config.BPFConntrackReplicationKeyFile)
+				}
+				if err == nil {
+					replicator := conntrack.NewReplicator(ctMap, config.BPFConntrackReplicationPort,
+						config.BPFConntrackReplicationPeers, bytes.TrimSpace(key))
+					err = replicator.Start()
+					if err == nil {
+						conntrackScanner.AddUnlocked(replicator)
+					}
+				}
+				if err != nil {
+					log.WithError(err).Warn("Failed to start conntrack replication, continuing without it.")
+				}
+			}
 			conntrackScanner.Start()
 		} else {
 			log.Info("BPF enabled but no Kubernetes client available, unable to run kube-proxy module.")
@@ -689,7 +1158,8 @@ func NewIntDataplaneDriver(config Config) *InternalDataplane {
 
 		if config.BPFConnTimeLBEnabled {
 			// Activate the connect-time load balancer.
-			err = nat.InstallConnectTimeLoadBalancer(frontendMap, backendMap, routeMap, config.BPFCgroupV2, config.BPFLogLevel)
+			err = nat.InstallConnectTimeLoadBalancer(frontendMap, backendMap, routeMap, exactRouteMap,
+				config.BPFCgroupV2, config.BPFLogLevel, ipv6ConnTimeLB)
 			if err != nil {
 				log.WithError(err).Panic("BPFConnTimeLBEnabled but failed to attach connect-time load balancer, bailing out.")
 			}
@@ -1653,6 +2123,42 @@ func (d *InternalDataplane) loopUpdatingDataplane() {
 	}
 }
 
+// ephemeralPortRange returns the range of source ports that the kernel picks for the host's own
+// connections.
+func ephemeralPortRange() (numorstring.Port, error) {
+	const path = "/proc/sys/net/ipv4/ip_local_port_range"
+	data, err := ioutil.ReadFile(path)
+	if err != nil {
+		return numorstring.Port{}, err
+	}
+	var minPort, maxPort uint16
+	if _, err := fmt.Sscan(string(data), &minPort, &maxPort); err != nil {
+		return numorstring.Port{}, fmt.Errorf("failed to parse %s: %w", path, err)
+	}
+	return numorstring.Port{MinPort: minPort, MaxPort: maxPort}, nil
+}
+
+// reserveLocalPorts adds the port range to ip_local_reserved_ports, which stops the kernel picking
+// its ports as the source ports of the host's own connections.
+func reserveLocalPorts(r numorstring.Port) error {
+	const path = "/proc/sys/net/ipv4/ip_local_reserved_ports"
+	data, err := ioutil.ReadFile(path)
+	if err != nil {
+		return err
+	}
+	reserved := strings.TrimSpace(string(data))
+	want := fmt.Sprintf("%d-%d", r.MinPort, r.MaxPort)
+	for _, p := range strings.Split(reserved, ",") {
+		if p == want {
+			return nil
+		}
+	}
+	if reserved != "" {
+		want = reserved + "," + want
+	}
+	return writeProcSys(path, want)
+}
+
 func (d *InternalDataplane) configureKernel() {
 	// Attempt to modprobe nf_conntrack_proto_sctp.  In some kernels this is a
 	// module that needs to be loaded, otherwise all SCTP packets are marked
@@ -1686,6 +2192,22 @@ func (d *InternalDataplane) configureKernel() {
 			log.WithError(err).Error("Failed to set unprivileged_bpf_disabled sysctl")
 		}
 	}
+	if d.config.BPFEnabled && d.config.BPFProgramStatsEnabled {
+		log.Info("BPF program statistics enabled, enabling kernel BPF statistics.")
+		err := writeProcSys("/proc/sys/kernel/bpf_stats_enabled", "1")
+		if err != nil {
+			log.WithError(err).Error("Failed to set bpf_stats_enabled sysctl")
+		}
+	}
+	if len(synCookiePorts(d.config)) > 0 {
+		// The kernel only issues cookies for SYNs that XDP answers if it always uses cookies;
+		// those SYNs never reach the listener so its queue never fills.
+		log.Info("XDP SYN cookies enabled, making sure TCP SYN cookies are always used.")
+		err := writeProcSys("/proc/sys/net/ipv4/tcp_syncookies", "2")
+		if err != nil {
+			log.WithError(err).Error("Failed to set tcp_syncookies sysctl")
+		}
+	}
 	if d.config.Wireguard.Enabled {
 		// wireguard module is available in linux kernel >= 5.6
 		mpwg := newModProbe(moduleWireguard, newRealCmd)
@@ -1694,6 +2216,39 @@ func (d *InternalDataplane) configureKernel() {
 	}
 }
 
+// bpfConntrackTopFlows is the number of flows, those with the most bytes, that the conntrack scanner
+// exports the usage of.
+const bpfConntrackTopFlows = 20
+
+// synCookiePorts returns the TCP ports whose SYNs the XDP program answers with SYN cookies, if it
+// is enabled.  SYN cookies only make sense for TCP so the other entries are ignored.
+func synCookiePorts(config Config) []uint16 {
+	if !config.BPFEnabled || !config.BPFXDPEnabled {
+		return nil
+	}
+	var ports []uint16
+	for _, p := range config.BPFXDPSynCookiePorts {
+		if strings.ToLower(p.Protocol) != "tcp" {
+			continue
+		}
+		ports = append(ports, p.Port)
+	}
+	return ports
+}
+
+// bpfProgVariant returns the variant of the endpoint programs that compiles out the stages that
+// the config doesn't use.  Without a Kubernetes client, the kube-proxy doesn't run and the NAT
+// maps stay empty; without the connect-time load balancer, no socket has a CTLB NAT to reverse.
+func bpfProgVariant(config Config) tc.ProgVariant {
+	v := tc.ProgVariant{
+		NoNAT:            config.KubeClientSet == nil,
+		NoNodePortTunnel: !config.BPFNodePortTunnelEnabled,
+		NoCTLBReverse:    !config.BPFConnTimeLBEnabled,
+	}
+	log.WithField("variant", v).Info("Selected BPF program variant.")
+	return v
+}
+
 func (d *InternalDataplane) recordMsgStat(msg interface{}) {
 	typeName := reflect.ValueOf(msg).Elem().Type().Name()
 	countMessages.WithLabelValues(typeName).Inc()
@@ -26,9 +26,13 @@ type sockmapState struct {
 	bpfLib            bpf.BPFDataplane
 	cbIDs             []*CbID
 	workloadEndpoints map[string][]string // name -> []CIDR
+	// msgApplyBytes and msgCorkBytes batch the redirected messages, see struct sk_msg_cfg in
+	// bpf-apache/redir.c.
+	msgApplyBytes uint32
+	msgCorkBytes  uint32
 }
 
-func NewSockmapState() (*sockmapState, error) {
+func NewSockmapState(msgApplyBytes, msgCorkBytes int) (*sockmapState, error) {
 	lib, err := bpf.NewBPFLib("/usr/lib/calico/bpf/")
 	if err != nil {
 		return nil, err
@@ -39,6 +43,8 @@ func NewSockmapState() (*sockmapState, error) {
 		bpfLib:            lib,
 		cbIDs:             nil,
 		workloadEndpoints: make(map[string][]string),
+		msgApplyBytes:     uint32(msgApplyBytes),
+		msgCorkBytes:      uint32(msgCorkBytes),
 	}, nil
 }
 
@@ -164,6 +170,18 @@ func (s *sockmapState) SetupSockmapAcceleration() error {
 		return err
 	}
 
+	log.Debug("Creating sk_msg config map.")
+	if _, err := s.bpfLib.NewSockmapMsgConfigMap(); err != nil {
+		return err
+	}
+	log.WithFields(log.Fields{
+		"applyBytes": s.msgApplyBytes,
+		"corkBytes":  s.msgCorkBytes,
+	}).Debug("Configuring sk_msg batching.")
+	if err := s.bpfLib.UpdateSockmapMsgConfig(s.msgApplyBytes, s.msgCorkBytes); err != nil {
+		return err
+	}
+
 	log.Debug("Loading sockops program.")
 	if err := s.bpfLib.LoadSockopsAuto(); err != nil {
 		return err
@@ -209,6 +227,10 @@ func (s *sockmapState) WipeSockmap(mode bpf.FindObjectMode) {
 	if err != nil {
 		log.WithError(err).Debug("Failed to remove sockmap endpoints map.")
 	}
+	err = s.bpfLib.RemoveSockmapMsgConfigMap()
+	if err != nil {
+		log.WithError(err).Debug("Failed to remove sk_msg config map.")
+	}
 	err = s.bpfLib.RemoveSockmap(mode)
 	if err != nil {
 		log.WithError(err).Debug("Failed to remove sockmap program.")
@@ -2570,7 +2570,7 @@ func describeBPFTests(opts ...bpfTestOpt) bool {
 							"Service endpoints didn't get created? Is controller-manager happy?")
 
 						// sync with NAT table being applied
-						natFtKey := nat.NewNATKey(net.ParseIP(felixes[1].IP), npPort, numericProto)
+						natFtKey := nat.NewNATKey(nat.NodePortLocalHostIP, npPort, numericProto)
 						Eventually(func() bool {
 							m := dumpNATMap(felixes[1])
 							v, ok := m[natFtKey]
@@ -2961,9 +2961,11 @@ func dumpBPFMap(felix *infrastructure.Felix, m bpf.Map, iter bpf.IterCallback) {
 }
 
 func dumpNATMap(felix *infrastructure.Felix) nat.MapMem {
-	bm := nat.FrontendMap(&bpf.MapContext{})
+	mc := &bpf.MapContext{}
 	m := make(nat.MapMem)
-	dumpBPFMap(felix, bm, nat.MapMemIter(m))
+	dumpBPFMap(felix, mc.NewPinnedMap(nat.FrontendMapParameters), nat.MapMemIter(m))
+	dumpBPFMap(felix, mc.NewPinnedMap(nat.FrontendExactMapParameters), nat.FrontendExactMapMemIter(m))
+	dumpBPFMap(felix, mc.NewPinnedMap(nat.NodePortMapParameters), nat.NodePortMapMemIter(m))
 	return m
 }
 
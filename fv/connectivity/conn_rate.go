@@ -0,0 +1,101 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package connectivity
+
+import (
+	"encoding/json"
+	"fmt"
+	"regexp"
+	"sort"
+	"time"
+
+	. "github.com/onsi/gomega"
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/fv/utils"
+)
+
+// ConnRate is the result of a connection rate test, in which test-connection opens and closes TCP
+// connections to the target back to back, see MeasureConnRate.
+type ConnRate struct {
+	Connections int
+	Failures    int
+	Duration    time.Duration
+	// P50 and P99 are the percentiles of the time that the connections took to establish.
+	P50 time.Duration
+	P99 time.Duration
+}
+
+// NewConnRate summarises the times that the connections of a test took to establish.
+func NewConnRate(connectTimes []time.Duration, failures int, duration time.Duration) ConnRate {
+	sorted := append([]time.Duration(nil), connectTimes...)
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i] < sorted[j] })
+
+	return ConnRate{
+		Connections: len(sorted),
+		Failures:    failures,
+		Duration:    duration,
+		P50:         percentile(sorted, 50),
+		P99:         percentile(sorted, 99),
+	}
+}
+
+// percentile returns the nearest-rank percentile of the sorted samples.
+func percentile(sorted []time.Duration, p int) time.Duration {
+	if len(sorted) == 0 {
+		return 0
+	}
+	i := (len(sorted)*p+99)/100 - 1
+	if i < 0 {
+		i = 0
+	}
+	return sorted[i]
+}
+
+// PerSecond returns the number of connections per second.
+func (r ConnRate) PerSecond() float64 {
+	return float64(r.Connections) / r.Duration.Seconds()
+}
+
+func (r ConnRate) PrintToStdout() {
+	encoded, err := json.Marshal(r)
+	if err != nil {
+		log.WithError(err).Panic("Failed to marshall connection rate to stdout")
+	}
+	fmt.Printf("CONNRATE=%s\n", string(encoded))
+}
+
+var connRateRegexp = regexp.MustCompile(`CONNRATE=(.*)\n`)
+
+// MeasureConnRate runs a connection rate test from the namespace in the container to the target
+// for the given duration.
+func MeasureConnRate(cName, nsPath, ip, port string, duration time.Duration) ConnRate {
+	logCxt := log.WithField("container", cName)
+
+	out, err := utils.Command("docker", "exec", cName,
+		"/"+BinaryName, "--conn-rate",
+		fmt.Sprintf("--duration=%d", int(duration.Seconds())),
+		nsPath, ip, port,
+	).Output()
+	logCxt.WithField("stdout", string(out)).WithError(err).Info("Connection rate test")
+	Expect(err).NotTo(HaveOccurred())
+
+	m := connRateRegexp.FindSubmatch(out)
+	Expect(m).To(HaveLen(2), "No result from connection rate test: "+string(out))
+	var r ConnRate
+	err = json.Unmarshal(m[1], &r)
+	Expect(err).NotTo(HaveOccurred())
+	return r
+}
@@ -0,0 +1,303 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// +build fvtests
+
+package fv_test
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"os"
+	"time"
+
+	. "github.com/onsi/ginkgo"
+	. "github.com/onsi/gomega"
+	log "github.com/sirupsen/logrus"
+	v1 "k8s.io/api/core/v1"
+	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/client-go/kubernetes"
+
+	api "github.com/projectcalico/api/pkg/apis/projectcalico/v3"
+	"github.com/projectcalico/libcalico-go/lib/apiconfig"
+	client "github.com/projectcalico/libcalico-go/lib/clientv3"
+
+	"github.com/projectcalico/felix/fv/infrastructure"
+	"github.com/projectcalico/felix/fv/utils"
+	"github.com/projectcalico/felix/fv/workload"
+)
+
+// The data plane benchmarks measure the TCP throughput, the small packet rate, the connection
+// rate and the connection setup latency of the main traffic paths in each data plane mode.  They
+// only run if FELIX_FV_BENCH is "true", see the fv-bench make target, and they append their
+// results, one JSON object per measurement, to dataplane-bench.log, labelled with
+// FV_BENCH_RELEASE.  They don't fail on poor numbers, only if the traffic doesn't get through.
+
+const (
+	benchResultsFile  = "dataplane-bench.log"
+	benchIperfPort    = 5201
+	benchConnPort     = 8055
+	benchIperfNP      = 30520
+	benchConnNP       = 30855
+	benchIperfSvcIP   = "10.101.0.20"
+	benchConnSvcIP    = "10.101.0.21"
+	benchDefaultSecs  = 10
+	benchServerNodeID = 1
+)
+
+type benchMode struct {
+	name string
+	bpf  bool
+	// ipip runs the traffic between the nodes over IPIP, with which the BPF programs don't use
+	// the FIB.
+	ipip    bool
+	envVars map[string]string
+}
+
+type benchResult struct {
+	Release  string `json:"release"`
+	Mode     string `json:"mode"`
+	Scenario string `json:"scenario"`
+	// Throughput in Gbit/s, UDP packets per second, TCP connections per second and the
+	// percentiles of their setup time, in microseconds.
+	Gbps        float64 `json:"gbps"`
+	PPS         float64 `json:"pps"`
+	ConnsPerSec float64 `json:"conns_per_sec"`
+	P50Micros   int64   `json:"p50_us"`
+	P99Micros   int64   `json:"p99_us"`
+}
+
+func benchModes() []benchMode {
+	if os.Getenv("FELIX_FV_ENABLE_BPF") != "true" {
+		return []benchMode{{name: "iptables"}}
+	}
+	return []benchMode{
+		{name: "bpf", bpf: true, envVars: map[string]string{
+			"FELIX_BPFConnectTimeLoadBalancingEnabled": "false",
+		}},
+		{name: "bpf-ctlb", bpf: true, envVars: map[string]string{
+			"FELIX_BPFConnectTimeLoadBalancingEnabled": "true",
+		}},
+		{name: "bpf-dsr", bpf: true, envVars: map[string]string{
+			"FELIX_BPFConnectTimeLoadBalancingEnabled": "false",
+			"FELIX_BPFExternalServiceMode":             "dsr",
+		}},
+		{name: "bpf-ipip-nofib", bpf: true, ipip: true, envVars: map[string]string{
+			"FELIX_BPFConnectTimeLoadBalancingEnabled": "false",
+		}},
+	}
+}
+
+func benchDuration() time.Duration {
+	secs := benchDefaultSecs
+	if s := os.Getenv("FV_BENCH_DURATION_SECS"); s != "" {
+		_, err := fmt.Sscan(s, &secs)
+		Expect(err).NotTo(HaveOccurred(), "Bad FV_BENCH_DURATION_SECS")
+	}
+	return time.Duration(secs) * time.Second
+}
+
+var _ = benchModesDescribe()
+
+func benchModesDescribe() bool {
+	if os.Getenv("FELIX_FV_BENCH") != "true" {
+		return true
+	}
+	for _, m := range benchModes() {
+		describeDataplaneBenchmarks(m)
+	}
+	return true
+}
+
+func describeDataplaneBenchmarks(mode benchMode) bool {
+	desc := fmt.Sprintf("_BENCH_ _BPF-SAFE_ Data plane benchmarks (%s)", mode.name)
+	return infrastructure.DatastoreDescribe(desc, []apiconfig.DatastoreType{apiconfig.Kubernetes}, func(getInfra infrastructure.InfraFactory) {
+		var (
+			infra        infrastructure.DatastoreInfra
+			felixes      []*infrastructure.Felix
+			calicoClient client.Interface
+			k8sClient    *kubernetes.Clientset
+			hostW        [2]*workload.Workload
+			w            [2][2]*workload.Workload
+			resultsFile  *os.File
+			duration     time.Duration
+		)
+
+		BeforeEach(func() {
+			infra = getInfra()
+			duration = benchDuration()
+
+			options := infrastructure.DefaultTopologyOptions()
+			options.IPIPEnabled = mode.ipip
+			options.IPIPRoutesEnabled = mode.ipip
+			options.ExtraEnvVars["FELIX_BPFLOGLEVEL"] = "off" // For best perf.
+			for k, v := range mode.envVars {
+				options.ExtraEnvVars[k] = v
+			}
+			if mode.bpf {
+				// NodePorts for traffic from other nodes.
+				options.AutoHEPsEnabled = true
+			}
+
+			felixes, calicoClient = infrastructure.StartNNodeTopology(2, options, infra)
+			k8sClient = infra.(*infrastructure.K8sDatastoreInfra).K8sClient
+
+			for ii, felix := range felixes {
+				// iperf3 measures the throughput and the packet rate.
+				felix.Exec("apt-get", "install", "-y", "iperf3")
+
+				hostW[ii] = workload.Run(felix, fmt.Sprintf("host%d", ii), "default", felix.IP,
+					fmt.Sprint(benchConnPort), "tcp")
+				for wi := range w[ii] {
+					wIP := fmt.Sprintf("10.65.%d.%d", ii, wi+2)
+					w[ii][wi] = workload.Run(felix, fmt.Sprintf("w%d%d", ii, wi), "default", wIP,
+						fmt.Sprint(benchConnPort), "tcp")
+					w[ii][wi].WorkloadEndpoint.Labels = map[string]string{"name": w[ii][wi].Name}
+					w[ii][wi].ConfigureInInfra(infra)
+				}
+			}
+
+			pol := api.NewGlobalNetworkPolicy()
+			pol.Name = "bench-allow-all"
+			pol.Spec.Ingress = []api.Rule{{Action: "Allow"}}
+			pol.Spec.Egress = []api.Rule{{Action: "Allow"}}
+			pol.Spec.Selector = "all()"
+			_, err := calicoClient.GlobalNetworkPolicies().Create(utils.Ctx, pol, utils.NoOptions)
+			Expect(err).NotTo(HaveOccurred())
+
+			var resultsErr error
+			resultsFile, resultsErr = os.OpenFile(benchResultsFile, os.O_WRONLY|os.O_APPEND|os.O_CREATE, 0644)
+			Expect(resultsErr).NotTo(HaveOccurred())
+		})
+
+		AfterEach(func() {
+			err := resultsFile.Close()
+			if err != nil {
+				log.WithError(err).Error("Close returned error")
+			}
+
+			for ii := range felixes {
+				for wi := range w[ii] {
+					w[ii][wi].Stop()
+				}
+				hostW[ii].Stop()
+			}
+			for _, felix := range felixes {
+				if CurrentGinkgoTestDescription().Failed {
+					felix.Exec("iptables-save", "-c")
+					felix.Exec("ip", "r")
+				}
+				felix.Stop()
+			}
+			infra.Stop()
+		})
+
+		// target is where the traffic of a scenario goes: the workload that serves it and the
+		// addresses that the client uses to reach its iperf3 server and its test-workload.
+		type target struct {
+			server    *workload.Workload
+			iperfIP   string
+			iperfPort int
+			connIP    string
+			connPort  int
+		}
+
+		record := func(scenario string, from *workload.Workload, t target) {
+			t.server.StartIperfServer(fmt.Sprint(benchIperfPort))
+
+			bps, out := from.ThroughputTo(t.iperfIP, fmt.Sprint(t.iperfPort), duration)
+			Expect(bps).To(BeNumerically(">", 0), "No TCP throughput; iperf3 said:\n"+out)
+			pps, out := from.PacketRateTo(t.iperfIP, fmt.Sprint(t.iperfPort), duration)
+			Expect(pps).To(BeNumerically(">", 0), "No UDP packets received; iperf3 said:\n"+out)
+			cr := from.ConnRateTo(t.connIP, fmt.Sprint(t.connPort), duration)
+			Expect(cr.Connections).To(BeNumerically(">", 0))
+
+			res := benchResult{
+				Release:     os.Getenv("FV_BENCH_RELEASE"),
+				Mode:        mode.name,
+				Scenario:    scenario,
+				Gbps:        bps / 1e9,
+				PPS:         pps,
+				ConnsPerSec: cr.PerSecond(),
+				P50Micros:   cr.P50.Microseconds(),
+				P99Micros:   cr.P99.Microseconds(),
+			}
+			log.WithField("result", res).Info("Benchmark result")
+			encoded, err := json.Marshal(res)
+			Expect(err).NotTo(HaveOccurred())
+			_, err = fmt.Fprintf(resultsFile, "%s\n", encoded)
+			Expect(err).NotTo(HaveOccurred())
+		}
+
+		direct := func(server *workload.Workload, ip string) target {
+			return target{server, ip, benchIperfPort, ip, benchConnPort}
+		}
+
+		It("pod-to-pod, same node", func() {
+			record("pod-to-pod-local", w[0][0], direct(w[0][1], w[0][1].IP))
+		})
+
+		It("pod-to-pod, other node", func() {
+			record("pod-to-pod-remote", w[0][0], direct(w[1][0], w[1][0].IP))
+		})
+
+		It("host-to-host", func() {
+			record("host-to-host", hostW[0], direct(hostW[1], felixes[1].IP))
+		})
+
+		if !mode.bpf {
+			// Felix's iptables mode doesn't do services, there is no kube-proxy in the FV
+			// topology.
+			return
+		}
+
+		Describe("with services backed by a pod on the other node", func() {
+			var backend *workload.Workload
+
+			BeforeEach(func() {
+				backend = w[benchServerNodeID][0]
+				iperfSvc := k8sService("bench-iperf", benchIperfSvcIP, backend, benchIperfPort, benchIperfPort,
+					benchIperfNP, "tcp")
+				// iperf3 uses the same port for its UDP test.
+				iperfSvc.Spec.Ports = append(iperfSvc.Spec.Ports, v1.ServicePort{
+					Protocol:   v1.ProtocolUDP,
+					Port:       benchIperfPort,
+					NodePort:   benchIperfNP,
+					Name:       iperfSvc.Spec.Ports[0].Name + "-udp",
+					TargetPort: iperfSvc.Spec.Ports[0].TargetPort,
+				})
+				connSvc := k8sService("bench-conn", benchConnSvcIP, backend, benchConnPort, benchConnPort,
+					benchConnNP, "tcp")
+
+				for _, svc := range []*v1.Service{iperfSvc, connSvc} {
+					_, err := k8sClient.CoreV1().Services("default").Create(context.Background(), svc, metav1.CreateOptions{})
+					Expect(err).NotTo(HaveOccurred())
+					Eventually(k8sGetEpsForServiceFunc(k8sClient, svc), "10s").Should(HaveLen(1),
+						"Service endpoints didn't get created? Is controller-manager happy?")
+				}
+			})
+
+			It("pod-to-service", func() {
+				record("pod-to-service", w[0][0],
+					target{backend, benchIperfSvcIP, benchIperfPort, benchConnSvcIP, benchConnPort})
+			})
+
+			It("NodePort", func() {
+				nodeIP := felixes[benchServerNodeID].IP
+				record("nodeport", hostW[0], target{backend, nodeIP, benchIperfNP, nodeIP, benchConnNP})
+			})
+		})
+	})
+}
@@ -47,24 +47,26 @@ func prepend0xInPlace(hexen []string) {
 
 // getExpectedSockmapKeys returns an array of sockhash map keys in a
 // form similar to what bpftool could print. So each key is an array
-// of 12 strings being a representation of hexadecimal bytes. First
+// of 20 strings being a representation of hexadecimal bytes. First
 // four bytes contain passed IP address, next four bytes contain
-// passed port and the last four bytes contain encoded 1 or 0,
-// denoting whether a socket is on the envoy side or not.
+// passed port and the next four bytes contain encoded 1 or 0,
+// denoting whether a socket is on the envoy side or not. The last
+// eight bytes hold the peer of endpoint-to-endpoint connections and
+// are zero for these keys.
 func getExpectedSockmapKeys(ip string, port int) [][]string {
-	key := make([]byte, 12)
+	key := make([]byte, 20)
 	parsedIP := net.ParseIP(ip)
 	Expect(parsedIP).NotTo(BeNil())
 	parsedIP = parsedIP.To4()
 	Expect(parsedIP).NotTo(BeNil())
 	copy(key, parsedIP)
 	binary.BigEndian.PutUint16(key[4:], uint16(port))
-	key2 := make([]byte, 12)
+	key2 := make([]byte, 20)
 	copy(key2, key)
 	binary.LittleEndian.PutUint32(key2[8:], 1)
 	strKeys := make([][]string, 0, 2)
 	for _, k := range [][]byte{key, key2} {
-		strKey := make([]string, 0, 12)
+		strKey := make([]string, 0, 20)
 		for _, b := range k {
 			strKey = append(strKey, fmt.Sprintf("%02x", b))
 		}
@@ -280,7 +282,7 @@ var _ = infrastructure.DatastoreDescribe("[SOCKMAP] with Felix using sockmap", [
 				"map",
 				"dump",
 				"pinned",
-				"/sys/fs/bpf/calico/sockmap/calico_sock_map_v1",
+				"/sys/fs/bpf/calico/sockmap/calico_sock_map_v2",
 			)
 			if err != nil {
 				log.WithFields(log.Fields{
@@ -350,18 +352,18 @@ var _ = infrastructure.DatastoreDescribe("[SOCKMAP] with Felix using sockmap", [
 				"map",
 				"dump",
 				"pinned",
-				"/sys/fs/bpf/calico/sockmap/calico_sock_map_v1",
+				"/sys/fs/bpf/calico/sockmap/calico_sock_map_v2",
 			)
 			logCxt := log.WithField("output", output)
 			if err != nil {
-				logCxt.WithError(err).Warn("Failed to dump calico_sock_map_v1")
+				logCxt.WithError(err).Warn("Failed to dump calico_sock_map_v2")
 				return nil
 			}
-			logCxt.Info("Dump of calico_sock_map_v1")
+			logCxt.Info("Dump of calico_sock_map_v2")
 			al := unmarshalBpfToolSockhashDumpOutput(output)
 			logCxt.WithFields(log.Fields{
 				"entries": al,
-			}).Info("Parsed contents of calico_sock_map_v1")
+			}).Info("Parsed contents of calico_sock_map_v2")
 			keys := make([][]string, 0, len(al))
 			for _, l := range al {
 				keys = append(keys, l.Key)
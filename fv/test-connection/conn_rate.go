@@ -0,0 +1,77 @@
+// Copyright (c) 2021 Tigera, Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package main
+
+import (
+	"fmt"
+	"net"
+	"sync"
+	"time"
+
+	log "github.com/sirupsen/logrus"
+
+	"github.com/projectcalico/felix/fv/connectivity"
+)
+
+// connRateWorkers is the number of connections that --conn-rate keeps in flight.
+const connRateWorkers = 4
+
+// measureConnRate opens and closes TCP connections to the target back to back for the duration
+// and prints their rate and the percentiles of the time that they took to establish.
+func measureConnRate(remoteIPAddr, remotePort string, duration time.Duration) error {
+	remoteAddr := net.JoinHostPort(remoteIPAddr, remotePort)
+	deadline := time.Now().Add(duration)
+	log.Infof("Measuring connection rate to %v for %v", remoteAddr, duration)
+
+	var lock sync.Mutex
+	var connectTimes []time.Duration
+	failures := 0
+
+	var wg sync.WaitGroup
+	for i := 0; i < connRateWorkers; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			var times []time.Duration
+			fails := 0
+			for time.Now().Before(deadline) {
+				start := time.Now()
+				conn, err := net.DialTimeout("tcp", remoteAddr, time.Second)
+				if err != nil {
+					log.WithError(err).Debug("Connection failed")
+					fails++
+					continue
+				}
+				times = append(times, time.Since(start))
+				// Reset the connection rather than close it so that the ports don't pile
+				// up in TIME_WAIT.
+				_ = conn.(*net.TCPConn).SetLinger(0)
+				_ = conn.Close()
+			}
+
+			lock.Lock()
+			defer lock.Unlock()
+			connectTimes = append(connectTimes, times...)
+			failures += fails
+		}()
+	}
+	wg.Wait()
+
+	if len(connectTimes) == 0 {
+		return fmt.Errorf("no connection to %v succeeded, %d failed", remoteAddr, failures)
+	}
+	connectivity.NewConnRate(connectTimes, failures, duration).PrintToStdout()
+	return nil
+}
@@ -45,7 +45,7 @@ import (
 const usage = `test-connection: test connection to some target, for Felix FV testing.
 
 Usage:
-  test-connection <namespace-path> <ip-address> <port> [--source-ip=<source_ip>] [--source-port=<source>] [--protocol=<protocol>] [--duration=<seconds>] [--loop-with-file=<file>] [--sendlen=<bytes>] [--recvlen=<bytes>] [--log-pongs] [--stdin]
+  test-connection <namespace-path> <ip-address> <port> [--source-ip=<source_ip>] [--source-port=<source>] [--protocol=<protocol>] [--duration=<seconds>] [--loop-with-file=<file>] [--sendlen=<bytes>] [--recvlen=<bytes>] [--log-pongs] [--stdin] [--conn-rate]
 
 Options:
   --source-ip=<source_ip>  Source IP to use for the connection [default: 0.0.0.0].
@@ -58,6 +58,7 @@ Options:
   --sendlen=<bytes>        How many additional bytes to send
   --recvlen=<bytes>        Tell the other side to send this many additional bytes
   --stdin                  Read and send data from stdin
+  --conn-rate              Open and close TCP connections back to back for --duration seconds and print their rate and setup times
 
 If connection is successful, test-connection exits successfully.
 
@@ -148,6 +149,22 @@ func main() {
 		log.WithError(err).Fatal("Invalid --stdin")
 	}
 
+	connRate, err := arguments.Bool("--conn-rate")
+	if err != nil {
+		log.WithError(err).Fatal("Invalid --conn-rate")
+	}
+	if connRate && seconds == 0 {
+		log.Fatal("--conn-rate needs a --duration")
+	}
+
+	run := func() error {
+		if connRate {
+			return measureConnRate(ipAddress, port, time.Duration(seconds)*time.Second)
+		}
+		return tryConnect(ipAddress, port, sourceIpAddress, sourcePort, protocol,
+			seconds, loopFile, sendLen, recvLen, logPongs, stdin)
+	}
+
 	log.Infof("Test connection from namespace %v IP %v port %v to IP %v port %v proto %v "+
 		"max duration %d seconds, logging pongs (%v), stdin %v",
 		namespacePath, sourceIpAddress, sourcePort, ipAddress, port, protocol, seconds, logPongs, stdin)
@@ -167,8 +184,7 @@ func main() {
 		err = maybeAddAddr(sourceIpAddress)
 		// Test connection from wherever we are already running.
 		if err == nil {
-			err = tryConnect(ipAddress, port, sourceIpAddress, sourcePort, protocol,
-				seconds, loopFile, sendLen, recvLen, logPongs, stdin)
+			err = run()
 		}
 	} else {
 		// Get the specified network namespace (representing a workload).
@@ -186,8 +202,7 @@ func main() {
 			if e != nil {
 				return e
 			}
-			return tryConnect(ipAddress, port, sourceIpAddress, sourcePort, protocol,
-				seconds, loopFile, sendLen, recvLen, logPongs, stdin)
+			return run()
 		})
 	}
 
@@ -16,6 +16,7 @@ package workload
 
 import (
 	"bufio"
+	"encoding/json"
 	"fmt"
 	"io"
 	"os"
@@ -434,6 +435,63 @@ func (w *Workload) LatencyTo(ip, port string) (time.Duration, string) {
 	return meanRtt, out
 }
 
+// ConnRateTo opens and closes TCP connections to the target back to back for the duration, see
+// connectivity.MeasureConnRate.
+func (w *Workload) ConnRateTo(ip, port string, duration time.Duration) connectivity.ConnRate {
+	w.C.EnsureBinary(connectivity.BinaryName)
+	return connectivity.MeasureConnRate(w.C.Name, w.namespacePath, ip, port, duration)
+}
+
+// StartIperfServer starts an iperf3 server in the workload, in the background.  iperf3 must be
+// installed in the workload's container.
+func (w *Workload) StartIperfServer(port string) {
+	out, err := w.RunCmd("iperf3", "--server", "--daemon", "--port", port)
+	Expect(err).NotTo(HaveOccurred(), "Failed to start iperf3 server: "+out)
+}
+
+type iperfResult struct {
+	End struct {
+		// Sum is the UDP summary, SumReceived the TCP one.
+		Sum struct {
+			Seconds     float64 `json:"seconds"`
+			Packets     int     `json:"packets"`
+			LostPackets int     `json:"lost_packets"`
+		} `json:"sum"`
+		SumReceived struct {
+			BitsPerSecond float64 `json:"bits_per_second"`
+		} `json:"sum_received"`
+	} `json:"end"`
+}
+
+func (w *Workload) iperfTo(ip, port string, duration time.Duration, args ...string) (iperfResult, string) {
+	args = append([]string{"--client", ip, "--port", port, "--json",
+		"--time", strconv.Itoa(int(duration.Seconds()))}, args...)
+	out, err := w.RunCmd("iperf3", args...)
+	Expect(err).NotTo(HaveOccurred(), "iperf3 failed: "+out)
+
+	var r iperfResult
+	err = json.Unmarshal([]byte(out), &r)
+	Expect(err).NotTo(HaveOccurred(), "Failed to parse iperf3 output: "+out)
+	return r, out
+}
+
+// ThroughputTo measures the TCP throughput from the workload to the iperf3 server at the target, in
+// bits per second.
+func (w *Workload) ThroughputTo(ip, port string, duration time.Duration) (float64, string) {
+	r, out := w.iperfTo(ip, port, duration)
+	return r.End.SumReceived.BitsPerSecond, out
+}
+
+// PacketRateTo measures the rate at which the iperf3 server at the target receives small UDP
+// packets from the workload, in packets per second.
+func (w *Workload) PacketRateTo(ip, port string, duration time.Duration) (float64, string) {
+	// Unlimited bandwidth, 64-byte payloads.
+	r, out := w.iperfTo(ip, port, duration, "--udp", "--bandwidth", "0", "--length", "64")
+	sum := r.End.Sum
+	Expect(sum.Seconds).To(BeNumerically(">", 0), "No UDP summary from iperf3: "+out)
+	return float64(sum.Packets-sum.LostPackets) / sum.Seconds, out
+}
+
 func (w *Workload) SendPacketsTo(ip string, count int, size int) (error, string) {
 	if strings.Contains(ip, ":") {
 		ip = fmt.Sprintf("[%s]", ip)
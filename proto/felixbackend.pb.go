@@ -2582,6 +2582,8 @@ type WorkloadEndpoint struct {
 	Tiers      []*TierInfo `protobuf:"bytes,7,rep,name=tiers" json:"tiers,omitempty"`
 	Ipv4Nat    []*NatInfo  `protobuf:"bytes,8,rep,name=ipv4_nat,json=ipv4Nat" json:"ipv4_nat,omitempty"`
 	Ipv6Nat    []*NatInfo  `protobuf:"bytes,9,rep,name=ipv6_nat,json=ipv6Nat" json:"ipv6_nat,omitempty"`
+	// Limit on the bandwidth that the workload sends, in bits per second, or 0 for no limit.
+	EgressBandwidth uint64 `protobuf:"varint,10,opt,name=egress_bandwidth,json=egressBandwidth,proto3" json:"egress_bandwidth,omitempty"`
 }
 
 func (m *WorkloadEndpoint) Reset()                    { *m = WorkloadEndpoint{} }
@@ -2652,6 +2654,13 @@ func (m *WorkloadEndpoint) GetIpv6Nat() []*NatInfo {
 	return nil
 }
 
+func (m *WorkloadEndpoint) GetEgressBandwidth() uint64 {
+	if m != nil {
+		return m.EgressBandwidth
+	}
+	return 0
+}
+
 type WorkloadEndpointRemove struct {
 	Id *WorkloadEndpointID `protobuf:"bytes,1,opt,name=id" json:"id,omitempty"`
 }
@@ -3283,6 +3292,9 @@ type RouteUpdate struct {
 	NatOutgoing   bool        `protobuf:"varint,8,opt,name=nat_outgoing,json=natOutgoing,proto3" json:"nat_outgoing,omitempty"`
 	LocalWorkload bool        `protobuf:"varint,9,opt,name=local_workload,json=localWorkload,proto3" json:"local_workload,omitempty"`
 	TunnelType    *TunnelType `protobuf:"bytes,10,opt,name=tunnel_type,json=tunnelType" json:"tunnel_type,omitempty"`
+	// IPs of all the nodes holding this destination, dst_node_ip first, if several remote nodes
+	// hold it, for example an anycast workload IP.  Empty if only one node holds it.
+	DstNodeIps []string `protobuf:"bytes,11,rep,name=dst_node_ips,json=dstNodeIps" json:"dst_node_ips,omitempty"`
 }
 
 func (m *RouteUpdate) Reset()                    { *m = RouteUpdate{} }
@@ -3353,6 +3365,13 @@ func (m *RouteUpdate) GetTunnelType() *TunnelType {
 	return nil
 }
 
+func (m *RouteUpdate) GetDstNodeIps() []string {
+	if m != nil {
+		return m.DstNodeIps
+	}
+	return nil
+}
+
 type RouteRemove struct {
 	Dst string `protobuf:"bytes,2,opt,name=dst,proto3" json:"dst,omitempty"`
 }
@@ -5679,6 +5698,11 @@ func (m *WorkloadEndpoint) MarshalTo(dAtA []byte) (int, error) {
 			i += n
 		}
 	}
+	if m.EgressBandwidth != 0 {
+		dAtA[i] = 0x50
+		i++
+		i = encodeVarintFelixbackend(dAtA, i, uint64(m.EgressBandwidth))
+	}
 	return i, nil
 }
 
@@ -6694,6 +6718,21 @@ func (m *RouteUpdate) MarshalTo(dAtA []byte) (int, error) {
 		}
 		i += n72
 	}
+	if len(m.DstNodeIps) > 0 {
+		for _, s := range m.DstNodeIps {
+			dAtA[i] = 0x5a
+			i++
+			l = len(s)
+			for l >= 1<<7 {
+				dAtA[i] = uint8(uint64(l)&0x7f | 0x80)
+				l >>= 7
+				i++
+			}
+			dAtA[i] = uint8(l)
+			i++
+			i += copy(dAtA[i:], s)
+		}
+	}
 	return i, nil
 }
 
@@ -7841,6 +7880,9 @@ func (m *WorkloadEndpoint) Size() (n int) {
 			n += 1 + l + sovFelixbackend(uint64(l))
 		}
 	}
+	if m.EgressBandwidth != 0 {
+		n += 1 + sovFelixbackend(uint64(m.EgressBandwidth))
+	}
 	return n
 }
 
@@ -8251,6 +8293,12 @@ func (m *RouteUpdate) Size() (n int) {
 		l = m.TunnelType.Size()
 		n += 1 + l + sovFelixbackend(uint64(l))
 	}
+	if len(m.DstNodeIps) > 0 {
+		for _, s := range m.DstNodeIps {
+			l = len(s)
+			n += 1 + l + sovFelixbackend(uint64(l))
+		}
+	}
 	return n
 }
 
@@ -13469,6 +13517,25 @@ func (m *WorkloadEndpoint) Unmarshal(dAtA []byte) error {
 				return err
 			}
 			iNdEx = postIndex
+		case 10:
+			if wireType != 0 {
+				return fmt.Errorf("proto: wrong wireType = %d for field EgressBandwidth", wireType)
+			}
+			m.EgressBandwidth = 0
+			for shift := uint(0); ; shift += 7 {
+				if shift >= 64 {
+					return ErrIntOverflowFelixbackend
+				}
+				if iNdEx >= l {
+					return io.ErrUnexpectedEOF
+				}
+				b := dAtA[iNdEx]
+				iNdEx++
+				m.EgressBandwidth |= (uint64(b) & 0x7F) << shift
+				if b < 0x80 {
+					break
+				}
+			}
 		default:
 			iNdEx = preIndex
 			skippy, err := skipFelixbackend(dAtA[iNdEx:])
@@ -16650,6 +16717,35 @@ func (m *RouteUpdate) Unmarshal(dAtA []byte) error {
 				return err
 			}
 			iNdEx = postIndex
+		case 11:
+			if wireType != 2 {
+				return fmt.Errorf("proto: wrong wireType = %d for field DstNodeIps", wireType)
+			}
+			var stringLen uint64
+			for shift := uint(0); ; shift += 7 {
+				if shift >= 64 {
+					return ErrIntOverflowFelixbackend
+				}
+				if iNdEx >= l {
+					return io.ErrUnexpectedEOF
+				}
+				b := dAtA[iNdEx]
+				iNdEx++
+				stringLen |= (uint64(b) & 0x7F) << shift
+				if b < 0x80 {
+					break
+				}
+			}
+			intStringLen := int(stringLen)
+			if intStringLen < 0 {
+				return ErrInvalidLengthFelixbackend
+			}
+			postIndex := iNdEx + intStringLen
+			if postIndex > l {
+				return io.ErrUnexpectedEOF
+			}
+			m.DstNodeIps = append(m.DstNodeIps, string(dAtA[iNdEx:postIndex]))
+			iNdEx = postIndex
 		default:
 			iNdEx = preIndex
 			skippy, err := skipFelixbackend(dAtA[iNdEx:])
@@ -17456,221 +17552,223 @@ var (
 func init() { proto1.RegisterFile("felixbackend.proto", fileDescriptorFelixbackend) }
 
 var fileDescriptorFelixbackend = []byte{
-	// 3453 bytes of a gzipped FileDescriptorProto
-	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xbc, 0x5a, 0xdd, 0x6e, 0x1c, 0x47,
-	0x76, 0x66, 0x0f, 0xc9, 0xe1, 0xcc, 0x99, 0x1f, 0xb6, 0x8a, 0x22, 0x39, 0xa4, 0x24, 0x4a, 0x6e,
-	0x59, 0x10, 0xad, 0xc0, 0x92, 0x40, 0x4b, 0x94, 0xe5, 0x04, 0x32, 0x48, 0x0e, 0x2d, 0x8e, 0x4d,
-	0x0d, 0x89, 0x26, 0x2d, 0xc7, 0x81, 0x81, 0x4e, 0xb3, 0xbb, 0x48, 0x76, 0xd4, 0xd3, 0xdd, 0xee,
-	0xae, 0xe1, 0x4f, 0x72, 0x17, 0xe4, 0x22, 0x09, 0x10, 0x24, 0x57, 0xc1, 0x3e, 0xc0, 0x62, 0xaf,
-	0xf6, 0x0d, 0xf6, 0x62, 0xaf, 0x16, 0xb0, 0xef, 0xf6, 0x05, 0x16, 0xd8, 0xf5, 0x3e, 0xc1, 0xbe,
-	0xc1, 0xa2, 0x7e, 0xfb, 0x67, 0x7a, 0x28, 0x69, 0xb1, 0xd8, 0x2b, 0x4e, 0x9d, 0xf3, 0x9d, 0xaf,
-	0x4e, 0x9d, 0x3a, 0x5d, 0x75, 0xaa, 0x8a, 0x80, 0x8e, 0xb1, 0xef, 0x5d, 0x1c, 0xd9, 0xce, 0x1b,
-	0x1c, 0xb8, 0x0f, 0xa3, 0x38, 0x24, 0x21, 0x9a, 0x66, 0x32, 0xa3, 0x05, 0x8d, 0x83, 0xcb, 0xc0,
-	0x31, 0xf1, 0xf7, 0x43, 0x9c, 0x10, 0xe3, 0x0f, 0x3a, 0x34, 0x0e, 0xc3, 0xae, 0x4d, 0xec, 0xc8,
-	0xb7, 0x03, 0x8c, 0x56, 0x61, 0xc6, 0x0b, 0xac, 0xe4, 0x32, 0x70, 0x3a, 0xda, 0x1d, 0x6d, 0xb5,
-	0xb1, 0xd6, 0x7a, 0xc8, 0xec, 0x1e, 0xf6, 0x02, 0x6a, 0xb6, 0x33, 0x61, 0x56, 0x3d, 0xf6, 0x0b,
-	0x3d, 0x83, 0xa6, 0x17, 0x25, 0x98, 0x58, 0xc3, 0xc8, 0xb5, 0x09, 0xee, 0x54, 0x18, 0x1c, 0x49,
-	0xf8, 0xfe, 0x01, 0x26, 0x5f, 0x33, 0xcd, 0xce, 0x84, 0xd9, 0x60, 0x48, 0xde, 0x44, 0x2f, 0x01,
-	0x71, 0x43, 0x17, 0xfb, 0xc4, 0x96, 0xe6, 0x93, 0xcc, 0x7c, 0x31, 0x6b, 0xde, 0xa5, 0x7a, 0xc5,
-	0xa1, 0x33, 0xa3, 0x8c, 0x2c, 0xf5, 0x20, 0xc6, 0x83, 0xf0, 0x0c, 0x77, 0xa6, 0x46, 0x3d, 0x30,
-	0x99, 0x46, 0x79, 0xc0, 0x9b, 0x68, 0x1f, 0xe6, 0x6d, 0x87, 0x78, 0x67, 0xd8, 0x8a, 0xe2, 0xf0,
-	0xd8, 0xf3, 0xb1, 0x74, 0x62, 0x9a, 0x31, 0x2c, 0x0b, 0x86, 0x0d, 0x86, 0xd9, 0xe7, 0x10, 0xe5,
-	0xc7, 0x9c, 0x3d, 0x2a, 0x2e, 0x61, 0x14, 0x3e, 0x55, 0xc7, 0x33, 0x2a, 0xdf, 0xf2, 0x8c, 0xc2,
-	0xc7, 0x57, 0x70, 0x5d, 0x32, 0x86, 0xbe, 0xe7, 0x5c, 0x4a, 0x17, 0x67, 0x18, 0xe1, 0x52, 0x9e,
-	0x90, 0x21, 0x94, 0x87, 0xc8, 0x1e, 0x91, 0x8e, 0xd2, 0x09, 0xff, 0x6a, 0x63, 0xe9, 0x94, 0x7b,
-	0x39, 0xba, 0xd4, 0xbb, 0xd3, 0x30, 0x21, 0x16, 0x0e, 0xdc, 0x28, 0xf4, 0x02, 0x95, 0x04, 0xf5,
-	0x1c, 0xdd, 0x4e, 0x98, 0x90, 0x6d, 0x81, 0x48, 0xbd, 0x3b, 0x1d, 0x91, 0x8e, 0xd2, 0x09, 0xef,
-	0x60, 0x2c, 0x5d, 0xea, 0xdd, 0xe9, 0x88, 0x14, 0x7d, 0x0b, 0x9d, 0xf3, 0x30, 0x7e, 0xe3, 0x87,
-	0xb6, 0x3b, 0xe2, 0x61, 0x83, 0x51, 0xde, 0x12, 0x94, 0xdf, 0x08, 0xd8, 0x88, 0x97, 0x0b, 0xe7,
-	0xa5, 0x9a, 0x72, 0x6a, 0xe1, 0x6d, 0xf3, 0x4a, 0x6a, 0xe5, 0xf1, 0x08, 0xb5, 0xf0, 0xfa, 0x33,
-	0x68, 0x39, 0x61, 0x70, 0xec, 0x9d, 0x48, 0x57, 0x5b, 0x8c, 0x6f, 0x4e, 0xf0, 0x6d, 0x31, 0x9d,
-	0x72, 0xb0, 0xe9, 0x64, 0xda, 0x2a, 0x80, 0x03, 0x4c, 0x6c, 0xd7, 0x4e, 0xbf, 0xaa, 0xf6, 0x48,
-	0x00, 0x5f, 0x09, 0x44, 0x7e, 0x3e, 0xf2, 0x52, 0x74, 0x1f, 0x66, 0x13, 0xba, 0x40, 0x04, 0x0e,
-	0xb6, 0x82, 0xe1, 0xe0, 0x08, 0xc7, 0x9d, 0xd9, 0x3b, 0xda, 0xea, 0x94, 0xd9, 0x96, 0xe2, 0x3e,
-	0x93, 0xa2, 0x0d, 0xd0, 0xbd, 0xc8, 0x1e, 0x58, 0x51, 0x18, 0xfa, 0xb2, 0x4f, 0x9d, 0xf5, 0x39,
-	0xaf, 0x3e, 0xc3, 0x8d, 0x57, 0xfb, 0x61, 0xe8, 0xab, 0xfe, 0xda, 0xd4, 0x20, 0x95, 0xe4, 0x29,
-	0x44, 0x24, 0xaf, 0x95, 0x52, 0xa8, 0x08, 0x2a, 0x8a, 0x42, 0x36, 0xaa, 0xd1, 0x0b, 0x1a, 0x34,
-	0x76, 0xf4, 0xf9, 0xf4, 0xc9, 0x4b, 0xd1, 0x01, 0x2c, 0x24, 0x38, 0x3e, 0xf3, 0x1c, 0x6c, 0xd9,
-	0x8e, 0x13, 0x0e, 0xd3, 0xe4, 0x99, 0x63, 0x84, 0x37, 0x04, 0xe1, 0x01, 0x07, 0x6d, 0x70, 0x8c,
-	0x1a, 0xe0, 0xf5, 0xa4, 0x44, 0x5e, 0x46, 0x2a, 0xbc, 0xbc, 0x7e, 0x05, 0xa9, 0xf2, 0xb3, 0x40,
-	0x2a, 0x3c, 0xdd, 0x02, 0x3d, 0xb0, 0x07, 0x38, 0x89, 0x6c, 0x47, 0xad, 0x61, 0xf3, 0x8c, 0x6e,
-	0x41, 0xd0, 0xf5, 0xa5, 0x5a, 0xb9, 0x37, 0x1b, 0xe4, 0x45, 0x79, 0x12, 0xe1, 0xd3, 0x42, 0x39,
-	0x89, 0x72, 0x27, 0x25, 0x11, 0x9e, 0x3c, 0x83, 0x66, 0x1c, 0x0e, 0x89, 0xf2, 0x62, 0x31, 0xb7,
-	0x16, 0x9b, 0x54, 0x95, 0xee, 0x06, 0x71, 0xda, 0x4c, 0x0d, 0x45, 0xcf, 0x9d, 0x51, 0xc3, 0x74,
-	0x11, 0x8f, 0xd3, 0x26, 0xda, 0x82, 0xc6, 0x19, 0xc1, 0x91, 0xec, 0x70, 0x89, 0xd9, 0xdd, 0x11,
-	0x76, 0xaf, 0xff, 0x71, 0x77, 0xa3, 0x7f, 0x38, 0x0c, 0x02, 0xec, 0x8f, 0x7c, 0xda, 0x40, 0xcd,
-	0xd4, 0xd8, 0x39, 0x89, 0xe8, 0x7c, 0xf9, 0x6d, 0x24, 0xca, 0x15, 0x46, 0x22, 0x3c, 0xf9, 0x0e,
-	0x96, 0xce, 0xbd, 0x18, 0x9f, 0x0c, 0xed, 0x78, 0x74, 0xbd, 0xb9, 0xc1, 0x28, 0x57, 0xe4, 0xa2,
-	0x20, 0x71, 0x23, 0x5e, 0x2d, 0x9e, 0x97, 0xab, 0xc6, 0xb0, 0x0b, 0x87, 0x6f, 0x5e, 0xcd, 0xae,
-	0xdc, 0x1d, 0x65, 0x17, 0xbe, 0x7f, 0x03, 0x9d, 0x13, 0x3f, 0x3c, 0xb2, 0x7d, 0xeb, 0xe8, 0x24,
-	0xb2, 0xf2, 0xeb, 0xcf, 0x2d, 0x46, 0x7e, 0x53, 0x90, 0xbf, 0x64, 0xb0, 0xcd, 0x97, 0xfb, 0x85,
-	0x85, 0x68, 0x9e, 0xdb, 0x6f, 0x9e, 0x44, 0x59, 0xc5, 0x66, 0x1d, 0x66, 0x22, 0xfb, 0x92, 0x2e,
-	0x73, 0xc6, 0xff, 0x4c, 0x43, 0xeb, 0x8b, 0x38, 0x1c, 0xa4, 0x55, 0xc6, 0x3e, 0xcc, 0x47, 0x71,
-	0xe8, 0xe0, 0x24, 0xb1, 0x12, 0x62, 0x93, 0x61, 0x92, 0xaf, 0x02, 0xe4, 0x76, 0xb9, 0xcf, 0x31,
-	0x07, 0x0c, 0x92, 0x6e, 0xc0, 0xd1, 0xa8, 0x18, 0xfd, 0x33, 0xdc, 0xc8, 0xef, 0x20, 0x79, 0x5e,
-	0x5e, 0x1a, 0xdc, 0x2e, 0xd9, 0x48, 0x0a, 0xe4, 0x9d, 0xd3, 0x31, 0xba, 0xb1, 0x3d, 0x88, 0x99,
-	0x98, 0x7e, 0x4b, 0x0f, 0x6a, 0x2a, 0x4a, 0x7a, 0x10, 0x73, 0xe1, 0xc3, 0xed, 0xd1, 0xbd, 0x25,
-	0x3f, 0x0e, 0x5e, 0x4e, 0xdc, 0x1d, 0xb3, 0xc5, 0x14, 0xc6, 0x72, 0xf3, 0xfc, 0x0a, 0xfd, 0x95,
-	0xbd, 0x89, 0x31, 0xcd, 0xbc, 0x43, 0x6f, 0x6a, 0x5c, 0x63, 0x7a, 0x13, 0x63, 0x2b, 0xd9, 0x51,
-	0x6a, 0xa5, 0x3b, 0xca, 0x6b, 0x48, 0x73, 0xb5, 0x30, 0xf8, 0x7a, 0x2e, 0x1f, 0x55, 0xb2, 0x17,
-	0x46, 0x3d, 0x7f, 0x5e, 0xa6, 0xc8, 0xe6, 0xe3, 0xbf, 0x6b, 0xd0, 0xcc, 0xe6, 0x2a, 0x7a, 0x06,
-	0x55, 0x9e, 0xf9, 0x1d, 0xed, 0xce, 0x64, 0x66, 0x16, 0xb3, 0x20, 0xd1, 0xd8, 0x0e, 0x48, 0x7c,
-	0x69, 0x0a, 0xf8, 0xf2, 0x73, 0x68, 0x64, 0xc4, 0x48, 0x87, 0xc9, 0x37, 0xf8, 0x92, 0x15, 0xce,
-	0x75, 0x93, 0xfe, 0x44, 0xd7, 0x61, 0xfa, 0xcc, 0xf6, 0x87, 0xbc, 0x3a, 0xae, 0x9b, 0xbc, 0xf1,
-	0x59, 0xe5, 0x53, 0xcd, 0xa8, 0x41, 0x95, 0x97, 0xd4, 0xc6, 0xcf, 0x34, 0x68, 0x64, 0xca, 0x65,
-	0xd4, 0x86, 0x8a, 0xe7, 0x0a, 0x92, 0x8a, 0xe7, 0xa2, 0x0e, 0xcc, 0x0c, 0x30, 0x8d, 0x4d, 0xd2,
-	0xa9, 0xdc, 0x99, 0x5c, 0xad, 0x9b, 0xb2, 0x89, 0x1e, 0xc3, 0x14, 0xb9, 0x8c, 0xf8, 0x57, 0xd3,
-	0x56, 0x81, 0xc9, 0x70, 0xf1, 0xdf, 0x87, 0x97, 0x11, 0x36, 0x19, 0xd2, 0xf8, 0x18, 0xea, 0x4a,
-	0x84, 0xaa, 0x50, 0xe9, 0xed, 0xeb, 0x13, 0x68, 0x96, 0xf6, 0x6f, 0x6d, 0xf4, 0xbb, 0xd6, 0xfe,
-	0x9e, 0x79, 0xa8, 0x6b, 0x68, 0x06, 0x26, 0xfb, 0xdb, 0x87, 0x7a, 0xc5, 0x88, 0x40, 0x2f, 0x56,
-	0xe2, 0x23, 0xee, 0xdd, 0x85, 0x96, 0xed, 0xba, 0xd8, 0xb5, 0xf2, 0x4e, 0x36, 0x99, 0xf0, 0x95,
-	0xf0, 0xf4, 0x3e, 0xcc, 0xf2, 0x9c, 0x4a, 0x61, 0x93, 0x0c, 0xd6, 0x16, 0x62, 0x01, 0x34, 0x6e,
-	0x89, 0x58, 0x88, 0xb4, 0x29, 0x74, 0x66, 0xd8, 0x30, 0x57, 0x52, 0x95, 0xa3, 0x3b, 0x0a, 0xd6,
-	0x58, 0xd3, 0xd3, 0xc5, 0x83, 0x22, 0x7a, 0x5d, 0xe6, 0xe5, 0x2a, 0xcc, 0x88, 0xca, 0x5c, 0x1c,
-	0x54, 0xda, 0x79, 0x98, 0x29, 0xd5, 0xc6, 0xb3, 0x42, 0x17, 0xc2, 0x93, 0xb7, 0x76, 0x61, 0xdc,
-	0x86, 0xba, 0x12, 0x20, 0x04, 0x53, 0x74, 0x8b, 0x14, 0xae, 0xb3, 0xdf, 0x46, 0x08, 0x33, 0x02,
-	0x80, 0x1e, 0x43, 0xcb, 0x0b, 0x8e, 0xc2, 0x61, 0xe0, 0x5a, 0xf1, 0xd0, 0xc7, 0x89, 0x48, 0xbc,
-	0x86, 0xdc, 0xf6, 0x86, 0x3e, 0x36, 0x9b, 0x02, 0x41, 0x1b, 0x09, 0x5a, 0x83, 0x76, 0x38, 0x24,
-	0x59, 0x93, 0xca, 0xa8, 0x49, 0x4b, 0x42, 0x98, 0x8d, 0xf1, 0x1d, 0xa0, 0xd1, 0x03, 0x02, 0xba,
-	0x9d, 0x19, 0xc9, 0xac, 0x1c, 0x09, 0x03, 0x88, 0x58, 0xdd, 0x83, 0x2a, 0x3f, 0x24, 0x88, 0x50,
-	0xb5, 0x72, 0x20, 0x53, 0x28, 0x8d, 0xa7, 0x79, 0x76, 0x11, 0xa7, 0xb7, 0xb1, 0x1b, 0x6b, 0x50,
-	0x93, 0x6d, 0x1a, 0x25, 0xe2, 0xe1, 0x58, 0x46, 0x89, 0xfe, 0x56, 0x91, 0xab, 0x64, 0x22, 0xf7,
-	0x1b, 0x0d, 0xaa, 0xdc, 0xe8, 0x6f, 0x13, 0x39, 0x74, 0x13, 0xea, 0xc3, 0x80, 0xc4, 0xf4, 0x00,
-	0xed, 0xb2, 0xcf, 0xab, 0x66, 0xa6, 0x02, 0xb4, 0x04, 0xb5, 0x28, 0xc6, 0x96, 0x1b, 0xd8, 0x84,
-	0xed, 0x2c, 0x35, 0x9a, 0x3d, 0xb8, 0x1b, 0xd8, 0x84, 0x1a, 0xaa, 0xd2, 0x88, 0xed, 0x09, 0x75,
-	0x33, 0x15, 0x18, 0xff, 0xdd, 0x86, 0x29, 0xda, 0x01, 0x5a, 0x80, 0x2a, 0x3d, 0x55, 0x85, 0x81,
-	0x18, 0xba, 0x68, 0xa1, 0x47, 0x00, 0x5e, 0x64, 0x9d, 0xe1, 0x38, 0xa1, 0xba, 0x0a, 0xfb, 0xae,
-	0x75, 0xf5, 0x5d, 0xbf, 0xe6, 0x72, 0xb3, 0xee, 0x45, 0xe2, 0x27, 0xfa, 0x3b, 0xea, 0x4a, 0x48,
-	0x42, 0x27, 0xf4, 0xc5, 0xe6, 0x39, 0x9b, 0x26, 0x27, 0x13, 0x9b, 0x0a, 0x80, 0x16, 0x61, 0x26,
-	0x89, 0x1d, 0x2b, 0xc0, 0xd4, 0x6d, 0xfa, 0xf5, 0x55, 0x93, 0xd8, 0xe9, 0x63, 0x82, 0x3e, 0x86,
-	0x3a, 0x55, 0x44, 0x61, 0x4c, 0x92, 0xce, 0x34, 0x8b, 0x8e, 0xca, 0xf1, 0x30, 0x26, 0xa6, 0x1d,
-	0x9c, 0x60, 0xb3, 0x96, 0xc4, 0x0e, 0x6d, 0x25, 0x94, 0xc7, 0x4d, 0x08, 0xe3, 0xa9, 0x72, 0x1e,
-	0x37, 0x21, 0x82, 0x87, 0x2a, 0x38, 0xcf, 0xcc, 0x38, 0x1e, 0x37, 0x21, 0x9c, 0xe7, 0x16, 0xd4,
-	0x3d, 0x67, 0x10, 0x59, 0x6c, 0x11, 0xa3, 0xdb, 0xc1, 0xf4, 0xce, 0x84, 0x59, 0xa3, 0x22, 0xb6,
-	0x3e, 0xbd, 0x80, 0xb6, 0x52, 0x5b, 0x4e, 0xe8, 0xca, 0x1d, 0x40, 0x96, 0xa5, 0x3d, 0x01, 0xdc,
-	0x08, 0xdc, 0xad, 0xd0, 0x65, 0x87, 0x22, 0x69, 0x4b, 0xdb, 0xe8, 0x2e, 0xb4, 0xe9, 0xa8, 0xbc,
-	0xc8, 0x4a, 0x30, 0xb1, 0x3c, 0x37, 0xe9, 0x00, 0xf3, 0xb6, 0x91, 0xc4, 0x4e, 0x2f, 0x3a, 0xc0,
-	0xa4, 0xe7, 0x26, 0x14, 0x44, 0x5d, 0xce, 0x80, 0x1a, 0x1c, 0xe4, 0x26, 0x44, 0x81, 0x9e, 0xc1,
-	0x12, 0x0b, 0x9c, 0x3d, 0xc0, 0x2e, 0x1b, 0x5d, 0x16, 0xdf, 0x64, 0xf8, 0xeb, 0x34, 0x94, 0x54,
-	0x4f, 0x87, 0x96, 0x35, 0x64, 0x91, 0x2a, 0x35, 0x6c, 0x71, 0x43, 0x1a, 0xbb, 0x11, 0xc3, 0x35,
-	0x68, 0x06, 0x21, 0xb1, 0xd4, 0xdc, 0x1e, 0x97, 0xcf, 0x6d, 0x23, 0x08, 0x89, 0x6c, 0xa0, 0x15,
-	0xa0, 0x4d, 0x4b, 0x4e, 0xf1, 0x09, 0xa3, 0xaf, 0x07, 0x21, 0x39, 0xe0, 0xb3, 0xfc, 0x04, 0x5a,
-	0x52, 0xcf, 0x67, 0xe8, 0x74, 0xcc, 0x0c, 0x35, 0xb8, 0x0d, 0x9f, 0x24, 0xc1, 0x2a, 0x27, 0xdc,
-	0x53, 0xac, 0x5d, 0x3e, 0xe7, 0x82, 0x35, 0x9d, 0xf7, 0x7f, 0xb9, 0x82, 0xb5, 0x2b, 0xa7, 0xfe,
-	0x43, 0x6e, 0x95, 0x4e, 0xff, 0x1b, 0x36, 0xfd, 0x1a, 0x43, 0xc9, 0x89, 0x45, 0xdb, 0x80, 0x72,
-	0x28, 0x9e, 0x05, 0xfe, 0x95, 0x59, 0xa0, 0x99, 0xb3, 0x19, 0x0a, 0x96, 0x08, 0x0f, 0x38, 0x4d,
-	0x21, 0x19, 0x06, 0x7c, 0x03, 0xe2, 0x63, 0x55, 0x81, 0x17, 0xd8, 0x42, 0x4e, 0x04, 0x0a, 0xdb,
-	0xcd, 0xa4, 0xc5, 0x0b, 0xb8, 0xa5, 0x02, 0x5e, 0x3a, 0xc3, 0x11, 0x33, 0x5b, 0x14, 0x53, 0x30,
-	0x32, 0xc9, 0xc2, 0x7e, 0x7c, 0x86, 0x7c, 0xaf, 0xec, 0xbb, 0xe5, 0x49, 0x32, 0x1f, 0xc6, 0xde,
-	0x89, 0x17, 0xd8, 0x3e, 0x73, 0x22, 0xc1, 0x3e, 0x76, 0x48, 0x18, 0x77, 0x62, 0xb6, 0xa8, 0xcc,
-	0x49, 0xe5, 0x41, 0xec, 0x1c, 0x08, 0x55, 0xce, 0x86, 0x76, 0xac, 0x6c, 0x92, 0xbc, 0x4d, 0x37,
-	0x21, 0xca, 0x66, 0x1b, 0x6e, 0xe7, 0xfa, 0x49, 0x8f, 0x8b, 0xca, 0x9a, 0x30, 0xeb, 0x9b, 0x99,
-	0x1e, 0xd5, 0xa1, 0xb1, 0x94, 0x46, 0x8e, 0xb9, 0x40, 0x33, 0xcc, 0xd3, 0x88, 0x51, 0xe7, 0x69,
-	0x9e, 0xc3, 0x92, 0xa2, 0x91, 0xe1, 0x57, 0x04, 0x67, 0x8c, 0x60, 0x41, 0x02, 0xfa, 0x2c, 0xf2,
-	0x63, 0x4d, 0x73, 0x01, 0x38, 0x1f, 0x31, 0xcd, 0xc6, 0xe0, 0x6b, 0xbe, 0x04, 0x14, 0xcf, 0xf0,
-	0x03, 0x9b, 0x38, 0xa7, 0x9d, 0x8b, 0xdc, 0xb1, 0x25, 0x7f, 0x84, 0x7f, 0x45, 0x11, 0xe6, 0x42,
-	0x42, 0xdd, 0x18, 0x91, 0x53, 0x5a, 0xee, 0x44, 0x19, 0xed, 0xe5, 0xdb, 0x69, 0x5d, 0xea, 0xe2,
-	0x28, 0xed, 0x23, 0x80, 0x53, 0x42, 0x22, 0xc1, 0xf3, 0xaf, 0xb9, 0xaa, 0x65, 0xe7, 0xf0, 0x70,
-	0x9f, 0x5b, 0xd7, 0x29, 0x46, 0x1a, 0xd4, 0xe4, 0xed, 0x49, 0xe7, 0xdf, 0x72, 0xf7, 0x4e, 0x74,
-	0xbf, 0x52, 0x17, 0x24, 0x0a, 0x44, 0xab, 0x52, 0xba, 0x99, 0x5a, 0x9e, 0xdb, 0xf9, 0x51, 0xec,
-	0x61, 0xb4, 0xdd, 0x73, 0x37, 0xab, 0x30, 0x45, 0x3f, 0xd8, 0x4d, 0x80, 0x9a, 0xfc, 0x78, 0xbf,
-	0xac, 0xd6, 0x7e, 0xd0, 0xf4, 0x1f, 0x35, 0x13, 0xfc, 0xf0, 0xc4, 0x8a, 0x62, 0x7c, 0xec, 0x5d,
-	0x18, 0x2f, 0x61, 0xae, 0xcc, 0xf5, 0x65, 0xa8, 0xa9, 0x29, 0xe1, 0xc4, 0xaa, 0x4d, 0xcb, 0x69,
-	0x96, 0x34, 0xa2, 0xc6, 0xe4, 0x0d, 0xe3, 0xe7, 0x1a, 0xd4, 0xd5, 0xa0, 0x78, 0xb9, 0x4c, 0x4e,
-	0x43, 0x97, 0x97, 0x06, 0xac, 0x5c, 0x66, 0x4d, 0xf4, 0x18, 0xa6, 0x23, 0x9b, 0x9c, 0xca, 0xfd,
-	0x7f, 0xb9, 0x18, 0x8f, 0x87, 0xfb, 0x36, 0x39, 0xe5, 0x91, 0xe1, 0xc0, 0xe5, 0xaf, 0xa0, 0xae,
-	0x64, 0x68, 0x01, 0xa6, 0xf1, 0x85, 0xed, 0x10, 0xee, 0xd5, 0xce, 0x84, 0xc9, 0x9b, 0xa8, 0x03,
-	0x55, 0x3e, 0x22, 0x5e, 0xb2, 0xec, 0x4c, 0x98, 0xa2, 0xbd, 0xd9, 0x04, 0xa0, 0x3c, 0x7c, 0x16,
-	0x8c, 0xff, 0xd7, 0xa0, 0x99, 0x0d, 0x26, 0xfa, 0x02, 0x1a, 0x76, 0x10, 0x84, 0xc4, 0xa6, 0x5b,
-	0xbf, 0x2c, 0x64, 0x3e, 0x2c, 0x09, 0xfb, 0xc3, 0x8d, 0x14, 0xc6, 0x0f, 0x20, 0x59, 0xc3, 0xe5,
-	0x17, 0xa0, 0x17, 0x01, 0xef, 0x75, 0x14, 0x79, 0x0e, 0xb3, 0x85, 0x45, 0x94, 0x15, 0x66, 0x74,
-	0x55, 0xa6, 0xf6, 0xd3, 0xfc, 0xec, 0x40, 0x65, 0x6c, 0xf9, 0xad, 0x70, 0x19, 0xfd, 0x6d, 0xec,
-	0x42, 0x4d, 0x6d, 0x3f, 0x1d, 0xa8, 0x8a, 0x93, 0x9d, 0x26, 0xb6, 0x72, 0xd1, 0x46, 0xd7, 0xb3,
-	0x25, 0xdd, 0xce, 0x04, 0x2f, 0xea, 0x36, 0x75, 0x68, 0x73, 0xbd, 0x15, 0xc6, 0x6c, 0x2d, 0x30,
-	0x9e, 0x42, 0x5d, 0x6d, 0x17, 0xd4, 0xdf, 0x63, 0x2f, 0x4e, 0x88, 0xf0, 0x81, 0x37, 0xa8, 0x13,
-	0xbe, 0x9d, 0x10, 0xe9, 0x04, 0xfd, 0x6d, 0xfc, 0xaf, 0x06, 0xa8, 0x78, 0x38, 0xed, 0x75, 0xe9,
-	0x99, 0x23, 0x8c, 0x9d, 0x53, 0x9c, 0x90, 0xd8, 0x26, 0x61, 0x4c, 0x33, 0x95, 0x0f, 0xbd, 0x9d,
-	0x15, 0xf7, 0x5c, 0x74, 0x1b, 0x1a, 0xea, 0x24, 0xec, 0xf1, 0x72, 0xaf, 0x6e, 0x82, 0x14, 0x71,
-	0x80, 0x3a, 0x21, 0x7b, 0x2e, 0x2b, 0xf9, 0xea, 0x26, 0x48, 0x51, 0xcf, 0xfd, 0x72, 0xaa, 0xa6,
-	0xe9, 0x15, 0xb3, 0x46, 0x4f, 0xf6, 0x6c, 0x20, 0x17, 0xb0, 0x50, 0x7e, 0xb3, 0x8c, 0x3e, 0xca,
-	0x94, 0xc7, 0x4b, 0x63, 0x0e, 0xd6, 0xa2, 0x0c, 0xff, 0x04, 0x6a, 0xb2, 0x0b, 0x71, 0xbb, 0xb0,
-	0x38, 0xee, 0x6a, 0x59, 0x01, 0x8d, 0x5f, 0x54, 0x40, 0x2f, 0xaa, 0x69, 0x28, 0xe9, 0x49, 0x5a,
-	0x9e, 0x46, 0x78, 0xa3, 0xac, 0xd0, 0xa6, 0x69, 0x33, 0xb0, 0x1d, 0x11, 0x02, 0xfa, 0x93, 0x8e,
-	0x5d, 0x3e, 0x69, 0xd0, 0x1d, 0x89, 0xd7, 0x8d, 0x20, 0x44, 0x74, 0x13, 0xba, 0x01, 0x75, 0x2f,
-	0x3a, 0x7b, 0x42, 0x8b, 0x03, 0x5e, 0x3b, 0xd6, 0xcd, 0x1a, 0x15, 0xf4, 0x31, 0x91, 0xca, 0x75,
-	0xae, 0xac, 0x2a, 0xe5, 0x3a, 0x53, 0xde, 0x83, 0x69, 0x5a, 0xf1, 0xcb, 0x4a, 0x51, 0x16, 0x37,
-	0x87, 0x1e, 0x8e, 0x7b, 0xc1, 0x71, 0x68, 0x72, 0x2d, 0xfa, 0x08, 0x6a, 0xbc, 0x03, 0x9b, 0x74,
-	0x6a, 0x0c, 0xd9, 0x56, 0xf7, 0x92, 0x84, 0x01, 0x67, 0x58, 0x7f, 0x36, 0x11, 0xd0, 0x75, 0x06,
-	0xad, 0x8f, 0x85, 0xae, 0xf7, 0x6d, 0x62, 0x6c, 0x8d, 0x4e, 0x91, 0x38, 0xc1, 0xbc, 0xfb, 0x14,
-	0x19, 0x1b, 0xd0, 0xce, 0xde, 0xf4, 0xf4, 0xba, 0xc5, 0x54, 0xa9, 0xbc, 0x35, 0x55, 0x7c, 0x40,
-	0xa3, 0xcf, 0x24, 0xe8, 0x5e, 0xc6, 0x87, 0xf9, 0x92, 0x3b, 0x25, 0x91, 0x22, 0x8f, 0x32, 0x29,
-	0x32, 0x99, 0x5b, 0xb5, 0x73, 0x6f, 0x25, 0x69, 0x7a, 0xfc, 0xa9, 0x02, 0xcd, 0xac, 0xaa, 0xec,
-	0x9c, 0x5a, 0x9c, 0xf2, 0xca, 0xc8, 0x94, 0xab, 0x89, 0x9b, 0xbc, 0x72, 0xe2, 0x1e, 0xc2, 0x1c,
-	0xbe, 0x88, 0xb0, 0x43, 0xb0, 0x6b, 0xb1, 0x19, 0xb4, 0x5d, 0x37, 0x96, 0x29, 0x74, 0x4d, 0xaa,
-	0x7a, 0xd1, 0xd9, 0x93, 0x0d, 0xaa, 0x28, 0xe2, 0xd7, 0x05, 0x7e, 0x7a, 0x04, 0xbf, 0xce, 0xf1,
-	0x9f, 0xc2, 0xac, 0x3a, 0x93, 0x59, 0xdc, 0xa1, 0x6a, 0xb9, 0x43, 0x6d, 0x85, 0x3b, 0x64, 0x9e,
-	0x3d, 0x85, 0xb6, 0x3c, 0xc0, 0x59, 0x57, 0xa6, 0x60, 0x53, 0x9c, 0xeb, 0xb8, 0xd9, 0x13, 0x68,
-	0x1d, 0x87, 0xf1, 0xb9, 0x1d, 0xcb, 0xee, 0x6a, 0x63, 0xac, 0x04, 0x8a, 0x59, 0x19, 0x7f, 0x9f,
-	0x9f, 0x61, 0x91, 0x65, 0xef, 0x36, 0xc3, 0x46, 0x0c, 0x35, 0x49, 0x5b, 0x3a, 0x57, 0x1f, 0x81,
-	0xee, 0x05, 0x27, 0x31, 0x4e, 0x12, 0xfe, 0xb0, 0xe7, 0xa9, 0xcd, 0x71, 0x56, 0xc8, 0xf7, 0x85,
-	0x98, 0xae, 0x87, 0xb8, 0x80, 0x14, 0x77, 0x30, 0x38, 0x07, 0x34, 0x9e, 0xc1, 0x8c, 0xf8, 0x5c,
-	0xd0, 0x3c, 0x54, 0xf1, 0x05, 0x2d, 0x49, 0xe5, 0xd2, 0x81, 0x2f, 0x48, 0x2f, 0xa2, 0x62, 0x96,
-	0xe0, 0x91, 0xdc, 0x4c, 0xa8, 0xc3, 0x91, 0x61, 0xc2, 0x5c, 0xc9, 0x95, 0x2d, 0xba, 0x0b, 0x2d,
-	0x2f, 0x09, 0x2d, 0xe2, 0x0d, 0x70, 0x42, 0xec, 0x81, 0xe4, 0x6a, 0x7a, 0x49, 0x78, 0x28, 0x65,
-	0xf4, 0x44, 0x3c, 0x8c, 0x28, 0x84, 0x51, 0x6a, 0xa6, 0x68, 0x19, 0x11, 0x74, 0xc6, 0x5d, 0xd7,
-	0xbe, 0xeb, 0x57, 0xf2, 0x31, 0x54, 0xf9, 0x45, 0xa2, 0xb8, 0xcf, 0x90, 0xd0, 0xc2, 0x45, 0xa5,
-	0x00, 0x19, 0xab, 0xd0, 0xce, 0x6b, 0xa8, 0x6f, 0x82, 0x40, 0x54, 0x3a, 0x02, 0xb9, 0x51, 0xe6,
-	0xdb, 0xfb, 0xcd, 0xef, 0x05, 0xdc, 0xbc, 0xea, 0x16, 0xf7, 0x7d, 0xf6, 0x8b, 0xf7, 0x1c, 0x66,
-	0x6f, 0x5c, 0xcf, 0xef, 0xbf, 0x0c, 0xae, 0xc3, 0x7c, 0xe9, 0x6d, 0x2c, 0xba, 0x05, 0x10, 0x0d,
-	0x8f, 0x7c, 0xcf, 0xb1, 0xd2, 0x62, 0xa4, 0xce, 0x25, 0x5f, 0xe1, 0x4b, 0xe3, 0x15, 0xff, 0x32,
-	0x0a, 0x8f, 0x8f, 0xcb, 0xa0, 0x56, 0x47, 0x59, 0x00, 0xca, 0xb6, 0xda, 0x6c, 0xe8, 0xca, 0x20,
-	0x72, 0x8f, 0x6d, 0x0e, 0x74, 0x41, 0x28, 0xd2, 0x89, 0x71, 0xfc, 0xc5, 0x74, 0xdb, 0xd0, 0xce,
-	0x3f, 0x5e, 0x96, 0x5c, 0x7d, 0x4e, 0x45, 0x61, 0xe8, 0x8b, 0x78, 0xcf, 0x16, 0x9f, 0x2b, 0x99,
-	0xd2, 0xb8, 0x93, 0xd2, 0x8c, 0xb9, 0xd4, 0x7c, 0x01, 0x35, 0x89, 0x60, 0x45, 0x96, 0xe7, 0xaa,
-	0x1b, 0x31, 0xfa, 0x1b, 0xad, 0x00, 0x0c, 0xec, 0xe4, 0xfb, 0x21, 0x8e, 0x6d, 0x51, 0x7e, 0xd5,
-	0xcc, 0x8c, 0xc4, 0xf8, 0x95, 0x06, 0xd7, 0xcb, 0xde, 0x22, 0xd1, 0xfd, 0xcc, 0x14, 0x2e, 0x96,
-	0x9e, 0x22, 0x44, 0xea, 0x7c, 0x0e, 0x55, 0xdf, 0x3e, 0xc2, 0xbe, 0x2c, 0x8d, 0xef, 0x5f, 0xf1,
-	0xc2, 0xf9, 0x70, 0x97, 0x21, 0xc5, 0x45, 0x38, 0x37, 0x5b, 0x7e, 0x0e, 0x8d, 0x8c, 0xf8, 0xbd,
-	0xaa, 0xcf, 0xcf, 0x8b, 0xce, 0xab, 0x17, 0x83, 0x77, 0x73, 0xde, 0xe8, 0x82, 0x5e, 0x94, 0xe7,
-	0xaf, 0xe1, 0xb4, 0xc2, 0x35, 0x5c, 0xe9, 0x15, 0xe3, 0x2f, 0x35, 0x98, 0x2d, 0x3c, 0x96, 0x22,
-	0x23, 0xe3, 0x02, 0x2a, 0xbe, 0x85, 0x8a, 0xd0, 0x7d, 0x56, 0x08, 0x9d, 0x51, 0xfe, 0xf0, 0xfa,
-	0xd7, 0x8e, 0xda, 0xd3, 0x8c, 0xb7, 0x22, 0x60, 0xef, 0xe0, 0xad, 0xf1, 0x01, 0x34, 0x32, 0xa2,
-	0xd2, 0x5b, 0xea, 0x43, 0x00, 0xfe, 0xe6, 0x79, 0x28, 0x8a, 0x7e, 0x2f, 0x12, 0xcb, 0x7f, 0xcd,
-	0x64, 0xbf, 0x99, 0x57, 0x17, 0xbe, 0x1d, 0x88, 0x54, 0xe4, 0x0d, 0x1a, 0x72, 0xf5, 0xf2, 0x22,
-	0xaf, 0x4c, 0x95, 0xc0, 0xf8, 0x5d, 0x05, 0x1a, 0x99, 0x57, 0x60, 0xf4, 0x61, 0xe6, 0x80, 0x91,
-	0x5e, 0x71, 0x32, 0x44, 0xfa, 0x5c, 0x81, 0x3e, 0x81, 0xa6, 0x17, 0xf1, 0xff, 0x0c, 0x60, 0x68,
-	0x7e, 0x21, 0x7a, 0x4d, 0x7d, 0x68, 0xf4, 0x93, 0x61, 0x70, 0xf0, 0x22, 0xf9, 0x9b, 0x86, 0xd1,
-	0x4d, 0x88, 0xac, 0x61, 0xdd, 0x84, 0x20, 0x03, 0x5a, 0xec, 0xbe, 0x21, 0x74, 0x31, 0x3b, 0x68,
-	0x88, 0x0a, 0xbe, 0xe1, 0x26, 0xa4, 0x1f, 0xba, 0x98, 0x46, 0x04, 0xad, 0x40, 0x43, 0x61, 0xbc,
-	0x48, 0x5e, 0xdd, 0x0a, 0x44, 0x2f, 0xa2, 0x45, 0x51, 0x62, 0x0f, 0xb0, 0x95, 0x0c, 0x8f, 0x02,
-	0x4c, 0xd8, 0xd3, 0x58, 0xcd, 0x04, 0x2a, 0x3a, 0x60, 0x12, 0xf4, 0x01, 0x34, 0x69, 0x39, 0x11,
-	0x0e, 0xc9, 0x49, 0xe8, 0x05, 0x27, 0xec, 0x3e, 0xb3, 0x66, 0x36, 0x02, 0x9b, 0xec, 0x09, 0x11,
-	0xba, 0x07, 0x6d, 0x3f, 0x74, 0x6c, 0xdf, 0x92, 0x67, 0x0b, 0x76, 0xa1, 0x59, 0x33, 0x5b, 0x4c,
-	0x2a, 0x17, 0x57, 0xb4, 0x06, 0x0d, 0xc2, 0x66, 0x80, 0x0f, 0x9a, 0xff, 0x13, 0x8c, 0x1c, 0x74,
-	0x3a, 0x37, 0x26, 0x10, 0xf5, 0xdb, 0xb8, 0x2d, 0xc2, 0x2b, 0x72, 0x41, 0xc4, 0xa0, 0xa2, 0x62,
-	0x60, 0xfc, 0xa7, 0x06, 0x4b, 0x63, 0x5f, 0xc5, 0x59, 0x22, 0xd0, 0xb3, 0x9d, 0x4c, 0x04, 0x7a,
-	0x06, 0x14, 0x67, 0x81, 0x4a, 0x7a, 0x16, 0xc8, 0x2d, 0x97, 0x93, 0xf9, 0xe5, 0x12, 0xad, 0x82,
-	0x1e, 0xd9, 0x31, 0x0e, 0x88, 0xe5, 0x62, 0x76, 0x97, 0xe1, 0x45, 0x22, 0xce, 0x6d, 0x2e, 0xef,
-	0x32, 0x71, 0x2f, 0x32, 0x1e, 0x95, 0x7a, 0x22, 0x3c, 0x2f, 0xf1, 0xc4, 0xf8, 0x0f, 0x0d, 0x16,
-	0xc7, 0xbc, 0x9c, 0x5f, 0xb9, 0xbc, 0xe7, 0xb7, 0x9f, 0x4a, 0x61, 0xfb, 0xa1, 0xf5, 0xa6, 0x17,
-	0x10, 0x1c, 0x1f, 0xdb, 0xcc, 0xdb, 0xfc, 0xc0, 0xae, 0x29, 0x95, 0x2c, 0x50, 0x8d, 0xa7, 0x25,
-	0x5e, 0xbc, 0x7d, 0x93, 0x31, 0x7e, 0xad, 0xc1, 0x7c, 0xe9, 0xe3, 0x39, 0x5a, 0x83, 0x79, 0x79,
-	0xf1, 0xe3, 0xf8, 0xc3, 0x84, 0xe0, 0xd8, 0xa2, 0x0b, 0xbe, 0xbc, 0xb8, 0x98, 0x13, 0xca, 0x2d,
-	0xae, 0xdb, 0xa2, 0x2a, 0xf4, 0x24, 0xfd, 0x3f, 0x12, 0x7c, 0x41, 0x70, 0x1c, 0xd8, 0xbe, 0x30,
-	0xaa, 0x88, 0x7b, 0x68, 0xae, 0xdd, 0x16, 0x4a, 0x6e, 0xf5, 0x0f, 0xb0, 0x2c, 0xad, 0x68, 0x8a,
-	0x1d, 0xd9, 0xbe, 0x1d, 0x38, 0xaa, 0x3b, 0x5e, 0x06, 0x76, 0x04, 0x62, 0x37, 0x03, 0x60, 0xd6,
-	0x0f, 0x56, 0xa1, 0xae, 0x1e, 0x1f, 0xd0, 0x0c, 0x4c, 0x6e, 0xf4, 0xbf, 0xd5, 0x27, 0x50, 0x0d,
-	0xa6, 0x7a, 0xfb, 0xaf, 0x9f, 0xe8, 0x53, 0xe2, 0xd7, 0xba, 0x5e, 0x7d, 0xf0, 0x5f, 0x1a, 0xd4,
-	0xd5, 0x47, 0x8c, 0x5a, 0x50, 0xdf, 0xea, 0x75, 0x4d, 0xab, 0xd7, 0xff, 0x62, 0x4f, 0x9f, 0x40,
-	0x73, 0x30, 0x6b, 0x6e, 0xbf, 0xda, 0x3b, 0xdc, 0xb6, 0xbe, 0xd9, 0x33, 0xbf, 0xda, 0xdd, 0xdb,
-	0xe8, 0xea, 0x1a, 0x9a, 0x85, 0x86, 0x10, 0xee, 0xec, 0x1d, 0x1c, 0xea, 0x15, 0x84, 0xa0, 0xbd,
-	0xbb, 0xb7, 0xb5, 0xb1, 0x9b, 0x82, 0x26, 0x51, 0x1b, 0x80, 0xcb, 0x18, 0x66, 0x0a, 0x5d, 0x83,
-	0x96, 0x30, 0x3a, 0xfc, 0xba, 0xdf, 0xdf, 0xde, 0xd5, 0xa7, 0x91, 0x0e, 0x4d, 0x0e, 0x11, 0x92,
-	0xea, 0x83, 0xe7, 0x00, 0xe9, 0x0a, 0x41, 0x7d, 0xec, 0xef, 0xf5, 0xb7, 0xf5, 0x09, 0xd4, 0x84,
-	0x5a, 0x7f, 0xcf, 0xda, 0xee, 0x6f, 0x6d, 0xec, 0xeb, 0x1a, 0xaa, 0xc3, 0x34, 0x4b, 0x46, 0xbd,
-	0xc2, 0x87, 0xd1, 0xdb, 0xd7, 0x27, 0xd7, 0x5e, 0x00, 0xf0, 0xe7, 0x26, 0xf6, 0x9f, 0x8e, 0x8f,
-	0x61, 0x8a, 0xfd, 0x95, 0x8b, 0x6a, 0xe6, 0xff, 0x27, 0x97, 0xa5, 0x2c, 0xf3, 0x3f, 0x94, 0x8f,
-	0xb5, 0xcd, 0xc5, 0x1f, 0x7e, 0x5a, 0xd1, 0x7e, 0xfb, 0xd3, 0x8a, 0xf6, 0xfb, 0x9f, 0x56, 0xb4,
-	0xff, 0xfb, 0xe3, 0xca, 0xc4, 0x3f, 0x4d, 0xb3, 0x9b, 0xfc, 0xa3, 0x2a, 0xfb, 0xf3, 0xc9, 0x9f,
-	0x03, 0x00, 0x00, 0xff, 0xff, 0x82, 0xf1, 0x6b, 0xf7, 0xa1, 0x29, 0x00, 0x00,
+	// 3482 bytes of a gzipped FileDescriptorProto
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xbc, 0x5a, 0xdd, 0x6e, 0x1c, 0xc7,
+	0x95, 0x66, 0x0f, 0xc9, 0xe1, 0xcc, 0x99, 0xbf, 0x56, 0x51, 0x24, 0x87, 0x94, 0x44, 0xd1, 0x2d,
+	0x0b, 0xa2, 0xb5, 0xb0, 0x24, 0xd0, 0x12, 0x65, 0x79, 0x17, 0x32, 0x48, 0x0e, 0x2d, 0x8e, 0x4d,
+	0x0d, 0x89, 0x26, 0x2d, 0xaf, 0x17, 0x06, 0x7a, 0x9b, 0xd3, 0x45, 0xb2, 0x57, 0x3d, 0xdd, 0xed,
+	0xee, 0x1a, 0xfe, 0xec, 0xde, 0x2d, 0x72, 0x91, 0x04, 0x08, 0x92, 0xab, 0x20, 0x0f, 0x90, 0xcb,
+	0xbc, 0x41, 0x2e, 0x72, 0x15, 0xc0, 0xbe, 0x4b, 0xde, 0x20, 0x71, 0x9e, 0x20, 0x4f, 0x90, 0xa0,
+	0x7e, 0xfb, 0x67, 0x7a, 0x28, 0x29, 0x08, 0x72, 0xc5, 0xa9, 0x73, 0xbe, 0xf3, 0xd5, 0xa9, 0x53,
+	0xa7, 0xab, 0x4e, 0x55, 0x11, 0xd0, 0x31, 0xf6, 0xdc, 0x8b, 0x23, 0xbb, 0xff, 0x1a, 0xfb, 0xce,
+	0x83, 0x30, 0x0a, 0x48, 0x80, 0xa6, 0x99, 0xcc, 0x68, 0x40, 0xed, 0xe0, 0xd2, 0xef, 0x9b, 0xf8,
+	0xdb, 0x21, 0x8e, 0x89, 0xf1, 0x67, 0x1d, 0x6a, 0x87, 0x41, 0xc7, 0x26, 0x76, 0xe8, 0xd9, 0x3e,
+	0x46, 0xab, 0x30, 0xe3, 0xfa, 0x56, 0x7c, 0xe9, 0xf7, 0xdb, 0xda, 0x8a, 0xb6, 0x5a, 0x5b, 0x6b,
+	0x3c, 0x60, 0x76, 0x0f, 0xba, 0x3e, 0x35, 0xdb, 0x99, 0x30, 0xcb, 0x2e, 0xfb, 0x85, 0x9e, 0x42,
+	0xdd, 0x0d, 0x63, 0x4c, 0xac, 0x61, 0xe8, 0xd8, 0x04, 0xb7, 0x4b, 0x0c, 0x8e, 0x24, 0x7c, 0xff,
+	0x00, 0x93, 0x2f, 0x99, 0x66, 0x67, 0xc2, 0xac, 0x31, 0x24, 0x6f, 0xa2, 0x17, 0x80, 0xb8, 0xa1,
+	0x83, 0x3d, 0x62, 0x4b, 0xf3, 0x49, 0x66, 0xbe, 0x90, 0x36, 0xef, 0x50, 0xbd, 0xe2, 0xd0, 0x99,
+	0x51, 0x4a, 0x96, 0x78, 0x10, 0xe1, 0x41, 0x70, 0x86, 0xdb, 0x53, 0xa3, 0x1e, 0x98, 0x4c, 0xa3,
+	0x3c, 0xe0, 0x4d, 0xb4, 0x0f, 0x73, 0x76, 0x9f, 0xb8, 0x67, 0xd8, 0x0a, 0xa3, 0xe0, 0xd8, 0xf5,
+	0xb0, 0x74, 0x62, 0x9a, 0x31, 0x2c, 0x09, 0x86, 0x0d, 0x86, 0xd9, 0xe7, 0x10, 0xe5, 0xc7, 0xac,
+	0x3d, 0x2a, 0x2e, 0x60, 0x14, 0x3e, 0x95, 0xc7, 0x33, 0x2a, 0xdf, 0xb2, 0x8c, 0xc2, 0xc7, 0x97,
+	0x70, 0x5d, 0x32, 0x06, 0x9e, 0xdb, 0xbf, 0x94, 0x2e, 0xce, 0x30, 0xc2, 0xc5, 0x2c, 0x21, 0x43,
+	0x28, 0x0f, 0x91, 0x3d, 0x22, 0x1d, 0xa5, 0x13, 0xfe, 0x55, 0xc6, 0xd2, 0x29, 0xf7, 0x32, 0x74,
+	0x89, 0x77, 0xa7, 0x41, 0x4c, 0x2c, 0xec, 0x3b, 0x61, 0xe0, 0xfa, 0x2a, 0x09, 0xaa, 0x19, 0xba,
+	0x9d, 0x20, 0x26, 0xdb, 0x02, 0x91, 0x78, 0x77, 0x3a, 0x22, 0x1d, 0xa5, 0x13, 0xde, 0xc1, 0x58,
+	0xba, 0xc4, 0xbb, 0xd3, 0x11, 0x29, 0xfa, 0x1a, 0xda, 0xe7, 0x41, 0xf4, 0xda, 0x0b, 0x6c, 0x67,
+	0xc4, 0xc3, 0x1a, 0xa3, 0xbc, 0x25, 0x28, 0xbf, 0x12, 0xb0, 0x11, 0x2f, 0xe7, 0xcf, 0x0b, 0x35,
+	0xc5, 0xd4, 0xc2, 0xdb, 0xfa, 0x95, 0xd4, 0xca, 0xe3, 0x11, 0x6a, 0xe1, 0xf5, 0x27, 0xd0, 0xe8,
+	0x07, 0xfe, 0xb1, 0x7b, 0x22, 0x5d, 0x6d, 0x30, 0xbe, 0x59, 0xc1, 0xb7, 0xc5, 0x74, 0xca, 0xc1,
+	0x7a, 0x3f, 0xd5, 0x56, 0x01, 0x1c, 0x60, 0x62, 0x3b, 0x76, 0xf2, 0x55, 0x35, 0x47, 0x02, 0xf8,
+	0x52, 0x20, 0xb2, 0xf3, 0x91, 0x95, 0xa2, 0x7b, 0xd0, 0x8a, 0xe9, 0x02, 0xe1, 0xf7, 0xb1, 0xe5,
+	0x0f, 0x07, 0x47, 0x38, 0x6a, 0xb7, 0x56, 0xb4, 0xd5, 0x29, 0xb3, 0x29, 0xc5, 0x3d, 0x26, 0x45,
+	0x1b, 0xa0, 0xbb, 0xa1, 0x3d, 0xb0, 0xc2, 0x20, 0xf0, 0x64, 0x9f, 0x3a, 0xeb, 0x73, 0x4e, 0x7d,
+	0x86, 0x1b, 0x2f, 0xf7, 0x83, 0xc0, 0x53, 0xfd, 0x35, 0xa9, 0x41, 0x22, 0xc9, 0x52, 0x88, 0x48,
+	0x5e, 0x2b, 0xa4, 0x50, 0x11, 0x54, 0x14, 0xb9, 0x6c, 0x54, 0xa3, 0x17, 0x34, 0x68, 0xec, 0xe8,
+	0xb3, 0xe9, 0x93, 0x95, 0xa2, 0x03, 0x98, 0x8f, 0x71, 0x74, 0xe6, 0xf6, 0xb1, 0x65, 0xf7, 0xfb,
+	0xc1, 0x30, 0x49, 0x9e, 0x59, 0x46, 0x78, 0x43, 0x10, 0x1e, 0x70, 0xd0, 0x06, 0xc7, 0xa8, 0x01,
+	0x5e, 0x8f, 0x0b, 0xe4, 0x45, 0xa4, 0xc2, 0xcb, 0xeb, 0x57, 0x90, 0x2a, 0x3f, 0x73, 0xa4, 0xc2,
+	0xd3, 0x2d, 0xd0, 0x7d, 0x7b, 0x80, 0xe3, 0xd0, 0xee, 0xab, 0x35, 0x6c, 0x8e, 0xd1, 0xcd, 0x0b,
+	0xba, 0x9e, 0x54, 0x2b, 0xf7, 0x5a, 0x7e, 0x56, 0x94, 0x25, 0x11, 0x3e, 0xcd, 0x17, 0x93, 0x28,
+	0x77, 0x12, 0x12, 0xe1, 0xc9, 0x53, 0xa8, 0x47, 0xc1, 0x90, 0x28, 0x2f, 0x16, 0x32, 0x6b, 0xb1,
+	0x49, 0x55, 0xc9, 0x6e, 0x10, 0x25, 0xcd, 0xc4, 0x50, 0xf4, 0xdc, 0x1e, 0x35, 0x4c, 0x16, 0xf1,
+	0x28, 0x69, 0xa2, 0x2d, 0xa8, 0x9d, 0x11, 0x1c, 0xca, 0x0e, 0x17, 0x99, 0xdd, 0x8a, 0xb0, 0x7b,
+	0xf5, 0x9f, 0xbb, 0x1b, 0xbd, 0xc3, 0xa1, 0xef, 0x63, 0x6f, 0xe4, 0xd3, 0x06, 0x6a, 0xa6, 0xc6,
+	0xce, 0x49, 0x44, 0xe7, 0x4b, 0x6f, 0x22, 0x51, 0xae, 0x30, 0x12, 0xe1, 0xc9, 0x37, 0xb0, 0x78,
+	0xee, 0x46, 0xf8, 0x64, 0x68, 0x47, 0xa3, 0xeb, 0xcd, 0x0d, 0x46, 0xb9, 0x2c, 0x17, 0x05, 0x89,
+	0x1b, 0xf1, 0x6a, 0xe1, 0xbc, 0x58, 0x35, 0x86, 0x5d, 0x38, 0x7c, 0xf3, 0x6a, 0x76, 0xe5, 0xee,
+	0x28, 0xbb, 0xf0, 0xfd, 0x2b, 0x68, 0x9f, 0x78, 0xc1, 0x91, 0xed, 0x59, 0x47, 0x27, 0xa1, 0x95,
+	0x5d, 0x7f, 0x6e, 0x31, 0xf2, 0x9b, 0x82, 0xfc, 0x05, 0x83, 0x6d, 0xbe, 0xd8, 0xcf, 0x2d, 0x44,
+	0x73, 0xdc, 0x7e, 0xf3, 0x24, 0x4c, 0x2b, 0x36, 0xab, 0x30, 0x13, 0xda, 0x97, 0x74, 0x99, 0x33,
+	0x7e, 0x36, 0x0d, 0x8d, 0xcf, 0xa2, 0x60, 0x90, 0x54, 0x19, 0xfb, 0x30, 0x17, 0x46, 0x41, 0x1f,
+	0xc7, 0xb1, 0x15, 0x13, 0x9b, 0x0c, 0xe3, 0x6c, 0x15, 0x20, 0xb7, 0xcb, 0x7d, 0x8e, 0x39, 0x60,
+	0x90, 0x64, 0x03, 0x0e, 0x47, 0xc5, 0xe8, 0xbf, 0xe1, 0x46, 0x76, 0x07, 0xc9, 0xf2, 0xf2, 0xd2,
+	0xe0, 0x76, 0xc1, 0x46, 0x92, 0x23, 0x6f, 0x9f, 0x8e, 0xd1, 0x8d, 0xed, 0x41, 0xcc, 0xc4, 0xf4,
+	0x1b, 0x7a, 0x50, 0x53, 0x51, 0xd0, 0x83, 0x98, 0x0b, 0x0f, 0x6e, 0x8f, 0xee, 0x2d, 0xd9, 0x71,
+	0xf0, 0x72, 0xe2, 0xce, 0x98, 0x2d, 0x26, 0x37, 0x96, 0x9b, 0xe7, 0x57, 0xe8, 0xaf, 0xec, 0x4d,
+	0x8c, 0x69, 0xe6, 0x2d, 0x7a, 0x53, 0xe3, 0x1a, 0xd3, 0x9b, 0x18, 0x5b, 0xc1, 0x8e, 0x52, 0x29,
+	0xdc, 0x51, 0x5e, 0x41, 0x92, 0xab, 0xb9, 0xc1, 0x57, 0x33, 0xf9, 0xa8, 0x92, 0x3d, 0x37, 0xea,
+	0xb9, 0xf3, 0x22, 0x45, 0x3a, 0x1f, 0xff, 0x5f, 0x83, 0x7a, 0x3a, 0x57, 0xd1, 0x53, 0x28, 0xf3,
+	0xcc, 0x6f, 0x6b, 0x2b, 0x93, 0xa9, 0x59, 0x4c, 0x83, 0x44, 0x63, 0xdb, 0x27, 0xd1, 0xa5, 0x29,
+	0xe0, 0x4b, 0xcf, 0xa0, 0x96, 0x12, 0x23, 0x1d, 0x26, 0x5f, 0xe3, 0x4b, 0x56, 0x38, 0x57, 0x4d,
+	0xfa, 0x13, 0x5d, 0x87, 0xe9, 0x33, 0xdb, 0x1b, 0xf2, 0xea, 0xb8, 0x6a, 0xf2, 0xc6, 0x27, 0xa5,
+	0x8f, 0x35, 0xa3, 0x02, 0x65, 0x5e, 0x52, 0x1b, 0xbf, 0xd2, 0xa0, 0x96, 0x2a, 0x97, 0x51, 0x13,
+	0x4a, 0xae, 0x23, 0x48, 0x4a, 0xae, 0x83, 0xda, 0x30, 0x33, 0xc0, 0x34, 0x36, 0x71, 0xbb, 0xb4,
+	0x32, 0xb9, 0x5a, 0x35, 0x65, 0x13, 0x3d, 0x82, 0x29, 0x72, 0x19, 0xf2, 0xaf, 0xa6, 0xa9, 0x02,
+	0x93, 0xe2, 0xe2, 0xbf, 0x0f, 0x2f, 0x43, 0x6c, 0x32, 0xa4, 0xf1, 0x21, 0x54, 0x95, 0x08, 0x95,
+	0xa1, 0xd4, 0xdd, 0xd7, 0x27, 0x50, 0x8b, 0xf6, 0x6f, 0x6d, 0xf4, 0x3a, 0xd6, 0xfe, 0x9e, 0x79,
+	0xa8, 0x6b, 0x68, 0x06, 0x26, 0x7b, 0xdb, 0x87, 0x7a, 0xc9, 0x08, 0x41, 0xcf, 0x57, 0xe2, 0x23,
+	0xee, 0xdd, 0x81, 0x86, 0xed, 0x38, 0xd8, 0xb1, 0xb2, 0x4e, 0xd6, 0x99, 0xf0, 0xa5, 0xf0, 0xf4,
+	0x1e, 0xb4, 0x78, 0x4e, 0x25, 0xb0, 0x49, 0x06, 0x6b, 0x0a, 0xb1, 0x00, 0x1a, 0xb7, 0x44, 0x2c,
+	0x44, 0xda, 0xe4, 0x3a, 0x33, 0x6c, 0x98, 0x2d, 0xa8, 0xca, 0xd1, 0x8a, 0x82, 0xd5, 0xd6, 0xf4,
+	0x64, 0xf1, 0xa0, 0x88, 0x6e, 0x87, 0x79, 0xb9, 0x0a, 0x33, 0xa2, 0x32, 0x17, 0x07, 0x95, 0x66,
+	0x16, 0x66, 0x4a, 0xb5, 0xf1, 0x34, 0xd7, 0x85, 0xf0, 0xe4, 0x8d, 0x5d, 0x18, 0xb7, 0xa1, 0xaa,
+	0x04, 0x08, 0xc1, 0x14, 0xdd, 0x22, 0x85, 0xeb, 0xec, 0xb7, 0x11, 0xc0, 0x8c, 0x00, 0xa0, 0x47,
+	0xd0, 0x70, 0xfd, 0xa3, 0x60, 0xe8, 0x3b, 0x56, 0x34, 0xf4, 0x70, 0x2c, 0x12, 0xaf, 0x26, 0xb7,
+	0xbd, 0xa1, 0x87, 0xcd, 0xba, 0x40, 0xd0, 0x46, 0x8c, 0xd6, 0xa0, 0x19, 0x0c, 0x49, 0xda, 0xa4,
+	0x34, 0x6a, 0xd2, 0x90, 0x10, 0x66, 0x63, 0x7c, 0x03, 0x68, 0xf4, 0x80, 0x80, 0x6e, 0xa7, 0x46,
+	0xd2, 0x92, 0x23, 0x61, 0x00, 0x11, 0xab, 0xbb, 0x50, 0xe6, 0x87, 0x04, 0x11, 0xaa, 0x46, 0x06,
+	0x64, 0x0a, 0xa5, 0xf1, 0x24, 0xcb, 0x2e, 0xe2, 0xf4, 0x26, 0x76, 0x63, 0x0d, 0x2a, 0xb2, 0x4d,
+	0xa3, 0x44, 0x5c, 0x1c, 0xc9, 0x28, 0xd1, 0xdf, 0x2a, 0x72, 0xa5, 0x54, 0xe4, 0x7e, 0xaf, 0x41,
+	0x99, 0x1b, 0xfd, 0x6b, 0x22, 0x87, 0x6e, 0x42, 0x75, 0xe8, 0x93, 0x88, 0x1e, 0xa0, 0x1d, 0xf6,
+	0x79, 0x55, 0xcc, 0x44, 0x80, 0x16, 0xa1, 0x12, 0x46, 0xd8, 0x72, 0x7c, 0x9b, 0xb0, 0x9d, 0xa5,
+	0x42, 0xb3, 0x07, 0x77, 0x7c, 0x9b, 0x50, 0x43, 0x55, 0x1a, 0xb1, 0x3d, 0xa1, 0x6a, 0x26, 0x02,
+	0xe3, 0xa7, 0x4d, 0x98, 0xa2, 0x1d, 0xa0, 0x79, 0x28, 0xd3, 0x53, 0x55, 0xe0, 0x8b, 0xa1, 0x8b,
+	0x16, 0x7a, 0x08, 0xe0, 0x86, 0xd6, 0x19, 0x8e, 0x62, 0xaa, 0x2b, 0xb1, 0xef, 0x5a, 0x57, 0xdf,
+	0xf5, 0x2b, 0x2e, 0x37, 0xab, 0x6e, 0x28, 0x7e, 0xa2, 0x7f, 0xa3, 0xae, 0x04, 0x24, 0xe8, 0x07,
+	0x9e, 0xd8, 0x3c, 0x5b, 0x49, 0x72, 0x32, 0xb1, 0xa9, 0x00, 0x68, 0x01, 0x66, 0xe2, 0xa8, 0x6f,
+	0xf9, 0x98, 0xba, 0x4d, 0xbf, 0xbe, 0x72, 0x1c, 0xf5, 0x7b, 0x98, 0xa0, 0x0f, 0xa1, 0x4a, 0x15,
+	0x61, 0x10, 0x91, 0xb8, 0x3d, 0xcd, 0xa2, 0xa3, 0x72, 0x3c, 0x88, 0x88, 0x69, 0xfb, 0x27, 0xd8,
+	0xac, 0xc4, 0x51, 0x9f, 0xb6, 0x62, 0xca, 0xe3, 0xc4, 0x84, 0xf1, 0x94, 0x39, 0x8f, 0x13, 0x13,
+	0xc1, 0x43, 0x15, 0x9c, 0x67, 0x66, 0x1c, 0x8f, 0x13, 0x13, 0xce, 0x73, 0x0b, 0xaa, 0x6e, 0x7f,
+	0x10, 0x5a, 0x6c, 0x11, 0xa3, 0xdb, 0xc1, 0xf4, 0xce, 0x84, 0x59, 0xa1, 0x22, 0xb6, 0x3e, 0x3d,
+	0x87, 0xa6, 0x52, 0x5b, 0xfd, 0xc0, 0x91, 0x3b, 0x80, 0x2c, 0x4b, 0xbb, 0x02, 0xb8, 0xe1, 0x3b,
+	0x5b, 0x81, 0xc3, 0x0e, 0x45, 0xd2, 0x96, 0xb6, 0xd1, 0x1d, 0x68, 0xd2, 0x51, 0xb9, 0xa1, 0x15,
+	0x63, 0x62, 0xb9, 0x4e, 0xdc, 0x06, 0xe6, 0x6d, 0x2d, 0x8e, 0xfa, 0xdd, 0xf0, 0x00, 0x93, 0xae,
+	0x13, 0x53, 0x10, 0x75, 0x39, 0x05, 0xaa, 0x71, 0x90, 0x13, 0x13, 0x05, 0x7a, 0x0a, 0x8b, 0x2c,
+	0x70, 0xf6, 0x00, 0x3b, 0x6c, 0x74, 0x69, 0x7c, 0x9d, 0xe1, 0xaf, 0xd3, 0x50, 0x52, 0x3d, 0x1d,
+	0x5a, 0xda, 0x90, 0x45, 0xaa, 0xd0, 0xb0, 0xc1, 0x0d, 0x69, 0xec, 0x46, 0x0c, 0xd7, 0xa0, 0xee,
+	0x07, 0xc4, 0x52, 0x73, 0x7b, 0x5c, 0x3c, 0xb7, 0x35, 0x3f, 0x20, 0xb2, 0x81, 0x96, 0x81, 0x36,
+	0x2d, 0x39, 0xc5, 0x27, 0x8c, 0xbe, 0xea, 0x07, 0xe4, 0x80, 0xcf, 0xf2, 0x63, 0x68, 0x48, 0x3d,
+	0x9f, 0xa1, 0xd3, 0x31, 0x33, 0x54, 0xe3, 0x36, 0x7c, 0x92, 0x04, 0xab, 0x9c, 0x70, 0x57, 0xb1,
+	0x76, 0xf8, 0x9c, 0x0b, 0xd6, 0x64, 0xde, 0xff, 0xe7, 0x0a, 0xd6, 0x8e, 0x9c, 0xfa, 0xf7, 0xb9,
+	0x55, 0x32, 0xfd, 0xaf, 0xd9, 0xf4, 0x6b, 0x0c, 0x25, 0x27, 0x16, 0x6d, 0x03, 0xca, 0xa0, 0x78,
+	0x16, 0x78, 0x57, 0x66, 0x81, 0x66, 0xb6, 0x52, 0x14, 0x2c, 0x11, 0xee, 0x73, 0x9a, 0x5c, 0x32,
+	0x0c, 0xf8, 0x06, 0xc4, 0xc7, 0xaa, 0x02, 0x2f, 0xb0, 0xb9, 0x9c, 0xf0, 0x15, 0xb6, 0x93, 0x4a,
+	0x8b, 0xe7, 0x70, 0x4b, 0x05, 0xbc, 0x70, 0x86, 0x43, 0x66, 0xb6, 0x20, 0xa6, 0x60, 0x64, 0x92,
+	0x85, 0xfd, 0xf8, 0x0c, 0xf9, 0x56, 0xd9, 0x77, 0x8a, 0x93, 0x64, 0x2e, 0x88, 0xdc, 0x13, 0xd7,
+	0xb7, 0x3d, 0xe6, 0x44, 0x8c, 0x3d, 0xdc, 0x27, 0x41, 0xd4, 0x8e, 0xd8, 0xa2, 0x32, 0x2b, 0x95,
+	0x07, 0x51, 0xff, 0x40, 0xa8, 0x32, 0x36, 0xb4, 0x63, 0x65, 0x13, 0x67, 0x6d, 0x3a, 0x31, 0x51,
+	0x36, 0xdb, 0x70, 0x3b, 0xd3, 0x4f, 0x72, 0x5c, 0x54, 0xd6, 0x84, 0x59, 0xdf, 0x4c, 0xf5, 0xa8,
+	0x0e, 0x8d, 0x85, 0x34, 0x72, 0xcc, 0x39, 0x9a, 0x61, 0x96, 0x46, 0x8c, 0x3a, 0x4b, 0xf3, 0x0c,
+	0x16, 0x15, 0x8d, 0x0c, 0xbf, 0x22, 0x38, 0x63, 0x04, 0xf3, 0x12, 0xd0, 0x63, 0x91, 0x1f, 0x6b,
+	0x9a, 0x09, 0xc0, 0xf9, 0x88, 0x69, 0x3a, 0x06, 0x5f, 0xf2, 0x25, 0x20, 0x7f, 0x86, 0x1f, 0xd8,
+	0xa4, 0x7f, 0xda, 0xbe, 0xc8, 0x1c, 0x5b, 0xb2, 0x47, 0xf8, 0x97, 0x14, 0x61, 0xce, 0xc7, 0xd4,
+	0x8d, 0x11, 0x39, 0xa5, 0xe5, 0x4e, 0x14, 0xd1, 0x5e, 0xbe, 0x99, 0xd6, 0xa1, 0x2e, 0x8e, 0xd2,
+	0x3e, 0x04, 0x38, 0x25, 0x24, 0x14, 0x3c, 0xff, 0x9b, 0xa9, 0x5a, 0x76, 0x0e, 0x0f, 0xf7, 0xb9,
+	0x75, 0x95, 0x62, 0xa4, 0x41, 0x45, 0xde, 0x9e, 0xb4, 0xff, 0x2f, 0x73, 0xef, 0x44, 0xf7, 0x2b,
+	0x75, 0x41, 0xa2, 0x40, 0xb4, 0x2a, 0xa5, 0x9b, 0xa9, 0xe5, 0x3a, 0xed, 0xef, 0xc5, 0x1e, 0x46,
+	0xdb, 0x5d, 0x67, 0xb3, 0x0c, 0x53, 0xf4, 0x83, 0xdd, 0x04, 0xa8, 0xc8, 0x8f, 0xf7, 0xf3, 0x72,
+	0xe5, 0x3b, 0x4d, 0xff, 0x5e, 0x33, 0xc1, 0x0b, 0x4e, 0xac, 0x30, 0xc2, 0xc7, 0xee, 0x85, 0xf1,
+	0x02, 0x66, 0x8b, 0x5c, 0x5f, 0x82, 0x8a, 0x9a, 0x12, 0x4e, 0xac, 0xda, 0xb4, 0x9c, 0x66, 0x49,
+	0x23, 0x6a, 0x4c, 0xde, 0x30, 0x7e, 0xad, 0x41, 0x55, 0x0d, 0x8a, 0x97, 0xcb, 0xe4, 0x34, 0x70,
+	0x78, 0x69, 0xc0, 0xca, 0x65, 0xd6, 0x44, 0x8f, 0x60, 0x3a, 0xb4, 0xc9, 0xa9, 0xdc, 0xff, 0x97,
+	0xf2, 0xf1, 0x78, 0xb0, 0x6f, 0x93, 0x53, 0x1e, 0x19, 0x0e, 0x5c, 0xfa, 0x02, 0xaa, 0x4a, 0x86,
+	0xe6, 0x61, 0x1a, 0x5f, 0xd8, 0x7d, 0xc2, 0xbd, 0xda, 0x99, 0x30, 0x79, 0x13, 0xb5, 0xa1, 0xcc,
+	0x47, 0xc4, 0x4b, 0x96, 0x9d, 0x09, 0x53, 0xb4, 0x37, 0xeb, 0x00, 0x94, 0x87, 0xcf, 0x82, 0xf1,
+	0x4b, 0x0d, 0xea, 0xe9, 0x60, 0xa2, 0xcf, 0xa0, 0x66, 0xfb, 0x7e, 0x40, 0x6c, 0xba, 0xf5, 0xcb,
+	0x42, 0xe6, 0xfd, 0x82, 0xb0, 0x3f, 0xd8, 0x48, 0x60, 0xfc, 0x00, 0x92, 0x36, 0x5c, 0x7a, 0x0e,
+	0x7a, 0x1e, 0xf0, 0x4e, 0x47, 0x91, 0x67, 0xd0, 0xca, 0x2d, 0xa2, 0xac, 0x30, 0xa3, 0xab, 0x32,
+	0xb5, 0x9f, 0xe6, 0x67, 0x07, 0x2a, 0x63, 0xcb, 0x6f, 0x89, 0xcb, 0xe8, 0x6f, 0x63, 0x17, 0x2a,
+	0x6a, 0xfb, 0x69, 0x43, 0x59, 0x9c, 0xec, 0x34, 0xb1, 0x95, 0x8b, 0x36, 0xba, 0x9e, 0x2e, 0xe9,
+	0x76, 0x26, 0x78, 0x51, 0xb7, 0xa9, 0x43, 0x93, 0xeb, 0xad, 0x20, 0x62, 0x6b, 0x81, 0xf1, 0x04,
+	0xaa, 0x6a, 0xbb, 0xa0, 0xfe, 0x1e, 0xbb, 0x51, 0x4c, 0x84, 0x0f, 0xbc, 0x41, 0x9d, 0xf0, 0xec,
+	0x98, 0x48, 0x27, 0xe8, 0x6f, 0xe3, 0xe7, 0x1a, 0xa0, 0xfc, 0xe1, 0xb4, 0xdb, 0xa1, 0x67, 0x8e,
+	0x20, 0xea, 0x9f, 0xe2, 0x98, 0x44, 0x36, 0x09, 0x22, 0x9a, 0xa9, 0x7c, 0xe8, 0xcd, 0xb4, 0xb8,
+	0xeb, 0xa0, 0xdb, 0x50, 0x53, 0x27, 0x61, 0x97, 0x97, 0x7b, 0x55, 0x13, 0xa4, 0x88, 0x03, 0xd4,
+	0x09, 0xd9, 0x75, 0x58, 0xc9, 0x57, 0x35, 0x41, 0x8a, 0xba, 0xce, 0xe7, 0x53, 0x15, 0x4d, 0x2f,
+	0x99, 0x15, 0x7a, 0xb2, 0x67, 0x03, 0xb9, 0x80, 0xf9, 0xe2, 0x9b, 0x65, 0xf4, 0x41, 0xaa, 0x3c,
+	0x5e, 0x1c, 0x73, 0xb0, 0x16, 0x65, 0xf8, 0x47, 0x50, 0x91, 0x5d, 0x88, 0xdb, 0x85, 0x85, 0x71,
+	0x57, 0xcb, 0x0a, 0x68, 0xfc, 0xb1, 0x04, 0x7a, 0x5e, 0x4d, 0x43, 0x49, 0x4f, 0xd2, 0xf2, 0x34,
+	0xc2, 0x1b, 0x45, 0x85, 0x36, 0x4d, 0x9b, 0x81, 0xdd, 0x17, 0x21, 0xa0, 0x3f, 0xe9, 0xd8, 0xe5,
+	0x93, 0x06, 0xdd, 0x91, 0x78, 0xdd, 0x08, 0x42, 0x44, 0x37, 0xa1, 0x1b, 0x50, 0x75, 0xc3, 0xb3,
+	0xc7, 0xb4, 0x38, 0xe0, 0xb5, 0x63, 0xd5, 0xac, 0x50, 0x41, 0x0f, 0x13, 0xa9, 0x5c, 0xe7, 0xca,
+	0xb2, 0x52, 0xae, 0x33, 0xe5, 0x5d, 0x98, 0xa6, 0x15, 0xbf, 0xac, 0x14, 0x65, 0x71, 0x73, 0xe8,
+	0xe2, 0xa8, 0xeb, 0x1f, 0x07, 0x26, 0xd7, 0xa2, 0x0f, 0xa0, 0xc2, 0x3b, 0xb0, 0x49, 0xbb, 0xc2,
+	0x90, 0x4d, 0x75, 0x2f, 0x49, 0x18, 0x70, 0x86, 0xf5, 0x67, 0x13, 0x01, 0x5d, 0x67, 0xd0, 0xea,
+	0x58, 0xe8, 0x3a, 0x87, 0xea, 0xf8, 0x24, 0xc2, 0x71, 0x6c, 0x1d, 0xd9, 0xbe, 0x73, 0xee, 0x3a,
+	0xe4, 0x94, 0x3d, 0x37, 0x4c, 0x99, 0x2d, 0x2e, 0xdf, 0x94, 0x62, 0x63, 0x6b, 0x74, 0x36, 0xc5,
+	0x61, 0xe7, 0xed, 0x67, 0xd3, 0xd8, 0x80, 0x66, 0xfa, 0x52, 0xa8, 0xdb, 0xc9, 0x67, 0x55, 0xe9,
+	0x8d, 0x59, 0xe5, 0x01, 0x1a, 0x7d, 0x51, 0x41, 0x77, 0x53, 0x3e, 0xcc, 0x15, 0x5c, 0x3f, 0x89,
+	0x6c, 0x7a, 0x98, 0xca, 0xa6, 0xc9, 0xcc, 0x02, 0x9f, 0x79, 0x56, 0x49, 0x32, 0xe9, 0xaf, 0x25,
+	0xa8, 0xa7, 0x55, 0x45, 0x47, 0xda, 0x7c, 0x76, 0x94, 0x46, 0xb2, 0x43, 0xcd, 0xf1, 0xe4, 0x95,
+	0x73, 0xfc, 0x00, 0x66, 0xf1, 0x45, 0x88, 0xfb, 0x04, 0x3b, 0x16, 0x9b, 0x6c, 0xdb, 0x71, 0x22,
+	0x99, 0x6d, 0xd7, 0xa4, 0xaa, 0x1b, 0x9e, 0x3d, 0xde, 0xa0, 0x8a, 0x3c, 0x7e, 0x5d, 0xe0, 0xa7,
+	0x47, 0xf0, 0xeb, 0x1c, 0xff, 0x31, 0xb4, 0xd4, 0xf1, 0xcd, 0xe2, 0x0e, 0x95, 0x8b, 0x1d, 0x6a,
+	0x2a, 0xdc, 0x21, 0xf3, 0xec, 0x09, 0x34, 0xe5, 0x59, 0xcf, 0xba, 0x32, 0x5b, 0xeb, 0xe2, 0x08,
+	0xc8, 0xcd, 0x1e, 0x43, 0xe3, 0x38, 0x88, 0xce, 0xed, 0x48, 0x76, 0x57, 0x19, 0x63, 0x25, 0x50,
+	0xcc, 0xca, 0xf8, 0xf7, 0xec, 0x0c, 0x8b, 0x2c, 0x7b, 0xbb, 0x19, 0x36, 0x22, 0xa8, 0x48, 0xda,
+	0xc2, 0xb9, 0xfa, 0x00, 0x74, 0xd7, 0xe7, 0x29, 0xcf, 0x4e, 0xf0, 0xae, 0xda, 0x47, 0x5b, 0x42,
+	0xbe, 0x2f, 0xc4, 0x74, 0xe9, 0xc4, 0x39, 0xa4, 0xb8, 0xae, 0xc1, 0x19, 0xa0, 0xf1, 0x14, 0x66,
+	0xc4, 0x97, 0x85, 0xe6, 0xa0, 0x8c, 0x2f, 0x68, 0xf5, 0x2a, 0x57, 0x19, 0x7c, 0x41, 0xba, 0x21,
+	0x15, 0xb3, 0x04, 0x0f, 0xe5, 0xbe, 0x43, 0x1d, 0x0e, 0x0d, 0x13, 0x66, 0x0b, 0x6e, 0x77, 0xd1,
+	0x1d, 0x68, 0xb8, 0x71, 0x60, 0x11, 0x77, 0x80, 0x63, 0x62, 0x0f, 0x24, 0x57, 0xdd, 0x8d, 0x83,
+	0x43, 0x29, 0xa3, 0x87, 0xe7, 0x61, 0x48, 0x21, 0x8c, 0x52, 0x33, 0x45, 0xcb, 0x08, 0xa1, 0x3d,
+	0xee, 0x66, 0xf7, 0x6d, 0xbf, 0x92, 0x0f, 0xa1, 0xcc, 0xef, 0x1c, 0xc5, 0xd5, 0x87, 0x84, 0xe6,
+	0xee, 0x34, 0x05, 0xc8, 0x58, 0x85, 0x66, 0x56, 0x43, 0x7d, 0x13, 0x04, 0xa2, 0x28, 0x12, 0xc8,
+	0x8d, 0x22, 0xdf, 0xde, 0x6d, 0x7e, 0x2f, 0xe0, 0xe6, 0x55, 0x17, 0xbe, 0xef, 0xb2, 0xb5, 0xbc,
+	0xe3, 0x30, 0xbb, 0xe3, 0x7a, 0x7e, 0xf7, 0x65, 0x70, 0x1d, 0xe6, 0x0a, 0x2f, 0x6e, 0xd1, 0x2d,
+	0x80, 0x70, 0x78, 0xe4, 0xb9, 0x7d, 0x2b, 0xa9, 0x5b, 0xaa, 0x5c, 0xf2, 0x05, 0xbe, 0x34, 0x5e,
+	0xf2, 0x2f, 0x23, 0xf7, 0x4e, 0xb9, 0x04, 0x6a, 0x75, 0x94, 0xb5, 0xa2, 0x6c, 0xab, 0x7d, 0x89,
+	0xae, 0x0c, 0x22, 0xf7, 0xd8, 0x3e, 0x42, 0x17, 0x84, 0x3c, 0x9d, 0x18, 0xc7, 0x3f, 0x4c, 0xb7,
+	0x0d, 0xcd, 0xec, 0x3b, 0x67, 0xc1, 0x2d, 0xe9, 0x54, 0x18, 0x04, 0x9e, 0x88, 0x77, 0x2b, 0xff,
+	0xb2, 0xc9, 0x94, 0xc6, 0x4a, 0x42, 0x33, 0xe6, 0xfe, 0xf3, 0x39, 0x54, 0x24, 0x82, 0xd5, 0x63,
+	0xae, 0xa3, 0x2e, 0xcf, 0xe8, 0x6f, 0xb4, 0x0c, 0x30, 0xb0, 0xe3, 0x6f, 0x87, 0x38, 0xb2, 0x45,
+	0xa5, 0x56, 0x31, 0x53, 0x12, 0xe3, 0xb7, 0x1a, 0x5c, 0x2f, 0x7a, 0xb6, 0x44, 0xf7, 0x52, 0x53,
+	0xb8, 0x50, 0x78, 0xe0, 0x10, 0xa9, 0xf3, 0x29, 0x94, 0x3d, 0xfb, 0x08, 0x7b, 0xb2, 0x8a, 0xbe,
+	0x77, 0xc5, 0x63, 0xe8, 0x83, 0x5d, 0x86, 0x14, 0x77, 0xe6, 0xdc, 0x6c, 0xe9, 0x19, 0xd4, 0x52,
+	0xe2, 0x77, 0x2a, 0x54, 0x3f, 0xcd, 0x3b, 0xaf, 0x1e, 0x17, 0xde, 0xce, 0x79, 0xa3, 0x03, 0x7a,
+	0x5e, 0x9e, 0xbd, 0xb1, 0xd3, 0x72, 0x37, 0x76, 0x85, 0xb7, 0x91, 0xbf, 0xd1, 0xa0, 0x95, 0x7b,
+	0x57, 0x45, 0x46, 0xca, 0x05, 0x94, 0x7f, 0x36, 0x15, 0xa1, 0xfb, 0x24, 0x17, 0x3a, 0xa3, 0xf8,
+	0x8d, 0xf6, 0x9f, 0x1d, 0xb5, 0x27, 0x29, 0x6f, 0x45, 0xc0, 0xde, 0xc2, 0x5b, 0xe3, 0x3d, 0xa8,
+	0xa5, 0x44, 0x85, 0x17, 0xda, 0x87, 0x00, 0xfc, 0x79, 0xf4, 0x50, 0x9c, 0x0f, 0xdc, 0x50, 0x2c,
+	0xff, 0x15, 0x93, 0xfd, 0x66, 0x5e, 0x5d, 0x78, 0xb6, 0x2f, 0x52, 0x91, 0x37, 0x68, 0xc8, 0xd5,
+	0x23, 0x8d, 0xbc, 0x5d, 0x55, 0x02, 0xe3, 0x6f, 0x25, 0xa8, 0xa5, 0x1e, 0x8c, 0xd1, 0xfb, 0xa9,
+	0xb3, 0x48, 0x72, 0x1b, 0xca, 0x10, 0xc9, 0xcb, 0x06, 0xfa, 0x08, 0xea, 0x6e, 0xc8, 0xff, 0x89,
+	0x80, 0xa1, 0xf9, 0xdd, 0xe9, 0x35, 0xf5, 0xa1, 0xd1, 0x4f, 0x86, 0xc1, 0xc1, 0x0d, 0xe5, 0x6f,
+	0x1a, 0x46, 0x27, 0x26, 0xb2, 0xdc, 0x75, 0x62, 0x82, 0x0c, 0x68, 0xb0, 0xab, 0x89, 0xc0, 0xc1,
+	0xec, 0x4c, 0x22, 0x8a, 0xfd, 0x9a, 0x13, 0x93, 0x5e, 0xe0, 0x60, 0x1a, 0x11, 0xb4, 0x0c, 0x35,
+	0x85, 0x71, 0x43, 0x79, 0xcb, 0x2b, 0x10, 0xdd, 0x90, 0x16, 0x45, 0xb1, 0x3d, 0xc0, 0x56, 0x3c,
+	0x3c, 0xf2, 0x31, 0x61, 0xaf, 0x68, 0x15, 0x13, 0xa8, 0xe8, 0x80, 0x49, 0xd0, 0x7b, 0x50, 0xa7,
+	0xe5, 0x44, 0x30, 0x24, 0x27, 0x81, 0xeb, 0x9f, 0xb0, 0xab, 0xcf, 0x8a, 0x59, 0xf3, 0x6d, 0xb2,
+	0x27, 0x44, 0xe8, 0x2e, 0x34, 0xbd, 0xa0, 0x6f, 0x7b, 0x96, 0x3c, 0x86, 0xb0, 0xbb, 0xcf, 0x8a,
+	0xd9, 0x60, 0x52, 0xb9, 0xb8, 0xa2, 0x35, 0xa8, 0x11, 0x36, 0x03, 0x7c, 0xd0, 0xfc, 0xff, 0x65,
+	0xe4, 0xa0, 0x93, 0xb9, 0x31, 0x81, 0x24, 0xf3, 0xb4, 0x02, 0xf5, 0x94, 0xfb, 0xf2, 0xbe, 0x13,
+	0x94, 0xff, 0xb1, 0x71, 0x5b, 0x4c, 0x80, 0xc8, 0x16, 0x11, 0xa5, 0x92, 0x8a, 0x92, 0xf1, 0x63,
+	0x0d, 0x16, 0xc7, 0x3e, 0xb1, 0xb3, 0x54, 0xa1, 0x07, 0x45, 0x99, 0x2a, 0xf4, 0x40, 0x29, 0x0e,
+	0x16, 0xa5, 0xe4, 0x60, 0x91, 0x59, 0x50, 0x27, 0xb3, 0x0b, 0x2a, 0x5a, 0x05, 0x3d, 0xb4, 0x23,
+	0xec, 0x13, 0xcb, 0xc1, 0xec, 0x62, 0xc4, 0x0d, 0xc5, 0x4c, 0x34, 0xb9, 0xbc, 0xc3, 0xc4, 0xdd,
+	0xd0, 0x78, 0x58, 0xe8, 0x89, 0xf0, 0xbc, 0xc0, 0x13, 0xe3, 0x47, 0x1a, 0x2c, 0x8c, 0x79, 0x86,
+	0xbf, 0x72, 0x03, 0xc8, 0x6e, 0x50, 0xa5, 0xdc, 0x06, 0x45, 0x2b, 0x52, 0xd7, 0x27, 0x38, 0x3a,
+	0xb6, 0x99, 0xb7, 0xd9, 0x81, 0x5d, 0x53, 0x2a, 0x59, 0xc2, 0x1a, 0x4f, 0x0a, 0xbc, 0x78, 0xf3,
+	0x36, 0x64, 0xfc, 0x4e, 0x83, 0xb9, 0xc2, 0x97, 0x78, 0xb4, 0x06, 0x73, 0xf2, 0x16, 0xa9, 0xef,
+	0x0d, 0x63, 0x82, 0x23, 0x8b, 0x6e, 0x09, 0xf2, 0x16, 0x64, 0x56, 0x28, 0xb7, 0xb8, 0x6e, 0x8b,
+	0xaa, 0xd0, 0xe3, 0xe4, 0x9f, 0x52, 0xf0, 0x05, 0xc1, 0x91, 0x6f, 0x7b, 0xc2, 0xa8, 0x24, 0x2e,
+	0xb5, 0xb9, 0x76, 0x5b, 0x28, 0xb9, 0xd5, 0x7f, 0xc0, 0x92, 0xb4, 0xa2, 0x49, 0x78, 0x64, 0x7b,
+	0xb6, 0xdf, 0x57, 0xdd, 0xf1, 0x42, 0xb1, 0x2d, 0x10, 0xbb, 0x29, 0x00, 0xb3, 0xbe, 0xbf, 0x0a,
+	0x55, 0xf5, 0x92, 0x81, 0x66, 0x60, 0x72, 0xa3, 0xf7, 0xb5, 0x3e, 0x81, 0x2a, 0x30, 0xd5, 0xdd,
+	0x7f, 0xf5, 0x58, 0x9f, 0x12, 0xbf, 0xd6, 0xf5, 0xf2, 0xfd, 0x9f, 0x68, 0x50, 0x55, 0x9f, 0x39,
+	0x6a, 0x40, 0x75, 0xab, 0xdb, 0x31, 0xad, 0x6e, 0xef, 0xb3, 0x3d, 0x7d, 0x02, 0xcd, 0x42, 0xcb,
+	0xdc, 0x7e, 0xb9, 0x77, 0xb8, 0x6d, 0x7d, 0xb5, 0x67, 0x7e, 0xb1, 0xbb, 0xb7, 0xd1, 0xd1, 0x35,
+	0xd4, 0x82, 0x9a, 0x10, 0xee, 0xec, 0x1d, 0x1c, 0xea, 0x25, 0x84, 0xa0, 0xb9, 0xbb, 0xb7, 0xb5,
+	0xb1, 0x9b, 0x80, 0x26, 0x51, 0x13, 0x80, 0xcb, 0x18, 0x66, 0x0a, 0x5d, 0x83, 0x86, 0x30, 0x3a,
+	0xfc, 0xb2, 0xd7, 0xdb, 0xde, 0xd5, 0xa7, 0x91, 0x0e, 0x75, 0x0e, 0x11, 0x92, 0xf2, 0xfd, 0x67,
+	0x00, 0xc9, 0x1a, 0x42, 0x7d, 0xec, 0xed, 0xf5, 0xb6, 0xf5, 0x09, 0x54, 0x87, 0x4a, 0x6f, 0xcf,
+	0xda, 0xee, 0x6d, 0x6d, 0xec, 0xeb, 0x1a, 0xaa, 0xc2, 0x34, 0x4b, 0x46, 0xbd, 0xc4, 0x87, 0xd1,
+	0xdd, 0xd7, 0x27, 0xd7, 0x9e, 0x03, 0xf0, 0xb7, 0x2b, 0xf6, 0x6f, 0x93, 0x8f, 0x60, 0x8a, 0xfd,
+	0x95, 0xcb, 0x6e, 0xea, 0x9f, 0x31, 0x97, 0xa4, 0x2c, 0xf5, 0x0f, 0x99, 0x8f, 0xb4, 0xcd, 0x85,
+	0xef, 0x7e, 0x58, 0xd6, 0xfe, 0xf0, 0xc3, 0xb2, 0xf6, 0xa7, 0x1f, 0x96, 0xb5, 0x5f, 0xfc, 0x65,
+	0x79, 0xe2, 0xbf, 0xa6, 0xd9, 0xb3, 0xc0, 0x51, 0x99, 0xfd, 0xf9, 0xe8, 0xef, 0x01, 0x00, 0x00,
+	0xff, 0xff, 0x96, 0x82, 0x37, 0xbe, 0xee, 0x29, 0x00, 0x00,
 }